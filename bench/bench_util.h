@@ -0,0 +1,104 @@
+// Shared helpers for the host benchmarks: wall-clock timing, sample series
+// with percentiles, failed checks, and one-line JSON output for tracking
+// across releases.
+
+#ifndef ARGUS_BENCH_UTIL_H
+#define ARGUS_BENCH_UTIL_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+#include <vector>
+#include "host_sim.h"
+
+inline uint64_t benchNowNs() {
+    return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Failed checks; a bench exits non-zero if there are any. One count per
+// program: a static in an inline function, not a copy per file.
+inline int& benchFailures() {
+    static int count = 0;
+    return count;
+}
+
+inline void benchCheck(bool ok, const char* what) {
+    if (!ok) {
+        printf("  FAIL: %s\n", what);
+        benchFailures()++;
+    }
+}
+
+inline bool benchHasFlag(int argc, char** argv, const char* flag) {
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], flag) == 0) return true;
+    }
+    return false;
+}
+
+inline long benchArg(int argc, char** argv, const char* flag, long fallback) {
+    for (int i = 1; i + 1 < argc; i++) {
+        if (strcmp(argv[i], flag) == 0) return strtol(argv[i + 1], nullptr, 10);
+    }
+    return fallback;
+}
+
+inline const char* benchArgStr(int argc, char** argv, const char* flag, const char* fallback) {
+    for (int i = 1; i + 1 < argc; i++) {
+        if (strcmp(argv[i], flag) == 0) return argv[i + 1];
+    }
+    return fallback;
+}
+
+class BenchSeries {
+public:
+    void reserve(size_t n) {
+        HostAllocPause pause;
+        samples.reserve(n);
+    }
+
+    void add(double v) {
+        HostAllocPause pause;
+        samples.push_back(v);
+        sorted = false;
+    }
+
+    size_t count() const { return samples.size(); }
+
+    double mean() const {
+        if (samples.empty()) return 0;
+        double sum = 0;
+        for (size_t i = 0; i < samples.size(); i++) sum += samples[i];
+        return sum / samples.size();
+    }
+
+    double percentile(double p) {
+        if (samples.empty()) return 0;
+        if (!sorted) {
+            std::sort(samples.begin(), samples.end());
+            sorted = true;
+        }
+        size_t idx = (size_t)(p / 100.0 * (samples.size() - 1) + 0.5);
+        return samples[idx];
+    }
+
+    double max() { return percentile(100); }
+
+private:
+    std::vector<double> samples;
+    bool sorted = false;
+};
+
+// Allocation counters between two points
+struct BenchAllocDelta {
+    HostAllocStats start;
+    BenchAllocDelta() : start(hostAllocStats()) {}
+    uint64_t allocs() const { return hostAllocStats().allocs - start.allocs; }
+    uint64_t bytes() const { return hostAllocStats().bytes - start.bytes; }
+    uint64_t psramAllocs() const { return hostAllocStats().psramAllocs - start.psramAllocs; }
+};
+
+#endif
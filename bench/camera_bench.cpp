@@ -0,0 +1,203 @@
+// Camera capture manager (camera_capture.h) on the host camera model
+// (host_camera.cpp: 250 ms init, 25 fps stream, stale buffers):
+//
+// 1. Per event, with the PSRAM double buffer (GRAB_LATEST) and with one
+//    buffer (GRAB_WHEN_EMPTY): request-to-frame latency from off (power-up
+//    and warm-up frames) and warm (within CAMERA_KEEP_WARM_MS), the camera's
+//    powered time per event, and the stale frames it dropped. Every frame
+//    handed out was exposed after its request, with exposure settled; the
+//    plain fb_get() on a running camera gives one from before the request.
+// 2. Per-request settings: an upload at another size re-initialises and
+//    comes back at that size; a request while a frame at other settings is
+//    out is refused.
+// 3. Duty: a day of day cycles (one capture per INTERVAL_DAY) against the
+//    camera left on from boot as before.
+// 4. A camera that fails its init: no frame, and no second 250 ms attempt.
+//
+// Exits non-zero if a check fails.
+//
+//   .pio/build/bench_camera/program [--captures N] [--json]
+
+#include <Arduino.h>
+#include "host_sim.h"
+#include "bench_util.h"
+#include "config.h"
+#include "camera_capture.h"
+#include "logger.h"
+
+// Loop passes every 10 ms for ms, the manager's idle check in each
+static void idleFor(uint32_t ms) {
+    for (uint32_t t = 0; t < ms; t += 10) {
+        cameraIdle();
+        logDrain();
+        hostClockAdvanceMs(10);
+    }
+}
+
+struct EventResult {
+    const char* name;
+    BenchSeries coldMs;
+    BenchSeries warmMs;
+    BenchSeries onMs;           // Powered time per event
+    uint32_t captures;
+    uint32_t stale;             // Dropped by the manager
+    uint32_t notFresh;          // Handed out, exposed before the request
+    uint32_t unsettled;
+    bool naiveStale;            // fb_get() on the running camera after an idle second
+    double naiveAgeMs;
+};
+
+// Events of three captures 200 ms apart, CAMERA_KEEP_WARM_MS + 1 s between
+// events
+static void runEvents(EventResult* r, bool psram, long events) {
+    hostReset();
+    hostSerialEcho(false);
+    hostSetPsram(psram);
+    cameraBegin(false);
+    for (long e = 0; e < events; e++) {
+        for (int i = 0; i < 3; i++) {
+            uint64_t requested = hostClockMicros();
+            camera_fb_t* fb = cameraCapture(CAPTURE_SCORING);
+            if (!fb) continue;
+            double ms = (hostClockMicros() - requested) / 1000.0;
+            (i == 0 ? r->coldMs : r->warmMs).add(ms);
+            HostCameraFrameInfo info = hostCameraFrameInfo(fb);
+            if (info.capturedMicros <= requested) r->notFresh++;
+            if (!info.settled) r->unsettled++;
+            r->captures++;
+            hostClockAdvanceMs(20);         // Scoring
+            cameraRelease(fb);
+            idleFor(200);
+        }
+        idleFor(CAMERA_KEEP_WARM_MS + 1000);
+        benchCheck(!cameraStats().powered && !hostCameraStats().powered, "camera still on after CAMERA_KEEP_WARM_MS");
+        r->onMs.add(cameraStats().lastActiveMs);
+    }
+    r->stale = cameraStats().staleDropped;
+
+    // Plain fb_get() a second after the last frame went back
+    camera_fb_t* fb = cameraCapture(CAPTURE_SCORING);
+    cameraRelease(fb);
+    hostClockAdvanceMs(1000);
+    uint64_t requested = hostClockMicros();
+    fb = esp_camera_fb_get();
+    if (fb) {
+        HostCameraFrameInfo info = hostCameraFrameInfo(fb);
+        r->naiveStale = info.capturedMicros <= requested;
+        r->naiveAgeMs = r->naiveStale ? (requested - info.capturedMicros) / 1000.0 : 0;
+        esp_camera_fb_return(fb);
+    }
+    cameraPowerDown();
+    logDrain();
+}
+
+int main(int argc, char** argv) {
+    long events = benchArg(argc, argv, "--captures", 20);
+    bool json = benchHasFlag(argc, argv, "--json");
+
+    // --- 1. Events ---
+    EventResult latest = {}, single = {};
+    latest.name = "PSRAM, 2 buffers";
+    single.name = "no PSRAM, 1 buffer";
+    runEvents(&latest, true, events);
+    runEvents(&single, false, events);
+    EventResult* runs[] = {&latest, &single};
+    for (int i = 0; i < 2; i++) {
+        EventResult& r = *runs[i];
+        benchCheck(r.captures == 3 * (uint32_t)events, "capture failed");
+        benchCheck(r.notFresh == 0, "frame exposed before its request");
+        benchCheck(r.unsettled == 0, "frame before exposure settled");
+        benchCheck(r.coldMs.max() < CAMERA_CAPTURE_TIMEOUT_MS, "capture from off over CAMERA_CAPTURE_TIMEOUT_MS");
+        benchCheck(r.warmMs.max() <= 80, "warm capture over two frame periods");
+        benchCheck(r.naiveStale, "plain fb_get() gave a fresh frame: stale model not exercised");
+        benchCheck(r.onMs.max() <= CAMERA_KEEP_WARM_MS + 400 + 3 * 220, "camera on longer than its captures and CAMERA_KEEP_WARM_MS");
+    }
+    benchCheck(single.stale > 0 && single.naiveAgeMs >= 900, "one buffer: frame kept since the last return not dropped");
+
+    // --- 2. Per-request settings ---
+    hostReset();
+    hostSerialEcho(false);
+    cameraBegin(false);
+    CaptureRequest evidence = {FRAMESIZE_SVGA, 10};
+    camera_fb_t* fb = cameraCapture(CAPTURE_SCORING);
+    bool vga = fb && fb->width == 640 && fb->height == 480;
+    camera_fb_t* refused = cameraCapture(evidence);
+    cameraRelease(fb);
+    uint32_t initsBefore = hostCameraStats().inits;
+    fb = cameraCapture(evidence);
+    bool svga = fb && fb->width == 800 && fb->height == 600;
+    cameraRelease(fb);
+    benchCheck(vga, "scoring frame not VGA");
+    benchCheck(!refused, "other settings accepted with a frame out");
+    benchCheck(svga && hostCameraStats().inits == initsBefore + 1, "SVGA request not re-initialised at that size");
+    cameraPowerDown();
+    logDrain();
+
+    // --- 3. Duty over a day of day cycles ---
+    hostReset();
+    hostSerialEcho(false);
+    cameraBegin(false);
+    uint32_t cycles = 86400000UL / INTERVAL_DAY;
+    uint64_t start = hostClockMicros();
+    uint32_t dutyCaptures = 0;
+    for (uint32_t c = 0; c < cycles; c++) {
+        uint64_t cycleStart = hostClockMicros();
+        fb = cameraCapture(CAPTURE_SCORING);
+        if (fb) dutyCaptures++;
+        hostClockAdvanceMs(20);
+        cameraRelease(fb);
+        uint32_t spent = (uint32_t)((hostClockMicros() - cycleStart) / 1000);
+        idleFor(INTERVAL_DAY - spent);
+    }
+    double dayMs = (hostClockMicros() - start) / 1000.0;
+    CameraStats duty = cameraStats();
+    HostCameraStats model = hostCameraStats();
+    double dutyPct = 100.0 * duty.activeMs / dayMs;
+    benchCheck(dutyCaptures == cycles, "day cycle capture failed");
+    // Per cycle: power-up, warm-up frames, one frame, scoring, then CAMERA_KEEP_WARM_MS
+    benchCheck(dutyPct < 100.0 * (CAMERA_KEEP_WARM_MS + 400 + 20) / INTERVAL_DAY, "camera on past CAMERA_KEEP_WARM_MS after the captures");
+    benchCheck(fabs(model.activeMicros / 1000.0 - duty.activeMs) <= duty.events + 1, "reported on time differs from the camera's");
+    logDrain();
+
+    // --- 4. Init failure ---
+    hostReset();
+    hostSerialEcho(false);
+    hostCameraFailInit(true);
+    bool probed = cameraBegin(true);
+    uint64_t t0 = hostClockMicros();
+    fb = cameraCapture(CAPTURE_SCORING);
+    double failMs = (hostClockMicros() - t0) / 1000.0;
+    benchCheck(!probed && !fb, "frame from a camera that failed its init");
+    benchCheck(hostCameraStats().inits == 1 && failMs < 1, "init retried after a failure");
+    hostCameraFailInit(false);
+    logDrain();
+
+    if (json) {
+        printf("{\"bench\":\"camera\",\"events\":%ld", events);
+        for (int i = 0; i < 2; i++) {
+            EventResult& r = *runs[i];
+            printf(",\"%s\":{\"cold_ms\":%.1f,\"warm_p50_ms\":%.1f,\"warm_max_ms\":%.1f,\"on_ms\":%.0f,"
+                   "\"stale_dropped\":%u,\"naive_age_ms\":%.0f}",
+                   i == 0 ? "psram" : "single", r.coldMs.mean(), r.warmMs.percentile(50), r.warmMs.max(),
+                   r.onMs.mean(), r.stale, r.naiveAgeMs);
+        }
+        printf(",\"day_cycles\":%u,\"duty_pct\":%.2f,\"events_per_day\":%u,\"ok\":%s}\n", cycles, dutyPct,
+               duty.events, benchFailures() ? "false" : "true");
+        return benchFailures() ? 1 : 0;
+    }
+    printf("ArgoS camera capture\n");
+    printf("  %-20s %9s %11s %11s %10s %7s %12s\n", "buffers", "cold ms", "warm p50", "warm max", "on/event", "stale",
+           "fb_get age");
+    for (int i = 0; i < 2; i++) {
+        EventResult& r = *runs[i];
+        printf("  %-20s %9.1f %11.1f %11.1f %10.0f %7u %9.0f ms\n", r.name, r.coldMs.mean(), r.warmMs.percentile(50),
+               r.warmMs.max(), r.onMs.mean(), r.stale, r.naiveAgeMs);
+    }
+    printf("  settings per request: VGA scoring %s, SVGA upload %s, busy change %s\n", vga ? "ok" : "WRONG",
+           svga ? "ok" : "WRONG", refused ? "ACCEPTED" : "refused");
+    printf("  day of %u cycles: camera on %.2f%% (%u power-ups, %.0f s), always on 100%%\n", cycles, dutyPct,
+           duty.events, duty.activeMs / 1000.0);
+    printf("  failed init: no frame in %.1f ms, %u init attempt(s)\n", failMs, hostCameraStats().inits);
+    printf("%s\n", benchFailures() ? "FAILED" : "OK");
+    return benchFailures() ? 1 : 0;
+}
@@ -0,0 +1,374 @@
+// Multi-channel sensors (SensorBank, struct-of-arrays): how a cycle scales
+// with the number of sensors per type.
+//
+// 1. Decision, statistics and telemetry for N channels: the batched path
+//    the firmware takes (one rule program pass over every channel, one loop
+//    per quantity, one frame) against running the single-channel path once
+//    per channel. Both decide the same for every channel.
+// 2. Telemetry frame: a multi-channel frame decodes to the same bank, and a
+//    single channel still encodes as the version 2 frame.
+// 3. Firmware: the real setup()/loop() with N DHT22 / BH1750 / GP2Y1010
+//    stand-ins. Every channel is reported with its own value, and one dirty
+//    string triggers the cleaning on its own.
+//
+// Exits non-zero on a decision mismatch, an allocation on the batched path,
+// a wrong frame, a channel reported wrong or a missed trigger.
+//
+//   .pio/build/bench_channels/program [--banks N] [--cycles N] [--json]
+
+#include <Arduino.h>
+#include <string>
+#include <vector>
+#include "host_sim.h"
+#include "bench_util.h"
+#include "config.h"
+#include "core.h"
+#include "rules.h"
+#include "report.h"
+#include "sensor_driver.h"
+#include "sensor_stats.h"
+#include "telemetry_frame.h"
+
+void setup();
+void loop();
+extern SensorBank bank;
+
+static const uint8_t channelCounts[] = {1, 2, 4, 8, 16};
+static const int COUNTS = sizeof(channelCounts) / sizeof(channelCounts[0]);
+static_assert(SENSOR_MAX_CHANNELS >= 16, "build with -D SENSOR_MAX_CHANNELS=16");
+
+static uint32_t rng = 0x9E3779B9;
+
+static float uniform() {
+    rng ^= rng << 13;
+    rng ^= rng >> 17;
+    rng ^= rng << 5;
+    return (rng & 0xFFFFFF) / 16777216.0f;
+}
+
+// Values around the thresholds of the default ruleset, now and then NaN
+static float around(float threshold, float spread) {
+    return uniform() < 0.02f ? NAN : threshold + (uniform() * 2 - 1) * spread;
+}
+
+static SensorBank randomBank(uint8_t n) {
+    SensorBank b;
+    b.channels = n;
+    for (uint8_t i = 0; i < n; i++) {
+        b.temp[i] = around(30, 10);
+        b.humidity[i] = around(HUMIDITY_MIN_TRIGGER, 20);
+        b.lux[i] = around(MIN_LUX_FOR_CLEANING, 3000);
+        b.dust[i] = around(DUST_THRESHOLD, 80);
+    }
+    return b;
+}
+
+static SystemStatus channelStatus(const SensorBank& b, uint8_t i, const SystemStatus& shared) {
+    SystemStatus s = shared;
+    s.temp = b.temp[i];
+    s.humidity = b.humidity[i];
+    s.lux = b.lux[i];
+    s.dust = b.dust[i];
+    return s;
+}
+
+struct PathCost {
+    double batchedNs;           // Per cycle (all channels)
+    double scalarNs;
+    uint64_t batchedAllocs;
+    uint32_t mismatches;
+    size_t frameBytes;          // One frame vs one per channel
+    size_t scalarFrameBytes;
+};
+
+static volatile uint32_t sink = 0;
+
+static PathCost measurePaths(uint8_t n, long banks) {
+    PathCost c = {};
+    std::vector<SensorBank> input;
+    input.reserve(banks);
+    for (long i = 0; i < banks; i++) input.push_back(randomBank(n));
+    SystemStatus shared = {NAN, NAN, NAN, NAN, 80.0f, NAN, MODE_DAY};
+    uint8_t frame[TELEMETRY_FRAME_MAX_SIZE];
+
+    // Same decisions
+    RuleResult results[SENSOR_MAX_CHANNELS];
+    // Cleaning due on half of the cycles
+    #define DAYS(k) ((int32_t)((k) % (2 * DAYS_BETWEEN_CLEAN)))
+    for (long k = 0; k < banks; k++) {
+        const SensorBank& b = input[k];
+        rulesEvaluateBank(b, shared, DAYS(k), results);
+        for (uint8_t i = 0; i < n; i++) {
+            RuleResult one = rulesEvaluate(channelStatus(b, i, shared), DAYS(k));
+            if (one.trigger != results[i].trigger || one.notes != results[i].notes) c.mismatches++;
+        }
+    }
+
+    // Batched: what the firmware does per cycle
+    BenchAllocDelta heap;
+    uint64_t t0 = benchNowNs();
+    for (long k = 0; k < banks; k++) {
+        const SensorBank& b = input[k];
+        SystemStatus status = channelStatus(b, 0, shared);
+        rulesEvaluateBank(b, status, DAYS(k), results);
+        sensorStatsAddStatus(status, b);
+        TelemetryFrame f;
+        f.flags = 0;
+        f.seq = 1;
+        f.timestamp = 0;
+        f.status = status;
+        f.bank = b;
+        c.frameBytes = encodeTelemetryFrame(f, frame, sizeof(frame));
+        sink += results[n - 1].trigger + frame[c.frameBytes - 1];
+    }
+    c.batchedNs = (double)(benchNowNs() - t0) / banks;
+    c.batchedAllocs = heap.allocs();
+
+    // Scalar: the single-channel path once per channel
+    t0 = benchNowNs();
+    for (long k = 0; k < banks; k++) {
+        const SensorBank& b = input[k];
+        c.scalarFrameBytes = 0;
+        for (uint8_t i = 0; i < n; i++) {
+            SystemStatus status = channelStatus(b, i, shared);
+            RuleResult r = rulesEvaluate(status, DAYS(k));
+            sensorStatsAdd(CH_TEMP, status.temp);
+            sensorStatsAdd(CH_HUMIDITY, status.humidity);
+            sensorStatsAdd(CH_DUST, status.dust);
+            sensorStatsAdd(CH_EFFICIENCY, status.efficiency);
+            sensorStatsAdd(CH_SOILING, status.soiling);
+            TelemetryFrame f;
+            f.flags = 0;
+            f.seq = 1;
+            f.timestamp = 0;
+            f.status = status;
+            f.bank.channels = 1;
+            size_t len = encodeTelemetryFrame(f, frame, sizeof(frame));
+            c.scalarFrameBytes += len;
+            sink += r.trigger + frame[len - 1];
+        }
+    }
+    c.scalarNs = (double)(benchNowNs() - t0) / banks;
+    #undef DAYS
+    sensorStatsResetInterval();
+    return c;
+}
+
+// --- 2. Frames ---
+static bool sameValue(float a, float b) { return (isnan(a) && isnan(b)) || a == b; }
+
+static bool frameRoundTrip(uint8_t n) {
+    TelemetryFrame f;
+    memset(&f, 0, sizeof(f));
+    f.seq = 1234;
+    f.timestamp = 1700000000;
+    f.bank = randomBank(n);
+    f.status = channelStatus(f.bank, 0, SystemStatus{NAN, NAN, NAN, NAN, 91.5f, 12.0f, MODE_DAY});
+    uint8_t buf[TELEMETRY_FRAME_MAX_SIZE];
+    size_t len = encodeTelemetryFrame(f, buf, sizeof(buf));
+    TelemetryFrame back;
+    size_t used = 0;
+    if (len != (size_t)TELEMETRY_FRAME_SIZE_CHANNELS(n) || !decodeTelemetryFrame(buf, len, &back, &used) || used != len) {
+        return false;
+    }
+    if (buf[0] != (n > 1 ? TELEMETRY_FRAME_VERSION_CHANNELS : TELEMETRY_FRAME_VERSION)) return false;
+    if (back.bank.channels != n || back.seq != f.seq || !sameValue(back.status.soiling, f.status.soiling)) return false;
+    for (uint8_t i = 0; i < n; i++) {
+        if (!sameValue(back.bank.temp[i], f.bank.temp[i]) || !sameValue(back.bank.humidity[i], f.bank.humidity[i]) ||
+            !sameValue(back.bank.lux[i], f.bank.lux[i]) || !sameValue(back.bank.dust[i], f.bank.dust[i])) {
+            return false;
+        }
+    }
+    // Shorter than its channel count says
+    return !decodeTelemetryFrame(buf, len - 1, &back);
+}
+
+// --- 3. Firmware ---
+struct FirmwareRun {
+    double wallUsMean;          // loop() of a day cycle
+    double wallUsP99;
+    double awakeMs;             // Virtual time in loop() (the dust wait, DHT and bus time)
+    double mqttBytes;           // Per cycle
+    double msgs;
+    bool reported;              // Every channel's dust on its topic, with its value
+    bool cleanQuiet;            // No alert while every string is clean
+    bool dirtyTriggers;         // The dirty string alone raises it
+};
+
+static float channelDust(uint8_t i) { return 40.0f + 5.0f * i; }
+
+static SensorLayout layoutFor(uint8_t n) {
+    SensorLayout layout;
+    memset(&layout, 0, sizeof(layout));
+    layout.dht = n;
+    layout.lux = n;
+    layout.dust = n;
+    for (uint8_t i = 0; i < n; i++) {
+        layout.dhtPins[i] = DHT_PIN;
+        layout.luxAddrs[i] = i == 0 ? BH1750_ADDR : (uint8_t)(0x40 + i);   // Behind a mux on a real board
+        layout.dustLedPins[i] = i == 0 ? DUST_LED_PIN : (uint8_t)(40 + i);
+        layout.dustVoPins[i] = DUST_VO_PIN;
+    }
+    return layout;
+}
+
+static FirmwareRun runFirmware(uint8_t n, long cycles) {
+    FirmwareRun run = {};
+    hostReset();
+    hostSerialEcho(false);
+    hostCameraSetFrameSize(24 * 1024);
+    HostEnvironment& env = hostEnv();
+    env.lux = 20000.0f;
+    env.temp = 31.0f;
+    env.humidity = 70.0f;
+
+    SensorLayout layout = layoutFor(n);
+    for (uint8_t i = 0; i < n; i++) {
+        hostI2cAttachLightSensor(layout.luxAddrs[i]);
+        hostSetDustAt(layout.dustLedPins[i], channelDust(i));
+    }
+
+    std::vector<float> lastDust(n, NAN);
+    uint32_t alerts = 0;
+    std::string dustTopic = MQTT_TOPIC(TOPIC_DUST);
+    std::string alertTopic = MQTT_TOPIC(TOPIC_ALERT);
+    hostBroker().addObserver([&](const std::string& topic, const uint8_t* payload, size_t len) {
+        HostAllocPause pause;
+        std::string value((const char*)payload, len);
+        if (topic == alertTopic && value == "true") alerts++;
+        if (topic.compare(0, dustTopic.size(), dustTopic) != 0) return;
+        std::string rest = topic.substr(dustTopic.size());
+        if (rest.empty()) lastDust[0] = strtof(value.c_str(), nullptr);
+        else if (rest[0] == '/' && isdigit((unsigned char)rest[1])) {
+            long i = strtol(rest.c_str() + 1, nullptr, 10);
+            if (i > 0 && i < n) lastDust[i] = strtof(value.c_str(), nullptr);
+        }
+    });
+
+    setup();
+    initSensors(layout);
+    // Every value published, so the messages follow the channel count
+    ReportConfig everyValue = reportConfigDefault();
+    everyValue.enabled = false;
+    reportConfigure(everyValue);
+    sensorBankReset(&bank);
+    benchCheck(bank.channels == n, "bank channel count");
+
+    BenchSeries wallNs;
+    wallNs.reserve(cycles);
+    double awakeUs = 0;
+    HostBroker& broker = hostBroker();
+    for (int warm = 0; warm < 3; warm++) {      // Connect, first mode change
+        hostClockAdvanceMs(INTERVAL_DAY + 1);
+        loop();
+    }
+    uint64_t msgStart = broker.messagesPublished;
+    uint64_t bytesStart = broker.bytesPublished;
+    uint32_t alertsBefore = alerts;
+    for (long c = 0; c < cycles; c++) {
+        hostClockAdvanceMs(INTERVAL_DAY + 1);
+        uint64_t virtStart = hostClockMicros();
+        uint64_t t0 = benchNowNs();
+        loop();
+        wallNs.add((double)(benchNowNs() - t0));
+        awakeUs += hostClockMicros() - virtStart;
+    }
+    run.wallUsMean = wallNs.mean() / 1000.0;
+    run.wallUsP99 = wallNs.percentile(99) / 1000.0;
+    run.awakeMs = awakeUs / cycles / 1000.0;
+    run.msgs = (double)(broker.messagesPublished - msgStart) / cycles;
+    run.mqttBytes = (double)(broker.bytesPublished - bytesStart) / cycles;
+    run.cleanQuiet = alerts == alertsBefore;
+
+    run.reported = true;
+    // The firmware applies DUST_CALIB; the ADC step is ~1 ug/m3
+    for (uint8_t i = 0; i < n; i++) run.reported &= fabsf(lastDust[i] - channelDust(i) * DUST_CALIB) <= 2.0f;
+
+    // Last string dirty and dry, cleaning due
+    hostSetDustAt(layout.dustLedPins[n - 1], DUST_THRESHOLD + 80);
+    env.humidity = HUMIDITY_MIN_TRIGGER - 20;
+    setDaysSinceClean(DAYS_BETWEEN_CLEAN);
+    alertsBefore = alerts;
+    hostClockAdvanceMs(INTERVAL_DAY + 1);
+    loop();
+    run.dirtyTriggers = alerts == alertsBefore + 1;
+    return run;
+}
+
+int main(int argc, char** argv) {
+    bool json = benchHasFlag(argc, argv, "--json");
+    long banks = benchArg(argc, argv, "--banks", 20000);
+    long cycles = benchArg(argc, argv, "--cycles", 100);
+
+    hostPowerCycle();
+    hostReset();
+    hostSerialEcho(false);
+    rulesInit();
+
+    PathCost paths[COUNTS];
+    bool frames[COUNTS];
+    FirmwareRun runs[COUNTS];
+    for (int k = 0; k < COUNTS; k++) {
+        uint8_t n = channelCounts[k];
+        paths[k] = measurePaths(n, banks);
+        frames[k] = frameRoundTrip(n);
+        benchCheck(paths[k].mismatches == 0, "batched decision differs from the single-channel one");
+        benchCheck(paths[k].batchedAllocs == 0, "batched path allocated");
+        benchCheck(frames[k], "frame round trip");
+    }
+
+    // One channel: the version 2 frame, byte for byte
+    TelemetryFrame one;
+    memset(&one, 0, sizeof(one));
+    one.seq = 7;
+    one.status = SystemStatus{21.5f, 40.0f, 9000.0f, 55.0f, 88.0f, NAN, MODE_DAY};
+    one.bank.channels = 1;
+    uint8_t a[TELEMETRY_FRAME_MAX_SIZE];
+    uint8_t b[TELEMETRY_FRAME_MAX_SIZE];
+    size_t lenA = encodeTelemetryFrame(one, a, sizeof(a));
+    one.bank.channels = 0;                      // Older callers: no bank
+    size_t lenB = encodeTelemetryFrame(one, b, sizeof(b));
+    benchCheck(lenA == TELEMETRY_FRAME_SIZE && lenB == lenA && a[0] == TELEMETRY_FRAME_VERSION && memcmp(a, b, lenA) == 0,
+               "single-channel frame is not version 2");
+
+    for (int k = 0; k < COUNTS; k++) {
+        runs[k] = runFirmware(channelCounts[k], cycles);
+        benchCheck(runs[k].reported, "a channel reported wrong or not at all");
+        benchCheck(runs[k].cleanQuiet, "alert with every string clean");
+        benchCheck(runs[k].dirtyTriggers, "dirty string did not trigger the cleaning");
+    }
+
+    if (json) {
+        printf("{\"bench\":\"channels\",\"channels\":[");
+        for (int k = 0; k < COUNTS; k++) {
+            printf("%s{\"n\":%u,\"batched_ns\":%.1f,\"scalar_ns\":%.1f,\"frame_bytes\":%zu,\"loop_us\":%.1f,"
+                   "\"awake_ms\":%.2f,\"mqtt_bytes\":%.1f}",
+                   k ? "," : "", (unsigned)channelCounts[k], paths[k].batchedNs, paths[k].scalarNs,
+                   paths[k].frameBytes, runs[k].wallUsMean, runs[k].awakeMs, runs[k].mqttBytes);
+        }
+        printf("],\"failures\":%d}\n", benchFailures());
+        return benchFailures() ? 1 : 0;
+    }
+
+    printf("ArgoS multi-channel benchmark (%ld banks, %ld day cycles per count)\n", banks, cycles);
+    printf("  decision + stats + frame per cycle\n");
+    printf("    n   batched ns  per-channel ns  speedup  frame B  per-channel B  mismatches  allocs\n");
+    for (int k = 0; k < COUNTS; k++) {
+        const PathCost& c = paths[k];
+        printf("   %2u   %10.1f  %14.1f  %6.2fx  %7zu  %13zu  %10u  %6llu\n", (unsigned)channelCounts[k],
+               c.batchedNs, c.scalarNs, c.scalarNs / c.batchedNs, c.frameBytes, c.scalarFrameBytes, c.mismatches,
+               (unsigned long long)c.batchedAllocs);
+    }
+    printf("  firmware day cycle (loop())\n");
+    printf("    n   wall us (p99)       awake ms  msgs  MQTT B  reported  clean  dirty string\n");
+    for (int k = 0; k < COUNTS; k++) {
+        const FirmwareRun& r = runs[k];
+        printf("   %2u   %7.1f (%7.1f)  %8.2f  %4.1f  %6.0f  %-8s  %-5s  %s\n", (unsigned)channelCounts[k],
+               r.wallUsMean, r.wallUsP99, r.awakeMs, r.msgs, r.mqttBytes, r.reported ? "ok" : "FAIL",
+               r.cleanQuiet ? "quiet" : "ALERT", r.dirtyTriggers ? "triggered" : "MISSED");
+    }
+    printf("  frames               round trip %s, 1 channel = version 2 %s\n",
+           frames[0] && frames[COUNTS - 1] ? "ok" : "FAIL", lenA == TELEMETRY_FRAME_SIZE ? "ok" : "FAIL");
+    printf("%s\n", benchFailures() ? "FAILED" : "OK");
+    return benchFailures() ? 1 : 0;
+}
@@ -0,0 +1,591 @@
+// Fleet collector (collector/collector.h) against a broker played by the
+// bench over loopback TCP: --devices stations each upload --images images
+// (8-24 KB in 4 KB chunks, windowed and resent as the firmware does, at
+// most --uploads at once) and --frames telemetry frames, with --loss % of
+// the chunks and of the collector's ACKs dropped on the way. Run with one
+// worker and with --workers: messages and MB/s through the collector,
+// images/s, upload latency (START to the last chunk ACKed), duplicates, the
+// backpressure counters and how busy the I/O thread is. All messages are
+// framed on that one thread: its busy share gives the ceiling on msg/s that
+// more workers cannot lift.
+//
+// Exits non-zero if an image on disk is missing or differs from the one
+// sent, a telemetry row is missing, a QoS 1 message is not acknowledged,
+// or a collector thread allocates after collectorBegin(). With more than two
+// cores (the bench's own thread plays the broker and every device), also if
+// --workers is not --min-speedup times the msg/s of one worker.
+//
+//   .pio/build/bench_collector/program [--devices N] [--images N] [--frames N]
+//       [--loss PCT] [--uploads N] [--workers N] [--min-speedup X] [--json]
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <math.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <stdlib.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <thread>
+#include <vector>
+#include "host_sim.h"
+#include "bench_util.h"
+#include "checksum.h"
+#include "collector.h"
+#include "image_transfer.h"
+#include "mqtt_wire.h"
+#include "telemetry_frame.h"
+
+#define BENCH_CHUNK      4096
+#define BENCH_IMAGE_MIN  (8 * 1024)
+#define BENCH_IMAGE_MAX  (24 * 1024)
+#define BENCH_TX_HIGH    (512 * 1024)   // Devices wait while this much is unsent
+#define BENCH_TIMEOUT_S  300
+
+static uint32_t rngState = 0x2545F491;
+
+static uint32_t rng() {
+    rngState ^= rngState << 13;
+    rngState ^= rngState >> 17;
+    rngState ^= rngState << 5;
+    return rngState;
+}
+
+static uint32_t wallMs() { return (uint32_t)(benchNowNs() / 1000000); }
+
+// First `size` bytes of image k of device d: a JPEG marker, then bytes from
+// a seeded xorshift
+static void fillImage(uint32_t device, uint32_t image, uint8_t* out, uint32_t size) {
+    uint32_t x = device * 2654435761u + image * 40503u + 1;
+    for (uint32_t i = 0; i < size; i++) {
+        x ^= x << 13;
+        x ^= x >> 17;
+        x ^= x << 5;
+        out[i] = (uint8_t)x;
+    }
+    out[0] = 0xFF;
+    out[1] = 0xD8;
+}
+
+struct Device {
+    char id[16];
+    uint16_t imagesDone;
+    uint16_t framesSent;
+    bool uploading;
+    uint32_t size;
+    uint64_t startNs;
+    ImageSender tx;
+};
+
+// The broker's side of the connection
+struct Link {
+    int fd;
+    std::vector<uint8_t> rx;
+    size_t rxLen;
+    std::vector<uint8_t> tx;
+    size_t txHead, txTail;
+    bool subscribed;
+    uint16_t nextId;
+    uint64_t qos1Sent, pubacks, acks, acksDropped, keyRequests;
+
+    size_t pending() const { return txTail - txHead; }
+
+    uint8_t* reserve(size_t len) {
+        if (txHead == txTail) txHead = txTail = 0;
+        if (tx.size() - txTail < len) {
+            memmove(&tx[0], &tx[txHead], pending());
+            txTail -= txHead;
+            txHead = 0;
+        }
+        return tx.size() - txTail >= len ? &tx[txTail] : nullptr;
+    }
+
+    void publish(const char* topic, const uint8_t* header, size_t headerLen, const uint8_t* payload, size_t len,
+                 uint8_t qos) {
+        size_t total = headerLen + len;
+        size_t topicLen = strlen(topic);
+        uint8_t* out = reserve(MQTT_PUBLISH_HEADER_MAX + topicLen + total);
+        if (!out) return;
+        uint16_t packetId = 0;
+        if (qos) {
+            if (!nextId) nextId = 1;
+            packetId = nextId++;
+            qos1Sent++;
+        }
+        size_t n = mqttEncodePublishHeader(out, tx.size() - txTail, topic, topicLen, total, qos, packetId);
+        memcpy(out + n, header, headerLen);
+        memcpy(out + n + headerLen, payload, len);
+        txTail += n + total;
+    }
+};
+
+struct Fleet {
+    long devices, images, frames, loss, uploads;
+    std::vector<Device> device;
+    std::vector<uint32_t> crc;          // Per device and image id - 1
+    std::vector<uint8_t> scratch;
+    BenchSeries latencyMs;
+    long active;
+    long finished;
+    uint32_t cursor;
+};
+
+struct RunResult {
+    int workers;
+    double seconds;
+    CollectorStats stats;
+    double p50Ms, p99Ms;
+    uint64_t allocs;
+    uint64_t imagesOk, imagesBad, rowsOnDisk;
+    uint64_t acksDropped, keyRequests;
+    bool acked;
+};
+
+// Share of the run the I/O thread was on a CPU
+static double ioBusy(const RunResult& r) { return r.seconds > 0 ? r.stats.ioCpuUs / (r.seconds * 1e6) : 0; }
+
+static void topicOf(char* out, size_t size, const Device& d, const char* suffix) {
+    snprintf(out, size, TOPIC_PREFIX "%s/%s", d.id, suffix);
+}
+
+static void sendFrame(Link& link, Device& d) {
+    TelemetryFrame f;
+    memset(&f, 0, sizeof(f));
+    f.seq = d.framesSent;
+    f.timestamp = 1700000000u + d.framesSent * 60u;
+    f.status.temp = 20.0f + (float)(rng() % 200) / 10.0f;
+    f.status.humidity = 40.0f;
+    f.status.lux = 50000.0f;
+    f.status.dust = (float)(rng() % 300);
+    f.status.efficiency = 95.0f;
+    f.status.soiling = NAN;
+    f.status.mode = MODE_DAY;
+    f.bank.channels = 1;
+    uint8_t frame[TELEMETRY_FRAME_MAX_SIZE];
+    size_t n = encodeTelemetryFrame(f, frame, sizeof(frame));
+    char topic[64];
+    topicOf(topic, sizeof(topic), d, TOPIC_FRAME);
+    link.publish(topic, nullptr, 0, frame, n, 0);
+    d.framesSent++;
+}
+
+static void sendControl(Link& link, const Device& d, const char* json) {
+    char topic[64];
+    topicOf(topic, sizeof(topic), d, TOPIC_CAM_CTRL);
+    link.publish(topic, nullptr, 0, (const uint8_t*)json, strlen(json), 1);
+}
+
+static void startImage(Fleet& fleet, Link& link, uint32_t index) {
+    Device& d = fleet.device[index];
+    uint16_t imageId = (uint16_t)(d.imagesDone + 1);
+    d.size = BENCH_IMAGE_MIN + rng() % (BENCH_IMAGE_MAX - BENCH_IMAGE_MIN + 1);
+    uint16_t count = (uint16_t)((d.size + BENCH_CHUNK - 1) / BENCH_CHUNK);
+    fillImage(index, imageId, &fleet.scratch[0], d.size);
+    uint32_t crc = crc32(&fleet.scratch[0], d.size);
+    fleet.crc[(size_t)index * fleet.images + d.imagesDone] = crc;
+    char json[160];
+    snprintf(json, sizeof(json), "{\"status\":\"start\",\"id\":%u,\"size\":%lu,\"chunks\":%u,\"chunk_size\":%u,\"crc\":%lu}",
+             (unsigned)imageId, (unsigned long)d.size, (unsigned)count, (unsigned)BENCH_CHUNK, (unsigned long)crc);
+    sendControl(link, d, json);
+    imageSenderStart(d.tx, imageId, count);
+    d.uploading = true;
+    d.startNs = benchNowNs();
+    fleet.active++;
+}
+
+// One step of a device: its next chunk, the END once every chunk is
+// ACKed, a new upload when a place is free; a frame now and then.
+// True if it sent something.
+static bool stepDevice(Fleet& fleet, Link& link, uint32_t index, uint32_t now) {
+    Device& d = fleet.device[index];
+    bool sent = false;
+    if (d.framesSent < fleet.frames && rng() % 4 == 0) {
+        sendFrame(link, d);
+        sent = true;
+    }
+    if (!d.uploading) {
+        if (d.imagesDone < fleet.images && fleet.active < fleet.uploads) {
+            startImage(fleet, link, index);
+            sent = true;
+        }
+    } else if (imageSenderDone(d.tx)) {
+        fleet.latencyMs.add((benchNowNs() - d.startNs) / 1e6);
+        char json[128];
+        snprintf(json, sizeof(json), "{\"status\":\"end\",\"id\":%u,\"chunks\":%u,\"resent\":%lu,\"ms\":%lu}",
+                 (unsigned)d.tx.imageId, (unsigned)d.tx.count, (unsigned long)d.tx.resent,
+                 (unsigned long)((benchNowNs() - d.startNs) / 1000000));
+        sendControl(link, d, json);
+        d.uploading = false;
+        d.imagesDone++;
+        fleet.active--;
+        sent = true;
+    } else {
+        int chunk = imageSenderNext(d.tx, now);
+        if (chunk >= 0) {
+            uint32_t offset = (uint32_t)chunk * BENCH_CHUNK;
+            uint32_t len = d.size - offset < BENCH_CHUNK ? d.size - offset : BENCH_CHUNK;
+            fillImage(index, d.tx.imageId, &fleet.scratch[0], offset + len);
+            ImageChunkHeader h;
+            h.flags = (d.tx.state[chunk] & IMG_STATE_SENT) ? IMG_CHUNK_FLAG_RESEND : 0;
+            h.imageId = d.tx.imageId;
+            h.index = (uint16_t)chunk;
+            h.count = d.tx.count;
+            h.crc = crc32(&fleet.scratch[offset], len);
+            uint8_t header[IMG_CHUNK_HEADER_SIZE];
+            encodeImageChunkHeader(h, header, sizeof(header));
+            if ((long)(rng() % 100) >= fleet.loss) {
+                char topic[64];
+                topicOf(topic, sizeof(topic), d, TOPIC_CAM_DATA);
+                link.publish(topic, header, sizeof(header), &fleet.scratch[offset], len, 0);
+            }
+            imageSenderSent(d.tx, (uint16_t)chunk, now);
+            sent = true;
+        }
+    }
+    if (!d.uploading && d.imagesDone == fleet.images && d.framesSent == fleet.frames) fleet.finished++;
+    return sent;
+}
+
+static Device* deviceOf(Fleet& fleet, const MqttPublish& m) {
+    const char* id = m.topic + sizeof(TOPIC_PREFIX) - 1;
+    if (m.topicLen < sizeof(TOPIC_PREFIX) + 2 || id[0] != 's' || id[1] != 't') return nullptr;
+    unsigned long index = strtoul(id + 2, nullptr, 10);
+    return index < fleet.device.size() ? &fleet.device[index] : nullptr;
+}
+
+static bool endsWith(const MqttPublish& m, const char* suffix) {
+    size_t n = strlen(suffix);
+    return m.topicLen > n && memcmp(m.topic + m.topicLen - n, suffix, n) == 0;
+}
+
+// Packets from the collector
+static bool brokerReceive(Fleet& fleet, Link& link) {
+    for (;;) {
+        ssize_t n = recv(link.fd, &link.rx[link.rxLen], link.rx.size() - link.rxLen, 0);
+        if (n == 0) return false;
+        if (n < 0) return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+        link.rxLen += (size_t)n;
+        size_t at = 0;
+        MqttPacket p;
+        size_t total;
+        while (mqttFrame(&link.rx[at], link.rxLen - at, &p, &total) == 1 && total <= link.rxLen - at) {
+            uint8_t* out;
+            switch (p.type) {
+                case MQTT_PACKET_CONNECT:
+                    if ((out = link.reserve(5))) {
+                        const uint8_t connack[] = {0x20, 3, 0, 0, 0};
+                        memcpy(out, connack, sizeof(connack));
+                        link.txTail += sizeof(connack);
+                    }
+                    break;
+                case MQTT_PACKET_SUBSCRIBE:
+                    if (p.len >= 2 && (out = link.reserve(7))) {
+                        const uint8_t suback[] = {0x90, 5, p.body[0], p.body[1], 0, 1, 1};
+                        memcpy(out, suback, sizeof(suback));
+                        link.txTail += sizeof(suback);
+                        link.subscribed = true;
+                    }
+                    break;
+                case MQTT_PACKET_PUBACK:
+                    link.pubacks++;
+                    break;
+                case MQTT_PACKET_PINGREQ:
+                    if ((out = link.reserve(2))) link.txTail += mqttEncodeEmpty(out, 2, MQTT_PACKET_PINGRESP);
+                    break;
+                case MQTT_PACKET_PUBLISH: {
+                    MqttPublish m;
+                    Device* d = mqttParsePublish(p, &m) ? deviceOf(fleet, m) : nullptr;
+                    if (!d) break;
+                    if (endsWith(m, TOPIC_CAM_REQ)) {
+                        link.keyRequests++;
+                    } else if ((long)(rng() % 100) < fleet.loss) {
+                        link.acksDropped++;
+                    } else {
+                        link.acks++;
+                        imageSenderApplyAck(d->tx, m.payload, m.len);
+                    }
+                    break;
+                }
+                default:
+                    break;
+            }
+            at += total;
+        }
+        memmove(&link.rx[0], &link.rx[at], link.rxLen - at);
+        link.rxLen -= at;
+    }
+}
+
+static bool brokerSend(Link& link) {
+    while (link.pending()) {
+        ssize_t n = send(link.fd, &link.tx[link.txHead], link.pending(), MSG_NOSIGNAL);
+        if (n > 0) {
+            link.txHead += (size_t)n;
+        } else {
+            return n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR);
+        }
+    }
+    return true;
+}
+
+static void removeTree(const char* path) {
+    DIR* dir = opendir(path);
+    if (dir) {
+        struct dirent* e;
+        while ((e = readdir(dir))) {
+            if (!strcmp(e->d_name, ".") || !strcmp(e->d_name, "..")) continue;
+            char child[512];
+            snprintf(child, sizeof(child), "%s/%s", path, e->d_name);
+            struct stat st;
+            if (lstat(child, &st) == 0 && S_ISDIR(st.st_mode)) {
+                removeTree(child);
+            } else {
+                unlink(child);
+            }
+        }
+        closedir(dir);
+    }
+    rmdir(path);
+}
+
+static bool readFile(const char* path, std::vector<uint8_t>& out) {
+    out.clear();
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return false;
+    uint8_t buf[65536];
+    ssize_t n;
+    while ((n = read(fd, buf, sizeof(buf))) > 0) out.insert(out.end(), buf, buf + n);
+    close(fd);
+    return n == 0;
+}
+
+// Every image file against the CRC sent for its device and id; rows in
+// the telemetry files (headers not counted)
+static void verifyDisk(Fleet& fleet, const char* dir, RunResult& r) {
+    std::vector<uint8_t> seen(fleet.crc.size(), 0);
+    std::vector<uint8_t> data;
+    char path[512];
+    for (long d = 0; d < fleet.devices; d++) {
+        snprintf(path, sizeof(path), "%s/%s", dir, fleet.device[d].id);
+        DIR* dev = opendir(path);
+        if (!dev) continue;
+        struct dirent* e;
+        while ((e = readdir(dev))) {
+            const char* dash = strchr(e->d_name, '-');
+            if (!dash || !strstr(dash, ".jpg")) continue;
+            unsigned long id = strtoul(dash + 1, nullptr, 10);
+            char file[sizeof(path) + 256];
+            snprintf(file, sizeof(file), "%s/%s", path, e->d_name);
+            size_t slot = (size_t)d * fleet.images + id - 1;
+            if (id >= 1 && id <= (unsigned long)fleet.images && readFile(file, data) && !data.empty() &&
+                crc32(&data[0], data.size()) == fleet.crc[slot] && !seen[slot]) {
+                seen[slot] = 1;
+                r.imagesOk++;
+            } else {
+                r.imagesBad++;
+            }
+        }
+        closedir(dev);
+    }
+    for (int w = 0; w < r.workers; w++) {
+        snprintf(path, sizeof(path), "%s/telemetry-%d.csv", dir, w);
+        if (!readFile(path, data)) continue;
+        uint64_t lines = (uint64_t)std::count(data.begin(), data.end(), (uint8_t)'\n');
+        r.rowsOnDisk += lines ? lines - 1 : 0;
+    }
+}
+
+static RunResult runFleet(long devices, long images, long frames, long loss, long uploads, int workers) {
+    RunResult r;
+    memset(&r, 0, sizeof(r));
+    r.workers = workers;
+
+    Fleet fleet;
+    fleet.devices = devices;
+    fleet.images = images;
+    fleet.frames = frames;
+    fleet.loss = loss;
+    fleet.uploads = uploads;
+    fleet.device.resize(devices);
+    fleet.crc.assign((size_t)devices * images, 0);
+    fleet.scratch.resize(BENCH_IMAGE_MAX);
+    fleet.latencyMs.reserve((size_t)devices * images);
+    fleet.active = fleet.finished = 0;
+    fleet.cursor = 0;
+    for (long i = 0; i < devices; i++) {
+        memset(&fleet.device[i], 0, sizeof(Device));
+        snprintf(fleet.device[i].id, sizeof(fleet.device[i].id), "st%05u", (unsigned)i);
+    }
+
+    Link link;
+    link.rx.resize(1 << 20);
+    link.tx.resize(4 << 20);
+    link.rxLen = link.txHead = link.txTail = 0;
+    link.subscribed = false;
+    link.nextId = 1;
+    link.qos1Sent = link.pubacks = link.acks = link.acksDropped = link.keyRequests = 0;
+
+    int listener = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t addrLen = sizeof(addr);
+    if (listener < 0 || bind(listener, (sockaddr*)&addr, sizeof(addr)) != 0 || listen(listener, 1) != 0 ||
+        getsockname(listener, (sockaddr*)&addr, &addrLen) != 0) {
+        benchCheck(false, "loopback listener");
+        if (listener >= 0) close(listener);
+        return r;
+    }
+
+    char dir[] = "/tmp/argus-collector-XXXXXX";
+    if (!mkdtemp(dir)) {
+        benchCheck(false, "output directory");
+        close(listener);
+        return r;
+    }
+    CollectorConfig config;
+    collectorDefaults(&config);
+    config.host = "127.0.0.1";
+    config.port = ntohs(addr.sin_port);
+    config.outDir = dir;
+    config.workers = (uint16_t)workers;
+    config.imageSlots = (uint16_t)uploads;      // One worker may get every upload
+    config.imageBytes = BENCH_IMAGE_MAX;
+    config.ringBytes = 1 << 20;
+    if (!collectorBegin(config)) {
+        benchCheck(false, "collectorBegin");
+        close(listener);
+        removeTree(dir);
+        return r;
+    }
+    BenchAllocDelta allocs;
+
+    pollfd pl = {listener, POLLIN, 0};
+    link.fd = poll(&pl, 1, 5000) == 1 ? accept4(listener, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC) : -1;
+    close(listener);
+    bool ok = link.fd >= 0;
+    uint64_t t0 = benchNowNs();
+    uint64_t deadline = t0 + (uint64_t)BENCH_TIMEOUT_S * 1000000000ull;
+    uint64_t expectedImages = (uint64_t)devices * images;
+    uint64_t expectedRows = (uint64_t)devices * frames;
+    while (ok && benchNowNs() < deadline) {
+        ok = brokerReceive(fleet, link);
+        bool sent = false;
+        if (ok && link.subscribed && fleet.finished < devices) {
+            uint32_t now = wallMs();
+            fleet.finished = 0;
+            for (long i = 0; i < devices && link.pending() < BENCH_TX_HIGH; i++) {
+                sent |= stepDevice(fleet, link, fleet.cursor, now);
+                fleet.cursor = (uint32_t)((fleet.cursor + 1) % devices);
+            }
+            if (link.pending() >= BENCH_TX_HIGH) fleet.finished = 0;    // Not a full round
+        }
+        ok = ok && brokerSend(link);
+        CollectorStats s = collectorStats();
+        if (fleet.finished == devices && !link.pending() && link.pubacks == link.qos1Sent &&
+            s.images >= expectedImages && s.rows >= expectedRows) {
+            break;
+        }
+        pollfd pfd = {link.fd, (short)(POLLIN | (link.pending() ? POLLOUT : 0)), 0};
+        if (!sent || link.pending() >= BENCH_TX_HIGH) poll(&pfd, 1, 2);
+    }
+    r.seconds = (benchNowNs() - t0) / 1e9;
+    r.stats = collectorStats();
+    r.allocs = allocs.allocs();
+    r.acked = link.pubacks == link.qos1Sent && link.qos1Sent > 0;
+    r.acksDropped = link.acksDropped;
+    r.keyRequests = link.keyRequests;
+    r.p50Ms = fleet.latencyMs.percentile(50);
+    r.p99Ms = fleet.latencyMs.percentile(99);
+    collectorEnd();
+    if (link.fd >= 0) close(link.fd);
+
+    verifyDisk(fleet, dir, r);
+    removeTree(dir);
+    benchCheck(ok && fleet.finished == devices, "fleet did not finish (connection lost or timed out)");
+    benchCheck(r.imagesOk == expectedImages && !r.imagesBad, "image missing or corrupted on disk");
+    benchCheck(r.rowsOnDisk == expectedRows, "telemetry rows missing");
+    benchCheck(r.acked, "QoS 1 message not acknowledged");
+    benchCheck(r.allocs == 0, "collector thread allocated after collectorBegin()");
+    return r;
+}
+
+int main(int argc, char** argv) {
+    long devices = benchArg(argc, argv, "--devices", 2000);
+    long images = benchArg(argc, argv, "--images", 2);
+    long frames = benchArg(argc, argv, "--frames", 8);
+    long loss = benchArg(argc, argv, "--loss", 5);
+    long uploads = benchArg(argc, argv, "--uploads", 256);
+    long workers = benchArg(argc, argv, "--workers", 4);
+    double minSpeedup = atof(benchArgStr(argc, argv, "--min-speedup", "1.2"));
+    bool json = benchHasFlag(argc, argv, "--json");
+    if (devices < 1 || devices > 99999 || images < 1 || images > 1000 || uploads < 1 || uploads > 4096 ||
+        workers < 1 || workers > COLLECTOR_MAX_WORKERS) {
+        fprintf(stderr, "bad arguments\n");
+        return 2;
+    }
+
+    // Everything on this thread is the broker and the devices: only the
+    // collector's threads are counted
+    HostAllocPause pause;
+    std::vector<RunResult> runs;
+    runs.push_back(runFleet(devices, images, frames, loss, uploads, 1));
+    if (workers > 1) runs.push_back(runFleet(devices, images, frames, loss, uploads, (int)workers));
+    unsigned cores = std::thread::hardware_concurrency();
+    double speedup = runs.size() > 1 && runs[0].stats.messages && runs[1].seconds > 0
+                         ? (runs[1].stats.messages / runs[1].seconds) / (runs[0].stats.messages / runs[0].seconds)
+                         : 1;
+    double ioCeiling = ioBusy(runs[0]) > 0 ? runs[0].stats.messages / runs[0].seconds / ioBusy(runs[0]) : 0;
+    bool speedupChecked = runs.size() > 1 && cores > 2;
+    if (speedupChecked) benchCheck(speedup >= minSpeedup, "more workers did not raise msg/s");
+
+    if (json) {
+        printf("{\"bench\":\"collector\",\"devices\":%ld,\"images\":%ld,\"frames\":%ld,\"loss\":%ld,\"runs\":[",
+               devices, images, frames, loss);
+        for (size_t i = 0; i < runs.size(); i++) {
+            const RunResult& r = runs[i];
+            printf("%s{\"workers\":%d,\"seconds\":%.2f,\"msg_per_s\":%.0f,\"mb_per_s\":%.1f,\"images_per_s\":%.0f,"
+                   "\"latency_p50_ms\":%.1f,\"latency_p99_ms\":%.1f,\"duplicates\":%llu,\"slot_waits\":%llu,"
+                   "\"ring_waits\":%llu,\"io_busy\":%.2f,\"worker_cpu_s\":%.2f,\"acks\":%llu,\"images_ok\":%llu,"
+                   "\"rows\":%llu,\"allocs\":%llu}",
+                   i ? "," : "", r.workers, r.seconds, r.stats.messages / r.seconds,
+                   r.stats.bytes / r.seconds / 1e6, r.stats.images / r.seconds, r.p50Ms, r.p99Ms,
+                   (unsigned long long)r.stats.duplicates, (unsigned long long)r.stats.slotWaits,
+                   (unsigned long long)r.stats.ringWaits, ioBusy(r), r.stats.workerCpuUs / 1e6,
+                   (unsigned long long)r.stats.acks, (unsigned long long)r.imagesOk, (unsigned long long)r.rowsOnDisk,
+                   (unsigned long long)r.allocs);
+        }
+        printf("],\"cores\":%u,\"speedup\":%.2f,\"speedup_checked\":%s,\"io_ceiling_msg_per_s\":%.0f,"
+               "\"failures\":%d}\n", cores, speedup, speedupChecked ? "true" : "false", ioCeiling, benchFailures());
+    } else {
+        printf("ArgoS collector benchmark (%ld devices, %ld images and %ld frames each, %ld %% loss, %ld uploads "
+               "at once)\n", devices, images, frames, loss, uploads);
+        printf("  workers     msg/s    MB/s  images/s  latency p50/p99 ms  duplicates  slot waits  ring waits  I/O busy"
+               "  allocs\n");
+        for (size_t i = 0; i < runs.size(); i++) {
+            const RunResult& r = runs[i];
+            printf("  %7d  %8.0f  %6.1f  %8.0f  %8.1f / %7.1f  %10llu  %10llu  %10llu  %6.0f %%  %6llu\n", r.workers,
+                   r.stats.messages / r.seconds, r.stats.bytes / r.seconds / 1e6, r.stats.images / r.seconds,
+                   r.p50Ms, r.p99Ms, (unsigned long long)r.stats.duplicates,
+                   (unsigned long long)r.stats.slotWaits, (unsigned long long)r.stats.ringWaits, 100 * ioBusy(r),
+                   (unsigned long long)r.allocs);
+        }
+        printf("  I/O thread         ceiling about %.0f msg/s (one worker's msg/s over its busy share)\n", ioCeiling);
+        if (runs.size() > 1) {
+            printf("  speedup            %.2fx with %d workers on %u cores (%s)\n", speedup, runs[1].workers, cores,
+                   speedupChecked ? "checked" : "not checked: the bench thread needs a core of its own");
+        }
+        for (size_t i = 0; i < runs.size(); i++) {
+            const RunResult& r = runs[i];
+            printf("  disk (%d)           %llu/%ld images intact, %llu/%ld rows; %llu ACKs sent, %llu dropped, "
+                   "%llu keyframe requests\n", r.workers, (unsigned long long)r.imagesOk, devices * images,
+                   (unsigned long long)r.rowsOnDisk, devices * frames, (unsigned long long)r.stats.acks,
+                   (unsigned long long)r.acksDropped, (unsigned long long)r.keyRequests);
+        }
+        printf("  %s\n", benchFailures() ? "FAILED" : "OK");
+    }
+    return benchFailures() ? 1 : 0;
+}
@@ -0,0 +1,270 @@
+// Connection path (net_link.h, mqtt_driver.h): runs the real setup()/loop()
+// against the host stand-ins of the AP, DHCP, DNS, SNTP and a local broker.
+//
+// 1. Time to first publish (BOOT_ONLINE reaching the broker), counted from
+//    setup() without BOOT_DELAY_MS: cold start (power cycle, nothing
+//    cached), warm start (reset, cache in RTC_NOINIT_ATTR memory kept) and a stale cache
+//    (the AP moved channel: the cached join fails over to a scan). Against
+//    the old sequence, which blocked setup() on the WiFi poll, the NTP wait
+//    and a DNS check before the first loopMQTT() connected by name; here it
+//    is timed on its own, without the hardware init before it.
+//    Also the time setup() holds up sampling and the longest loop() pass
+//    until the first publish (single task: the TLS handshake runs in loop()).
+// 2. Broker outage: connect attempts and time spent in failed connects with
+//    the back-off, against a retry on every loop pass, then the time to
+//    reconnect once the broker is back.
+// 3. Lease: a lease cached with a short renewal time (T1) and joined with
+//    as a static IP is given up for DHCP once T1 has passed; the new one is
+//    cached again.
+//
+// Exits non-zero if a warm start is not faster than a cold one, the stale
+// cache does not recover, setup() blocks longer than the old sequence, the
+// back-off does not bound the attempts, the device does not come back
+// within MQTT_BACKOFF_MAX_MS (+ jitter) of the broker's return, or a cached
+// lease is used past T1.
+//
+//   .pio/build/bench_connect/program [--outage-s N] [--json]
+
+#include <Arduino.h>
+#include <WiFi.h>
+#include <WiFiClientSecure.h>
+#include "mqtt_client.h"
+#include <esp_sntp.h>
+#include "host_sim.h"
+#include "bench_util.h"
+#include "config.h"
+#include "net_link.h"
+
+void setup();
+void loop();
+
+static const uint32_t CONNECT_FAIL_MS = 2000;  // A refused connect times out after this
+static const uint32_t MAX_PASSES = 60000;      // loop() passes before a start counts as stuck
+static const uint32_t LEASE_S = 20;            // Renewal time of the leases in part 3
+
+static uint64_t firstPublishAt = 0;
+
+static void resetHost() {
+    hostReset();
+    hostSerialEcho(false);
+    firstPublishAt = 0;
+    hostBroker().addObserver([](const std::string& topic, const uint8_t* payload, size_t len) {
+        (void)topic;
+        (void)payload;
+        (void)len;
+        if (!firstPublishAt) firstPublishAt = hostClockMicros();
+    });
+}
+
+struct StartResult {
+    double firstPublishMs;      // From setup(), boot delay excluded
+    double setupMs;
+    double worstLoopMs;         // Longest loop() pass before the first publish
+    NetLinkStats link;
+};
+
+// setup(), then loop() until the broker has seen the first message. Both
+// starts are resets (no deep sleep), so both wait BOOT_DELAY_MS first.
+static StartResult start() {
+    StartResult r;
+    memset(&r, 0, sizeof(r));
+    uint64_t t0 = hostClockMicros();
+    setup();
+    r.setupMs = (hostClockMicros() - t0) / 1000.0 - BOOT_DELAY_MS;
+    for (uint32_t i = 0; i < MAX_PASSES && !firstPublishAt; i++) {
+        uint64_t before = hostClockMicros();
+        loop();
+        double passMs = (hostClockMicros() - before) / 1000.0;
+        if (passMs > r.worstLoopMs) r.worstLoopMs = passMs;
+        hostClockAdvanceMs(1);
+    }
+    r.firstPublishMs = firstPublishAt ? (firstPublishAt - t0) / 1000.0 - BOOT_DELAY_MS : -1;
+    r.link = netLinkStats();
+    return r;
+}
+
+// The sequence before this change, blocking in setup(): WiFi poll in 500 ms
+// steps, NTP wait in 500 ms steps, DNS check, then connect by name (DNS
+// again + TLS) and publish
+static WiFiClientSecure legacyNet;
+static MqttClient legacyClient(legacyNet);
+
+// PubSubClient's connect() returned with the CONNACK
+static bool legacyConnect() {
+    if (!legacyNet.connect(SECRET_MQTT_SERVER, SECRET_MQTT_PORT) ||
+        !legacyClient.connect(SECRET_MQTT_CLIENT_ID, SECRET_MQTT_USER, SECRET_MQTT_PASSWORD)) {
+        return false;
+    }
+    while (legacyClient.connecting()) {
+        legacyClient.loop();
+        delay(1);
+    }
+    return legacyClient.connected();
+}
+
+static double legacyFirstPublishMs() {
+    uint64_t t0 = hostClockMicros();
+    WiFi.config(IPAddress(), IPAddress(), IPAddress());
+    WiFi.begin(SECRET_SSID, SECRET_WIFI_PASSWORD);
+    for (int attempts = 0; WiFi.status() != WL_CONNECTED && attempts < 20; attempts++) delay(500);
+    configTime(0, 0, "pool.ntp.org", "time.nist.gov");
+    for (int retry = 0; sntp_get_sync_status() != SNTP_SYNC_STATUS_COMPLETED && retry < 20; retry++) delay(500);
+    IPAddress ip;
+    WiFi.hostByName(SECRET_MQTT_SERVER, ip);
+    legacyNet.setInsecure();
+    legacyClient.setBufferSize(MQTT_BUFFER_SIZE);
+    if (!legacyConnect()) return -1;
+    legacyClient.publish(MQTT_TOPIC(TOPIC_MODE), "BOOT_ONLINE");
+    legacyClient.loop();
+    double ms = firstPublishAt ? (firstPublishAt - t0) / 1000.0 : -1;
+    legacyClient.disconnect();
+    return ms;
+}
+
+struct OutageResult {
+    uint64_t attempts;
+    double failedConnectS;      // Time spent in connects that timed out
+    double reconnectMs;         // Broker back to connected (-1: never)
+};
+
+// Broker down for `seconds`, then back; the firmware is connected before
+static OutageResult outage(uint32_t seconds) {
+    OutageResult r;
+    hostNet().connectFailMs = CONNECT_FAIL_MS;
+    hostNet().brokerAvailable = false;
+    uint64_t refusedBefore = hostBroker().connectsRefused;
+    uint64_t end = hostClockMicros() + (uint64_t)seconds * 1000000ULL;
+    while (hostClockMicros() < end) {
+        loop();
+        hostClockAdvanceMs(1);
+    }
+    r.attempts = hostBroker().connectsRefused - refusedBefore;
+    r.failedConnectS = r.attempts * CONNECT_FAIL_MS / 1000.0;
+
+    hostNet().brokerAvailable = true;
+    uint64_t connectsBefore = hostBroker().connects;
+    uint64_t back = hostClockMicros();
+    r.reconnectMs = -1;
+    for (uint32_t i = 0; i < 4 * MQTT_BACKOFF_MAX_MS && r.reconnectMs < 0; i++) {
+        loop();
+        if (hostBroker().connects != connectsBefore) r.reconnectMs = (hostClockMicros() - back) / 1000.0;
+        hostClockAdvanceMs(1);
+    }
+    return r;
+}
+
+// Old policy: a connect on every loop pass while the broker is down
+static uint64_t legacyOutageAttempts(uint32_t seconds) {
+    hostNet().connectFailMs = CONNECT_FAIL_MS;
+    hostNet().brokerAvailable = false;
+    WiFi.config(IPAddress(), IPAddress(), IPAddress());
+    WiFi.begin(SECRET_SSID, SECRET_WIFI_PASSWORD);
+    while (WiFi.status() != WL_CONNECTED) delay(1);
+    uint64_t refusedBefore = hostBroker().connectsRefused;
+    uint64_t end = hostClockMicros() + (uint64_t)seconds * 1000000ULL;
+    while (hostClockMicros() < end) {
+        if (!legacyClient.connected()) legacyConnect();
+        hostClockAdvanceMs(1);
+    }
+    return hostBroker().connectsRefused - refusedBefore;
+}
+
+int main(int argc, char** argv) {
+    bool json = benchHasFlag(argc, argv, "--json");
+    uint32_t outageS = (uint32_t)benchArg(argc, argv, "--outage-s", 600);
+
+    // --- 1. Time to first publish ---
+    resetHost();
+    double legacyMs = legacyFirstPublishMs();
+
+    hostPowerCycle();
+    resetHost();
+    StartResult cold = start();
+
+    resetHost();
+    StartResult warm = start();
+
+    resetHost();
+    hostNet().apChannel = 11;
+    StartResult stale = start();
+
+    resetHost();
+    hostNet().apChannel = 11;
+    StartResult afterStale = start();           // Cache rebuilt by the stale start
+
+    // --- 2. Broker outage ---
+    OutageResult down = outage(outageS);
+
+    resetHost();
+    uint64_t legacyAttempts = legacyOutageAttempts(outageS);
+
+    // Doublings from MIN to MAX, then one attempt per MAX (jitter shortens nothing)
+    uint64_t boundAttempts = 1;
+    for (uint32_t b = MQTT_BACKOFF_MIN_MS; b < MQTT_BACKOFF_MAX_MS; b *= 2) boundAttempts++;
+    boundAttempts += (uint64_t)outageS * 1000 / MQTT_BACKOFF_MAX_MS + 1;
+
+    // --- 3. Lease renewal time ---
+    hostPowerCycle();
+    resetHost();
+    hostNet().leaseS = LEASE_S;
+    start();                                    // DHCP: lease cached with T1 = LEASE_S
+    resetHost();
+    hostNet().leaseS = LEASE_S;
+    StartResult leased = start();
+    for (uint32_t ms = 0; ms < (LEASE_S + 2) * 1000; ms++) {
+        loop();
+        hostClockAdvanceMs(1);
+    }
+    NetLinkStats renewed = netLinkStats();
+    resetHost();
+    hostNet().leaseS = LEASE_S;
+    StartResult released = start();
+
+    benchCheck(cold.firstPublishMs > 0 && warm.firstPublishMs > 0 && stale.firstPublishMs > 0,
+               "a start never published");
+    benchCheck(warm.link.fastJoins == 1 && warm.link.cachedBroker, "warm start did not use the cache");
+    benchCheck(cold.link.fastJoins == 0 && !cold.link.cachedBroker, "cold start used a cache (power cycle kept RTC)");
+    benchCheck(warm.firstPublishMs < cold.firstPublishMs, "warm start not faster than cold");
+    benchCheck(stale.link.fastFailed == 1 && afterStale.link.fastJoins == 1, "stale cache not replaced");
+    benchCheck(leased.link.fastJoins == 1 && renewed.leaseExpired == 1 && renewed.joins == 2 &&
+               released.link.fastJoins == 1, "cached lease used past its renewal time, or the new one not cached");
+    benchCheck(cold.setupMs < legacyMs, "setup() blocks longer than the old sequence");
+    benchCheck(down.attempts <= boundAttempts, "back-off did not bound the connect attempts");
+    benchCheck(down.reconnectMs >= 0 && down.reconnectMs <= MQTT_BACKOFF_MAX_MS * 1.25 + CONNECT_FAIL_MS,
+               "no reconnect within the back-off after the outage");
+
+    if (json) {
+        printf("{\"bench\":\"connect\",\"legacy_ms\":%.0f,\"cold_ms\":%.0f,\"warm_ms\":%.0f,\"stale_ms\":%.0f,"
+               "\"cold_setup_ms\":%.0f,\"worst_loop_ms\":%.0f,\"outage_attempts\":%llu,"
+               "\"legacy_outage_attempts\":%llu,\"reconnect_ms\":%.0f,\"lease_renewed\":%s,\"failures\":%d}\n",
+               legacyMs, cold.firstPublishMs, warm.firstPublishMs, stale.firstPublishMs, cold.setupMs,
+               cold.worstLoopMs, (unsigned long long)down.attempts, (unsigned long long)legacyAttempts,
+               down.reconnectMs, renewed.leaseExpired == 1 ? "true" : "false", benchFailures());
+        return benchFailures() ? 1 : 0;
+    }
+
+    HostNetModel net = hostNetDefaults();
+    printf("ArgoS connection benchmark (scan %u ms, assoc %u ms, DHCP %u ms, DNS %u ms, NTP %u ms, TLS %u ms)\n",
+           net.wifiScanMs, net.wifiAssocMs, net.dhcpMs, net.dnsMs, net.ntpMs, net.tlsHandshakeMs);
+    printf("  start                first publish   setup()   worst loop   WiFi join\n");
+    printf("  old sequence         %10.0f ms  %6.0f ms            -           -   (blocking, hardware init not counted)\n",
+           legacyMs, legacyMs);
+    const char* names[] = {"cold (power cycle)", "warm (cache)", "stale AP cache"};
+    StartResult* rows[] = {&cold, &warm, &stale};
+    for (int i = 0; i < 3; i++) {
+        printf("  %-20s %10.0f ms  %6.0f ms  %8.0f ms  %7u ms\n", names[i], rows[i]->firstPublishMs,
+               rows[i]->setupMs, rows[i]->worstLoopMs, (unsigned)rows[i]->link.joinMs);
+    }
+    printf("  cache               warm: AP %s, broker %s; stale: %u fallback, next start %s\n",
+           warm.link.fastJoins ? "cached" : "scanned", warm.link.cachedBroker ? "cached" : "looked up",
+           (unsigned)stale.link.fastFailed, afterStale.link.fastJoins ? "cached again" : "scanned");
+    printf("  outage %4u s       back-off: %llu attempts, %.0f s in failed connects; every pass: %llu attempts\n",
+           outageS, (unsigned long long)down.attempts, down.failedConnectS, (unsigned long long)legacyAttempts);
+    printf("  broker back         reconnected after %.0f ms (back-off max %u ms)\n", down.reconnectMs,
+           (unsigned)MQTT_BACKOFF_MAX_MS);
+    printf("  lease T1 %2u s       cached lease given up after T1: %u, DHCP joins %u; next start %s\n",
+           (unsigned)LEASE_S, (unsigned)renewed.leaseExpired, (unsigned)(renewed.joins - renewed.fastJoins),
+           released.link.fastJoins ? "cached again" : "scanned");
+    printf("%s\n", benchFailures() ? "FAILED" : "OK");
+    return benchFailures() ? 1 : 0;
+}
@@ -0,0 +1,160 @@
+// End-to-end cycle benchmark: runs the real setup()/loop() against the host
+// stand-ins for thousands of virtual day cycles and reports what one cycle
+// costs (host wall time, heap traffic, MQTT bytes, serial bytes, virtual
+// awake time).
+//
+// The run covers the image paths (cleaning triggers with real JPEG frames, so
+// delta uploads; dashboard requests) and broker outages (images queued in
+// flash, then replayed). After the first --warmup cycles (startup: first
+// connect, first keyframe) no cycle may allocate from the heap or PSRAM, and
+// the live heap must end where it was: with nothing allocated there is
+// nothing to fragment. Exits non-zero otherwise.
+//
+//   .pio/build/bench_cycle/program [--cycles N] [--trigger-every N] [--warmup N]
+//                                  [--outage-every N] [--json]
+
+#include <Arduino.h>
+#include "host_sim.h"
+#include "bench_util.h"
+#include "config.h"
+#include "core.h"
+#include <vector>
+
+void setup();
+void loop();
+
+// A panel-like VGA frame with a dark square that moves with n: a few changed
+// tiles from one trigger to the next
+static void setPanelFrame(long n) {
+    HostAllocPause pause;
+    static std::vector<uint8_t> rgb(640 * 480 * 3);
+    for (int y = 0; y < 480; y++) {
+        for (int x = 0; x < 640; x++) {
+            uint8_t* p = &rgb[((size_t)y * 640 + x) * 3];
+            bool cell = ((x / 80) + (y / 60)) % 2 == 0;
+            p[0] = (uint8_t)(40 + y / 8);
+            p[1] = (uint8_t)(60 + x / 16);
+            p[2] = (uint8_t)(cell ? 150 : 120);
+        }
+    }
+    int sx = (int)(n * 48 % 560), sy = (int)(n * 32 % 400);
+    for (int y = sy; y < sy + 64; y++) {
+        for (int x = sx; x < sx + 64; x++) memset(&rgb[((size_t)y * 640 + x) * 3], 10, 3);
+    }
+    std::vector<uint8_t> jpeg = hostJpegEncode(&rgb[0], 640, 480, 80);
+    hostCameraSetFrame(&jpeg[0], jpeg.size());
+}
+
+int main(int argc, char** argv) {
+    long cycles = benchArg(argc, argv, "--cycles", 5000);
+    long triggerEvery = benchArg(argc, argv, "--trigger-every", 250);
+    long warmup = benchArg(argc, argv, "--warmup", 50);
+    long outageEvery = benchArg(argc, argv, "--outage-every", 1000);
+    long outageCycles = 60;             // 10 minutes without the broker
+    long requestEvery = 97;
+    bool json = benchHasFlag(argc, argv, "--json");
+
+    hostReset();
+    hostSerialEcho(false);
+    setPanelFrame(0);
+
+    HostEnvironment& env = hostEnv();
+    env.lux = 20000.0f;
+    env.temp = 31.0f;
+    env.humidity = 70.0f;
+    env.dust = 60.0f;
+
+    setup();
+
+    BenchSeries wallNs;
+    BenchSeries awakeMs;
+    wallNs.reserve(cycles);
+    awakeMs.reserve(cycles);
+    uint64_t allocs = 0;
+    uint64_t allocBytes = 0;
+    uint64_t imageCycles = 0;
+    uint64_t outages = 0;
+    HostAllocStats steadyStart = {};
+
+    HostBroker& broker = hostBroker();
+    uint64_t msgStart = broker.messagesPublished;
+    uint64_t bytesStart = broker.bytesPublished;
+    uint64_t serialStart = hostSerialBytesOut();
+
+    for (long i = 0; i < cycles; i++) {
+        // Periodically create cleaning conditions to exercise the image path
+        bool trigger = triggerEvery > 0 && (i % triggerEvery) == triggerEvery - 1;
+        env.dust = trigger ? 220.0f : 60.0f + (float)(i % 40);
+        env.humidity = trigger ? 40.0f : 70.0f;
+        if (trigger) {
+            setDaysSinceClean(DAYS_BETWEEN_CLEAN);
+            setPanelFrame(i / triggerEvery);
+            imageCycles++;
+        }
+        long phase = outageEvery > 0 ? i % outageEvery : -1;
+        if (phase == outageEvery - outageCycles) outages++;
+        hostNet().brokerAvailable = phase < outageEvery - outageCycles;
+        if (i % requestEvery == requestEvery - 1) {
+            HostAllocPause pause;   // The dashboard's side
+            hostBroker().publishToDevice(MQTT_TOPIC(TOPIC_CAM_REQ), (const uint8_t*)"now", 3);
+        }
+        if (i == warmup) steadyStart = hostAllocStats();
+
+        hostClockAdvanceMs(INTERVAL_DAY + 1);
+        uint64_t virtStart = hostClockMicros();
+        BenchAllocDelta heap;
+        uint64_t t0 = benchNowNs();
+        loop();
+        uint64_t t1 = benchNowNs();
+        allocs += heap.allocs();
+        allocBytes += heap.bytes();
+        wallNs.add((double)(t1 - t0));
+        awakeMs.add((hostClockMicros() - virtStart) / 1000.0);
+    }
+
+    HostAllocStats end = hostAllocStats();
+    uint64_t steadyAllocs = 0, steadyPsram = 0;
+    int64_t liveGrowth = 0;
+    bool ok = cycles > warmup;
+    if (ok) {
+        steadyAllocs = end.allocs - steadyStart.allocs;
+        steadyPsram = end.psramAllocs - steadyStart.psramAllocs;
+        liveGrowth = (end.liveBytes - steadyStart.liveBytes) + (end.psramLiveBytes - steadyStart.psramLiveBytes);
+        ok = steadyAllocs == 0 && steadyPsram == 0 && liveGrowth == 0;
+    }
+
+    double n = (double)cycles;
+    double msgs = (broker.messagesPublished - msgStart) / n;
+    double bytes = (broker.bytesPublished - bytesStart) / n;
+    double serial = (hostSerialBytesOut() - serialStart) / n;
+
+    if (json) {
+        printf("{\"bench\":\"cycle\",\"cycles\":%ld,\"image_cycles\":%llu,"
+               "\"wall_ns_mean\":%.0f,\"wall_ns_p50\":%.0f,\"wall_ns_p99\":%.0f,\"wall_ns_max\":%.0f,"
+               "\"allocs_per_cycle\":%.2f,\"alloc_bytes_per_cycle\":%.1f,"
+               "\"msgs_per_cycle\":%.2f,\"mqtt_bytes_per_cycle\":%.1f,\"serial_bytes_per_cycle\":%.1f,"
+               "\"awake_ms_mean\":%.2f,\"awake_ms_p99\":%.2f,\"outages\":%llu,\"steady_allocs\":%llu,"
+               "\"steady_psram_allocs\":%llu,\"live_growth_bytes\":%lld,\"ok\":%s}\n",
+               cycles, (unsigned long long)imageCycles,
+               wallNs.mean(), wallNs.percentile(50), wallNs.percentile(99), wallNs.max(),
+               allocs / n, allocBytes / n, msgs, bytes, serial,
+               awakeMs.mean(), awakeMs.percentile(99), (unsigned long long)outages,
+               (unsigned long long)steadyAllocs, (unsigned long long)steadyPsram, (long long)liveGrowth,
+               ok ? "true" : "false");
+        return ok ? 0 : 1;
+    }
+
+    printf("ArgoS cycle benchmark (%ld day cycles, %llu with image upload)\n", cycles,
+           (unsigned long long)imageCycles);
+    printf("  wall time / cycle   mean %8.0f ns  p50 %8.0f ns  p99 %8.0f ns  max %8.0f ns\n",
+           wallNs.mean(), wallNs.percentile(50), wallNs.percentile(99), wallNs.max());
+    printf("  heap / cycle        %8.2f allocs  %10.1f bytes\n", allocs / n, allocBytes / n);
+    printf("  mqtt / cycle        %8.2f msgs    %10.1f bytes\n", msgs, bytes);
+    printf("  serial / cycle      %10.1f bytes\n", serial);
+    printf("  awake (virtual)     mean %8.2f ms  p99 %8.2f ms\n", awakeMs.mean(), awakeMs.percentile(99));
+    printf("  after %ld startup cycles (%llu outages): %llu heap allocs, %llu PSRAM allocs, live %+lld bytes\n",
+           warmup, (unsigned long long)outages, (unsigned long long)steadyAllocs, (unsigned long long)steadyPsram,
+           (long long)liveGrowth);
+    printf("%s\n", ok ? "OK" : "FAILED: allocates after startup");
+    return ok ? 0 : 1;
+}
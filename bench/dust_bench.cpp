@@ -0,0 +1,264 @@
+// Dust sampler benchmark: the background GP2Y1010 sampler against a simulated
+// Vo waveform (output peaking ~280 us into the LED pulse, ADC noise, EMI
+// spikes). Reports pulse timing (LED edges, read offset, rate), filter error
+// of the mean / median / outlier-rejected mean, step response, other rates,
+// reads with the esp_timer task held off, and the day cycle time spent on
+// dust against the blocking reads it replaced. Exits non-zero if a pulse is
+// off the datasheet timing, an on-time read is dropped, a late one is kept,
+// the filtered value misses the truth, or sampling allocates.
+//
+//   .pio/build/bench_dust/program [--seconds N] [--spikes PERMILLE] [--json]
+
+#include <Arduino.h>
+#include <math.h>
+#include "host_sim.h"
+#include "bench_util.h"
+#include "config.h"
+#include "dust_sampler.h"
+
+static float truthDust = 80.0f;        // ug/m3 the waveform encodes
+static uint32_t spikePermille = 20;
+static uint32_t rng = 0x9E3779B9;
+
+static uint32_t nextRandom() {
+    rng ^= rng << 13;
+    rng ^= rng >> 17;
+    rng ^= rng << 5;
+    return rng;
+}
+
+static float gaussian() {
+    float sum = 0;
+    for (int i = 0; i < 6; i++) sum += (nextRandom() & 0xFFFF) / 65535.0f;
+    return (sum - 3.0f) * 1.414f;
+}
+
+// Vo while the IR LED is on: dark level rising to the dust voltage, peaking
+// at 280 us (+-60 us to ~37 %), 10 mV of noise and, now and then, a +1.2 V
+// spike (WiFi TX burst coupling into the analog line). LED off: dark level.
+static uint16_t waveform(uint8_t pin, uint64_t nowMicros) {
+    if (pin != DUST_VO_PIN) return 0;
+    float volts = 0.1f;
+    if (hostPinLevel(DUST_LED_PIN) == LOW) {
+        float lit = (float)(nowMicros - hostPinChangedAtMicros(DUST_LED_PIN));
+        float peak = (truthDust / (1000.0f * DUST_CALIB) + 0.1f) / 0.17f;
+        float shape = expf(-((lit - 280.0f) / 60.0f) * ((lit - 280.0f) / 60.0f));
+        volts += (peak - 0.1f) * shape;
+    }
+    volts += 0.010f * gaussian();
+    if (nextRandom() % 1000 < spikePermille) volts += 1.2f;
+    int raw = (int)(volts * 4095.0f / 3.3f + 0.5f);
+    return (uint16_t)(raw < 0 ? 0 : (raw > 4095 ? 4095 : raw));
+}
+
+// LED edges seen by polling the pin every POLL_US
+struct PulseTiming {
+    uint32_t pulses;
+    BenchSeries widthUs;
+    BenchSeries periodUs;
+};
+
+static const uint64_t POLL_US = 50;
+
+static void runPolled(uint64_t micros, PulseTiming* timing) {
+    uint64_t lastEdge = hostPinChangedAtMicros(DUST_LED_PIN);
+    uint64_t lastOn = 0;
+    uint64_t end = hostClockMicros() + micros;
+    while (hostClockMicros() < end) {
+        hostClockAdvanceMicros(POLL_US);
+        uint64_t edge = hostPinChangedAtMicros(DUST_LED_PIN);
+        if (!timing || edge == lastEdge) continue;
+        lastEdge = edge;
+        if (hostPinLevel(DUST_LED_PIN) == LOW) {
+            if (lastOn) timing->periodUs.add((double)(edge - lastOn));
+            lastOn = edge;
+            timing->pulses++;
+        } else if (lastOn) {
+            timing->widthUs.add((double)(edge - lastOn));
+        }
+    }
+}
+
+// Reference: the blocking readDustSensorSmooth() this sampler replaced, as the
+// day cycle called it (5-read moving average, 6 calls 20 ms apart)
+static float legacyReadings[5];
+static int legacyIndex = 0;
+
+static float legacyReadDust() {
+    digitalWrite(DUST_LED_PIN, LOW);
+    delayMicroseconds(280);
+    int adc = analogRead(DUST_VO_PIN);
+    delayMicroseconds(40);
+    digitalWrite(DUST_LED_PIN, HIGH);
+    delayMicroseconds(9680);
+    legacyReadings[legacyIndex] = dustDensityFromAdc((uint16_t)adc);
+    legacyIndex = (legacyIndex + 1) % 5;
+    float sum = 0;
+    for (int i = 0; i < 5; i++) sum += legacyReadings[i];
+    return sum / 5;
+}
+
+static float legacyDayCycleDust() {
+    for (int k = 0; k < 5; k++) {
+        legacyReadDust();
+        delay(20);
+    }
+    return legacyReadDust();
+}
+
+static double relError(float value) { return fabs(value - truthDust) / truthDust * 100.0; }
+
+int main(int argc, char** argv) {
+    long seconds = benchArg(argc, argv, "--seconds", 60);
+    spikePermille = (uint32_t)benchArg(argc, argv, "--spikes", 20);
+    bool json = benchHasFlag(argc, argv, "--json");
+
+    hostReset();
+    hostSerialEcho(false);
+    hostSetAdcSource(waveform);
+    analogReadResolution(12);
+    int failures = 0;
+
+    // --- 1. Pulse timing at DUST_SAMPLE_HZ, steady dust with spikes ---
+    truthDust = 80.0f;
+    startDustSampler();
+    runPolled(1000000, nullptr);    // Fill the window
+    PulseTiming timing;
+    timing.pulses = 0;
+    BenchSeries meanErr, medianErr, filteredErr, rejected, readNs;
+    BenchAllocDelta heap;
+    for (long s = 0; s < seconds; s++) {
+        runPolled(1000000, &timing);
+        DustReading r;
+        uint64_t t0 = benchNowNs();
+        bool ok = readDust(&r);
+        readNs.add((double)(benchNowNs() - t0));
+        if (!ok) failures++;
+        meanErr.add(relError(r.mean));
+        medianErr.add(relError(r.median));
+        filteredErr.add(relError(r.filtered));
+        rejected.add(r.rejected);
+    }
+    uint64_t samplingAllocs = heap.allocs();
+    DustSamplerStats stats = dustSamplerStats();
+    long expectedPulses = seconds * DUST_SAMPLE_HZ;
+    if (labs((long)timing.pulses - expectedPulses) > 1) failures++;
+    if (timing.widthUs.percentile(0) != DUST_PULSE_US || timing.widthUs.max() != DUST_PULSE_US) failures++;
+    if (timing.periodUs.percentile(0) != 1000000 / DUST_SAMPLE_HZ || timing.periodUs.max() != 1000000 / DUST_SAMPLE_HZ) {
+        failures++;
+    }
+    if (stats.late || stats.samples != stats.pulses) failures++;
+    if (stats.readOffsetMinUs != DUST_READ_DELAY_US || stats.readOffsetMaxUs != DUST_READ_DELAY_US) failures++;
+    if (filteredErr.max() > 3.0) failures++;
+    if (samplingAllocs) failures++;
+
+    // --- 2. Step response: 80 -> 200 ug/m3 ---
+    truthDust = 200.0f;
+    uint64_t stepAt = hostClockMicros();
+    uint64_t settledAt = 0;
+    while (!settledAt && hostClockMicros() - stepAt < 5000000) {
+        runPolled(10000, nullptr);
+        DustReading r;
+        if (readDust(&r) && relError(r.filtered) < 5.0) settledAt = hostClockMicros();
+    }
+    double settleMs = settledAt ? (settledAt - stepAt) / 1000.0 : -1;
+    double windowMs = DUST_WINDOW * 1000.0 / DUST_SAMPLE_HZ;
+    if (!settledAt || settleMs > windowMs) failures++;
+
+    // --- 3. Other rates ---
+    const uint16_t rates[] = {20, 50, 200, 1000};
+    uint32_t ratePulses[4];
+    for (int i = 0; i < 4; i++) {
+        if (!startDustSampler(rates[i])) failures++;
+        runPolled(2000000, nullptr);
+        DustSamplerStats rs = dustSamplerStats();
+        ratePulses[i] = rs.pulses;
+        if (labs((long)rs.pulses - 2L * rates[i]) > 1 || rs.late) failures++;
+    }
+    bool rejectsTooFast = !startDustSampler(1000000 / DUST_PULSE_US);
+    if (!rejectsTooFast) failures++;
+
+    // --- 4. esp_timer task held off: reads after the LED is off are dropped ---
+    const uint32_t latencies[] = {25, 80};
+    DustSamplerStats held[2];
+    double heldErr[2];
+    for (int i = 0; i < 2; i++) {
+        hostTimerSetLatency(latencies[i]);
+        startDustSampler();
+        runPolled(10000000, nullptr);
+        held[i] = dustSamplerStats();
+        DustReading r;
+        readDust(&r);
+        heldErr[i] = relError(r.filtered);
+        if (labs((long)held[i].pulses - 10L * DUST_SAMPLE_HZ) > 10) failures++;
+    }
+    hostTimerSetLatency(0);
+    if (held[0].late || held[0].readOffsetMaxUs >= DUST_PULSE_US) failures++;
+    if (!held[1].late || !held[1].samples || held[1].readOffsetMaxUs >= DUST_PULSE_US) failures++;
+    stopDustSampler();
+
+    // --- 5. Day cycle: blocking reads vs the sampler ---
+    truthDust = 80.0f;
+    const int cycles = 1000;
+    BenchSeries legacyErr, legacyBlockMs;
+    for (int c = 0; c < cycles; c++) {
+        uint64_t v0 = hostClockMicros();
+        float dust = legacyDayCycleDust();
+        legacyBlockMs.add((hostClockMicros() - v0) / 1000.0);
+        legacyErr.add(relError(dust));
+    }
+    startDustSampler();
+    runPolled(1000000, nullptr);
+    BenchSeries samplerErr, samplerBlockMs;
+    for (int c = 0; c < cycles; c++) {
+        runPolled(100000, nullptr);
+        uint64_t v0 = hostClockMicros();
+        DustReading r;
+        readDust(&r);
+        samplerBlockMs.add((hostClockMicros() - v0) / 1000.0);
+        samplerErr.add(relError(r.filtered));
+    }
+    stopDustSampler();
+    if (samplerBlockMs.max() > 0 || samplerErr.percentile(99) >= legacyErr.percentile(99)) failures++;
+
+    if (json) {
+        printf("{\"bench\":\"dust\",\"seconds\":%ld,\"spike_permille\":%u,\"pulses\":%u,\"late\":%u,"
+               "\"read_offset_us\":[%u,%u],\"width_us\":[%.0f,%.0f],\"period_us\":[%.0f,%.0f],"
+               "\"mean_err_pct\":%.2f,\"median_err_pct\":%.2f,\"filtered_err_pct\":%.2f,\"filtered_err_max_pct\":%.2f,"
+               "\"rejected\":%.1f,\"read_ns\":%.0f,\"allocs\":%llu,\"settle_ms\":%.0f,"
+               "\"legacy_block_ms\":%.1f,\"legacy_err_p99_pct\":%.2f,\"sampler_block_ms\":%.1f,"
+               "\"sampler_err_p99_pct\":%.2f,\"late_at_%uus\":%u,\"late_at_%uus\":%u,\"failures\":%d}\n",
+               seconds, spikePermille, timing.pulses, stats.late, stats.readOffsetMinUs, stats.readOffsetMaxUs,
+               timing.widthUs.percentile(0), timing.widthUs.max(), timing.periodUs.percentile(0), timing.periodUs.max(),
+               meanErr.mean(), medianErr.mean(), filteredErr.mean(), filteredErr.max(), rejected.mean(), readNs.mean(),
+               (unsigned long long)samplingAllocs, settleMs, legacyBlockMs.mean(), legacyErr.percentile(99),
+               samplerBlockMs.mean(), samplerErr.percentile(99), latencies[0], held[0].late, latencies[1], held[1].late,
+               failures);
+    } else {
+        printf("ArgoS dust sampler benchmark (%ld s at %d Hz, %.1f %% spikes)\n", seconds, DUST_SAMPLE_HZ,
+               spikePermille / 10.0);
+        printf("  pulses             %8u (expected %ld)  late reads %u\n", timing.pulses, expectedPulses, stats.late);
+        printf("  LED on -> read     %5u..%u us   pulse width %.0f..%.0f us   period %.0f..%.0f us\n",
+               stats.readOffsetMinUs, stats.readOffsetMaxUs, timing.widthUs.percentile(0), timing.widthUs.max(),
+               timing.periodUs.percentile(0), timing.periodUs.max());
+        printf("  error vs truth     mean %6.2f %%   median %6.2f %%   filtered %6.2f %% (max %.2f %%)\n",
+               meanErr.mean(), medianErr.mean(), filteredErr.mean(), filteredErr.max());
+        printf("  outliers rejected  %6.1f of %d per window   readDust() %.0f ns host, %llu allocs\n", rejected.mean(),
+               DUST_WINDOW, readNs.mean(), (unsigned long long)samplingAllocs);
+        printf("  step 80 -> 200     settled (5 %%) in %.0f ms (window %.0f ms)\n", settleMs, windowMs);
+        printf("  rates              20 Hz %u  50 Hz %u  200 Hz %u  1000 Hz %u pulses in 2 s, %u Hz %s\n",
+               ratePulses[0], ratePulses[1], ratePulses[2], ratePulses[3], 1000000 / DUST_PULSE_US,
+               rejectsTooFast ? "rejected" : "ACCEPTED");
+        for (int i = 0; i < 2; i++) {
+            printf("  dispatch +0..%-3u us read %u..%u us, %u late of %u pulses, filtered error %.2f %%\n",
+                   latencies[i], held[i].readOffsetMinUs, held[i].readOffsetMaxUs, held[i].late, held[i].pulses,
+                   heldErr[i]);
+        }
+        printf("  day cycle          blocking reads %6.1f ms, p99 error %5.2f %%\n", legacyBlockMs.mean(),
+               legacyErr.percentile(99));
+        printf("                     sampler        %6.1f ms, p99 error %5.2f %%\n", samplerBlockMs.mean(),
+               samplerErr.percentile(99));
+        printf("%s\n", failures ? "FAIL" : "OK");
+    }
+    return failures ? 1 : 0;
+}
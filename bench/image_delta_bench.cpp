@@ -0,0 +1,360 @@
+// Delta image upload benchmark: frame sequences uploaded whole (publishImage)
+// and as deltas against a keyframe (publishFrame), through the firmware MQTT
+// client and the dashboard stand-in, which rebuilds every frame. Sequences are
+// generated VGA panels (static scene, a bird crossing, spots accumulating, a
+// shadow sweeping over) or, with --dir, a folder of recorded JPEGs in name
+// order. Reports uplink bytes, bytes-saved ratio, frame kinds, changed tiles,
+// encode cost and reconstruction PSNR, then reboots the device mid-sequence to
+// check the keyframe survives in flash. Exits non-zero if deltas cost more
+// than whole frames, the static scene saves less than 5x, a rebuilt frame is
+// below 30 dB or a reboot forces a new keyframe.
+//
+//   .pio/build/bench_image_delta/program [--dir PATH] [--frames N] [--json]
+
+#include <Arduino.h>
+#include <dirent.h>
+#include <math.h>
+#include <stdio.h>
+#include <algorithm>
+#include <string>
+#include <vector>
+#include "host_sim.h"
+#include "bench_util.h"
+#include "config.h"
+#include "mqtt_driver.h"
+#include "image_delta.h"
+
+void setup();
+extern MqttClient client;
+
+#define MIN_PSNR_DB     30.0
+#define MIN_STATIC_GAIN 5.0
+
+typedef std::vector<uint8_t> Bytes;
+
+struct Sequence {
+    std::string name;
+    std::vector<Bytes> frames;
+};
+
+struct RunResult {
+    uint64_t bytes;
+    uint32_t keyframes;
+    uint32_t deltas;
+    uint32_t unchanged;
+    uint32_t plain;
+    uint32_t tilesSent;
+    uint32_t rebuilt;           // Frames the dashboard could show
+    double psnrMin;
+    double psnrSum;
+    double encodeMsSum;
+};
+
+// --- Generated scenes ---
+
+static uint32_t rng = 0x6C8E9CF5;
+
+static uint32_t nextRandom() {
+    rng ^= rng << 13;
+    rng ^= rng >> 17;
+    rng ^= rng << 5;
+    return rng;
+}
+
+static int randomRange(int lo, int hi) { return lo + (int)(nextRandom() % (uint32_t)(hi - lo + 1)); }
+
+struct Spot {
+    int x, y, r;
+};
+
+struct Scene {
+    int cell, ox, oy;
+    float glare;
+    std::vector<Spot> spots;
+    int birdX, birdY;           // -1: no bird
+    int shadowX;                // Shadow covers x < shadowX
+};
+
+static const int W = 640;
+static const int H = 480;
+
+static Scene makeScene() {
+    Scene s;
+    s.cell = randomRange(70, 90);
+    s.ox = randomRange(0, s.cell);
+    s.oy = randomRange(0, s.cell);
+    s.glare = (float)randomRange(0, 25);
+    s.birdX = s.birdY = -1;
+    s.shadowX = 0;
+    return s;
+}
+
+static inline void blend(uint8_t* p, const uint8_t* c, float a) {
+    for (int k = 0; k < 3; k++) p[k] = (uint8_t)(p[k] + (c[k] - p[k]) * a);
+}
+
+// Same panel photo as bench_soiling, with fresh sensor noise every frame
+static Bytes render(const Scene& s) {
+    std::vector<uint8_t> rgb((size_t)W * H * 3);
+    const uint8_t spot[3] = {232, 226, 212};
+    const uint8_t bird[3] = {40, 34, 30};
+    for (int y = 0; y < H; y++) {
+        for (int x = 0; x < W; x++) {
+            uint8_t* p = &rgb[((size_t)y * W + x) * 3];
+            bool inGap = (x + s.ox) % s.cell < 4 || (y + s.oy) % s.cell < 4;
+            int base[3] = {22, 34, 78};
+            if (inGap) {
+                base[0] = 150;
+                base[1] = 152;
+                base[2] = 162;
+            }
+            int lift = (int)(s.glare * x / W) + (int)(nextRandom() % 9) - 4;
+            float shade = x < s.shadowX ? 0.55f : 1.0f;
+            for (int k = 0; k < 3; k++) p[k] = (uint8_t)std::max(0, std::min(255, (int)((base[k] + lift) * shade)));
+        }
+    }
+    for (size_t i = 0; i < s.spots.size(); i++) {
+        const Spot& sp = s.spots[i];
+        for (int y = std::max(0, sp.y - sp.r); y < std::min(H, sp.y + sp.r); y++) {
+            for (int x = std::max(0, sp.x - sp.r); x < std::min(W, sp.x + sp.r); x++) {
+                if ((x - sp.x) * (x - sp.x) + (y - sp.y) * (y - sp.y) <= sp.r * sp.r) {
+                    blend(&rgb[((size_t)y * W + x) * 3], spot, 0.9f);
+                }
+            }
+        }
+    }
+    if (s.birdX >= 0) {
+        for (int y = std::max(0, s.birdY - 18); y < std::min(H, s.birdY + 18); y++) {
+            for (int x = std::max(0, s.birdX - 30); x < std::min(W, s.birdX + 30); x++) {
+                float dx = (x - s.birdX) / 30.0f;
+                float dy = (y - s.birdY) / 18.0f;
+                if (dx * dx + dy * dy <= 1) blend(&rgb[((size_t)y * W + x) * 3], bird, 0.95f);
+            }
+        }
+    }
+    return hostJpegEncode(&rgb[0], W, H, 80);
+}
+
+static Sequence generate(const char* name, int frames) {
+    Sequence seq;
+    seq.name = name;
+    Scene scene = makeScene();
+    std::string n = name;
+    for (int i = 0; i < frames; i++) {
+        if (n == "bird") {
+            // Lands a quarter in, walks, flies off three quarters in
+            bool present = i >= frames / 4 && i < frames * 3 / 4;
+            scene.birdX = present ? 100 + (i - frames / 4) * 12 : -1;
+            scene.birdY = 220;
+        } else if (n == "soiling") {
+            for (int k = 0; k < 3; k++) {
+                Spot sp = {randomRange(0, W - 1), randomRange(0, H - 1), randomRange(4, 9)};
+                scene.spots.push_back(sp);
+            }
+        } else if (n == "shadow") {
+            scene.shadowX = i * W / frames;
+        }
+        seq.frames.push_back(render(scene));
+    }
+    return seq;
+}
+
+static bool loadFile(const std::string& path, Bytes* out) {
+    FILE* f = fopen(path.c_str(), "rb");
+    if (!f) return false;
+    fseek(f, 0, SEEK_END);
+    long n = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    out->resize(n > 0 ? (size_t)n : 0);
+    bool ok = n > 0 && fread(&(*out)[0], 1, (size_t)n, f) == (size_t)n;
+    fclose(f);
+    return ok;
+}
+
+static Sequence loadFolder(const char* dir) {
+    Sequence seq;
+    seq.name = dir;
+    DIR* d = opendir(dir);
+    if (!d) return seq;
+    std::vector<std::string> names;
+    while (dirent* e = readdir(d)) {
+        std::string lower = e->d_name;
+        std::transform(lower.begin(), lower.end(), lower.begin(), ::tolower);
+        if (lower.size() > 4 && (lower.rfind(".jpg") == lower.size() - 4 || lower.rfind(".jpeg") == lower.size() - 5)) {
+            names.push_back(e->d_name);
+        }
+    }
+    closedir(d);
+    std::sort(names.begin(), names.end());
+    for (size_t i = 0; i < names.size(); i++) {
+        Bytes jpeg;
+        if (loadFile(std::string(dir) + "/" + names[i], &jpeg)) seq.frames.push_back(jpeg);
+    }
+    return seq;
+}
+
+// --- Runs ---
+
+static uint64_t cameraBytes = 0;
+
+// What loop() does between cycles: ACKs, keyframe requests from the dashboard
+static void pump() {
+    for (int i = 0; i < 10; i++) {
+        hostClockAdvanceMs(50);
+        loopMQTT();
+        if (takeKeyframeRequest()) publishKeyframe();
+    }
+}
+
+static void boot() {
+    client.disconnect();    // A reboot drops the session
+    hostReset();
+    hostSerialEcho(false);
+    hostBroker().addObserver([](const std::string& topic, const uint8_t* payload, size_t len) {
+        if (topic == MQTT_TOPIC(TOPIC_CAM_CTRL) || topic == MQTT_TOPIC(TOPIC_CAM_DATA)) {
+            cameraBytes += topic.size() + len;
+        }
+    });
+    setup();
+    while (!client.connected() && millis() < 30000) {   // WiFi join and connect run in the background
+        loopMQTT();
+        hostClockAdvanceMs(1);
+    }
+    pump();
+}
+
+static double psnr(const Bytes& jpeg, const HostDashboardFrame& shown) {
+    std::vector<uint8_t> rgb;
+    int w, h;
+    if (!hostJpegDecode(&jpeg[0], jpeg.size(), &rgb, &w, &h) || w != shown.width || h != shown.height) return 0;
+    double se = 0;
+    for (size_t i = 0; i < rgb.size(); i++) {
+        double d = (double)rgb[i] - shown.rgb[i];
+        se += d * d;
+    }
+    double mse = se / rgb.size();
+    return mse <= 0 ? 99.0 : 10.0 * log10(255.0 * 255.0 / mse);
+}
+
+static void uploadFrame(const Bytes& jpeg, bool delta, RunResult* r) {
+    if (!delta) {
+        publishImage(&jpeg[0], jpeg.size());
+        r->plain++;
+        pump();
+        return;
+    }
+    // Encode once on its own for the device cost and the frame kind;
+    // publishFrame() repeats it
+    DeltaFrame frame;
+    uint64_t v0 = hostClockMicros();
+    bool encoded = imageDeltaEncode(&jpeg[0], jpeg.size(), &frame);
+    r->encodeMsSum += (hostClockMicros() - v0) / 1000.0;
+    if (!encoded) r->plain++;
+    else if (frame.kind == DELTA_KEYFRAME) r->keyframes++;
+    else if (frame.kind == DELTA_TILES) r->deltas++, r->tilesSent += frame.changed;
+    else r->unchanged++;
+
+    uint32_t before = hostDashboardStats().keyframes + hostDashboardStats().deltas + hostDashboardStats().unchanged;
+    publishFrame(&jpeg[0], jpeg.size());
+    pump();
+    HostDashboardStats st = hostDashboardStats();
+    if (st.keyframes + st.deltas + st.unchanged == before) return;
+    double db = psnr(jpeg, hostDashboardLastFrame());
+    r->rebuilt++;
+    r->psnrSum += db;
+    r->psnrMin = std::min(r->psnrMin, db);
+}
+
+static RunResult run(const Sequence& seq, bool delta, size_t rebootAt, uint32_t* keyframesAfterReboot) {
+    RunResult r;
+    memset(&r, 0, sizeof(r));
+    r.psnrMin = 99.0;
+    hostFlashWipe();
+    cameraBytes = 0;
+    boot();
+    for (size_t i = 0; i < seq.frames.size(); i++) {
+        if (rebootAt && i == rebootAt) {
+            uint32_t keyframesBefore = r.keyframes;
+            uint64_t bytes = cameraBytes;
+            boot();     // Flash survives, dashboard restarts too
+            cameraBytes = bytes;
+            uploadFrame(seq.frames[i], delta, &r);
+            *keyframesAfterReboot = r.keyframes - keyframesBefore;
+            continue;
+        }
+        uploadFrame(seq.frames[i], delta, &r);
+    }
+    r.bytes = cameraBytes;
+    return r;
+}
+
+int main(int argc, char** argv) {
+    const char* dir = benchArgStr(argc, argv, "--dir", nullptr);
+    long frames = benchArg(argc, argv, "--frames", 40);
+    bool json = benchHasFlag(argc, argv, "--json");
+
+    std::vector<Sequence> sequences;
+    if (dir) {
+        sequences.push_back(loadFolder(dir));
+        if (sequences[0].frames.empty()) {
+            printf("no JPEGs in %s\n", dir);
+            return 1;
+        }
+    } else {
+        const char* names[] = {"static", "bird", "soiling", "shadow"};
+        for (int i = 0; i < 4; i++) sequences.push_back(generate(names[i], (int)frames));
+    }
+
+    int failures = 0;
+    if (!json) {
+        printf("ArgoS delta image upload benchmark (%ld frames per sequence%s%s)\n", (long)sequences[0].frames.size(),
+               dir ? ", from " : ", generated VGA", dir ? dir : "");
+        printf("  sequence   whole KB  delta KB  saved   key  tiles  same  plain  tiles/delta  encode ms  PSNR min/mean\n");
+    }
+    for (size_t s = 0; s < sequences.size(); s++) {
+        const Sequence& seq = sequences[s];
+        uint32_t unused = 0;
+        RunResult whole = run(seq, false, 0, &unused);
+        RunResult delta = run(seq, true, 0, &unused);
+        double saved = delta.bytes ? (double)whole.bytes / delta.bytes : 0;
+        double psnrMean = delta.rebuilt ? delta.psnrSum / delta.rebuilt : 0;
+        bool ok = delta.bytes < whole.bytes && delta.rebuilt == seq.frames.size() && delta.psnrMin >= MIN_PSNR_DB;
+        if (seq.name == "static" && saved < MIN_STATIC_GAIN) ok = false;
+        if (!ok) failures++;
+        if (json) {
+            printf("{\"bench\":\"image_delta\",\"sequence\":\"%s\",\"frames\":%u,\"whole_bytes\":%llu,"
+                   "\"delta_bytes\":%llu,\"saved_ratio\":%.2f,\"keyframes\":%u,\"deltas\":%u,\"unchanged\":%u,"
+                   "\"plain\":%u,\"tiles_per_delta\":%.1f,\"encode_ms\":%.1f,\"psnr_min\":%.1f,\"psnr_mean\":%.1f,"
+                   "\"ok\":%s}\n",
+                   seq.name.c_str(), (unsigned)seq.frames.size(), (unsigned long long)whole.bytes,
+                   (unsigned long long)delta.bytes, saved, delta.keyframes, delta.deltas, delta.unchanged, delta.plain,
+                   delta.deltas ? (double)delta.tilesSent / delta.deltas : 0.0,
+                   delta.encodeMsSum / seq.frames.size(), delta.psnrMin, psnrMean, ok ? "true" : "false");
+        } else {
+            printf("  %-9s %9.1f %9.1f %5.1fx %5u %6u %5u %6u %12.1f %10.1f %7.1f / %.1f%s\n", seq.name.c_str(),
+                   whole.bytes / 1024.0, delta.bytes / 1024.0, saved, delta.keyframes, delta.deltas, delta.unchanged,
+                   delta.plain, delta.deltas ? (double)delta.tilesSent / delta.deltas : 0.0,
+                   delta.encodeMsSum / seq.frames.size(), delta.psnrMin, psnrMean, ok ? "" : "  !!");
+        }
+    }
+
+    // Reboot halfway through the first sequence: the keyframe comes back from
+    // flash, the restarted dashboard asks for it once
+    const Sequence& seq = sequences[0];
+    uint32_t keyframesAfterReboot = 0;
+    RunResult rebooted = run(seq, true, seq.frames.size() / 2, &keyframesAfterReboot);
+    HostDashboardStats st = hostDashboardStats();
+    bool rebootOk = keyframesAfterReboot == 0 && rebooted.rebuilt == seq.frames.size() && st.keyframeRequests <= 1;
+    if (!rebootOk) failures++;
+    if (json) {
+        printf("{\"bench\":\"image_delta\",\"sequence\":\"reboot\",\"keyframes_after_reboot\":%u,"
+               "\"keyframe_requests\":%u,\"rebuilt\":%u,\"frames\":%u,\"failures\":%d}\n",
+               keyframesAfterReboot, st.keyframeRequests, rebooted.rebuilt, (unsigned)seq.frames.size(), failures);
+    } else {
+        printf("  reboot at frame %u: %u new keyframes, %u keyframe requests, %u/%u frames rebuilt\n",
+               (unsigned)(seq.frames.size() / 2), keyframesAfterReboot, st.keyframeRequests, rebooted.rebuilt,
+               (unsigned)seq.frames.size());
+        printf("  %s\n", failures ? "FAILED" : "OK");
+    }
+    return failures ? 1 : 0;
+}
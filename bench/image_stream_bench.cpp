@@ -0,0 +1,248 @@
+// Image upload cost on the device side: the streamed publishImage() (frame
+// buffer written straight to the socket, small client buffer) against the
+// staged path it replaced (4 KB client buffer, 2 KB chunks memcpy'd into a
+// static staging buffer, then copied again into the client buffer). Frames come
+// from cameraCapture() and are released right after the upload, like loop()
+// does. Reports bytes copied, client buffer, peak heap/PSRAM, messages,
+// upload time and frame hold time. Exits non-zero if a streamed image is lost
+// or any of its payload bytes is copied.
+//
+//   .pio/build/bench_image_stream/program [--images N] [--kbps N] [--latency MS] [--json]
+
+#include <Arduino.h>
+#include <vector>
+#include "host_sim.h"
+#include "bench_util.h"
+#include "config.h"
+#include "camera_capture.h"
+#include "mqtt_driver.h"
+#include "image_transfer.h"
+#include "checksum.h"
+
+void setup();
+void callback(char* topic, byte* payload, unsigned int length);
+extern MqttClient client;
+
+// --- The staged sender, as shipped before streaming ---
+
+#define STAGED_BUFFER_SIZE  4096
+#define STAGED_CHUNK_SIZE   2048
+
+static ImageSender stagedTx;
+static uint8_t stagedChunk[IMG_CHUNK_HEADER_SIZE + STAGED_CHUNK_SIZE];
+static uint64_t stagedBytesCopied = 0;
+static uint16_t stagedImageId = 0x8000;
+
+static void stagedCallback(char* topic, byte* payload, unsigned int length) {
+    if (strcmp(topic, MQTT_TOPIC(TOPIC_CAM_ACK)) == 0) imageSenderApplyAck(stagedTx, payload, length);
+}
+
+static bool stagedPublishImage(const uint8_t* buf, size_t length) {
+    uint32_t count = (length + STAGED_CHUNK_SIZE - 1) / STAGED_CHUNK_SIZE;
+    if (count == 0 || count > IMG_MAX_CHUNKS) return false;
+    uint16_t id = stagedImageId++;
+    char json[200];
+    snprintf(json, sizeof(json),
+             "{\"status\":\"start\",\"id\":%u,\"size\":%u,\"chunks\":%u,\"chunk_size\":%d,\"crc\":%lu,"
+             "\"device\":\"%s\"}",
+             (unsigned)id, (unsigned)length, (unsigned)count, STAGED_CHUNK_SIZE, (unsigned long)crc32(buf, length),
+             SECRET_MQTT_CLIENT_ID);
+    if (!client.publish(MQTT_TOPIC(TOPIC_CAM_CTRL), json)) return false;
+
+    imageSenderStart(stagedTx, id, (uint16_t)count);
+    unsigned long lastProgress = millis();
+    uint16_t lastAcked = 0;
+    while (!imageSenderDone(stagedTx)) {
+        client.loop();
+        if (!client.connected()) return false;
+        if (stagedTx.acked != lastAcked) {
+            lastAcked = stagedTx.acked;
+            lastProgress = millis();
+        } else if (millis() - lastProgress > IMG_TRANSFER_TIMEOUT_MS) {
+            return false;
+        }
+        int index = imageSenderNext(stagedTx, millis());
+        if (index < 0) {
+            delay(1);
+            continue;
+        }
+        size_t offset = (size_t)index * STAGED_CHUNK_SIZE;
+        size_t chunkSize = length - offset;
+        if (chunkSize > STAGED_CHUNK_SIZE) chunkSize = STAGED_CHUNK_SIZE;
+        ImageChunkHeader h;
+        h.flags = (index < stagedTx.nextNew) ? IMG_CHUNK_FLAG_RESEND : 0;
+        h.imageId = id;
+        h.index = (uint16_t)index;
+        h.count = (uint16_t)count;
+        h.crc = crc32(buf + offset, chunkSize);
+        encodeImageChunkHeader(h, stagedChunk, sizeof(stagedChunk));
+        memcpy(stagedChunk + IMG_CHUNK_HEADER_SIZE, buf + offset, chunkSize);
+        stagedBytesCopied += chunkSize;
+        if (client.publish(MQTT_TOPIC(TOPIC_CAM_DATA), stagedChunk, IMG_CHUNK_HEADER_SIZE + chunkSize)) {
+            imageSenderSent(stagedTx, (uint16_t)index, millis());
+        } else {
+            delay(1);
+        }
+    }
+    stagedTx.active = false;
+    snprintf(json, sizeof(json), "{\"status\":\"end\",\"id\":%u,\"chunks\":%u,\"resent\":%u,\"ms\":0}",
+             (unsigned)id, (unsigned)count, (unsigned)stagedTx.resent);
+    client.publish(MQTT_TOPIC(TOPIC_CAM_CTRL), json);
+    client.loop();
+    return true;
+}
+
+// Payload bytes of everything except image data (no loss in this bench)
+static uint64_t controlBytes = 0;
+
+struct PathResult {
+    const char* name;
+    long frameBytes;
+    uint32_t delivered;
+    double copiedPerImage;      // Image payload bytes memcpy'd on the device
+    double controlCopied;       // START/END JSON through the client buffer
+    uint32_t clientBuffer;
+    uint32_t staticStaging;
+    int64_t heapPeak;           // Above the level before the run
+    int64_t psramPeak;
+    double messagesPerImage;
+    double uploadMs;            // Virtual, capture to release
+    double holdMaxMs;
+    double cpuUs;               // Host CPU per image
+};
+
+static PathResult runPath(const char* name, bool streamed, long frameBytes, long images) {
+    PathResult r;
+    memset(&r, 0, sizeof(r));
+    r.name = name;
+    r.frameBytes = frameBytes;
+    hostCameraSetFrameSize((size_t)frameBytes);
+    if (!streamed) {
+        client.setBufferSize(STAGED_BUFFER_SIZE);
+        client.setCallback(stagedCallback);
+        r.staticStaging = sizeof(stagedChunk);
+    }
+    r.clientBuffer = client.getBufferSize();
+
+    std::vector<uint8_t> expected;
+    {
+        HostAllocPause pause;
+        camera_fb_t* fb = cameraCapture(CAPTURE_UPLOAD);       // Powers the camera up
+        expected.assign(fb->buf, fb->buf + fb->len);
+        cameraRelease(fb);
+    }
+    hostCameraResetStats();
+    HostAllocStats before = hostAllocStats();
+    hostAllocResetPeak();
+    uint64_t copiedBefore = client.stats().bytesQueued;
+    uint64_t stagedBefore = stagedBytesCopied;
+    uint64_t messagesBefore = hostBroker().messagesPublished;
+    uint64_t controlBefore = controlBytes;
+    uint64_t cpu = 0;
+    uint64_t virt = 0;
+
+    for (long i = 0; i < images; i++) {
+        uint32_t completed = hostDashboardStats().imagesCompleted;
+        uint64_t t0 = hostClockMicros();
+        uint64_t c0 = benchNowNs();
+        camera_fb_t* fb = cameraCapture(CAPTURE_UPLOAD);
+        bool ok = streamed ? publishImage(fb->buf, fb->len) : stagedPublishImage(fb->buf, fb->len);
+        cameraRelease(fb);
+        cpu += benchNowNs() - c0;
+        virt += hostClockMicros() - t0;
+        if (ok && hostDashboardStats().imagesCompleted == completed + 1 && hostDashboardLastImage() == expected) {
+            r.delivered++;
+        }
+    }
+
+    while (!client.idle() && client.connected()) {     // Let the last END reach the broker
+        client.loop();
+        delay(1);
+    }
+
+    HostAllocStats after = hostAllocStats();
+    HostCameraStats cam = hostCameraStats();
+    // Everything but image data goes through publish(); the rest of the
+    // client's copies are image payload
+    uint64_t control = controlBytes - controlBefore;
+    uint64_t payloadCopied = (stagedBytesCopied - stagedBefore) + (client.stats().bytesQueued - copiedBefore) - control;
+    r.controlCopied = (double)control / images;
+    r.copiedPerImage = (double)payloadCopied / images;
+    r.heapPeak = after.peakLiveBytes - before.liveBytes;
+    r.psramPeak = after.psramPeakBytes - before.psramLiveBytes;
+    r.messagesPerImage = (double)(hostBroker().messagesPublished - messagesBefore) / images;
+    r.uploadMs = virt / 1000.0 / images;
+    r.holdMaxMs = cam.heldMicrosMax / 1000.0;
+    r.cpuUs = cpu / 1000.0 / images;
+
+    if (!streamed) {
+        client.setBufferSize(MQTT_BUFFER_SIZE);
+        client.setCallback(callback);
+    }
+    return r;
+}
+
+int main(int argc, char** argv) {
+    long images = benchArg(argc, argv, "--images", 20);
+    long kbps = benchArg(argc, argv, "--kbps", 1000);
+    long latency = benchArg(argc, argv, "--latency", 40);
+    bool json = benchHasFlag(argc, argv, "--json");
+
+    hostReset();
+    hostFlashWipe();
+    hostSerialEcho(false);
+    setup();
+    while (!client.connected() && millis() < 30000) {   // WiFi join and connect run in the background
+        loopMQTT();
+        hostClockAdvanceMs(1);
+    }
+    hostNet().linkLatencyMs = (uint32_t)latency;
+    hostNet().linkBytesPerMs = (uint32_t)(kbps / 8);
+    hostBroker().addObserver([](const std::string& topic, const uint8_t* payload, size_t len) {
+        if (topic != MQTT_TOPIC(TOPIC_CAM_DATA)) controlBytes += len;
+    });
+
+    // Typical VGA JPEG sizes at quality 10-15
+    const long frames[] = {16 * 1024, 32 * 1024, 48 * 1024};
+    std::vector<PathResult> results;
+    int failures = 0;
+    for (size_t f = 0; f < sizeof(frames) / sizeof(frames[0]); f++) {
+        PathResult staged = runPath("staged", false, frames[f], images);
+        PathResult streamed = runPath("streamed", true, frames[f], images);
+        if (staged.delivered != (uint32_t)images) failures++;
+        if (streamed.delivered != (uint32_t)images) failures++;
+        if (streamed.copiedPerImage != 0 || streamed.heapPeak > 0 || streamed.psramPeak > 0) failures++;
+        if (streamed.clientBuffer != MQTT_BUFFER_SIZE) failures++;
+        results.push_back(staged);
+        results.push_back(streamed);
+    }
+
+    if (json) {
+        printf("{\"bench\":\"image_stream\",\"kbps\":%ld,\"latency_ms\":%ld,\"images\":%ld,\"runs\":[", kbps, latency,
+               images);
+        for (size_t i = 0; i < results.size(); i++) {
+            const PathResult& r = results[i];
+            printf("%s{\"path\":\"%s\",\"frame_bytes\":%ld,\"delivered\":%u,\"copied_per_image\":%.0f,"
+                   "\"control_copied\":%.0f,\"client_buffer\":%u,\"static_staging\":%u,\"heap_peak\":%lld,"
+                   "\"psram_peak\":%lld,\"messages_per_image\":%.1f,\"upload_ms\":%.1f,\"hold_max_ms\":%.1f,"
+                   "\"cpu_us\":%.1f}",
+                   i ? "," : "", r.name, r.frameBytes, r.delivered, r.copiedPerImage, r.controlCopied, r.clientBuffer,
+                   r.staticStaging, (long long)r.heapPeak, (long long)r.psramPeak, r.messagesPerImage, r.uploadMs,
+                   r.holdMaxMs, r.cpuUs);
+        }
+        printf("],\"failures\":%d}\n", failures);
+    } else {
+        printf("ArgoS image stream benchmark (%ld images per run, %ld kbps, %ld ms latency)\n", images, kbps, latency);
+        printf("  frame  path       copied/img  ctrl  buffer  staging  heap pk  psram pk  msgs  upload ms  held ms"
+               "  cpu us  ok\n");
+        for (size_t i = 0; i < results.size(); i++) {
+            const PathResult& r = results[i];
+            printf("  %3ldK  %-9s  %10.0f  %4.0f  %6u  %7u  %7lld  %8lld  %4.1f  %9.1f  %7.1f  %6.1f  %u/%ld\n",
+                   r.frameBytes / 1024, r.name, r.copiedPerImage, r.controlCopied, r.clientBuffer, r.staticStaging,
+                   (long long)r.heapPeak, (long long)r.psramPeak, r.messagesPerImage, r.uploadMs, r.holdMaxMs,
+                   r.cpuUs, r.delivered, images);
+        }
+        printf("  %s\n", failures ? "FAILED" : "OK");
+    }
+    return failures ? 1 : 0;
+}
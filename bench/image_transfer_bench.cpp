@@ -0,0 +1,177 @@
+// Image transfer benchmark: delivers images through the real publishImage()
+// to the dashboard stand-in (ACK every few chunks, NACK gaps, ACK again on
+// duplicates) over a shaped link with injected loss in both directions. The old
+// fixed-delay sender runs the same sweep as the baseline. Exits non-zero if
+// any windowed transfer fails or arrives corrupted, or if an image has fewer
+// chunks than IMG_WINDOW (the env pins IMG_CHUNK_SIZE to 2 KB for that).
+//
+//   .pio/build/bench_image_transfer/program [--images N] [--size BYTES]
+//                                            [--kbps N] [--latency MS] [--json]
+
+#include <Arduino.h>
+#include <vector>
+#include "host_sim.h"
+#include "bench_util.h"
+#include "config.h"
+#include "mqtt_driver.h"
+#include "image_transfer.h"
+
+void setup();
+extern MqttClient client;
+
+// The sender this protocol replaced: START/END twice, fixed 20 ms spacing,
+// 2 KB chunks through a 4 KB client buffer, each written out by publish()
+#define LEGACY_CHUNK_SIZE  2048
+
+static void legacyPublish(const char* topic, const uint8_t* payload, size_t len) {
+    while (!client.publish(topic, payload, len) && client.connected()) {
+        client.loop();      // Outbox full: wait, like the blocking write did
+        delay(1);
+    }
+    client.loop();
+}
+
+static void legacyPublishImage(const uint8_t* buf, size_t length) {
+    const char* start = "{\"status\":\"start\"}";
+    legacyPublish(MQTT_TOPIC(TOPIC_CAM_CTRL), (const uint8_t*)start, strlen(start));
+    legacyPublish(MQTT_TOPIC(TOPIC_CAM_CTRL), (const uint8_t*)start, strlen(start));
+    for (size_t offset = 0; offset < length; offset += LEGACY_CHUNK_SIZE) {
+        size_t n = length - offset;
+        if (n > LEGACY_CHUNK_SIZE) n = LEGACY_CHUNK_SIZE;
+        legacyPublish(MQTT_TOPIC(TOPIC_CAM_DATA), buf + offset, n);
+        delay(20);
+        client.loop();
+    }
+    const char* end = "{\"status\":\"end\"}";
+    legacyPublish(MQTT_TOPIC(TOPIC_CAM_CTRL), (const uint8_t*)end, strlen(end));
+    legacyPublish(MQTT_TOPIC(TOPIC_CAM_CTRL), (const uint8_t*)end, strlen(end));
+}
+
+struct SweepResult {
+    int loss;
+    double windowedMs;
+    double legacyMs;
+    uint32_t delivered;
+    uint32_t corrupted;
+    uint32_t legacyIntact;
+    double resentPerImage;
+};
+
+int main(int argc, char** argv) {
+    long images = benchArg(argc, argv, "--images", 20);
+    long size = benchArg(argc, argv, "--size", 48 * 1024);
+    long kbps = benchArg(argc, argv, "--kbps", 1000);
+    long latency = benchArg(argc, argv, "--latency", 40);
+    bool json = benchHasFlag(argc, argv, "--json");
+
+    hostReset();
+    hostFlashWipe();
+    hostSerialEcho(false);
+    setup();
+    while (!client.connected() && millis() < 30000) {   // WiFi join and connect run in the background
+        loopMQTT();
+        hostClockAdvanceMs(1);
+    }
+
+    std::vector<uint8_t> image(size);
+    uint32_t x = 0x12345678;
+    for (long i = 0; i < size; i++) {
+        x ^= x << 13;
+        x ^= x >> 17;
+        x ^= x << 5;
+        image[i] = (uint8_t)x;
+    }
+
+    // Old Node-RED assembler: concatenates whatever arrives between START and END
+    bool legacyMode = false;
+    std::vector<uint8_t> legacy;
+    hostBroker().addObserver([&](const std::string& topic, const uint8_t* payload, size_t len) {
+        if (!legacyMode) return;
+        if (topic == MQTT_TOPIC(TOPIC_CAM_DATA)) {
+            legacy.insert(legacy.end(), payload, payload + len);
+        } else if (topic == MQTT_TOPIC(TOPIC_CAM_CTRL) && !memcmp(payload, "{\"status\":\"start\"", 17)) {
+            legacy.clear();
+        }
+    });
+
+    HostNetModel& net = hostNet();
+    net.linkLatencyMs = (uint32_t)latency;
+    net.linkBytesPerMs = (uint32_t)(kbps / 8);
+    uint32_t chunks = (uint32_t)((size + IMG_CHUNK_SIZE - 1) / IMG_CHUNK_SIZE);
+    double boundMs = (double)(size + chunks * (IMG_CHUNK_HEADER_SIZE + 40)) / net.linkBytesPerMs;
+
+    const int losses[] = {0, 1, 5, 10, 20};
+    std::vector<SweepResult> results;
+    int failures = 0;
+    if (chunks < IMG_WINDOW) {
+        // One window covers the image: neither windowing nor a NACKed gap is exercised
+        printf("  FAIL: %u chunks of %u bytes, fewer than IMG_WINDOW (%u); lower IMG_CHUNK_SIZE or raise --size\n",
+               chunks, (unsigned)IMG_CHUNK_SIZE, (unsigned)IMG_WINDOW);
+        failures++;
+    }
+    for (size_t l = 0; l < sizeof(losses) / sizeof(losses[0]); l++) {
+        SweepResult r;
+        memset(&r, 0, sizeof(r));
+        r.loss = losses[l];
+        net.lossPercent = (uint8_t)r.loss;
+
+        uint32_t resendsBefore = hostDashboardStats().resends;
+        BenchSeries windowedMs;
+        for (long i = 0; i < images; i++) {
+            uint32_t completedBefore = hostDashboardStats().imagesCompleted;
+            uint64_t t0 = hostClockMicros();
+            bool ok = publishImage(&image[0], image.size());
+            windowedMs.add((hostClockMicros() - t0) / 1000.0);
+            bool completed = hostDashboardStats().imagesCompleted == completedBefore + 1;
+            bool intact = hostDashboardLastImage() == image;
+            if (ok && completed && intact) r.delivered++;
+            if (completed && !intact) r.corrupted++;
+        }
+        uint32_t resent = hostDashboardStats().resends - resendsBefore;
+
+        BenchSeries legacyMs;
+        legacyMode = true;
+        hostDashboardEnable(false);
+        client.setBufferSize(4096);
+        for (long i = 0; i < images; i++) {
+            uint64_t t0 = hostClockMicros();
+            legacyPublishImage(&image[0], image.size());
+            legacyMs.add((hostClockMicros() - t0) / 1000.0);
+            if (legacy == image) r.legacyIntact++;
+        }
+        legacyMode = false;
+        hostDashboardEnable(true);
+        client.setBufferSize(MQTT_BUFFER_SIZE);
+        r.windowedMs = windowedMs.mean();
+        r.legacyMs = legacyMs.mean();
+        r.resentPerImage = (double)resent / images;
+        if (r.delivered != (uint32_t)images || r.corrupted) failures++;
+        results.push_back(r);
+    }
+
+    if (json) {
+        printf("{\"bench\":\"image_transfer\",\"image_bytes\":%ld,\"chunks\":%u,\"kbps\":%ld,\"latency_ms\":%ld,"
+               "\"bandwidth_bound_ms\":%.0f,\"sweep\":[", size, chunks, kbps, latency, boundMs);
+        for (size_t i = 0; i < results.size(); i++) {
+            const SweepResult& r = results[i];
+            printf("%s{\"loss\":%d,\"windowed_ms\":%.0f,\"legacy_ms\":%.0f,\"delivered\":%u,\"corrupted\":%u,"
+                   "\"resent_per_image\":%.1f,\"legacy_intact\":%u}", i ? "," : "", r.loss, r.windowedMs,
+                   r.legacyMs, r.delivered, r.corrupted, r.resentPerImage, r.legacyIntact);
+        }
+        printf("],\"images\":%ld,\"failures\":%d}\n", images, failures);
+    } else {
+        printf("ArgoS image transfer benchmark (%ld bytes, %u chunks, %ld kbps, %ld ms latency)\n", size, chunks,
+               kbps, latency);
+        printf("  bandwidth bound     %.0f ms\n", boundMs);
+        printf("  loss   windowed ms  delivered  resent/img   legacy ms  legacy intact\n");
+        for (size_t i = 0; i < results.size(); i++) {
+            const SweepResult& r = results[i];
+            printf("  %3d%%   %11.0f   %4u/%-4ld  %10.1f  %10.0f   %4u/%ld\n", r.loss, r.windowedMs, r.delivered,
+                   images, r.resentPerImage, r.legacyMs, r.legacyIntact, images);
+        }
+        HostDashboardStats dash = hostDashboardStats();
+        printf("  dashboard           %u ACKs, %u NACKs, %u duplicates\n", dash.acks, dash.nacks, dash.duplicates);
+        printf("  %s\n", failures ? "FAILED" : "OK");
+    }
+    return failures ? 1 : 0;
+}
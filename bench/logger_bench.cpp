@@ -0,0 +1,135 @@
+// Logger benchmark: per-call cost of the deferred logger against the old
+// String-concatenating logSystem(), and a 24h simulated run (day cycles at
+// INTERVAL_DAY, drained through the modelled UART) that must not touch the
+// heap. Exits non-zero if any allocation is seen.
+//
+//   .pio/build/bench_logger/program [--calls N] [--json]
+
+#include <Arduino.h>
+#include "host_sim.h"
+#include "bench_util.h"
+#include "config.h"
+#include "logger.h"
+
+// Reference: the logSystem(String) path this logger replaced
+static String legacyTimestamp() {
+    unsigned long now = millis();
+    char buf[16];
+    sprintf(buf, "[%02lu:%02lu:%02lu]", (now / 3600000) % 24, (now / 60000) % 60, (now / 1000) % 60);
+    return String(buf);
+}
+
+static void legacyLogSystem(String message) {
+    Serial.print(legacyTimestamp());
+    Serial.print(" ");
+    Serial.println(message);
+}
+
+int main(int argc, char** argv) {
+    long calls = benchArg(argc, argv, "--calls", 1000000);
+    bool json = benchHasFlag(argc, argv, "--json");
+
+    hostReset();
+    hostSerialEcho(false);
+    Serial.setTxBufferSize(LOG_SERIAL_TX_BUFFER);
+    Serial.begin(115200);
+
+    float temp = 31.4f;
+    float lux = 23456.0f;
+    int days = 3;
+
+    // --- 1. Call-site cost (drain excluded, ring drained between batches) ---
+    hostSerialBlockingModel(false);
+    uint64_t callNs = 0;
+    long done = 0;
+    BenchAllocDelta callHeap;
+    while (done < calls) {
+        int batch = LOG_RING_SIZE;
+        uint64_t t0 = benchNowNs();
+        for (int i = 0; i < batch; i++) {
+            LOG_INFO("Env: %.1fC | %.0f lx", temp, lux);
+        }
+        callNs += benchNowNs() - t0;
+        done += batch;
+        while (logPending()) logDrain();
+    }
+    uint64_t callAllocs = callHeap.allocs();
+
+    // --- 2. Same message through the legacy String path ---
+    long legacyCalls = calls / 10;
+    BenchAllocDelta legacyHeap;
+    uint64_t t0 = benchNowNs();
+    for (long i = 0; i < legacyCalls; i++) {
+        legacyLogSystem("Env: " + String(temp, 1) + "C | " + String(lux, 0) + " lx");
+    }
+    uint64_t legacyNs = benchNowNs() - t0;
+    uint64_t legacyAllocs = legacyHeap.allocs();
+
+    // --- 3. Virtual loop stall at 115200 baud: lines of a cleaning-alert cycle ---
+    // Legacy: synchronous prints with the default TX setup (128-byte FIFO only)
+    hostSerialBlockingModel(true);
+    Serial.setTxBufferSize(0);
+    Serial.flush();
+    uint64_t v0 = hostClockMicros();
+    legacyLogSystem("Env: " + String(temp, 1) + "C | " + String(lux, 0) + " lx");
+    legacyLogSystem("⚠️ ALERT: CLEANING TRIGGERED");
+    legacyLogSystem("   Reason: " + String("Environment (Dust+Dry+Time)"));
+    legacyLogSystem("📸 CAPTURING EVIDENCE...");
+    legacyLogSystem("Status: OK (Dust:" + String(87.0f, 0) + " Days:" + String(days) + ")");
+    uint64_t legacyStallUs = hostClockMicros() - v0;
+
+    Serial.setTxBufferSize(LOG_SERIAL_TX_BUFFER);
+    Serial.flush();
+    v0 = hostClockMicros();
+    LOG_INFO("Env: %.1fC | %.0f lx", temp, lux);
+    LOG_WARN("⚠️ ALERT: CLEANING TRIGGERED");
+    LOG_WARN("   Reason: %s", "Environment (Dust+Dry+Time)");
+    LOG_INFO("📸 CAPTURING EVIDENCE...");
+    LOG_INFO("Status: OK (Dust:%.0f Days:%d)", 87.0f, days);
+    logDrain();
+    uint64_t deferredStallUs = hostClockMicros() - v0;
+
+    // --- 4. 24h simulated run ---
+    const unsigned long dayMs = 24UL * 3600UL * 1000UL;
+    unsigned long cycles = dayMs / INTERVAL_DAY;
+    Serial.flush();
+    hostClockReset(0);
+    uint32_t droppedStart = logDropped();
+    BenchAllocDelta dayHeap;
+    for (unsigned long c = 0; c < cycles; c++) {
+        hostClockAdvanceMs(INTERVAL_DAY);
+        float dust = 40.0f + (c % 90);
+        LOG_INFO("Env: %.1fC | %.0f lx", temp + (c % 7) * 0.1f, lux);
+        if (c % 97 == 0) LOG_WARN("⚠️ Critical conditions met, waiting for schedule (%d/%d days)", days, DAYS_BETWEEN_CLEAN);
+        LOG_INFO("Status: OK (Dust:%.0f Days:%d)", dust, days);
+        LOG_DEBUG("debug detail %d", (int)c);
+        logDrain();
+    }
+    logFlush();
+    uint64_t dayAllocs = dayHeap.allocs();
+    uint32_t dayDropped = logDropped() - droppedStart;
+
+    double nsPerCall = (double)callNs / done;
+    double legacyNsPerCall = (double)legacyNs / legacyCalls;
+
+    if (json) {
+        printf("{\"bench\":\"logger\",\"ns_per_call\":%.1f,\"allocs_per_call\":%.3f,"
+               "\"legacy_ns_per_call\":%.1f,\"legacy_allocs_per_call\":%.2f,"
+               "\"loop_stall_us\":%llu,\"legacy_loop_stall_us\":%llu,"
+               "\"day_cycles\":%lu,\"day_allocs\":%llu,\"day_dropped\":%u}\n",
+               nsPerCall, (double)callAllocs / done, legacyNsPerCall, (double)legacyAllocs / legacyCalls,
+               (unsigned long long)deferredStallUs, (unsigned long long)legacyStallUs,
+               cycles, (unsigned long long)dayAllocs, dayDropped);
+    } else {
+        printf("ArgoS logger benchmark\n");
+        printf("  deferred LOG_INFO     %8.1f ns/call  %6.3f allocs/call (%ld calls)\n",
+               nsPerCall, (double)callAllocs / done, done);
+        printf("  legacy logSystem      %8.1f ns/call  %6.2f allocs/call (%ld calls)\n",
+               legacyNsPerCall, (double)legacyAllocs / legacyCalls, legacyCalls);
+        printf("  loop stall / cycle    %8llu us deferred vs %llu us legacy (115200 baud)\n",
+               (unsigned long long)deferredStallUs, (unsigned long long)legacyStallUs);
+        printf("  24h run               %lu cycles, %llu heap allocations, %u records dropped\n",
+               cycles, (unsigned long long)dayAllocs, dayDropped);
+    }
+    return (callAllocs == 0 && dayAllocs == 0) ? 0 : 1;
+}
@@ -0,0 +1,281 @@
+// Micro-benchmarks of the hot paths, one operation at a time: wall time per
+// operation, heap allocations and bytes per operation, and for the publish
+// paths the MQTT messages and wire bytes (topic + payload) per operation,
+// counted by the host broker.
+//
+//   evaluate_state      evaluateSystemState() over a set of day statuses
+//   operation_mode      determineOperationMode() over a dawn/dusk lux sweep
+//   get_topic           getTopic() (runtime topic builder)
+//   dust_adc            dustDensityFromAdc()
+//   dust_filter         filterDust() over a full DUST_WINDOW
+//   dust_read           readDust(): window copy + filter, sampler running
+//   report_telemetry    reportTelemetry() (deadbands, heartbeat)
+//   frame_encode        encodeTelemetryFrame(), every channel
+//   publish_telemetry   publishTelemetry(), every value due
+//   publish_stats       publishStats() (JSON aggregates)
+//   perf_probe          PERF_SCOPE around an empty block
+//   publish_image       publishImage() of a 320x240 JPEG, chunk loop and
+//                       control JSON included, ACKed by the dashboard
+//
+// Each case runs for at least --min-ms of wall time (default 200) after a
+// warm-up; ns/op is the best of --reps runs (default 5). Exits non-zero if
+// a case allocates more per operation than its budget below (0 for every
+// path that runs each cycle). --filter <text> runs the cases whose name
+// contains it; --json prints one line per case.
+//
+//   .pio/build/bench_micro/program [--min-ms N] [--reps N] [--filter text] [--json]
+
+#include <Arduino.h>
+#include <math.h>
+#include "host_sim.h"
+#include "bench_util.h"
+#include "config.h"
+#include "core.h"
+#include "report.h"
+#include "dust_sampler.h"
+#include "sensor_driver.h"
+#include "telemetry_frame.h"
+#include "stream_stats.h"
+#include "mqtt_driver.h"
+#include "perf_metrics.h"
+
+void setup();
+void loop();
+extern MqttClient client;
+const char* getTopic(const char* suffix);
+
+static volatile uint32_t sink = 0;
+
+// ============================================================================
+// CASES
+// ============================================================================
+
+static SystemStatus statuses[16];
+static SensorBank bank;
+static float luxSweep[64];
+static float dustSamples[DUST_WINDOW];
+static float dustWork[DUST_WINDOW];
+static ReportMask allDue;
+static StatsSummary summary;
+static uint8_t frameBuffer[TELEMETRY_FRAME_MAX_SIZE];
+static std::vector<uint8_t> jpeg;
+
+static void prepare() {
+    uint32_t rng = 0x9E3779B9;
+    for (int i = 0; i < 16; i++) {
+        rng = rng * 1664525 + 1013904223;
+        float t = (rng >> 8) / 16777216.0f;
+        statuses[i] = {20 + 15 * t, 30 + 50 * t, 20000 + 60000 * t, 40 + 200 * t, NAN, 30 + 60 * t, MODE_DAY};
+    }
+    sensorBankReset(&bank);
+    for (uint8_t i = 0; i < bank.channels; i++) {
+        bank.temp[i] = statuses[i % 16].temp;
+        bank.humidity[i] = statuses[i % 16].humidity;
+        bank.lux[i] = statuses[i % 16].lux;
+        bank.dust[i] = statuses[i % 16].dust;
+    }
+    for (int i = 0; i < 64; i++) luxSweep[i] = MIN_LUX_DAY_MODE * (0.5f + i / 42.0f);
+    for (int i = 0; i < DUST_WINDOW; i++) {
+        rng = rng * 1664525 + 1013904223;
+        dustSamples[i] = 50 + (rng >> 24) / 8.0f + (i % 17 == 0 ? 400 : 0);    // Noise and spikes
+    }
+    for (uint8_t m = 0; m < REPORT_METRICS; m++) allDue.channels[m] = 0xFFFF;
+    summary = {600, 24.5f, 0.8f, 22.0f, 27.0f, 24.4f, 26.1f, 24.7f};
+    std::vector<uint8_t> rgb(320 * 240 * 3);
+    for (size_t i = 0; i < rgb.size(); i++) rgb[i] = (uint8_t)((i * 7) ^ (i >> 9));
+    jpeg = hostJpegEncode(rgb.data(), 320, 240, 80);
+}
+
+static void opEvaluate(uint32_t i) {
+    const SystemStatus& s = statuses[i & 15];
+    sink = sink + evaluateSystemState(s, bank);
+}
+
+static void opMode(uint32_t i) {
+    static SystemMode mode = MODE_NIGHT;
+    mode = determineOperationMode(luxSweep[i & 63], mode);
+    sink = sink + mode;
+}
+
+static void opTopic(uint32_t i) {
+    static const char* const suffixes[2] = {TOPIC_DUST, TOPIC_TEMP};
+    sink = sink + (uint8_t)getTopic(suffixes[i & 1])[0];
+}
+
+static void opDustAdc(uint32_t i) {
+    float d = dustDensityFromAdc((uint16_t)(i & 4095));
+    sink = sink + (uint32_t)d;
+}
+
+static void opDustFilter(uint32_t i) {
+    memcpy(dustWork, dustSamples, sizeof(dustWork));
+    DustReading r;
+    filterDust(dustWork, DUST_WINDOW, &r);
+    sink = sink + (uint32_t)r.filtered;
+}
+
+static void opDustRead(uint32_t i) {
+    DustReading r;
+    if (readDust(&r, 0)) sink = sink + r.count;
+}
+
+static void opReport(uint32_t i) {
+    ReportMask mask = reportTelemetry(statuses[i & 15], bank);
+    sink = sink + mask.channels[REPORT_DUST];
+}
+
+static void opFrame(uint32_t i) {
+    TelemetryFrame frame;
+    frame.flags = 0;
+    frame.seq = i;
+    frame.timestamp = 1700000000 + i;
+    frame.status = statuses[i & 15];
+    frame.bank = bank;
+    sink = sink + (uint32_t)encodeTelemetryFrame(frame, frameBuffer, sizeof(frameBuffer));
+}
+
+static void opPublishTelemetry(uint32_t i) {
+    sink = sink + publishTelemetry(statuses[i & 15], bank, allDue);
+    flushMQTT();        // Queued by the client, written at the end of the network step
+}
+
+static void opPublishStats(uint32_t i) {
+    sink = sink + publishStats(MQTT_TOPIC(TOPIC_TEMP) TOPIC_STATS, summary, 1);
+    flushMQTT();
+}
+
+static void opProbe(uint32_t i) {
+    PERF_SCOPE(PERF_LIGHT);
+    sink = sink + i;
+}
+
+static void opPublishImage(uint32_t i) {
+    sink = sink + publishImage(jpeg.data(), jpeg.size());
+}
+
+struct MicroCase {
+    const char* name;
+    void (*op)(uint32_t i);
+    bool mqtt;                  // Needs the broker connection
+    double maxAllocs;           // Per operation
+};
+
+static const MicroCase CASES[] = {
+    {"evaluate_state", opEvaluate, false, 0},
+    {"operation_mode", opMode, false, 0},
+    {"get_topic", opTopic, false, 0},
+    {"dust_adc", opDustAdc, false, 0},
+    {"dust_filter", opDustFilter, false, 0},
+    {"dust_read", opDustRead, false, 0},
+    {"report_telemetry", opReport, false, 0},
+    {"frame_encode", opFrame, false, 0},
+    {"publish_telemetry", opPublishTelemetry, true, 0},
+    {"publish_stats", opPublishStats, true, 0},
+    {"perf_probe", opProbe, false, 0},
+    {"publish_image", opPublishImage, true, 0},
+};
+
+// ============================================================================
+// RUNNER
+// ============================================================================
+
+struct MicroResult {
+    uint64_t ops;
+    double nsPerOp;
+    double allocsPerOp;
+    double allocBytesPerOp;
+    double msgsPerOp;
+    double wireBytesPerOp;
+};
+
+// Firmware up with the broker connected, the dust sampler filling its window
+static bool bootConnected() {
+    client.disconnect();
+    hostReset();
+    hostSerialEcho(false);
+    setup();
+    for (int i = 0; i < 600 && !client.connected(); i++) {
+        loop();
+        hostClockAdvanceMs(100);
+    }
+    setDaysSinceClean(0);                           // Globals outlive setup() on the host
+    return client.connected();
+}
+
+// The clock is read around the whole run only
+static uint64_t timedRun(const MicroCase& c, uint64_t ops, uint32_t* next) {
+    uint64_t start = benchNowNs();
+    for (uint64_t n = 0; n < ops; n++) c.op((*next)++);
+    return benchNowNs() - start;
+}
+
+static MicroResult runCase(const MicroCase& c, long minMs, long reps) {
+    uint32_t next = 0;
+    // Calibrate: double until one run takes minMs
+    uint64_t ops = 1;
+    while (timedRun(c, ops, &next) < (uint64_t)minMs * 1000000ULL && ops < (1ULL << 32)) ops *= 2;
+
+    MicroResult r = {};
+    r.ops = ops;
+    r.nsPerOp = 1e300;
+    for (long k = 0; k < reps; k++) {
+        BenchAllocDelta alloc;
+        uint64_t msgs = hostBroker().messagesPublished;
+        uint64_t bytes = hostBroker().bytesPublished;
+        double ns = (double)timedRun(c, ops, &next) / ops;
+        if (ns < r.nsPerOp) r.nsPerOp = ns;
+        // Same per run (every op is deterministic): the last run's figures
+        r.allocsPerOp = (double)alloc.allocs() / ops;
+        r.allocBytesPerOp = (double)alloc.bytes() / ops;
+        r.msgsPerOp = (double)(hostBroker().messagesPublished - msgs) / ops;
+        r.wireBytesPerOp = (double)(hostBroker().bytesPublished - bytes) / ops;
+    }
+    return r;
+}
+
+int main(int argc, char** argv) {
+    bool json = benchHasFlag(argc, argv, "--json");
+    long minMs = benchArg(argc, argv, "--min-ms", 200);
+    long reps = benchArg(argc, argv, "--reps", 5);
+    const char* filter = benchArgStr(argc, argv, "--filter", nullptr);
+
+    hostPowerCycle();
+    prepare();
+    if (!bootConnected()) {
+        printf("Firmware did not connect to the host broker\n");
+        return 2;
+    }
+    // Paths the Node-RED dashboard would answer: keep its ACKs flowing
+    hostDashboardEnable(true);
+
+    int failures = 0;
+    if (!json) {
+        printf("ArgoS micro-benchmarks (%ld ms per run, best of %ld, %u channels, %u-byte JPEG)\n", minMs, reps,
+               (unsigned)bank.channels, (unsigned)jpeg.size());
+        printf("  case                       ops        ns/op   allocs/op  bytes/op    msgs/op  wire B/op\n");
+    }
+    for (size_t i = 0; i < sizeof(CASES) / sizeof(CASES[0]); i++) {
+        const MicroCase& c = CASES[i];
+        if (filter && !strstr(c.name, filter)) continue;
+        if (c.mqtt && !client.connected() && !bootConnected()) {
+            printf("  %s: broker connection lost\n", c.name);
+            failures++;
+            continue;
+        }
+        MicroResult r = runCase(c, minMs, reps);
+        bool ok = r.allocsPerOp <= c.maxAllocs;
+        if (!ok) failures++;
+        if (json) {
+            printf("{\"bench\":\"micro\",\"case\":\"%s\",\"ops\":%llu,\"ns_op\":%.2f,\"allocs_op\":%.3f,"
+                   "\"alloc_bytes_op\":%.1f,\"msgs_op\":%.3f,\"wire_bytes_op\":%.1f,\"ok\":%s}\n",
+                   c.name, (unsigned long long)r.ops, r.nsPerOp, r.allocsPerOp, r.allocBytesPerOp, r.msgsPerOp,
+                   r.wireBytesPerOp, ok ? "true" : "false");
+        } else {
+            printf("  %-18s %12llu %12.1f %11.3f %9.1f %10.3f %10.1f%s\n", c.name, (unsigned long long)r.ops,
+                   r.nsPerOp, r.allocsPerOp, r.allocBytesPerOp, r.msgsPerOp, r.wireBytesPerOp,
+                   ok ? "" : "   FAIL: allocates");
+        }
+    }
+    if (!json) printf("%s\n", failures ? "FAILED" : "OK");
+    return failures ? 1 : 0;
+}
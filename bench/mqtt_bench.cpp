@@ -0,0 +1,318 @@
+// MQTT client (mqtt_client.h) against the host broker over a shaped link:
+//
+// 1. Throughput: QoS 1 publishes with an in-flight window of 1 and of
+//    MQTT_INFLIGHT_WINDOW, QoS 0 as the baseline, at --latency one way.
+// 2. Broken connections: 2 % and 5 % of the PUBLISH and PUBACK packets
+//    take the connection down with them (TCP loses nothing short of that).
+//    No QoS 1 publish may go missing; retransmits after the reconnects and
+//    duplicates reported. QoS 0 publishes at the same rate for comparison.
+// 3. Connection drop mid-stream: the broker goes away for --outage-s while
+//    QoS 1 publishes are in flight, and a request is published to the device
+//    meanwhile. With a persistent session every publish arrives and so does
+//    the request; with a clean session the publishes arrive (resent as new
+//    messages) and the request is lost.
+// 4. Topic aliases: wire bytes per message on firmware topics with and
+//    without aliases.
+// 5. Firmware: publishAlert() through setup()/loop() while 5 % of the
+//    packets break the connection, every alert must reach the broker.
+// 6. Connect: the longest a connect() call held the caller; the CONNACK
+//    comes 2x the latency later, through loop().
+//
+// Exits non-zero if a QoS 1 message is lost, the window does not raise
+// throughput, the persistent session loses the request, aliases do not
+// save wire bytes, or connect() waits for the CONNACK.
+//
+//   .pio/build/bench_mqtt/program [--messages N] [--latency MS] [--outage-s N] [--json]
+
+#include <Arduino.h>
+#include <WiFi.h>
+#include <vector>
+#include "host_sim.h"
+#include "bench_util.h"
+#include "config.h"
+#include "mqtt_client.h"
+#include "mqtt_driver.h"
+
+void setup();
+void loop();
+
+#define BENCH_TOPIC     MQTT_TOPIC("bench/seq")
+#define BENCH_REQUEST   MQTT_TOPIC("bench/request")
+
+static WiFiClient benchNet;
+static MqttClient benchClient(benchNet);
+
+// Sequence numbers seen by the broker on BENCH_TOPIC
+static std::vector<uint32_t> received;
+static uint32_t requests = 0;
+
+static void benchCallback(char* topic, uint8_t* payload, unsigned int length) {
+    if (strcmp(topic, BENCH_REQUEST) == 0) requests++;
+}
+
+static void resetHost(uint32_t latency) {
+    hostReset();
+    hostSerialEcho(false);
+    WiFi.begin(SECRET_SSID, SECRET_WIFI_PASSWORD);
+    while (WiFi.status() != WL_CONNECTED) delay(1);
+    hostNet().linkLatencyMs = latency;
+    hostNet().linkBytesPerMs = 125;             // 1 Mbit/s
+    {
+        HostAllocPause pause;
+        received.clear();
+    }
+    requests = 0;
+    hostBroker().addObserver([](const std::string& topic, const uint8_t* payload, size_t len) {
+        if (topic != BENCH_TOPIC || len < 4) return;
+        uint32_t seq;
+        memcpy(&seq, payload, 4);
+        received.push_back(seq);
+    });
+    benchClient.reset();
+    benchClient.setBufferSize(MQTT_BUFFER_SIZE);
+    benchClient.setCallback(benchCallback);
+    benchClient.setSessionExpiry(MQTT_SESSION_EXPIRY_S);
+    benchClient.setInflightWindow(MQTT_INFLIGHT_WINDOW);
+    benchClient.setTopicAliases(MQTT_TOPIC_ALIASES);
+}
+
+static double connectHeldMaxMs = 0;    // Inside connect()
+
+static bool benchConnect() {
+    if (!benchNet.connect(IPAddress(192, 168, 1, 10), SECRET_MQTT_PORT)) return false;
+    uint64_t before = hostClockMicros();
+    bool sent = benchClient.connect("argus-bench", nullptr, nullptr);
+    double heldMs = (hostClockMicros() - before) / 1000.0;
+    if (heldMs > connectHeldMaxMs) connectHeldMaxMs = heldMs;
+    if (!sent) return false;
+    while (benchClient.connecting()) {
+        benchClient.loop();
+        delay(1);
+    }
+    return benchClient.subscribe(BENCH_REQUEST, 1);
+}
+
+static uint32_t distinct() {
+    std::vector<uint32_t> seen;
+    {
+        HostAllocPause pause;
+        seen = received;
+    }
+    std::sort(seen.begin(), seen.end());
+    return (uint32_t)(std::unique(seen.begin(), seen.end()) - seen.begin());
+}
+
+struct RunResult {
+    uint32_t messages;
+    uint32_t distinct;
+    double seconds;             // Virtual, first publish to idle
+    MqttClientStats client;
+    uint64_t duplicates;
+    uint64_t connects;
+    uint64_t wireBytes;
+    uint32_t requests;
+};
+
+// `messages` publishes of 64 bytes (sequence number first), retried while
+// the outbox is full or the connection is down; reconnects every 500 ms.
+// outageAt: the broker goes away after that many publishes for outageS.
+static RunResult run(uint32_t messages, uint8_t qos, uint32_t outageAt = 0, uint32_t outageS = 0) {
+    RunResult r;
+    memset(&r, 0, sizeof(r));
+    r.messages = messages;
+    uint64_t t0 = hostClockMicros();
+    uint64_t wire0 = hostBroker().wireBytesIn;
+    uint64_t dup0 = hostBroker().duplicates;
+    uint64_t connects0 = hostBroker().connects;
+    uint64_t outageEnd = 0;
+    unsigned long nextConnect = 0;
+    uint8_t payload[64];
+    memset(payload, 0xA5, sizeof(payload));
+
+    uint32_t seq = 0;
+    uint64_t limit = t0 + 3600ULL * 1000000ULL;
+    while ((seq < messages || !benchClient.idle()) && hostClockMicros() < limit) {
+        if (outageEnd && hostClockMicros() >= outageEnd) {
+            hostNet().brokerAvailable = true;
+            outageEnd = 0;
+        }
+        if (!benchClient.connected() && (long)(millis() - nextConnect) >= 0) {
+            nextConnect = millis() + 500;
+            benchConnect();
+        }
+        while (seq < messages && benchClient.connected()) {
+            memcpy(payload, &seq, 4);
+            if (!benchClient.publish(BENCH_TOPIC, payload, sizeof(payload), qos)) break;
+            seq++;
+            if (outageAt && seq == outageAt) {
+                hostNet().brokerAvailable = false;
+                outageEnd = hostClockMicros() + (uint64_t)outageS * 1000000ULL;
+                // Reaches the device only through a kept session
+                hostBroker().publishToDevice(BENCH_REQUEST, (const uint8_t*)"now", 3, 1);
+            }
+        }
+        benchClient.loop();
+        hostClockAdvanceMs(1);
+    }
+    // Requests still on their way
+    for (int i = 0; i < 500; i++) {
+        benchClient.loop();
+        hostClockAdvanceMs(1);
+    }
+    r.seconds = (hostClockMicros() - t0) / 1e6;
+    r.distinct = distinct();
+    r.client = benchClient.stats();
+    r.duplicates = hostBroker().duplicates - dup0;
+    r.connects = hostBroker().connects - connects0;
+    r.wireBytes = hostBroker().wireBytesIn - wire0;
+    r.requests = requests;
+    return r;
+}
+
+// Firmware topics, short readings: the telemetry mix
+static double wireBytesPerMessage(uint8_t aliases, uint32_t messages) {
+    resetHost(0);
+    benchClient.setTopicAliases(aliases);
+    benchConnect();
+    static const char* const topics[] = {MQTT_TOPIC(TOPIC_TEMP), MQTT_TOPIC(TOPIC_HUM), MQTT_TOPIC(TOPIC_LUX),
+                                         MQTT_TOPIC(TOPIC_DUST), MQTT_TOPIC(TOPIC_SOILING)};
+    uint64_t wire0 = hostBroker().wireBytesIn;
+    for (uint32_t i = 0; i < messages; i++) {
+        while (!benchClient.publish(topics[i % 5], "23.4")) benchClient.loop();
+        if (i % 5 == 4) benchClient.loop();
+    }
+    benchClient.loop();
+    return (double)(hostBroker().wireBytesIn - wire0) / messages;
+}
+
+// Firmware alerts: publishAlert() between loop() passes
+static uint32_t firmwareAlerts(uint32_t alerts, uint8_t drop, uint32_t* broken) {
+    hostReset();
+    hostSerialEcho(false);
+    uint32_t seen = 0;
+    hostBroker().addObserver([&seen](const std::string& topic, const uint8_t* payload, size_t len) {
+        if (topic == MQTT_TOPIC(TOPIC_ALERT) && len == 4 && memcmp(payload, "true", 4) == 0) seen++;
+    });
+    setup();
+    for (int i = 0; i < 600 && !mqttIdle(); i++) {
+        loop();
+        hostClockAdvanceMs(100);
+    }
+    hostNet().linkLatencyMs = 50;
+    hostNet().dropPercent = drop;
+    uint64_t broken0 = hostBroker().connectionsDropped;
+    for (uint32_t i = 0; i < alerts; i++) {
+        publishAlert(true);
+        for (int k = 0; k < 10; k++) {
+            loop();
+            hostClockAdvanceMs(100);
+        }
+    }
+    hostNet().dropPercent = 0;
+    for (int i = 0; i < 6000 && !mqttIdle(); i++) {
+        loop();
+        hostClockAdvanceMs(100);
+    }
+    *broken = (uint32_t)(hostBroker().connectionsDropped - broken0);
+    return seen;
+}
+
+int main(int argc, char** argv) {
+    bool json = benchHasFlag(argc, argv, "--json");
+    uint32_t messages = (uint32_t)benchArg(argc, argv, "--messages", 400);
+    uint32_t latency = (uint32_t)benchArg(argc, argv, "--latency", 50);
+    uint32_t outageS = (uint32_t)benchArg(argc, argv, "--outage-s", 20);
+
+    // --- 1. Throughput ---
+    resetHost(latency);
+    RunResult qos0 = run(messages, 0);
+    resetHost(latency);
+    benchClient.setInflightWindow(1);
+    RunResult window1 = run(messages, 1);
+    resetHost(latency);
+    RunResult windowN = run(messages, 1);
+
+    // --- 2. Broken connections ---
+    const uint8_t drops[] = {2, 5};
+    RunResult lossy[2];
+    RunResult lossyQos0[2];
+    for (int i = 0; i < 2; i++) {
+        resetHost(latency);
+        hostNet().dropPercent = drops[i];
+        lossy[i] = run(messages, 1);
+        resetHost(latency);
+        hostNet().dropPercent = drops[i];
+        lossyQos0[i] = run(messages, 0);
+    }
+    hostNet().dropPercent = 0;
+
+    // --- 3. Connection drop ---
+    resetHost(latency);
+    RunResult kept = run(messages, 1, messages / 2, outageS);
+    resetHost(latency);
+    benchClient.setSessionExpiry(0);
+    RunResult clean = run(messages, 1, messages / 2, outageS);
+
+    // --- 4. Topic aliases ---
+    double withAliases = wireBytesPerMessage(MQTT_TOPIC_ALIASES, messages);
+    double withoutAliases = wireBytesPerMessage(0, messages);
+
+    // --- 5. Firmware alerts ---
+    const uint32_t alerts = 50;
+    uint32_t alertBreaks = 0;
+    uint32_t alertsSeen = firmwareAlerts(alerts, 5, &alertBreaks);
+
+    double rate0 = qos0.messages / qos0.seconds;
+    double rate1 = window1.messages / window1.seconds;
+    double rateN = windowN.messages / windowN.seconds;
+    benchCheck(qos0.distinct == messages && window1.distinct == messages && windowN.distinct == messages,
+               "messages lost without loss");
+    benchCheck(rateN >= 4 * rate1, "the in-flight window does not raise QoS 1 throughput");
+    for (int i = 0; i < 2; i++) {
+        benchCheck(lossy[i].distinct == messages, "QoS 1 message lost over broken connections");
+        benchCheck(lossy[i].connects > 1, "no connection broke");
+    }
+    benchCheck(kept.distinct == messages && kept.client.sessionsResumed >= 1, "persistent session lost messages");
+    benchCheck(kept.requests == 1, "request to the device lost with a persistent session");
+    benchCheck(clean.distinct == messages, "clean session lost device messages");
+    benchCheck(withAliases < withoutAliases, "topic aliases save no wire bytes");
+    benchCheck(alertsSeen >= alerts, "firmware alert lost over broken connections");
+    benchCheck(connectHeldMaxMs < 2.0 * latency, "connect() waited for the CONNACK");
+
+    if (json) {
+        printf("{\"bench\":\"mqtt\",\"messages\":%u,\"latency_ms\":%u,\"qos0_msg_s\":%.1f,\"window1_msg_s\":%.1f,"
+               "\"window%u_msg_s\":%.1f,\"drop2_lost\":%u,\"drop2_retransmits\":%u,\"drop2_duplicates\":%llu,"
+               "\"drop5_lost\":%u,\"drop5_retransmits\":%u,\"drop5_duplicates\":%llu,\"drop5_qos0_lost\":%u,"
+               "\"drop_kept_requests\":%u,\"drop_clean_requests\":%u,\"wire_bytes_alias\":%.1f,"
+               "\"wire_bytes_full\":%.1f,\"alerts\":%u,\"alerts_seen\":%u,\"connect_held_ms\":%.1f,\"failures\":%d}\n",
+               messages, latency, rate0, rate1, (unsigned)MQTT_INFLIGHT_WINDOW, rateN, messages - lossy[0].distinct,
+               lossy[0].client.retransmits, (unsigned long long)lossy[0].duplicates, messages - lossy[1].distinct,
+               lossy[1].client.retransmits, (unsigned long long)lossy[1].duplicates,
+               messages - lossyQos0[1].distinct, kept.requests, clean.requests, withAliases, withoutAliases, alerts,
+               alertsSeen, connectHeldMaxMs, benchFailures());
+        return benchFailures() ? 1 : 0;
+    }
+
+    printf("ArgoS MQTT client (%u messages of 64 bytes, %u ms one way, 1 Mbit/s)\n", messages, latency);
+    printf("  throughput          QoS 0 %.1f msg/s, QoS 1 window 1 %.1f msg/s, window %u %.1f msg/s (%.1fx)\n",
+           rate0, rate1, (unsigned)MQTT_INFLIGHT_WINDOW, rateN, rateN / rate1);
+    for (int i = 0; i < 2; i++) {
+        printf("  breaks %u %%         QoS 1: %u lost, %u connects, %u retransmits, %llu duplicates, %.1f s; "
+               "QoS 0: %u lost\n",
+               (unsigned)drops[i], messages - lossy[i].distinct, (unsigned)lossy[i].connects,
+               lossy[i].client.retransmits, (unsigned long long)lossy[i].duplicates, lossy[i].seconds,
+               messages - lossyQos0[i].distinct);
+    }
+    printf("  drop %u s           persistent: %u/%u arrived, %u retransmits, request %s; "
+           "clean: %u/%u arrived, request %s\n",
+           outageS, kept.distinct, messages, kept.client.retransmits, kept.requests ? "delivered" : "lost",
+           clean.distinct, messages, clean.requests ? "delivered" : "lost");
+    printf("  topic aliases       %.1f wire bytes/msg, %.1f without (%.0f %% saved)\n", withAliases,
+           withoutAliases, 100.0 * (1 - withAliases / withoutAliases));
+    printf("  firmware alerts     %u raised, %u arrivals (duplicates included), %u connections broken\n",
+           alerts, alertsSeen, alertBreaks);
+    printf("  connect             connect() holds the caller %.1f ms at most, CONNACK after %u ms in loop()\n",
+           connectHeldMaxMs, 2 * latency);
+    printf("%s\n", benchFailures() ? "FAILED" : "OK");
+    return benchFailures() ? 1 : 0;
+}
@@ -0,0 +1,235 @@
+// Offline queue harness: runs the real setup()/loop() through a broker
+// outage of several virtual hours, then measures the catch-up (time to
+// drain, replay throughput, worst loop() stall) and checks that every frame
+// captured offline reaches the broker exactly once, in order. Also cuts
+// power at every byte of a write to check recovery, and overflows a small
+// partition to check drop accounting. Exits non-zero on any failure.
+//
+//   .pio/build/bench_offline_queue/program [--hours N] [--json]
+
+#include <Arduino.h>
+#include <set>
+#include "host_sim.h"
+#include "bench_util.h"
+#include "config.h"
+#include "core.h"
+#include "offline_queue.h"
+#include "report.h"
+#include "telemetry_frame.h"
+
+void setup();
+void loop();
+
+static uint32_t pushFrames(uint32_t firstSeq, uint32_t count) {
+    uint32_t pushed = 0;
+    for (uint32_t i = 0; i < count; i++) {
+        TelemetryFrame frame;
+        memset(&frame, 0, sizeof(frame));
+        frame.seq = firstSeq + i;
+        frame.status.dust = (float)i;
+        uint8_t buf[TELEMETRY_FRAME_SIZE];
+        encodeTelemetryFrame(frame, buf, sizeof(buf));
+        if (offlineQueuePush(OFFLINE_TELEMETRY, buf, sizeof(buf))) pushed++;
+    }
+    return pushed;
+}
+
+// Reads everything pending; returns false on a gap or bad frame
+static bool readAllFrames(uint32_t* count, uint32_t* firstSeq, bool consume) {
+    OfflineCursor cursor;
+    OfflineRecord rec;
+    uint8_t buf[64];
+    offlineQueueBegin(&cursor);
+    *count = 0;
+    bool ok = true;
+    uint32_t expect = 0;
+    while (offlineQueueRead(&cursor, &rec, buf, sizeof(buf))) {
+        TelemetryFrame frame;
+        if (!decodeTelemetryFrame(buf, rec.len, &frame)) ok = false;
+        if (*count == 0) *firstSeq = frame.seq;
+        else if (frame.seq != expect) ok = false;
+        expect = frame.seq + 1;
+        (*count)++;
+    }
+    if (consume) offlineQueueConsume(cursor);
+    return ok;
+}
+
+int main(int argc, char** argv) {
+    long hours = benchArg(argc, argv, "--hours", 6);
+    bool json = benchHasFlag(argc, argv, "--json");
+
+    // --- 1. Outage and catch-up through the firmware ---
+    hostReset();
+    hostFlashWipe();
+    hostSerialEcho(false);
+    hostCameraSetFrameSize(24 * 1024);
+    HostEnvironment& env = hostEnv();
+    env.lux = 20000.0f;
+    env.temp = 31.0f;
+    env.humidity = 70.0f;
+    env.dust = 60.0f;
+    // A frame every cycle (no report by exception): the worst case for the queue
+    ReportConfig everyValue = reportConfigDefault();
+    everyValue.enabled = false;
+    reportConfigure(everyValue);
+
+    std::set<uint32_t> replayedSeqs;
+    uint32_t replayMessages = 0;
+    uint32_t duplicateFrames = 0;
+    HostBroker& broker = hostBroker();
+    broker.addObserver([&](const std::string& topic, const uint8_t* payload, size_t len) {
+        if (topic == MQTT_TOPIC(TOPIC_REPLAY)) {
+            replayMessages++;
+            for (size_t off = 0; off + TELEMETRY_FRAME_SIZE <= len; off += TELEMETRY_FRAME_SIZE) {
+                TelemetryFrame frame;
+                if (decodeTelemetryFrame(payload + off, TELEMETRY_FRAME_SIZE, &frame) &&
+                    !replayedSeqs.insert(frame.seq).second) {
+                    duplicateFrames++;
+                }
+            }
+        }
+    });
+
+    setup();
+
+    hostNet().brokerAvailable = false;
+    uint64_t outageMs = (uint64_t)hours * 3600ULL * 1000ULL;
+    uint64_t outageEnd = hostClockMicros() / 1000 + outageMs;
+    uint32_t outageCycles = 0;
+    uint32_t outageImages = 0;
+    while (hostClockMicros() / 1000 < outageEnd) {
+        bool trigger = (outageCycles % 360) == 359;     // One cleaning event per hour
+        env.dust = trigger ? 220.0f : 60.0f;
+        env.humidity = trigger ? 40.0f : 70.0f;
+        if (trigger) {
+            setDaysSinceClean(DAYS_BETWEEN_CLEAN);
+            outageImages++;
+        }
+        hostClockAdvanceMs(INTERVAL_DAY + 1);           // Dust is sampled over the cycle
+        loop();
+        outageCycles++;
+    }
+    env.dust = 60.0f;
+    env.humidity = 70.0f;
+    OfflineQueueStats afterOutage = offlineQueueStats();
+
+    uint32_t imagesBefore = hostDashboardStats().imagesCompleted;
+    hostNet().brokerAvailable = true;
+    uint64_t catchStart = hostClockMicros();
+    double worstLoopMs = 0;
+    double worstTelemetryLoopMs = 0;
+    uint32_t loops = 0;
+    while (!offlineQueueEmpty() && loops < 1000000) {
+        uint32_t imagesNow = hostDashboardStats().imagesCompleted;
+        uint64_t t0 = hostClockMicros();
+        loop();
+        double ms = (hostClockMicros() - t0) / 1000.0;
+        if (ms > worstLoopMs) worstLoopMs = ms;
+        bool imageReplayed = hostDashboardStats().imagesCompleted != imagesNow;
+        if (!imageReplayed && loops > 0 && ms > worstTelemetryLoopMs) worstTelemetryLoopMs = ms;
+        hostClockAdvanceMs(1);
+        loops++;
+    }
+    double catchUpMs = (hostClockMicros() - catchStart) / 1000.0;
+    OfflineQueueStats afterReplay = offlineQueueStats();
+    uint32_t imagesReplayed = hostDashboardStats().imagesCompleted - imagesBefore;
+
+    bool contiguous = !replayedSeqs.empty() &&
+                      *replayedSeqs.rbegin() - *replayedSeqs.begin() + 1 == replayedSeqs.size();
+    benchCheck(afterOutage.dropped == 0, "outage fits in the partition without drops");
+    benchCheck(replayedSeqs.size() == outageCycles, "every offline frame replayed");
+    benchCheck(contiguous, "replayed frame sequence has no gaps");
+    benchCheck(duplicateFrames == 0, "no duplicate frames");
+    benchCheck(imagesReplayed == outageImages, "every offline image replayed");
+    benchCheck(afterReplay.depth == 0 && afterReplay.depthBytes == 0, "queue empty after catch-up");
+    // Budget is checked before each message, so one batch may overrun it
+    benchCheck(worstTelemetryLoopMs < OFFLINE_REPLAY_BUDGET_MS * 2, "replay respects the loop budget");
+
+    // --- 2. Power cut at every byte of a record write, then remount ---
+    uint32_t cutTrials = 0;
+    uint32_t cutFailures = 0;
+    for (int64_t cut = 0; cut <= 64; cut++) {
+        hostFlashWipe();
+        hostFlashRestorePower();
+        initOfflineQueue();
+        pushFrames(0, 100);                 // Crosses into a second sector
+        hostFlashPowerCutAfter(cut);
+        pushFrames(100, 1);
+        hostFlashRestorePower();
+        initOfflineQueue();                 // Reboot
+        uint32_t count = 0;
+        uint32_t first = 0;
+        bool ok = readAllFrames(&count, &first, false);
+        // The interrupted record either committed completely or is absent
+        ok = ok && first == 0 && (count == 100 || count == 101);
+        // The queue must keep working after recovery
+        uint32_t before = count;
+        ok = ok && pushFrames(before, 5) == 5 && readAllFrames(&count, &first, true) && count == before + 5;
+        ok = ok && offlineQueueEmpty();
+        cutTrials++;
+        if (!ok) cutFailures++;
+    }
+    benchCheck(cutFailures == 0, "recovery after power cut at every byte of a write");
+
+    // Power cut while marking records consumed
+    hostFlashWipe();
+    initOfflineQueue();
+    pushFrames(0, 200);
+    {
+        OfflineCursor cursor;
+        OfflineRecord rec;
+        uint8_t buf[64];
+        offlineQueueBegin(&cursor);
+        for (int i = 0; i < 150; i++) offlineQueueRead(&cursor, &rec, buf, sizeof(buf));
+        hostFlashPowerCutAfter(40);
+        offlineQueueConsume(cursor);
+        hostFlashRestorePower();
+        initOfflineQueue();
+        uint32_t count = 0;
+        uint32_t first = 0;
+        bool ok = readAllFrames(&count, &first, true);
+        benchCheck(ok && count >= 50 && count < 200 && first + count == 200,
+                   "consume interrupted by power cut resumes at an exact record");
+    }
+
+    // --- 3. Overflow of a small partition drops the oldest records ---
+    hostFlashAddPartition(OFFLINE_PARTITION_LABEL, 0x40, 8 * 4096);
+    initOfflineQueue();
+    uint32_t overflowPushed = pushFrames(0, 2000);
+    OfflineQueueStats overflow = offlineQueueStats();
+    uint32_t tailCount = 0;
+    uint32_t tailFirst = 0;
+    bool tailOk = readAllFrames(&tailCount, &tailFirst, true);
+    benchCheck(overflowPushed == 2000, "pushes succeed while full");
+    benchCheck(overflow.dropped > 0 && overflow.dropped + overflow.depth == 2000, "drops + depth == pushed");
+    benchCheck(tailOk && tailFirst + tailCount == 2000, "newest records kept without gaps");
+    hostFlashAddPartition(OFFLINE_PARTITION_LABEL, 0x40, 0x100000);
+
+    HostFlashStats flash = hostFlashStats();
+    if (json) {
+        printf("{\"bench\":\"offline_queue\",\"outage_hours\":%ld,\"outage_cycles\":%u,\"outage_images\":%u,"
+               "\"queued_bytes\":%u,\"catch_up_ms\":%.0f,\"replay_rate\":%.1f,\"replay_messages\":%u,"
+               "\"worst_loop_ms\":%.1f,\"worst_telemetry_loop_ms\":%.1f,\"power_cut_trials\":%u,"
+               "\"power_cut_failures\":%u,\"overflow_dropped\":%u,\"flash_bytes_written\":%llu,"
+               "\"sectors_erased\":%llu,\"failures\":%d}\n",
+               hours, outageCycles, outageImages, afterOutage.depthBytes, catchUpMs, afterReplay.lastReplayRate,
+               replayMessages, worstLoopMs, worstTelemetryLoopMs, cutTrials, cutFailures, overflow.dropped,
+               (unsigned long long)flash.bytesWritten, (unsigned long long)flash.sectorsErased, benchFailures());
+    } else {
+        printf("ArgoS offline queue harness\n");
+        printf("  outage              %ld h, %u cycles, %u images, %u records / %u KB queued\n", hours,
+               outageCycles, outageImages, afterOutage.depth, afterOutage.depthBytes / 1024);
+        printf("  catch-up            %.0f ms virtual, %.1f records/s, %u replay messages\n", catchUpMs,
+               afterReplay.lastReplayRate, replayMessages);
+        printf("  worst loop()        %.1f ms (%.1f ms without image replay, budget %d ms)\n", worstLoopMs,
+               worstTelemetryLoopMs, OFFLINE_REPLAY_BUDGET_MS);
+        printf("  power cut           %u trials, %u failed recoveries\n", cutTrials, cutFailures);
+        printf("  overflow            %u pushed into 32 KB, %u dropped, %u kept\n", overflowPushed,
+               overflow.dropped, overflow.depth);
+        printf("  flash               %llu KB written, %llu sectors erased\n",
+               (unsigned long long)(flash.bytesWritten / 1024), (unsigned long long)flash.sectorsErased);
+        printf("  %s\n", benchFailures() ? "FAILED" : "OK");
+    }
+    return benchFailures() ? 1 : 0;
+}
@@ -0,0 +1,288 @@
+// Runtime instrumentation (perf_metrics.h): what a probe costs, and what the
+// metrics topic reports from the real setup()/loop().
+//
+// 1. Probe cost: PERF_SCOPE around an empty block, wall clock per probe, and
+//    that cost against one loop() pass. Histogram placement, percentiles and
+//    the interval diff checked on known samples.
+// 2. Firmware run: day and night passes with a broker outage in the middle.
+//    Every report on TOPIC_METRICS is parsed: the intervals add up to the
+//    run, loop() passes and sensor reads match what the harness drove, the
+//    outage shows as failed connects and a longer interval, heap low-water
+//    marks are at or under the free heap.
+// 3. Publish benchFailures(): while the broker's Maximum Packet Size is below the
+//    aggregates (and the report itself), the refused publishes are counted
+//    and the first report after the limit is lifted carries them; without
+//    the limit there are none.
+//
+// Latencies are virtual time (the host stand-ins advance the clock by what
+// the hardware would take), so stage figures are stable between machines.
+//
+// Exits non-zero if a probe costs more than --max-probe-ns (default 250) or
+// a check above fails.
+//
+//   .pio/build/bench_perf/program [--hours N] [--max-probe-ns N] [--json]
+
+#include <Arduino.h>
+#include <string>
+#include <vector>
+#include "host_sim.h"
+#include "bench_util.h"
+#include "config.h"
+#include "core.h"
+#include "perf_metrics.h"
+#include "mqtt_client.h"
+
+void setup();
+void loop();
+extern MqttClient client;
+extern SystemMode currentMode;
+extern unsigned long lastCheckTime;
+
+static const uint32_t PASS_MS = 1000;           // Virtual time between loop() passes
+
+// ============================================================================
+// PROBES
+// ============================================================================
+
+static volatile uint32_t sink = 0;
+
+static double probeNs(uint32_t n) {
+    uint64_t start = benchNowNs();
+    for (uint32_t i = 0; i < n; i++) {
+        PERF_SCOPE(PERF_LIGHT);
+        sink = sink + 1;
+    }
+    uint64_t probed = benchNowNs() - start;
+    start = benchNowNs();
+    for (uint32_t i = 0; i < n; i++) sink = sink + 1;
+    uint64_t bare = benchNowNs() - start;
+    return probed > bare ? (double)(probed - bare) / n : 0;
+}
+
+// Known samples through perfRecord(): buckets, percentiles, interval diff
+static bool histogramChecks() {
+    perfReset();
+    PerfReport report;
+    bool ok = !perfReportDue(&report);
+    for (int i = 0; i < 90; i++) perfRecord(PERF_DECISION, 100);       // Bucket 7: [64, 128)
+    for (int i = 0; i < 10; i++) perfRecord(PERF_DECISION, 3000);      // Bucket 12: [2048, 4096)
+    perfRecord(PERF_CAMERA, 0);
+    perfRecord(PERF_CAMERA, 0xFFFFFFFF);                                // Open-ended last bucket
+    perfCount(PERF_CONNECTS);
+    hostClockAdvanceMs(PERF_REPORT_MS);
+    ok &= perfReportDue(&report);
+    const PerfStageSummary& d = report.stage[PERF_DECISION];
+    ok &= d.count == 100 && d.buckets[7] == 90 && d.buckets[12] == 10;
+    ok &= d.avgUs == 390 && d.p50Us == 128 && d.p95Us == 3000 && d.maxUs == 3000;
+    const PerfStageSummary& c = report.stage[PERF_CAMERA];
+    ok &= c.count == 2 && c.buckets[0] == 1 && c.buckets[PERF_BUCKETS - 1] == 1 && c.p95Us == 0xFFFFFFFF;
+    ok &= report.counters[PERF_CONNECTS] == 1 && report.stage[PERF_LOOP].count == 0;
+
+    // Next interval: only what came after
+    perfRecord(PERF_DECISION, 5);
+    hostClockAdvanceMs(PERF_REPORT_MS);
+    ok &= perfReportDue(&report);
+    ok &= report.stage[PERF_DECISION].count == 1 && report.stage[PERF_DECISION].maxUs == 5;
+    ok &= report.counters[PERF_CONNECTS] == 0;
+
+    char json[PERF_REPORT_BUFFER];
+    size_t len = perfReportJson(report, json, sizeof(json));
+    ok &= len > 0 && strstr(json, "\"decision\":[1,5,5,5,5,3,1]") != nullptr;
+    ok &= perfReportJson(report, json, 40) == 0;                        // Too small: nothing
+    return ok;
+}
+
+// ============================================================================
+// FIRMWARE RUN
+// ============================================================================
+
+// Fields of one metrics message
+struct Metrics {
+    uint32_t ms;
+    uint32_t heap[2];
+    uint32_t psram[2];
+    uint32_t pubFail;
+    uint32_t conn;
+    uint32_t connFail;
+    uint32_t stage[PERF_STAGES][5];     // n, avg, p50, p95, max (0 if left out)
+};
+
+static uint32_t field(const std::string& json, const char* key, int index = 0) {
+    size_t at = json.find(std::string("\"") + key + "\":");
+    if (at == std::string::npos) return 0;
+    at += strlen(key) + 3;
+    if (json[at] == '[') at++;
+    for (int i = 0; i < index; i++) at = json.find(',', at) + 1;
+    return (uint32_t)strtoul(json.c_str() + at, nullptr, 10);
+}
+
+static Metrics parseMetrics(const std::string& json) {
+    Metrics m = {};
+    m.ms = field(json, "ms");
+    m.heap[0] = field(json, "heap");
+    m.heap[1] = field(json, "heap", 1);
+    m.psram[0] = field(json, "psram");
+    m.psram[1] = field(json, "psram", 1);
+    m.pubFail = field(json, "pub_fail");
+    m.conn = field(json, "conn");
+    m.connFail = field(json, "conn_fail");
+    for (uint8_t s = 0; s < PERF_STAGES; s++) {
+        for (int i = 0; i < 5; i++) m.stage[s][i] = field(json, perfStageName((PerfStage)s), i);
+    }
+    return m;
+}
+
+struct Run {
+    std::vector<Metrics> reports;
+    size_t maxBytes;
+    uint32_t passes;
+    uint32_t dayCycles;         // Cycles that read climate and dust
+    uint64_t ms;                // perfReset() to the last pass
+    uint64_t outageMs;
+    uint32_t loopMaxUs;         // Worst loop() pass seen in the reports
+    double passWallNs;          // Mean wall time of one loop() pass
+};
+
+static Run firmwareRun(double hours, bool outage, uint32_t maxPacket) {
+    Run run = {};
+    client.disconnect();
+    hostReset();
+    hostSerialEcho(false);
+    hostCameraSetFrameSize(24 * 1024);
+    hostBroker().maxPacket = maxPacket;
+    std::string metricsTopic = MQTT_TOPIC(TOPIC_METRICS);
+    hostBroker().addObserver([&](const std::string& topic, const uint8_t* payload, size_t len) {
+        if (topic != metricsTopic) return;
+        HostAllocPause pause;
+        run.reports.push_back(parseMetrics(std::string((const char*)payload, len)));
+        if (len > run.maxBytes) run.maxBytes = len;
+    });
+
+    setup();
+    setDaysSinceClean(0);                           // Globals outlive setup() on the host
+    perfReset();
+    uint64_t startMs = hostClockMicros() / 1000;
+
+    // Day, then night: sensors and camera first, light only after
+    uint32_t passes = (uint32_t)(hours * 3600 * 1000 / PASS_MS);
+    uint32_t outageStart = passes / 3, outageEnd = outageStart + passes / 6;
+    uint64_t wallNs = 0;
+    for (uint32_t p = 0; p < passes; p++) {
+        hostEnv().lux = p < passes / 2 ? 40000.0f : 2.0f;
+        if (outage && p == outageStart) hostNet().brokerAvailable = false;
+        if (outage && p == outageEnd) hostNet().brokerAvailable = true;
+        // Limit lifted halfway: a broker restart, the reconnect gets no maximum
+        if (maxPacket && p == passes / 2) {
+            hostBroker().maxPacket = 0;
+            hostNet().brokerAvailable = false;
+        }
+        if (maxPacket && p == passes / 2 + 1) hostNet().brokerAvailable = true;
+        unsigned long cycleBefore = lastCheckTime;
+        uint64_t t0 = benchNowNs();
+        loop();
+        wallNs += benchNowNs() - t0;
+        if (lastCheckTime != cycleBefore && currentMode == MODE_DAY) run.dayCycles++;
+        hostClockAdvanceMs(PASS_MS);
+    }
+    run.passes = passes;
+    run.ms = hostClockMicros() / 1000 - startMs;
+    run.outageMs = outage ? (uint64_t)(outageEnd - outageStart) * PASS_MS : 0;
+    run.passWallNs = (double)wallNs / passes;
+    for (size_t i = 0; i < run.reports.size(); i++) {
+        if (run.reports[i].stage[PERF_LOOP][4] > run.loopMaxUs) run.loopMaxUs = run.reports[i].stage[PERF_LOOP][4];
+    }
+    return run;
+}
+
+static uint64_t total(const Run& run, uint8_t stage) {
+    uint64_t n = 0;
+    for (size_t i = 0; i < run.reports.size(); i++) n += run.reports[i].stage[stage][0];
+    return n;
+}
+
+static uint64_t totalOf(const Run& run, uint32_t Metrics::*counter) {
+    uint64_t n = 0;
+    for (size_t i = 0; i < run.reports.size(); i++) n += run.reports[i].*counter;
+    return n;
+}
+
+int main(int argc, char** argv) {
+    bool json = benchHasFlag(argc, argv, "--json");
+    long hours = benchArg(argc, argv, "--hours", 6);
+    long maxProbeNs = benchArg(argc, argv, "--max-probe-ns", 250);
+
+    hostPowerCycle();
+    probeNs(100000);                                // Warm-up
+    double probe = probeNs(2000000);
+    bool histOk = histogramChecks();
+
+    Run run = firmwareRun(hours, true, 0);
+    Run shrunk = firmwareRun(2, false, 128);        // No stats JSON fits, for the first hour
+
+    // Reports cover the run up to the last one
+    uint64_t reportedMs = totalOf(run, &Metrics::ms);
+    uint64_t longest = 0;
+    for (size_t i = 0; i < run.reports.size(); i++) longest = std::max<uint64_t>(longest, run.reports[i].ms);
+    uint64_t loops = total(run, PERF_LOOP);
+    uint32_t lowWaterOk = 0;
+    for (size_t i = 0; i < run.reports.size(); i++) {
+        const Metrics& m = run.reports[i];
+        lowWaterOk += m.heap[1] <= m.heap[0] && m.heap[1] > 0 && m.psram[1] <= m.psram[0];
+    }
+
+    benchCheck(histOk, "histogram buckets, percentiles or interval diff");
+    benchCheck(probe <= maxProbeNs, "probe too slow");
+    benchCheck(run.reports.size() >= (run.ms - run.outageMs) / PERF_REPORT_MS - 1, "metrics reports missing");
+    benchCheck(reportedMs <= run.ms && reportedMs + PERF_REPORT_MS + PASS_MS >= run.ms, "report intervals do not add up");
+    benchCheck(longest >= run.outageMs, "outage not folded into one interval");
+    benchCheck(loops <= run.passes && loops + (PERF_REPORT_MS / PASS_MS) + 1 >= run.passes, "loop() passes miscounted");
+    benchCheck(total(run, PERF_LIGHT) == loops, "light reads miscounted");
+    benchCheck(total(run, PERF_DECISION) + 1 >= run.dayCycles && total(run, PERF_DECISION) <= run.dayCycles,
+               "decisions miscounted");
+    benchCheck(total(run, PERF_SENSORS) >= total(run, PERF_DECISION), "sensor reads miscounted");
+    benchCheck(total(run, PERF_MQTT) > 0 && total(run, PERF_TELEMETRY) > 0, "network side not timed");
+    benchCheck(totalOf(run, &Metrics::conn) >= 1 && totalOf(run, &Metrics::connFail) >= 1, "outage connects not counted");
+    // Failed broker lookups count as failed connects without an attempt
+    benchCheck(total(run, PERF_RECONNECT) >= totalOf(run, &Metrics::conn) &&
+               total(run, PERF_RECONNECT) <= totalOf(run, &Metrics::conn) + totalOf(run, &Metrics::connFail),
+               "connect attempts not timed");
+    benchCheck(totalOf(run, &Metrics::pubFail) == 0, "publish benchFailures() with a normal buffer");
+    benchCheck(lowWaterOk == run.reports.size(), "low-water mark above the free memory");
+    benchCheck(run.maxBytes <= PERF_REPORT_BUFFER, "report over its buffer");
+    benchCheck(totalOf(shrunk, &Metrics::pubFail) > 0, "refused publishes not counted");
+
+    if (json) {
+        printf("{\"bench\":\"perf\",\"probe_ns\":%.1f,\"pass_ns\":%.0f,\"reports\":%u,\"max_bytes\":%u,"
+               "\"conn\":%llu,\"conn_fail\":%llu,\"pub_fail_shrunk\":%llu,\"failures\":%d}\n",
+               probe, run.passWallNs, (unsigned)run.reports.size(), (unsigned)run.maxBytes,
+               (unsigned long long)totalOf(run, &Metrics::conn), (unsigned long long)totalOf(run, &Metrics::connFail),
+               (unsigned long long)totalOf(shrunk, &Metrics::pubFail), benchFailures());
+        return benchFailures() ? 1 : 0;
+    }
+
+    printf("ArgoS runtime metrics benchmark (%ld h, broker down %.0f min)\n", hours, run.outageMs / 60000.0);
+    printf("  probe               %.1f ns (%.2f %% of a %.0f us loop() pass on this host)\n", probe,
+           probe * 100 / run.passWallNs, run.passWallNs / 1000);
+    printf("  histogram           %s\n", histOk ? "ok" : "WRONG");
+    printf("  reports             %u on TOPIC_METRICS, largest %u bytes, longest interval %.0f s\n",
+           (unsigned)run.reports.size(), (unsigned)run.maxBytes, longest / 1000.0);
+    printf("  stage               count     worst p95 us    worst max us\n");
+    for (uint8_t s = 0; s < PERF_STAGES; s++) {
+        uint32_t p95 = 0, max = 0;
+        for (size_t i = 0; i < run.reports.size(); i++) {
+            p95 = std::max(p95, run.reports[i].stage[s][3]);
+            max = std::max(max, run.reports[i].stage[s][4]);
+        }
+        printf("  %-16s %9llu  %15u  %14u\n", perfStageName((PerfStage)s), (unsigned long long)total(run, s), p95,
+               max);
+    }
+    printf("  connects            %llu ok, %llu failed during the outage\n",
+           (unsigned long long)totalOf(run, &Metrics::conn), (unsigned long long)totalOf(run, &Metrics::connFail));
+    printf("  publish benchFailures()    %llu (no limit), %llu (broker maximum packet 128 bytes)\n",
+           (unsigned long long)totalOf(run, &Metrics::pubFail), (unsigned long long)totalOf(shrunk, &Metrics::pubFail));
+    printf("  memory              heap min %u / free %u, PSRAM min %u / free %u (last report)\n",
+           run.reports.empty() ? 0 : run.reports.back().heap[1], run.reports.empty() ? 0 : run.reports.back().heap[0],
+           run.reports.empty() ? 0 : run.reports.back().psram[1], run.reports.empty() ? 0 : run.reports.back().psram[0]);
+    printf("%s\n", benchFailures() ? "FAILED" : "OK");
+    return benchFailures() ? 1 : 0;
+}
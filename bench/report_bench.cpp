@@ -0,0 +1,455 @@
+// Report by exception (report.h): replays a day of sensor readings through
+// the real setup()/loop(), once publishing every value as before and once
+// with the deadbands, heartbeat and hysteresis of config.h.
+//
+// 1. Traffic: telemetry, alert and mode messages, their bytes and an
+//    estimate of the radio time (fixed cost per message plus airtime per
+//    byte), with the sent / held back / heartbeat counters. Aggregates
+//    (TOPIC_STATS, once per heartbeat), metrics, logs and images are listed
+//    apart, then everything together: report by exception does not touch
+//    them, so the total drops less.
+// 2. Fidelity: after every cycle, the value the dashboard holds for each
+//    metric is within its deadband of what the firmware measured, and no
+//    measured metric goes quieter than the heartbeat.
+// 3. Mode and alert: mode changes published against the changes a plain
+//    threshold would make on the same light readings; the same cleaning
+//    alerts raised in both runs, and the alert cleared at the end.
+// 4. Deep sleep: the state saved to RTC memory gives the same decisions
+//    after a restore, and a sleep past the heartbeat sends everything.
+// 5. Back-pressure: with the runtime queue full, two telemetry records due
+//    for different values coalesce in the latest-wins slot; both values
+//    still reach the broker.
+//
+// The default trace is synthetic: sun with passing clouds and sensor noise
+// (lux crossing MIN_LUX_DAY_MODE slowly at dawn and dusk), temperature and
+// humidity following the day, dust with one event at midday. A recorded one
+// can be given as CSV: seconds,temp,humidity,lux,dust (header line optional,
+// values interpolated between rows).
+//
+// Exits non-zero if the reduction of telemetry + alert + mode messages is
+// under --min-reduction (default 10x) or a check above fails.
+//
+//   .pio/build/bench_report/program [--hours N] [--trace file.csv] [--min-reduction N] [--json]
+
+#include <Arduino.h>
+#include <string>
+#include <vector>
+#include "host_sim.h"
+#include "bench_util.h"
+#include "config.h"
+#include "core.h"
+#include "report.h"
+#include "runtime.h"
+#include "telemetry_frame.h"
+#include "mqtt_client.h"
+
+void setup();
+void loop();
+extern MqttClient client;
+extern SensorBank bank;
+extern SystemMode currentMode;
+extern unsigned long lastCheckTime;
+
+static const uint32_t PASS_MS = 1000;           // Virtual time between loop() passes
+static const uint32_t WARMUP_S = 120;           // Connect and first cycles, not counted
+static const double RADIO_MSG_US = 1500.0;      // Per message: channel access, ACKs, TCP/MQTT headers
+static const double RADIO_BYTE_US = 1.23;       // Per byte at 6.5 Mbit/s (802.11n MCS0)
+
+static uint32_t rng = 0x2545F491;
+
+static float noise() {
+    rng ^= rng << 13;
+    rng ^= rng >> 17;
+    rng ^= rng << 5;
+    return (rng & 0xFFFFFF) / 8388608.0f - 1.0f;    // -1..1
+}
+
+// ============================================================================
+// TRACE
+// ============================================================================
+
+struct TraceRow {
+    double t;
+    HostEnvironment env;
+};
+
+static std::vector<TraceRow> recorded;
+static double traceSeconds = 0;
+
+static bool loadTrace(const char* path) {
+    FILE* f = fopen(path, "r");
+    if (!f) return false;
+    char line[256];
+    while (fgets(line, sizeof(line), f)) {
+        TraceRow row;
+        if (sscanf(line, "%lf,%f,%f,%f,%f", &row.t, &row.env.temp, &row.env.humidity, &row.env.lux,
+                   &row.env.dust) == 5) {
+            recorded.push_back(row);
+        }
+    }
+    fclose(f);
+    if (recorded.size() < 2) return false;
+    traceSeconds = recorded.back().t - recorded.front().t;
+    return traceSeconds > 0;
+}
+
+// Starts at midnight. Clouds are slow sums of sines, so both runs see the
+// same sky; the sensor noise comes from the seeded generator.
+static HostEnvironment synthetic(double t) {
+    double h = fmod(t / 3600.0, 24.0);
+    double sun = h > 6 && h < 18 ? sin(M_PI * (h - 6) / 12) : 0;
+    double sky = sin(t / 700.0) + 0.8 * sin(t / 1900.0 + 1) + 0.3 * sin(t / 310.0 + 2);
+    double clouds = sky > 0.6 ? 1.0 - 0.35 * (sky - 0.6) : 1.0;
+    double warm = sin(M_PI * (h - 9) / 12);
+    bool dustEvent = h >= 13 && h < 14;
+
+    HostEnvironment env;
+    env.lux = (float)(90000.0 * pow(sun, 1.3) * clouds * (1 + 0.03 * noise()) + 2);
+    env.temp = (float)(17 + 9 * warm + 0.1 * noise());
+    env.humidity = (float)(70 - 25 * warm + 0.5 * noise());
+    env.dust = (float)(45 + 8 * sin(t / 5000.0) + 4 * noise() + (dustEvent ? 170 : 0));
+    return env;
+}
+
+static HostEnvironment traceAt(double t) {
+    if (recorded.empty()) return synthetic(t);
+    t += recorded.front().t;
+    size_t i = 1;
+    while (i + 1 < recorded.size() && recorded[i].t < t) i++;
+    const TraceRow& a = recorded[i - 1];
+    const TraceRow& b = recorded[i];
+    float k = (float)((t - a.t) / (b.t - a.t));
+    k = k < 0 ? 0 : k > 1 ? 1 : k;
+    HostEnvironment env;
+    env.temp = a.env.temp + (b.env.temp - a.env.temp) * k;
+    env.humidity = a.env.humidity + (b.env.humidity - a.env.humidity) * k;
+    env.lux = a.env.lux + (b.env.lux - a.env.lux) * k;
+    env.dust = a.env.dust + (b.env.dust - a.env.dust) * k;
+    return env;
+}
+
+// ============================================================================
+// FIRMWARE RUN
+// ============================================================================
+
+struct Run {
+    uint64_t scopedMsgs;        // Telemetry, alert and mode
+    uint64_t scopedBytes;
+    uint64_t otherMsgs;         // Aggregates, metrics, logs, images...
+    uint64_t aggregateMsgs;     // TOPIC_STATS
+    uint64_t metricsMsgs;
+    uint64_t logMsgs;
+    uint32_t modeMsgs;
+    uint32_t alertsRaised;      // "true" after a "false" (or first)
+    bool alertClear;            // Last alert published was "false"
+    uint32_t cycles;
+    uint32_t outOfBand;         // Dashboard value past the deadband of the measurement
+    double worstSilenceS;       // Longest a measured metric went unpublished
+    ReportStats stats;
+};
+
+static double radioMs(const Run& r) {
+    return (r.scopedMsgs * RADIO_MSG_US + r.scopedBytes * RADIO_BYTE_US) / 1000.0;
+}
+
+static Run replay(bool exceptions, double seconds) {
+    Run run = {};
+    client.disconnect();
+    hostReset();
+    hostSerialEcho(false);
+    hostCameraSetFrameSize(24 * 1024);
+    rng = 0x2545F491;
+    hostEnv() = traceAt(0);
+
+    static std::string topics[REPORT_METRICS];
+    topics[REPORT_TEMP] = MQTT_TOPIC(TOPIC_TEMP);
+    topics[REPORT_HUMIDITY] = MQTT_TOPIC(TOPIC_HUM);
+    topics[REPORT_LUX] = MQTT_TOPIC(TOPIC_LUX);
+    topics[REPORT_DUST] = MQTT_TOPIC(TOPIC_DUST);
+    topics[REPORT_SOILING] = MQTT_TOPIC(TOPIC_SOILING);
+    static const float halfStep[REPORT_METRICS] = {0.05f, 0.05f, 0.5f, 0.5f, 0.5f};
+    std::string alertTopic = MQTT_TOPIC(TOPIC_ALERT);
+    std::string modeTopic = MQTT_TOPIC(TOPIC_MODE);
+    std::string replayTopic = MQTT_TOPIC(TOPIC_REPLAY);
+    std::string metricsTopic = MQTT_TOPIC(TOPIC_METRICS);
+    std::string logTopic = MQTT_TOPIC(TOPIC_LOG);
+    const size_t statsLen = strlen(TOPIC_STATS);
+
+    float held[REPORT_METRICS];
+    uint64_t heldAt[REPORT_METRICS];
+    for (int m = 0; m < REPORT_METRICS; m++) held[m] = NAN;
+    int lastAlert = -1;
+    bool counting = false;
+    hostBroker().addObserver([&](const std::string& topic, const uint8_t* payload, size_t len) {
+        HostAllocPause pause;
+        std::string value((const char*)payload, len);
+        bool scoped = topic == alertTopic || topic == modeTopic || topic == replayTopic;
+        // Cycles queued while offline reach the dashboard as frames
+        TelemetryFrame frame;
+        size_t used;
+        for (size_t at = 0; topic == replayTopic && at < len; at += used) {
+            if (!decodeTelemetryFrame(payload + at, len - at, &frame, &used)) break;
+            const float values[REPORT_SOILING] = {frame.status.temp, frame.status.humidity, frame.status.lux,
+                                                  frame.status.dust};
+            for (int m = 0; m < REPORT_SOILING; m++) {
+                if (isnan(values[m])) continue;
+                held[m] = values[m];
+                heldAt[m] = hostClockMicros();
+            }
+        }
+        for (int m = 0; m < REPORT_METRICS; m++) {
+            if (topic.compare(0, topics[m].size(), topics[m]) != 0) continue;
+            std::string rest = topic.substr(topics[m].size());
+            if (rest.empty()) {
+                held[m] = strtof(value.c_str(), nullptr);
+                heldAt[m] = hostClockMicros();
+            }
+            scoped |= rest.empty() || (rest[0] == '/' && isdigit((unsigned char)rest[1]));
+        }
+        if (topic == alertTopic) {
+            int state = value == "true";
+            if (counting && state && lastAlert != 1) run.alertsRaised++;
+            lastAlert = state;
+        }
+        if (!counting) return;
+        if (scoped) {
+            run.scopedMsgs++;
+            run.scopedBytes += topic.size() + len;
+            if (topic == modeTopic) run.modeMsgs++;
+        } else {
+            run.otherMsgs++;
+            if (topic.size() > statsLen && topic.compare(topic.size() - statsLen, statsLen, TOPIC_STATS) == 0) {
+                run.aggregateMsgs++;
+            }
+            if (topic == metricsTopic) run.metricsMsgs++;
+            if (topic == logTopic) run.logMsgs++;
+        }
+    });
+
+    setup();
+    ReportConfig config = reportConfigDefault();
+    config.enabled = exceptions;
+    reportConfigure(config);
+    setDaysSinceClean(DAYS_BETWEEN_CLEAN);          // Globals outlive setup() on the host
+
+    const ReportConfig& def = reportConfigDefault();
+    uint64_t passes = (uint64_t)(seconds * 1000 / PASS_MS);
+    for (uint64_t p = 0; p < passes; p++) {
+        double t = p * (PASS_MS / 1000.0);
+        if (!counting && t >= WARMUP_S) {
+            counting = true;
+            reportResetStats();
+        }
+        hostEnv() = traceAt(t);
+        unsigned long cycleBefore = lastCheckTime;
+        loop();
+        hostClockAdvanceMs(PASS_MS);
+        if (!counting || lastCheckTime == cycleBefore) continue;
+
+        // A cycle ran and its messages went out: what the dashboard shows
+        run.cycles++;
+        const float measured[REPORT_METRICS] = {bank.temp[0], bank.humidity[0], bank.lux[0], bank.dust[0], NAN};
+        for (int m = 0; m < REPORT_SOILING; m++) {
+            if (isnan(measured[m])) continue;
+            if (isnan(held[m])) {
+                run.outOfBand++;
+                continue;
+            }
+            const Deadband& band = def.deadband[m];
+            float limit = band.rel * fabsf(held[m]);
+            if (limit < band.abs) limit = band.abs;
+            if (exceptions && fabsf(measured[m] - held[m]) > limit + halfStep[m]) run.outOfBand++;
+            if (!exceptions && fabsf(measured[m] - held[m]) > halfStep[m]) run.outOfBand++;
+            double silence = (hostClockMicros() - heldAt[m]) / 1e6;
+            if (silence > run.worstSilenceS) run.worstSilenceS = silence;
+        }
+    }
+    run.alertClear = lastAlert == 0;
+    run.stats = reportStats();
+    return run;
+}
+
+// ============================================================================
+// MODE FLAPPING AND RTC STATE
+// ============================================================================
+
+// Mode changes on the light readings of the trace, as loop() reads them (one
+// per pass): plain threshold against hysteresis
+static void countModeChanges(double seconds, uint32_t* plain, uint32_t* hysteresis) {
+    rng = 0x2545F491;
+    SystemMode a = MODE_BOOT, b = MODE_BOOT;
+    *plain = *hysteresis = 0;
+    uint64_t passes = (uint64_t)(seconds * 1000 / PASS_MS);
+    for (uint64_t p = 0; p < passes; p++) {
+        float lux = traceAt(p * (PASS_MS / 1000.0)).lux;
+        SystemMode na = lux >= MIN_LUX_DAY_MODE ? MODE_DAY : MODE_NIGHT;
+        SystemMode nb = determineOperationMode(lux, b);
+        if (a != MODE_BOOT && na != a) (*plain)++;
+        if (b != MODE_BOOT && nb != b) (*hysteresis)++;
+        a = na;
+        b = nb;
+    }
+}
+
+static bool rtcRoundTrip() {
+    hostReset();
+    reportConfigure(reportConfigDefault());
+    SensorBank b;
+    memset(&b, 0, sizeof(b));
+    b.channels = 2;
+    for (uint8_t i = 0; i < 2; i++) {
+        b.temp[i] = 25.0f + i;
+        b.humidity[i] = 40.0f;
+        b.lux[i] = 30000.0f;
+        b.dust[i] = 60.0f;
+    }
+    SystemStatus s = {b.temp[0], b.humidity[0], b.lux[0], b.dust[0], NAN, 30.0f, MODE_DAY};
+    bool alert;
+    bool ok = !reportMaskEmpty(reportTelemetry(s, b));
+    ok &= reportAlert(false, &alert) && reportMode(MODE_DAY);
+    hostClockAdvanceMs(INTERVAL_DAY);
+
+    ReportState saved = reportSaveState();
+    reportConfigure(reportConfigDefault());         // Deep sleep: RAM lost
+    reportRestoreState(saved, INTERVAL_DAY);
+    ok &= reportMaskEmpty(reportTelemetry(s, b)) && !reportAlert(false, &alert) && !reportMode(MODE_DAY);
+
+    b.dust[1] = 90.0f;                              // Past the deadband: that value only
+    ReportMask mask = reportTelemetry(s, b);
+    ok &= mask.channels[REPORT_DUST] == 2 && mask.channels[REPORT_TEMP] == 0;
+
+    saved = reportSaveState();
+    reportConfigure(reportConfigDefault());
+    reportRestoreState(saved, REPORT_HEARTBEAT_MS);
+    mask = reportTelemetry(s, b);
+    ok &= mask.channels[REPORT_TEMP] == 3 && mask.channels[REPORT_LUX] == 3 && mask.channels[REPORT_SOILING] == 1;
+    ok &= reportAlert(false, &alert) && !alert && reportMode(MODE_DAY);
+    return ok;
+}
+
+static bool coalescedMasks() {
+    client.disconnect();
+    hostReset();
+    hostSerialEcho(false);
+    setup();
+    for (uint32_t ms = 0; ms < WARMUP_S * 1000 && !client.connected(); ms += PASS_MS) {
+        loop();
+        hostClockAdvanceMs(PASS_MS);
+    }
+    std::string tempTopic = MQTT_TOPIC(TOPIC_TEMP);
+    std::string dustTopic = MQTT_TOPIC(TOPIC_DUST);
+    uint32_t temps = 0, dusts = 0;
+    hostBroker().addObserver([&](const std::string& topic, const uint8_t* payload, size_t len) {
+        (void)payload;
+        (void)len;
+        if (topic == tempTopic) temps++;
+        if (topic == dustTopic) dusts++;
+    });
+
+    // The network side does not run: the queue fills, then the slot
+    SensorBank b;
+    memset(&b, 0, sizeof(b));
+    b.channels = 1;
+    b.temp[0] = 21.5f;
+    b.dust[0] = 70.0f;
+    SystemStatus s = {b.temp[0], b.humidity[0], b.lux[0], b.dust[0], NAN, 30.0f, MODE_DAY};
+    ReportMask none, dust, temp;
+    memset(&none, 0, sizeof(none));
+    dust = none;
+    temp = none;
+    dust.channels[REPORT_DUST] = 1;
+    temp.channels[REPORT_TEMP] = 1;
+    for (uint32_t i = 0; i < RUNTIME_QUEUE_LENGTH; i++) runtimeSubmitTelemetry(s, b, none);
+    uint32_t coalescedBefore = runtimeStats().coalesced;
+    runtimeSubmitTelemetry(s, b, dust);
+    runtimeSubmitTelemetry(s, b, temp);
+    bool coalesced = runtimeStats().coalesced == coalescedBefore + 2;
+
+    for (uint32_t i = 0; i < 100 && !runtimeIdle(); i++) {
+        runtimeNetworkStep();
+        runtimeRetryPending();
+        hostClockAdvanceMs(1);
+    }
+    return coalesced && temps == 1 && dusts == 1;
+}
+
+int main(int argc, char** argv) {
+    bool json = benchHasFlag(argc, argv, "--json");
+    long hours = benchArg(argc, argv, "--hours", 24);
+    long minReduction = benchArg(argc, argv, "--min-reduction", 10);
+    const char* tracePath = benchArgStr(argc, argv, "--trace", nullptr);
+
+    double seconds = hours * 3600.0;
+    if (tracePath) {
+        if (!loadTrace(tracePath)) {
+            printf("Cannot read trace %s (seconds,temp,humidity,lux,dust)\n", tracePath);
+            return 2;
+        }
+        seconds = traceSeconds;
+    }
+
+    hostPowerCycle();
+    Run every = replay(false, seconds);
+    Run rbe = replay(true, seconds);
+    uint32_t plainChanges, hystChanges;
+    countModeChanges(seconds, &plainChanges, &hystChanges);
+    bool rtcOk = rtcRoundTrip();
+    bool coalesceOk = coalescedMasks();
+
+    double reduction = rbe.scopedMsgs ? (double)every.scopedMsgs / rbe.scopedMsgs : 0;
+    uint64_t everyTotal = every.scopedMsgs + every.otherMsgs;
+    uint64_t rbeTotal = rbe.scopedMsgs + rbe.otherMsgs;
+    double totalReduction = rbeTotal ? (double)everyTotal / rbeTotal : 0;
+    benchCheck(reduction >= minReduction, "telemetry + alert + mode messages not reduced enough");
+    benchCheck(rbe.outOfBand == 0, "dashboard value outside the deadband of the measurement");
+    benchCheck(every.outOfBand == 0, "dashboard value differs with every value published");
+    benchCheck(rbe.worstSilenceS * 1000 <= REPORT_HEARTBEAT_MS + INTERVAL_NIGHT, "metric silent past the heartbeat");
+    benchCheck(rbe.alertsRaised == every.alertsRaised, "alerts raised differ");
+    benchCheck(rbe.alertClear && every.alertClear, "alert not cleared at the end");
+    benchCheck(hystChanges <= plainChanges && rbe.modeMsgs <= hystChanges + seconds * 1000 / REPORT_HEARTBEAT_MS + 1,
+               "mode published more than it changed");
+    benchCheck(rtcOk, "report state across deep sleep");
+    benchCheck(coalesceOk, "value lost when telemetry records coalesced");
+
+    if (json) {
+        printf("{\"bench\":\"report\",\"seconds\":%.0f,\"every_msgs\":%llu,\"rbe_msgs\":%llu,\"every_bytes\":%llu,"
+               "\"rbe_bytes\":%llu,\"reduction\":%.1f,\"radio_ms_every\":%.1f,\"radio_ms_rbe\":%.1f,"
+               "\"every_total_msgs\":%llu,\"rbe_total_msgs\":%llu,\"total_reduction\":%.1f,\"aggregate_msgs\":%llu,"
+               "\"metrics_msgs\":%llu,\"log_msgs\":%llu,\"mode_changes_plain\":%u,\"mode_changes_hysteresis\":%u,"
+               "\"failures\":%d}\n",
+               seconds, (unsigned long long)every.scopedMsgs, (unsigned long long)rbe.scopedMsgs,
+               (unsigned long long)every.scopedBytes, (unsigned long long)rbe.scopedBytes, reduction,
+               radioMs(every), radioMs(rbe), (unsigned long long)everyTotal, (unsigned long long)rbeTotal,
+               totalReduction, (unsigned long long)rbe.aggregateMsgs, (unsigned long long)rbe.metricsMsgs,
+               (unsigned long long)rbe.logMsgs, plainChanges, hystChanges, benchFailures());
+        return benchFailures() ? 1 : 0;
+    }
+
+    printf("ArgoS report-by-exception benchmark (%s, %.1f h, %u cycles)\n",
+           tracePath ? tracePath : "synthetic trace", seconds / 3600.0, rbe.cycles);
+    printf("                      messages     bytes   radio ms   sent  held back  heartbeats   other msgs\n");
+    printf("  every value         %8llu  %8llu  %9.1f  %5u  %9u  %10u   %10llu\n",
+           (unsigned long long)every.scopedMsgs, (unsigned long long)every.scopedBytes, radioMs(every),
+           every.stats.sent, every.stats.suppressed, every.stats.heartbeats, (unsigned long long)every.otherMsgs);
+    printf("  by exception        %8llu  %8llu  %9.1f  %5u  %9u  %10u   %10llu\n",
+           (unsigned long long)rbe.scopedMsgs, (unsigned long long)rbe.scopedBytes, radioMs(rbe), rbe.stats.sent,
+           rbe.stats.suppressed, rbe.stats.heartbeats, (unsigned long long)rbe.otherMsgs);
+    printf("  reduction           %7.1fx  %7.1fx  %8.1fx   (telemetry, alert and mode only)\n", reduction,
+           rbe.scopedBytes ? (double)every.scopedBytes / rbe.scopedBytes : 0, radioMs(every) / radioMs(rbe));
+    printf("  other msgs          %llu aggregates, %llu metrics, %llu logs, %llu images / other\n",
+           (unsigned long long)rbe.aggregateMsgs, (unsigned long long)rbe.metricsMsgs,
+           (unsigned long long)rbe.logMsgs,
+           (unsigned long long)(rbe.otherMsgs - rbe.aggregateMsgs - rbe.metricsMsgs - rbe.logMsgs));
+    printf("  all messages        %llu -> %llu, %.1fx\n", (unsigned long long)everyTotal,
+           (unsigned long long)rbeTotal, totalReduction);
+    printf("  dashboard           %u values past the deadband, longest silence %.0f s (heartbeat %u s)\n",
+           rbe.outOfBand, rbe.worstSilenceS, (unsigned)(REPORT_HEARTBEAT_MS / 1000));
+    printf("  mode                %u changes with a plain threshold, %u with hysteresis, %u published\n",
+           plainChanges, hystChanges, rbe.modeMsgs);
+    printf("  alert               raised %u / %u times, cleared at the end: %s\n", rbe.alertsRaised,
+           every.alertsRaised, rbe.alertClear ? "yes" : "no");
+    printf("  deep sleep          state round trip %s\n", rtcOk ? "ok" : "WRONG");
+    printf("  back-pressure       coalesced telemetry: %s\n", coalesceOk ? "both values sent" : "VALUE LOST");
+    printf("%s\n", benchFailures() ? "FAILED" : "OK");
+    return benchFailures() ? 1 : 0;
+}
@@ -0,0 +1,463 @@
+// Rule engine (rules.h): the compiled-in default ruleset against a copy of
+// the fixed decision logic it replaced, and updates over MQTT.
+//
+// 1. Equivalence: trigger, reason and the "not due yet" note of the default
+//    ruleset vs the old logic, over every combination of values just below,
+//    at and just above each threshold (NaN included), then random statuses.
+// 2. Cost per evaluation: the old logic, the default ruleset and a nearly
+//    full ruleset with hysteresis and hold times; heap allocations.
+// 3. Validation: every single-bit flip and every truncation of an encoded
+//    ruleset is rejected, and so are programs with a valid CRC that would
+//    read out of bounds or leave the stack unbalanced.
+// 4. Slots: hysteresis and hold time, and a hold time carried across a
+//    deep sleep.
+// 5. Delivery: a ruleset published on TOPIC_RULES to the running firmware
+//    is ACKed, changes the next decision, survives a reset and not a power
+//    cycle; a corrupted one is NACKed and changes nothing.
+//
+// Exits non-zero on any mismatch, allocation, accepted bad blob or failed
+// update.
+//
+//   .pio/build/bench_rules/program [--random N] [--json]
+
+#include <Arduino.h>
+#include "mqtt_client.h"
+#include <string>
+#include <vector>
+#include "host_sim.h"
+#include "bench_util.h"
+#include "checksum.h"
+#include "config.h"
+#include "core.h"
+#include "rules.h"
+
+void setup();
+void loop();
+void loopMQTT();
+extern MqttClient client;
+
+static uint32_t rng = 0x2545F491;
+
+static uint32_t nextRandom() {
+    rng ^= rng << 13;
+    rng ^= rng >> 17;
+    rng ^= rng << 5;
+    return rng;
+}
+
+static float uniform(float lo, float hi) { return lo + (hi - lo) * (nextRandom() % 100001) / 100000.0f; }
+
+// The decision before the rule engine (core.cpp), without its side effects.
+// Returns the reason index of the default ruleset (-1: no cleaning).
+static int legacyDecide(const SystemStatus& status, int daysSinceLastClean, bool* waiting) {
+    bool condDust = (status.dust > DUST_THRESHOLD);
+    bool condHum = (status.humidity < HUMIDITY_MIN_TRIGGER);
+    bool condLux = (status.lux > MIN_LUX_FOR_CLEANING);
+    bool condTime = (daysSinceLastClean >= DAYS_BETWEEN_CLEAN);
+    bool scored = !isnan(status.soiling);
+    bool condVisual = !scored || status.soiling >= SOILING_CONFIRM_SCORE;
+    bool condSoiled = scored && status.soiling >= SOILING_CLEAN_SCORE;
+
+    *waiting = condDust && condHum && condLux && !condTime;
+    if (condDust && condHum && condLux && condTime && condVisual) return 1;
+    if (condSoiled && condLux && condTime) return 2;
+    return -1;
+}
+
+struct Case {
+    SystemStatus status;
+    int days;
+};
+
+static SystemStatus makeStatus(float dust, float hum, float lux, float soiling) {
+    SystemStatus s;
+    s.temp = 25;
+    s.humidity = hum;
+    s.lux = lux;
+    s.dust = dust;
+    s.efficiency = NAN;
+    s.soiling = soiling;
+    s.mode = MODE_DAY;
+    return s;
+}
+
+static void edgeValues(float threshold, float step, std::vector<float>& out) {
+    out.clear();
+    out.push_back(threshold - step);
+    out.push_back(threshold);
+    out.push_back(threshold + step);
+    out.push_back(NAN);
+}
+
+static std::vector<Case> edgeCases() {
+    std::vector<float> dust, hum, lux, soil;
+    edgeValues(DUST_THRESHOLD, 0.5f, dust);
+    edgeValues(HUMIDITY_MIN_TRIGGER, 0.5f, hum);
+    edgeValues(MIN_LUX_FOR_CLEANING, 1, lux);
+    soil.push_back(NAN);
+    soil.push_back(0);
+    float soilEdges[] = {SOILING_CONFIRM_SCORE, SOILING_CLEAN_SCORE};
+    for (float e : soilEdges) {
+        soil.push_back(e - 0.5f);
+        soil.push_back(e);
+        soil.push_back(e + 0.5f);
+    }
+    int days[] = {0, DAYS_BETWEEN_CLEAN - 1, DAYS_BETWEEN_CLEAN, DAYS_BETWEEN_CLEAN + 1, 100};
+    std::vector<Case> cases;
+    for (float d : dust)
+        for (float h : hum)
+            for (float l : lux)
+                for (float s : soil)
+                    for (int t : days) cases.push_back(Case{makeStatus(d, h, l, s), t});
+    return cases;
+}
+
+static Case randomCase() {
+    Case c;
+    c.status = makeStatus(uniform(0, 400), uniform(10, 100), uniform(0, 100000),
+                          nextRandom() % 3 == 0 ? NAN : uniform(0, 100));
+    c.status.temp = uniform(-10, 60);
+    c.status.mode = nextRandom() % 2 ? MODE_DAY : MODE_NIGHT;
+    c.days = nextRandom() % (3 * DAYS_BETWEEN_CLEAN);
+    return c;
+}
+
+// Trigger and note of the engine vs the old logic; returns mismatches
+static uint32_t compare(const std::vector<Case>& cases) {
+    uint32_t mismatches = 0;
+    for (const Case& c : cases) {
+        bool waiting;
+        int expected = legacyDecide(c.status, c.days, &waiting);
+        RuleResult r = rulesEvaluate(c.status, c.days);
+        bool noted = (r.notes & 1) != 0;
+        if (r.trigger != expected || noted != waiting || (r.notes & ~1)) {
+            if (mismatches < 5) {
+                printf("  mismatch: dust %.1f hum %.1f lux %.0f soil %.1f days %d: engine %d/%d, old %d/%d\n",
+                       c.status.dust, c.status.humidity, c.status.lux, c.status.soiling, c.days, r.trigger,
+                       (int)noted, expected, (int)waiting);
+            }
+            mismatches++;
+        }
+    }
+    return mismatches;
+}
+
+// --- Rulesets built in the bench ---
+struct Builder {
+    RuleSet set;
+
+    Builder(uint16_t version) {
+        set = RuleSet();
+        set.version = version;
+    }
+    uint8_t constant(float v) {
+        for (uint8_t k = 0; k < set.nConsts; k++) {
+            if (set.consts[k] == v) return k;
+        }
+        set.consts[set.nConsts] = v;
+        return set.nConsts++;
+    }
+    uint8_t reason(const char* text) {
+        strncpy(set.reasons[set.nReasons], text, RULES_REASON_LEN - 1);
+        return set.nReasons++;
+    }
+    Builder& op(uint8_t code, uint8_t a = 0, uint16_t b = 0) {
+        set.ops[set.nOps++] = RuleOp(code, a, b);
+        return *this;
+    }
+    Builder& compare(RuleField f, uint8_t code, float v) { return op(OP_FIELD, f).op(OP_CONST, constant(v)).op(code); }
+};
+
+// Close to RULES_MAX_OPS and RULES_MAX_CONSTS: hysteresis on dust, humidity held low, a
+// temperature window, efficiency and soiling, four reasons
+static RuleSet fullRuleset() {
+    Builder b(2);
+    uint8_t rDust = b.reason("Dust latched, dry for 10 min");
+    uint8_t rEff = b.reason("Efficiency low and soiled");
+    uint8_t rHot = b.reason("Hot and dusty");
+    uint8_t rNote = b.reason("Dusty at night");
+    // (dust latched 150/120) && held(humidity < 60, 600 s) && lux > 5000 && days >= 3
+    b.op(OP_FIELD, RULE_DUST).op(OP_CONST, b.constant(150)).op(OP_CONST, b.constant(120)).op(OP_HYST, 0);
+    b.compare(RULE_HUMIDITY, OP_LT, 60).op(OP_HELD, 1, 600).op(OP_AND);
+    b.compare(RULE_LUX, OP_GT, 5000).op(OP_AND);
+    b.compare(RULE_DAYS_SINCE_CLEAN, OP_GE, 3).op(OP_AND).op(OP_TRIGGER, rDust);
+    // efficiency < 75 && !isnan(soiling) && soiling >= 30 && lux > 20000 && not night
+    b.compare(RULE_EFFICIENCY, OP_LT, 75);
+    b.op(OP_FIELD, RULE_SOILING).op(OP_ISNAN).op(OP_NOT).op(OP_AND);
+    b.compare(RULE_SOILING, OP_GE, 30).op(OP_AND);
+    b.compare(RULE_LUX, OP_GT, 20000).op(OP_AND);
+    b.compare(RULE_MODE, OP_LT, MODE_NIGHT).op(OP_AND).op(OP_TRIGGER, rEff);
+    // 35 < temp <= 55 && dust > 100 (latched 1) && days >= 1
+    b.compare(RULE_TEMP, OP_GT, 35).compare(RULE_TEMP, OP_LE, 55).op(OP_AND);
+    b.op(OP_FIELD, RULE_DUST).op(OP_CONST, b.constant(100)).op(OP_CONST, b.constant(80)).op(OP_HYST, 1).op(OP_AND);
+    b.compare(RULE_DAYS_SINCE_CLEAN, OP_GE, 1).op(OP_AND).op(OP_TRIGGER, rHot);
+    // night && dust > 200: note
+    b.compare(RULE_MODE, OP_GE, MODE_NIGHT).compare(RULE_DUST, OP_GT, 200).op(OP_AND).op(OP_NOTE, rNote);
+    return b.set;
+}
+
+// Offered and adopted (the next evaluation takes it)
+static bool install(const RuleSet& set) {
+    uint8_t blob[RULES_BLOB_MAX];
+    size_t len = rulesEncode(set, blob, sizeof(blob));
+    uint16_t version;
+    if (!len || rulesOffer(blob, len, &version) != RULES_OK) return false;
+    rulesEvaluate(makeStatus(0, 100, 0, NAN), 0);
+    return rulesVersion() == set.version;
+}
+
+struct Cost {
+    double nsPerEval;
+    uint64_t allocs;
+};
+
+static volatile int sink = 0;
+
+template <typename F> static Cost measure(const std::vector<Case>& cases, int rounds, F evaluate) {
+    Cost c;
+    BenchAllocDelta heap;
+    uint64_t t0 = benchNowNs();
+    for (int r = 0; r < rounds; r++) {
+        for (const Case& k : cases) sink += evaluate(k);
+    }
+    c.nsPerEval = (double)(benchNowNs() - t0) / ((double)rounds * cases.size());
+    c.allocs = heap.allocs();
+    return c;
+}
+
+// Blob with a valid CRC around an arbitrary (bad) program
+static RuleError decodeCrafted(const RuleSet& set) {
+    uint8_t blob[RULES_BLOB_MAX];
+    size_t len = rulesEncode(set, blob, sizeof(blob));
+    RuleSet out;
+    return rulesDecode(blob, len, &out);
+}
+
+int main(int argc, char** argv) {
+    bool json = benchHasFlag(argc, argv, "--json");
+    long randomCount = benchArg(argc, argv, "--random", 200000);
+
+    hostPowerCycle();
+    hostReset();
+    hostSerialEcho(false);
+    rulesInit();
+    benchCheck(rulesIsDefault(), "default ruleset not active after a power cycle");
+
+    // --- 1. Equivalence ---
+    std::vector<Case> edges = edgeCases();
+    std::vector<Case> randoms;
+    randoms.reserve(randomCount);
+    for (long i = 0; i < randomCount; i++) randoms.push_back(randomCase());
+    uint32_t edgeMismatches = compare(edges);
+    uint32_t randomMismatches = compare(randoms);
+    uint32_t edgeTriggers = 0;
+    for (const Case& c : edges) edgeTriggers += rulesEvaluate(c.status, c.days).trigger >= 0;
+    benchCheck(edgeMismatches == 0, "default ruleset differs from the old logic at the thresholds");
+    benchCheck(randomMismatches == 0, "default ruleset differs from the old logic on random statuses");
+
+    // --- 2. Cost ---
+    std::vector<Case> sample(randoms.begin(), randoms.begin() + std::min<size_t>(randoms.size(), 4096));
+    int rounds = 100;
+    Cost legacyCost = measure(sample, rounds, [](const Case& c) {
+        bool waiting;
+        return legacyDecide(c.status, c.days, &waiting) + waiting;
+    });
+    Cost defaultCost = measure(sample, rounds, [](const Case& c) {
+        RuleResult r = rulesEvaluate(c.status, c.days);
+        return r.trigger + r.notes;
+    });
+    RuleSet full = fullRuleset();
+    benchCheck(install(full), "full ruleset not adopted");
+    Cost fullCost = measure(sample, rounds, [](const Case& c) {
+        RuleResult r = rulesEvaluate(c.status, c.days);
+        return r.trigger + r.notes;
+    });
+    benchCheck(defaultCost.allocs == 0 && fullCost.allocs == 0, "evaluation allocated");
+
+    // --- 3. Validation ---
+    uint8_t blob[RULES_BLOB_MAX];
+    size_t defaultLen = rulesEncode(rulesDefault(), blob, sizeof(blob));
+    size_t len = defaultLen;
+    RuleSet decoded;
+    benchCheck(rulesDecode(blob, len, &decoded) == RULES_OK && decoded.nOps == rulesDefault().nOps,
+               "default ruleset does not round-trip");
+    uint32_t flipsAccepted = 0, truncAccepted = 0;
+    for (size_t bit = 0; bit < len * 8; bit++) {
+        blob[bit / 8] ^= 1 << (bit % 8);
+        flipsAccepted += rulesDecode(blob, len, &decoded) == RULES_OK;
+        blob[bit / 8] ^= 1 << (bit % 8);
+    }
+    for (size_t n = 0; n < len; n++) truncAccepted += rulesDecode(blob, n, &decoded) == RULES_OK;
+    blob[len] = 0;
+    truncAccepted += rulesDecode(blob, len + 1, &decoded) == RULES_OK;
+    benchCheck(flipsAccepted == 0, "a bit flip was accepted");
+    benchCheck(truncAccepted == 0, "a truncated or extended blob was accepted");
+
+    struct Crafted {
+        const char* name;
+        RuleOp ops[4];
+        uint8_t nOps;
+        RuleError expected;
+    } crafted[] = {
+        {"unknown opcode", {RuleOp(OP_COUNT)}, 1, RULES_BAD_PROGRAM},
+        {"field out of range", {RuleOp(OP_FIELD, RULE_FIELD_COUNT), RuleOp(OP_NOTE, 0)}, 2, RULES_BAD_PROGRAM},
+        {"constant out of range", {RuleOp(OP_CONST, 1), RuleOp(OP_NOTE, 0)}, 2, RULES_BAD_PROGRAM},
+        {"reason out of range", {RuleOp(OP_CONST, 0), RuleOp(OP_TRIGGER, 1)}, 2, RULES_BAD_PROGRAM},
+        {"slot out of range", {RuleOp(OP_CONST, 0), RuleOp(OP_HELD, RULES_MAX_SLOTS), RuleOp(OP_NOTE, 0)}, 3,
+         RULES_BAD_PROGRAM},
+        {"stack underflow", {RuleOp(OP_CONST, 0), RuleOp(OP_AND), RuleOp(OP_NOTE, 0)}, 3, RULES_BAD_PROGRAM},
+        {"value left on the stack", {RuleOp(OP_CONST, 0)}, 1, RULES_BAD_PROGRAM},
+    };
+    uint32_t craftedOk = 0;
+    const size_t nCrafted = sizeof(crafted) / sizeof(crafted[0]);
+    for (size_t i = 0; i < nCrafted; i++) {
+        Builder b(9);
+        b.constant(1);
+        b.reason("r");
+        for (uint8_t k = 0; k < crafted[i].nOps; k++) b.set.ops[k] = crafted[i].ops[k];
+        b.set.nOps = crafted[i].nOps;
+        RuleError err = decodeCrafted(b.set);
+        if (err == crafted[i].expected) craftedOk++;
+        else printf("  %s: %s\n", crafted[i].name, rulesErrorName(err));
+    }
+    {
+        Builder deep(9);
+        deep.constant(1);
+        deep.reason("r");
+        for (int k = 0; k <= RULES_STACK; k++) deep.op(OP_CONST, 0);
+        for (int k = 0; k < RULES_STACK; k++) deep.op(OP_AND);
+        deep.op(OP_NOTE, 0);
+        craftedOk += decodeCrafted(deep.set) == RULES_BAD_PROGRAM;
+        // A reason one character over the limit: spliced in, CRC recomputed
+        Builder text(9);
+        text.constant(1);
+        memset(text.set.reasons[0], 'x', RULES_REASON_LEN - 1);
+        text.set.nReasons = 1;
+        text.op(OP_CONST, 0).op(OP_NOTE, 0);
+        uint8_t raw[RULES_BLOB_MAX + 1];
+        size_t n = rulesEncode(text.set, raw, RULES_BLOB_MAX);
+        size_t nul = n - 5;
+        raw[nul] = 'x';
+        raw[nul + 1] = 0;
+        uint32_t crc = crc32(raw, nul + 2);
+        memcpy(raw + nul + 2, &crc, 4);                             // Little-endian host
+        craftedOk += rulesDecode(raw, n + 1, &decoded) == RULES_BAD_REASON;
+    }
+    benchCheck(craftedOk == nCrafted + 2, "a program with a valid CRC was misjudged");
+
+    // --- 4. Slots ---
+    Builder slots(3);
+    uint8_t rLatch = slots.reason("latched");
+    uint8_t rHeld = slots.reason("held");
+    slots.op(OP_FIELD, RULE_DUST).op(OP_CONST, slots.constant(150)).op(OP_CONST, slots.constant(100));
+    slots.op(OP_HYST, 0).op(OP_NOTE, rLatch);
+    slots.compare(RULE_HUMIDITY, OP_LT, 60).op(OP_HELD, 1, 600).op(OP_TRIGGER, rHeld);
+    benchCheck(install(slots.set), "slot ruleset not adopted");
+    const float dustSteps[] = {120, 160, 120, 90, 120};
+    const bool latchExpected[] = {false, true, true, false, false};
+    bool hystOk = true;
+    for (int i = 0; i < 5; i++) {
+        RuleResult r = rulesEvaluate(makeStatus(dustSteps[i], 80, 0, NAN), 0);
+        hystOk &= ((r.notes & 1) != 0) == latchExpected[i];
+    }
+    benchCheck(hystOk, "hysteresis sequence");
+    bool heldOk = rulesEvaluate(makeStatus(0, 50, 0, NAN), 0).trigger < 0;
+    hostClockAdvanceMs(400000);
+    heldOk &= rulesEvaluate(makeStatus(0, 50, 0, NAN), 0).trigger < 0;
+    RulesState saved = rulesSaveState();            // 400 s held, then 300 s asleep
+    hostClockAdvanceMs(5000);
+    rulesRestoreState(saved, 300000);
+    heldOk &= rulesEvaluate(makeStatus(0, 50, 0, NAN), 0).trigger == rHeld;
+    heldOk &= rulesEvaluate(makeStatus(0, 70, 0, NAN), 0).trigger < 0;
+    heldOk &= rulesEvaluate(makeStatus(0, 50, 0, NAN), 0).trigger < 0;     // Restarted
+    benchCheck(heldOk, "hold time (and across a sleep)");
+    hostClockAdvanceMs(601000);
+    uint16_t version;
+    len = rulesEncode(slots.set, blob, sizeof(blob));
+    benchCheck(rulesOffer(blob, len, &version) == RULES_OK && rulesEvaluate(makeStatus(0, 50, 0, NAN), 0).trigger == rHeld,
+               "resending the active ruleset reset its slots");
+
+    // --- 5. Delivery over MQTT ---
+    hostPowerCycle();
+    hostReset();
+    hostSerialEcho(false);
+    std::vector<std::string> acks;
+    hostBroker().addObserver([&acks](const std::string& topic, const uint8_t* payload, size_t n) {
+        if (topic == MQTT_TOPIC(TOPIC_RULES_ACK)) acks.push_back(std::string((const char*)payload, n));
+    });
+    setup();
+    while (!client.connected() && millis() < 30000) {   // WiFi join and connect run in the background
+        loopMQTT();
+        hostClockAdvanceMs(1);
+    }
+    SystemStatus dusty = makeStatus(90, 80, 8000, NAN);   // Dusty but humid: no cleaning by default
+    bool beforeUpdate = rulesEvaluate(dusty, 0).trigger >= 0;
+
+    Builder update(7);
+    uint8_t rUpdate = update.reason("Dust over 80 (update)");
+    update.compare(RULE_DUST, OP_GT, 80).op(OP_TRIGGER, rUpdate);
+    len = rulesEncode(update.set, blob, sizeof(blob));
+    std::vector<uint8_t> corrupt(blob, blob + len);
+    corrupt[14] ^= 0x10;
+    hostBroker().publishToDevice(MQTT_TOPIC(TOPIC_RULES), corrupt.data(), corrupt.size());
+    uint64_t until = millis() + 5000;
+    while (acks.size() < 1 && millis() < until) {
+        loopMQTT();
+        hostClockAdvanceMs(1);
+    }
+    bool nackOk = acks.size() == 1 && acks[0].find("bad_crc") != std::string::npos &&
+                  rulesEvaluate(dusty, 0).trigger < 0 && rulesIsDefault();
+
+    hostBroker().publishToDevice(MQTT_TOPIC(TOPIC_RULES), blob, len);
+    until = millis() + 5000;
+    while (acks.size() < 2 && millis() < until) {
+        loopMQTT();
+        hostClockAdvanceMs(1);
+    }
+    RuleResult afterUpdate = rulesEvaluate(dusty, 0);
+    bool ackOk = acks.size() == 2 && acks[1] == "{\"version\":7,\"result\":\"ok\"}";
+    bool updateOk = !beforeUpdate && afterUpdate.trigger == rUpdate && rulesVersion() == 7 &&
+                    strcmp(rulesReason(afterUpdate.trigger), "Dust over 80 (update)") == 0;
+
+    hostReset();                                // RTC_NOINIT_ATTR kept, RTC_DATA_ATTR cleared
+    hostSerialEcho(false);
+    rulesInit();
+    bool keptOnReset = rulesVersion() == 7 && !rulesIsDefault();
+    hostPowerCycle();
+    hostReset();
+    hostSerialEcho(false);
+    rulesInit();
+    bool droppedOnPowerCycle = rulesIsDefault();
+    benchCheck(nackOk, "corrupted update not NACKed, or it changed the rules");
+    benchCheck(ackOk && updateOk, "update over MQTT not ACKed or not in effect");
+    benchCheck(keptOnReset && droppedOnPowerCycle, "update not kept across a reset, or kept across a power cycle");
+
+    if (json) {
+        printf("{\"bench\":\"rules\",\"cases\":%zu,\"mismatches\":%u,\"legacy_ns\":%.1f,\"default_ns\":%.1f,"
+               "\"full_ns\":%.1f,\"allocs\":%llu,\"flips_accepted\":%u,\"truncations_accepted\":%u,"
+               "\"failures\":%d}\n",
+               edges.size() + randoms.size(), edgeMismatches + randomMismatches, legacyCost.nsPerEval,
+               defaultCost.nsPerEval, fullCost.nsPerEval,
+               (unsigned long long)(defaultCost.allocs + fullCost.allocs), flipsAccepted, truncAccepted, benchFailures());
+        return benchFailures() ? 1 : 0;
+    }
+
+    printf("ArgoS rule engine benchmark (default ruleset: %u ops, %u constants, blob %zu bytes)\n",
+           (unsigned)rulesDefault().nOps, (unsigned)rulesDefault().nConsts, defaultLen);
+    printf("  equivalence          %zu threshold edges (%u trigger), %zu random: %u mismatches\n", edges.size(),
+           edgeTriggers, randoms.size(), edgeMismatches + randomMismatches);
+    printf("  cost / evaluation    old logic %6.1f ns   default %6.1f ns   full (%u ops, slots) %6.1f ns\n",
+           legacyCost.nsPerEval, defaultCost.nsPerEval, (unsigned)full.nOps, fullCost.nsPerEval);
+    printf("  heap                 %llu allocations in %zu evaluations\n",
+           (unsigned long long)(defaultCost.allocs + fullCost.allocs), 2 * rounds * sample.size());
+    printf("  validation           %zu bit flips, %zu truncations: %u accepted; crafted programs %u/%zu judged right\n",
+           defaultLen * 8, defaultLen + 1, flipsAccepted + truncAccepted, craftedOk, nCrafted + 2);
+    printf("  slots                hysteresis %s, hold time (across sleep) %s\n", hystOk ? "ok" : "FAIL",
+           heldOk ? "ok" : "FAIL");
+    printf("  MQTT update          corrupted: %s; v7: %s, %s; reset %s, power cycle %s\n",
+           acks.size() > 0 ? acks[0].c_str() : "no ack", acks.size() > 1 ? acks[1].c_str() : "no ack",
+           updateOk ? "decision changed" : "NOT IN EFFECT", keptOnReset ? "kept" : "LOST",
+           droppedOnPowerCycle ? "back to defaults" : "KEPT");
+    printf("%s\n", benchFailures() ? "FAILED" : "OK");
+    return benchFailures() ? 1 : 0;
+}
@@ -0,0 +1,298 @@
+// Serial command channel (serial_commands.h) against the old
+// readStringUntil() parser, on feeds paced by the virtual clock.
+//
+// 1. Parser alone, one call per 1 ms pass: a 9600-baud link, lines split in
+//    three with 200 ms gaps, and gaps longer than the Serial timeout. Time
+//    blocked per pass (max and total), commands applied and lost, heap
+//    allocations per command.
+// 2. Firmware loop(): pass durations idle and with text commands and sample
+//    frames arriving; the jitter the channel adds (p99 and p99.9 difference).
+// 3. Binary frames: a second of sample vectors at 921600 baud through
+//    loop(), one in 50 corrupted. Vectors per second applied, bad frames
+//    caught, the last vector in the hooks, text lines between frames still
+//    run; parse cost per frame.
+//
+// Exits non-zero if the new parser blocks a pass, allocates, loses a
+// command or a good frame, applies a corrupted one, or loop() jitter with
+// input exceeds --max-jitter-us (default 1000).
+//
+//   .pio/build/bench_serial/program [--commands N] [--max-jitter-us N] [--json]
+
+#include <Arduino.h>
+#include <math.h>
+#include "host_sim.h"
+#include "bench_util.h"
+#include "config.h"
+#include "core.h"
+#include "logger.h"
+#include "sensor_driver.h"
+#include "serial_commands.h"
+#include "mqtt_client.h"
+
+void setup();
+void loop();
+extern MqttClient client;
+extern float simTemp;
+extern float simHum;
+extern float simLux;
+extern float simDust;
+
+// Reference: the checkSerialCommands() this channel replaced
+static void legacyCheckSerialCommands() {
+    if (Serial.available() > 0) {
+        String cmd = Serial.readStringUntil('\n');
+        cmd.trim();
+        if (cmd.length() == 0) return;
+        if (cmd.startsWith("set dust ")) {
+            float val = cmd.substring(9).toFloat();
+            setSimDust(val);
+            Serial.println("CMD: Dust set to " + String(val));
+        } else if (cmd.startsWith("set lux ")) {
+            float val = cmd.substring(8).toFloat();
+            setSimLux(val);
+            Serial.println("CMD: Lux set to " + String(val));
+        } else if (cmd.startsWith("set hum ")) {
+            float val = cmd.substring(8).toFloat();
+            setSimHum(val);
+            Serial.println("CMD: Humidity set to " + String(val));
+        } else if (cmd.startsWith("set days ")) {
+            int val = cmd.substring(9).toInt();
+            setDaysSinceClean(val);
+            Serial.println("CMD: Days since clean set to " + String(val));
+        } else {
+            Serial.println("Unknown command. Use: set dust X, set lux X, set hum X, set days X");
+        }
+    }
+}
+
+static void newPoll() {
+    serialCommandsPoll();
+    while (logPending()) logDrain();
+}
+
+// ============================================================================
+// 1. PARSER ALONE
+// ============================================================================
+
+struct Feed {
+    const char* name;
+    uint32_t bytesPerSecond;
+    uint32_t pieces;            // Each line split into this many
+    uint32_t gapMs;             // Between pieces and lines
+};
+
+static const Feed FEEDS[] = {
+    {"9600 baud", 960, 1, 0},
+    {"fragmented", 11520, 3, 200},
+    {"gap > timeout", 11520, 2, 1500},
+};
+
+struct ParserResult {
+    double maxPassUs;
+    double blockedMs;           // Total over the run, beyond the 1 ms pass
+    uint32_t applied;
+    double allocsPerCommand;
+};
+
+// Schedules `commands` lines "set dust <100+i>" on the paced feed
+static void schedule(const Feed& feed, long commands) {
+    uint64_t at = hostClockMicros();
+    char line[32];
+    for (long i = 0; i < commands; i++) {
+        int len = snprintf(line, sizeof(line), "set dust %ld\n", 100 + i);
+        for (uint32_t p = 0; p < feed.pieces; p++) {
+            int from = len * p / feed.pieces, to = len * (p + 1) / feed.pieces;
+            hostSerialInputPaced(line + from, to - from, feed.bytesPerSecond, at);
+            at += (uint64_t)(to - from) * 1000000ULL / feed.bytesPerSecond + feed.gapMs * 1000ULL;
+        }
+    }
+}
+
+static ParserResult runParser(const Feed& feed, long commands, void (*poll)()) {
+    hostReset();
+    hostSerialEcho(false);
+    hostSerialBlockingModel(false);
+    Serial.begin(115200);
+    setSimDust(0);
+    schedule(feed, commands);
+    ParserResult r = {};
+    float last = simDust;
+    BenchAllocDelta heap;
+    while (hostSerialInputPending() > 0 || Serial.available()) {
+        uint64_t start = hostClockMicros();
+        poll();
+        double us = (double)(hostClockMicros() - start);
+        if (us > r.maxPassUs) r.maxPassUs = us;
+        r.blockedMs += us / 1000.0;
+        if (simDust != last) r.applied++;
+        last = simDust;
+        hostClockAdvanceMs(1);
+    }
+    r.allocsPerCommand = (double)heap.allocs() / commands;
+    return r;
+}
+
+// ============================================================================
+// 2. FIRMWARE LOOP
+// ============================================================================
+
+static bool bootConnected() {
+    client.disconnect();
+    hostReset();
+    hostSerialEcho(false);
+    setup();
+    for (int i = 0; i < 600 && !client.connected(); i++) {
+        loop();
+        hostClockAdvanceMs(100);
+    }
+    return client.connected();
+}
+
+static size_t sampleFrame(float temp, float hum, float lux, float dust, uint8_t* out) {
+    float v[4] = {temp, hum, lux, dust};
+    uint8_t payload[16];
+    memcpy(payload, v, sizeof(payload));        // Little-endian host, as the wire
+    return serialFrameEncode(SERIAL_FRAME_SAMPLE, payload, sizeof(payload), out);
+}
+
+// Pass durations over `seconds` of 1 ms passes, with or without input
+static void runLoop(long seconds, bool fed, BenchSeries* passes) {
+    bootConnected();
+    if (fed) {
+        // Every 500 ms a text line in two pieces 20 ms apart, then 40 sample
+        // frames at 921600 baud
+        uint64_t at = hostClockMicros();
+        uint8_t frame[SERIAL_FRAME_OVERHEAD + 16];
+        size_t n = sampleFrame(25, 50, 8000, 50, frame);
+        for (long slot = 0; slot < seconds * 2; slot++) {
+            hostSerialInputPaced("set te", 6, 11520, at);
+            hostSerialInputPaced("mp 25\n", 6, 11520, at + 20000);
+            for (int i = 0; i < 40; i++) hostSerialInputPaced((const char*)frame, n, 92160, at + 40000 + i * 10000);
+            at += 500000;
+        }
+    }
+    passes->reserve(seconds * 1000);
+    uint64_t end = hostClockMicros() + seconds * 1000000ULL;
+    while (hostClockMicros() < end) {
+        uint64_t start = hostClockMicros();
+        loop();
+        passes->add((double)(hostClockMicros() - start));
+        hostClockAdvanceMs(1);
+    }
+}
+
+int main(int argc, char** argv) {
+    bool json = benchHasFlag(argc, argv, "--json");
+    long commands = benchArg(argc, argv, "--commands", 20);
+    long maxJitterUs = benchArg(argc, argv, "--max-jitter-us", 1000);
+
+    // --- 1. Parser alone ---
+    const size_t nFeeds = sizeof(FEEDS) / sizeof(FEEDS[0]);
+    ParserResult legacy[nFeeds], fresh[nFeeds];
+    for (size_t f = 0; f < nFeeds; f++) {
+        legacy[f] = runParser(FEEDS[f], commands, legacyCheckSerialCommands);
+        fresh[f] = runParser(FEEDS[f], commands, newPoll);
+        benchCheck(fresh[f].maxPassUs == 0, "new parser blocked a pass");
+        benchCheck(fresh[f].applied == (uint32_t)commands, "new parser lost a command");
+        benchCheck(fresh[f].allocsPerCommand == 0, "new parser allocates");
+    }
+
+    // --- 2. Firmware loop() jitter ---
+    long seconds = 20;
+    BenchSeries idle, fed;
+    runLoop(seconds, false, &idle);
+    runLoop(seconds, true, &fed);
+    const SerialCommandStats& cs = serialCommandStats();
+    uint32_t linesRun = cs.lines, framesRun = cs.frames;
+    // Not the max: a cycle's aggregates land on other passes in the two runs
+    double jitterP99 = fed.percentile(99) - idle.percentile(99);
+    double jitterP999 = fed.percentile(99.9) - idle.percentile(99.9);
+    benchCheck(jitterP99 <= maxJitterUs && jitterP999 <= maxJitterUs, "input adds loop() jitter over --max-jitter-us");
+
+    // --- 3. Binary frames at 921600 baud ---
+    bootConnected();
+    const uint32_t rate = 92160;
+    uint8_t frame[SERIAL_FRAME_OVERHEAD + 16];
+    size_t frameLen = sampleFrame(0, 0, 0, 0, frame);
+    uint32_t vectors = rate / (uint32_t)frameLen;     // One second of link time
+    uint32_t corrupted = 0;
+    SerialCommandStats before = serialCommandStats();
+    uint64_t at = hostClockMicros();
+    float lastGood = NAN;
+    for (uint32_t i = 0; i < vectors; i++) {
+        float dust = 100 + i;
+        sampleFrame(20 + i * 0.001f, 40, 50000, dust, frame);
+        if (i % 50 == 49 && i + 1 < vectors) {
+            frame[5] ^= 0x10;                           // Payload bit flip: CRC fails
+            corrupted++;
+        } else {
+            lastGood = dust;
+        }
+        hostSerialInputPaced((const char*)frame, frameLen, rate, at);
+        at += frameLen * 1000000ULL / rate;
+        if (i == vectors / 2) {
+            hostSerialInputPaced("set days 3\n", 11, rate, at);
+            at += 11 * 1000000ULL / rate;
+        }
+    }
+    uint64_t start = hostClockMicros();
+    BenchAllocDelta heap;
+    uint32_t maxWaiting = 0;
+    while (hostSerialInputPending() > 0) {
+        uint32_t waiting = (uint32_t)Serial.available();
+        if (waiting > maxWaiting) maxWaiting = waiting;
+        loop();
+        hostClockAdvanceMs(1);
+    }
+    uint64_t binaryAllocs = heap.allocs();
+    double elapsedS = (hostClockMicros() - start) / 1e6;
+    const SerialCommandStats& after = serialCommandStats();
+    uint32_t applied = after.frames - before.frames;
+    uint32_t bad = after.badFrames - before.badFrames;
+    benchCheck(applied == vectors - corrupted, "good frame lost or bad frame applied");
+    benchCheck(bad == corrupted, "corrupted frames not all caught");
+    benchCheck(simDust == lastGood && simLux == 50000, "last vector not in the hooks");
+    benchCheck(after.lines == before.lines + 1, "text line between frames not run");
+    benchCheck(binaryAllocs == 0, "binary frames allocate");
+    benchCheck(maxWaiting <= SERIAL_RX_BUFFER, "more bytes waiting than SERIAL_RX_BUFFER holds");
+
+    // Parse cost per frame (wall)
+    std::vector<uint8_t> burst;
+    for (int i = 0; i < 1000; i++) burst.insert(burst.end(), frame, frame + frameLen);
+    uint64_t t0 = benchNowNs();
+    for (int k = 0; k < 100; k++) serialCommandsFeed(burst.data(), burst.size());
+    double nsPerFrame = (double)(benchNowNs() - t0) / 100000.0;
+
+    if (json) {
+        printf("{\"bench\":\"serial\",\"commands\":%ld", commands);
+        for (size_t f = 0; f < nFeeds; f++) {
+            printf(",\"feed%u\":{\"legacy_max_us\":%.0f,\"legacy_blocked_ms\":%.1f,\"legacy_applied\":%u,"
+                   "\"legacy_allocs\":%.1f,\"new_max_us\":%.0f,\"new_applied\":%u,\"new_allocs\":%.1f}",
+                   (unsigned)f, legacy[f].maxPassUs, legacy[f].blockedMs, legacy[f].applied,
+                   legacy[f].allocsPerCommand, fresh[f].maxPassUs, fresh[f].applied, fresh[f].allocsPerCommand);
+        }
+        printf(",\"loop_p99_us\":[%.0f,%.0f],\"loop_p999_us\":[%.0f,%.0f],\"loop_max_us\":[%.0f,%.0f],\"vectors_per_s\":%.0f,\"bad_frames\":%u,"
+               "\"ns_per_frame\":%.1f,\"rx_max_bytes\":%u,\"ok\":%s}\n",
+               idle.percentile(99), fed.percentile(99), idle.percentile(99.9), fed.percentile(99.9), idle.max(),
+               fed.max(), applied / elapsedS, bad, nsPerFrame,
+               maxWaiting, benchFailures() ? "false" : "true");
+        return benchFailures() ? 1 : 0;
+    }
+    printf("ArgoS serial command channel (%ld commands per feed)\n", commands);
+    printf("  feed             parser   max pass ms  blocked ms  applied  allocs/cmd\n");
+    for (size_t f = 0; f < nFeeds; f++) {
+        printf("  %-16s old     %11.1f %11.1f %5u/%-3ld %10.1f\n", FEEDS[f].name, legacy[f].maxPassUs / 1000,
+               legacy[f].blockedMs, legacy[f].applied, commands, legacy[f].allocsPerCommand);
+        printf("  %-16s new     %11.1f %11.1f %5u/%-3ld %10.1f\n", "", fresh[f].maxPassUs / 1000,
+               fresh[f].blockedMs, fresh[f].applied, commands, fresh[f].allocsPerCommand);
+    }
+    printf("  loop() over %ld s, idle vs fed (%u lines, %u frames): p99 %.0f / %.0f us, p99.9 %.0f / %.0f us, "
+           "max %.0f / %.0f us\n",
+           seconds, (unsigned)linesRun, (unsigned)framesRun, idle.percentile(99), fed.percentile(99),
+           idle.percentile(99.9), fed.percentile(99.9), idle.max(), fed.max());
+    printf("  binary at 921600 baud: %u vectors in %.2f s (%.0f/s applied), %u of %u corrupted caught, "
+           "%.0f ns/frame, RX high-water %u B\n",
+           vectors, elapsedS, applied / elapsedS, bad, corrupted, nsPerFrame, maxWaiting);
+    printf("%s\n", benchFailures() ? "FAILED" : "OK");
+    return benchFailures() ? 1 : 0;
+}
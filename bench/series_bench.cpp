@@ -0,0 +1,489 @@
+// Compressed batch upload (series_codec.h, TELEMETRY_MODE_BATCH): size and
+// cost of the delta-of-delta / XOR encoding against one frame or one text
+// message per value, and the firmware sending batches.
+//
+// 1. Codec on solar-day traces: a synthetic day (full-precision floats with
+//    noise), the day recorded through the firmware's sensor stand-ins in 3.
+//    (DHT22, BH1750 and ADC resolution; as batched, so already snapped) and,
+//    with --trace, a recorded CSV.
+//    Each exact and snapped to the SERIES_STEP_* of config.h: bytes against
+//    packed frames and text topics, bits per sample, encode and decode time
+//    per sample, and the round trip (bit-exact, or within half a step).
+// 2. Edge cases: clock steps and gaps, mode changes, NaN, incompressible
+//    values filling a batch to its limit, truncated payloads rejected.
+// 3. Firmware: the real setup()/loop() built with TELEMETRY_MODE_BATCH over
+//    a day of readings, with a broker outage in the middle. Every cycle
+//    arrives exactly once, as measured, and batches go out at least every
+//    TELEMETRY_BATCH_MS while connected.
+//
+// Exits non-zero on a round-trip error, a sample lost, duplicated or wrong,
+// or the snapped sensor trace compressing less than --min-ratio (default 4x)
+// against packed frames.
+//
+//   .pio/build/bench_series/program [--hours N] [--trace file.csv] [--min-ratio N] [--json]
+
+#include <Arduino.h>
+#include <map>
+#include <string>
+#include <vector>
+#include "host_sim.h"
+#include "bench_util.h"
+#include "config.h"
+#include "core.h"
+#include "offline_queue.h"
+#include "series_codec.h"
+#include "telemetry_frame.h"
+#include "mqtt_client.h"
+
+static_assert(TELEMETRY_MODE == TELEMETRY_MODE_BATCH, "build with -D TELEMETRY_MODE=3");
+
+void setup();
+void loop();
+extern MqttClient client;
+extern SensorBank bank;
+extern SystemMode currentMode;
+extern unsigned long lastCheckTime;
+
+static const int COLUMNS = 6;                   // SystemStatus floats, one channel
+static const float STEPS[COLUMNS] = {SERIES_STEP_TEMP, SERIES_STEP_HUMIDITY, SERIES_STEP_LUX,
+                                     SERIES_STEP_DUST, SERIES_STEP_EFFICIENCY, SERIES_STEP_SOILING};
+static const int DECIMALS[COLUMNS] = {1, 1, 0, 0, 1, 0};     // publishMetric() text
+static const char* const TOPICS[COLUMNS] = {MQTT_TOPIC(TOPIC_TEMP), MQTT_TOPIC(TOPIC_HUM), MQTT_TOPIC(TOPIC_LUX),
+                                            MQTT_TOPIC(TOPIC_DUST), MQTT_TOPIC(TOPIC_EFFICIENCY),
+                                            MQTT_TOPIC(TOPIC_SOILING)};
+
+static uint32_t rng = 0x6D2B79F5;
+
+static float noise() {
+    rng ^= rng << 13;
+    rng ^= rng >> 17;
+    rng ^= rng << 5;
+    return (rng & 0xFFFFFF) / 8388608.0f - 1.0f;    // -1..1
+}
+
+struct Sample {
+    uint32_t t;
+    uint8_t mode;
+    float v[COLUMNS];
+};
+
+typedef std::vector<Sample> Trace;
+
+// ============================================================================
+// TRACES
+// ============================================================================
+
+// What the sensors see, from midnight: sun with passing clouds, temperature
+// and humidity following it, dust with a midday event
+static HostEnvironment solarDay(double t) {
+    double h = fmod(t / 3600.0, 24.0);
+    double sun = h > 6 && h < 18 ? sin(M_PI * (h - 6) / 12) : 0;
+    double sky = sin(t / 700.0) + 0.8 * sin(t / 1900.0 + 1) + 0.3 * sin(t / 310.0 + 2);
+    double clouds = sky > 0.6 ? 1.0 - 0.35 * (sky - 0.6) : 1.0;
+    double warm = sin(M_PI * (h - 9) / 12);
+    HostEnvironment env;
+    env.lux = (float)(90000.0 * pow(sun, 1.3) * clouds * (1 + 0.03 * noise()) + 2);
+    env.temp = (float)(17 + 9 * warm + 0.1 * noise());
+    env.humidity = (float)(70 - 25 * warm + 0.5 * noise());
+    env.dust = (float)(45 + 8 * sin(t / 5000.0) + 4 * noise() + (h >= 13 && h < 14 ? 170 : 0));
+    return env;
+}
+
+// The firmware's cadence: INTERVAL_DAY by day, INTERVAL_NIGHT by night,
+// climate and dust only by day, a soiling score every few day cycles
+static Trace syntheticTrace(double seconds) {
+    Trace trace;
+    rng = 0x6D2B79F5;
+    uint32_t dayCycle = 0;
+    for (double t = 0; t < seconds;) {
+        HostEnvironment env = solarDay(t);
+        bool day = env.lux >= MIN_LUX_DAY_MODE;
+        Sample s;
+        s.t = 1700000000u + (uint32_t)t;
+        s.mode = day ? MODE_DAY : MODE_NIGHT;
+        s.v[0] = day ? env.temp : NAN;
+        s.v[1] = day ? env.humidity : NAN;
+        s.v[2] = env.lux;
+        s.v[3] = day ? env.dust : NAN;
+        s.v[4] = NAN;
+        s.v[5] = day && dayCycle++ % SOILING_INTERVAL_CYCLES == 0 ? 12.0f + 0.5f * noise() : NAN;
+        trace.push_back(s);
+        t += (day ? INTERVAL_DAY : INTERVAL_NIGHT) / 1000.0 + (noise() > 0.8f ? 1 : 0);
+    }
+    return trace;
+}
+
+static bool loadTrace(const char* path, Trace* trace) {
+    FILE* f = fopen(path, "r");
+    if (!f) return false;
+    char line[256];
+    double t;
+    float temp, humidity, lux, dust;
+    while (fgets(line, sizeof(line), f)) {
+        if (sscanf(line, "%lf,%f,%f,%f,%f", &t, &temp, &humidity, &lux, &dust) != 5) continue;
+        Sample s;
+        s.t = (uint32_t)t;
+        s.mode = lux >= MIN_LUX_DAY_MODE ? MODE_DAY : MODE_NIGHT;
+        s.v[0] = temp;
+        s.v[1] = humidity;
+        s.v[2] = lux;
+        s.v[3] = dust;
+        s.v[4] = s.v[5] = NAN;
+        trace->push_back(s);
+    }
+    fclose(f);
+    return trace->size() > 1;
+}
+
+// ============================================================================
+// CODEC ON A TRACE
+// ============================================================================
+
+struct CodecResult {
+    size_t samples;
+    size_t batches;
+    uint64_t batchBytes;        // Topic + payload, as the broker counts
+    uint64_t frameBytes;        // One frame per sample
+    uint64_t textBytes;         // One message per measured value
+    uint64_t textMsgs;
+    double encodeNs;            // Per sample
+    double decodeNs;
+    uint32_t errors;            // Round-trip values off
+};
+
+static bool sameBits(float a, float b) {
+    return (isnan(a) && isnan(b)) || memcmp(&a, &b, sizeof(float)) == 0;
+}
+
+// Batches cut as the firmware does: full, or TELEMETRY_BATCH_MS after the first sample
+static CodecResult runCodec(const Trace& trace, bool snap) {
+    CodecResult r = {};
+    r.samples = trace.size();
+    size_t batchTopic = strlen(MQTT_TOPIC(TOPIC_BATCH));
+    size_t frameTopic = strlen(MQTT_TOPIC(TOPIC_FRAME));
+    static uint8_t buf[TELEMETRY_BATCH_BYTES];
+    std::vector<std::vector<uint8_t>> payloads;
+    std::vector<std::vector<Sample>> expected;
+    SeriesEncoder enc;
+    uint32_t start = 0;
+    uint64_t encodeNs = 0;
+
+    for (size_t i = 0; i <= trace.size(); i++) {
+        Sample s;
+        if (i < trace.size()) {
+            s = trace[i];
+            for (int c = 0; c < COLUMNS; c++) {
+                if (snap) s.v[c] = seriesQuantize(s.v[c], STEPS[c]);
+                if (isnan(trace[i].v[c])) continue;
+                char text[16];
+                r.textBytes += strlen(TOPICS[c]) + snprintf(text, sizeof(text), "%.*f", DECIMALS[c], trace[i].v[c]);
+                r.textMsgs++;
+            }
+            r.frameBytes += frameTopic + TELEMETRY_FRAME_SIZE;
+        }
+        uint64_t t0 = benchNowNs();
+        bool due = i == trace.size() || (!expected.empty() && (uint64_t)(s.t - start) * 1000 >= TELEMETRY_BATCH_MS);
+        bool fits = !due && !expected.empty() && seriesAppend(&enc, s.t, s.mode, s.v);
+        size_t len = fits || expected.empty() ? 0 : seriesFinish(&enc);
+        encodeNs += benchNowNs() - t0;
+        if (fits) {
+            expected.back().push_back(s);
+            continue;
+        }
+        if (len) payloads.push_back(std::vector<uint8_t>(buf, buf + len));
+        if (i == trace.size()) break;
+        t0 = benchNowNs();
+        seriesBegin(&enc, buf, sizeof(buf), COLUMNS, 0, (uint32_t)payloads.size());
+        seriesAppend(&enc, s.t, s.mode, s.v);
+        encodeNs += benchNowNs() - t0;
+        start = s.t;
+        expected.push_back(std::vector<Sample>(1, s));
+    }
+
+    uint64_t decodeNs = 0;
+    for (size_t b = 0; b < payloads.size(); b++) {
+        r.batches++;
+        r.batchBytes += batchTopic + payloads[b].size();
+        SeriesDecoder dec;
+        Sample got;
+        size_t n = 0;
+        uint64_t t0 = benchNowNs();
+        bool ok = seriesDecodeBegin(&dec, payloads[b].data(), payloads[b].size());
+        std::vector<Sample> decoded;
+        while (ok && seriesDecodeNext(&dec, &got.t, &got.mode, got.v)) decoded.push_back(got);
+        decodeNs += benchNowNs() - t0;
+        const std::vector<Sample>& want = expected[b];
+        if (!ok || decoded.size() != want.size()) {
+            r.errors++;
+            continue;
+        }
+        for (n = 0; n < want.size(); n++) {
+            bool same = decoded[n].t == want[n].t && decoded[n].mode == want[n].mode;
+            for (int c = 0; c < COLUMNS; c++) same &= sameBits(decoded[n].v[c], want[n].v[c]);
+            r.errors += !same;
+        }
+    }
+    r.encodeNs = (double)encodeNs / r.samples;
+    r.decodeNs = (double)decodeNs / r.samples;
+    return r;
+}
+
+// Snapping keeps every value within half a step
+static uint32_t snapErrors(const Trace& trace) {
+    uint32_t errors = 0;
+    for (const Sample& s : trace) {
+        for (int c = 0; c < COLUMNS; c++) {
+            float q = seriesQuantize(s.v[c], STEPS[c]);
+            if (isnan(s.v[c]) != isnan(q) || fabsf(q - s.v[c]) > STEPS[c] * 0.5f + fabsf(s.v[c]) * 1e-6f) errors++;
+        }
+    }
+    return errors;
+}
+
+// ============================================================================
+// EDGE CASES
+// ============================================================================
+
+static bool edgeCases() {
+    bool ok = true;
+    uint8_t buf[TELEMETRY_BATCH_BYTES];
+    SeriesEncoder enc;
+    SeriesDecoder dec;
+    float v[COLUMNS] = {21.5f, NAN, 0.0f, -3.25f, INFINITY, 50.0f};
+    float out[COLUMNS];
+    uint32_t t;
+    uint8_t mode;
+
+    // Gaps of every timestamp class, mode changes, a NaN with a payload
+    static const uint32_t times[] = {1000, 1010, 1020, 1021, 1100, 1400, 3000, 3000, 100000, 2000000000u};
+    seriesBegin(&enc, buf, sizeof(buf), COLUMNS, SERIES_FLAG_UPTIME, 42);
+    uint32_t nanPayload = 0x7FC01234;
+    for (size_t i = 0; i < sizeof(times) / sizeof(times[0]); i++) {
+        if (i == 3) memcpy(&v[1], &nanPayload, sizeof(float));
+        else v[1] = NAN;
+        v[2] = (float)i * 1000.0f;
+        ok &= seriesAppend(&enc, times[i], (uint8_t)(i % 3), v);
+    }
+    ok &= !seriesAppend(&enc, 999, 0, v);               // Clock went back
+    size_t len = seriesFinish(&enc);
+    ok &= seriesDecodeBegin(&dec, buf, len) && dec.header.seq == 42 && dec.header.flags == SERIES_FLAG_UPTIME &&
+          dec.header.count == sizeof(times) / sizeof(times[0]);
+    for (size_t i = 0; ok && i < sizeof(times) / sizeof(times[0]); i++) {
+        ok &= seriesDecodeNext(&dec, &t, &mode, out) && t == times[i] && mode == i % 3 && isnan(out[1]) &&
+              out[2] == (float)i * 1000.0f && out[3] == -3.25f && isinf(out[4]);
+    }
+    ok &= !seriesDecodeNext(&dec, &t, &mode, out);
+
+    // Truncated: fails before the last sample
+    seriesDecodeBegin(&dec, buf, len - 3);
+    size_t n = 0;
+    while (seriesDecodeNext(&dec, &t, &mode, out)) n++;
+    ok &= n < sizeof(times) / sizeof(times[0]);
+    ok &= !seriesDecodeBegin(&dec, buf, SERIES_HEADER_SIZE - 1);
+
+    // Random bits until the batch refuses: within the buffer, exact
+    std::vector<std::vector<float>> sent;
+    seriesBegin(&enc, buf, sizeof(buf), COLUMNS, 0, 1);
+    for (uint32_t i = 0;; i++) {
+        for (int c = 0; c < COLUMNS; c++) {
+            noise();
+            uint32_t bits = rng ^ (i * 2654435761u);
+            memcpy(&v[c], &bits, sizeof(float));
+            if (isnan(v[c])) v[c] = NAN;
+        }
+        if (!seriesAppend(&enc, 5000 + i * 7, 1, v)) break;
+        sent.push_back(std::vector<float>(v, v + COLUMNS));
+    }
+    len = seriesFinish(&enc);
+    ok &= len <= sizeof(buf) && seriesDecodeBegin(&dec, buf, len);
+    for (size_t i = 0; ok && i < sent.size(); i++) {
+        ok &= seriesDecodeNext(&dec, &t, &mode, out);
+        for (int c = 0; c < COLUMNS; c++) ok &= sameBits(out[c], sent[i][c]);
+    }
+    return ok && !sent.empty();
+}
+
+// ============================================================================
+// FIRMWARE
+// ============================================================================
+
+struct FirmwareRun {
+    uint32_t cycles;
+    uint32_t received;          // Samples decoded from batches
+    uint32_t duplicates;        // Batches received twice
+    uint32_t wrong;             // Not what the firmware measured, or out of order
+    uint32_t messages;
+    uint32_t replayed;          // Offline queue records replayed (batches)
+    uint64_t bytes;
+    uint32_t longestGapS;       // Between batches while connected
+    Trace samples;              // As received, in batch order (virtual timestamps)
+};
+
+static FirmwareRun runFirmware(double seconds, double outageFrom, double outageTo) {
+    FirmwareRun run = {};
+    client.disconnect();
+    hostReset();
+    hostSerialEcho(false);
+    hostCameraSetFrameSize(24 * 1024);
+    rng = 0x6D2B79F5;
+    hostEnv() = solarDay(0);
+
+    std::string batchTopic = MQTT_TOPIC(TOPIC_BATCH);
+    std::map<uint32_t, std::vector<Sample>> batches;     // By batch sequence number
+    Trace measured;                                      // Channel 0 after each cycle
+    uint64_t lastBatchUs = 0;
+    bool outage = false;
+    hostBroker().addObserver([&](const std::string& topic, const uint8_t* payload, size_t len) {
+        HostAllocPause pause;
+        if (topic != batchTopic) return;
+        run.messages++;
+        run.bytes += topic.size() + len;
+        uint64_t now = hostClockMicros();
+        if (!outage && lastBatchUs && (now - lastBatchUs) / 1000000 > run.longestGapS) {
+            run.longestGapS = (uint32_t)((now - lastBatchUs) / 1000000);
+        }
+        lastBatchUs = now;
+        SeriesDecoder dec;
+        Sample s;
+        if (!seriesDecodeBegin(&dec, payload, len)) return;
+        if (batches.count(dec.header.seq)) run.duplicates++;
+        std::vector<Sample>& batch = batches[dec.header.seq];
+        batch.clear();
+        while (seriesDecodeNext(&dec, &s.t, &s.mode, s.v)) batch.push_back(s);
+    });
+
+    setup();
+    uint64_t passes = (uint64_t)seconds;
+    for (uint64_t p = 0; p < passes; p++) {
+        bool down = p >= outageFrom && p < outageTo;
+        if (down != outage) {
+            outage = down;
+            hostNet().brokerAvailable = !down;
+            if (down) client.disconnect();
+            else lastBatchUs = 0;
+        }
+        hostEnv() = solarDay((double)p);
+        unsigned long before = lastCheckTime;
+        loop();
+        if (lastCheckTime != before) {
+            Sample s = {};
+            s.t = 1700000000u + (uint32_t)(hostClockMicros() / 1000000);
+            s.mode = (uint8_t)currentMode;
+            const float v[COLUMNS] = {bank.temp[0], bank.humidity[0], bank.lux[0], bank.dust[0], NAN, NAN};
+            memcpy(s.v, v, sizeof(v));
+            measured.push_back(s);
+        }
+        hostClockAdvanceMs(1000);
+    }
+    // Last batch out
+    outage = true;                                       // Not a gap
+    hostClockAdvanceMs(TELEMETRY_BATCH_MS);
+    for (int i = 0; i < 200; i++) {
+        loop();
+        hostClockAdvanceMs(10);
+    }
+
+    for (auto& b : batches) run.samples.insert(run.samples.end(), b.second.begin(), b.second.end());
+    run.cycles = (uint32_t)measured.size();
+    run.received = (uint32_t)run.samples.size();
+    // In cycle order, each as measured (efficiency and soiling are not in the bank)
+    for (size_t i = 0; i < measured.size(); i++) {
+        bool ok = i < run.samples.size() && run.samples[i].mode == measured[i].mode &&
+                  (i == 0 || run.samples[i].t >= run.samples[i - 1].t);       // Firmware clock
+        for (int c = 0; ok && c < 4; c++) {
+            float got = run.samples[i].v[c];
+            float want = measured[i].v[c];
+            ok = isnan(got) == isnan(want) && (isnan(got) || fabsf(got - want) <= STEPS[c] * 0.5f + 1e-3f);
+        }
+        run.wrong += !ok;
+    }
+    // The host's time() is the wall clock: the virtual time of each cycle
+    // for the codec table
+    for (size_t i = 0; i < measured.size() && i < run.samples.size(); i++) run.samples[i].t = measured[i].t;
+    run.replayed = offlineQueueStats().replayed;
+    return run;
+}
+
+int main(int argc, char** argv) {
+    bool json = benchHasFlag(argc, argv, "--json");
+    long hours = benchArg(argc, argv, "--hours", 24);
+    long minRatio = benchArg(argc, argv, "--min-ratio", 4);
+    const char* tracePath = benchArgStr(argc, argv, "--trace", nullptr);
+    double seconds = hours * 3600.0;
+
+    hostPowerCycle();
+    hostReset();
+    hostSerialEcho(false);
+
+    FirmwareRun fw = runFirmware(seconds, seconds * 0.45, seconds * 0.45 + 1800);
+    benchCheck(fw.received == fw.cycles, "samples lost or extra");
+    benchCheck(fw.duplicates == 0, "sample received twice");
+    benchCheck(fw.wrong == 0, "sample differs from the measurement");
+    benchCheck(fw.replayed > 0, "no batch went through the offline queue");
+    benchCheck(fw.longestGapS * 1000 <= TELEMETRY_BATCH_MS + INTERVAL_NIGHT, "batch held past TELEMETRY_BATCH_MS");
+
+    struct Row {
+        const char* name;
+        Trace trace;
+    };
+    std::vector<Row> rows;
+    rows.push_back(Row{"synthetic", syntheticTrace(seconds)});
+    rows.push_back(Row{"sensor path", fw.samples});
+    if (tracePath) {
+        Trace csv;
+        if (!loadTrace(tracePath, &csv)) {
+            printf("Cannot read trace %s (seconds,temp,humidity,lux,dust)\n", tracePath);
+            return 2;
+        }
+        rows.push_back(Row{tracePath, csv});
+    }
+
+    CodecResult exact[4], snapped[4];
+    for (size_t k = 0; k < rows.size(); k++) {
+        exact[k] = runCodec(rows[k].trace, false);
+        snapped[k] = runCodec(rows[k].trace, true);
+        benchCheck(exact[k].errors == 0, "exact round trip differs");
+        benchCheck(snapped[k].errors == 0 && snapErrors(rows[k].trace) == 0, "snapped value off by more than half a step");
+    }
+    double sensorRatio = (double)snapped[1].frameBytes / snapped[1].batchBytes;
+    benchCheck(sensorRatio >= minRatio, "sensor trace compresses less than --min-ratio against frames");
+    bool edges = edgeCases();
+    benchCheck(edges, "edge cases");
+
+    if (json) {
+        printf("{\"bench\":\"series\",\"traces\":[");
+        for (size_t k = 0; k < rows.size(); k++) {
+            printf("%s{\"name\":\"%s\",\"samples\":%zu,\"frame_bytes\":%llu,\"text_bytes\":%llu,\"exact_bytes\":%llu,"
+                   "\"snapped_bytes\":%llu,\"encode_ns\":%.1f,\"decode_ns\":%.1f}",
+                   k ? "," : "", rows[k].name, exact[k].samples, (unsigned long long)exact[k].frameBytes,
+                   (unsigned long long)exact[k].textBytes, (unsigned long long)exact[k].batchBytes,
+                   (unsigned long long)snapped[k].batchBytes, snapped[k].encodeNs, snapped[k].decodeNs);
+        }
+        printf("],\"firmware_msgs\":%u,\"firmware_bytes\":%llu,\"failures\":%d}\n", fw.messages,
+               (unsigned long long)fw.bytes, benchFailures());
+        return benchFailures() ? 1 : 0;
+    }
+
+    printf("ArgoS compressed batch benchmark (%.0f h, batches of %u bytes / %u s)\n", seconds / 3600.0,
+           (unsigned)TELEMETRY_BATCH_BYTES, (unsigned)(TELEMETRY_BATCH_MS / 1000));
+    printf("  trace          samples  text B (msgs)      frames B   batch B   vs frames  vs text  bits/sample"
+           "  encode ns  decode ns\n");
+    for (size_t k = 0; k < rows.size(); k++) {
+        for (int s = 0; s < 2; s++) {
+            const CodecResult& r = s ? snapped[k] : exact[k];
+            uint64_t payload = r.batchBytes - r.batches * strlen(MQTT_TOPIC(TOPIC_BATCH));
+            printf("  %-12s %s %7zu  %8llu (%5llu)  %9llu  %8llu  %8.1fx  %6.1fx  %11.1f  %9.1f  %9.1f\n",
+                   s ? "" : rows[k].name, s ? "snap " : "exact", r.samples, (unsigned long long)r.textBytes,
+                   (unsigned long long)r.textMsgs, (unsigned long long)r.frameBytes, (unsigned long long)r.batchBytes,
+                   (double)r.frameBytes / r.batchBytes, (double)r.textBytes / r.batchBytes,
+                   payload * 8.0 / r.samples, r.encodeNs, r.decodeNs);
+        }
+    }
+    printf("  edge cases      %s (clock steps, gaps, modes, NaN, full batch, truncation)\n", edges ? "ok" : "WRONG");
+    printf("  firmware        %u cycles, %u received (%u duplicates, %u wrong), %u batches, %llu bytes,\n"
+           "                  %u queue records replayed after a 30 min outage, longest gap %u s\n",
+           fw.cycles, fw.received, fw.duplicates, fw.wrong, fw.messages, (unsigned long long)fw.bytes,
+           fw.replayed, fw.longestGapS);
+    printf("%s\n", benchFailures() ? "FAILED" : "OK");
+    return benchFailures() ? 1 : 0;
+}
@@ -0,0 +1,311 @@
+// Deep-sleep duty cycling (deep_sleep.h): runs the real setup()/loop() built
+// with ENABLE_DEEP_SLEEP and wakes it with the host stand-in of the RTC timer.
+//
+// 1. Day and night wake-ups: virtual awake time from wake-up to sleep for the
+//    cold boot, warm wake-ups and warm wake-ups that start the camera; duty
+//    cycle against the always-on loop; period of the day cycles (the sleep
+//    ends early by the last boot's connect time).
+// 2. State across sleep: before every wake-up the firmware's ordinary RAM is
+//    scrubbed (deep sleep loses it); after setup() the mode, counters,
+//    decision state and the stats interval must be what they were at sleep.
+// 3. Bad RTC record: a flipped byte and a power cycle must boot cold, and the
+//    following sleeps resume warm again.
+// 4. Lease: with a DHCP renewal time (T1) of a few cycles, the cached lease
+//    ages through the sleeps and a wake-up past T1 joins with DHCP.
+//
+// Exits non-zero on a state mismatch, an invalid record accepted, a wake-up
+// that never went back to sleep, a warm wake-up without its telemetry, a
+// cached lease never given up after T1, or day cycles more than 2 % off
+// INTERVAL_DAY on average. (A
+// cold boot runs its first cycle one interval after boot, as without sleep.)
+//
+//   .pio/build/bench_sleep/program [--cycles N] [--json]
+
+#include <Arduino.h>
+#include "host_sim.h"
+#include "bench_util.h"
+#include "config.h"
+#include "core.h"
+#include "deep_sleep.h"
+#include "report.h"
+#include "sensor_stats.h"
+#include "mqtt_client.h"
+#include "net_link.h"
+
+void setup();
+void loop();
+extern MqttClient client;
+extern SystemMode currentMode;
+extern uint32_t dayCycles;
+extern uint32_t statsCycles;
+extern unsigned long lastCheckTime;
+
+static const uint32_t SCRUBBED = 0xDEADBEEF;
+static const uint32_t MAX_PASSES = 100000;     // loop() passes before a wake-up counts as stuck
+static const uint32_t LEASE_S = 30;            // Renewal time of the leases in part 4
+static const int LEASE_WAKES = 10;
+
+// What the firmware has to carry across a sleep
+struct Snapshot {
+    uint8_t mode;
+    uint32_t dayCycles;
+    uint32_t statsCycles;
+    CoreState core;
+    uint8_t stats[SENSOR_STATS_STATE_SIZE];
+};
+
+static void takeSnapshot(Snapshot* s) {
+    memset(s, 0, sizeof(*s));
+    s->mode = (uint8_t)currentMode;
+    s->dayCycles = dayCycles;
+    s->statsCycles = statsCycles;
+    s->core = coreSaveState();
+    sensorStatsSave(s->stats);
+}
+
+// Deep sleep loses ordinary RAM; the host keeps it, so overwrite it
+static void scrubRam() {
+    currentMode = MODE_BOOT;
+    dayCycles = SCRUBBED;
+    statsCycles = SCRUBBED;
+    lastCheckTime = 0;
+    CoreState junk = {-1, 0, 12345.0f};
+    coreRestoreState(junk, 0);
+    sensorStatsResetInterval();
+    sensorStatsAdd(CH_TEMP, -99.0f);
+}
+
+// Restored state against the snapshot at sleep; ages have grown by the sleep
+// plus the time setup() took
+static bool sameState(const Snapshot& before, const Snapshot& after, uint32_t sleptMs, uint32_t setupMs) {
+    uint32_t minAge = before.core.sinceCleanMs + sleptMs;
+    return before.mode == after.mode && before.dayCycles == after.dayCycles &&
+           before.statsCycles == after.statsCycles &&
+           before.core.daysSinceLastClean == after.core.daysSinceLastClean &&
+           memcmp(&before.core.lastSoilingScore, &after.core.lastSoilingScore, sizeof(float)) == 0 &&
+           after.core.sinceCleanMs >= minAge && after.core.sinceCleanMs <= minAge + setupMs + 1 &&
+           memcmp(before.stats, after.stats, SENSOR_STATS_STATE_SIZE) == 0;
+}
+
+// loop() until the firmware goes to sleep; false if it never does
+static bool runUntilSleep() {
+    for (uint32_t i = 0; i < MAX_PASSES; i++) {
+        loop();
+        if (hostDeepSleepPending()) return true;
+        hostClockAdvanceMs(1);
+    }
+    return false;
+}
+
+static uint32_t luxMessages = 0;
+static uint32_t dustMessages = 0;
+static uint32_t dustNan = 0;
+static uint32_t nightStates = 0;
+static uint64_t lastLuxAt = 0;
+static BenchSeries dayPeriodMs;     // Between day-cycle lux messages
+static bool dayPhase = true;
+
+struct WakeResult {
+    double awakeMs;
+    uint32_t setupMs;
+    bool slept;
+    bool camera;                // Camera started during this wake-up
+};
+
+// Wakes the sleeping firmware (or boots it cold) and runs it back to sleep
+static WakeResult wake(bool cold) {
+    WakeResult r;
+    memset(&r, 0, sizeof(r));
+    if (cold) {
+        hostPowerCycle();
+    } else {
+        hostDeepSleepWake();
+    }
+    uint32_t framesBefore = hostCameraStats().framesTaken;
+    uint64_t start = hostClockMicros();
+    setup();
+    r.setupMs = (uint32_t)((hostClockMicros() - start) / 1000);
+    r.slept = runUntilSleep();
+    r.awakeMs = (hostClockMicros() - start) / 1000.0;
+    r.camera = hostCameraStats().framesTaken != framesBefore;
+    return r;
+}
+
+int main(int argc, char** argv) {
+    long cycles = benchArg(argc, argv, "--cycles", 120);
+    bool json = benchHasFlag(argc, argv, "--json");
+    long nightCycles = cycles / 4;
+
+    client.disconnect();
+    hostReset();
+    hostFlashWipe();
+    hostSerialEcho(false);
+    hostCameraSetFrameSize(24 * 1024);
+    HostEnvironment& env = hostEnv();
+    env.lux = 20000.0f;
+    env.temp = 31.0f;
+    env.humidity = 70.0f;
+    env.dust = 60.0f;
+    // Every value published: the lux messages mark the cycles
+    ReportConfig everyValue = reportConfigDefault();
+    everyValue.enabled = false;
+    reportConfigure(everyValue);
+    hostBroker().addObserver([](const std::string& topic, const uint8_t* payload, size_t len) {
+        if (topic == MQTT_TOPIC(TOPIC_LUX)) {
+            luxMessages++;
+            uint64_t now = hostClockMicros();
+            if (dayPhase && lastLuxAt) dayPeriodMs.add((now - lastLuxAt) / 1000.0);
+            lastLuxAt = now;
+        }
+        if (topic == MQTT_TOPIC(TOPIC_DUST)) {
+            dustMessages++;
+            if (len >= 3 && memmem(payload, len, "nan", 3)) dustNan++;
+        }
+        if (topic == MQTT_TOPIC(TOPIC_MODE) && len == 10 && memcmp(payload, "NIGHT_MODE", 10) == 0) nightStates++;
+    });
+
+    // --- 1 + 2. Cold boot, then day and night wake-ups ---
+    BenchSeries warmDay;
+    BenchSeries warmCamera;
+    BenchSeries warmNight;
+    uint32_t wakeups = 0;
+    uint32_t stuck = 0;
+    uint32_t mismatches = 0;
+    uint32_t notWarm = 0;
+    uint32_t missingTelemetry = 0;
+    uint64_t awakeMicros = 0;
+
+    WakeResult cold = wake(true);
+    wakeups++;
+    stuck += cold.slept ? 0 : 1;
+    awakeMicros += (uint64_t)(cold.awakeMs * 1000);
+    uint64_t sleepStart = hostSleepStats().sleptMicros;
+    uint64_t runStart = hostClockMicros() - (uint64_t)(cold.awakeMs * 1000);
+
+    for (long i = 0; i < cycles + nightCycles; i++) {
+        bool night = i >= cycles;
+        dayPhase = !night;
+        // Cleaning conditions now and then: the decision state changes
+        bool trigger = !night && (i % 25) == 24;
+        env.lux = night ? 200.0f : 20000.0f;
+        env.dust = trigger ? 220.0f : 60.0f + (float)(i % 40);
+        env.humidity = trigger ? 40.0f : 70.0f;
+
+        Snapshot before;
+        takeSnapshot(&before);
+        uint32_t sleptMs = (uint32_t)(hostDeepSleepMicros() / 1000);
+        scrubRam();
+        hostDeepSleepWake();
+        uint32_t framesBefore = hostCameraStats().framesTaken;
+        uint64_t start = hostClockMicros();
+        setup();
+        uint32_t setupMs = (uint32_t)((hostClockMicros() - start) / 1000);
+        Snapshot after;
+        takeSnapshot(&after);
+        if (!sleepStats().warm) notWarm++;
+        if (!sameState(before, after, sleptMs, setupMs)) mismatches++;
+
+        if (trigger) setDaysSinceClean(DAYS_BETWEEN_CLEAN);
+        uint32_t luxBefore = luxMessages;
+        SystemMode modeAtWake = currentMode;
+        bool slept = runUntilSleep();
+        // A mode change restarts the wait on the new mode's interval
+        if (luxMessages == luxBefore && currentMode == modeAtWake) missingTelemetry++;
+        double awakeMs = (hostClockMicros() - start) / 1000.0;
+        bool camera = hostCameraStats().framesTaken != framesBefore;
+        wakeups++;
+        stuck += slept ? 0 : 1;
+        awakeMicros += (uint64_t)(awakeMs * 1000);
+        if (night) warmNight.add(awakeMs);
+        else if (camera) warmCamera.add(awakeMs);
+        else warmDay.add(awakeMs);
+    }
+    uint64_t runMicros = hostClockMicros() - runStart;
+    double sleptS = (hostSleepStats().sleptMicros - sleepStart) / 1e6;
+    double duty = 100.0 * awakeMicros / (double)runMicros;
+    uint32_t nightModeStates = nightStates;
+
+    // --- 3. Bad RTC records ---
+    hostRtcCorrupt(hostRtcBytes() / 2);
+    scrubRam();
+    hostDeepSleepWake();
+    setup();
+    SleepStats corrupt = sleepStats();
+    bool corruptKept = dayCycles == SCRUBBED;   // Nothing restored from the bad record
+    bool corruptSlept = runUntilSleep();
+    wakeups++;
+
+    WakeResult power = wake(true);
+    SleepStats powered = sleepStats();
+    wakeups++;
+    stuck += (corruptSlept ? 0 : 1) + (power.slept ? 0 : 1);
+
+    hostDeepSleepWake();
+    setup();
+    bool warmAgain = sleepStats().warm;
+    bool againSlept = runUntilSleep();
+    wakeups++;
+    stuck += againSlept ? 0 : 1;
+
+    // --- 4. Lease across sleeps ---
+    hostNet().leaseS = LEASE_S;
+    WakeResult leased = wake(true);             // DHCP: lease cached with T1 = LEASE_S
+    wakeups++;
+    stuck += leased.slept ? 0 : 1;
+    uint32_t expiredAtWake = 0;
+    for (int i = 0; i < LEASE_WAKES; i++) {
+        hostDeepSleepWake();
+        setup();
+        expiredAtWake += netLinkStats().leaseExpired;
+        stuck += runUntilSleep() ? 0 : 1;
+        wakeups++;
+    }
+
+    benchCheck(stuck == 0, "a wake-up never went back to sleep");
+    benchCheck(mismatches == 0, "state differs after a wake-up");
+    benchCheck(notWarm == 0, "a timer wake-up with a valid record booted cold");
+    benchCheck(warmDay.count() > 0 && warmDay.mean() + BOOT_DELAY_MS <= cold.awakeMs,
+               "warm wake-ups not shorter than a cold boot by the boot delay");
+    benchCheck(!corrupt.warm && corrupt.rejected && corruptKept, "corrupted RTC record accepted");
+    benchCheck(!powered.warm && !powered.rejected, "power cycle did not boot cold");
+    benchCheck(warmAgain, "no warm wake-up after a cold boot");
+    benchCheck(fabs(dayPeriodMs.mean() - INTERVAL_DAY) <= INTERVAL_DAY / 50, "day cycles drift off their interval");
+    benchCheck(missingTelemetry == 0, "a warm wake-up without its telemetry");
+    benchCheck(dustMessages > 0 && dustNan == 0, "day cycle published no dust reading");
+    benchCheck(nightModeStates == 1, "night mode published again after a wake-up (mode lost)");
+    benchCheck(expiredAtWake > 0, "cached lease still used after sleeping past its renewal time");
+
+    if (json) {
+        printf("{\"bench\":\"sleep\",\"wakeups\":%u,\"cold_awake_ms\":%.1f,\"warm_day_awake_ms\":%.1f,"
+               "\"warm_camera_awake_ms\":%.1f,\"warm_night_awake_ms\":%.1f,\"duty_percent\":%.2f,"
+               "\"day_period_ms\":%.0f,\"rtc_bytes\":%u,\"mismatches\":%u,\"lease_renewals\":%u,\"failures\":%d}\n",
+               wakeups, cold.awakeMs, warmDay.mean(), warmCamera.mean(), warmNight.mean(), duty,
+               dayPeriodMs.mean(), (unsigned)hostRtcBytes(), mismatches, expiredAtWake, benchFailures());
+        return benchFailures() ? 1 : 0;
+    }
+
+    printf("ArgoS deep-sleep benchmark (%ld day + %ld night wake-ups, %d s / %d s cycles)\n", cycles, nightCycles,
+           INTERVAL_DAY / 1000, INTERVAL_NIGHT / 1000);
+    printf("  boot                 wakes   awake ms mean      p99\n");
+    printf("  cold                     1  %14.1f\n", cold.awakeMs);
+    printf("  warm day             %5u  %14.1f %8.1f\n", (unsigned)warmDay.count(), warmDay.mean(),
+           warmDay.percentile(99));
+    printf("  warm day + camera    %5u  %14.1f %8.1f\n", (unsigned)warmCamera.count(), warmCamera.mean(),
+           warmCamera.percentile(99));
+    printf("  warm night           %5u  %14.1f %8.1f\n", (unsigned)warmNight.count(), warmNight.mean(),
+           warmNight.percentile(99));
+    printf("  day cycle period    mean %.0f ms  p99 %.0f ms  max %.0f ms (interval %d ms)\n", dayPeriodMs.mean(),
+           dayPeriodMs.percentile(99), dayPeriodMs.max(), INTERVAL_DAY);
+    printf("  duty cycle          %6.1f %% awake (always-on loop: 100 %%), %.0f s asleep\n", duty, sleptS);
+    printf("  state               %u wake-ups checked, %u mismatches, RTC data %u bytes\n",
+           (unsigned)(cycles + nightCycles), mismatches, (unsigned)hostRtcBytes());
+    printf("  bad record          flipped byte: %s; power cycle: %s; next sleep: %s\n",
+           corrupt.rejected && !corrupt.warm ? "rejected, cold boot" : "ACCEPTED",
+           !powered.warm ? "cold boot" : "WARM", warmAgain ? "warm" : "cold");
+    printf("  telemetry           %u warm wake-ups without lux, %u dust readings, %u NaN, NIGHT_MODE published %u x\n",
+           missingTelemetry, dustMessages, dustNan, nightModeStates);
+    printf("  lease T1 %2u s       %d wake-ups: %u joined with DHCP, the lease past T1\n", (unsigned)LEASE_S,
+           LEASE_WAKES, expiredAtWake);
+    printf("%s\n", benchFailures() ? "FAILED" : "OK");
+    return benchFailures() ? 1 : 0;
+}
@@ -0,0 +1,316 @@
+// Soiling score benchmark: decodes and scores a folder of panel JPEGs (file
+// names containing "clean" or "dirty" are labelled) or, without --dir, a
+// generated set of VGA panels at soiling levels 0-4. Reports score per
+// image/level, decode and kernel cost, whether the upload threshold separates
+// clean from soiled panels, and the uplink saved by gating uploads on the
+// score when the firmware runs over a season of cleaning triggers. Exits
+// non-zero if a frame fails to decode, the threshold misclassifies a
+// labelled panel or scoring allocates.
+//
+//   .pio/build/bench_soiling/program [--dir PATH] [--per-level N] [--cycles N] [--json]
+
+#include <Arduino.h>
+#include <dirent.h>
+#include <stdio.h>
+#include <algorithm>
+#include <string>
+#include <vector>
+#include "host_sim.h"
+#include "bench_util.h"
+#include "config.h"
+#include "core.h"
+#include "soiling.h"
+
+void setup();
+void loop();
+
+struct Sample {
+    std::string name;
+    int level;          // 0-4 generated, -1 unknown
+    int label;          // 0 clean, 1 soiled, -1 unlabelled
+    std::vector<uint8_t> jpeg;
+    SoilingScore score;
+    bool decoded;
+};
+
+static uint32_t rng = 0x2545F491;
+
+static uint32_t nextRandom() {
+    rng ^= rng << 13;
+    rng ^= rng >> 17;
+    rng ^= rng << 5;
+    return rng;
+}
+
+static int randomRange(int lo, int hi) { return lo + (int)(nextRandom() % (uint32_t)(hi - lo + 1)); }
+
+static inline void blend(uint8_t* p, const uint8_t* c, float a) {
+    for (int k = 0; k < 3; k++) p[k] = (uint8_t)(p[k] + (c[k] - p[k]) * a);
+}
+
+// VGA photo of a panel: dark cells, light gaps, sun glare, then dust film,
+// dust patches and bright spots growing with the level
+static std::vector<uint8_t> makePanel(int level) {
+    const int w = 640;
+    const int h = 480;
+    std::vector<uint8_t> rgb((size_t)w * h * 3);
+    const int cell = randomRange(70, 90);
+    const int gap = 4;
+    const int ox = randomRange(0, cell);
+    const int oy = randomRange(0, cell);
+    const float glare = (float)randomRange(0, 25);
+    const uint8_t dust[3] = {172, 152, 120};
+    const uint8_t spot[3] = {232, 226, 212};
+
+    for (int y = 0; y < h; y++) {
+        for (int x = 0; x < w; x++) {
+            uint8_t* p = &rgb[((size_t)y * w + x) * 3];
+            bool inGap = (x + ox) % cell < gap || (y + oy) % cell < gap;
+            int base[3] = {22, 34, 78};
+            if (inGap) {
+                base[0] = 150;
+                base[1] = 152;
+                base[2] = 162;
+            }
+            int lift = (int)(glare * x / w) + (int)(nextRandom() % 9) - 4;
+            for (int k = 0; k < 3; k++) p[k] = (uint8_t)std::max(0, std::min(255, base[k] + lift));
+            blend(p, dust, 0.11f * level);
+        }
+    }
+    // Patches: dust settles unevenly (bottom edge, around the frame)
+    int patches = level >= 2 ? level * 2 : 0;
+    for (int i = 0; i < patches; i++) {
+        int cx = randomRange(0, w - 1);
+        int cy = randomRange(h / 3, h - 1);
+        int r = randomRange(50, 110);
+        for (int y = std::max(0, cy - r); y < std::min(h, cy + r); y++) {
+            for (int x = std::max(0, cx - r); x < std::min(w, cx + r); x++) {
+                float d = sqrtf((float)((x - cx) * (x - cx) + (y - cy) * (y - cy))) / r;
+                if (d < 1) blend(&rgb[((size_t)y * w + x) * 3], dust, 0.12f * level * (1 - d));
+            }
+        }
+    }
+    // Spots: droppings and debris
+    int spots = level * level * 6;
+    for (int i = 0; i < spots; i++) {
+        int cx = randomRange(0, w - 1);
+        int cy = randomRange(0, h - 1);
+        int r = randomRange(5, 12);
+        for (int y = std::max(0, cy - r); y < std::min(h, cy + r); y++) {
+            for (int x = std::max(0, cx - r); x < std::min(w, cx + r); x++) {
+                if ((x - cx) * (x - cx) + (y - cy) * (y - cy) <= r * r) blend(&rgb[((size_t)y * w + x) * 3], spot, 0.9f);
+            }
+        }
+    }
+    return hostJpegEncode(&rgb[0], w, h, 80);
+}
+
+static bool loadFile(const std::string& path, std::vector<uint8_t>* out) {
+    FILE* f = fopen(path.c_str(), "rb");
+    if (!f) return false;
+    fseek(f, 0, SEEK_END);
+    long n = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    out->resize(n > 0 ? (size_t)n : 0);
+    bool ok = n > 0 && fread(&(*out)[0], 1, (size_t)n, f) == (size_t)n;
+    fclose(f);
+    return ok;
+}
+
+static void loadFolder(const char* dir, std::vector<Sample>* samples) {
+    DIR* d = opendir(dir);
+    if (!d) return;
+    std::vector<std::string> names;
+    while (dirent* e = readdir(d)) {
+        std::string n = e->d_name;
+        std::string lower = n;
+        std::transform(lower.begin(), lower.end(), lower.begin(), ::tolower);
+        if (lower.size() > 4 && (lower.rfind(".jpg") == lower.size() - 4 || lower.rfind(".jpeg") == lower.size() - 5)) {
+            names.push_back(n);
+        }
+    }
+    closedir(d);
+    std::sort(names.begin(), names.end());
+    for (size_t i = 0; i < names.size(); i++) {
+        Sample s;
+        s.name = names[i];
+        s.level = -1;
+        std::string lower = names[i];
+        std::transform(lower.begin(), lower.end(), lower.begin(), ::tolower);
+        s.label = lower.find("clean") != std::string::npos ? 0
+                  : (lower.find("dirty") != std::string::npos || lower.find("soil") != std::string::npos) ? 1
+                                                                                                             : -1;
+        if (loadFile(std::string(dir) + "/" + names[i], &s.jpeg)) samples->push_back(s);
+    }
+}
+
+int main(int argc, char** argv) {
+    const char* dir = benchArgStr(argc, argv, "--dir", nullptr);
+    long perLevel = benchArg(argc, argv, "--per-level", 8);
+    long cycles = benchArg(argc, argv, "--cycles", 2000);
+    bool json = benchHasFlag(argc, argv, "--json");
+
+    hostReset();
+    hostSerialEcho(false);
+
+    // --- 1. Score every sample ---
+    std::vector<Sample> samples;
+    if (dir) {
+        loadFolder(dir, &samples);
+        if (samples.empty()) {
+            printf("no JPEGs in %s\n", dir);
+            return 1;
+        }
+    } else {
+        for (int level = 0; level <= 4; level++) {
+            for (long i = 0; i < perLevel; i++) {
+                Sample s;
+                char name[40];
+                snprintf(name, sizeof(name), "panel_l%d_%02ld.jpg", level, i);
+                s.name = name;
+                s.level = level;
+                s.label = level <= 1 ? 0 : (level >= 3 ? 1 : -1);
+                s.jpeg = makePanel(level);
+                samples.push_back(s);
+            }
+        }
+    }
+
+    int failures = 0;
+    uint32_t decodeFailures = 0;
+    BenchSeries hostNs;
+    BenchSeries deviceMs;
+    BenchAllocDelta heap;
+    for (size_t i = 0; i < samples.size(); i++) {
+        Sample& s = samples[i];
+        uint64_t v0 = hostClockMicros();
+        uint64_t t0 = benchNowNs();
+        s.decoded = scoreSoilingJpeg(&s.jpeg[0], s.jpeg.size(), &s.score);
+        hostNs.add((double)(benchNowNs() - t0));
+        deviceMs.add((hostClockMicros() - v0) / 1000.0);
+        if (!s.decoded) decodeFailures++;
+    }
+    if (decodeFailures) failures++;
+    uint64_t scoreAllocs = heap.allocs();
+    if (scoreAllocs) failures++;
+
+    // Kernel alone, on a grid already decoded
+    static uint8_t grid[SOILING_GRID_W * SOILING_GRID_H];
+    for (size_t i = 0; i < sizeof(grid); i++) grid[i] = (uint8_t)nextRandom();
+    SoilingScore kernel;
+    const int kernelRuns = 20000;
+    uint64_t k0 = benchNowNs();
+    for (int i = 0; i < kernelRuns; i++) {
+        grid[i % sizeof(grid)] ^= 1;
+        scoreSoilingGray(grid, SOILING_GRID_W, SOILING_GRID_H, &kernel);
+    }
+    double kernelNs = (double)(benchNowNs() - k0) / kernelRuns;
+
+    // Threshold separation on labelled samples
+    uint32_t labelled = 0;
+    uint32_t correct = 0;
+    float maxClean = 0;
+    float minSoiled = 100;
+    for (size_t i = 0; i < samples.size(); i++) {
+        const Sample& s = samples[i];
+        if (s.label < 0 || !s.decoded) continue;
+        labelled++;
+        bool upload = s.score.score >= SOILING_UPLOAD_SCORE;
+        if (upload == (s.label == 1)) correct++;
+        if (s.label == 0) maxClean = std::max(maxClean, s.score.score);
+        else minSoiled = std::min(minSoiled, s.score.score);
+    }
+    if (correct != labelled) failures++;
+
+    // --- 2. Uplink through the firmware over a season of dust triggers ---
+    // The panel gets dirtier with every cycle since it was last cleaned, and
+    // is cleaned when the firmware raises the alert. Before the score, every
+    // trigger raised the alert and uploaded a frame.
+    std::vector<std::vector<uint8_t> > panels;
+    for (int level = 0; level <= 4; level++) panels.push_back(makePanel(level));
+    hostReset();
+    hostFlashWipe();
+    hostSerialEcho(false);
+    HostEnvironment& env = hostEnv();
+    env.lux = 20000.0f;
+    env.temp = 31.0f;
+    uint32_t cleanings = 0;
+    hostBroker().addObserver([&](const std::string& topic, const uint8_t* payload, size_t len) {
+        if (topic == MQTT_TOPIC(TOPIC_ALERT) && len == 4 && !memcmp(payload, "true", 4)) cleanings++;
+    });
+    setup();
+    uint32_t triggers = 0;
+    uint64_t baselineBytes = 0;
+    uint32_t imagesBefore = hostDashboardStats().imagesCompleted;
+    uint64_t imageBytes = 0;
+    long sinceClean = 0;
+    for (long i = 0; i < cycles; i++) {
+        int level = (int)std::min(4L, sinceClean / 120);
+        hostCameraSetFrame(&panels[level][0], panels[level].size());
+        bool trigger = (i % 25) == 24;      // Dry, dusty afternoon
+        env.dust = trigger ? 220.0f : 60.0f;
+        env.humidity = trigger ? 40.0f : 70.0f;
+        if (trigger) {
+            setDaysSinceClean(DAYS_BETWEEN_CLEAN);
+            triggers++;
+            baselineBytes += panels[level].size();
+        }
+        uint32_t cleaningsBefore = cleanings;
+        uint32_t uploadsBefore = hostDashboardStats().imagesCompleted;
+        hostClockAdvanceMs(INTERVAL_DAY + 1);
+        loop();
+        if (hostDashboardStats().imagesCompleted != uploadsBefore) imageBytes += panels[level].size();
+        sinceClean = cleanings != cleaningsBefore ? 0 : sinceClean + 1;
+    }
+    uint32_t uploads = hostDashboardStats().imagesCompleted - imagesBefore;
+    if (triggers && uploads >= triggers) failures++;
+
+    if (json) {
+        printf("{\"bench\":\"soiling\",\"samples\":%u,\"decode_failures\":%u,\"host_us\":%.1f,"
+               "\"device_ms\":%.1f,\"kernel_ns\":%.0f,\"score_allocs\":%llu,\"labelled\":%u,\"correct\":%u,"
+               "\"max_clean\":%.1f,\"min_soiled\":%.1f,\"cycles\":%ld,\"triggers\":%u,\"cleanings\":%u,"
+               "\"uploads\":%u,\"baseline_image_bytes\":%llu,\"image_bytes\":%llu,\"failures\":%d}\n",
+               (unsigned)samples.size(), decodeFailures, hostNs.mean() / 1000.0, deviceMs.mean(), kernelNs,
+               (unsigned long long)scoreAllocs, labelled, correct, maxClean, minSoiled, cycles, triggers, cleanings,
+               uploads, (unsigned long long)baselineBytes, (unsigned long long)imageBytes, failures);
+    } else {
+        printf("ArgoS soiling score benchmark (%u images%s%s)\n", (unsigned)samples.size(), dir ? " from " : ", generated",
+               dir ? dir : "");
+        if (dir) {
+            for (size_t i = 0; i < samples.size(); i++) {
+                const Sample& s = samples[i];
+                printf("  %-32s %s score %5.1f  (uniformity %.2f haze %.2f spots %.2f)\n", s.name.c_str(),
+                       s.decoded ? "  " : "!!", s.score.score, s.score.uniformity, s.score.haze, s.score.spots);
+            }
+        } else {
+            printf("  level  score mean   min    max   uniformity  haze  spots\n");
+            for (int level = 0; level <= 4; level++) {
+                float sum = 0, lo = 100, hi = 0, u = 0, hz = 0, sp = 0;
+                int n = 0;
+                for (size_t i = 0; i < samples.size(); i++) {
+                    const Sample& s = samples[i];
+                    if (s.level != level) continue;
+                    sum += s.score.score;
+                    lo = std::min(lo, s.score.score);
+                    hi = std::max(hi, s.score.score);
+                    u += s.score.uniformity;
+                    hz += s.score.haze;
+                    sp += s.score.spots;
+                    n++;
+                }
+                printf("  %5d  %10.1f  %5.1f  %5.1f  %10.2f  %4.2f  %5.2f\n", level, sum / n, lo, hi, u / n, hz / n,
+                       sp / n);
+            }
+        }
+        printf("  threshold %d        %u/%u labelled correct (clean max %.1f, soiled min %.1f)\n",
+               SOILING_UPLOAD_SCORE, correct, labelled, maxClean, minSoiled);
+        printf("  cost / frame        %.1f ms device (estimated decode), %.1f us host, kernel %.0f ns, %llu allocs\n",
+               deviceMs.mean(), hostNs.mean() / 1000.0, kernelNs, (unsigned long long)scoreAllocs);
+        printf("  %ld day cycles     %u dust triggers: %u uploads / %llu KB before, %u cleanings, %u uploads / "
+               "%llu KB gated\n",
+               cycles, triggers, triggers, (unsigned long long)(baselineBytes / 1024), cleanings, uploads,
+               (unsigned long long)(imageBytes / 1024));
+        printf("  %s\n", failures ? "FAILED" : "OK");
+    }
+    return failures ? 1 : 0;
+}
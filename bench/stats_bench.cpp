@@ -0,0 +1,285 @@
+// Streaming statistics benchmark: accuracy of the incremental estimators
+// (Welford moments, P-square p50/p95) against exact statistics on noisy,
+// skewed, bimodal and spiky streams; cost per sample and memory as the
+// window grows, against recomputing over a window buffer on every sample (the
+// old dust moving average); and the interval aggregates the firmware
+// publishes. Exits non-zero if a quantile misses its rank, the cost per sample
+// grows with the window, or the published aggregates are wrong.
+//
+//   .pio/build/bench_stats/program [--samples N] [--cycles N] [--json]
+
+#include <Arduino.h>
+#include <math.h>
+#include <algorithm>
+#include <string>
+#include <vector>
+#include "host_sim.h"
+#include "bench_util.h"
+#include "config.h"
+#include "core.h"
+#include "stream_stats.h"
+#include "sensor_stats.h"
+
+void setup();
+void loop();
+
+static uint32_t rng = 0x2545F491;
+
+static float uniform() {
+    rng ^= rng << 13;
+    rng ^= rng >> 17;
+    rng ^= rng << 5;
+    return (rng & 0xFFFFFF) / 16777216.0f;
+}
+
+static float gaussian() {
+    float u = uniform() + 1e-7f;
+    return sqrtf(-2.0f * logf(u)) * cosf(6.2831853f * uniform());
+}
+
+enum Shape { SHAPE_NORMAL, SHAPE_SKEWED, SHAPE_BIMODAL, SHAPE_SPIKY, SHAPE_OFFSET, SHAPES };
+static const char* shapeNames[SHAPES] = {"normal", "skewed", "bimodal", "spiky", "offset"};
+
+static float sample(int shape) {
+    switch (shape) {
+        case SHAPE_NORMAL: return 25.0f + 2.0f * gaussian();                    // Temperature
+        case SHAPE_SKEWED: return 20000.0f * expf(0.6f * gaussian());           // Lux under clouds
+        case SHAPE_BIMODAL: return uniform() < 0.7f ? 60.0f + 5.0f * gaussian() : 180.0f + 10.0f * gaussian();
+        case SHAPE_SPIKY: return 80.0f + 3.0f * gaussian() + (uniform() < 0.03f ? 400.0f : 0.0f);
+        default: return 50000.0f + 0.5f * gaussian();                          // Bright, steady
+    }
+}
+
+// Where `value` falls in the sorted data, as a fraction (the quantile it is)
+static double rankOf(const std::vector<float>& sorted, float value) {
+    size_t below = std::lower_bound(sorted.begin(), sorted.end(), value) - sorted.begin();
+    size_t upTo = std::upper_bound(sorted.begin(), sorted.end(), value) - sorted.begin();
+    return (below + upTo) / 2.0 / sorted.size();
+}
+
+struct ShapeResult {
+    double meanErr;     // Relative to the exact std
+    double stdErr;      // Relative
+    double p50Rank;
+    double p95Rank;
+    double naiveStdErr; // float sum / sum of squares
+};
+
+static ShapeResult accuracy(int shape, long n) {
+    std::vector<float> data;
+    data.reserve(n);
+    ChannelStats stats;
+    float sum = 0;
+    float sumSq = 0;
+    for (long i = 0; i < n; i++) {
+        float x = sample(shape);
+        data.push_back(x);
+        stats.add(x);
+        sum += x;
+        sumSq += x * x;
+    }
+    double mean = 0;
+    for (long i = 0; i < n; i++) mean += data[i];
+    mean /= n;
+    double var = 0;
+    for (long i = 0; i < n; i++) var += (data[i] - mean) * (data[i] - mean);
+    double sd = sqrt(var / (n - 1));
+    std::sort(data.begin(), data.end());
+
+    StatsSummary s;
+    stats.summary(&s);
+    float naiveVar = (sumSq - sum * sum / n) / (n - 1);
+    ShapeResult r;
+    r.meanErr = fabs(s.mean - mean) / sd;
+    r.stdErr = fabs(s.std - sd) / sd;
+    r.p50Rank = rankOf(data, s.p50);
+    r.p95Rank = rankOf(data, s.p95);
+    r.naiveStdErr = fabs(sqrt(fabs(naiveVar)) - sd) / sd;
+    return r;
+}
+
+// Old approach: the window kept in a buffer and every statistic recomputed
+// over it on each sample
+struct NaiveWindow {
+    std::vector<float> ring;
+    std::vector<float> scratch;
+    size_t next;
+    size_t filled;
+    float mean;
+    float p50;
+    float p95;
+
+    explicit NaiveWindow(size_t w) : ring(w), scratch(w), next(0), filled(0), mean(0), p50(0), p95(0) {}
+
+    void fill(const float* data) {
+        std::copy(data, data + ring.size(), ring.begin());
+        filled = ring.size();
+    }
+
+    void add(float x) {
+        ring[next] = x;
+        next = (next + 1) % ring.size();
+        if (filled < ring.size()) filled++;
+        float sum = 0;
+        for (size_t i = 0; i < filled; i++) sum += ring[i];
+        mean = sum / filled;
+        std::copy(ring.begin(), ring.begin() + filled, scratch.begin());
+        std::nth_element(scratch.begin(), scratch.begin() + filled / 2, scratch.begin() + filled);
+        p50 = scratch[filled / 2];
+        size_t hi = (size_t)(0.95 * (filled - 1));
+        std::nth_element(scratch.begin(), scratch.begin() + hi, scratch.begin() + filled);
+        p95 = scratch[hi];
+    }
+};
+
+// --- Firmware aggregates, seen at the broker ---
+struct Published {
+    uint32_t reports;
+    uint32_t lastN;
+    float lastMean;
+    float tempAtReport;
+    float lastP95;
+    uint32_t luxReports;
+    uint32_t luxN;
+};
+
+static Published published;
+
+static float jsonField(const uint8_t* payload, size_t len, const char* key) {
+    std::string json((const char*)payload, len);
+    size_t at = json.find(std::string("\"") + key + "\":");
+    return at == std::string::npos ? NAN : strtof(json.c_str() + at + strlen(key) + 3, nullptr);
+}
+
+int main(int argc, char** argv) {
+    long n = benchArg(argc, argv, "--samples", 100000);
+    long cycles = benchArg(argc, argv, "--cycles", 10 * STATS_REPORT_CYCLES);
+    bool json = benchHasFlag(argc, argv, "--json");
+    int failures = 0;
+
+    // --- 1. Accuracy against exact statistics ---
+    ShapeResult shapes[SHAPES];
+    for (int sh = 0; sh < SHAPES; sh++) {
+        shapes[sh] = accuracy(sh, n);
+        const ShapeResult& r = shapes[sh];
+        if (r.meanErr > 0.01 || r.stdErr > 0.02) failures++;
+        if (fabs(r.p50Rank - 0.50) > 0.02 || fabs(r.p95Rank - 0.95) > 0.02) failures++;
+    }
+
+    // --- 2. Cost per sample and memory as the window grows ---
+    const size_t windows[] = {16, 128, 1024, 8192, 65536};
+    const int windowCount = sizeof(windows) / sizeof(windows[0]);
+    double streamNs[windowCount];
+    double naiveNs[windowCount];
+    std::vector<float> input(1 << 20);
+    for (size_t i = 0; i < input.size(); i++) input[i] = sample(SHAPE_SPIKY);
+    volatile float sink = 0;
+    for (int w = 0; w < windowCount; w++) {
+        // Streaming: tumbling windows of `windows[w]` samples
+        ChannelStats stats;
+        StatsSummary s;
+        uint64_t t0 = benchNowNs();
+        for (size_t i = 0; i < input.size(); i++) {
+            stats.add(input[i]);
+            if ((i + 1) % windows[w] == 0) {
+                stats.summary(&s);
+                sink += s.p95;
+                stats.reset();
+            }
+        }
+        streamNs[w] = (double)(benchNowNs() - t0) / input.size();
+
+        // Recomputed over a full window; fewer samples timed as it grows
+        NaiveWindow naive(windows[w]);
+        naive.fill(&input[0]);
+        size_t count = std::max((size_t)64, (size_t)(20000000 / windows[w]));
+        count = std::min(count, input.size());
+        t0 = benchNowNs();
+        for (size_t i = 0; i < count; i++) {
+            naive.add(input[i]);
+        }
+        sink += naive.p95;
+        naiveNs[w] = (double)(benchNowNs() - t0) / count;
+    }
+    (void)sink;
+    double growth = streamNs[windowCount - 1] / streamNs[0];
+    if (growth > 2.0) failures++;
+
+    // --- 3. Firmware: aggregates published every STATS_REPORT_CYCLES cycles ---
+    hostReset();
+    hostSerialEcho(false);
+    HostEnvironment& env = hostEnv();
+    env.lux = 20000.0f;
+    env.temp = 25.0f;
+    env.humidity = 70.0f;
+    env.dust = 60.0f;
+    memset(&published, 0, sizeof(published));
+    hostBroker().addObserver([](const std::string& topic, const uint8_t* payload, size_t len) {
+        if (topic == MQTT_TOPIC(TOPIC_TEMP TOPIC_STATS)) {
+            published.reports++;
+            published.lastN = (uint32_t)jsonField(payload, len, "n");
+            published.lastMean = jsonField(payload, len, "mean");
+            published.lastP95 = jsonField(payload, len, "p95");
+            published.tempAtReport = hostEnv().temp;
+        }
+        if (topic == MQTT_TOPIC(TOPIC_LUX TOPIC_STATS)) {
+            published.luxReports++;
+            published.luxN = (uint32_t)jsonField(payload, len, "n");
+        }
+    });
+    setup();
+    // Temperature ramps 25 -> 35 C; loop() runs every 250 ms
+    const uint32_t stepMs = 250;
+    uint64_t endMs = hostClockMicros() / 1000 + (uint64_t)cycles * (INTERVAL_DAY + 1);
+    uint32_t passes = 0;
+    while (hostClockMicros() / 1000 < endMs) {
+        env.temp = 25.0f + 10.0f * passes / (cycles * (INTERVAL_DAY / stepMs));
+        loop();
+        hostClockAdvanceMs(stepMs);
+        passes++;
+    }
+    uint32_t expectedReports = (uint32_t)(cycles / STATS_REPORT_CYCLES);
+    uint32_t samplesPerInterval = STATS_REPORT_CYCLES * (INTERVAL_DAY / STATS_SAMPLE_MS);
+    // Linear ramp: the interval mean is the temperature half an interval back
+    float lastTruth = published.tempAtReport - 10.0f * STATS_REPORT_CYCLES / cycles / 2;
+    if (published.reports + 1 < expectedReports || published.reports > expectedReports) failures++;
+    if (published.lastN + 2 < samplesPerInterval || published.lastN > samplesPerInterval + 2) failures++;
+    if (fabs(published.lastMean - lastTruth) > 0.2) failures++;
+
+    if (json) {
+        printf("{\"bench\":\"stats\",\"samples\":%ld", n);
+        for (int sh = 0; sh < SHAPES; sh++) {
+            printf(",\"%s\":{\"mean_err\":%.5f,\"std_err\":%.5f,\"p50_rank\":%.4f,\"p95_rank\":%.4f,\"naive_std_err\":%.4f}",
+                   shapeNames[sh], shapes[sh].meanErr, shapes[sh].stdErr, shapes[sh].p50Rank, shapes[sh].p95Rank,
+                   shapes[sh].naiveStdErr);
+        }
+        printf(",\"stream_bytes\":%u,\"stream_ns\":[", (unsigned)sizeof(ChannelStats));
+        for (int w = 0; w < windowCount; w++) printf("%s%.1f", w ? "," : "", streamNs[w]);
+        printf("],\"naive_ns\":[");
+        for (int w = 0; w < windowCount; w++) printf("%s%.1f", w ? "," : "", naiveNs[w]);
+        printf("],\"reports\":%u,\"report_n\":%u,\"report_mean\":%.2f,\"truth_mean\":%.2f,\"lux_n\":%u,\"failures\":%d}\n",
+               published.reports, published.lastN, published.lastMean, lastTruth, published.luxN, failures);
+    } else {
+        printf("ArgoS streaming statistics benchmark (%ld samples per stream)\n", n);
+        printf("  stream     mean err   std err   p50 rank  p95 rank   naive std err\n");
+        for (int sh = 0; sh < SHAPES; sh++) {
+            const ShapeResult& r = shapes[sh];
+            printf("  %-8s  %7.4f s  %7.2f %%   %7.4f   %7.4f   %10.2f %%\n", shapeNames[sh], r.meanErr,
+                   r.stdErr * 100, r.p50Rank, r.p95Rank, r.naiveStdErr * 100);
+        }
+        printf("  window     streaming ns/sample (%u B)   recomputed ns/sample (bytes)\n", (unsigned)sizeof(ChannelStats));
+        for (int w = 0; w < windowCount; w++) {
+            printf("  %6u   %12.1f   %22.1f (%u)\n", (unsigned)windows[w], streamNs[w], naiveNs[w],
+                   (unsigned)(windows[w] * 2 * sizeof(float)));
+        }
+        printf("  cost growth        %.2fx from %u to %u samples per window\n", growth, (unsigned)windows[0],
+               (unsigned)windows[windowCount - 1]);
+        printf("  firmware           %u temperature reports (expected %u), last n %u (expected ~%u), mean %.2f C "
+               "(truth %.2f), p95 %.2f C\n", published.reports, expectedReports, published.lastN, samplesPerInterval,
+               published.lastMean, lastTruth, published.lastP95);
+        printf("                     lux: %u reports, %u samples per interval (every loop pass)\n", published.luxReports,
+               published.luxN);
+        printf("%s\n", failures ? "FAIL" : "OK");
+    }
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,145 @@
+// Digital twin (host_twin.cpp): traces replayed through the real
+// setup()/loop() on the virtual clock.
+//
+// 1. Synthetic weeks: simulated days per second, and the same event lines
+//    from a second run (seed, trace and build fixed).
+// 2. Recorded trace: a CSV with its columns in another order (header) over
+//    two dry, bright days. Dust over DUST_THRESHOLD for an hour on the second
+//    midday raises one alert in that hour; the same trace without it none;
+//    the mode follows sunrise and sunset. A malformed file is rejected.
+//
+// Exits non-zero below --min-days-per-s (default 1) or if a check fails.
+//
+//   .pio/build/bench_twin/program [--days N] [--min-days-per-s N] [--json]
+
+#include <Arduino.h>
+#include <string>
+#include <vector>
+#include <sys/wait.h>
+#include <unistd.h>
+#include "host_sim.h"
+#include "bench_util.h"
+#include "config.h"
+
+// Runs the twin in a child process (one run per process, see host_sim.h),
+// its event lines back in memory
+static HostTwinStats runCaptured(HostTwinOptions options, std::string* events) {
+    HostTwinStats stats = {};
+    FILE* f = tmpfile();
+    int fds[2];
+    if (!f || pipe(fds) != 0) return stats;
+    fflush(stdout);
+    pid_t child = fork();
+    if (child == 0) {
+        options.events = f;
+        stats = hostTwinRun(options);
+        fflush(f);
+        _exit(write(fds[1], &stats, sizeof(stats)) == (ssize_t)sizeof(stats) ? 0 : 1);
+    }
+    close(fds[1]);
+    if (child < 0 || read(fds[0], &stats, sizeof(stats)) != (ssize_t)sizeof(stats)) stats = HostTwinStats();
+    close(fds[0]);
+    waitpid(child, nullptr, 0);
+    events->clear();
+    rewind(f);
+    char buf[4096];
+    size_t n;
+    while ((n = fread(buf, 1, sizeof(buf), f)) > 0) events->append(buf, n);
+    fclose(f);
+    return stats;
+}
+
+// Trace time of the first alert raised, -1 if none
+static double firstAlert(const std::string& events) {
+    size_t at = events.find("\"ev\":\"alert\",\"v\":true");
+    if (at == std::string::npos) return -1;
+    size_t line = events.rfind('\n', at);
+    line = line == std::string::npos ? 0 : line + 1;
+    return atof(events.c_str() + line + 5);        // {"t":
+}
+
+// Two clear days from midnight, every 5 minutes: seconds,temp,humidity,lux,dust
+static bool writeTrace(const char* path, bool spike) {
+    FILE* f = fopen(path, "w");
+    if (!f) return false;
+    fprintf(f, "seconds,temp,humidity,lux,dust\n");
+    for (int t = 0; t <= 2 * 86400; t += 300) {
+        double h = fmod(t / 3600.0, 24.0);
+        double sun = h > 6 && h < 20 ? sin(M_PI * (h - 6) / 14) : 0;
+        bool dusty = spike && t >= 86400 + 12 * 3600 && t < 86400 + 13 * 3600;
+        fprintf(f, "%d,%.1f,%.1f,%.0f,%.0f\n", t, 18 + 10 * sun, 70 - 35 * sun, 2 + 80000 * sun,
+                dusty ? DUST_THRESHOLD * 2.0 : 40.0);
+    }
+    fclose(f);
+    return true;
+}
+
+int main(int argc, char** argv) {
+    bool json = benchHasFlag(argc, argv, "--json");
+    long days = benchArg(argc, argv, "--days", 14);
+    long minRate = benchArg(argc, argv, "--min-days-per-s", 1);
+
+    // --- 1. Synthetic weeks ---
+    HostTwinOptions options = hostTwinDefaults();
+    options.seconds = days * 86400.0;
+    std::string first, second;
+    HostTwinStats run = runCaptured(options, &first);
+    runCaptured(options, &second);
+    double rate = run.wallSeconds > 0 ? run.simSeconds / 86400.0 / run.wallSeconds : 0;
+    benchCheck(rate >= minRate, "simulated days per second under --min-days-per-s");
+    benchCheck(first == second, "second run gives other events");
+    benchCheck(run.modeChanges >= 2 * (uint32_t)days - 2, "no day/night mode change every sunrise and sunset");
+    benchCheck(run.publishes > 0, "nothing published");
+
+    // --- 2. Recorded trace ---
+    const char* path = "/tmp/argus_twin_trace.csv";
+    std::vector<HostTraceRow> rows;
+    std::string error, quiet, dusty;
+    HostTwinStats clean = {}, spiked = {};
+    bool loaded = writeTrace(path, false) && hostTraceLoad(path, &rows, &error);
+    benchCheck(loaded, "trace with a header not loaded");
+    if (loaded) {
+        benchCheck(rows.size() == 577 && rows[144].env.lux > 5000 && rows[144].env.dust == 40, "columns not mapped");
+        options = hostTwinDefaults();
+        options.trace = &rows;
+        clean = runCaptured(options, &quiet);
+        benchCheck(clean.alertsRaised == 0, "alert without dust");
+        benchCheck(clean.modeChanges == 4, "mode changes other than two sunrises and sunsets");
+        benchCheck(fabs(clean.simSeconds - 2 * 86400.0) < 2, "not the trace's span");
+    }
+    loaded = writeTrace(path, true) && hostTraceLoad(path, &rows, &error);
+    if (loaded) {
+        spiked = runCaptured(options, &dusty);
+        double raised = firstAlert(dusty);
+        benchCheck(spiked.alertsRaised == 1, "not one alert for the dust hour");
+        // Rows are interpolated: the dust rises over the 5 minutes before noon
+        benchCheck(raised >= 86400 + 12 * 3600 - 300 && raised < 86400 + 13 * 3600, "alert outside the dust hour");
+    }
+    FILE* f = fopen(path, "w");
+    if (f) {
+        fprintf(f, "seconds,lux,dust,temp,humidity\n0,1,2,3,4\n60,1,2,3\n");
+        fclose(f);
+    }
+    benchCheck(!hostTraceLoad(path, &rows, &error), "short row accepted");
+    remove(path);
+
+    if (json) {
+        printf("{\"bench\":\"twin\",\"days\":%ld,\"wall_s\":%.2f,\"days_per_s\":%.2f,\"passes\":%llu,"
+               "\"mode_changes\":%u,\"alerts\":%u,\"publishes\":%llu,\"publish_bytes\":%llu,"
+               "\"trace_alerts\":[%u,%u],\"ok\":%s}\n",
+               days, run.wallSeconds, rate, (unsigned long long)run.passes, run.modeChanges, run.alertsRaised,
+               (unsigned long long)run.publishes, (unsigned long long)run.publishBytes, clean.alertsRaised,
+               spiked.alertsRaised, benchFailures() ? "false" : "true");
+        return benchFailures() ? 1 : 0;
+    }
+    printf("ArgoS digital twin\n");
+    printf("  synthetic %ld days: %.2f s wall, %.1f simulated days/s, %llu loop() passes\n", days, run.wallSeconds,
+           rate, (unsigned long long)run.passes);
+    printf("    mode changes %u, alerts %u, publishes %llu (%llu bytes), repeat run %s\n", run.modeChanges,
+           run.alertsRaised, (unsigned long long)run.publishes, (unsigned long long)run.publishBytes,
+           first == second ? "identical" : "DIFFERS");
+    printf("  recorded 2 days: alerts %u clean / %u with a dust hour, mode changes %u\n", clean.alertsRaised,
+           spiked.alertsRaised, clean.modeChanges);
+    printf("%s\n", benchFailures() ? "FAILED" : "OK");
+    return benchFailures() ? 1 : 0;
+}
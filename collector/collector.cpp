@@ -0,0 +1,1021 @@
+#include "collector.h"
+#include "image_assembly.h"
+#include "image_delta.h"
+#include "mqtt_wire.h"
+#include "record_ring.h"
+#include "checksum.h"
+#include "series_codec.h"
+#include "telemetry_frame.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <new>
+#include <thread>
+
+#define TOPIC_PREFIX_LEN (sizeof(TOPIC_PREFIX) - 1)
+#define OUTBOX_BYTES     (1 << 16)     // Per worker, encoded ACKs for the I/O thread
+#define ACK_RANGES_MAX   32
+
+enum Counter {
+    C_CONNECTS, C_MESSAGES, C_BYTES, C_RING_WAITS, C_ROWS, C_CHUNKS, C_DUPLICATES, C_CRC_ERRORS, C_SLOT_WAITS,
+    C_RECLAIMED, C_IMAGES, C_IMAGE_BYTES, C_ACKS, C_KEY_REQUESTS, C_REJECTED, C_IGNORED, C_WRITE_ERRORS, C_CPU_US,
+    C_COUNT
+};
+
+// Each counter has one writer: a worker, or the I/O thread
+typedef std::atomic<uint64_t> Counters[C_COUNT];
+
+static inline void count(Counters& c, Counter which, uint64_t n = 1) {
+    c[which].store(c[which].load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+}
+
+struct DeviceState {
+    uint32_t hash;
+    uint8_t idLen;              // 0: free entry
+    bool dirReady;              // <outDir>/<id> created
+    bool haveDone;
+    bool haveKeyframe;
+    int16_t slot;               // Image in reassembly, -1 for none
+    uint16_t doneId;            // Last image completed: its duplicates are ACKed whole
+    uint16_t doneCount;
+    uint16_t keyframeId;
+    char id[COLLECTOR_DEVICE_ID_MAX + 1];
+};
+
+struct Worker {
+    uint16_t index;
+    RecordRing in;              // Messages, from the I/O thread
+    RecordRing out;             // Encoded PUBLISH packets, to the I/O thread
+    DeviceState* devices;
+    uint32_t deviceBits;
+    uint32_t deviceCount;
+    ImagePool pool;
+    char* rows;
+    size_t rowsLen;
+    int rowsFd;
+    std::thread thread;
+    std::mutex lock;
+    std::condition_variable wake;
+    std::atomic<bool> sleeping;
+    Counters counter;
+};
+
+// Telemetry row columns after the key fields
+enum Column { COL_TEMP, COL_HUMIDITY, COL_LUX, COL_DUST, COL_EFFICIENCY, COL_SOILING, COLUMNS };
+
+struct Row {
+    uint32_t time;
+    bool uptime;
+    bool haveSeq;
+    uint32_t seq;
+    uint8_t channel;
+    int mode;                   // SystemMode, -1 when not sent
+    float value[COLUMNS];
+};
+
+static const struct {
+    const char* topic;
+    Column column;
+} metricTopics[] = {
+    {TOPIC_TEMP, COL_TEMP}, {TOPIC_HUM, COL_HUMIDITY}, {TOPIC_LUX, COL_LUX},
+    {TOPIC_DUST, COL_DUST}, {TOPIC_SOILING, COL_SOILING},
+};
+
+static CollectorConfig cfg;
+static Worker* workers = nullptr;
+static std::thread ioThread;
+static std::atomic<bool> ioRunning(false);
+static std::atomic<bool> workersRunning(false);
+static std::atomic<bool> connectedFlag(false);
+static std::atomic<bool> ioSleeping(false);
+static int wakeFd = -1;
+static sockaddr_storage brokerAddr;
+static socklen_t brokerAddrLen = 0;
+static char outDir[256];
+static char filterSensor[64];
+static char filterCamera[64];
+static Counters ioCounter;
+
+// I/O thread only
+static int sock = -1;
+static uint8_t* rx = nullptr;
+static size_t rxLen = 0;
+static size_t rxSkip = 0;       // Rest of a packet too large for rx
+static uint8_t* tx = nullptr;
+static size_t txLen = 0;
+static uint32_t lastOutMs = 0;
+static uint32_t pingSentMs = 0;
+static bool pingOutstanding = false;
+
+static uint32_t nowMs() {
+    return (uint32_t)std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// CPU time of the calling thread
+static uint64_t threadCpuUs() {
+    timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + (uint64_t)ts.tv_nsec / 1000;
+}
+
+static inline void put16(uint8_t* p, uint16_t v) { memcpy(p, &v, 2); }
+static inline void put32(uint8_t* p, uint32_t v) { memcpy(p, &v, 4); }
+static inline uint16_t get16(const uint8_t* p) { uint16_t v; memcpy(&v, p, 2); return v; }
+static inline uint32_t get32(const uint8_t* p) { uint32_t v; memcpy(&v, p, 4); return v; }
+static inline uint16_t getLE16(const uint8_t* p) { return (uint16_t)(p[0] | (p[1] << 8)); }
+
+static uint32_t hashId(const char* id, size_t len) {
+    uint32_t h = 2166136261u;      // FNV-1a
+    for (size_t i = 0; i < len; i++) h = (h ^ (uint8_t)id[i]) * 16777619u;
+    return h;
+}
+
+// Device ids become directory names
+static bool validDeviceId(const char* id, size_t len) {
+    if (!len || len > COLLECTOR_DEVICE_ID_MAX || id[0] == '.') return false;
+    for (size_t i = 0; i < len; i++) {
+        char c = id[i];
+        bool ok = (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_' ||
+                  c == '-' || c == '.';
+        if (!ok) return false;
+    }
+    return true;
+}
+
+static void wakeIo() {
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (ioSleeping.load(std::memory_order_relaxed)) {
+        uint64_t one = 1;
+        if (write(wakeFd, &one, sizeof(one)) < 0) {
+            // Already signalled (counter full) or closing
+        }
+    }
+}
+
+static void wakeWorker(Worker& w) {
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (w.sleeping.load(std::memory_order_relaxed)) {
+        std::lock_guard<std::mutex> guard(w.lock);
+        w.wake.notify_one();
+    }
+}
+
+// ============================================================================
+// WORKER: one shard of the fleet
+// ============================================================================
+
+// Open addressing on the id hash (Fibonacci-scrambled: the low bits chose
+// the worker); new devices take the first free entry
+static DeviceState* findDevice(Worker& w, uint32_t hash, const char* id, uint8_t len) {
+    uint32_t mask = (1u << w.deviceBits) - 1;
+    uint32_t i = (hash * 2654435769u) >> (32 - w.deviceBits);
+    for (uint32_t probes = 0; probes <= mask; probes++, i = (i + 1) & mask) {
+        DeviceState& d = w.devices[i];
+        if (!d.idLen) {
+            if (w.deviceCount >= cfg.devices) return nullptr;
+            memset(&d, 0, sizeof(d));
+            d.hash = hash;
+            d.idLen = len;
+            d.slot = -1;
+            memcpy(d.id, id, len);
+            w.deviceCount++;
+            return &d;
+        }
+        if (d.hash == hash && d.idLen == len && memcmp(d.id, id, len) == 0) return &d;
+    }
+    return nullptr;
+}
+
+// Queues a QoS 0 PUBLISH to TOPIC_PREFIX <device>/<suffix>; waits while the
+// I/O thread catches up, drops it once that has stopped
+static void sendToDevice(Worker& w, const DeviceState& d, const char* suffix, const uint8_t* payload, size_t len) {
+    char topic[TOPIC_PREFIX_LEN + COLLECTOR_DEVICE_ID_MAX + 32];
+    int topicLen = snprintf(topic, sizeof(topic), TOPIC_PREFIX "%s/%s", d.id, suffix);
+    uint32_t need = (uint32_t)(MQTT_PUBLISH_HEADER_MAX + topicLen + len);
+    uint8_t* rec;
+    while (!(rec = w.out.reserve(need))) {
+        if (!ioRunning.load(std::memory_order_relaxed)) return;
+        wakeIo();
+        std::this_thread::sleep_for(std::chrono::microseconds(100));
+    }
+    size_t n = mqttEncodePublishHeader(rec, need, topic, (size_t)topicLen, len, 0, 0);
+    memcpy(rec + n, payload, len);
+    w.out.commit((uint32_t)(n + len));
+    wakeIo();
+}
+
+static void sendAck(Worker& w, const DeviceState& d, uint8_t type, uint16_t imageId, const ImageAckRange* ranges,
+                    uint8_t count) {
+    uint8_t payload[IMG_ACK_HEADER_SIZE + 4 * ACK_RANGES_MAX];
+    size_t n = encodeImageAck(type, imageId, ranges, count, payload, sizeof(payload));
+    if (!n) return;
+    sendToDevice(w, d, TOPIC_CAM_ACK, payload, n);
+    ::count(w.counter, C_ACKS);
+}
+
+static void requestKeyframe(Worker& w, const DeviceState& d) {
+    sendToDevice(w, d, TOPIC_CAM_REQ, (const uint8_t*)"key", 3);
+    ::count(w.counter, C_KEY_REQUESTS);
+}
+
+static void flushRows(Worker& w) {
+    size_t done = 0;
+    while (done < w.rowsLen) {
+        ssize_t n = write(w.rowsFd, w.rows + done, w.rowsLen - done);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) {
+            ::count(w.counter, C_WRITE_ERRORS);
+            break;
+        }
+        done += (size_t)n;
+    }
+    w.rowsLen = 0;
+}
+
+static void writeRow(Worker& w, const DeviceState& d, const Row& r) {
+    static const char* const modes[] = {"boot", "day", "night"};
+    if (COLLECTOR_ROWS_BYTES - w.rowsLen < 512) flushRows(w);
+    char* p = w.rows + w.rowsLen;
+    size_t left = COLLECTOR_ROWS_BYTES - w.rowsLen;
+    size_t n = (size_t)snprintf(p, left, "%s,%lu,%d,", d.id, (unsigned long)r.time, r.uptime ? 1 : 0);
+    if (r.haveSeq) n += (size_t)snprintf(p + n, left - n, "%lu", (unsigned long)r.seq);
+    n += (size_t)snprintf(p + n, left - n, ",%u,%s", (unsigned)r.channel,
+                          r.mode >= 0 && r.mode < 3 ? modes[r.mode] : "");
+    for (uint8_t c = 0; c < COLUMNS; c++) {
+        float v = r.value[c];
+        n += (size_t)(v == v ? snprintf(p + n, left - n, ",%g", (double)v) : snprintf(p + n, left - n, ","));
+    }
+    p[n++] = '\n';
+    w.rowsLen += n;
+    ::count(w.counter, C_ROWS);
+}
+
+static void clearRow(Row& r) {
+    memset(&r, 0, sizeof(r));
+    r.mode = -1;
+    for (uint8_t c = 0; c < COLUMNS; c++) r.value[c] = NAN;
+}
+
+// One row per channel; efficiency and soiling are station-wide (channel 0)
+static void frameRows(Worker& w, const DeviceState& d, const TelemetryFrame& f) {
+    uint8_t channels = f.bank.channels ? f.bank.channels : 1;
+    for (uint8_t ch = 0; ch < channels; ch++) {
+        Row r;
+        clearRow(r);
+        r.time = f.timestamp;
+        r.uptime = f.flags & TELEMETRY_FLAG_UPTIME;
+        r.haveSeq = true;
+        r.seq = f.seq;
+        r.channel = ch;
+        r.mode = (int)f.status.mode;
+        r.value[COL_TEMP] = f.bank.temp[ch];
+        r.value[COL_HUMIDITY] = f.bank.humidity[ch];
+        r.value[COL_LUX] = f.bank.lux[ch];
+        r.value[COL_DUST] = f.bank.dust[ch];
+        if (ch == 0) {
+            r.value[COL_EFFICIENCY] = f.status.efficiency;
+            r.value[COL_SOILING] = f.status.soiling;
+        }
+        writeRow(w, d, r);
+    }
+}
+
+// TOPIC_FRAME: one frame; TOPIC_REPLAY: frames back to back
+static void onFrames(Worker& w, const DeviceState& d, const uint8_t* p, size_t len) {
+    size_t at = 0;
+    while (at < len) {
+        TelemetryFrame f;
+        size_t used;
+        if (!decodeTelemetryFrame(p + at, len - at, &f, &used)) {
+            ::count(w.counter, C_REJECTED);
+            return;
+        }
+        frameRows(w, d, f);
+        at += used;
+    }
+}
+
+// TOPIC_BATCH: the 6 SystemStatus columns, then channels 1.. of temp,
+// humidity, lux and dust (mqtt_driver.cpp batchColumns)
+static void onBatch(Worker& w, const DeviceState& d, const uint8_t* p, size_t len) {
+    SeriesDecoder dec;
+    if (!seriesDecodeBegin(&dec, p, len) || dec.header.columns < 6 || (dec.header.columns - 6) % 4) {
+        ::count(w.counter, C_REJECTED);
+        return;
+    }
+    uint8_t extra = (uint8_t)((dec.header.columns - 6) / 4);
+    float values[SERIES_MAX_COLUMNS];
+    uint32_t timestamp;
+    uint8_t mode;
+    while (seriesDecodeNext(&dec, &timestamp, &mode, values)) {
+        for (uint8_t ch = 0; ch <= extra; ch++) {
+            Row r;
+            clearRow(r);
+            r.time = timestamp;
+            r.uptime = dec.header.flags & SERIES_FLAG_UPTIME;
+            r.haveSeq = true;
+            r.seq = dec.header.seq;
+            r.channel = ch;
+            r.mode = mode;
+            if (ch == 0) {
+                for (uint8_t c = 0; c < COLUMNS; c++) r.value[c] = values[c];
+            } else {
+                for (uint8_t a = 0; a < 4; a++) r.value[a] = values[6 + a * extra + ch - 1];
+            }
+            writeRow(w, d, r);
+        }
+    }
+}
+
+// Text metric (TELEMETRY_MODE_TOPICS): no timestamp on the wire, so ours
+static void onMetric(Worker& w, const DeviceState& d, Column column, const uint8_t* p, size_t len) {
+    char text[32];
+    if (!len || len >= sizeof(text)) {
+        ::count(w.counter, C_REJECTED);
+        return;
+    }
+    memcpy(text, p, len);
+    text[len] = '\0';
+    char* end;
+    float v = strtof(text, &end);
+    if (end == text) {
+        ::count(w.counter, C_REJECTED);
+        return;
+    }
+    Row r;
+    clearRow(r);
+    r.time = (uint32_t)time(nullptr);
+    r.value[column] = v;
+    writeRow(w, d, r);
+}
+
+// Unsigned number after "key": in the device's control JSON
+static bool jsonUint(const char* json, const char* key, uint32_t* out) {
+    char pattern[24];
+    snprintf(pattern, sizeof(pattern), "\"%s\":", key);
+    const char* p = strstr(json, pattern);
+    if (!p) return false;
+    p += strlen(pattern);
+    while (*p == ' ') p++;
+    char* end;
+    unsigned long v = strtoul(p, &end, 10);
+    if (end == p) return false;
+    *out = (uint32_t)v;
+    return true;
+}
+
+static bool jsonStatus(const char* json, const char* status) {
+    char pattern[32];
+    snprintf(pattern, sizeof(pattern), "\"status\":\"%s\"", status);
+    return strstr(json, pattern) != nullptr;
+}
+
+static inline bool ownsSlot(const Worker& w, const DeviceState& d, uint32_t owner) {
+    return d.slot >= 0 && w.pool.slot[d.slot].used && w.pool.slot[d.slot].owner == owner;
+}
+
+static void onControl(Worker& w, DeviceState& d, const uint8_t* p, size_t len) {
+    char json[256];
+    if (len >= sizeof(json)) len = sizeof(json) - 1;
+    memcpy(json, p, len);
+    json[len] = '\0';
+    uint32_t owner = (uint32_t)(&d - w.devices);
+    uint32_t id, size, chunks, chunkSize, key;
+
+    if (jsonStatus(json, "start")) {
+        if (!jsonUint(json, "id", &id) || !jsonUint(json, "size", &size) || !jsonUint(json, "chunks", &chunks) ||
+            !jsonUint(json, "chunk_size", &chunkSize)) {
+            ::count(w.counter, C_REJECTED);
+            return;
+        }
+        if (imageSlotOwned(w.pool, d.slot, owner, (uint16_t)id)) {
+            w.pool.slot[d.slot].size = size;        // Chunks got here first
+            return;
+        }
+        if (ownsSlot(w, d, owner)) imagePoolRelease(w.pool, d.slot);     // Previous image abandoned
+        d.slot = -1;
+        if (size > w.pool.slotBytes || chunks > IMG_MAX_CHUNKS) {
+            ::count(w.counter, C_SLOT_WAITS);
+            return;
+        }
+        int slot = imagePoolTake(w.pool, owner, (uint16_t)id, (uint16_t)chunks, chunkSize, nowMs());
+        if (slot < 0) return;       // Chunks try again
+        d.slot = (int16_t)slot;
+        w.pool.slot[slot].size = size;
+    } else if (jsonStatus(json, "unchanged")) {
+        if (jsonUint(json, "key", &key) && (!d.haveKeyframe || d.keyframeId != key)) requestKeyframe(w, d);
+    } else {
+        ::count(w.counter, C_IGNORED);      // "end": nothing left to do
+    }
+}
+
+static void storeImage(Worker& w, DeviceState& d, const uint8_t* image, uint32_t size, uint16_t imageId) {
+    const char* ext = "jpg";
+    if (size >= DELTA_HEADER_SIZE && memcmp(image, DELTA_MAGIC, 4) == 0) {
+        ext = "adlt";
+        uint16_t key = getLE16(image + 6);
+        if (image[5] == DELTA_KEYFRAME) {
+            d.haveKeyframe = true;
+            d.keyframeId = key;
+        } else if (!d.haveKeyframe || d.keyframeId != key) {
+            requestKeyframe(w, d);
+        }
+    }
+
+    char path[sizeof(outDir) + COLLECTOR_DEVICE_ID_MAX + 32];
+    if (!d.dirReady) {
+        snprintf(path, sizeof(path), "%s/%s", outDir, d.id);
+        d.dirReady = mkdir(path, 0755) == 0 || errno == EEXIST;
+    }
+    snprintf(path, sizeof(path), "%s/%s/%lu-%u.%s", outDir, d.id, (unsigned long)time(nullptr), (unsigned)imageId,
+             ext);
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    size_t done = 0;
+    while (fd >= 0 && done < size) {
+        ssize_t n = write(fd, image + done, size - done);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) break;
+        done += (size_t)n;
+    }
+    if (fd >= 0) close(fd);
+    if (done != size) {
+        ::count(w.counter, C_WRITE_ERRORS);
+        return;
+    }
+    ::count(w.counter, C_IMAGES);
+    ::count(w.counter, C_IMAGE_BYTES, size);
+}
+
+static void onChunk(Worker& w, DeviceState& d, const uint8_t* p, size_t len) {
+    ImageChunkHeader h;
+    if (!decodeImageChunkHeader(p, len, &h)) {
+        ::count(w.counter, C_REJECTED);
+        return;
+    }
+    const uint8_t* data = p + IMG_CHUNK_HEADER_SIZE;
+    size_t dataLen = len - IMG_CHUNK_HEADER_SIZE;
+    ::count(w.counter, C_CHUNKS);
+    if (crc32(data, dataLen) != h.crc) {
+        ::count(w.counter, C_CRC_ERRORS);      // The device resends on timeout
+        return;
+    }
+    if (d.haveDone && d.doneId == h.imageId) {
+        ImageAckRange all = {0, (uint16_t)(d.doneCount - 1)};
+        ::count(w.counter, C_DUPLICATES);
+        sendAck(w, d, IMG_ACK_RANGES, h.imageId, &all, 1);
+        return;
+    }
+
+    uint32_t owner = (uint32_t)(&d - w.devices);
+    uint32_t now = nowMs();
+    if (!imageSlotOwned(w.pool, d.slot, owner, h.imageId)) {
+        if (ownsSlot(w, d, owner)) imagePoolRelease(w.pool, d.slot);
+        d.slot = (int16_t)imagePoolTake(w.pool, owner, h.imageId, h.count, 0, now);
+        if (d.slot < 0) {
+            ::count(w.counter, C_SLOT_WAITS);
+            return;
+        }
+    }
+
+    bool ackDue;
+    ImageAckRange gap;
+    ChunkResult result = imageSlotAdd(w.pool, d.slot, h, data, dataLen, now, &ackDue, &gap);
+    if (result == CHUNK_REJECTED) {
+        ::count(w.counter, C_REJECTED);
+        return;
+    }
+    if (result == CHUNK_DUPLICATE) ::count(w.counter, C_DUPLICATES);
+    if (gap.first <= gap.last) sendAck(w, d, IMG_NACK_RANGES, h.imageId, &gap, 1);
+    const ImageSlot& s = w.pool.slot[d.slot];
+    if (ackDue) {
+        ImageAckRange ranges[ACK_RANGES_MAX];
+        uint8_t n = imageSlotRanges(s, ranges, ACK_RANGES_MAX);
+        sendAck(w, d, IMG_ACK_RANGES, h.imageId, ranges, n);
+    }
+    if (result == CHUNK_COMPLETE) {
+        storeImage(w, d, imageSlotData(w.pool, d.slot), imageSlotSize(s), h.imageId);
+        d.haveDone = true;
+        d.doneId = h.imageId;
+        d.doneCount = h.count;
+        imagePoolRelease(w.pool, d.slot);
+        d.slot = -1;
+    }
+}
+
+static bool isKind(const char* kind, size_t len, const char* name) {
+    return strlen(name) == len && memcmp(kind, name, len) == 0;
+}
+
+// Record: hash u32, topic length u16, device id length u16, topic, payload
+static void handleMessage(Worker& w, const uint8_t* rec, uint32_t len) {
+    uint32_t hash = get32(rec);
+    uint16_t topicLen = get16(rec + 4);
+    uint8_t idLen = (uint8_t)get16(rec + 6);
+    const char* topic = (const char*)rec + 8;
+    const uint8_t* payload = rec + 8 + topicLen;
+    size_t payloadLen = len - 8 - topicLen;
+    const char* id = topic + TOPIC_PREFIX_LEN;
+    const char* kind = id + idLen + 1;
+    size_t kindLen = topicLen - TOPIC_PREFIX_LEN - idLen - 1;
+
+    DeviceState* d = findDevice(w, hash, id, idLen);
+    if (!d) {
+        ::count(w.counter, C_REJECTED);        // Table full
+        return;
+    }
+    if (isKind(kind, kindLen, TOPIC_CAM_DATA)) {
+        onChunk(w, *d, payload, payloadLen);
+    } else if (isKind(kind, kindLen, TOPIC_CAM_CTRL)) {
+        onControl(w, *d, payload, payloadLen);
+    } else if (isKind(kind, kindLen, TOPIC_FRAME) || isKind(kind, kindLen, TOPIC_REPLAY)) {
+        onFrames(w, *d, payload, payloadLen);
+    } else if (isKind(kind, kindLen, TOPIC_BATCH)) {
+        onBatch(w, *d, payload, payloadLen);
+    } else {
+        for (size_t i = 0; i < sizeof(metricTopics) / sizeof(metricTopics[0]); i++) {
+            if (isKind(kind, kindLen, metricTopics[i].topic)) {
+                onMetric(w, *d, metricTopics[i].column, payload, payloadLen);
+                return;
+            }
+        }
+        ::count(w.counter, C_IGNORED);
+    }
+}
+
+static void workerLoop(Worker* worker) {
+    Worker& w = *worker;
+    uint32_t lastReclaim = nowMs();
+    for (;;) {
+        uint32_t len;
+        const uint8_t* rec = w.in.front(&len);
+        if (rec) {
+            handleMessage(w, rec, len);
+            w.in.pop();
+            continue;
+        }
+        if (!workersRunning.load(std::memory_order_acquire)) break;
+        // Idle: rows to disk, then sleep until the I/O thread hands over more
+        if (w.rowsLen) flushRows(w);
+        w.counter[C_CPU_US].store(threadCpuUs(), std::memory_order_relaxed);
+        uint32_t now = nowMs();
+        if (now - lastReclaim >= 1000) {
+            ::count(w.counter, C_RECLAIMED, imagePoolReclaim(w.pool, now, COLLECTOR_IMAGE_IDLE_MS));
+            lastReclaim = now;
+        }
+        std::unique_lock<std::mutex> guard(w.lock);
+        w.sleeping.store(true, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (w.in.empty() && workersRunning.load(std::memory_order_relaxed)) {
+            w.wake.wait_for(guard, std::chrono::milliseconds(100));
+        }
+        w.sleeping.store(false, std::memory_order_relaxed);
+    }
+    flushRows(w);
+    w.counter[C_CPU_US].store(threadCpuUs(), std::memory_order_relaxed);
+}
+
+// ============================================================================
+// I/O THREAD: the broker connection
+// ============================================================================
+
+static void closeBroker() {
+    if (sock >= 0) close(sock);
+    sock = -1;
+    connectedFlag.store(false);
+    rxLen = rxSkip = txLen = 0;
+}
+
+static bool openBroker() {
+    sock = socket(brokerAddr.ss_family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (sock < 0) return false;
+    if (connect(sock, (const sockaddr*)&brokerAddr, brokerAddrLen) != 0) {
+        pollfd pfd = {sock, POLLOUT, 0};
+        int err = 0;
+        socklen_t errLen = sizeof(err);
+        if (errno != EINPROGRESS || poll(&pfd, 1, 2000) != 1 ||
+            getsockopt(sock, SOL_SOCKET, SO_ERROR, &err, &errLen) != 0 || err) {
+            closeBroker();
+            return false;
+        }
+    }
+    int one = 1;
+    setsockopt(sock, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+    // SUBSCRIBE goes with CONNECT: with a session present it only confirms.
+    // No Local: our ACKs on camera/ack do not come back to us.
+    const char* filters[] = {filterSensor, filterCamera};
+    const uint8_t options[] = {1 | MQTT_SUB_NO_LOCAL, 1 | MQTT_SUB_NO_LOCAL};
+    txLen = mqttEncodeConnect(tx, COLLECTOR_TX_BYTES, cfg.clientId, cfg.keepAliveS, cfg.sessionExpiryS,
+                              COLLECTOR_RX_BYTES);
+    txLen += mqttEncodeSubscribe(tx + txLen, COLLECTOR_TX_BYTES - txLen, 1, filters, options, 2);
+    lastOutMs = nowMs();
+    pingOutstanding = false;
+    count(ioCounter, C_CONNECTS);
+    return true;
+}
+
+static bool sendPending() {
+    size_t done = 0;
+    while (done < txLen) {
+        ssize_t n = send(sock, tx + done, txLen - done, MSG_NOSIGNAL);
+        if (n > 0) {
+            done += (size_t)n;
+        } else if (n < 0 && errno == EINTR) {
+            continue;
+        } else if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            break;
+        } else {
+            return false;
+        }
+    }
+    if (done) {
+        memmove(tx, tx + done, txLen - done);
+        txLen -= done;
+        lastOutMs = nowMs();
+    }
+    return true;
+}
+
+// Workers' ACKs into tx while they fit; dropped without a connection (the
+// devices resend and get ACKed again)
+static bool collectOutbound() {
+    bool more = false;
+    for (uint16_t i = 0; i < cfg.workers; i++) {
+        RecordRing& out = workers[i].out;
+        uint32_t len;
+        const uint8_t* rec;
+        while ((rec = out.front(&len))) {
+            if (sock >= 0) {
+                if (txLen + len + 16 > COLLECTOR_TX_BYTES) {    // Room left for a PUBACK
+                    more = true;
+                    break;
+                }
+                memcpy(tx + txLen, rec, len);
+                txLen += len;
+            }
+            out.pop();
+        }
+    }
+    return more;
+}
+
+// Hands a message to its device's worker. While that worker's ring is full
+// the connection is not read (the broker holds the backlog) but ACKs keep
+// going out, or a worker waiting to queue one would never drain its ring.
+static bool dispatch(const MqttPublish& m) {
+    const char* id = m.topic + TOPIC_PREFIX_LEN;
+    const char* slash = m.topicLen > TOPIC_PREFIX_LEN ?
+                        (const char*)memchr(id, '/', m.topicLen - TOPIC_PREFIX_LEN) : nullptr;
+    if (!slash || memcmp(m.topic, TOPIC_PREFIX, TOPIC_PREFIX_LEN) != 0 || !validDeviceId(id, slash - id)) {
+        count(ioCounter, C_REJECTED);
+        return true;
+    }
+    size_t idLen = slash - id;
+    uint32_t hash = hashId(id, idLen);
+    Worker& w = workers[hash % cfg.workers];
+    uint32_t len = (uint32_t)(8 + m.topicLen + m.len);
+    if (len > w.in.maxRecord()) {
+        count(ioCounter, C_REJECTED);
+        return true;
+    }
+    uint8_t* rec;
+    while (!(rec = w.in.reserve(len))) {
+        count(ioCounter, C_RING_WAITS);
+        wakeWorker(w);
+        collectOutbound();
+        if (!sendPending()) return false;
+        if (!ioRunning.load(std::memory_order_relaxed)) return false;
+        std::this_thread::sleep_for(std::chrono::microseconds(100));
+    }
+    put32(rec, hash);
+    put16(rec + 4, m.topicLen);
+    put16(rec + 6, (uint16_t)idLen);
+    memcpy(rec + 8, m.topic, m.topicLen);
+    memcpy(rec + 8 + m.topicLen, m.payload, m.len);
+    w.in.commit(len);
+    wakeWorker(w);
+    return true;
+}
+
+static bool handlePacket(const MqttPacket& p) {
+    switch (p.type) {
+        case MQTT_PACKET_CONNACK: {
+            uint8_t reason;
+            bool session;
+            if (!mqttParseConnack(p, &reason, &session) || reason) {
+                fprintf(stderr, "❌ Broker refused the connection (reason 0x%02X)\n", reason);
+                return false;
+            }
+            fprintf(stderr, "🔗 Connected to the broker%s\n", session ? " (session resumed)" : "");
+            connectedFlag.store(true);
+            return true;
+        }
+        case MQTT_PACKET_PUBLISH: {
+            MqttPublish m;
+            if (!mqttParsePublish(p, &m)) return false;
+            count(ioCounter, C_MESSAGES);
+            count(ioCounter, C_BYTES, m.len);
+            if (!dispatch(m)) return false;
+            // Handed over, not yet on disk: a crash loses what the rings hold
+            if (m.qos) txLen += mqttEncodePuback(tx + txLen, COLLECTOR_TX_BYTES - txLen, m.packetId);
+            return true;
+        }
+        case MQTT_PACKET_SUBACK:
+            for (size_t i = 3; i < p.len; i++) {
+                if (p.body[i] >= 0x80) fprintf(stderr, "⚠️ Subscription %u refused (0x%02X)\n", (unsigned)i - 3,
+                                                p.body[i]);
+            }
+            return true;
+        case MQTT_PACKET_PINGRESP:
+            pingOutstanding = false;
+            return true;
+        case MQTT_PACKET_DISCONNECT:
+            return false;
+        default:
+            return true;
+    }
+}
+
+// Complete packets in rx, while tx has room for the PUBACKs
+static bool processRx() {
+    size_t at = 0;
+    if (rxSkip) {
+        at = rxSkip < rxLen ? rxSkip : rxLen;
+        rxSkip -= at;
+    }
+    while (at < rxLen && COLLECTOR_TX_BYTES - txLen >= 16) {
+        MqttPacket p;
+        size_t total;
+        int r = mqttFrame(rx + at, rxLen - at, &p, &total);
+        if (r < 0) return false;
+        if (r == 0) break;
+        if (total > COLLECTOR_RX_BYTES) {
+            // Above our Maximum Packet Size: the broker should not have sent it
+            count(ioCounter, C_REJECTED);
+            rxSkip = total - (rxLen - at);
+            at = rxLen;
+            break;
+        }
+        if (total > rxLen - at) break;
+        if (!handlePacket(p)) return false;
+        at += total;
+    }
+    memmove(rx, rx + at, rxLen - at);
+    rxLen -= at;
+    return true;
+}
+
+static bool readBroker() {
+    for (int i = 0; i < 8 && rxLen < COLLECTOR_RX_BYTES; i++) {
+        ssize_t n = recv(sock, rx + rxLen, COLLECTOR_RX_BYTES - rxLen, 0);
+        if (n == 0) return false;
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return errno == EAGAIN || errno == EWOULDBLOCK;
+        }
+        rxLen += (size_t)n;
+        if (!processRx()) return false;
+    }
+    return true;
+}
+
+static bool keepAlive(uint32_t now) {
+    uint32_t period = (uint32_t)cfg.keepAliveS * 1000;
+    if (!period || !connectedFlag.load(std::memory_order_relaxed)) return true;
+    if (pingOutstanding) return now - pingSentMs < period;
+    if (now - lastOutMs >= period / 2 && COLLECTOR_TX_BYTES - txLen >= 2) {
+        txLen += mqttEncodeEmpty(tx + txLen, COLLECTOR_TX_BYTES - txLen, MQTT_PACKET_PINGREQ);
+        pingOutstanding = true;
+        pingSentMs = now;
+    }
+    return true;
+}
+
+static void ioLoop() {
+    uint32_t retryAt = nowMs();
+    while (ioRunning.load(std::memory_order_relaxed)) {
+        uint32_t now = nowMs();
+        if (sock < 0 && (int32_t)(now - retryAt) >= 0 && !openBroker()) retryAt = now + 1000;
+        bool more = collectOutbound();
+        bool ok = true;
+        ioCounter[C_CPU_US].store(threadCpuUs(), std::memory_order_relaxed);
+        pollfd fds[2] = {{wakeFd, POLLIN, 0}, {sock, 0, 0}};
+        if (sock >= 0) {
+            ok = keepAlive(now) && sendPending() && processRx();
+            fds[1].events = (short)(POLLIN | (txLen ? POLLOUT : 0));
+        }
+        if (ok) {
+            ioSleeping.store(true, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            for (uint16_t i = 0; i < cfg.workers && !more; i++) more = !workers[i].out.empty();
+            poll(fds, sock >= 0 ? 2 : 1, more ? 0 : 100);
+            ioSleeping.store(false, std::memory_order_relaxed);
+            uint64_t v;
+            if ((fds[0].revents & POLLIN) && read(wakeFd, &v, sizeof(v)) < 0) {
+                // Raced with another reader: nothing to do
+            }
+            if (sock >= 0 && (fds[1].revents & (POLLIN | POLLHUP | POLLERR))) ok = readBroker();
+        }
+        if (!ok) {
+            fprintf(stderr, "⚠️ Broker connection lost, retrying\n");
+            closeBroker();
+            retryAt = now + 1000;
+        }
+    }
+    if (sock >= 0) {
+        txLen = 0;
+        txLen = mqttEncodeEmpty(tx, COLLECTOR_TX_BYTES, MQTT_PACKET_DISCONNECT);
+        sendPending();
+        closeBroker();
+    }
+}
+
+// ============================================================================
+// LIFECYCLE
+// ============================================================================
+
+void collectorDefaults(CollectorConfig* config) {
+    config->host = "localhost";
+    config->port = COLLECTOR_PORT;
+    config->clientId = COLLECTOR_CLIENT_ID;
+    config->outDir = "collected";
+    config->workers = COLLECTOR_WORKERS;
+    config->devices = COLLECTOR_DEVICES;
+    config->imageSlots = COLLECTOR_IMAGE_SLOTS;
+    config->imageBytes = COLLECTOR_IMAGE_BYTES;
+    config->ringBytes = COLLECTOR_RING_BYTES;
+    config->keepAliveS = COLLECTOR_KEEPALIVE_S;
+    config->sessionExpiryS = COLLECTOR_SESSION_EXPIRY_S;
+}
+
+static void freeAll() {
+    if (workers) {
+        for (uint16_t i = 0; i < cfg.workers; i++) {
+            Worker& w = workers[i];
+            if (w.rowsFd >= 0) close(w.rowsFd);
+            imagePoolFree(w.pool);
+            free(w.devices);
+            free(w.rows);
+        }
+        delete[] workers;
+        workers = nullptr;
+    }
+    free(rx);
+    free(tx);
+    rx = tx = nullptr;
+    if (wakeFd >= 0) close(wakeFd);
+    wakeFd = -1;
+}
+
+static bool initWorker(Worker& w, uint16_t index) {
+    w.index = index;
+    w.deviceCount = 0;
+    w.rowsLen = 0;
+    w.rowsFd = -1;
+    w.sleeping.store(false);
+    for (int c = 0; c < C_COUNT; c++) w.counter[c].store(0);
+    w.deviceBits = 1;
+    while ((1u << w.deviceBits) < 2 * cfg.devices) w.deviceBits++;
+    w.devices = (DeviceState*)calloc((size_t)1 << w.deviceBits, sizeof(DeviceState));
+    w.rows = (char*)malloc(COLLECTOR_ROWS_BYTES);
+    if (!w.devices || !w.rows || !w.in.init(cfg.ringBytes) || !w.out.init(OUTBOX_BYTES) ||
+        !imagePoolInit(w.pool, cfg.imageSlots, cfg.imageBytes)) {
+        return false;
+    }
+    char path[sizeof(outDir) + 32];
+    snprintf(path, sizeof(path), "%s/telemetry-%u.csv", outDir, (unsigned)index);
+    w.rowsFd = open(path, O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    if (w.rowsFd < 0) return false;
+    struct stat st;
+    if (fstat(w.rowsFd, &st) == 0 && st.st_size == 0) {
+        w.rowsLen = (size_t)snprintf(w.rows, COLLECTOR_ROWS_BYTES,
+                                     "device,time,uptime,seq,channel,mode,temp,humidity,lux,dust,efficiency,soiling\n");
+        flushRows(w);
+    }
+    return true;
+}
+
+bool collectorBegin(const CollectorConfig& config) {
+    if (workers) return false;
+    cfg = config;
+    if (!cfg.workers) {
+        unsigned cores = std::thread::hardware_concurrency();
+        cfg.workers = (uint16_t)(cores ? cores : 1);
+    }
+    if (cfg.workers > COLLECTOR_MAX_WORKERS) cfg.workers = COLLECTOR_MAX_WORKERS;
+    // A ring holds at least a few of the largest messages
+    if (!cfg.devices || !cfg.imageSlots || cfg.imageBytes < IMG_CHUNK_HEADER_SIZE ||
+        (cfg.ringBytes & (cfg.ringBytes - 1)) || cfg.ringBytes < 4 * COLLECTOR_RX_BYTES ||
+        strlen(cfg.outDir) >= sizeof(outDir) - COLLECTOR_DEVICE_ID_MAX - 32 || strlen(cfg.clientId) > 64) {
+        fprintf(stderr, "❌ Collector: bad configuration\n");
+        return false;
+    }
+
+    char port[8];
+    snprintf(port, sizeof(port), "%u", (unsigned)cfg.port);
+    addrinfo hints;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    addrinfo* found = nullptr;
+    if (getaddrinfo(cfg.host, port, &hints, &found) != 0 || !found) {
+        fprintf(stderr, "❌ Collector: cannot resolve %s\n", cfg.host);
+        return false;
+    }
+    memcpy(&brokerAddr, found->ai_addr, found->ai_addrlen);
+    brokerAddrLen = found->ai_addrlen;
+    freeaddrinfo(found);
+
+    snprintf(outDir, sizeof(outDir), "%s", cfg.outDir);
+    if (mkdir(outDir, 0755) != 0 && errno != EEXIST) {
+        fprintf(stderr, "❌ Collector: cannot create %s\n", outDir);
+        return false;
+    }
+    snprintf(filterSensor, sizeof(filterSensor), TOPIC_PREFIX "+/sensor/#");
+    snprintf(filterCamera, sizeof(filterCamera), TOPIC_PREFIX "+/camera/#");
+    for (int c = 0; c < C_COUNT; c++) ioCounter[c].store(0);
+
+    rx = (uint8_t*)malloc(COLLECTOR_RX_BYTES);
+    tx = (uint8_t*)malloc(COLLECTOR_TX_BYTES);
+    wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    workers = new (std::nothrow) Worker[cfg.workers];
+    bool ok = rx && tx && wakeFd >= 0 && workers;
+    for (uint16_t i = 0; ok && i < cfg.workers; i++) ok = initWorker(workers[i], i);
+    if (!ok) {
+        fprintf(stderr, "❌ Collector: out of memory or cannot write %s\n", outDir);
+        freeAll();
+        return false;
+    }
+
+    sock = -1;
+    rxLen = rxSkip = txLen = 0;
+    connectedFlag.store(false);
+    workersRunning.store(true);
+    ioRunning.store(true);
+    for (uint16_t i = 0; i < cfg.workers; i++) workers[i].thread = std::thread(workerLoop, &workers[i]);
+    ioThread = std::thread(ioLoop);
+    return true;
+}
+
+void collectorEnd() {
+    if (!workers) return;
+    // Network first; the workers then finish what their rings hold
+    ioRunning.store(false);
+    ioSleeping.store(true);
+    wakeIo();
+    ioThread.join();
+    workersRunning.store(false, std::memory_order_release);
+    for (uint16_t i = 0; i < cfg.workers; i++) {
+        {
+            std::lock_guard<std::mutex> guard(workers[i].lock);
+            workers[i].wake.notify_one();
+        }
+        workers[i].thread.join();
+    }
+    freeAll();
+}
+
+bool collectorConnected() { return connectedFlag.load(); }
+
+CollectorStats collectorStats() {
+    uint64_t sum[C_COUNT];
+    uint64_t ioCpuUs = ioCounter[C_CPU_US].load(std::memory_order_relaxed);
+    for (int c = 0; c < C_COUNT; c++) {
+        sum[c] = ioCounter[c].load(std::memory_order_relaxed);
+        for (uint16_t i = 0; workers && i < cfg.workers; i++) sum[c] += workers[i].counter[c].load(std::memory_order_relaxed);
+    }
+    CollectorStats s;
+    s.connects = sum[C_CONNECTS];
+    s.messages = sum[C_MESSAGES];
+    s.bytes = sum[C_BYTES];
+    s.ringWaits = sum[C_RING_WAITS];
+    s.rows = sum[C_ROWS];
+    s.chunks = sum[C_CHUNKS];
+    s.duplicates = sum[C_DUPLICATES];
+    s.crcErrors = sum[C_CRC_ERRORS];
+    s.slotWaits = sum[C_SLOT_WAITS];
+    s.reclaimed = sum[C_RECLAIMED];
+    s.images = sum[C_IMAGES];
+    s.imageBytes = sum[C_IMAGE_BYTES];
+    s.acks = sum[C_ACKS];
+    s.keyRequests = sum[C_KEY_REQUESTS];
+    s.rejected = sum[C_REJECTED];
+    s.ignored = sum[C_IGNORED];
+    s.writeErrors = sum[C_WRITE_ERRORS];
+    s.ioCpuUs = ioCpuUs;
+    s.workerCpuUs = sum[C_CPU_US] - ioCpuUs;
+    return s;
+}
@@ -0,0 +1,98 @@
+#ifndef COLLECTOR_H
+#define COLLECTOR_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "config.h"
+
+// Fleet ingestion service: the server side of the device topics, in place of
+// the Node-RED image assembler for more than a handful of stations.
+//
+// One MQTT 5 connection subscribes to TOPIC_PREFIX "+/sensor/#" and
+// "+/camera/#". Its I/O thread (a poll() loop) frames the packets and hands
+// each message, by a hash of the device id in its topic, to one of
+// `workers` threads through a RecordRing (record_ring.h); a device always
+// lands on the same worker, so its state has one owner and takes no lock.
+// When a worker falls behind, its ring fills and the I/O thread stops
+// reading: the broker buffers, nothing is dropped here.
+//
+// A worker keeps a fixed table of devices, reassembles images in its slot
+// pool (image_assembly.h) and sends the ACKs back through the I/O thread,
+// decodes telemetry (text metrics, frames, replays, compressed batches) to
+// rows, and writes both under `outDir`:
+//
+//   telemetry-<worker>.csv    device,time,uptime,seq,channel,mode,temp,humidity,lux,dust,efficiency,soiling
+//   <device>/<time>-<id>.jpg  images (.adlt: delta containers, image_delta.h)
+//
+// Everything is allocated in collectorBegin(); after that the threads do not
+// touch the heap.
+
+// ============================================================================
+// DEFAULTS (CollectorConfig)
+// ============================================================================
+#define COLLECTOR_PORT              1883
+#define COLLECTOR_CLIENT_ID         "argus-collector"
+#define COLLECTOR_WORKERS           0           // 0: one per core
+#define COLLECTOR_DEVICES           4096        // Device table entries, per worker
+#define COLLECTOR_IMAGE_SLOTS       32          // Images in reassembly at once, per worker
+#define COLLECTOR_IMAGE_BYTES       (256 * 1024)
+#define COLLECTOR_IMAGE_IDLE_MS     30000       // Frees the slot of a transfer gone silent
+#define COLLECTOR_RING_BYTES        (1 << 22)   // Per worker, messages waiting for it
+#define COLLECTOR_KEEPALIVE_S       30
+#define COLLECTOR_SESSION_EXPIRY_S  3600        // The broker keeps QoS 1 messages across a restart
+
+#define COLLECTOR_RX_BYTES          (IMG_CHUNK_SIZE + 4096)  // Largest packet (Maximum Packet Size)
+#define COLLECTOR_TX_BYTES          (64 * 1024)
+#define COLLECTOR_ROWS_BYTES        (64 * 1024)  // Telemetry CSV written in blocks of this
+#define COLLECTOR_DEVICE_ID_MAX     48
+#define COLLECTOR_MAX_WORKERS       64
+
+struct CollectorConfig {
+    const char* host;
+    uint16_t port;
+    const char* clientId;
+    const char* outDir;
+    uint16_t workers;
+    uint32_t devices;
+    uint16_t imageSlots;
+    uint32_t imageBytes;
+    uint32_t ringBytes;
+    uint16_t keepAliveS;
+    uint32_t sessionExpiryS;
+};
+
+struct CollectorStats {
+    uint64_t connects;
+    uint64_t messages;          // PUBLISH received
+    uint64_t bytes;             // Their payloads
+    uint64_t ringWaits;         // Times the I/O thread waited for a worker
+    uint64_t rows;              // Telemetry rows written
+    uint64_t chunks;
+    uint64_t duplicates;        // Chunks received twice (ACK lost)
+    uint64_t crcErrors;
+    uint64_t slotWaits;         // Chunks not ACKed: no free slot or too large
+    uint64_t reclaimed;         // Slots of transfers gone silent
+    uint64_t images;            // Written to disk
+    uint64_t imageBytes;
+    uint64_t acks;              // ACK/NACK messages sent
+    uint64_t keyRequests;       // Deltas against a keyframe we lack
+    uint64_t rejected;          // Malformed, unknown device id, device table full
+    uint64_t ignored;           // Topics not handled (stats, echoes)
+    uint64_t writeErrors;
+    uint64_t ioCpuUs;           // CPU time of the I/O thread: over wall time, its saturation
+    uint64_t workerCpuUs;       // Of all workers together
+};
+
+void collectorDefaults(CollectorConfig* config);
+
+// Resolves the broker, creates outDir, allocates and starts the threads
+// (the connection is made in the background, and again after a loss).
+// False on a bad configuration or an allocation failure.
+bool collectorBegin(const CollectorConfig& config);
+// Stops the threads, flushes the telemetry files and frees everything
+void collectorEnd();
+
+bool collectorConnected();
+CollectorStats collectorStats();
+
+#endif
@@ -0,0 +1,121 @@
+#include "image_assembly.h"
+
+static inline bool hasChunk(const ImageSlot& s, uint16_t i) { return s.got[i >> 3] & (1 << (i & 7)); }
+
+bool imagePoolInit(ImagePool& pool, uint16_t slots, uint32_t slotBytes) {
+    memset(&pool, 0, sizeof(pool));
+    if (!slots || !slotBytes) return false;
+    pool.memory = (uint8_t*)malloc((size_t)slots * slotBytes);
+    pool.slot = (ImageSlot*)calloc(slots, sizeof(ImageSlot));
+    pool.freeList = (uint16_t*)malloc(slots * sizeof(uint16_t));
+    if (!pool.memory || !pool.slot || !pool.freeList) {
+        imagePoolFree(pool);
+        return false;
+    }
+    pool.slotBytes = slotBytes;
+    pool.slots = slots;
+    for (uint16_t i = 0; i < slots; i++) pool.freeList[i] = (uint16_t)(slots - 1 - i);
+    pool.freeCount = slots;
+    return true;
+}
+
+void imagePoolFree(ImagePool& pool) {
+    free(pool.memory);
+    free(pool.slot);
+    free(pool.freeList);
+    memset(&pool, 0, sizeof(pool));
+}
+
+int imagePoolTake(ImagePool& pool, uint32_t owner, uint16_t imageId, uint16_t count, uint32_t chunkSize,
+                  uint32_t now) {
+    if (!pool.freeCount || !count || count > IMG_MAX_CHUNKS) return -1;
+    if (chunkSize && (uint64_t)chunkSize * (count - 1) >= pool.slotBytes) return -1;
+    int slot = pool.freeList[--pool.freeCount];
+    ImageSlot& s = pool.slot[slot];
+    memset(&s, 0, sizeof(s));
+    s.used = true;
+    s.owner = owner;
+    s.imageId = imageId;
+    s.count = count;
+    s.highest = -1;
+    s.chunkSize = chunkSize;
+    s.lastMs = now;
+    return slot;
+}
+
+void imagePoolRelease(ImagePool& pool, int slot) {
+    if (slot < 0 || slot >= pool.slots || !pool.slot[slot].used) return;
+    pool.slot[slot].used = false;
+    pool.freeList[pool.freeCount++] = (uint16_t)slot;
+}
+
+uint16_t imagePoolReclaim(ImagePool& pool, uint32_t now, uint32_t idleMs) {
+    uint16_t n = 0;
+    for (uint16_t i = 0; i < pool.slots; i++) {
+        if (pool.slot[i].used && now - pool.slot[i].lastMs >= idleMs) {
+            imagePoolRelease(pool, i);
+            n++;
+        }
+    }
+    return n;
+}
+
+ChunkResult imageSlotAdd(ImagePool& pool, int slot, const ImageChunkHeader& h, const uint8_t* data, size_t len,
+                         uint32_t now, bool* ackDue, ImageAckRange* gap) {
+    ImageSlot& s = pool.slot[slot];
+    *ackDue = false;
+    gap->first = 1;
+    gap->last = 0;
+    if (h.count != s.count || h.index >= s.count) return CHUNK_REJECTED;
+    s.lastMs = now;
+    if (hasChunk(s, h.index)) {
+        *ackDue = true;
+        return CHUNK_DUPLICATE;
+    }
+
+    bool last = h.index == s.count - 1;
+    if (!s.chunkSize) {
+        if (last && s.count > 1) return CHUNK_REJECTED;    // Offset unknown: the device sends it again
+        s.chunkSize = (uint32_t)len;
+    }
+    // Every chunk but the last is exactly chunkSize
+    if (last ? len > s.chunkSize : len != s.chunkSize) return CHUNK_REJECTED;
+    size_t offset = (size_t)h.index * s.chunkSize;
+    if (offset + len > pool.slotBytes) return CHUNK_REJECTED;
+    if (last && s.size && offset + len != s.size) return CHUNK_REJECTED;
+
+    memcpy(imageSlotData(pool, slot) + offset, data, len);
+    s.got[h.index >> 3] |= (uint8_t)(1 << (h.index & 7));
+    s.received++;
+    if (last) s.lastLen = (uint32_t)len;
+
+    if (h.index > s.highest + 1) {
+        gap->first = (uint16_t)(s.highest + 1);
+        gap->last = (uint16_t)(h.index - 1);
+    }
+    bool fill = h.index < s.highest;
+    if (h.index > s.highest) s.highest = h.index;
+    if (s.received == s.count) {
+        *ackDue = true;
+        return CHUNK_COMPLETE;
+    }
+    *ackDue = fill || s.received % 4 == 0;
+    return CHUNK_STORED;
+}
+
+uint8_t imageSlotRanges(const ImageSlot& s, ImageAckRange* out, uint8_t max) {
+    uint8_t n = 0;
+    for (uint16_t i = 0; i < s.count; i++) {
+        if (!hasChunk(s, i)) continue;
+        if (n && out[n - 1].last + 1 == i) {
+            out[n - 1].last = i;
+        } else if (n < max) {
+            out[n].first = i;
+            out[n].last = i;
+            n++;
+        } else {
+            break;
+        }
+    }
+    return n;
+}
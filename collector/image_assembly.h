@@ -0,0 +1,86 @@
+#ifndef IMAGE_ASSEMBLY_H
+#define IMAGE_ASSEMBLY_H
+
+#include "image_transfer.h"
+
+// Receiving end of the windowed image transfer (src/image_transfer.h) for
+// many devices at once. No I/O; the collector does the publishing and the
+// writing.
+//
+// Images are put together in place: a pool of equal buffers allocated once,
+// chunk i copied to i * chunk size of its slot, so an image costs one copy
+// of its bytes and nothing is allocated per image. The chunk size comes from
+// the START control message, or from the first chunk that is not the last
+// one when START has not arrived (yet). A transfer holds its slot until the
+// last chunk arrives, the device starts another image, or it has been
+// silent for COLLECTOR_IMAGE_IDLE_MS; with every slot taken, chunks are not
+// ACKed and the device sends them again later.
+//
+// ACK policy, as the Node-RED flow: a chunk past a gap NACKs the gap, a
+// duplicate (our ACK was lost) and every fourth chunk or a gap filled ACK
+// what was received, and the last chunk ACKs everything.
+
+struct ImageSlot {
+    bool used;
+    uint32_t owner;             // Device table index
+    uint16_t imageId;
+    uint16_t count;
+    uint16_t received;
+    int32_t highest;            // Highest index received, -1 for none
+    uint32_t chunkSize;
+    uint32_t size;              // From START, 0 until known
+    uint32_t lastLen;           // Length of the last chunk, once received
+    uint32_t lastMs;
+    uint8_t got[(IMG_MAX_CHUNKS + 7) / 8];
+};
+
+struct ImagePool {
+    uint8_t* memory;
+    uint32_t slotBytes;
+    uint16_t slots;
+    uint16_t freeCount;
+    ImageSlot* slot;
+    uint16_t* freeList;
+};
+
+enum ChunkResult : uint8_t {
+    CHUNK_STORED,
+    CHUNK_DUPLICATE,
+    CHUNK_COMPLETE,             // Image in slot data, imageSlotSize() bytes
+    CHUNK_REJECTED              // Does not fit the geometry: not ACKed
+};
+
+bool imagePoolInit(ImagePool& pool, uint16_t slots, uint32_t slotBytes);
+void imagePoolFree(ImagePool& pool);
+
+// Slot for a new transfer, -1 if none is free. chunkSize 0: set by the
+// first chunk that is not the last.
+int imagePoolTake(ImagePool& pool, uint32_t owner, uint16_t imageId, uint16_t count, uint32_t chunkSize,
+                  uint32_t now);
+void imagePoolRelease(ImagePool& pool, int slot);
+// Frees slots without a chunk for idleMs; returns how many
+uint16_t imagePoolReclaim(ImagePool& pool, uint32_t now, uint32_t idleMs);
+
+inline uint8_t* imageSlotData(const ImagePool& pool, int slot) {
+    return pool.memory + (size_t)slot * pool.slotBytes;
+}
+
+inline bool imageSlotOwned(const ImagePool& pool, int slot, uint32_t owner, uint16_t imageId) {
+    return slot >= 0 && slot < pool.slots && pool.slot[slot].used && pool.slot[slot].owner == owner &&
+           pool.slot[slot].imageId == imageId;
+}
+
+inline uint32_t imageSlotSize(const ImageSlot& s) {
+    return (uint32_t)(s.count - 1) * s.chunkSize + s.lastLen;
+}
+
+// Copies a chunk (CRC already checked) into its place. *ackDue: the ranges
+// received should go out now; *gap: chunks skipped, to NACK (first > last
+// for none).
+ChunkResult imageSlotAdd(ImagePool& pool, int slot, const ImageChunkHeader& h, const uint8_t* data, size_t len,
+                         uint32_t now, bool* ackDue, ImageAckRange* gap);
+
+// Received chunks as ranges, at most `max`; returns the count
+uint8_t imageSlotRanges(const ImageSlot& s, ImageAckRange* out, uint8_t max);
+
+#endif
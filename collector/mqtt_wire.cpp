@@ -0,0 +1,172 @@
+#include "mqtt_wire.h"
+#include <string.h>
+
+size_t mqttPutLength(uint8_t* out, size_t value) {
+    size_t n = 0;
+    do {
+        uint8_t b = value & 0x7F;
+        value >>= 7;
+        out[n++] = value ? (b | 0x80) : b;
+    } while (value);
+    return n;
+}
+
+size_t mqttGetLength(const uint8_t* p, size_t avail, size_t* value) {
+    size_t v = 0;
+    for (size_t i = 0; i < 4 && i < avail; i++) {
+        v |= (size_t)(p[i] & 0x7F) << (7 * i);
+        if (!(p[i] & 0x80)) {
+            *value = v;
+            return i + 1;
+        }
+    }
+    return 0;
+}
+
+static size_t lengthSize(size_t value) {
+    return value < 128 ? 1 : value < 16384 ? 2 : value < 2097152 ? 3 : 4;
+}
+
+static size_t putString(uint8_t* out, const char* s, size_t len) {
+    out[0] = (uint8_t)(len >> 8);
+    out[1] = (uint8_t)len;
+    memcpy(out + 2, s, len);
+    return 2 + len;
+}
+
+static void put32(uint8_t* p, uint32_t v) {
+    p[0] = (uint8_t)(v >> 24);
+    p[1] = (uint8_t)(v >> 16);
+    p[2] = (uint8_t)(v >> 8);
+    p[3] = (uint8_t)v;
+}
+
+int mqttFrame(const uint8_t* data, size_t len, MqttPacket* packet, size_t* total) {
+    if (len < 2) return 0;
+    size_t body;
+    size_t n = mqttGetLength(data + 1, len - 1, &body);
+    if (!n) return len >= 5 ? -1 : 0;
+    *total = 1 + n + body;
+    if (len >= *total) {
+        packet->type = data[0] >> 4;
+        packet->flags = data[0] & 0x0F;
+        packet->body = data + 1 + n;
+        packet->len = body;
+    }
+    return 1;
+}
+
+size_t mqttEncodeConnect(uint8_t* out, size_t size, const char* clientId, uint16_t keepAliveS,
+                         uint32_t sessionExpiryS, uint32_t maxPacket) {
+    size_t idLen = strlen(clientId);
+    size_t props = (sessionExpiryS ? 5 : 0) + (maxPacket ? 5 : 0);
+    size_t remaining = 10 + lengthSize(props) + props + 2 + idLen;
+    if (idLen > 65535 || size < 1 + lengthSize(remaining) + remaining) return 0;
+    size_t n = 0;
+    out[n++] = MQTT_PACKET_CONNECT << 4;
+    n += mqttPutLength(out + n, remaining);
+    n += putString(out + n, "MQTT", 4);
+    out[n++] = 5;
+    out[n++] = sessionExpiryS ? 0 : 0x02;
+    out[n++] = (uint8_t)(keepAliveS >> 8);
+    out[n++] = (uint8_t)keepAliveS;
+    n += mqttPutLength(out + n, props);
+    if (sessionExpiryS) {
+        out[n++] = 0x11;
+        put32(out + n, sessionExpiryS);
+        n += 4;
+    }
+    if (maxPacket) {
+        out[n++] = 0x27;
+        put32(out + n, maxPacket);
+        n += 4;
+    }
+    n += putString(out + n, clientId, idLen);
+    return n;
+}
+
+size_t mqttEncodeSubscribe(uint8_t* out, size_t size, uint16_t packetId, const char* const* filters,
+                           const uint8_t* options, uint8_t count) {
+    size_t remaining = 3;
+    for (uint8_t i = 0; i < count; i++) remaining += 2 + strlen(filters[i]) + 1;
+    if (size < 1 + lengthSize(remaining) + remaining) return 0;
+    size_t n = 0;
+    out[n++] = (MQTT_PACKET_SUBSCRIBE << 4) | 0x02;
+    n += mqttPutLength(out + n, remaining);
+    out[n++] = (uint8_t)(packetId >> 8);
+    out[n++] = (uint8_t)packetId;
+    out[n++] = 0;
+    for (uint8_t i = 0; i < count; i++) {
+        n += putString(out + n, filters[i], strlen(filters[i]));
+        out[n++] = options[i];
+    }
+    return n;
+}
+
+size_t mqttEncodePublishHeader(uint8_t* out, size_t size, const char* topic, size_t topicLen, size_t payloadLen,
+                               uint8_t qos, uint16_t packetId) {
+    size_t remaining = 2 + topicLen + (qos ? 2 : 0) + 1 + payloadLen;
+    size_t header = 1 + lengthSize(remaining) + remaining - payloadLen;
+    if (topicLen > 65535 || size < header) return 0;
+    size_t n = 0;
+    out[n++] = (uint8_t)((MQTT_PACKET_PUBLISH << 4) | (qos ? 0x02 : 0));
+    n += mqttPutLength(out + n, remaining);
+    n += putString(out + n, topic, topicLen);
+    if (qos) {
+        out[n++] = (uint8_t)(packetId >> 8);
+        out[n++] = (uint8_t)packetId;
+    }
+    out[n++] = 0;       // No properties
+    return n;
+}
+
+size_t mqttEncodePuback(uint8_t* out, size_t size, uint16_t packetId) {
+    if (size < 4) return 0;
+    out[0] = MQTT_PACKET_PUBACK << 4;
+    out[1] = 2;         // Success, no properties: reason code omitted
+    out[2] = (uint8_t)(packetId >> 8);
+    out[3] = (uint8_t)packetId;
+    return 4;
+}
+
+size_t mqttEncodeEmpty(uint8_t* out, size_t size, uint8_t type) {
+    if (size < 2) return 0;
+    out[0] = (uint8_t)(type << 4);
+    out[1] = 0;
+    return 2;
+}
+
+bool mqttParseConnack(const MqttPacket& packet, uint8_t* reason, bool* sessionPresent) {
+    if (packet.type != MQTT_PACKET_CONNACK || packet.len < 2) return false;
+    *sessionPresent = packet.body[0] & 0x01;
+    *reason = packet.body[1];
+    return true;
+}
+
+bool mqttParsePublish(const MqttPacket& packet, MqttPublish* out) {
+    const uint8_t* p = packet.body;
+    size_t len = packet.len;
+    out->qos = (packet.flags >> 1) & 0x03;
+    out->dup = packet.flags & 0x08;
+    if (len < 2 || out->qos > 1) return false;
+    size_t topicLen = ((size_t)p[0] << 8) | p[1];
+    size_t n = 2 + topicLen;
+    if (n > len) return false;
+    out->topic = (const char*)p + 2;
+    out->topicLen = (uint16_t)topicLen;
+    out->packetId = 0;
+    if (out->qos) {
+        if (n + 2 > len) return false;
+        out->packetId = (uint16_t)((p[n] << 8) | p[n + 1]);
+        n += 2;
+    }
+    // Properties skipped whole: we set no Topic Alias Maximum, so the broker
+    // sends every topic in full
+    size_t props;
+    size_t used = mqttGetLength(p + n, len - n, &props);
+    if (!used || n + used + props > len) return false;
+    n += used + props;
+    out->payload = p + n;
+    out->len = len - n;
+    return true;
+}
@@ -0,0 +1,68 @@
+#ifndef MQTT_WIRE_H
+#define MQTT_WIRE_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// MQTT 5 packets for the collector, the subscribing end of the fleet. No I/O
+// and no allocation: encoders write into the caller's buffer and return the
+// bytes written (0 if it is too small), parsers point into the input.
+// Only what the collector exchanges with a broker: CONNECT/CONNACK,
+// SUBSCRIBE/SUBACK, PUBLISH, PUBACK, PINGREQ/PINGRESP, DISCONNECT.
+
+#define MQTT_PACKET_CONNECT     1
+#define MQTT_PACKET_CONNACK     2
+#define MQTT_PACKET_PUBLISH     3
+#define MQTT_PACKET_PUBACK      4
+#define MQTT_PACKET_SUBSCRIBE   8
+#define MQTT_PACKET_SUBACK      9
+#define MQTT_PACKET_PINGREQ     12
+#define MQTT_PACKET_PINGRESP    13
+#define MQTT_PACKET_DISCONNECT  14
+
+#define MQTT_SUB_NO_LOCAL       0x04    // Subscription option: not our own publishes back
+#define MQTT_PUBLISH_HEADER_MAX 16      // Fixed header and packet id, without the topic
+
+struct MqttPacket {
+    uint8_t type;
+    uint8_t flags;              // Low nibble of the first byte
+    const uint8_t* body;        // After the fixed header
+    size_t len;
+};
+
+struct MqttPublish {
+    const char* topic;          // Not NUL-terminated
+    uint16_t topicLen;
+    uint8_t qos;
+    bool dup;
+    uint16_t packetId;          // 0 at QoS 0
+    const uint8_t* payload;
+    size_t len;
+};
+
+size_t mqttPutLength(uint8_t* out, size_t value);
+// Variable byte integer at p; bytes used, 0 if incomplete or malformed
+size_t mqttGetLength(const uint8_t* p, size_t avail, size_t* value);
+
+// One packet at the start of `data`: 1 with the whole size in *total (and
+// *packet filled once all of it is in `len`), 0 if the length is not
+// complete yet, -1 if malformed
+int mqttFrame(const uint8_t* data, size_t len, MqttPacket* packet, size_t* total);
+
+// Clean start when sessionExpiryS is 0; maxPacket 0 leaves it to the broker
+size_t mqttEncodeConnect(uint8_t* out, size_t size, const char* clientId, uint16_t keepAliveS,
+                         uint32_t sessionExpiryS, uint32_t maxPacket);
+size_t mqttEncodeSubscribe(uint8_t* out, size_t size, uint16_t packetId, const char* const* filters,
+                           const uint8_t* options, uint8_t count);
+// Everything up to the payload, which the caller appends (payloadLen bytes)
+size_t mqttEncodePublishHeader(uint8_t* out, size_t size, const char* topic, size_t topicLen, size_t payloadLen,
+                               uint8_t qos, uint16_t packetId);
+size_t mqttEncodePuback(uint8_t* out, size_t size, uint16_t packetId);
+// PINGREQ, PINGRESP or DISCONNECT
+size_t mqttEncodeEmpty(uint8_t* out, size_t size, uint8_t type);
+
+// CONNACK: reason code, and whether the broker kept our session
+bool mqttParseConnack(const MqttPacket& packet, uint8_t* reason, bool* sessionPresent);
+bool mqttParsePublish(const MqttPacket& packet, MqttPublish* out);
+
+#endif
@@ -0,0 +1,108 @@
+#ifndef RECORD_RING_H
+#define RECORD_RING_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <atomic>
+#include "spsc_queue.h"
+
+// Single-producer / single-consumer ring of variable-length records, the
+// byte-buffer sibling of SpscQueue: the collector's I/O thread hands whole
+// MQTT messages to a worker (and a worker its ACKs back) with one copy and
+// no allocation. A record is a 32-bit length and its bytes, padded to 8; a
+// record never wraps, a marker sends the consumer back to the start instead.
+// reserve()/commit() and front()/pop() each belong to one thread.
+
+class RecordRing {
+public:
+    RecordRing() : buf(nullptr), size(0), reservedAt(0), frontAt(0), tail(0), head(0) {}
+    ~RecordRing() { release(); }
+
+    // bytes: a power of two; records up to maxRecord() bytes
+    bool init(uint32_t bytes) {
+        release();
+        if (bytes < 64 || (bytes & (bytes - 1))) return false;
+        buf = (uint8_t*)malloc(bytes);
+        if (!buf) return false;
+        size = bytes;
+        tail.store(0);
+        head.store(0);
+        return true;
+    }
+
+    void release() {
+        free(buf);
+        buf = nullptr;
+        size = 0;
+    }
+
+    uint32_t maxRecord() const { return size / 2 - 8; }
+
+    // Producer: room for a record of len bytes, nullptr while full
+    uint8_t* reserve(uint32_t len) {
+        if (len > maxRecord()) return nullptr;
+        uint32_t need = span(len);
+        uint32_t t = tail.load(std::memory_order_relaxed);
+        uint32_t used = t - head.load(std::memory_order_acquire);
+        uint32_t toEnd = size - (t & (size - 1));
+        if (need > toEnd) {
+            if (size - used < toEnd + need) return nullptr;
+            put32(buf + (t & (size - 1)), WRAP);
+            t += toEnd;
+        } else if (size - used < need) {
+            return nullptr;
+        }
+        reservedAt = t;
+        return buf + (t & (size - 1)) + 4;
+    }
+
+    // Producer: publishes the reserved record, len as given to reserve()
+    void commit(uint32_t len) {
+        put32(buf + (reservedAt & (size - 1)), len);
+        tail.store(reservedAt + span(len), std::memory_order_release);
+    }
+
+    // Consumer: oldest record, nullptr when empty
+    const uint8_t* front(uint32_t* len) {
+        uint32_t h = head.load(std::memory_order_relaxed);
+        if (tail.load(std::memory_order_acquire) == h) return nullptr;
+        uint32_t v = get32(buf + (h & (size - 1)));
+        if (v == WRAP) {
+            h += size - (h & (size - 1));
+            v = get32(buf + (h & (size - 1)));
+        }
+        frontAt = h;
+        *len = v;
+        return buf + (h & (size - 1)) + 4;
+    }
+
+    // Consumer: frees the record front() returned
+    void pop() {
+        uint32_t len = get32(buf + (frontAt & (size - 1)));
+        head.store(frontAt + span(len), std::memory_order_release);
+    }
+
+    bool empty() const { return tail.load(std::memory_order_acquire) == head.load(std::memory_order_acquire); }
+
+private:
+    static const uint32_t WRAP = 0xFFFFFFFFu;
+
+    static uint32_t span(uint32_t len) { return (4 + len + 7) & ~7u; }
+    static void put32(uint8_t* p, uint32_t v) { memcpy(p, &v, 4); }
+    static uint32_t get32(const uint8_t* p) {
+        uint32_t v;
+        memcpy(&v, p, 4);
+        return v;
+    }
+
+    uint8_t* buf;
+    uint32_t size;
+    uint32_t reservedAt;        // Producer's
+    uint32_t frontAt;           // Consumer's
+    alignas(SPSC_CACHE_LINE) std::atomic<uint32_t> tail;
+    alignas(SPSC_CACHE_LINE) std::atomic<uint32_t> head;
+};
+
+#endif
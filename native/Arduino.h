@@ -0,0 +1,265 @@
+/*
+* ============================================================================
+* ArgoS - native/Arduino.h
+* ============================================================================
+* Host (Linux) stand-in for the Arduino core used by the native build.
+* Clock, GPIO/ADC, Serial and String behave like the ESP32 core, but time is
+* virtual (see host_sim.h) so delays cost nothing in wall time.
+* ============================================================================
+*/
+
+#ifndef ARGUS_NATIVE_ARDUINO_H
+#define ARGUS_NATIVE_ARDUINO_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+
+typedef uint8_t byte;
+typedef bool boolean;
+
+#define HIGH 0x1
+#define LOW  0x0
+
+#define INPUT        0x01
+#define OUTPUT       0x03
+#define INPUT_PULLUP 0x05
+
+#define DEC 10
+#define HEX 16
+
+#define IRAM_ATTR
+// RTC slow memory (host_sim.h). RTC_DATA_ATTR: kept across deep sleep only,
+// zeroed by any other reset. RTC_NOINIT_ATTR: kept across resets too, garbage
+// after a power-on. Only zero-initialised variables.
+#define RTC_DATA_ATTR __attribute__((section("argus_rtc")))
+#define RTC_NOINIT_ATTR __attribute__((section("argus_rtc_noinit")))
+#define PROGMEM
+
+// --- Clock (virtual) ---
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);
+void delayMicroseconds(unsigned int us);
+void yield();
+
+// --- GPIO / ADC ---
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t val);
+int digitalRead(uint8_t pin);
+uint16_t analogRead(uint8_t pin);
+void analogReadResolution(uint8_t bits);
+
+// --- Random (deterministic on the host; seeded by hostReset()) ---
+long random(long howbig);
+long random(long howsmall, long howbig);
+void randomSeed(unsigned long seed);
+
+// --- Memory ---
+bool psramFound();
+void* ps_malloc(size_t size);
+
+// --- Time (SNTP status modelled in host_net.cpp, time() is the host clock) ---
+void configTime(long gmtOffset_sec, int daylightOffset_sec, const char* server1,
+                const char* server2 = nullptr, const char* server3 = nullptr);
+
+// ============================================================================
+// String (same allocation behaviour as WString: exact-size heap buffers)
+// ============================================================================
+
+class String {
+public:
+    String(const char* cstr = "");
+    String(const String& other);
+    explicit String(char c);
+    explicit String(int value, unsigned char base = 10);
+    explicit String(unsigned int value, unsigned char base = 10);
+    explicit String(long value, unsigned char base = 10);
+    explicit String(unsigned long value, unsigned char base = 10);
+    explicit String(float value, unsigned int decimalPlaces = 2);
+    explicit String(double value, unsigned int decimalPlaces = 2);
+    ~String();
+
+    String& operator=(const String& rhs);
+    String& operator=(const char* cstr);
+
+    bool reserve(unsigned int size);
+    unsigned int length() const { return len; }
+    const char* c_str() const { return buffer ? buffer : ""; }
+
+    bool concat(const String& s);
+    bool concat(const char* cstr);
+    bool concat(const char* cstr, unsigned int length);
+    bool concat(char c);
+    String& operator+=(const String& rhs) { concat(rhs); return *this; }
+    String& operator+=(const char* cstr) { concat(cstr); return *this; }
+    String& operator+=(char c) { concat(c); return *this; }
+
+    bool equals(const String& s) const;
+    bool equals(const char* cstr) const;
+    bool operator==(const String& rhs) const { return equals(rhs); }
+    bool operator==(const char* cstr) const { return equals(cstr); }
+    bool operator!=(const String& rhs) const { return !equals(rhs); }
+    bool operator!=(const char* cstr) const { return !equals(cstr); }
+
+    bool startsWith(const String& prefix) const;
+    bool endsWith(const String& suffix) const;
+    int indexOf(char ch, unsigned int fromIndex = 0) const;
+    char charAt(unsigned int index) const;
+    char operator[](unsigned int index) const { return charAt(index); }
+
+    String substring(unsigned int beginIndex) const { return substring(beginIndex, len); }
+    String substring(unsigned int beginIndex, unsigned int endIndex) const;
+    void trim();
+    void toLowerCase();
+    void toUpperCase();
+
+    long toInt() const;
+    float toFloat() const;
+
+private:
+    char* buffer;
+    unsigned int capacity;
+    unsigned int len;
+
+    void copy(const char* cstr, unsigned int length);
+};
+
+String operator+(const String& lhs, const String& rhs);
+String operator+(const String& lhs, const char* rhs);
+String operator+(const char* lhs, const String& rhs);
+String operator+(const String& lhs, char rhs);
+
+// ============================================================================
+// Print / Stream / Serial
+// ============================================================================
+
+class Print;
+
+class Printable {
+public:
+    virtual ~Printable() {}
+    virtual size_t printTo(Print& p) const = 0;
+};
+
+class Print {
+public:
+    virtual ~Print() {}
+    virtual size_t write(uint8_t c) = 0;
+    virtual size_t write(const uint8_t* buffer, size_t size);
+    size_t write(const char* str) { return str ? write((const uint8_t*)str, strlen(str)) : 0; }
+
+    size_t printf(const char* format, ...) __attribute__((format(printf, 2, 3)));
+
+    size_t print(const String& s) { return write((const uint8_t*)s.c_str(), s.length()); }
+    size_t print(const char* str) { return write(str); }
+    size_t print(char c) { return write((uint8_t)c); }
+    size_t print(int n, int base = DEC) { return print((long)n, base); }
+    size_t print(unsigned int n, int base = DEC) { return print((unsigned long)n, base); }
+    size_t print(long n, int base = DEC);
+    size_t print(unsigned long n, int base = DEC);
+    size_t print(double n, int digits = 2);
+    size_t print(const Printable& p) { return p.printTo(*this); }
+
+    size_t println() { return write("\r\n"); }
+    template <typename T> size_t println(const T& v) { size_t n = print(v); return n + println(); }
+    template <typename T> size_t println(const T& v, int fmt) { size_t n = print(v, fmt); return n + println(); }
+};
+
+class Stream : public Print {
+public:
+    Stream() : timeoutMs(1000) {}
+    virtual int available() = 0;
+    virtual int read() = 0;
+    virtual int peek() = 0;
+
+    void setTimeout(unsigned long timeout) { timeoutMs = timeout; }
+    unsigned long getTimeout() const { return timeoutMs; }
+
+    size_t readBytes(uint8_t* buffer, size_t length);
+    String readStringUntil(char terminator);
+
+protected:
+    unsigned long timeoutMs;
+    int timedRead();
+};
+
+class HardwareSerial : public Stream {
+public:
+    void begin(unsigned long baud) { baudRate = baud; }
+    void end() {}
+    unsigned long baud() const { return baudRate; }
+    void flush();
+
+    // TX path: 128-byte hardware FIFO plus the optional driver ring buffer.
+    // Writes only block (advance the virtual clock) once both are full.
+    size_t setTxBufferSize(size_t size) { txBufferSize = size; return size; }
+    size_t setRxBufferSize(size_t size) { return size; }
+    int availableForWrite();
+
+    int available() override;
+    int read() override;
+    int peek() override;
+    size_t write(uint8_t c) override;
+    size_t write(const uint8_t* buffer, size_t size) override;
+    using Print::write;
+
+    operator bool() const { return true; }
+
+private:
+    unsigned long baudRate = 115200;
+    size_t txBufferSize = 0;
+    uint64_t txQueued = 0;
+    uint64_t txDrainedAtUs = 0;
+
+    void drainTx();
+};
+
+extern HardwareSerial Serial;
+
+// ============================================================================
+// IPAddress
+// ============================================================================
+
+class IPAddress : public Printable {
+public:
+    IPAddress() : addr(0) {}
+    IPAddress(uint8_t a, uint8_t b, uint8_t c, uint8_t d)
+        : addr((uint32_t)a | ((uint32_t)b << 8) | ((uint32_t)c << 16) | ((uint32_t)d << 24)) {}
+    IPAddress(uint32_t raw) : addr(raw) {}
+
+    operator uint32_t() const { return addr; }
+    uint8_t operator[](int index) const { return (uint8_t)(addr >> (8 * index)); }
+    bool operator==(const IPAddress& rhs) const { return addr == rhs.addr; }
+    bool operator!=(const IPAddress& rhs) const { return addr != rhs.addr; }
+
+    String toString() const;
+    size_t printTo(Print& p) const override;
+
+private:
+    uint32_t addr;
+};
+
+// ============================================================================
+// ESP (heap introspection, backed by the host allocation counters)
+// ============================================================================
+
+class EspClass {
+public:
+    uint32_t getHeapSize();
+    uint32_t getFreeHeap();
+    uint32_t getMinFreeHeap();
+    uint32_t getMaxAllocHeap();
+    uint32_t getPsramSize();
+    uint32_t getFreePsram();
+    uint32_t getMinFreePsram();
+    void restart();
+};
+
+extern EspClass ESP;
+
+#endif
@@ -0,0 +1,34 @@
+// Host stand-in for claws/BH1750. Talks to the sensor through the TwoWire
+// stand-in, so the simulated I2C device decides what is measured.
+
+#ifndef ARGUS_NATIVE_BH1750_H
+#define ARGUS_NATIVE_BH1750_H
+
+#include "Arduino.h"
+#include "Wire.h"
+
+class BH1750 {
+public:
+    enum Mode {
+        UNCONFIGURED = 0,
+        CONTINUOUS_HIGH_RES_MODE = 0x10,
+        CONTINUOUS_HIGH_RES_MODE_2 = 0x11,
+        CONTINUOUS_LOW_RES_MODE = 0x13,
+        ONE_TIME_HIGH_RES_MODE = 0x20,
+        ONE_TIME_HIGH_RES_MODE_2 = 0x21,
+        ONE_TIME_LOW_RES_MODE = 0x23
+    };
+
+    BH1750(byte addr = 0x23) : address(addr), mode(UNCONFIGURED), i2c(nullptr) {}
+
+    bool begin(Mode mode = CONTINUOUS_HIGH_RES_MODE, byte addr = 0x00, TwoWire* i2c = nullptr);
+    bool configure(Mode mode);
+    float readLightLevel();
+
+private:
+    byte address;
+    Mode mode;
+    TwoWire* i2c;
+};
+
+#endif
@@ -0,0 +1,26 @@
+// Host stand-in for the Adafruit DHT library. The single-wire protocol is not
+// modelled; readings come straight from hostEnv().
+
+#ifndef ARGUS_NATIVE_DHT_H
+#define ARGUS_NATIVE_DHT_H
+
+#include "Arduino.h"
+
+#define DHT11 11
+#define DHT22 22
+#define DHT21 21
+
+class DHT {
+public:
+    DHT(uint8_t pin, uint8_t type, uint8_t count = 6) : pin(pin), type(type) { (void)count; }
+    void begin(uint8_t usec = 55) { (void)usec; }
+    float readTemperature(bool isFahrenheit = false, bool force = false);
+    float readHumidity(bool force = false);
+
+private:
+    uint8_t pin;
+    uint8_t type;
+    unsigned long lastReadMs = 0;
+};
+
+#endif
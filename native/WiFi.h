@@ -0,0 +1,83 @@
+// Host stand-in for the ESP32 WiFi stack. Association, DHCP and DNS cost
+// virtual time according to hostNet().
+
+#ifndef ARGUS_NATIVE_WIFI_H
+#define ARGUS_NATIVE_WIFI_H
+
+#include "Arduino.h"
+
+typedef enum {
+    WL_IDLE_STATUS = 0,
+    WL_NO_SSID_AVAIL = 1,
+    WL_SCAN_COMPLETED = 2,
+    WL_CONNECTED = 3,
+    WL_CONNECT_FAILED = 4,
+    WL_CONNECTION_LOST = 5,
+    WL_DISCONNECTED = 6
+} wl_status_t;
+
+typedef enum { WIFI_OFF = 0, WIFI_STA = 1, WIFI_AP = 2, WIFI_AP_STA = 3 } wifi_mode_t;
+
+class WiFiClass {
+public:
+    wl_status_t begin(const char* ssid, const char* passphrase = nullptr, int32_t channel = 0,
+                      const uint8_t* bssid = nullptr, bool connect = true);
+    bool config(IPAddress localIP, IPAddress gateway, IPAddress subnet,
+                IPAddress dns1 = IPAddress(), IPAddress dns2 = IPAddress());
+    bool disconnect(bool wifioff = false, bool eraseap = false);
+    bool reconnect();
+    wl_status_t status();
+
+    bool mode(wifi_mode_t m) { currentMode = m; return true; }
+    wifi_mode_t getMode() { return currentMode; }
+    bool setAutoReconnect(bool enabled) { (void)enabled; return true; }
+    bool persistent(bool enabled) { (void)enabled; return true; }
+    bool setSleep(bool enabled) { (void)enabled; return true; }
+
+    int hostByName(const char* host, IPAddress& result);
+
+    IPAddress localIP();
+    IPAddress gatewayIP();
+    IPAddress subnetMask();
+    IPAddress dnsIP(uint8_t index = 0);
+    int32_t channel();
+    uint8_t* BSSID();
+    int8_t RSSI();
+
+private:
+    wifi_mode_t currentMode = WIFI_STA;
+    bool started = false;
+    bool staticIp = false;
+    unsigned long readyAtMs = 0;
+};
+
+extern WiFiClass WiFi;
+
+// Plain TCP socket stand-in. Bytes written are counted, charged to the link
+// model and parsed by hostBroker(), which also serves what is read.
+class WiFiClient : public Stream {
+public:
+    virtual ~WiFiClient() {}
+    virtual int connect(IPAddress ip, uint16_t port);
+    virtual int connect(const char* host, uint16_t port);
+    virtual void stop();
+    virtual uint8_t connected();
+
+    size_t write(uint8_t c) override { return write(&c, 1); }
+    size_t write(const uint8_t* buf, size_t size) override;
+    using Print::write;
+    int available() override;
+    int read() override;
+    int read(uint8_t* buf, size_t size);
+    int peek() override;
+    void flush() {}
+
+    void setTimeout(uint32_t seconds) { Stream::setTimeout(seconds * 1000); }
+
+    uint64_t bytesWritten = 0;
+
+protected:
+    bool open = false;
+};
+
+#endif
@@ -0,0 +1,27 @@
+// Host stand-in for WiFiClientSecure: connect() pays the TLS handshake cost.
+// No session resumption, like the Arduino client: every connect is a full
+// handshake.
+
+#ifndef ARGUS_NATIVE_WIFICLIENTSECURE_H
+#define ARGUS_NATIVE_WIFICLIENTSECURE_H
+
+#include "WiFi.h"
+
+class WiFiClientSecure : public WiFiClient {
+public:
+    void setInsecure() { insecure = true; }
+    void setCACert(const char* rootCA) { (void)rootCA; }
+    int lastError(char* buf, const size_t size);
+
+    int connect(IPAddress ip, uint16_t port) override;
+    int connect(const char* host, uint16_t port) override;
+    // Address resolved by the caller, `host` for SNI
+    int connect(IPAddress ip, uint16_t port, const char* host, const char* rootCA,
+                const char* cert, const char* key);
+
+private:
+    bool insecure = false;
+    bool handshake();
+};
+
+#endif
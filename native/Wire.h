@@ -0,0 +1,38 @@
+// Host stand-in for the ESP32 TwoWire driver. Transactions are routed to the
+// simulated devices registered with hostI2cAttach().
+
+#ifndef ARGUS_NATIVE_WIRE_H
+#define ARGUS_NATIVE_WIRE_H
+
+#include "Arduino.h"
+
+class TwoWire : public Stream {
+public:
+    bool begin(int sda = -1, int scl = -1, uint32_t frequency = 0);
+    void setTimeOut(uint16_t timeOutMillis) { timeOut = timeOutMillis; }
+    void setClock(uint32_t frequency) { (void)frequency; }
+
+    void beginTransmission(uint8_t address);
+    uint8_t endTransmission(bool sendStop = true);
+    uint8_t requestFrom(uint8_t address, uint8_t quantity, bool sendStop = true);
+
+    size_t write(uint8_t data) override;
+    size_t write(const uint8_t* data, size_t quantity) override;
+    using Print::write;
+    int available() override;
+    int read() override;
+    int peek() override;
+
+private:
+    uint16_t timeOut = 50;
+    uint8_t txAddress = 0;
+    uint8_t txBuffer[128];
+    size_t txLength = 0;
+    uint8_t rxBuffer[128];
+    size_t rxLength = 0;
+    size_t rxIndex = 0;
+};
+
+extern TwoWire Wire;
+
+#endif
@@ -0,0 +1,13 @@
+// Host stand-in for the ESP-IDF network interface handles: the station
+// interface and its lwIP netif (lwip/dhcp.h), nothing else.
+
+#ifndef ARGUS_NATIVE_ESP_NETIF_H
+#define ARGUS_NATIVE_ESP_NETIF_H
+
+typedef struct esp_netif_obj esp_netif_t;
+
+// "WIFI_STA_DEF" only
+esp_netif_t* esp_netif_get_handle_from_ifkey(const char* if_key);
+void* esp_netif_get_netif_impl(esp_netif_t* esp_netif);
+
+#endif
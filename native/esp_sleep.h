@@ -0,0 +1,23 @@
+// Host stand-in for the ESP-IDF sleep API (esp_sleep.h), deep sleep and the
+// RTC timer wake-up only. esp_deep_sleep_start() returns on the host with
+// the sleep pending; the runner wakes the firmware (host_sim.h).
+
+#ifndef ARGUS_NATIVE_ESP_SLEEP_H
+#define ARGUS_NATIVE_ESP_SLEEP_H
+
+#include <stdint.h>
+#include "esp_camera.h"     // esp_err_t
+
+typedef enum {
+    ESP_SLEEP_WAKEUP_UNDEFINED = 0,     // Power-on or reset, not a wake-up
+    ESP_SLEEP_WAKEUP_ALL,
+    ESP_SLEEP_WAKEUP_EXT0,
+    ESP_SLEEP_WAKEUP_EXT1,
+    ESP_SLEEP_WAKEUP_TIMER
+} esp_sleep_wakeup_cause_t;
+
+esp_err_t esp_sleep_enable_timer_wakeup(uint64_t time_in_us);
+void esp_deep_sleep_start();
+esp_sleep_wakeup_cause_t esp_sleep_get_wakeup_cause();
+
+#endif
@@ -0,0 +1,15 @@
+// Host stand-in for the SNTP status (ESP-IDF esp_sntp.h). configTime()
+// starts the sync; it completes ntpMs (hostNet()) after WiFi is up.
+
+#ifndef ARGUS_NATIVE_ESP_SNTP_H
+#define ARGUS_NATIVE_ESP_SNTP_H
+
+typedef enum {
+    SNTP_SYNC_STATUS_RESET,
+    SNTP_SYNC_STATUS_COMPLETED,     // Reported once, then back to RESET
+    SNTP_SYNC_STATUS_IN_PROGRESS
+} sntp_sync_status_t;
+
+sntp_sync_status_t sntp_get_sync_status(void);
+
+#endif
@@ -0,0 +1,34 @@
+// Host stand-in for the ESP-IDF high resolution timer (esp_timer.h). Callbacks
+// fire as the host clock passes their deadline, on the thread that advanced
+// it, and see esp_timer_get_time() == the deadline (the esp_timer task runs at
+// top priority, so a callback starts on time and takes ~no time) plus the
+// dispatch latency set with hostTimerSetLatency().
+
+#ifndef ARGUS_NATIVE_ESP_TIMER_H
+#define ARGUS_NATIVE_ESP_TIMER_H
+
+#include <stdint.h>
+#include "esp_camera.h"     // esp_err_t
+
+typedef struct esp_timer* esp_timer_handle_t;
+typedef void (*esp_timer_cb_t)(void* arg);
+
+typedef enum { ESP_TIMER_TASK, ESP_TIMER_ISR } esp_timer_dispatch_t;
+
+typedef struct {
+    esp_timer_cb_t callback;
+    void* arg;
+    esp_timer_dispatch_t dispatch_method;
+    const char* name;
+    bool skip_unhandled_events;
+} esp_timer_create_args_t;
+
+esp_err_t esp_timer_create(const esp_timer_create_args_t* args, esp_timer_handle_t* out);
+esp_err_t esp_timer_start_once(esp_timer_handle_t timer, uint64_t timeout_us);
+esp_err_t esp_timer_start_periodic(esp_timer_handle_t timer, uint64_t period_us);
+esp_err_t esp_timer_stop(esp_timer_handle_t timer);
+esp_err_t esp_timer_delete(esp_timer_handle_t timer);
+bool esp_timer_is_active(esp_timer_handle_t timer);
+int64_t esp_timer_get_time();
+
+#endif
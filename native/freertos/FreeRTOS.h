@@ -0,0 +1,38 @@
+// Host stand-in for the FreeRTOS port layer: critical sections map to a
+// spinlock so code written for both ESP32 cores keeps its semantics.
+
+#ifndef ARGUS_NATIVE_FREERTOS_H
+#define ARGUS_NATIVE_FREERTOS_H
+
+#include <stdint.h>
+#include <atomic>
+
+typedef int BaseType_t;
+typedef unsigned int UBaseType_t;
+typedef uint32_t TickType_t;
+
+#define pdTRUE  1
+#define pdFALSE 0
+#define pdPASS  1
+#define portMAX_DELAY 0xFFFFFFFFu
+#define portTICK_PERIOD_MS 1
+
+struct portMUX_TYPE {
+    std::atomic_flag flag;
+};
+
+#define portMUX_INITIALIZER_UNLOCKED {ATOMIC_FLAG_INIT}
+
+inline void portENTER_CRITICAL(portMUX_TYPE* mux) {
+    while (mux->flag.test_and_set(std::memory_order_acquire)) {
+    }
+}
+
+inline void portEXIT_CRITICAL(portMUX_TYPE* mux) { mux->flag.clear(std::memory_order_release); }
+
+#define portENTER_CRITICAL_ISR(mux) portENTER_CRITICAL(mux)
+#define portEXIT_CRITICAL_ISR(mux) portEXIT_CRITICAL(mux)
+#define portENTER_CRITICAL_SAFE(mux) portENTER_CRITICAL(mux)
+#define portEXIT_CRITICAL_SAFE(mux) portEXIT_CRITICAL(mux)
+
+#endif
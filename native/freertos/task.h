@@ -0,0 +1,23 @@
+// Host stand-in for FreeRTOS tasks: each task is a std::thread. Core affinity
+// is recorded (xPortGetCoreID) but not enforced, priorities are ignored.
+// vTaskDelete(NULL) does not end the thread: the task function has to return
+// right after it, and hostTasksJoin() (host_sim.h) waits for that.
+
+#ifndef ARGUS_NATIVE_FREERTOS_TASK_H
+#define ARGUS_NATIVE_FREERTOS_TASK_H
+
+#include "FreeRTOS.h"
+
+typedef void (*TaskFunction_t)(void*);
+typedef void* TaskHandle_t;
+
+#define tskNO_AFFINITY 0x7FFFFFFF
+#define pdMS_TO_TICKS(ms) ((TickType_t)(ms) / portTICK_PERIOD_MS)
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t task, const char* name, uint32_t stackDepth, void* param,
+                                   UBaseType_t priority, TaskHandle_t* handle, BaseType_t core);
+void vTaskDelay(TickType_t ticks);
+void vTaskDelete(TaskHandle_t task);
+BaseType_t xPortGetCoreID();
+
+#endif
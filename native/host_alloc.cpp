@@ -0,0 +1,158 @@
+// Heap accounting for the native build. The executable interposes the glibc
+// allocator entry points, so String, std:: containers and operator new are
+// all counted without touching the firmware sources.
+
+#include "host_sim.h"
+#include <atomic>
+#include <malloc.h>
+
+extern "C" {
+void* __libc_malloc(size_t size);
+void* __libc_calloc(size_t n, size_t size);
+void* __libc_realloc(void* ptr, size_t size);
+void __libc_free(void* ptr);
+}
+
+static std::atomic<uint64_t> allocCount(0);
+static std::atomic<uint64_t> freeCount(0);
+static std::atomic<uint64_t> allocBytes(0);
+static std::atomic<int64_t> liveBytes(0);
+static std::atomic<int64_t> peakLiveBytes(0);
+static thread_local int pauseDepth = 0;
+
+// PSRAM blocks (ps_malloc) are tracked apart from the internal heap in a
+// fixed open-addressing table, so free() can tell them apart without allocating
+static const size_t PSRAM_SLOTS = 4096;
+static void* psramPtr[PSRAM_SLOTS];
+static size_t psramSize[PSRAM_SLOTS];
+static std::atomic_flag psramLock = ATOMIC_FLAG_INIT;
+static std::atomic<int64_t> psramLive(0);
+static std::atomic<int64_t> psramPeak(0);
+static std::atomic<uint64_t> psramAllocCount(0);
+
+static size_t psramSlot(void* ptr) { return ((uintptr_t)ptr >> 4) % PSRAM_SLOTS; }
+
+static void psramInsert(void* ptr, size_t size) {
+    while (psramLock.test_and_set(std::memory_order_acquire)) {
+    }
+    size_t i = psramSlot(ptr);
+    while (psramPtr[i]) i = (i + 1) % PSRAM_SLOTS;
+    psramPtr[i] = ptr;
+    psramSize[i] = size;
+    psramLock.clear(std::memory_order_release);
+    int64_t live = psramLive.fetch_add((int64_t)size) + (int64_t)size;
+    int64_t peak = psramPeak.load();
+    while (live > peak && !psramPeak.compare_exchange_weak(peak, live)) {
+    }
+}
+
+// Returns the block size if ptr came from hostPsramAlloc (0 otherwise)
+static size_t psramRemove(void* ptr) {
+    if (!ptr || psramLive.load(std::memory_order_relaxed) == 0) return 0;
+    size_t size = 0;
+    while (psramLock.test_and_set(std::memory_order_acquire)) {
+    }
+    size_t i = psramSlot(ptr);
+    while (psramPtr[i] && psramPtr[i] != ptr) i = (i + 1) % PSRAM_SLOTS;
+    if (psramPtr[i] == ptr) {
+        size = psramSize[i];
+        psramPtr[i] = nullptr;
+        // Re-insert the rest of the probe run
+        for (size_t j = (i + 1) % PSRAM_SLOTS; psramPtr[j]; j = (j + 1) % PSRAM_SLOTS) {
+            void* p = psramPtr[j];
+            size_t s = psramSize[j];
+            psramPtr[j] = nullptr;
+            size_t k = psramSlot(p);
+            while (psramPtr[k]) k = (k + 1) % PSRAM_SLOTS;
+            psramPtr[k] = p;
+            psramSize[k] = s;
+        }
+    }
+    psramLock.clear(std::memory_order_release);
+    if (size) psramLive.fetch_sub((int64_t)size);
+    return size;
+}
+
+void* hostPsramAlloc(size_t size) {
+    void* ptr = __libc_malloc(size ? size : 1);
+    if (ptr) psramInsert(ptr, size ? size : 1);
+    if (ptr && !pauseDepth) psramAllocCount.fetch_add(1, std::memory_order_relaxed);
+    return ptr;
+}
+
+HostAllocPause::HostAllocPause() { pauseDepth++; }
+HostAllocPause::~HostAllocPause() { pauseDepth--; }
+
+static void noteAlloc(void* ptr) {
+    if (!ptr || pauseDepth) return;
+    int64_t size = (int64_t)malloc_usable_size(ptr);
+    allocCount.fetch_add(1, std::memory_order_relaxed);
+    allocBytes.fetch_add((uint64_t)size, std::memory_order_relaxed);
+    int64_t live = liveBytes.fetch_add(size, std::memory_order_relaxed) + size;
+    int64_t peak = peakLiveBytes.load(std::memory_order_relaxed);
+    while (live > peak && !peakLiveBytes.compare_exchange_weak(peak, live, std::memory_order_relaxed)) {
+    }
+}
+
+static void noteFree(void* ptr) {
+    if (!ptr || pauseDepth) return;
+    freeCount.fetch_add(1, std::memory_order_relaxed);
+    liveBytes.fetch_sub((int64_t)malloc_usable_size(ptr), std::memory_order_relaxed);
+}
+
+extern "C" {
+
+void* malloc(size_t size) {
+    void* ptr = __libc_malloc(size);
+    noteAlloc(ptr);
+    return ptr;
+}
+
+void* calloc(size_t n, size_t size) {
+    void* ptr = __libc_calloc(n, size);
+    noteAlloc(ptr);
+    return ptr;
+}
+
+void* realloc(void* ptr, size_t size) {
+    size_t psram = psramRemove(ptr);
+    if (psram) {
+        void* out = __libc_realloc(ptr, size);
+        psramInsert(out ? out : ptr, out ? size : psram);
+        return out;
+    }
+    noteFree(ptr);
+    void* out = __libc_realloc(ptr, size);
+    if (!out && ptr && size) {
+        // Original block is still alive
+        noteAlloc(ptr);
+        return out;
+    }
+    noteAlloc(out);
+    return out;
+}
+
+void free(void* ptr) {
+    if (!psramRemove(ptr)) noteFree(ptr);
+    __libc_free(ptr);
+}
+
+}
+
+HostAllocStats hostAllocStats() {
+    HostAllocStats s;
+    s.allocs = allocCount.load();
+    s.frees = freeCount.load();
+    s.bytes = allocBytes.load();
+    s.liveBytes = liveBytes.load();
+    s.peakLiveBytes = peakLiveBytes.load();
+    s.psramLiveBytes = psramLive.load();
+    s.psramPeakBytes = psramPeak.load();
+    s.psramAllocs = psramAllocCount.load();
+    return s;
+}
+
+void hostAllocResetPeak() {
+    peakLiveBytes.store(liveBytes.load());
+    psramPeak.store(psramLive.load());
+}
@@ -0,0 +1,695 @@
+#include "Arduino.h"
+#include "host_sim.h"
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <deque>
+#include <mutex>
+#include <stdarg.h>
+#include <ctype.h>
+
+// ============================================================================
+// VIRTUAL CLOCK
+// ============================================================================
+
+static std::atomic<uint64_t> clockMicros(0);
+
+// Real-time mode (threaded runs): time is the steady clock times `scale`,
+// shared by all threads, and a cost holds the calling thread until it has
+// passed, so each firmware task spends it as if it had its own core. The
+// last stretch is spun rather than slept: a 280 us LED pulse is 280 us.
+typedef std::chrono::steady_clock HostSteady;
+static double realtimeScale = 0;
+static uint64_t realtimeBase = 0;
+static HostSteady::time_point realtimeOrigin;
+static const std::chrono::microseconds REALTIME_SPIN(100);
+
+void hostClockRealtime(double scale) {
+    uint64_t now = hostClockMicros();
+    realtimeOrigin = HostSteady::now();
+    realtimeBase = now;
+    clockMicros.store(now);
+    realtimeScale = scale > 0 ? scale : 0;
+}
+
+void hostClockReset(uint64_t startMicros) {
+    clockMicros.store(startMicros);
+    realtimeBase = startMicros;
+    realtimeOrigin = HostSteady::now();
+}
+
+// esp_timer callbacks run at their deadline, on the thread whose cost passed
+// it, and their own costs stay on their own time (another task's)
+static thread_local uint64_t timerNowMicros = 0;   // 0 = not in a callback
+static std::mutex timerFireLock;
+static uint32_t timerLatencyMax = 0;
+static uint32_t timerLatencySeed = 0x1234567;
+
+void hostTimerSetLatency(uint32_t maxMicros) { timerLatencyMax = maxMicros; }
+
+static void fireTimers(uint64_t untilMicros) {
+    std::unique_lock<std::mutex> guard(timerFireLock, std::try_to_lock);
+    if (!guard.owns_lock()) return;     // Another thread is firing them
+    HostTimerEvent event;
+    while (hostTimerTakeDue(untilMicros, &event)) {
+        uint64_t latency = 0;
+        if (timerLatencyMax) {
+            timerLatencySeed = timerLatencySeed * 1103515245u + 12345u;
+            latency = (timerLatencySeed >> 8) % (timerLatencyMax + 1);
+        }
+        timerNowMicros = event.dueMicros + latency ? event.dueMicros + latency : 1;
+        event.callback(event.arg);
+        timerNowMicros = 0;
+    }
+}
+
+uint64_t hostClockMicros() {
+    if (timerNowMicros) return timerNowMicros;
+    if (realtimeScale <= 0) return clockMicros.load();
+    std::chrono::duration<double, std::micro> real = HostSteady::now() - realtimeOrigin;
+    return realtimeBase + (uint64_t)(real.count() * realtimeScale);
+}
+
+void hostClockAdvanceMicros(uint64_t us) {
+    if (timerNowMicros) {
+        timerNowMicros += us;
+        return;
+    }
+    if (realtimeScale <= 0) {
+        fireTimers(clockMicros.load() + us);
+        clockMicros.fetch_add(us);
+        return;
+    }
+    fireTimers(hostClockMicros());
+    HostSteady::time_point now = HostSteady::now();
+    HostSteady::time_point until = now + std::chrono::duration_cast<HostSteady::duration>(
+        std::chrono::duration<double, std::micro>(us / realtimeScale));
+    if (until - now > REALTIME_SPIN) std::this_thread::sleep_until(until - REALTIME_SPIN);
+    while (HostSteady::now() < until) {
+    }
+    fireTimers(hostClockMicros());
+}
+
+void hostClockAdvanceMs(uint64_t ms) { hostClockAdvanceMicros(ms * 1000ULL); }
+
+unsigned long millis() { return (unsigned long)(hostClockMicros() / 1000ULL); }
+unsigned long micros() { return (unsigned long)hostClockMicros(); }
+void delay(unsigned long ms) { hostClockAdvanceMs(ms); }
+void delayMicroseconds(unsigned int us) { hostClockAdvanceMicros(us); }
+void yield() {}
+
+// ============================================================================
+// ENVIRONMENT / GPIO / ADC
+// ============================================================================
+
+static HostEnvironment environment = {25.0f, 50.0f, 8000.0f, 50.0f};
+HostEnvironment& hostEnv() { return environment; }
+
+static const int HOST_PIN_COUNT = 64;
+static uint8_t pinLevel[HOST_PIN_COUNT];
+static uint64_t pinChangedAt[HOST_PIN_COUNT];
+static uint64_t lowPins = 0;            // Driven LOW (not just never driven): the dust model's candidates
+static HostAdcSource adcSource = hostDustAdcModel;
+static uint8_t adcBits = 12;
+static float dustAt[HOST_PIN_COUNT];     // Per LED pin; NaN = environment.dust
+static bool dustAtSet = false;
+
+void hostSetDustAt(uint8_t ledPin, float dust) {
+    if (ledPin >= HOST_PIN_COUNT) return;
+    if (!dustAtSet) {
+        for (int p = 0; p < HOST_PIN_COUNT; p++) dustAt[p] = NAN;
+        dustAtSet = true;
+    }
+    dustAt[ledPin] = dust;
+}
+
+void hostSetAdcSource(HostAdcSource source) { adcSource = source ? source : hostDustAdcModel; }
+uint8_t hostPinLevel(uint8_t pin) { return pin < HOST_PIN_COUNT ? pinLevel[pin] : LOW; }
+uint64_t hostPinChangedAtMicros(uint8_t pin) { return pin < HOST_PIN_COUNT ? pinChangedAt[pin] : 0; }
+
+void pinMode(uint8_t pin, uint8_t mode) {
+    (void)pin;
+    (void)mode;
+}
+
+void digitalWrite(uint8_t pin, uint8_t val) {
+    if (pin >= HOST_PIN_COUNT) return;
+    val = val ? HIGH : LOW;
+    if (pinLevel[pin] != val) {
+        pinLevel[pin] = val;
+        pinChangedAt[pin] = hostClockMicros();
+        if (val == LOW && pinChangedAt[pin]) lowPins |= 1ULL << pin;
+        else lowPins &= ~(1ULL << pin);
+    }
+}
+
+int digitalRead(uint8_t pin) { return hostPinLevel(pin); }
+
+void analogReadResolution(uint8_t bits) { adcBits = bits; }
+
+uint16_t analogRead(uint8_t pin) {
+    uint16_t raw = adcSource(pin, hostClockMicros());
+    // Sources produce 12-bit values
+    if (adcBits < 12) raw >>= (12 - adcBits);
+    return raw;
+}
+
+// GP2Y1010AU0F: Vo = (density + 0.1) / 0.17 with the LED (active low) lit for
+// ~280us. The LED pin is the one driven LOW most recently.
+uint16_t hostDustAdcModel(uint8_t pin, uint64_t nowMicros) {
+    (void)pin;
+    int ledPin = -1;
+    uint64_t latest = 0;
+    for (uint64_t pins = lowPins; pins; pins &= pins - 1) {
+        int p = __builtin_ctzll(pins);
+        if (pinChangedAt[p] >= latest) {
+            latest = pinChangedAt[p];
+            ledPin = p;
+        }
+    }
+    float volts = 0.1f;
+    if (ledPin >= 0) {
+        uint64_t lit = nowMicros - latest;
+        if (lit >= 200 && lit <= 400) {
+            float dust = dustAtSet && !isnan(dustAt[ledPin]) ? dustAt[ledPin] : environment.dust;
+            volts = (dust / 1000.0f + 0.1f) / 0.17f;
+        }
+    }
+    int raw = (int)(volts * 4095.0f / 3.3f + 0.5f);
+    if (raw > 4095) raw = 4095;
+    return (uint16_t)raw;
+}
+
+static uint32_t randomState = 1;
+
+void randomSeed(unsigned long seed) { randomState = seed ? (uint32_t)seed : 1; }
+
+long random(long howbig) {
+    if (howbig <= 0) return 0;
+    randomState ^= randomState << 13;
+    randomState ^= randomState >> 17;
+    randomState ^= randomState << 5;
+    return (long)(randomState % (uint32_t)howbig);
+}
+
+long random(long howsmall, long howbig) {
+    if (howsmall >= howbig) return howsmall;
+    return howsmall + random(howbig - howsmall);
+}
+
+static bool psramPresent = true;
+
+void hostSetPsram(bool present) { psramPresent = present; }
+bool psramFound() { return psramPresent; }
+void* ps_malloc(size_t size) { return hostPsramAlloc(size); }
+
+// ============================================================================
+// STRING
+// ============================================================================
+
+String::String(const char* cstr) : buffer(nullptr), capacity(0), len(0) {
+    if (cstr) copy(cstr, strlen(cstr));
+}
+
+String::String(const String& other) : buffer(nullptr), capacity(0), len(0) {
+    copy(other.c_str(), other.len);
+}
+
+String::String(char c) : buffer(nullptr), capacity(0), len(0) {
+    char buf[2] = {c, 0};
+    copy(buf, 1);
+}
+
+static void formatInteger(char* buf, size_t size, unsigned long value, bool negative, unsigned char base) {
+    char tmp[34];
+    int i = 0;
+    if (base < 2) base = 10;
+    do {
+        unsigned long digit = value % base;
+        tmp[i++] = (char)(digit < 10 ? '0' + digit : 'a' + digit - 10);
+        value /= base;
+    } while (value && i < (int)sizeof(tmp) - 1);
+    size_t o = 0;
+    if (negative && o < size - 1) buf[o++] = '-';
+    while (i > 0 && o < size - 1) buf[o++] = tmp[--i];
+    buf[o] = 0;
+}
+
+String::String(int value, unsigned char base) : buffer(nullptr), capacity(0), len(0) {
+    char buf[36];
+    bool neg = value < 0 && base == 10;
+    formatInteger(buf, sizeof(buf), neg ? (unsigned long)(-(long)value) : (unsigned long)(unsigned int)value, neg, base);
+    copy(buf, strlen(buf));
+}
+
+String::String(unsigned int value, unsigned char base) : buffer(nullptr), capacity(0), len(0) {
+    char buf[36];
+    formatInteger(buf, sizeof(buf), value, false, base);
+    copy(buf, strlen(buf));
+}
+
+String::String(long value, unsigned char base) : buffer(nullptr), capacity(0), len(0) {
+    char buf[36];
+    bool neg = value < 0 && base == 10;
+    formatInteger(buf, sizeof(buf), neg ? (unsigned long)(-value) : (unsigned long)value, neg, base);
+    copy(buf, strlen(buf));
+}
+
+String::String(unsigned long value, unsigned char base) : buffer(nullptr), capacity(0), len(0) {
+    char buf[36];
+    formatInteger(buf, sizeof(buf), value, false, base);
+    copy(buf, strlen(buf));
+}
+
+String::String(float value, unsigned int decimalPlaces) : buffer(nullptr), capacity(0), len(0) {
+    char buf[48];
+    snprintf(buf, sizeof(buf), "%.*f", (int)decimalPlaces, (double)value);
+    copy(buf, strlen(buf));
+}
+
+String::String(double value, unsigned int decimalPlaces) : buffer(nullptr), capacity(0), len(0) {
+    char buf[48];
+    snprintf(buf, sizeof(buf), "%.*f", (int)decimalPlaces, value);
+    copy(buf, strlen(buf));
+}
+
+String::~String() { free(buffer); }
+
+bool String::reserve(unsigned int size) {
+    if (buffer && capacity >= size) return true;
+    char* grown = (char*)realloc(buffer, size + 1);
+    if (!grown) return false;
+    if (!buffer) grown[0] = 0;
+    buffer = grown;
+    capacity = size;
+    return true;
+}
+
+void String::copy(const char* cstr, unsigned int length) {
+    if (!reserve(length)) return;
+    memmove(buffer, cstr, length);
+    buffer[length] = 0;
+    len = length;
+}
+
+String& String::operator=(const String& rhs) {
+    if (this != &rhs) copy(rhs.c_str(), rhs.len);
+    return *this;
+}
+
+String& String::operator=(const char* cstr) {
+    copy(cstr ? cstr : "", cstr ? strlen(cstr) : 0);
+    return *this;
+}
+
+bool String::concat(const char* cstr, unsigned int length) {
+    if (!cstr) return false;
+    if (length == 0) return true;
+    if (!reserve(len + length)) return false;
+    memmove(buffer + len, cstr, length);
+    len += length;
+    buffer[len] = 0;
+    return true;
+}
+
+bool String::concat(const String& s) {
+    // Self-concatenation: copy the length before reserve() moves the buffer
+    if (&s == this) {
+        unsigned int n = len;
+        if (!reserve(len * 2)) return false;
+        memcpy(buffer + n, buffer, n);
+        len = n * 2;
+        buffer[len] = 0;
+        return true;
+    }
+    return concat(s.c_str(), s.len);
+}
+
+bool String::concat(const char* cstr) { return cstr ? concat(cstr, strlen(cstr)) : false; }
+bool String::concat(char c) { return concat(&c, 1); }
+
+bool String::equals(const String& s) const { return len == s.len && memcmp(c_str(), s.c_str(), len) == 0; }
+bool String::equals(const char* cstr) const { return strcmp(c_str(), cstr ? cstr : "") == 0; }
+
+bool String::startsWith(const String& prefix) const {
+    return prefix.len <= len && strncmp(c_str(), prefix.c_str(), prefix.len) == 0;
+}
+
+bool String::endsWith(const String& suffix) const {
+    return suffix.len <= len && strcmp(c_str() + len - suffix.len, suffix.c_str()) == 0;
+}
+
+int String::indexOf(char ch, unsigned int fromIndex) const {
+    if (fromIndex >= len) return -1;
+    const char* hit = strchr(c_str() + fromIndex, ch);
+    return hit ? (int)(hit - c_str()) : -1;
+}
+
+char String::charAt(unsigned int index) const { return index < len ? buffer[index] : 0; }
+
+String String::substring(unsigned int beginIndex, unsigned int endIndex) const {
+    if (beginIndex > endIndex) {
+        unsigned int t = beginIndex;
+        beginIndex = endIndex;
+        endIndex = t;
+    }
+    String out;
+    if (beginIndex >= len) return out;
+    if (endIndex > len) endIndex = len;
+    out.copy(c_str() + beginIndex, endIndex - beginIndex);
+    return out;
+}
+
+void String::trim() {
+    if (!buffer || len == 0) return;
+    unsigned int begin = 0;
+    while (begin < len && isspace((unsigned char)buffer[begin])) begin++;
+    unsigned int end = len;
+    while (end > begin && isspace((unsigned char)buffer[end - 1])) end--;
+    len = end - begin;
+    if (begin > 0) memmove(buffer, buffer + begin, len);
+    buffer[len] = 0;
+}
+
+void String::toLowerCase() {
+    for (unsigned int i = 0; i < len; i++) buffer[i] = (char)tolower((unsigned char)buffer[i]);
+}
+
+void String::toUpperCase() {
+    for (unsigned int i = 0; i < len; i++) buffer[i] = (char)toupper((unsigned char)buffer[i]);
+}
+
+long String::toInt() const { return atol(c_str()); }
+float String::toFloat() const { return (float)atof(c_str()); }
+
+String operator+(const String& lhs, const String& rhs) {
+    String out(lhs);
+    out.concat(rhs);
+    return out;
+}
+
+String operator+(const String& lhs, const char* rhs) {
+    String out(lhs);
+    out.concat(rhs);
+    return out;
+}
+
+String operator+(const char* lhs, const String& rhs) {
+    String out(lhs);
+    out.concat(rhs);
+    return out;
+}
+
+String operator+(const String& lhs, char rhs) {
+    String out(lhs);
+    out.concat(rhs);
+    return out;
+}
+
+// ============================================================================
+// PRINT / STREAM
+// ============================================================================
+
+size_t Print::write(const uint8_t* buffer, size_t size) {
+    size_t n = 0;
+    while (size--) n += write(*buffer++);
+    return n;
+}
+
+size_t Print::print(long n, int base) {
+    char buf[36];
+    bool neg = n < 0 && base == 10;
+    formatInteger(buf, sizeof(buf), neg ? (unsigned long)(-n) : (unsigned long)n, neg, (unsigned char)base);
+    return write(buf);
+}
+
+size_t Print::print(unsigned long n, int base) {
+    char buf[36];
+    formatInteger(buf, sizeof(buf), n, false, (unsigned char)base);
+    return write(buf);
+}
+
+size_t Print::print(double n, int digits) {
+    char buf[48];
+    snprintf(buf, sizeof(buf), "%.*f", digits, n);
+    return write(buf);
+}
+
+// Same strategy as the ESP32 core: 64-byte stack buffer, heap when longer
+size_t Print::printf(const char* format, ...) {
+    char loc_buf[64];
+    char* temp = loc_buf;
+    va_list arg;
+    va_start(arg, format);
+    int len = vsnprintf(temp, sizeof(loc_buf), format, arg);
+    va_end(arg);
+    if (len < 0) return 0;
+    if (len >= (int)sizeof(loc_buf)) {
+        temp = (char*)malloc(len + 1);
+        if (!temp) return 0;
+        va_start(arg, format);
+        vsnprintf(temp, len + 1, format, arg);
+        va_end(arg);
+    }
+    size_t n = write((const uint8_t*)temp, len);
+    if (temp != loc_buf) free(temp);
+    return n;
+}
+
+int Stream::timedRead() {
+    unsigned long start = millis();
+    do {
+        int c = read();
+        if (c >= 0) return c;
+        // Only paced input (hostSerialInputPaced) arrives while we spin
+        delay(1);
+    } while (millis() - start < timeoutMs);
+    return -1;
+}
+
+size_t Stream::readBytes(uint8_t* buffer, size_t length) {
+    size_t count = 0;
+    while (count < length) {
+        int c = timedRead();
+        if (c < 0) break;
+        buffer[count++] = (uint8_t)c;
+    }
+    return count;
+}
+
+String Stream::readStringUntil(char terminator) {
+    String ret;
+    int c = timedRead();
+    while (c >= 0 && c != terminator) {
+        ret += (char)c;
+        c = timedRead();
+    }
+    return ret;
+}
+
+// ============================================================================
+// SERIAL
+// ============================================================================
+
+HardwareSerial Serial;
+
+static bool serialEcho = true;
+static bool serialBlocking = true;
+static std::atomic<uint64_t> serialBytesOut(0);
+static std::deque<uint8_t> serialRx;
+static std::deque<std::pair<uint64_t, uint8_t> > serialRxPaced;    // Arrival time, byte
+static std::mutex serialRxLock;
+static std::mutex serialTxLock;     // The UART driver's lock: logs and the command echo share the port
+
+void hostSerialEcho(bool enabled) { serialEcho = enabled; }
+void hostSerialBlockingModel(bool enabled) { serialBlocking = enabled; }
+uint64_t hostSerialBytesOut() { return serialBytesOut.load(); }
+
+void hostSerialInput(const char* data, size_t len) {
+    std::lock_guard<std::mutex> guard(serialRxLock);
+    serialRx.insert(serialRx.end(), (const uint8_t*)data, (const uint8_t*)data + len);
+}
+
+void hostSerialInputPaced(const char* data, size_t len, uint32_t bytesPerSecond, uint64_t startMicros) {
+    std::lock_guard<std::mutex> guard(serialRxLock);
+    uint64_t at = startMicros > hostClockMicros() ? startMicros : hostClockMicros();
+    if (!serialRxPaced.empty() && serialRxPaced.back().first > at) at = serialRxPaced.back().first;
+    for (size_t i = 0; i < len; i++) {
+        at += 1000000ULL / (bytesPerSecond ? bytesPerSecond : 1);
+        serialRxPaced.push_back(std::make_pair(at, (uint8_t)data[i]));
+    }
+}
+
+size_t hostSerialInputPending() {
+    std::lock_guard<std::mutex> guard(serialRxLock);
+    return serialRx.size() + serialRxPaced.size();
+}
+
+// Paced bytes whose time has come join the RX buffer (caller holds the lock)
+static void serialRxArrive() {
+    if (serialRxPaced.empty()) return;
+    HostAllocPause pause;           // The driver's ring, not the firmware's heap
+    uint64_t now = hostClockMicros();
+    while (!serialRxPaced.empty() && serialRxPaced.front().first <= now) {
+        serialRx.push_back(serialRxPaced.front().second);
+        serialRxPaced.pop_front();
+    }
+}
+
+int HardwareSerial::available() {
+    std::lock_guard<std::mutex> guard(serialRxLock);
+    serialRxArrive();
+    return (int)serialRx.size();
+}
+
+int HardwareSerial::read() {
+    std::lock_guard<std::mutex> guard(serialRxLock);
+    serialRxArrive();
+    if (serialRx.empty()) return -1;
+    int c = serialRx.front();
+    serialRx.pop_front();
+    return c;
+}
+
+int HardwareSerial::peek() {
+    std::lock_guard<std::mutex> guard(serialRxLock);
+    serialRxArrive();
+    return serialRx.empty() ? -1 : serialRx.front();
+}
+
+size_t HardwareSerial::write(uint8_t c) { return write(&c, 1); }
+
+static const size_t UART_FIFO_SIZE = 128;
+
+// Bits leave the wire at the baud rate whether or not anyone is waiting
+void HardwareSerial::drainTx() {
+    uint64_t now = hostClockMicros();
+    if (baudRate > 0 && now > txDrainedAtUs) {
+        uint64_t sent = (now - txDrainedAtUs) * baudRate / 10ULL / 1000000ULL;
+        if (sent > 0) {
+            txQueued = sent >= txQueued ? 0 : txQueued - sent;
+            txDrainedAtUs += sent * 10ULL * 1000000ULL / baudRate;
+        }
+    }
+    if (txQueued == 0) txDrainedAtUs = now;
+}
+
+int HardwareSerial::availableForWrite() {
+    if (!serialBlocking) return (int)(UART_FIFO_SIZE + txBufferSize);
+    std::lock_guard<std::mutex> guard(serialTxLock);
+    drainTx();
+    uint64_t capacity = UART_FIFO_SIZE + txBufferSize;
+    return txQueued >= capacity ? 0 : (int)(capacity - txQueued);
+}
+
+void HardwareSerial::flush() {
+    if (!serialBlocking || baudRate == 0) return;
+    std::lock_guard<std::mutex> guard(serialTxLock);
+    drainTx();
+    hostClockAdvanceMicros(txQueued * 10ULL * 1000000ULL / baudRate);
+    txQueued = 0;
+    txDrainedAtUs = hostClockMicros();
+}
+
+size_t HardwareSerial::write(const uint8_t* buffer, size_t size) {
+    std::lock_guard<std::mutex> guard(serialTxLock);
+    serialBytesOut.fetch_add(size);
+    if (serialEcho) fwrite(buffer, 1, size, stdout);
+    if (serialBlocking && baudRate > 0) {
+        drainTx();
+        uint64_t capacity = UART_FIFO_SIZE + txBufferSize;
+        txQueued += size;
+        if (txQueued > capacity) {
+            // Caller spins until the excess has been shifted out
+            uint64_t excess = txQueued - capacity;
+            hostClockAdvanceMicros(excess * 10ULL * 1000000ULL / baudRate);
+            drainTx();
+        }
+    }
+    return size;
+}
+
+// ============================================================================
+// IPADDRESS
+// ============================================================================
+
+String IPAddress::toString() const {
+    char buf[16];
+    snprintf(buf, sizeof(buf), "%u.%u.%u.%u", (*this)[0], (*this)[1], (*this)[2], (*this)[3]);
+    return String(buf);
+}
+
+size_t IPAddress::printTo(Print& p) const {
+    char buf[16];
+    snprintf(buf, sizeof(buf), "%u.%u.%u.%u", (*this)[0], (*this)[1], (*this)[2], (*this)[3]);
+    return p.print(buf);
+}
+
+// ============================================================================
+// ESP
+// ============================================================================
+
+// Same budget as the ESP32-S3 internal heap / 8MB OPI PSRAM
+static const uint32_t HOST_HEAP_SIZE = 320 * 1024;
+static const uint32_t HOST_PSRAM_SIZE = 8 * 1024 * 1024;
+
+EspClass ESP;
+
+uint32_t EspClass::getHeapSize() { return HOST_HEAP_SIZE; }
+
+uint32_t EspClass::getFreeHeap() {
+    int64_t live = hostAllocStats().liveBytes;
+    return live >= HOST_HEAP_SIZE ? 0 : HOST_HEAP_SIZE - (uint32_t)live;
+}
+
+uint32_t EspClass::getMinFreeHeap() {
+    int64_t peak = hostAllocStats().peakLiveBytes;
+    return peak >= HOST_HEAP_SIZE ? 0 : HOST_HEAP_SIZE - (uint32_t)peak;
+}
+
+uint32_t EspClass::getMaxAllocHeap() { return getFreeHeap(); }
+uint32_t EspClass::getPsramSize() { return HOST_PSRAM_SIZE; }
+uint32_t EspClass::getFreePsram() { return HOST_PSRAM_SIZE - (uint32_t)hostAllocStats().psramLiveBytes; }
+uint32_t EspClass::getMinFreePsram() { return HOST_PSRAM_SIZE - (uint32_t)hostAllocStats().psramPeakBytes; }
+
+void EspClass::restart() {
+    fflush(stdout);
+    exit(0);
+}
+
+// ============================================================================
+// RESET
+// ============================================================================
+
+void hostReset() {
+    hostClockRealtime(0);
+    hostClockReset(0);
+    hostTimersStopAll();
+    hostDeepSleepReset();
+    timerLatencyMax = 0;
+    environment.temp = 25.0f;
+    environment.humidity = 50.0f;
+    environment.lux = 8000.0f;
+    environment.dust = 50.0f;
+    memset(pinLevel, 0, sizeof(pinLevel));
+    memset(pinChangedAt, 0, sizeof(pinChangedAt));
+    lowPins = 0;
+    dustAtSet = false;
+    adcSource = hostDustAdcModel;
+    serialBytesOut.store(0);
+    {
+        std::lock_guard<std::mutex> guard(serialRxLock);
+        serialRx.clear();
+        serialRxPaced.clear();
+    }
+    hostNetReset();
+    randomSeed(1);
+    hostBroker().reset();
+    hostDashboardEnable(true);
+    hostDashboardReset();
+    esp_camera_deinit();
+    hostCameraFailInit(false);
+    psramPresent = true;
+    hostCameraResetStats();
+    hostAllocResetPeak();
+}
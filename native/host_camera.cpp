@@ -0,0 +1,202 @@
+#include "esp_camera.h"
+#include "host_sim.h"
+#include "Arduino.h"
+#include <mutex>
+#include <vector>
+
+// Up to fb_count frames may be out at once (the driver's frame buffers), from
+// either firmware task
+#define HOST_CAMERA_MAX_FB 2
+// The sensor streams from the end of esp_camera_init() at 25 fps; frame k is
+// complete at streamStart + (k + 1) * HOST_CAMERA_FRAME_US
+#define HOST_CAMERA_FRAME_US 40000
+
+static std::vector<uint8_t> frameData;
+static bool cameraReady = false;
+static bool failInit = false;
+static uint32_t settleFrames = 2;
+static size_t frameCount = 1;
+static camera_grab_mode_t grabMode = CAMERA_GRAB_WHEN_EMPTY;
+static uint64_t streamStart = 0;
+static uint64_t poweredAt = 0;
+static uint32_t nextFrame = 0;              // Next frame index a free buffer can hold
+static bool frameOut[HOST_CAMERA_MAX_FB];
+static uint32_t slotFrame[HOST_CAMERA_MAX_FB];      // GRAB_WHEN_EMPTY: frame each buffer holds
+static camera_fb_t frames[HOST_CAMERA_MAX_FB];
+static HostCameraFrameInfo frameInfo[HOST_CAMERA_MAX_FB];
+static uint64_t frameTakenAt[HOST_CAMERA_MAX_FB];
+static framesize_t frameSize = FRAMESIZE_VGA;
+static pixformat_t frameFormat = PIXFORMAT_JPEG;
+static HostCameraStats cameraStats;
+static std::mutex cameraLock;
+
+// JPEG-shaped filler: SOI marker, pseudo-random entropy data, EOI marker
+void hostCameraSetFrameSize(size_t len) {
+    HostAllocPause pause;
+    if (len < 4) len = 4;
+    frameData.resize(len);
+    uint32_t x = 0x9E3779B9;
+    for (size_t i = 0; i < len; i++) {
+        x ^= x << 13;
+        x ^= x >> 17;
+        x ^= x << 5;
+        frameData[i] = (uint8_t)x;
+    }
+    frameData[0] = 0xFF;
+    frameData[1] = 0xD8;
+    frameData[len - 2] = 0xFF;
+    frameData[len - 1] = 0xD9;
+}
+
+void hostCameraSetFrame(const uint8_t* data, size_t len) {
+    HostAllocPause pause;
+    frameData.assign(data, data + len);
+}
+
+void hostCameraFailInit(bool fail) { failInit = fail; }
+
+void hostCameraSetSettleFrames(uint32_t frames) { settleFrames = frames; }
+
+static void frameDimensions(framesize_t size, size_t& w, size_t& h) {
+    static const uint16_t dims[][2] = {
+        {96, 96}, {160, 120}, {176, 144}, {240, 176}, {240, 240}, {320, 240}, {400, 296},
+        {480, 320}, {640, 480}, {800, 600}, {1024, 768}, {1280, 720}, {1280, 1024}, {1600, 1200}};
+    w = dims[size][0];
+    h = dims[size][1];
+}
+
+static uint64_t frameDone(uint32_t index) { return streamStart + (uint64_t)(index + 1) * HOST_CAMERA_FRAME_US; }
+
+// First frame exposed wholly after t
+static uint32_t frameStartingAfter(uint64_t t) {
+    if (t <= streamStart) return 0;
+    return (uint32_t)((t - streamStart + HOST_CAMERA_FRAME_US - 1) / HOST_CAMERA_FRAME_US);
+}
+
+// Caller holds cameraLock
+static void powerOff(uint64_t now) {
+    if (!cameraReady) return;
+    cameraReady = false;
+    cameraStats.activeMicros += now - poweredAt;
+    memset(frameOut, 0, sizeof(frameOut));
+}
+
+esp_err_t esp_camera_init(const camera_config_t* config) {
+    if (!config) return ESP_FAIL;
+    {
+        std::lock_guard<std::mutex> guard(cameraLock);
+        powerOff(hostClockMicros());
+        poweredAt = hostClockMicros();
+        cameraStats.inits++;
+    }
+    // Sensor probe + XCLK start-up
+    delay(250);
+    std::lock_guard<std::mutex> guard(cameraLock);
+    if (failInit) {
+        cameraStats.activeMicros += hostClockMicros() - poweredAt;
+        return ESP_FAIL;
+    }
+    frameSize = config->frame_size;
+    frameFormat = config->pixel_format;
+    frameCount = config->fb_count < 1 ? 1 : (config->fb_count > HOST_CAMERA_MAX_FB ? HOST_CAMERA_MAX_FB : config->fb_count);
+    grabMode = config->grab_mode;
+    if (frameData.empty()) hostCameraSetFrameSize(24 * 1024);
+    streamStart = hostClockMicros();
+    // GRAB_WHEN_EMPTY: the buffers fill with the first frames, then the
+    // sensor's output is dropped until one is returned
+    for (size_t i = 0; i < frameCount; i++) slotFrame[i] = (uint32_t)i;
+    nextFrame = grabMode == CAMERA_GRAB_WHEN_EMPTY ? (uint32_t)frameCount : 0;
+    memset(frameOut, 0, sizeof(frameOut));
+    cameraReady = true;
+    return ESP_OK;
+}
+
+esp_err_t esp_camera_deinit() {
+    std::lock_guard<std::mutex> guard(cameraLock);
+    powerOff(hostClockMicros());
+    return ESP_OK;
+}
+
+camera_fb_t* esp_camera_fb_get() {
+    size_t slot = HOST_CAMERA_MAX_FB;
+    uint32_t index = 0;
+    {
+        std::lock_guard<std::mutex> guard(cameraLock);
+        if (!cameraReady) return nullptr;
+        for (size_t i = 0; i < frameCount; i++) {
+            if (frameOut[i]) continue;
+            if (grabMode == CAMERA_GRAB_LATEST) {
+                slot = i;
+                break;
+            }
+            // Oldest buffered frame first
+            if (slot == HOST_CAMERA_MAX_FB || slotFrame[i] < slotFrame[slot]) slot = i;
+        }
+        if (slot == HOST_CAMERA_MAX_FB) return nullptr;
+        if (grabMode == CAMERA_GRAB_LATEST) {
+            // The last complete frame, or the next one if that was handed out
+            uint64_t now = hostClockMicros();
+            index = now >= frameDone(0) ? (uint32_t)((now - streamStart) / HOST_CAMERA_FRAME_US - 1) : 0;
+            if (index < nextFrame) index = nextFrame;
+            nextFrame = index + 1;
+        } else {
+            index = slotFrame[slot];
+        }
+        frameOut[slot] = true;
+    }
+    uint64_t done = frameDone(index);
+    if (done > hostClockMicros()) hostClockAdvanceMicros(done - hostClockMicros());
+    camera_fb_t& frame = frames[slot];
+    frame.buf = &frameData[0];
+    frame.len = frameData.size();
+    frameDimensions(frameSize, frame.width, frame.height);
+    frame.format = frameFormat;
+    frame.timestamp.tv_sec = (time_t)(done / 1000000ULL);
+    frame.timestamp.tv_usec = (suseconds_t)(done % 1000000ULL);
+    std::lock_guard<std::mutex> guard(cameraLock);
+    frameInfo[slot].index = index;
+    frameInfo[slot].capturedMicros = done;
+    frameInfo[slot].settled = index >= settleFrames;
+    frameTakenAt[slot] = hostClockMicros();
+    cameraStats.framesTaken++;
+    return &frame;
+}
+
+void esp_camera_fb_return(camera_fb_t* fb) {
+    if (fb < frames || fb >= frames + frameCount) return;
+    size_t slot = (size_t)(fb - frames);
+    std::lock_guard<std::mutex> guard(cameraLock);
+    if (!frameOut[slot]) return;
+    frameOut[slot] = false;
+    uint64_t now = hostClockMicros();
+    uint64_t held = now - frameTakenAt[slot];
+    cameraStats.heldMicrosTotal += held;
+    if (held > cameraStats.heldMicrosMax) cameraStats.heldMicrosMax = held;
+    if (grabMode == CAMERA_GRAB_WHEN_EMPTY) {
+        // Refilled by the first frame that starts after this
+        uint32_t index = frameStartingAfter(now);
+        slotFrame[slot] = index > nextFrame ? index : nextFrame;
+        nextFrame = slotFrame[slot] + 1;
+    }
+}
+
+HostCameraFrameInfo hostCameraFrameInfo(const camera_fb_t* fb) {
+    HostCameraFrameInfo info = {};
+    if (fb < frames || fb >= frames + HOST_CAMERA_MAX_FB) return info;
+    std::lock_guard<std::mutex> guard(cameraLock);
+    return frameInfo[fb - frames];
+}
+
+HostCameraStats hostCameraStats() {
+    std::lock_guard<std::mutex> guard(cameraLock);
+    HostCameraStats stats = cameraStats;
+    if (cameraReady) stats.activeMicros += hostClockMicros() - poweredAt;
+    stats.powered = cameraReady;
+    return stats;
+}
+
+void hostCameraResetStats() {
+    std::lock_guard<std::mutex> guard(cameraLock);
+    memset(&cameraStats, 0, sizeof(cameraStats));
+    poweredAt = hostClockMicros();
+}
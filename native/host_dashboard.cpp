@@ -0,0 +1,186 @@
+// Dashboard side of the image protocol, the same policy as the Node-RED
+// "Image Assembler": ACK received ranges every few chunks and on gap fills,
+// NACK gaps as soon as they show up, ACK again on duplicates. Delta
+// containers (image_delta.h) are rebuilt into full frames like the "Camera
+// Viewer" does; a delta against a keyframe it does not have asks for "key".
+
+#include "host_sim.h"
+#include "config.h"
+#include "image_transfer.h"
+#include "checksum.h"
+#include "image_delta.h"
+#include <algorithm>
+
+#define DASHBOARD_ACK_EVERY 4
+#define DASHBOARD_MAX_RANGES 32
+
+static bool enabled = true;
+static HostDashboardStats stats;
+static bool active = false;
+static uint16_t imageId = 0;
+static uint16_t chunkCount = 0;
+static int highest = -1;
+static uint16_t received = 0;
+static std::vector<std::vector<uint8_t> > chunks;
+static std::vector<uint8_t> lastImage;
+static HostDashboardFrame keyframe;    // Deltas are only against the latest
+static HostDashboardFrame lastFrame;
+
+static inline uint16_t get16(const uint8_t* p) { return (uint16_t)(p[0] | (p[1] << 8)); }
+
+static void requestKeyframe() {
+    stats.keyframeRequests++;
+    hostBroker().publishToDevice(MQTT_TOPIC(TOPIC_CAM_REQ), (const uint8_t*)"key", 3);
+}
+
+static bool showKeyframe(uint16_t id) {
+    if (keyframe.rgb.empty() || keyframe.keyframeId != id) {
+        requestKeyframe();
+        return false;
+    }
+    lastFrame = keyframe;
+    return true;
+}
+
+// Plain JPEG, keyframe or changed tiles drawn over their keyframe
+static void onImage(const std::vector<uint8_t>& image) {
+    HostDashboardFrame frame;
+    frame.keyframeId = 0;
+    frame.kind = 0;
+    if (image.size() < DELTA_HEADER_SIZE || memcmp(&image[0], DELTA_MAGIC, 4) != 0) {
+        if (hostJpegDecode(&image[0], image.size(), &frame.rgb, &frame.width, &frame.height)) lastFrame = frame;
+        return;
+    }
+    const uint8_t* h = &image[0];
+    uint16_t id = get16(h + 6);
+    uint16_t changed = get16(h + 20);
+    size_t offset = DELTA_HEADER_SIZE + 2 * (size_t)changed;
+    if (offset >= image.size()) return;
+    if (h[5] == DELTA_KEYFRAME) {
+        frame.keyframeId = id;
+        frame.kind = DELTA_KEYFRAME;
+        if (!hostJpegDecode(h + offset, image.size() - offset, &frame.rgb, &frame.width, &frame.height)) return;
+        stats.keyframes++;
+        keyframe = frame;
+        lastFrame = frame;
+        return;
+    }
+    if (h[5] != DELTA_TILES || !showKeyframe(id)) return;
+    std::vector<uint8_t> tiles;
+    int tileW, tileH;
+    if (!hostJpegDecode(h + offset, image.size() - offset, &tiles, &tileW, &tileH)) return;
+    const int tile = get16(h + 12);
+    const int cols = h[14];
+    for (uint16_t slot = 0; slot < changed && (slot + 1) * tile <= tileH; slot++) {
+        uint16_t index = get16(h + DELTA_HEADER_SIZE + 2 * slot);
+        int x0 = (index % cols) * tile;
+        int y0 = (index / cols) * tile;
+        for (int y = 0; y < tile && y0 + y < lastFrame.height; y++) {
+            int n = std::min(tile, lastFrame.width - x0);
+            if (n <= 0) break;
+            memcpy(&lastFrame.rgb[((size_t)(y0 + y) * lastFrame.width + x0) * 3],
+                   &tiles[((size_t)(slot * tile + y) * tileW) * 3], (size_t)n * 3);
+        }
+    }
+    lastFrame.kind = DELTA_TILES;
+    stats.deltas++;
+}
+
+static void onControl(const uint8_t* payload, size_t len) {
+    std::string json((const char*)payload, len);
+    if (json.find("\"status\":\"unchanged\"") == std::string::npos) return;
+    size_t at = json.find("\"key\":");
+    if (at == std::string::npos) return;
+    if (showKeyframe((uint16_t)atoi(json.c_str() + at + 6))) {
+        lastFrame.kind = DELTA_UNCHANGED;
+        stats.unchanged++;
+    }
+}
+
+static void send(uint8_t type, const ImageAckRange* ranges, uint8_t n) {
+    uint8_t out[IMG_ACK_HEADER_SIZE + 4 * DASHBOARD_MAX_RANGES];
+    size_t len = encodeImageAck(type, imageId, ranges, n, out, sizeof(out));
+    hostBroker().publishToDevice(MQTT_TOPIC(TOPIC_CAM_ACK), out, len);
+    if (type == IMG_ACK_RANGES) stats.acks++;
+    else stats.nacks++;
+}
+
+static void sendAck() {
+    ImageAckRange ranges[DASHBOARD_MAX_RANGES];
+    uint8_t n = 0;
+    for (uint16_t i = 0; i < chunkCount && n < DASHBOARD_MAX_RANGES; i++) {
+        if (chunks[i].empty()) continue;
+        if (n > 0 && ranges[n - 1].last + 1 == i) {
+            ranges[n - 1].last = i;
+        } else {
+            ranges[n].first = i;
+            ranges[n].last = i;
+            n++;
+        }
+    }
+    send(IMG_ACK_RANGES, ranges, n);
+}
+
+static void onChunk(const uint8_t* payload, size_t len) {
+    ImageChunkHeader h;
+    if (!decodeImageChunkHeader(payload, len, &h)) return;
+    if (h.flags & IMG_CHUNK_FLAG_RESEND) stats.resends++;
+    const uint8_t* data = payload + IMG_CHUNK_HEADER_SIZE;
+    size_t dataLen = len - IMG_CHUNK_HEADER_SIZE;
+    if (crc32(data, dataLen) != h.crc) {
+        stats.crcErrors++;
+        return;
+    }
+    if (!active || h.imageId != imageId) {
+        active = true;
+        imageId = h.imageId;
+        chunkCount = h.count;
+        highest = -1;
+        received = 0;
+        chunks.assign(chunkCount, std::vector<uint8_t>());
+    }
+    if (!chunks[h.index].empty()) {
+        stats.duplicates++;
+        sendAck();      // Our ACK was lost
+        return;
+    }
+    chunks[h.index].assign(data, data + dataLen);
+    received++;
+    if (h.index > highest + 1) {
+        ImageAckRange gap = {(uint16_t)(highest + 1), (uint16_t)(h.index - 1)};
+        send(IMG_NACK_RANGES, &gap, 1);
+    }
+    bool fill = h.index < highest;
+    if (h.index > highest) highest = h.index;
+
+    if (received == chunkCount) {
+        lastImage.clear();
+        for (uint16_t i = 0; i < chunkCount; i++) lastImage.insert(lastImage.end(), chunks[i].begin(), chunks[i].end());
+        stats.imagesCompleted++;
+        sendAck();
+        onImage(lastImage);
+    } else if (fill || received % DASHBOARD_ACK_EVERY == 0) {
+        sendAck();
+    }
+}
+
+void hostDashboardEnable(bool on) { enabled = on; }
+
+void hostDashboardReset() {
+    HostAllocPause pause;
+    memset(&stats, 0, sizeof(stats));
+    active = false;
+    chunks.clear();
+    lastImage.clear();
+    keyframe = HostDashboardFrame();
+    lastFrame = HostDashboardFrame();
+    hostBroker().addObserver([](const std::string& topic, const uint8_t* payload, size_t len) {
+        if (!enabled) return;
+        if (topic == MQTT_TOPIC(TOPIC_CAM_DATA)) onChunk(payload, len);
+        else if (topic == MQTT_TOPIC(TOPIC_CAM_CTRL)) onControl(payload, len);
+    });
+}
+
+HostDashboardStats hostDashboardStats() { return stats; }
+const std::vector<uint8_t>& hostDashboardLastImage() { return lastImage; }
+const HostDashboardFrame& hostDashboardLastFrame() { return lastFrame; }
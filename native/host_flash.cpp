@@ -0,0 +1,128 @@
+#include "esp_partition.h"
+#include "host_sim.h"
+#include <string.h>
+#include <algorithm>
+#include <vector>
+
+struct HostPartition {
+    esp_partition_t info;
+    std::vector<uint8_t> data;
+};
+
+static std::vector<HostPartition*> partitions;
+static HostFlashStats flashStats;
+static bool powerCut = false;
+static int64_t bytesUntilCut = -1;
+
+// ESP32-S3 QIO flash, typical datasheet figures
+static const uint32_t ERASE_SECTOR_US = 45000;
+static const uint32_t PROGRAM_SETUP_US = 40;
+
+void hostFlashAddPartition(const char* label, uint8_t subtype, size_t size) {
+    HostAllocPause pause;
+    for (size_t i = 0; i < partitions.size(); i++) {
+        if (strcmp(partitions[i]->info.label, label) == 0) {
+            partitions[i]->info.size = (uint32_t)size;
+            partitions[i]->data.assign(size, 0xFF);
+            return;
+        }
+    }
+    HostPartition* p = new HostPartition();
+    memset(&p->info, 0, sizeof(p->info));
+    p->info.type = ESP_PARTITION_TYPE_DATA;
+    p->info.subtype = subtype;
+    p->info.address = 0x610000 + 0x100000 * (uint32_t)partitions.size();
+    p->info.size = (uint32_t)size;
+    strncpy(p->info.label, label, sizeof(p->info.label) - 1);
+    p->data.assign(size, 0xFF);
+    partitions.push_back(p);
+}
+
+// Data partitions from partitions.csv, created on first lookup
+static void ensureDefaultTable() {
+    if (!partitions.empty()) return;
+    hostFlashAddPartition("offlineq", 0x40, 0x100000);
+    hostFlashAddPartition("refframe", 0x41, 0x30000);
+}
+
+void hostFlashWipe() {
+    for (size_t i = 0; i < partitions.size(); i++) {
+        std::fill(partitions[i]->data.begin(), partitions[i]->data.end(), 0xFF);
+    }
+}
+
+void hostFlashPowerCutAfter(int64_t bytes) {
+    bytesUntilCut = bytes;
+    powerCut = false;
+}
+
+bool hostFlashPowerIsCut() { return powerCut; }
+
+void hostFlashRestorePower() {
+    powerCut = false;
+    bytesUntilCut = -1;
+}
+
+HostFlashStats hostFlashStats() { return flashStats; }
+
+static HostPartition* lookup(const esp_partition_t* partition) {
+    for (size_t i = 0; i < partitions.size(); i++) {
+        if (&partitions[i]->info == partition) return partitions[i];
+    }
+    return nullptr;
+}
+
+const esp_partition_t* esp_partition_find_first(esp_partition_type_t type, esp_partition_subtype_t subtype,
+                                                const char* label) {
+    ensureDefaultTable();
+    for (size_t i = 0; i < partitions.size(); i++) {
+        esp_partition_t& info = partitions[i]->info;
+        if (info.type != type) continue;
+        if (subtype != ESP_PARTITION_SUBTYPE_ANY && info.subtype != subtype) continue;
+        if (label && strcmp(label, info.label) != 0) continue;
+        return &info;
+    }
+    return nullptr;
+}
+
+esp_err_t esp_partition_read(const esp_partition_t* partition, size_t src_offset, void* dst, size_t size) {
+    HostPartition* p = lookup(partition);
+    if (!p || !dst) return ESP_ERR_INVALID_ARG;
+    if (src_offset + size > p->data.size()) return ESP_ERR_INVALID_SIZE;
+    memcpy(dst, &p->data[src_offset], size);
+    flashStats.bytesRead += size;
+    hostClockAdvanceMicros(1 + size / 40);
+    return ESP_OK;
+}
+
+esp_err_t esp_partition_write(const esp_partition_t* partition, size_t dst_offset, const void* src, size_t size) {
+    HostPartition* p = lookup(partition);
+    if (!p || !src) return ESP_ERR_INVALID_ARG;
+    if (dst_offset + size > p->data.size()) return ESP_ERR_INVALID_SIZE;
+    if (powerCut) return ESP_FAIL;
+    const uint8_t* bytes = (const uint8_t*)src;
+    size_t n = size;
+    if (bytesUntilCut >= 0 && (int64_t)n > bytesUntilCut) {
+        n = (size_t)bytesUntilCut;
+        powerCut = true;
+    }
+    // NOR programming can only clear bits
+    for (size_t i = 0; i < n; i++) p->data[dst_offset + i] &= bytes[i];
+    if (bytesUntilCut >= 0) bytesUntilCut -= (int64_t)n;
+    flashStats.bytesWritten += n;
+    hostClockAdvanceMicros(PROGRAM_SETUP_US + n);
+    return powerCut ? ESP_FAIL : ESP_OK;
+}
+
+esp_err_t esp_partition_erase_range(const esp_partition_t* partition, size_t offset, size_t size) {
+    HostPartition* p = lookup(partition);
+    if (!p) return ESP_ERR_INVALID_ARG;
+    if (offset % SPI_FLASH_SEC_SIZE || size % SPI_FLASH_SEC_SIZE || offset + size > p->data.size()) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    if (powerCut) return ESP_FAIL;
+    memset(&p->data[offset], 0xFF, size);
+    flashStats.sectorsErased += size / SPI_FLASH_SEC_SIZE;
+    hostClockAdvanceMicros((uint64_t)ERASE_SECTOR_US * (size / SPI_FLASH_SEC_SIZE));
+    return ESP_OK;
+}
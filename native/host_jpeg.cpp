@@ -0,0 +1,188 @@
+#include "esp_jpg_decode.h"
+#include "img_converters.h"
+#include "host_sim.h"
+#include <stdio.h>
+#include <string.h>
+#include <setjmp.h>
+#include <jpeglib.h>
+#include <vector>
+
+// ============================================================================
+// JPEG (libjpeg behind the esp_jpg_decode() interface)
+// ============================================================================
+
+// TJpgDec on the S3 at 240 MHz: entropy decoding follows the coded size,
+// IDCT and colour conversion the output pixels (1/8 scale skips the IDCT)
+#define HOST_JPEG_US_BASE      800
+#define HOST_JPEG_NS_PER_BYTE  450
+#define HOST_JPEG_NS_PER_PIXEL 300
+// esp32-camera software encoder (fmt2jpg)
+#define HOST_JPEG_ENC_US_BASE      500
+#define HOST_JPEG_ENC_NS_PER_PIXEL 600
+
+struct HostJpegError {
+    jpeg_error_mgr pub;
+    jmp_buf jump;
+};
+
+static void hostJpegErrorExit(j_common_ptr cinfo) {
+    longjmp(((HostJpegError*)cinfo->err)->jump, 1);
+}
+
+static void hostJpegSilence(j_common_ptr cinfo) { (void)cinfo; }
+
+esp_err_t esp_jpg_decode(size_t len, jpg_scale_t scale, jpg_reader_cb reader, jpg_writer_cb writer, void* arg) {
+    if (!len || !reader || !writer) return ESP_FAIL;
+    hostClockAdvanceMicros(HOST_JPEG_US_BASE + (uint64_t)len * HOST_JPEG_NS_PER_BYTE / 1000);
+
+    // The device decoder works from a fixed work area; none of this is its
+    // cost. Buffers are static (per thread: both firmware tasks decode) so none
+    // is left mid-update by the longjmp.
+    HostAllocPause pause;
+    static thread_local std::vector<uint8_t> input;
+    static thread_local std::vector<uint8_t> row;
+    input.resize(len);
+    if (reader(arg, 0, &input[0], len) != len) return ESP_FAIL;
+
+    jpeg_decompress_struct cinfo;
+    HostJpegError err;
+    cinfo.err = jpeg_std_error(&err.pub);
+    err.pub.error_exit = hostJpegErrorExit;
+    err.pub.output_message = hostJpegSilence;
+    if (setjmp(err.jump)) {
+        jpeg_destroy_decompress(&cinfo);
+        return ESP_FAIL;
+    }
+    jpeg_create_decompress(&cinfo);
+    jpeg_mem_src(&cinfo, &input[0], (unsigned long)len);
+    if (jpeg_read_header(&cinfo, TRUE) != JPEG_HEADER_OK) {
+        jpeg_destroy_decompress(&cinfo);
+        return ESP_FAIL;
+    }
+    cinfo.out_color_space = JCS_RGB;
+    cinfo.scale_num = 1;
+    cinfo.scale_denom = 1u << (unsigned)scale;
+    jpeg_start_decompress(&cinfo);
+
+    uint16_t width = (uint16_t)cinfo.output_width;
+    uint16_t height = (uint16_t)cinfo.output_height;
+    bool ok = writer(arg, 0, 0, width, height, nullptr);
+    row.resize((size_t)width * 3);
+    while (ok && cinfo.output_scanline < cinfo.output_height) {
+        uint16_t y = (uint16_t)cinfo.output_scanline;
+        JSAMPROW rows[1] = {&row[0]};
+        jpeg_read_scanlines(&cinfo, rows, 1);
+        hostClockAdvanceMicros((uint64_t)width * HOST_JPEG_NS_PER_PIXEL / 1000);
+        ok = writer(arg, 0, y, width, 1, &row[0]);
+    }
+    if (ok) {
+        jpeg_finish_decompress(&cinfo);
+        ok = writer(arg, width, height, width, height, nullptr);
+    } else {
+        jpeg_abort_decompress(&cinfo);
+    }
+    jpeg_destroy_decompress(&cinfo);
+    return ok ? ESP_OK : ESP_FAIL;
+}
+
+// Compresses RGB (or BGR, as the esp32-camera RGB888 format) rows
+static std::vector<uint8_t> encode(const uint8_t* pixels, int width, int height, int quality, bool bgr) {
+    HostAllocPause pause;
+    static thread_local std::vector<uint8_t> swapped;
+    jpeg_compress_struct cinfo;
+    jpeg_error_mgr jerr;
+    cinfo.err = jpeg_std_error(&jerr);
+    jpeg_create_compress(&cinfo);
+    unsigned char* out = nullptr;
+    unsigned long outLen = 0;
+    jpeg_mem_dest(&cinfo, &out, &outLen);
+    cinfo.image_width = (JDIMENSION)width;
+    cinfo.image_height = (JDIMENSION)height;
+    cinfo.input_components = 3;
+    cinfo.in_color_space = JCS_RGB;
+    jpeg_set_defaults(&cinfo);
+    jpeg_set_quality(&cinfo, quality, TRUE);
+    jpeg_start_compress(&cinfo, TRUE);
+    swapped.resize((size_t)width * 3);
+    while (cinfo.next_scanline < cinfo.image_height) {
+        JSAMPROW row = (JSAMPROW)(pixels + (size_t)cinfo.next_scanline * width * 3);
+        if (bgr) {
+            for (int x = 0; x < width * 3; x += 3) {
+                swapped[x] = row[x + 2];
+                swapped[x + 1] = row[x + 1];
+                swapped[x + 2] = row[x];
+            }
+            row = &swapped[0];
+        }
+        jpeg_write_scanlines(&cinfo, &row, 1);
+    }
+    jpeg_finish_compress(&cinfo);
+    std::vector<uint8_t> jpeg(out, out + outLen);
+    jpeg_destroy_compress(&cinfo);
+    free(out);
+    return jpeg;
+}
+
+std::vector<uint8_t> hostJpegEncode(const uint8_t* rgb, int width, int height, int quality) {
+    return encode(rgb, width, height, quality, false);
+}
+
+bool fmt2jpg(uint8_t* src, size_t src_len, uint16_t width, uint16_t height, pixformat_t format, uint8_t quality,
+             uint8_t** out, size_t* out_len) {
+    if (!src || format != PIXFORMAT_RGB888 || src_len < (size_t)width * height * 3 || !width || !height) return false;
+    hostClockAdvanceMicros(HOST_JPEG_ENC_US_BASE + (uint64_t)width * height * HOST_JPEG_ENC_NS_PER_PIXEL / 1000);
+    std::vector<uint8_t> jpeg = encode(src, width, height, quality, true);
+    *out = (uint8_t*)hostPsramAlloc(jpeg.size());
+    if (!*out) return false;
+    memcpy(*out, &jpeg[0], jpeg.size());
+    *out_len = jpeg.size();
+    return true;
+}
+
+bool fmt2jpg_cb(uint8_t* src, size_t src_len, uint16_t width, uint16_t height, pixformat_t format, uint8_t quality,
+                jpg_out_cb cb, void* arg) {
+    if (!src || !cb || format != PIXFORMAT_RGB888 || src_len < (size_t)width * height * 3 || !width || !height) {
+        return false;
+    }
+    hostClockAdvanceMicros(HOST_JPEG_ENC_US_BASE + (uint64_t)width * height * HOST_JPEG_ENC_NS_PER_PIXEL / 1000);
+    HostAllocPause pause;
+    std::vector<uint8_t> jpeg = encode(src, width, height, quality, true);
+    // The encoder hands its output over in pieces of its work buffer
+    for (size_t at = 0; at < jpeg.size(); at += 1024) {
+        size_t n = jpeg.size() - at < 1024 ? jpeg.size() - at : 1024;
+        if (cb(arg, at, &jpeg[at], n) != n) return false;
+    }
+    return true;
+}
+
+// Receiving side (dashboard): no device cost
+bool hostJpegDecode(const uint8_t* jpeg, size_t len, std::vector<uint8_t>* rgb, int* width, int* height) {
+    HostAllocPause pause;
+    jpeg_decompress_struct cinfo;
+    HostJpegError err;
+    cinfo.err = jpeg_std_error(&err.pub);
+    err.pub.error_exit = hostJpegErrorExit;
+    err.pub.output_message = hostJpegSilence;
+    if (setjmp(err.jump)) {
+        jpeg_destroy_decompress(&cinfo);
+        return false;
+    }
+    jpeg_create_decompress(&cinfo);
+    jpeg_mem_src(&cinfo, jpeg, (unsigned long)len);
+    if (jpeg_read_header(&cinfo, TRUE) != JPEG_HEADER_OK) {
+        jpeg_destroy_decompress(&cinfo);
+        return false;
+    }
+    cinfo.out_color_space = JCS_RGB;
+    jpeg_start_decompress(&cinfo);
+    *width = (int)cinfo.output_width;
+    *height = (int)cinfo.output_height;
+    rgb->resize((size_t)*width * *height * 3);
+    while (cinfo.output_scanline < cinfo.output_height) {
+        JSAMPROW row = &(*rgb)[(size_t)cinfo.output_scanline * *width * 3];
+        jpeg_read_scanlines(&cinfo, &row, 1);
+    }
+    jpeg_finish_decompress(&cinfo);
+    jpeg_destroy_decompress(&cinfo);
+    return true;
+}
@@ -0,0 +1,133 @@
+// Arduino-style runner for the native build: setup() once, then loop()
+// forever on the virtual clock. stdin is forwarded to Serial so the
+// simulator commands work from a terminal. With RUNTIME_DUAL_CORE the
+// network task is a second thread, so the clock follows the wall clock
+// (HOST_FAST_SCALE times faster with --fast). With ENABLE_DEEP_SLEEP each
+// sleep skips ahead on the clock and setup() runs again on the wake-up.
+//
+// --replay runs the digital twin instead (host_twin.cpp): a CSV trace, or a
+// generated one, through setup()/loop() as fast as the host goes. Alerts and
+// mode changes (and with --publishes every publish) go to --events as JSON
+// lines, the summary and the simulated days per second to stdout.
+//
+//   .pio/build/native/program [--fast] [--seconds N]
+//   .pio/build/native/program --replay trace.csv|synthetic [--days N] [--start-day D] [--seed S]
+//                             [--step-ms N] [--events file|-] [--publishes]
+
+#ifndef ARGUS_HOST_NO_MAIN
+
+#include "Arduino.h"
+#include "host_sim.h"
+#include "runtime.h"
+#include <chrono>
+#include <thread>
+#include <fcntl.h>
+#include <unistd.h>
+
+#define HOST_FAST_SCALE 20
+
+void setup();
+void loop();
+
+static void pumpStdin() {
+    char buf[256];
+    ssize_t n = ::read(STDIN_FILENO, buf, sizeof(buf));
+    if (n > 0) hostSerialInput(buf, (size_t)n);
+}
+
+static int replay(int argc, char** argv) {
+    if (RUNTIME_DUAL_CORE || ENABLE_SIMULATOR) {
+        printf("--replay needs the single-task build on the stand-in sensors: pio run -e twin\n");
+        return 2;
+    }
+    HostTwinOptions options = hostTwinDefaults();
+    const char* source = nullptr;
+    const char* eventsPath = nullptr;
+    for (int i = 1; i < argc; i++) {
+        bool more = i + 1 < argc;
+        if (strcmp(argv[i], "--replay") == 0 && more) source = argv[++i];
+        else if (strcmp(argv[i], "--days") == 0 && more) options.seconds = strtod(argv[++i], nullptr) * 86400.0;
+        else if (strcmp(argv[i], "--start-day") == 0 && more) options.startDay = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--seed") == 0 && more) options.seed = (uint32_t)strtoul(argv[++i], nullptr, 10);
+        else if (strcmp(argv[i], "--step-ms") == 0 && more) options.stepMs = (uint32_t)strtoul(argv[++i], nullptr, 10);
+        else if (strcmp(argv[i], "--events") == 0 && more) eventsPath = argv[++i];
+        else if (strcmp(argv[i], "--publishes") == 0) options.publishes = true;
+    }
+    if (!source || !options.stepMs) {
+        printf("--replay needs a trace (CSV or 'synthetic') and --step-ms > 0\n");
+        return 2;
+    }
+    std::vector<HostTraceRow> trace;
+    if (strcmp(source, "synthetic") != 0) {
+        std::string error;
+        if (!hostTraceLoad(source, &trace, &error)) {
+            printf("%s: %s\n", source, error.c_str());
+            return 2;
+        }
+        options.trace = &trace;
+    } else if (options.seconds <= 0) {
+        options.seconds = 30 * 86400.0;
+    }
+    FILE* events = nullptr;
+    if (eventsPath) {
+        events = strcmp(eventsPath, "-") == 0 ? stdout : fopen(eventsPath, "w");
+        if (!events) {
+            printf("Cannot write %s\n", eventsPath);
+            return 2;
+        }
+        options.events = events;
+    }
+
+    HostTwinStats stats = hostTwinRun(options);
+    if (events && events != stdout) fclose(events);
+    double days = stats.simSeconds / 86400.0;
+    printf("Replayed %.2f days (%s) in %.2f s: %.1f simulated days/s, %llu loop() passes\n", days, source,
+           stats.wallSeconds, stats.wallSeconds > 0 ? days / stats.wallSeconds : 0,
+           (unsigned long long)stats.passes);
+    printf("  mode changes %u, alerts raised %u / cleared %u, publishes %llu (%llu bytes), deep sleeps %u\n",
+           stats.modeChanges, stats.alertsRaised, stats.alertsCleared, (unsigned long long)stats.publishes,
+           (unsigned long long)stats.publishBytes, stats.sleeps);
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--replay") == 0) return replay(argc, argv);
+    }
+    bool fast = false;
+    uint64_t stopAfterMs = 0;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--fast") == 0) fast = true;
+        else if (strcmp(argv[i], "--seconds") == 0 && i + 1 < argc) stopAfterMs = strtoull(argv[++i], nullptr, 10) * 1000ULL;
+    }
+    fcntl(STDIN_FILENO, F_SETFL, fcntl(STDIN_FILENO, F_GETFL) | O_NONBLOCK);
+    setvbuf(stdout, nullptr, _IOLBF, 0);
+
+    hostReset();
+    if (RUNTIME_DUAL_CORE) hostClockRealtime(fast ? HOST_FAST_SCALE : 1);
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    setup();
+    for (;;) {
+        pumpStdin();
+        loop();
+        if (hostDeepSleepPending()) {
+            // Deep sleep: the clock jumps to the wake-up, which boots again
+            hostDeepSleepWake();
+            setup();
+            continue;
+        }
+        hostClockAdvanceMs(1);
+        if (stopAfterMs && millis() >= stopAfterMs) break;
+        if (!fast && !RUNTIME_DUAL_CORE) {
+            // Keep virtual time from running ahead of the wall clock
+            std::chrono::microseconds ahead(hostClockMicros());
+            std::chrono::steady_clock::time_point due = start + ahead;
+            if (due > std::chrono::steady_clock::now()) std::this_thread::sleep_until(due);
+        }
+    }
+    runtimeStop();
+    hostTasksJoin();
+    return 0;
+}
+
+#endif
@@ -0,0 +1,826 @@
+#include "WiFi.h"
+#include "WiFiClientSecure.h"
+#include "esp_sntp.h"
+#include "esp_timer.h"
+#include "esp_netif.h"
+#include "lwip/dhcp.h"
+#include "lwip/dns.h"
+#include "host_sim.h"
+#include <mutex>
+
+// ============================================================================
+// NETWORK MODEL
+// ============================================================================
+
+HostNetModel hostNetDefaults() {
+    HostNetModel m;
+    m.wifiAvailable = true;
+    m.brokerAvailable = true;
+    m.wifiScanMs = 2200;
+    m.wifiAssocMs = 350;
+    m.dhcpMs = 600;
+    m.dnsMs = 120;
+    m.tlsHandshakeMs = 900;
+    m.ntpMs = 400;
+    m.leaseS = 43200;
+    m.connectFailMs = 0;
+    m.apChannel = 6;
+    m.linkLatencyMs = 0;
+    m.linkBytesPerMs = 0;
+    m.lossPercent = 0;
+    m.dropPercent = 0;
+    return m;
+}
+
+static HostNetModel netModel = hostNetDefaults();
+HostNetModel& hostNet() { return netModel; }
+
+// Blocking socket send: the caller waits until the bytes left the radio
+static void chargeLink(size_t bytes) {
+    if (netModel.linkBytesPerMs > 0) {
+        hostClockAdvanceMicros((uint64_t)bytes * 1000ULL / netModel.linkBytesPerMs);
+    }
+}
+
+// Deterministic loss pattern so runs are reproducible
+static uint32_t lossState = 0x2545F491;
+static bool lossRoll() {
+    if (netModel.lossPercent == 0) return false;
+    lossState ^= lossState << 13;
+    lossState ^= lossState >> 17;
+    lossState ^= lossState << 5;
+    return (lossState % 100) < netModel.lossPercent;
+}
+
+static uint32_t dropState = 0x6C078965;
+static bool dropRoll() {
+    if (netModel.dropPercent == 0) return false;
+    dropState ^= dropState << 13;
+    dropState ^= dropState >> 17;
+    dropState ^= dropState << 5;
+    return (dropState % 100) < netModel.dropPercent;
+}
+
+// ============================================================================
+// WIFI
+// ============================================================================
+
+WiFiClass WiFi;
+
+static const uint8_t hostBssid[6] = {0x02, 0x41, 0x52, 0x47, 0x55, 0x53};
+static unsigned long linkReadyAtMs = 0;     // For the SNTP model
+static bool staDhcp = true;                 // For the DHCP lease (esp_netif.h)
+
+wl_status_t WiFiClass::begin(const char* ssid, const char* passphrase, int32_t channel,
+                             const uint8_t* bssid, bool connect) {
+    (void)ssid;
+    (void)passphrase;
+    if (!connect) return WL_DISCONNECTED;
+    started = true;
+    // Association happens in the background; status() flips when it is done.
+    // A channel/BSSID hint that does not match the AP never associates.
+    unsigned long cost = netModel.wifiAssocMs;
+    if (channel == 0 || bssid == nullptr) cost += netModel.wifiScanMs;
+    if (!staticIp) cost += netModel.dhcpMs;
+    bool found = (channel == 0 || channel == netModel.apChannel) &&
+                 (bssid == nullptr || memcmp(bssid, hostBssid, sizeof(hostBssid)) == 0);
+    readyAtMs = found ? millis() + cost : (unsigned long)-1;
+    linkReadyAtMs = readyAtMs;
+    return WL_DISCONNECTED;
+}
+
+bool WiFiClass::config(IPAddress localIP, IPAddress gateway, IPAddress subnet,
+                       IPAddress dns1, IPAddress dns2) {
+    (void)gateway;
+    (void)subnet;
+    (void)dns1;
+    (void)dns2;
+    staticIp = ((uint32_t)localIP != 0);
+    staDhcp = !staticIp;
+    return true;
+}
+
+bool WiFiClass::disconnect(bool wifioff, bool eraseap) {
+    (void)wifioff;
+    (void)eraseap;
+    started = false;
+    linkReadyAtMs = (unsigned long)-1;
+    return true;
+}
+
+bool WiFiClass::reconnect() {
+    begin(nullptr, nullptr, channel(), BSSID());
+    return true;
+}
+
+wl_status_t WiFiClass::status() {
+    if (!started) return WL_DISCONNECTED;
+    if (!netModel.wifiAvailable) return WL_NO_SSID_AVAIL;
+    return (millis() >= readyAtMs) ? WL_CONNECTED : WL_DISCONNECTED;
+}
+
+int WiFiClass::hostByName(const char* host, IPAddress& result) {
+    (void)host;
+    if (status() != WL_CONNECTED) return 0;
+    hostClockAdvanceMs(netModel.dnsMs);
+    result = IPAddress(192, 168, 1, 10);
+    return 1;
+}
+
+IPAddress WiFiClass::localIP() { return status() == WL_CONNECTED ? IPAddress(192, 168, 1, 50) : IPAddress(); }
+IPAddress WiFiClass::gatewayIP() { return IPAddress(192, 168, 1, 1); }
+IPAddress WiFiClass::subnetMask() { return IPAddress(255, 255, 255, 0); }
+IPAddress WiFiClass::dnsIP(uint8_t index) { (void)index; return IPAddress(192, 168, 1, 1); }
+int32_t WiFiClass::channel() { return netModel.apChannel; }
+uint8_t* WiFiClass::BSSID() { return (uint8_t*)hostBssid; }
+int8_t WiFiClass::RSSI() { return -61; }
+
+static struct dhcp staLease;
+static struct netif staNetif = {&staLease};
+
+esp_netif_t* esp_netif_get_handle_from_ifkey(const char* if_key) {
+    return strcmp(if_key, "WIFI_STA_DEF") == 0 ? (esp_netif_t*)&staNetif : nullptr;
+}
+
+void* esp_netif_get_netif_impl(esp_netif_t* esp_netif) {
+    uint32_t t1 = staDhcp && WiFi.status() == WL_CONNECTED ? netModel.leaseS : 0;
+    staLease.offered_t0_lease = t1 * 2;
+    staLease.offered_t1_renew = t1;
+    staLease.offered_t2_rebind = t1 * 7 / 4;
+    return esp_netif;
+}
+
+// ============================================================================
+// SNTP AND ASYNC DNS
+// ============================================================================
+
+static bool sntpStarted = false;
+static unsigned long sntpStartMs = 0;
+
+void configTime(long gmtOffset_sec, int daylightOffset_sec, const char* server1,
+                const char* server2, const char* server3) {
+    (void)gmtOffset_sec;
+    (void)daylightOffset_sec;
+    (void)server1;
+    (void)server2;
+    (void)server3;
+    sntpStarted = true;
+    sntpStartMs = millis();
+}
+
+sntp_sync_status_t sntp_get_sync_status(void) {
+    if (!sntpStarted || WiFi.status() != WL_CONNECTED) return SNTP_SYNC_STATUS_RESET;
+    unsigned long from = linkReadyAtMs > sntpStartMs ? linkReadyAtMs : sntpStartMs;
+    if (millis() - from < netModel.ntpMs) return SNTP_SYNC_STATUS_RESET;
+    sntpStarted = false;
+    return SNTP_SYNC_STATUS_COMPLETED;
+}
+
+// One query in flight, answered by a one-shot timer
+static esp_timer_handle_t dnsTimer = nullptr;
+static dns_found_callback dnsFound = nullptr;
+static void* dnsArg = nullptr;
+static const char* dnsName = nullptr;
+
+static void dnsAnswer(void* arg) {
+    (void)arg;
+    dns_found_callback found = dnsFound;
+    dnsFound = nullptr;
+    if (!found) return;
+    ip_addr_t addr;
+    memset(&addr, 0, sizeof(addr));
+    ip_2_ip4(&addr)->addr = (uint32_t)IPAddress(192, 168, 1, 10);
+    found(dnsName, WiFi.status() == WL_CONNECTED ? &addr : nullptr, dnsArg);
+}
+
+err_t dns_gethostbyname(const char* hostname, ip_addr_t* addr, dns_found_callback found, void* callback_arg) {
+    (void)addr;
+    if (!hostname || !found) return ERR_VAL;
+    if (WiFi.status() != WL_CONNECTED) return ERR_CONN;
+    if (dnsFound) return ERR_INPROGRESS;    // Answered with the first query
+    if (!dnsTimer) {
+        HostAllocPause pause;
+        esp_timer_create_args_t args = {};
+        args.callback = dnsAnswer;
+        args.name = "dns";
+        esp_timer_create(&args, &dnsTimer);
+    }
+    dnsFound = found;
+    dnsArg = callback_arg;
+    dnsName = hostname;
+    esp_timer_start_once(dnsTimer, (uint64_t)netModel.dnsMs * 1000ULL);
+    return ERR_INPROGRESS;
+}
+
+// ============================================================================
+// SOCKETS
+// ============================================================================
+
+int WiFiClient::connect(IPAddress ip, uint16_t port) {
+    (void)ip;
+    (void)port;
+    stop();
+    if (WiFi.status() != WL_CONNECTED) return 0;
+    if (!netModel.brokerAvailable) {
+        hostBroker().connectsRefused++;
+        hostClockAdvanceMs(netModel.connectFailMs);     // Until the connect times out
+        return 0;
+    }
+    hostClockAdvanceMs(2 * netModel.linkLatencyMs);   // SYN / SYN-ACK
+    open = true;
+    hostBroker().wireOpen(this);
+    return 1;
+}
+
+int WiFiClient::connect(const char* host, uint16_t port) {
+    IPAddress ip;
+    if (!WiFi.hostByName(host, ip)) return 0;
+    return WiFiClient::connect(ip, port);
+}
+
+void WiFiClient::stop() {
+    if (open) hostBroker().wireClosed(this);
+    open = false;
+}
+
+uint8_t WiFiClient::connected() {
+    return open && WiFi.status() == WL_CONNECTED && netModel.brokerAvailable && hostBroker().wireConnected(this);
+}
+
+size_t WiFiClient::write(const uint8_t* buf, size_t size) {
+    if (!connected()) return 0;
+    bytesWritten += size;
+    chargeLink(size);
+    hostBroker().wireReceive(this, buf, size);
+    return size;
+}
+
+int WiFiClient::available() { return connected() ? (int)hostBroker().wireAvailable(this) : 0; }
+
+int WiFiClient::read() {
+    uint8_t c;
+    return read(&c, 1) == 1 ? c : -1;
+}
+
+int WiFiClient::read(uint8_t* buf, size_t size) {
+    if (!connected()) return -1;
+    return (int)hostBroker().wireRead(this, buf, size);
+}
+
+int WiFiClient::peek() {
+    uint8_t c;
+    return connected() && hostBroker().wireRead(this, &c, 1, true) == 1 ? c : -1;
+}
+
+bool WiFiClientSecure::handshake() {
+    hostClockAdvanceMs(netModel.tlsHandshakeMs);
+    return true;
+}
+
+int WiFiClientSecure::connect(IPAddress ip, uint16_t port) {
+    if (!WiFiClient::connect(ip, port)) return 0;
+    return handshake() ? 1 : 0;
+}
+
+int WiFiClientSecure::connect(IPAddress ip, uint16_t port, const char* host, const char* rootCA,
+                              const char* cert, const char* key) {
+    (void)host;
+    (void)rootCA;
+    (void)cert;
+    (void)key;
+    return connect(ip, port);
+}
+
+int WiFiClientSecure::connect(const char* host, uint16_t port) {
+    IPAddress ip;
+    if (!WiFi.hostByName(host, ip)) return 0;
+    return connect(ip, port);
+}
+
+int WiFiClientSecure::lastError(char* buf, const size_t size) {
+    if (buf && size) snprintf(buf, size, "%s", netModel.brokerAvailable ? "none" : "connection refused");
+    return netModel.brokerAvailable ? 0 : -1;
+}
+
+void hostNetReset() {
+    netModel = hostNetDefaults();
+    WiFi.disconnect();
+    sntpStarted = false;
+    dnsFound = nullptr;
+}
+
+// ============================================================================
+// BROKER
+// ============================================================================
+
+static HostBroker broker;
+static std::mutex brokerLock;
+
+HostBroker& hostBroker() { return broker; }
+
+static void putLength(std::vector<uint8_t>& out, size_t length) {
+    do {
+        uint8_t b = length & 0x7F;
+        length >>= 7;
+        out.push_back(length ? (b | 0x80) : b);
+    } while (length);
+}
+
+static size_t getLength(const uint8_t* p, size_t avail, size_t* length) {
+    size_t value = 0;
+    for (size_t i = 0; i < 4 && i < avail; i++) {
+        value |= (size_t)(p[i] & 0x7F) << (7 * i);
+        if (!(p[i] & 0x80)) {
+            *length = value;
+            return i + 1;
+        }
+    }
+    return 0;
+}
+
+static void putString(std::vector<uint8_t>& out, const std::string& s) {
+    out.push_back((uint8_t)(s.size() >> 8));
+    out.push_back((uint8_t)s.size());
+    out.insert(out.end(), s.begin(), s.end());
+}
+
+// Properties this broker reads (Session Expiry, Topic Alias); the rest are
+// skipped by size. False if malformed.
+static bool readProperties(const uint8_t* p, size_t len, uint32_t* expiry, uint16_t* alias) {
+    size_t at = 0;
+    while (at < len) {
+        uint8_t id = p[at++];
+        size_t left = len - at;
+        size_t size;
+        switch (id) {
+            case 0x01: case 0x17: case 0x19: case 0x24: case 0x25: case 0x28: case 0x29: case 0x2A:
+                size = 1;
+                break;
+            case 0x13: case 0x21: case 0x22: case 0x23:
+                size = 2;
+                break;
+            case 0x02: case 0x11: case 0x18: case 0x27:
+                size = 4;
+                break;
+            case 0x0B: {
+                size_t v;
+                size = getLength(p + at, left, &v);
+                if (!size) return false;
+                break;
+            }
+            case 0x26:
+                if (left < 2) return false;
+                size = 2 + ((p[at] << 8) | p[at + 1]);
+                if (size + 2 > left) return false;
+                size += 2 + ((p[at + size] << 8) | p[at + size + 1]);
+                break;
+            default:
+                if (left < 2) return false;
+                size = 2 + ((p[at] << 8) | p[at + 1]);
+                break;
+        }
+        if (size > left) return false;
+        if (id == 0x11 && expiry) *expiry = (p[at] << 24) | (p[at + 1] << 16) | (p[at + 2] << 8) | p[at + 3];
+        if (id == 0x23 && alias) *alias = (uint16_t)((p[at] << 8) | p[at + 1]);
+        at += size;
+    }
+    return true;
+}
+
+void HostBroker::reset() {
+    HostAllocPause pause;
+    std::lock_guard<std::mutex> guard(brokerLock);
+    observers.clear();
+    sessions.clear();
+    connections.clear();
+    topicAliasMax = 16;
+    receiveMax = 0;
+    maxPacket = 0;
+    messagesPublished = 0;
+    bytesPublished = 0;
+    messagesDropped = 0;
+    acksDropped = 0;
+    connectionsDropped = 0;
+    duplicates = 0;
+    wireBytesIn = 0;
+    connects = 0;
+    connectsRefused = 0;
+    sessionsResumed = 0;
+}
+
+void HostBroker::addObserver(Observer observer) {
+    HostAllocPause pause;
+    observers.push_back(observer);
+}
+
+HostBroker::Connection* HostBroker::find(const void* socket) {
+    for (std::list<Connection>::iterator it = connections.begin(); it != connections.end(); ++it) {
+        if (it->socket == socket) return &*it;
+    }
+    return nullptr;
+}
+
+// Connection gone: the session stays if it has an expiry
+void HostBroker::drop(Connection* conn) {
+    Session* s = conn->session;
+    conn->session = nullptr;
+    conn->closed = true;
+    conn->tx.clear();
+    if (!s) return;
+    s->online = false;
+    if (s->expiryS) return;
+    for (std::list<Session>::iterator it = sessions.begin(); it != sessions.end(); ++it) {
+        if (&*it == s) {
+            sessions.erase(it);
+            break;
+        }
+    }
+}
+
+// A connection whose dropPercent roll hit is dropped here, outside any loop
+// over sessions or connections
+HostBroker::Connection* HostBroker::live(const void* socket) {
+    Connection* conn = find(socket);
+    if (conn && conn->broken && !conn->closed) drop(conn);
+    return conn && !conn->closed ? conn : nullptr;
+}
+
+bool HostBroker::breakRoll(Connection* conn) {
+    if (conn->broken || !dropRoll()) return conn->broken;
+    conn->broken = true;
+    connectionsDropped++;
+    return true;
+}
+
+void HostBroker::send(Connection* conn, const std::vector<uint8_t>& packet) {
+    if (conn->closed || conn->broken) return;
+    Segment seg;
+    seg.dueMicros = hostClockMicros() + 2000ULL * netModel.linkLatencyMs;
+    seg.bytes = packet;
+    conn->tx.push_back(seg);
+}
+
+void HostBroker::sendPublish(Connection* conn, Pending& p, uint8_t qos, bool dup) {
+    p.sent = true;
+    if (breakRoll(conn)) return;
+    if (qos == 0 && lossRoll()) {
+        messagesDropped++;
+        return;
+    }
+    std::vector<uint8_t> packet;
+    packet.push_back((uint8_t)(0x30 | (dup ? 0x08 : 0) | (qos << 1)));
+    putLength(packet, 2 + p.topic.size() + (qos ? 2 : 0) + 1 + p.payload.size());
+    putString(packet, p.topic);
+    if (qos) {
+        packet.push_back((uint8_t)(p.id >> 8));
+        packet.push_back((uint8_t)p.id);
+    }
+    packet.push_back(0);
+    packet.insert(packet.end(), p.payload.begin(), p.payload.end());
+    send(conn, packet);
+}
+
+void HostBroker::wireOpen(const void* socket) {
+    HostAllocPause pause;
+    std::lock_guard<std::mutex> guard(brokerLock);
+    Connection* old = find(socket);
+    if (old) drop(old);
+    for (std::list<Connection>::iterator it = connections.begin(); it != connections.end(); ++it) {
+        if (it->socket == socket) {
+            connections.erase(it);
+            break;
+        }
+    }
+    Connection conn;
+    conn.socket = socket;
+    conn.session = nullptr;
+    conn.txOffset = 0;
+    conn.closed = false;
+    conn.broken = false;
+    connections.push_back(conn);
+}
+
+void HostBroker::wireClosed(const void* socket) {
+    HostAllocPause pause;
+    std::lock_guard<std::mutex> guard(brokerLock);
+    for (std::list<Connection>::iterator it = connections.begin(); it != connections.end(); ++it) {
+        if (it->socket == socket) {
+            drop(&*it);
+            connections.erase(it);
+            return;
+        }
+    }
+}
+
+bool HostBroker::wireConnected(const void* socket) {
+    HostAllocPause pause;
+    std::lock_guard<std::mutex> guard(brokerLock);
+    return live(socket) != nullptr;
+}
+
+void HostBroker::wireReceive(const void* socket, const uint8_t* data, size_t len) {
+    HostAllocPause pause;
+    std::vector<std::pair<std::string, std::vector<uint8_t> > > delivered;
+    {
+        std::lock_guard<std::mutex> guard(brokerLock);
+        Connection* conn = live(socket);
+        if (!conn) return;
+        wireBytesIn += len;
+        conn->rx.insert(conn->rx.end(), data, data + len);
+        size_t at = 0;
+        while (conn->rx.size() - at >= 2) {
+            size_t remaining;
+            size_t n = getLength(&conn->rx[at + 1], conn->rx.size() - at - 1, &remaining);
+            if (!n || conn->rx.size() - at < 1 + n + remaining) break;
+            size_t total = 1 + n + remaining;
+            if (!handle(conn, &conn->rx[at], total, delivered)) {
+                drop(conn);
+                break;
+            }
+            at += total;
+            if (conn->closed || conn->broken) break;
+        }
+        if (conn->broken && !conn->closed) drop(conn);
+        if (!conn->closed) conn->rx.erase(conn->rx.begin(), conn->rx.begin() + at);
+        else conn->rx.clear();
+    }
+    // Observers may publish back (dashboard ACKs): called without the lock
+    for (size_t i = 0; i < delivered.size(); i++) {
+        const std::vector<uint8_t>& payload = delivered[i].second;
+        for (size_t k = 0; k < observers.size(); k++) {
+            observers[k](delivered[i].first, payload.empty() ? nullptr : &payload[0], payload.size());
+        }
+    }
+}
+
+// One packet from the device; false: protocol error, the connection goes
+bool HostBroker::handle(Connection* conn, const uint8_t* packet, size_t len,
+                        std::vector<std::pair<std::string, std::vector<uint8_t> > >& delivered) {
+    size_t remaining;
+    size_t h = 1 + getLength(packet + 1, len - 1, &remaining);
+    const uint8_t* body = packet + h;
+    size_t blen = len - h;
+    uint8_t type = packet[0] >> 4;
+    if (type != 1 && !conn->session) return false;     // CONNECT first
+
+    switch (type) {
+        case 1: {   // CONNECT
+            if (blen < 10 || body[6] != 5) return false;
+            uint8_t flags = body[7];
+            size_t at = 10;
+            size_t propLen;
+            size_t n = getLength(body + at, blen - at, &propLen);
+            if (!n || at + n + propLen + 2 > blen) return false;
+            uint32_t expiry = 0;
+            if (!readProperties(body + at + n, propLen, &expiry, nullptr)) return false;
+            at += n + propLen;
+            size_t idLen = (body[at] << 8) | body[at + 1];
+            if (at + 2 + idLen > blen) return false;
+            std::string clientId((const char*)body + at + 2, idLen);
+
+            Session* s = nullptr;
+            for (std::list<Session>::iterator it = sessions.begin(); it != sessions.end(); ++it) {
+                if (it->clientId != clientId) continue;
+                // Taken over: the other connection is closed
+                for (std::list<Connection>::iterator c = connections.begin(); c != connections.end(); ++c) {
+                    if (c->session != &*it || &*c == conn) continue;
+                    c->session = nullptr;
+                    c->closed = true;
+                    c->tx.clear();
+                }
+                if (flags & 0x02) sessions.erase(it);
+                else s = &*it;
+                break;
+            }
+            bool present = s != nullptr;
+            if (!s) {
+                sessions.push_back(Session());
+                s = &sessions.back();
+                s->clientId = clientId;
+                s->nextId = 1;
+                memset(s->seen, 0, sizeof(s->seen));
+                s->seenNext = 0;
+            }
+            s->expiryS = expiry;
+            s->online = true;
+            conn->session = s;
+            conn->aliases.assign(topicAliasMax, std::string());
+            connects++;
+            if (present) sessionsResumed++;
+
+            std::vector<uint8_t> ack;
+            ack.push_back(0x20);
+            size_t props = (topicAliasMax ? 3 : 0) + (receiveMax ? 3 : 0) + (maxPacket ? 5 : 0);
+            putLength(ack, 2 + 1 + props);
+            ack.push_back(present ? 1 : 0);
+            ack.push_back(0);
+            ack.push_back((uint8_t)props);
+            if (topicAliasMax) {
+                ack.push_back(0x22);
+                ack.push_back((uint8_t)(topicAliasMax >> 8));
+                ack.push_back((uint8_t)topicAliasMax);
+            }
+            if (receiveMax) {
+                ack.push_back(0x21);
+                ack.push_back((uint8_t)(receiveMax >> 8));
+                ack.push_back((uint8_t)receiveMax);
+            }
+            if (maxPacket) {
+                ack.push_back(0x27);
+                for (int shift = 24; shift >= 0; shift -= 8) ack.push_back((uint8_t)(maxPacket >> shift));
+            }
+            send(conn, ack);
+            // What waited for the session, resent ones with DUP
+            for (size_t i = 0; i < s->pending.size() && !conn->broken; i++) {
+                sendPublish(conn, s->pending[i], 1, s->pending[i].sent);
+            }
+            return true;
+        }
+        case 3: {   // PUBLISH
+            uint8_t qos = (packet[0] >> 1) & 0x03;
+            bool dup = packet[0] & 0x08;
+            if (blen < 2 || qos > 1) return false;
+            size_t topicLen = (body[0] << 8) | body[1];
+            size_t at = 2 + topicLen;
+            uint16_t id = 0;
+            if (qos) {
+                if (at + 2 > blen) return false;
+                id = (uint16_t)((body[at] << 8) | body[at + 1]);
+                at += 2;
+            }
+            size_t propLen;
+            size_t n = at < blen ? getLength(body + at, blen - at, &propLen) : 0;
+            if (!n || at + n + propLen > blen) return false;
+            uint16_t alias = 0;
+            if (!readProperties(body + at + n, propLen, nullptr, &alias)) return false;
+            at += n + propLen;
+            std::string topic((const char*)body + 2, topicLen);
+            if (alias) {
+                if (alias > conn->aliases.size()) return false;
+                if (topic.empty()) topic = conn->aliases[alias - 1];
+                else conn->aliases[alias - 1] = topic;
+            }
+            if (topic.empty()) return false;
+
+            if (breakRoll(conn)) return true;      // Lost with the connection
+            if (qos == 0 && lossRoll()) {
+                messagesDropped++;
+                return true;
+            }
+            if (qos) {
+                Session* s = conn->session;
+                bool seen = false;
+                for (size_t i = 0; i < 64 && !seen; i++) seen = s->seen[i] == id;
+                if (seen && dup) duplicates++;
+                if (!seen) {
+                    s->seen[s->seenNext] = id;
+                    s->seenNext = (uint8_t)((s->seenNext + 1) % 64);
+                }
+                if (breakRoll(conn)) {
+                    acksDropped++;              // Delivered, but the device resends it
+                } else {
+                    std::vector<uint8_t> ack;
+                    ack.push_back(0x40);
+                    ack.push_back(2);
+                    ack.push_back((uint8_t)(id >> 8));
+                    ack.push_back((uint8_t)id);
+                    send(conn, ack);
+                }
+            }
+            messagesPublished++;
+            bytesPublished += topic.size() + (blen - at);
+            delivered.push_back(std::make_pair(topic, std::vector<uint8_t>(body + at, body + blen)));
+            return true;
+        }
+        case 4: {   // PUBACK
+            if (blen < 2) return false;
+            uint16_t id = (uint16_t)((body[0] << 8) | body[1]);
+            std::vector<Pending>& pending = conn->session->pending;
+            for (size_t i = 0; i < pending.size(); i++) {
+                if (pending[i].id == id) {
+                    pending.erase(pending.begin() + i);
+                    break;
+                }
+            }
+            return true;
+        }
+        case 8: {   // SUBSCRIBE
+            if (blen < 3) return false;
+            uint16_t id = (uint16_t)((body[0] << 8) | body[1]);
+            size_t propLen;
+            size_t n = getLength(body + 2, blen - 2, &propLen);
+            if (!n) return false;
+            size_t at = 2 + n + propLen;
+            std::vector<uint8_t> ack;
+            std::vector<uint8_t> codes;
+            while (at + 2 < blen) {
+                size_t topicLen = (body[at] << 8) | body[at + 1];
+                if (at + 2 + topicLen + 1 > blen) return false;
+                std::string filter((const char*)body + at + 2, topicLen);
+                uint8_t qos = body[at + 2 + topicLen] & 0x03;
+                if (qos > 1) qos = 1;
+                at += 2 + topicLen + 1;
+                std::vector<std::pair<std::string, uint8_t> >& subs = conn->session->subscriptions;
+                size_t i = 0;
+                while (i < subs.size() && subs[i].first != filter) i++;
+                if (i == subs.size()) subs.push_back(std::make_pair(filter, qos));
+                else subs[i].second = qos;
+                codes.push_back(qos);
+            }
+            ack.push_back(0x90);
+            putLength(ack, 2 + 1 + codes.size());
+            ack.push_back((uint8_t)(id >> 8));
+            ack.push_back((uint8_t)id);
+            ack.push_back(0);
+            ack.insert(ack.end(), codes.begin(), codes.end());
+            send(conn, ack);
+            return true;
+        }
+        case 12: {  // PINGREQ
+            std::vector<uint8_t> pong;
+            pong.push_back(0xD0);
+            pong.push_back(0);
+            send(conn, pong);
+            return true;
+        }
+        case 14:    // DISCONNECT
+            drop(conn);
+            return true;
+        default:
+            return false;
+    }
+}
+
+size_t HostBroker::wireAvailable(const void* socket) {
+    HostAllocPause pause;
+    std::lock_guard<std::mutex> guard(brokerLock);
+    Connection* conn = live(socket);
+    if (!conn) return 0;
+    uint64_t now = hostClockMicros();
+    size_t n = 0;
+    for (size_t i = 0; i < conn->tx.size() && conn->tx[i].dueMicros <= now; i++) {
+        n += conn->tx[i].bytes.size() - (i == 0 ? conn->txOffset : 0);
+    }
+    return n;
+}
+
+size_t HostBroker::wireRead(const void* socket, uint8_t* out, size_t len, bool peek) {
+    HostAllocPause pause;
+    std::lock_guard<std::mutex> guard(brokerLock);
+    Connection* conn = live(socket);
+    if (!conn) return 0;
+    uint64_t now = hostClockMicros();
+    size_t n = 0;
+    size_t offset = conn->txOffset;
+    size_t seg = 0;
+    while (n < len && seg < conn->tx.size() && conn->tx[seg].dueMicros <= now) {
+        const std::vector<uint8_t>& bytes = conn->tx[seg].bytes;
+        size_t take = bytes.size() - offset;
+        if (take > len - n) take = len - n;
+        memcpy(out + n, &bytes[offset], take);
+        n += take;
+        offset += take;
+        if (offset == bytes.size()) {
+            seg++;
+            offset = 0;
+        }
+    }
+    if (!peek) {
+        conn->tx.erase(conn->tx.begin(), conn->tx.begin() + seg);
+        conn->txOffset = offset;
+    }
+    return n;
+}
+
+void HostBroker::publishToDevice(const std::string& topic, const uint8_t* payload, size_t len, uint8_t qos) {
+    HostAllocPause pause;
+    std::lock_guard<std::mutex> guard(brokerLock);
+    for (std::list<Session>::iterator s = sessions.begin(); s != sessions.end(); ++s) {
+        uint8_t granted = 0;
+        bool subscribed = false;
+        for (size_t i = 0; i < s->subscriptions.size(); i++) {
+            if (s->subscriptions[i].first == topic) {
+                subscribed = true;
+                granted = s->subscriptions[i].second;
+            }
+        }
+        if (!subscribed) continue;
+        Connection* conn = nullptr;
+        for (std::list<Connection>::iterator c = connections.begin(); c != connections.end(); ++c) {
+            if (c->session == &*s && !c->closed) conn = &*c;
+        }
+        Pending p;
+        p.id = 0;
+        p.topic = topic;
+        p.payload.assign(payload, payload + len);
+        p.sent = false;
+        if (qos && granted) {
+            p.id = s->nextId++;
+            if (!s->nextId) s->nextId = 1;
+            s->pending.push_back(p);
+            if (conn) sendPublish(conn, s->pending.back(), 1, false);
+        } else if (conn) {
+            sendPublish(conn, p, 0, false);
+        }
+    }
+}
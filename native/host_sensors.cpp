@@ -0,0 +1,183 @@
+#include "Wire.h"
+#include "BH1750.h"
+#include "DHT.h"
+#include "host_sim.h"
+
+// ============================================================================
+// I2C BUS
+// ============================================================================
+
+TwoWire Wire;
+
+static HostI2cDevice* i2cDevices[128];
+
+void hostI2cAttach(uint8_t address, HostI2cDevice* device) {
+    if (address < 128) i2cDevices[address] = device;
+}
+
+void hostI2cDetachAll() {
+    for (int i = 0; i < 128; i++) i2cDevices[i] = nullptr;
+}
+
+HostI2cDevice* hostI2cDevice(uint8_t address) {
+    return address < 128 ? i2cDevices[address] : nullptr;
+}
+
+// 100 kHz bus: ~9 bit times per byte including ACK
+static void chargeBusTime(size_t bytes) {
+    hostClockAdvanceMicros((uint64_t)(bytes + 1) * 90ULL);
+}
+
+bool TwoWire::begin(int sda, int scl, uint32_t frequency) {
+    (void)sda;
+    (void)scl;
+    (void)frequency;
+    return true;
+}
+
+void TwoWire::beginTransmission(uint8_t address) {
+    txAddress = address;
+    txLength = 0;
+}
+
+size_t TwoWire::write(uint8_t data) {
+    if (txLength >= sizeof(txBuffer)) return 0;
+    txBuffer[txLength++] = data;
+    return 1;
+}
+
+size_t TwoWire::write(const uint8_t* data, size_t quantity) {
+    size_t n = 0;
+    while (n < quantity && write(data[n])) n++;
+    return n;
+}
+
+// Return codes follow the Arduino convention: 0 ok, 2 NACK on address
+uint8_t TwoWire::endTransmission(bool sendStop) {
+    (void)sendStop;
+    chargeBusTime(txLength);
+    HostI2cDevice* dev = hostI2cDevice(txAddress);
+    if (!dev) return 2;
+    dev->onWrite(txBuffer, txLength);
+    txLength = 0;
+    return 0;
+}
+
+uint8_t TwoWire::requestFrom(uint8_t address, uint8_t quantity, bool sendStop) {
+    (void)sendStop;
+    rxIndex = 0;
+    rxLength = 0;
+    HostI2cDevice* dev = hostI2cDevice(address);
+    if (!dev) {
+        hostClockAdvanceMs(timeOut);
+        return 0;
+    }
+    if (quantity > sizeof(rxBuffer)) quantity = sizeof(rxBuffer);
+    rxLength = dev->onRead(rxBuffer, quantity);
+    chargeBusTime(rxLength);
+    return (uint8_t)rxLength;
+}
+
+int TwoWire::available() { return (int)(rxLength - rxIndex); }
+int TwoWire::read() { return rxIndex < rxLength ? rxBuffer[rxIndex++] : -1; }
+int TwoWire::peek() { return rxIndex < rxLength ? rxBuffer[rxIndex] : -1; }
+
+// ============================================================================
+// BH1750 (driver + simulated chip)
+// ============================================================================
+
+// Simulated BH1750: answers measurement reads with hostEnv().lux
+class HostBh1750Chip : public HostI2cDevice {
+public:
+    void onWrite(const uint8_t* data, size_t len) override {
+        if (len > 0) opcode = data[0];
+    }
+
+    size_t onRead(uint8_t* data, size_t len) override {
+        if (len < 2) return 0;
+        float counts = hostEnv().lux * 1.2f;
+        if (counts > 65535.0f) counts = 65535.0f;
+        if (counts < 0) counts = 0;
+        uint16_t raw = (uint16_t)counts;
+        data[0] = (uint8_t)(raw >> 8);
+        data[1] = (uint8_t)(raw & 0xFF);
+        return 2;
+    }
+
+private:
+    uint8_t opcode = 0;
+};
+
+static HostBh1750Chip defaultLightChip;
+static HostBh1750Chip extraLightChips[16];
+
+void hostI2cAttachLightSensor(uint8_t address) {
+    if (address >= 128 || i2cDevices[address]) return;
+    // First chip of the pool not on the bus (hostI2cDetachAll() frees them)
+    for (HostBh1750Chip& chip : extraLightChips) {
+        bool used = false;
+        for (int i = 0; i < 128 && !used; i++) used = i2cDevices[i] == &chip;
+        if (!used) {
+            hostI2cAttach(address, &chip);
+            return;
+        }
+    }
+}
+
+// The default board has a light sensor at 0x23 unless a harness replaced it
+static void ensureDefaultLightChip(uint8_t address) {
+    static bool attached = false;
+    if (!attached && address == 0x23 && !hostI2cDevice(0x23)) {
+        hostI2cAttach(0x23, &defaultLightChip);
+        attached = true;
+    }
+}
+
+bool BH1750::begin(Mode mode, byte addr, TwoWire* bus) {
+    i2c = bus ? bus : &Wire;
+    if (addr) address = addr;
+    ensureDefaultLightChip(address);
+    return configure(mode);
+}
+
+bool BH1750::configure(Mode newMode) {
+    i2c->beginTransmission(address);
+    i2c->write((uint8_t)newMode);
+    bool ack = (i2c->endTransmission() == 0);
+    if (ack) mode = newMode;
+    return ack;
+}
+
+float BH1750::readLightLevel() {
+    if (mode == UNCONFIGURED || !i2c) return -2.0f;
+    if (i2c->requestFrom(address, (uint8_t)2) != 2) return -1.0f;
+    uint16_t raw = (uint16_t)(i2c->read() << 8);
+    raw |= (uint16_t)i2c->read();
+    return raw / 1.2f;
+}
+
+// ============================================================================
+// DHT22
+// ============================================================================
+
+// The Adafruit driver caches for 2 s; a real transfer costs ~5 ms of bus time
+static void chargeDhtRead(unsigned long& lastReadMs) {
+    unsigned long now = millis();
+    if (lastReadMs == 0 || now - lastReadMs >= 2000) {
+        hostClockAdvanceMs(5);
+        lastReadMs = millis();
+    }
+}
+
+float DHT::readTemperature(bool isFahrenheit, bool force) {
+    (void)force;
+    chargeDhtRead(lastReadMs);
+    float t = hostEnv().temp;
+    return isFahrenheit ? t * 1.8f + 32.0f : t;
+}
+
+float DHT::readHumidity(bool force) {
+    (void)force;
+    chargeDhtRead(lastReadMs);
+    return hostEnv().humidity;
+}
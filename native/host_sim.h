@@ -0,0 +1,454 @@
+/*
+* ============================================================================
+* ArgoS - native/host_sim.h
+* ============================================================================
+* Control surface of the Linux stand-ins. Benchmarks and harnesses use it to
+* drive the virtual clock, set what the sensors see, shape the network and
+* read back the counters (allocations, serial bytes, broker traffic).
+* ============================================================================
+*/
+
+#ifndef ARGUS_HOST_SIM_H
+#define ARGUS_HOST_SIM_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <functional>
+#include <deque>
+#include <list>
+#include <string>
+#include <vector>
+#include "esp_camera.h"
+
+// ============================================================================
+// VIRTUAL CLOCK
+// ============================================================================
+
+void hostClockReset(uint64_t startMicros = 0);
+uint64_t hostClockMicros();
+void hostClockAdvanceMicros(uint64_t us);
+void hostClockAdvanceMs(uint64_t ms);
+
+// Threaded runs (firmware tasks on std::thread): time follows the steady clock
+// times `scale`, and costs sleep the calling thread. 0 = virtual clock again.
+void hostClockRealtime(double scale);
+
+// esp_timer stand-in: the clock takes the timers due up to a point in time,
+// earliest first, and runs their callbacks at their deadline
+struct HostTimerEvent {
+    void (*callback)(void* arg);
+    void* arg;
+    uint64_t dueMicros;
+};
+
+bool hostTimerTakeDue(uint64_t untilMicros, HostTimerEvent* event);
+void hostTimersStopAll();
+// Callbacks start up to `maxMicros` late (uniform), as when the esp_timer
+// task is held off by an ISR or a flash write. 0 (default) = on time.
+void hostTimerSetLatency(uint32_t maxMicros);
+
+// Waits for the tasks started with xTaskCreatePinnedToCore to return
+void hostTasksJoin();
+
+// ============================================================================
+// DEEP SLEEP / RTC MEMORY
+// ============================================================================
+
+// esp_deep_sleep_start() returns with the sleep pending. The runner (or a
+// harness) stops calling loop(), calls hostDeepSleepWake() and then setup()
+// again: timers stop, WiFi drops, the clock jumps over the sleep and the wake-up
+// cause is the timer. RTC memory is kept. Ordinary globals keep
+// their values on the host, so harnesses scrub what the firmware must restore.
+bool hostDeepSleepPending();
+uint64_t hostDeepSleepMicros();     // Timer wake-up armed for the pending sleep
+void hostDeepSleepWake();
+// Power loss: RTC_DATA_ATTR cleared, RTC_NOINIT_ATTR filled with garbage,
+// wake-up cause undefined (cold boot)
+void hostPowerCycle();
+// hostReset(): no sleep pending, cause undefined. Like any reset other than a
+// deep-sleep wake, RTC_DATA_ATTR is cleared (the bootloader reloads it) and
+// RTC_NOINIT_ATTR is kept
+void hostDeepSleepReset();
+
+size_t hostRtcBytes();
+void hostRtcCorrupt(size_t offset);     // Flips bits of one byte
+
+struct HostSleepStats {
+    uint32_t sleeps;
+    uint64_t sleptMicros;
+};
+
+HostSleepStats hostSleepStats();
+
+// ============================================================================
+// ENVIRONMENT (what the stand-in DHT22 / BH1750 / GP2Y1010 measure)
+// ============================================================================
+
+struct HostEnvironment {
+    float temp;
+    float humidity;
+    float lux;
+    float dust;     // ug/m3 seen by the optical dust sensor
+};
+
+HostEnvironment& hostEnv();
+
+// --- GPIO / ADC ---
+// Optional override for analogRead(). Default models the GP2Y1010 output:
+// the Vo pin only carries the dust voltage while the IR LED has been on for
+// 200..400us, otherwise it sits at the dark level.
+typedef uint16_t (*HostAdcSource)(uint8_t pin, uint64_t nowMicros);
+void hostSetAdcSource(HostAdcSource source);
+uint8_t hostPinLevel(uint8_t pin);
+uint64_t hostPinChangedAtMicros(uint8_t pin);
+uint16_t hostDustAdcModel(uint8_t pin, uint64_t nowMicros);
+// Dust seen by the sensor whose LED is on `ledPin` (several GP2Y1010s);
+// NaN = hostEnv().dust again
+void hostSetDustAt(uint8_t ledPin, float dust);
+
+// --- I2C ---
+class HostI2cDevice {
+public:
+    virtual ~HostI2cDevice() {}
+    virtual void onWrite(const uint8_t* data, size_t len) = 0;
+    virtual size_t onRead(uint8_t* data, size_t len) = 0;
+};
+
+void hostI2cAttach(uint8_t address, HostI2cDevice* device);
+void hostI2cDetachAll();
+HostI2cDevice* hostI2cDevice(uint8_t address);
+// Another BH1750 measuring hostEnv().lux (0x23 is always there)
+void hostI2cAttachLightSensor(uint8_t address);
+
+// ============================================================================
+// SERIAL
+// ============================================================================
+
+// Echo device output to stdout (default true). Benchmarks turn it off.
+void hostSerialEcho(bool enabled);
+// Model the UART: 10 bits per byte at the configured baud rate, writes block
+// (advance the virtual clock) once the FIFO and TX buffer are full (default
+// true).
+void hostSerialBlockingModel(bool enabled);
+void hostSerialInput(const char* data, size_t len);
+// Bytes arriving one at a time on the virtual clock from startMicros (or
+// now), after any still due: a slow link (bytesPerSecond = baud / 10), or
+// with a later start per piece, a fragmented feed
+void hostSerialInputPaced(const char* data, size_t len, uint32_t bytesPerSecond, uint64_t startMicros = 0);
+// Input not read yet, arrived or not
+size_t hostSerialInputPending();
+uint64_t hostSerialBytesOut();
+
+// ============================================================================
+// NETWORK (WiFi association, DNS, NTP, TLS and link shaping)
+// ============================================================================
+
+struct HostNetModel {
+    bool wifiAvailable;
+    bool brokerAvailable;
+    uint32_t wifiScanMs;        // Full channel scan before association
+    uint32_t wifiAssocMs;       // Association + WPA handshake
+    uint32_t dhcpMs;
+    uint32_t dnsMs;
+    uint32_t tlsHandshakeMs;
+    uint32_t ntpMs;             // SNTP answer after WiFi is up (esp_sntp.h)
+    uint32_t leaseS;            // DHCP renewal time (T1) of the leases handed out, s
+    uint32_t connectFailMs;     // Broker down: a connect fails after this long
+    int32_t apChannel;          // Joins with another channel hint never associate
+    uint32_t linkLatencyMs;     // One-way broker latency
+    uint32_t linkBytesPerMs;    // 0 = unlimited
+    uint8_t lossPercent;        // QoS 0 messages the broker drops (overloaded), either direction
+    uint8_t dropPercent;        // Per PUBLISH or PUBACK: the connection breaks, taking it along
+};
+
+HostNetModel& hostNet();
+HostNetModel hostNetDefaults();
+// Defaults, WiFi down, no SNTP or DNS query in flight (hostReset())
+void hostNetReset();
+
+// In-process stand-in of an MQTT 5 broker, reached through the WiFiClient
+// stand-in: the firmware's client writes real packets, the broker answers
+// (CONNACK, PUBACK, SUBACK, PINGRESP) after 2x linkLatencyMs. Device
+// publishes are counted and handed to observers; harnesses inject messages
+// towards the device.
+//
+// Sessions by client id: subscriptions and unacknowledged QoS 1 messages
+// towards the device outlive the connection unless it asked for a clean
+// start or no session expiry. Inside a connection TCP loses nothing:
+// lossPercent drops QoS 0 PUBLISHes only, dropPercent breaks the connection
+// instead. QoS 1 publishes towards the device without a PUBACK are resent,
+// with DUP, when the session resumes (never on a live connection).
+class HostBroker {
+public:
+    typedef std::function<void(const std::string& topic, const uint8_t* payload, size_t len)> Observer;
+
+    void reset();
+    void addObserver(Observer observer);
+
+    // Called by the socket stand-in
+    void wireOpen(const void* socket);
+    void wireReceive(const void* socket, const uint8_t* data, size_t len);
+    size_t wireAvailable(const void* socket);
+    size_t wireRead(const void* socket, uint8_t* out, size_t len, bool peek = false);
+    void wireClosed(const void* socket);
+    bool wireConnected(const void* socket);     // False once the broker closed it
+
+    // Called by harnesses. Goes to the sessions subscribed to `topic` at the
+    // lower of `qos` and the granted QoS; arrives after 2x linkLatencyMs (the
+    // device's message reached the harness instantly). QoS 1 waits for an
+    // offline session, QoS 0 does not.
+    void publishToDevice(const std::string& topic, const uint8_t* payload, size_t len, uint8_t qos = 1);
+
+    uint16_t topicAliasMax;     // Sent in the CONNACK (0: aliases refused)
+    uint16_t receiveMax;        // Sent in the CONNACK when not 0
+    uint32_t maxPacket;         // Maximum Packet Size, sent in the CONNACK when not 0
+
+    uint64_t messagesPublished;
+    uint64_t bytesPublished;    // topic + payload
+    uint64_t messagesDropped;   // QoS 0 PUBLISH lost (lossPercent), either direction
+    uint64_t acksDropped;       // PUBACK to the device lost with its connection
+    uint64_t connectionsDropped;    // Broken by dropPercent
+    uint64_t duplicates;        // Device QoS 1 publish received again (DUP, id seen)
+    uint64_t wireBytesIn;       // Every byte the device wrote
+    uint64_t connects;
+    uint64_t connectsRefused;   // Connect attempts while !brokerAvailable
+    uint64_t sessionsResumed;
+
+private:
+    struct Pending {
+        uint16_t id;
+        std::string topic;
+        std::vector<uint8_t> payload;
+        bool sent;
+    };
+    struct Session {
+        std::string clientId;
+        std::vector<std::pair<std::string, uint8_t> > subscriptions;
+        std::vector<Pending> pending;   // QoS 1 towards the device, until PUBACK
+        uint32_t expiryS;
+        uint16_t nextId;
+        uint16_t seen[64];              // Recent device packet ids
+        uint8_t seenNext;
+        bool online;
+    };
+    struct Segment {
+        uint64_t dueMicros;
+        std::vector<uint8_t> bytes;
+    };
+    struct Connection {
+        const void* socket;
+        Session* session;
+        std::vector<uint8_t> rx;
+        std::deque<Segment> tx;
+        size_t txOffset;
+        std::vector<std::string> aliases;
+        bool closed;
+        bool broken;            // dropPercent hit: dropped on the next wire call
+    };
+
+    std::vector<Observer> observers;
+    std::list<Session> sessions;
+    std::list<Connection> connections;
+
+    Connection* find(const void* socket);
+    void drop(Connection* conn);
+    void send(Connection* conn, const std::vector<uint8_t>& packet);
+    void sendPublish(Connection* conn, Pending& p, uint8_t qos, bool dup);
+    bool breakRoll(Connection* conn);
+    Connection* live(const void* socket);
+    bool handle(Connection* conn, const uint8_t* packet, size_t len,
+                std::vector<std::pair<std::string, std::vector<uint8_t> > >& delivered);
+};
+
+HostBroker& hostBroker();
+
+// ============================================================================
+// DASHBOARD (receiving side of the image protocol, see image_transfer.h)
+// ============================================================================
+
+// Attached to the broker by hostReset() and enabled by default, so images
+// published by the firmware are ACKed like the Node-RED flow does.
+void hostDashboardEnable(bool enabled);
+void hostDashboardReset();
+
+struct HostDashboardStats {
+    uint32_t imagesCompleted;
+    uint32_t acks;
+    uint32_t nacks;
+    uint32_t duplicates;        // Chunks received twice (an ACK was lost)
+    uint32_t crcErrors;
+    uint32_t resends;           // Chunks flagged as retransmissions
+    uint32_t keyframes;         // Delta upload (image_delta.h)
+    uint32_t deltas;
+    uint32_t unchanged;
+    uint32_t keyframeRequests;  // Deltas against a keyframe it did not have
+};
+
+// What the viewer shows: the last image decoded, with delta tiles applied
+struct HostDashboardFrame {
+    int width;
+    int height;
+    std::vector<uint8_t> rgb;
+    uint16_t keyframeId;
+    uint8_t kind;               // DeltaKind, 0 for a plain JPEG
+
+    HostDashboardFrame() : width(0), height(0), keyframeId(0), kind(0) {}
+};
+
+HostDashboardStats hostDashboardStats();
+const std::vector<uint8_t>& hostDashboardLastImage();
+const HostDashboardFrame& hostDashboardLastFrame();
+
+// ============================================================================
+// CAMERA
+// ============================================================================
+
+// Frames returned by esp_camera_fb_get(). Default: synthetic JPEG-shaped
+// buffer of the given size.
+void hostCameraSetFrameSize(size_t len);
+void hostCameraSetFrame(const uint8_t* data, size_t len);
+
+// RGB888 <-> JPEG (libjpeg), for harnesses that build their own frames and
+// check what the dashboard reconstructed. Neither advances the clock.
+std::vector<uint8_t> hostJpegEncode(const uint8_t* rgb, int width, int height, int quality);
+bool hostJpegDecode(const uint8_t* jpeg, size_t len, std::vector<uint8_t>* rgb, int* width, int* height);
+
+// The sensor streams at 25 fps from the end of esp_camera_init() (250 ms).
+// GRAB_WHEN_EMPTY: each buffer keeps the first frame after it was returned,
+// however long it then waits (a stale frame); GRAB_LATEST: fb_get() gives
+// the last complete frame not handed out yet. Frames before the settle count
+// are marked unsettled (auto exposure still converging).
+void hostCameraFailInit(bool fail);             // esp_camera_init() fails until cleared (hostReset)
+void hostCameraSetSettleFrames(uint32_t frames);  // Default 2
+
+struct HostCameraFrameInfo {
+    uint32_t index;             // Since the last init
+    uint64_t capturedMicros;    // Virtual clock, = fb->timestamp
+    bool settled;
+};
+
+// A frame currently out (zero for anything else)
+HostCameraFrameInfo hostCameraFrameInfo(const camera_fb_t* fb);
+
+// Frame buffer ownership: how long the firmware held frames before returning
+// them (virtual time), and how long the camera was powered (init to deinit)
+struct HostCameraStats {
+    uint32_t framesTaken;
+    uint64_t heldMicrosTotal;
+    uint64_t heldMicrosMax;
+    uint32_t inits;
+    uint64_t activeMicros;      // Including the current power-up
+    bool powered;
+};
+
+HostCameraStats hostCameraStats();
+void hostCameraResetStats();
+
+// ============================================================================
+// FLASH (data partitions for esp_partition_*)
+// ============================================================================
+
+// The partitions.csv data partitions exist by default; adding a label that
+// exists resizes and erases it. Flash contents survive hostReset().
+void hostFlashAddPartition(const char* label, uint8_t subtype, size_t size);
+void hostFlashWipe();
+// Simulated power loss: after `bytes` more programmed bytes every write and
+// erase fails until hostFlashRestorePower() (the "reboot").
+void hostFlashPowerCutAfter(int64_t bytes);
+bool hostFlashPowerIsCut();
+void hostFlashRestorePower();
+
+struct HostFlashStats {
+    uint64_t bytesRead;
+    uint64_t bytesWritten;
+    uint64_t sectorsErased;
+};
+
+HostFlashStats hostFlashStats();
+
+// ============================================================================
+// HEAP
+// ============================================================================
+
+struct HostAllocStats {
+    uint64_t allocs;
+    uint64_t frees;
+    uint64_t bytes;
+    int64_t liveBytes;
+    int64_t peakLiveBytes;
+    int64_t psramLiveBytes;     // ps_malloc() blocks, not part of the above
+    int64_t psramPeakBytes;
+    uint64_t psramAllocs;       // ps_malloc() calls
+};
+
+HostAllocStats hostAllocStats();
+void* hostPsramAlloc(size_t size);
+// psramFound(): true by default (hostReset), false for a board without PSRAM
+void hostSetPsram(bool present);
+void hostAllocResetPeak();
+
+// Stand-in internals (broker queues, observers) run under this guard so the
+// counters only see what the firmware allocates. Memory must be released
+// under a guard as well.
+class HostAllocPause {
+public:
+    HostAllocPause();
+    ~HostAllocPause();
+};
+
+// ============================================================================
+// TRACE REPLAY (digital twin, host_twin.cpp)
+// ============================================================================
+
+// One row of a recorded trace: seconds from any origin, what the sensors saw
+struct HostTraceRow {
+    double t;
+    HostEnvironment env;
+};
+
+// CSV: timestamp,lux,dust,temp,humidity. A header line naming the columns
+// (timestamp|t|seconds, lux, dust, temp|temperature, humidity|hum) may give
+// another order; blank and '#' lines are skipped. Rows sorted by time.
+bool hostTraceLoad(const char* path, std::vector<HostTraceRow>* rows, std::string* error);
+// Linear between rows, the first/last row outside them. `t` from the first row.
+HostEnvironment hostTraceAt(const std::vector<HostTraceRow>& rows, double t);
+// Generated: day length, sun and temperature following the season from
+// `startDay` (day of the year, 0 = 1 Jan), passing clouds, dust building up
+// between rain days with storms now and then. Deterministic for a seed.
+HostEnvironment hostTraceSynthetic(double t, int startDay, uint32_t seed);
+
+struct HostTwinOptions {
+    const std::vector<HostTraceRow>* trace;     // nullptr: hostTraceSynthetic()
+    double seconds;             // Replayed; a recorded trace's span if 0
+    int startDay;               // Synthetic only
+    uint32_t seed;
+    uint32_t stepMs;            // Virtual time between loop() passes
+    FILE* events;               // JSON lines (see host_twin.cpp), nullptr = none
+    bool publishes;             // Every would-be publish as an event, not only counted
+};
+
+HostTwinOptions hostTwinDefaults();
+
+struct HostTwinStats {
+    double simSeconds;
+    double wallSeconds;
+    uint64_t passes;
+    uint32_t modeChanges;
+    uint32_t alertsRaised;
+    uint32_t alertsCleared;
+    uint64_t publishes;
+    uint64_t publishBytes;      // Topic + payload
+    uint32_t sleeps;
+};
+
+// From a power cycle: setup(), then loop() on the virtual clock with the
+// sensors reading the trace, until options.seconds of it are replayed. Once
+// per process: firmware globals, the flash queue and the metrics carry over
+// into a second run.
+HostTwinStats hostTwinRun(const HostTwinOptions& options);
+
+// Full reset of clock, environment, network and counters
+void hostReset();
+
+#endif
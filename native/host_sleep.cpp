@@ -0,0 +1,89 @@
+#include "esp_sleep.h"
+#include "host_sim.h"
+#include "Arduino.h"
+#include "WiFi.h"
+
+// ============================================================================
+// RTC SLOW MEMORY (RTC_DATA_ATTR variables, section "argus_rtc";
+// RTC_NOINIT_ATTR, section "argus_rtc_noinit")
+// ============================================================================
+
+// Bounds from the linker; weak so a build without RTC variables still links
+extern uint8_t __start_argus_rtc[] __attribute__((weak));
+extern uint8_t __stop_argus_rtc[] __attribute__((weak));
+extern uint8_t __start_argus_rtc_noinit[] __attribute__((weak));
+extern uint8_t __stop_argus_rtc_noinit[] __attribute__((weak));
+
+size_t hostRtcBytes() { return __start_argus_rtc ? (size_t)(__stop_argus_rtc - __start_argus_rtc) : 0; }
+
+static size_t rtcNoinitBytes() {
+    return __start_argus_rtc_noinit ? (size_t)(__stop_argus_rtc_noinit - __start_argus_rtc_noinit) : 0;
+}
+
+// What the bootloader does on a boot other than a deep-sleep wake-up
+static void rtcDataReload() {
+    if (hostRtcBytes()) memset(__start_argus_rtc, 0, hostRtcBytes());
+}
+
+void hostRtcCorrupt(size_t offset) {
+    if (offset < hostRtcBytes()) __start_argus_rtc[offset] ^= 0x5A;
+}
+
+// ============================================================================
+// DEEP SLEEP
+// ============================================================================
+
+static uint64_t timerWakeupUs = 0;
+static bool sleepPending = false;
+static esp_sleep_wakeup_cause_t wakeupCause = ESP_SLEEP_WAKEUP_UNDEFINED;
+static HostSleepStats sleepStats;
+
+esp_err_t esp_sleep_enable_timer_wakeup(uint64_t time_in_us) {
+    timerWakeupUs = time_in_us;
+    return ESP_OK;
+}
+
+void esp_deep_sleep_start() {
+    sleepPending = true;
+    sleepStats.sleeps++;
+}
+
+esp_sleep_wakeup_cause_t esp_sleep_get_wakeup_cause() { return wakeupCause; }
+
+bool hostDeepSleepPending() { return sleepPending; }
+uint64_t hostDeepSleepMicros() { return timerWakeupUs; }
+HostSleepStats hostSleepStats() { return sleepStats; }
+
+// Only the RTC domain stays powered: timers stop, the radio and the camera
+// are off
+static void powerDown() {
+    hostTimersStopAll();
+    WiFi.disconnect();
+    esp_camera_deinit();
+}
+
+void hostDeepSleepWake() {
+    if (!sleepPending) return;
+    sleepPending = false;
+    powerDown();
+    hostClockAdvanceMicros(timerWakeupUs);
+    sleepStats.sleptMicros += timerWakeupUs;
+    wakeupCause = ESP_SLEEP_WAKEUP_TIMER;
+}
+
+void hostPowerCycle() {
+    sleepPending = false;
+    powerDown();
+    rtcDataReload();
+    // Whatever the cells settle to at power-on: only a magic and a CRC tell
+    for (size_t i = 0; i < rtcNoinitBytes(); i++) __start_argus_rtc_noinit[i] = (uint8_t)(i * 0x9D + 0x35);
+    wakeupCause = ESP_SLEEP_WAKEUP_UNDEFINED;
+}
+
+void hostDeepSleepReset() {
+    sleepPending = false;
+    rtcDataReload();
+    timerWakeupUs = 0;
+    wakeupCause = ESP_SLEEP_WAKEUP_UNDEFINED;
+    memset(&sleepStats, 0, sizeof(sleepStats));
+}
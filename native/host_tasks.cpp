@@ -0,0 +1,49 @@
+#include <freertos/task.h>
+#include "host_sim.h"
+#include "Arduino.h"
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// ============================================================================
+// TASKS (std::thread per xTaskCreatePinnedToCore)
+// ============================================================================
+
+// setup()/loop() run on core 1, as the Arduino loopTask does
+static thread_local BaseType_t currentCore = 1;
+static std::vector<std::thread> tasks;
+static std::mutex tasksLock;
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t task, const char* name, uint32_t stackDepth, void* param,
+                                   UBaseType_t priority, TaskHandle_t* handle, BaseType_t core) {
+    (void)name;
+    (void)stackDepth;
+    (void)priority;
+    if (!task) return pdFALSE;
+    HostAllocPause pause;
+    std::lock_guard<std::mutex> guard(tasksLock);
+    tasks.push_back(std::thread([task, param, core]() {
+        currentCore = core == tskNO_AFFINITY ? 0 : core;
+        task(param);
+    }));
+    if (handle) *handle = (TaskHandle_t)&tasks.back();
+    return pdPASS;
+}
+
+void vTaskDelay(TickType_t ticks) { delay((unsigned long)ticks * portTICK_PERIOD_MS); }
+
+void vTaskDelete(TaskHandle_t task) { (void)task; }
+
+BaseType_t xPortGetCoreID() { return currentCore; }
+
+void hostTasksJoin() {
+    std::vector<std::thread> running;
+    {
+        std::lock_guard<std::mutex> guard(tasksLock);
+        running.swap(tasks);
+    }
+    for (size_t i = 0; i < running.size(); i++) running[i].join();
+    HostAllocPause pause;
+    running.clear();
+    running.shrink_to_fit();
+}
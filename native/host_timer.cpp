@@ -0,0 +1,102 @@
+#include "esp_timer.h"
+#include "host_sim.h"
+#include <mutex>
+
+// ============================================================================
+// ESP_TIMER (fired by the host clock, see hostClockAdvanceMicros)
+// ============================================================================
+
+struct esp_timer {
+    esp_timer_cb_t callback;
+    void* arg;
+    uint64_t dueMicros;
+    uint64_t periodMicros;      // 0 = one-shot
+    bool active;
+    esp_timer* next;
+};
+
+static esp_timer* timers = nullptr;
+static std::mutex timersLock;
+
+esp_err_t esp_timer_create(const esp_timer_create_args_t* args, esp_timer_handle_t* out) {
+    if (!args || !args->callback || !out) return ESP_ERR_INVALID_ARG;
+    esp_timer* t = new esp_timer();
+    t->callback = args->callback;
+    t->arg = args->arg;
+    std::lock_guard<std::mutex> guard(timersLock);
+    t->next = timers;
+    timers = t;
+    *out = t;
+    return ESP_OK;
+}
+
+static esp_err_t startTimer(esp_timer_handle_t timer, uint64_t delayMicros, uint64_t periodMicros) {
+    if (!timer) return ESP_ERR_INVALID_ARG;
+    uint64_t now = hostClockMicros();
+    std::lock_guard<std::mutex> guard(timersLock);
+    if (timer->active) return ESP_ERR_INVALID_STATE;
+    timer->dueMicros = now + delayMicros;
+    timer->periodMicros = periodMicros;
+    timer->active = true;
+    return ESP_OK;
+}
+
+esp_err_t esp_timer_start_once(esp_timer_handle_t timer, uint64_t timeout_us) {
+    return startTimer(timer, timeout_us, 0);
+}
+
+esp_err_t esp_timer_start_periodic(esp_timer_handle_t timer, uint64_t period_us) {
+    if (!period_us) return ESP_ERR_INVALID_ARG;
+    return startTimer(timer, period_us, period_us);
+}
+
+esp_err_t esp_timer_stop(esp_timer_handle_t timer) {
+    if (!timer) return ESP_ERR_INVALID_ARG;
+    std::lock_guard<std::mutex> guard(timersLock);
+    if (!timer->active) return ESP_ERR_INVALID_STATE;
+    timer->active = false;
+    return ESP_OK;
+}
+
+esp_err_t esp_timer_delete(esp_timer_handle_t timer) {
+    if (!timer) return ESP_ERR_INVALID_ARG;
+    {
+        std::lock_guard<std::mutex> guard(timersLock);
+        if (timer->active) return ESP_ERR_INVALID_STATE;
+        for (esp_timer** p = &timers; *p; p = &(*p)->next) {
+            if (*p == timer) {
+                *p = timer->next;
+                break;
+            }
+        }
+    }
+    delete timer;
+    return ESP_OK;
+}
+
+bool esp_timer_is_active(esp_timer_handle_t timer) {
+    std::lock_guard<std::mutex> guard(timersLock);
+    return timer && timer->active;
+}
+
+int64_t esp_timer_get_time() { return (int64_t)hostClockMicros(); }
+
+bool hostTimerTakeDue(uint64_t untilMicros, HostTimerEvent* event) {
+    std::lock_guard<std::mutex> guard(timersLock);
+    esp_timer* first = nullptr;
+    for (esp_timer* t = timers; t; t = t->next) {
+        if (t->active && t->dueMicros <= untilMicros && (!first || t->dueMicros < first->dueMicros)) first = t;
+    }
+    if (!first) return false;
+    event->callback = first->callback;
+    event->arg = first->arg;
+    event->dueMicros = first->dueMicros;
+    if (first->periodMicros) first->dueMicros += first->periodMicros;
+    else first->active = false;
+    return true;
+}
+
+void hostTimersStopAll() {
+    std::lock_guard<std::mutex> guard(timersLock);
+    for (esp_timer* t = timers; t; t = t->next) t->active = false;
+}
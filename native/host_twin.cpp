@@ -0,0 +1,273 @@
+#include "host_sim.h"
+#include "Arduino.h"
+#include "config.h"
+#include "core.h"
+#include <math.h>
+#include <chrono>
+
+// Digital twin: the real setup()/loop() on the virtual clock, the stand-in
+// sensors reading a recorded or generated trace. What the firmware would
+// have sent is taken from the broker, one JSON line per event:
+//
+//   {"t":<s>,"ev":"mode","v":"DAY"}          mode published, on a change
+//   {"t":<s>,"ev":"alert","v":true}          cleaning alert raised / cleared
+//   {"t":<s>,"ev":"pub","topic":"sensor/dust_density","bytes":5}
+//                                            every publish (options.publishes)
+//   {"ev":"summary",...}                     last line, HostTwinStats
+//
+// t is trace seconds from its start. The same trace and build give the same
+// lines, so two builds (thresholds, rules) compare with diff.
+
+void setup();
+void loop();
+
+// ============================================================================
+// TRACES
+// ============================================================================
+
+static bool columnIndex(const std::string& name, int* column) {
+    static const char* const names[][3] = {
+        {"timestamp", "t", "seconds"}, {"lux", "light", "light_level"}, {"dust", "dust_density", "pm"},
+        {"temp", "temperature", "t_c"}, {"humidity", "hum", "rh"}
+    };
+    for (int c = 0; c < 5; c++) {
+        for (int k = 0; k < 3; k++) {
+            if (name == names[c][k]) {
+                *column = c;
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+bool hostTraceLoad(const char* path, std::vector<HostTraceRow>* rows, std::string* error) {
+    FILE* f = fopen(path, "r");
+    if (!f) {
+        *error = std::string("cannot open ") + path;
+        return false;
+    }
+    int order[5] = {0, 1, 2, 3, 4};     // Field of each column: t, lux, dust, temp, humidity
+    char line[512];
+    unsigned lineNo = 0;
+    rows->clear();
+    while (fgets(line, sizeof(line), f)) {
+        lineNo++;
+        char* p = line;
+        while (*p == ' ' || *p == '\t') p++;
+        if (*p == '#' || *p == '\n' || *p == '\r' || *p == 0) continue;
+        if (rows->empty() && !isdigit((unsigned char)*p) && *p != '-' && *p != '.') {
+            // Header: column names
+            int col = 0;
+            for (char* tok = strtok(p, ",\r\n"); tok && col < 5; tok = strtok(nullptr, ",\r\n"), col++) {
+                std::string name(tok);
+                while (!name.empty() && name[0] == ' ') name.erase(0, 1);
+                while (!name.empty() && name[name.size() - 1] == ' ') name.erase(name.size() - 1);
+                for (size_t i = 0; i < name.size(); i++) name[i] = (char)tolower((unsigned char)name[i]);
+                if (!columnIndex(name, &order[col])) {
+                    *error = "unknown column '" + name + "'";
+                    fclose(f);
+                    return false;
+                }
+            }
+            continue;
+        }
+        double v[5];
+        if (sscanf(p, "%lf,%lf,%lf,%lf,%lf", &v[0], &v[1], &v[2], &v[3], &v[4]) != 5) {
+            *error = "line " + std::to_string(lineNo) + ": expected 5 numbers";
+            fclose(f);
+            return false;
+        }
+        double field[5];
+        for (int c = 0; c < 5; c++) field[order[c]] = v[c];
+        HostTraceRow row;
+        row.t = field[0];
+        row.env.lux = (float)field[1];
+        row.env.dust = (float)field[2];
+        row.env.temp = (float)field[3];
+        row.env.humidity = (float)field[4];
+        if (!rows->empty() && row.t < rows->back().t) {
+            *error = "line " + std::to_string(lineNo) + ": timestamp goes back";
+            fclose(f);
+            return false;
+        }
+        rows->push_back(row);
+    }
+    fclose(f);
+    if (rows->empty()) {
+        *error = "no rows";
+        return false;
+    }
+    return true;
+}
+
+HostEnvironment hostTraceAt(const std::vector<HostTraceRow>& rows, double t) {
+    t += rows.front().t;
+    if (t <= rows.front().t) return rows.front().env;
+    if (t >= rows.back().t) return rows.back().env;
+    // Replay moves forward: start from the last row found
+    static const HostTraceRow* lastRows = nullptr;
+    static size_t at = 1;
+    if (lastRows != rows.data() || at >= rows.size() || rows[at - 1].t > t) at = 1;
+    lastRows = rows.data();
+    while (rows[at].t < t) at++;
+    const HostTraceRow& a = rows[at - 1];
+    const HostTraceRow& b = rows[at];
+    float k = b.t > a.t ? (float)((t - a.t) / (b.t - a.t)) : 1.0f;
+    HostEnvironment env;
+    env.temp = a.env.temp + (b.env.temp - a.env.temp) * k;
+    env.humidity = a.env.humidity + (b.env.humidity - a.env.humidity) * k;
+    env.lux = a.env.lux + (b.env.lux - a.env.lux) * k;
+    env.dust = a.env.dust + (b.env.dust - a.env.dust) * k;
+    return env;
+}
+
+static uint32_t mix(uint32_t x) {
+    x ^= x >> 16;
+    x *= 0x7FEB352D;
+    x ^= x >> 15;
+    x *= 0x846CA68B;
+    x ^= x >> 16;
+    return x;
+}
+
+// 0..1, fixed for a day (or second) and seed
+static double unit(uint32_t n, uint32_t seed, uint32_t salt) {
+    return mix(n * 0x9E3779B9u ^ mix(seed + salt)) / 4294967296.0;
+}
+
+static bool rainDay(uint32_t day, uint32_t seed) { return unit(day, seed, 1) < 0.12; }
+
+HostEnvironment hostTraceSynthetic(double t, int startDay, uint32_t seed) {
+    uint32_t day = (uint32_t)(startDay + t / 86400.0);
+    double h = fmod(t / 3600.0, 24.0);
+    double season = cos(2 * M_PI * ((int)(day % 365) - 172) / 365.0);   // 1 at midsummer
+    double dayLength = 12 + 3.5 * season;
+    double sunrise = 12 - dayLength / 2;
+    double sun = h > sunrise && h < sunrise + dayLength ? sin(M_PI * (h - sunrise) / dayLength) : 0;
+    bool rain = rainDay(day, seed);
+    double cloudiness = rain ? 1.0 : unit(day, seed, 2);
+    double sky = sin(t / 700.0) + 0.8 * sin(t / 1900.0 + day) + 0.3 * sin(t / 310.0 + 2);
+    double clouds = rain ? 0.25 : sky > 1.2 - cloudiness ? 1.0 - 0.5 * cloudiness * (sky - 1.2 + cloudiness) / 2.3 : 1.0;
+    double noise = unit((uint32_t)t, seed, 3) * 2 - 1;
+    double warm = sin(M_PI * (h - 9) / 12);
+
+    // Dust settles between rain days; a storm now and then around midday
+    uint32_t dry = 0;
+    while (dry < 60 && !rainDay(day - dry, seed)) dry++;
+    bool storm = !rain && unit(day, seed, 4) < 0.08 && h >= 12 && h < 14;
+
+    HostEnvironment env;
+    env.lux = (float)((70000 + 30000 * season) * pow(sun, 1.3) * clouds * (1 + 0.03 * noise) + 2);
+    env.temp = (float)(14 + 10 * season + (rain ? 3 : 6) * warm + 0.1 * noise);
+    env.humidity = (float)(rain ? 92 + 3 * noise : 65 - 20 * warm - 5 * season + 0.5 * noise);
+    env.dust = (float)(30 + 8 * dry + 4 * noise + (storm ? 280 : 0));
+    return env;
+}
+
+// ============================================================================
+// TWIN
+// ============================================================================
+
+HostTwinOptions hostTwinDefaults() {
+    HostTwinOptions o;
+    o.trace = nullptr;
+    o.seconds = 0;
+    o.startDay = 120;
+    o.seed = 1;
+    o.stepMs = 1000;
+    o.events = nullptr;
+    o.publishes = false;
+    return o;
+}
+
+// Observer state: file scope, as the broker keeps the observer until the
+// next hostReset()
+static HostTwinStats* twinStats = nullptr;
+static const HostTwinOptions* twinOptions = nullptr;
+static double twinNow = 0;
+static std::string twinMode;
+static int twinAlert = -1;
+
+static void observe(const std::string& topic, const uint8_t* payload, size_t len) {
+    if (!twinStats) return;
+    HostAllocPause pause;
+    static const size_t prefix = sizeof(MQTT_TOPIC("")) - 1;
+    twinStats->publishes++;
+    twinStats->publishBytes += topic.size() + len;
+    FILE* out = twinOptions->events;
+    const char* name = topic.c_str() + (topic.size() > prefix ? prefix : 0);
+    if (out && twinOptions->publishes) {
+        fprintf(out, "{\"t\":%.3f,\"ev\":\"pub\",\"topic\":\"%s\",\"bytes\":%u}\n", twinNow, name, (unsigned)len);
+    }
+    std::string value((const char*)payload, len);
+    if (topic == MQTT_TOPIC(TOPIC_MODE) && value != "BOOT_ONLINE" && value != twinMode) {
+        if (!twinMode.empty()) twinStats->modeChanges++;
+        twinMode = value;
+        if (out) fprintf(out, "{\"t\":%.3f,\"ev\":\"mode\",\"v\":\"%s\"}\n", twinNow, twinMode.c_str());
+    } else if (topic == MQTT_TOPIC(TOPIC_ALERT)) {
+        int state = value == "true";
+        if (state == twinAlert) return;
+        if (state) twinStats->alertsRaised++;
+        else if (twinAlert == 1) twinStats->alertsCleared++;
+        twinAlert = state;
+        if (out) fprintf(out, "{\"t\":%.3f,\"ev\":\"alert\",\"v\":%s}\n", twinNow, state ? "true" : "false");
+    }
+}
+
+HostTwinStats hostTwinRun(const HostTwinOptions& options) {
+    HostTwinStats stats = {};
+    double seconds = options.seconds;
+    if (seconds <= 0 && options.trace) seconds = options.trace->back().t - options.trace->front().t;
+
+    hostPowerCycle();
+    hostReset();
+    hostSerialEcho(false);
+    twinStats = &stats;
+    twinOptions = &options;
+    twinNow = 0;
+    twinMode.clear();
+    twinAlert = -1;
+    hostBroker().addObserver(observe);
+    uint64_t start = hostClockMicros();
+
+    std::chrono::steady_clock::time_point wallStart = std::chrono::steady_clock::now();
+    HostEnvironment& env = hostEnv();
+    env = options.trace ? hostTraceAt(*options.trace, 0) : hostTraceSynthetic(0, options.startDay, options.seed);
+    setup();
+    setDaysSinceClean(DAYS_BETWEEN_CLEAN);      // As a fresh device: globals outlive setup() on the host
+    double nextDay = 86400;
+    for (;;) {
+        twinNow = (hostClockMicros() - start) / 1e6;
+        if (twinNow >= seconds) break;
+        // The firmware only counts days through the hook; the twin stands in for the operator
+        if (twinNow >= nextDay) {
+            setDaysSinceClean(coreSaveState().daysSinceLastClean + 1);
+            nextDay += 86400;
+        }
+        env = options.trace ? hostTraceAt(*options.trace, twinNow)
+                            : hostTraceSynthetic(twinNow, options.startDay, options.seed);
+        loop();
+        stats.passes++;
+        if (hostDeepSleepPending()) {
+            // Deep sleep: the clock jumps to the wake-up, which boots again
+            hostDeepSleepWake();
+            stats.sleeps++;
+            setup();
+            continue;
+        }
+        hostClockAdvanceMs(options.stepMs);
+    }
+    twinStats = nullptr;
+    stats.simSeconds = twinNow;
+    stats.wallSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - wallStart).count();
+    if (options.events) {
+        fprintf(options.events,
+                "{\"ev\":\"summary\",\"days\":%.2f,\"passes\":%llu,\"mode_changes\":%u,\"alerts_raised\":%u,"
+                "\"alerts_cleared\":%u,\"publishes\":%llu,\"publish_bytes\":%llu,\"sleeps\":%u}\n",
+                stats.simSeconds / 86400.0, (unsigned long long)stats.passes, stats.modeChanges, stats.alertsRaised,
+                stats.alertsCleared, (unsigned long long)stats.publishes, (unsigned long long)stats.publishBytes,
+                stats.sleeps);
+    }
+    return stats;
+}
@@ -0,0 +1,22 @@
+// Host stand-in for the esp32-camera converters (conversions/img_converters.h).
+// Only the software JPEG encoder: RGB888 buffers are B, G, R in memory, as the
+// esp32-camera converters store them. fmt2jpg() malloc's its output in PSRAM
+// (released by the caller with free()); fmt2jpg_cb() hands it to a callback.
+
+#ifndef ARGUS_NATIVE_IMG_CONVERTERS_H
+#define ARGUS_NATIVE_IMG_CONVERTERS_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "esp_camera.h"
+#include "esp_jpg_decode.h"
+
+bool fmt2jpg(uint8_t* src, size_t src_len, uint16_t width, uint16_t height, pixformat_t format, uint8_t quality,
+             uint8_t** out, size_t* out_len);
+
+// Returns the bytes it took; fewer aborts the encode
+typedef size_t (*jpg_out_cb)(void* arg, size_t index, const void* data, size_t len);
+bool fmt2jpg_cb(uint8_t* src, size_t src_len, uint16_t width, uint16_t height, pixformat_t format, uint8_t quality,
+                jpg_out_cb cb, void* arg);
+
+#endif
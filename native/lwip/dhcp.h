@@ -0,0 +1,22 @@
+// Host stand-in for the lwIP DHCP client state of the station netif: the
+// timers of the lease it holds (leaseS, hostNet()), zero while it has none
+// (link down or a static IP).
+
+#ifndef ARGUS_NATIVE_LWIP_DHCP_H
+#define ARGUS_NATIVE_LWIP_DHCP_H
+
+#include <stdint.h>
+
+struct dhcp {
+    uint32_t offered_t0_lease;
+    uint32_t offered_t1_renew;
+    uint32_t offered_t2_rebind;
+};
+
+struct netif {
+    struct dhcp* dhcp;
+};
+
+#define netif_dhcp_data(netif) ((netif)->dhcp)
+
+#endif
@@ -0,0 +1,37 @@
+// Host stand-in for the lwIP asynchronous resolver. The answer arrives
+// dnsMs (hostNet()) after the query, from the esp_timer machinery, like the
+// callback lwIP runs on its own thread.
+
+#ifndef ARGUS_NATIVE_LWIP_DNS_H
+#define ARGUS_NATIVE_LWIP_DNS_H
+
+#include <stdint.h>
+
+typedef int8_t err_t;
+
+#define ERR_OK          0
+#define ERR_INPROGRESS -5
+#define ERR_VAL        -6
+#define ERR_CONN      -11
+
+typedef struct {
+    uint32_t addr;
+} ip4_addr_t;
+
+typedef struct {
+    union {
+        ip4_addr_t ip4;
+    } u_addr;
+    uint8_t type;
+} ip_addr_t;
+
+#define ip_2_ip4(ipaddr)    (&((ipaddr)->u_addr.ip4))
+#define ip4_addr_get_u32(a) ((a)->addr)
+
+typedef void (*dns_found_callback)(const char* name, const ip_addr_t* ipaddr, void* callback_arg);
+
+// ERR_OK: `addr` holds the answer (cached); ERR_INPROGRESS: `found` is
+// called later, with nullptr if the lookup failed
+err_t dns_gethostbyname(const char* hostname, ip_addr_t* addr, dns_found_callback found, void* callback_arg);
+
+#endif
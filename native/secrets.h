@@ -0,0 +1,17 @@
+// Credentials for the native build. The broker and WiFi are simulated, so
+// these only need to be well-formed.
+
+#ifndef SECRETS_H
+#define SECRETS_H
+
+#define SECRET_SSID "host-sim"
+#define SECRET_WIFI_PASSWORD "host-sim"
+
+#define SECRET_MQTT_SERVER "broker.host.sim"
+#define SECRET_MQTT_PORT 8883
+#define SECRET_MQTT_USER "argus"
+#define SECRET_MQTT_PASSWORD "argus"
+
+#define SECRET_MQTT_CLIENT_ID "ArgoS_Native_001"
+
+#endif
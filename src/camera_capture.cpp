@@ -0,0 +1,174 @@
+#include "camera_capture.h"
+#include "logger.h"
+#include "perf_metrics.h"
+#include <atomic>
+
+// Acquisition side only
+static bool powered = false;
+static bool available = true;           // Cleared by a failed init: no retry this boot
+static CaptureRequest running = CAPTURE_SCORING;
+static uint32_t poweredAtMs = 0;
+static uint32_t eventFrames = 0;
+static CameraStats stats = {};
+
+// Either task
+static std::atomic<uint32_t> framesOut(0);
+static std::atomic<uint32_t> lastUseMs(0);
+
+static bool powerUp(const CaptureRequest& request) {
+    camera_config_t config;
+    memset(&config, 0, sizeof(config));
+    config.ledc_channel = LEDC_CHANNEL_0;
+    config.ledc_timer = LEDC_TIMER_0;
+    config.pin_d0 = Y2_GPIO_NUM;
+    config.pin_d1 = Y3_GPIO_NUM;
+    config.pin_d2 = Y4_GPIO_NUM;
+    config.pin_d3 = Y5_GPIO_NUM;
+    config.pin_d4 = Y6_GPIO_NUM;
+    config.pin_d5 = Y7_GPIO_NUM;
+    config.pin_d6 = Y8_GPIO_NUM;
+    config.pin_d7 = Y9_GPIO_NUM;
+    config.pin_xclk = XCLK_GPIO_NUM;
+    config.pin_pclk = PCLK_GPIO_NUM;
+    config.pin_vsync = VSYNC_GPIO_NUM;
+    config.pin_href = HREF_GPIO_NUM;
+    config.pin_sccb_sda = SIOD_GPIO_NUM;
+    config.pin_sccb_scl = SIOC_GPIO_NUM;
+    config.pin_pwdn = PWDN_GPIO_NUM;
+    config.pin_reset = RESET_GPIO_NUM;
+    config.xclk_freq_hz = CAMERA_XCLK_HZ;
+    config.pixel_format = PIXFORMAT_JPEG;
+    config.frame_size = request.size;
+    config.jpeg_quality = request.quality;
+    // Double buffer in PSRAM: the driver keeps overwriting the spare, so
+    // fb_get() waits at most one frame
+    bool psram = psramFound();
+    config.fb_count = psram ? 2 : 1;
+    config.fb_location = psram ? CAMERA_FB_IN_PSRAM : CAMERA_FB_IN_DRAM;
+    config.grab_mode = psram ? CAMERA_GRAB_LATEST : CAMERA_GRAB_WHEN_EMPTY;
+
+    uint32_t start = millis();
+    if (esp_camera_init(&config) != ESP_OK) {
+        available = false;
+        stats.activeMs += millis() - start;
+        LOG_ERROR("❌ Camera Failed");
+        return false;
+    }
+    powered = true;
+    running = request;
+    poweredAtMs = start;
+    eventFrames = 0;
+    stats.events++;
+    for (uint8_t i = 0; i < CAMERA_WARMUP_FRAMES; i++) {
+        camera_fb_t* fb = esp_camera_fb_get();
+        if (!fb) break;
+        esp_camera_fb_return(fb);
+        stats.warmupDropped++;
+    }
+    return true;
+}
+
+static void powerDown() {
+    esp_camera_deinit();
+    // No PWDN line on this board: the deinit stops XCLK and the DMA and the
+    // sensor idles unclocked
+    if (PWDN_GPIO_NUM >= 0) {
+        pinMode(PWDN_GPIO_NUM, OUTPUT);
+        digitalWrite(PWDN_GPIO_NUM, HIGH);
+    }
+    powered = false;
+    uint32_t onMs = millis() - poweredAtMs;
+    stats.lastActiveMs = onMs;
+    stats.activeMs += onMs;
+    #if ENABLE_PERF_METRICS
+        perfRecord(PERF_CAMERA_ON, onMs * 1000UL);
+    #endif
+    LOG_INFO("📷 Camera off: on %lu ms, %lu frames", (unsigned long)onMs, (unsigned long)eventFrames);
+}
+
+bool cameraBegin(bool probe) {
+    powered = false;
+    available = true;
+    framesOut.store(0);
+    stats = CameraStats();
+    if (!probe) return true;
+    if (!powerUp(CAPTURE_SCORING)) return false;
+    LOG_INFO("✅ Camera Initialized (%d frame buffers)", psramFound() ? 2 : 1);
+    powerDown();
+    return true;
+}
+
+bool cameraSameSettings(const CaptureRequest& a, const CaptureRequest& b) {
+    return a.size == b.size && a.quality == b.quality;
+}
+
+camera_fb_t* cameraCapture(const CaptureRequest& request) {
+    uint32_t requestedUs = micros();
+    lastUseMs.store(millis());
+    if (!available) {
+        stats.failures++;
+        return nullptr;
+    }
+    if (powered && !cameraSameSettings(request, running)) {
+        if (framesOut.load() > 0) {
+            stats.failures++;
+            LOG_WARN("📷 Capture refused: a frame at other settings is still out");
+            return nullptr;
+        }
+        powerDown();
+    }
+    bool cold = !powered;
+    if (cold && !powerUp(request)) {
+        stats.failures++;
+        return nullptr;
+    }
+
+    camera_fb_t* fb;
+    while ((fb = esp_camera_fb_get()) != nullptr) {
+        uint32_t takenUs = (uint32_t)((uint64_t)fb->timestamp.tv_sec * 1000000ULL + fb->timestamp.tv_usec);
+        if ((int32_t)(takenUs - requestedUs) > 0) break;
+        esp_camera_fb_return(fb);
+        fb = nullptr;
+        stats.staleDropped++;
+        if ((uint32_t)micros() - requestedUs >= CAMERA_CAPTURE_TIMEOUT_MS * 1000UL) break;
+    }
+    uint32_t latencyUs = (uint32_t)micros() - requestedUs;
+    if (!fb || latencyUs >= CAMERA_CAPTURE_TIMEOUT_MS * 1000UL) {
+        if (fb) esp_camera_fb_return(fb);
+        stats.failures++;
+        LOG_WARN("📷 No fresh frame in %lu ms", (unsigned long)(latencyUs / 1000));
+        return nullptr;
+    }
+    framesOut.fetch_add(1);
+    stats.captures++;
+    eventFrames++;
+    stats.lastLatencyUs = latencyUs;
+    if (latencyUs > stats.maxLatencyUs) stats.maxLatencyUs = latencyUs;
+    LOG_INFO("📷 Frame in %lu ms (%s)", (unsigned long)(latencyUs / 1000), cold ? "cold" : "warm");
+    return fb;
+}
+
+void cameraRelease(camera_fb_t* fb) {
+    if (!fb) return;
+    esp_camera_fb_return(fb);
+    lastUseMs.store(millis());
+    framesOut.fetch_sub(1);
+}
+
+void cameraIdle() {
+    if (!powered || framesOut.load() > 0) return;
+    if (millis() - lastUseMs.load() < CAMERA_KEEP_WARM_MS) return;
+    powerDown();
+}
+
+void cameraPowerDown() {
+    if (powered && framesOut.load() == 0) powerDown();
+}
+
+CameraStats cameraStats() {
+    CameraStats s = stats;
+    if (powered) s.activeMs += millis() - poweredAtMs;
+    s.framesOut = framesOut.load();
+    s.powered = powered;
+    return s;
+}
@@ -0,0 +1,64 @@
+#ifndef CAMERA_CAPTURE_H
+#define CAMERA_CAPTURE_H
+
+#include <Arduino.h>
+#include "esp_camera.h"
+#include "config.h"
+
+// Camera power management and capture-at-trigger. The camera is off between
+// uses: a request powers it up (init, then CAMERA_WARMUP_FRAMES dropped while
+// exposure settles), later ones within CAMERA_KEEP_WARM_MS find it running.
+// cameraIdle() powers it down once no frame is out and none was asked for in
+// that time.
+//
+// A capture returns a frame exposed after the request. Frames the driver
+// already held (the one buffered since the last return, the previous frame
+// of the stream) are dropped, so a trigger never uploads an old picture. The
+// capture gives up after CAMERA_CAPTURE_TIMEOUT_MS, power-up included.
+//
+// Size and quality are per request. Other settings than the running ones
+// re-initialise the driver, which needs every frame back first: with one
+// still out the capture fails.
+//
+// Power-up is the only allocation left after startup: the driver takes its
+// frame buffers at init and frees them at deinit, the same sizes each time.
+//
+// Captures, cameraIdle() and cameraPowerDown() on the acquisition side;
+// cameraRelease() from either task.
+
+struct CaptureRequest {
+    framesize_t size;
+    uint8_t quality;            // JPEG 0-63, lower is better
+};
+
+static const CaptureRequest CAPTURE_SCORING = {CAMERA_FRAME_SIZE, CAMERA_JPEG_QUALITY};
+static const CaptureRequest CAPTURE_UPLOAD = {CAMERA_UPLOAD_SIZE, CAMERA_UPLOAD_QUALITY};
+
+struct CameraStats {
+    uint32_t events;            // Power-ups
+    uint32_t captures;          // Frames handed out
+    uint32_t failures;          // Requests without a frame (init, timeout, busy)
+    uint32_t staleDropped;      // Exposed before their request
+    uint32_t warmupDropped;
+    uint32_t lastLatencyUs;     // Request to frame
+    uint32_t maxLatencyUs;
+    uint32_t lastActiveMs;      // Powered time of the last event that ended
+    uint32_t activeMs;          // Powered time since boot, the current event included
+    uint32_t framesOut;
+    bool powered;
+};
+
+// At boot. probe: power the camera up once to check it answers (cold boot),
+// then off. Without a probe the first capture finds out.
+bool cameraBegin(bool probe);
+// A fresh frame, nullptr on failure. Give it back with cameraRelease().
+camera_fb_t* cameraCapture(const CaptureRequest& request);
+void cameraRelease(camera_fb_t* fb);
+// From loop(): powers down after CAMERA_KEEP_WARM_MS unused
+void cameraIdle();
+// Now, if no frame is out (before a deep sleep)
+void cameraPowerDown();
+bool cameraSameSettings(const CaptureRequest& a, const CaptureRequest& b);
+CameraStats cameraStats();
+
+#endif
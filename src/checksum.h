@@ -0,0 +1,13 @@
+#ifndef CHECKSUM_H
+#define CHECKSUM_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// CRC-32 (IEEE 802.3, same as zlib/Python binascii.crc32).
+// Chain calls with crc32Update(previous, ...), starting from 0.
+uint32_t crc32Update(uint32_t crc, const uint8_t* data, size_t len);
+
+inline uint32_t crc32(const uint8_t* data, size_t len) { return crc32Update(0, data, len); }
+
+#endif
@@ -35,7 +35,14 @@
 // ============================================================================
 // true = Ignore hardware, use values injected via Serial commands
 // false = Use real sensors
+#ifndef ENABLE_SIMULATOR
 #define ENABLE_SIMULATOR      true
+#endif
+
+// Serial command channel (serial_commands.h): text lines and binary sample frames
+#define SERIAL_CMD_LINE_MAX   48        // Longest text command; longer lines are dropped
+#define SERIAL_CMD_POLL_BYTES 512       // RX bytes handled per loop() pass at most
+#define SERIAL_RX_BUFFER      2048      // UART driver RX buffer: sample bursts between passes
 
 // ============================================================================
 // HARDWARE PINOUT
@@ -70,12 +77,24 @@
 #define DUST_LED_PIN     21      
 #define DUST_VO_PIN      3      
 
+// Several sensors per type, one per panel string: list them in string
+// order. A type with fewer sensors than strings shares its last one (e.g.
+// one DHT22 for the whole array). Every list starts with the pins above.
+#define DHT_PINS         {DHT_PIN}
+#define BH1750_ADDRS     {BH1750_ADDR}  // 0x23 / 0x5C (ADDR pin); more behind an I2C mux
+#define DUST_LED_PINS    {DUST_LED_PIN}
+#define DUST_VO_PINS     {DUST_VO_PIN}  // ADC1 pins, same order as the LEDs
+#ifndef SENSOR_MAX_CHANNELS
+#define SENSOR_MAX_CHANNELS 4           // Per type: sizes the sensor arrays and the telemetry record
+#endif
+
 // ============================================================================
 // OPERATIONAL THRESHOLDS (Business Logic)
 // ============================================================================
 
 // Light
 #define MIN_LUX_DAY_MODE      1000      // Below this = Night Mode
+#define MODE_LUX_HYSTERESIS   200       // Day above MIN_LUX_DAY_MODE + this, night below - this
 #define MIN_LUX_FOR_CLEANING  5000      // Min lux to justify cleaning
 #define MAX_LUX_REFERENCE     100000    // Full sun reference
 
@@ -83,7 +102,6 @@
 #define DUST_THRESHOLD        150.0     // ug/m3 (High risk)
 #define HUMIDITY_MIN_TRIGGER  60.0      // % (Low humidity increases dust sticking)
 #define DUST_CALIB            1.1       // Calibration factor
-#define DUST_SAMPLES          5         // Moving average window size
 
 // Performance
 #define EFFICIENCY_MIN        75.0      // % 
@@ -95,6 +113,200 @@
 #define INTERVAL_NIGHT        30000     // 30 sec (For Testing)
 #define DAYS_BETWEEN_CLEAN    7
 
+// ============================================================================
+// LOGGING
+// ============================================================================
+
+// 0=None 1=Error 2=Warn 3=Info 4=Debug (higher levels compile to nothing)
+#ifndef LOG_LEVEL
+#define LOG_LEVEL             3
+#endif
+#define LOG_RING_SIZE         64        // Records buffered between drains
+#define LOG_MAX_ARGS          4         // Arguments per record
+#define LOG_LINE_MAX          160       // Formatted line length
+#define LOG_SERIAL_TX_BUFFER  1024      // UART driver TX buffer (bytes)
+#define LOG_MQTT_MIN_LEVEL    2         // Forward WARN+ to TOPIC_LOG (0 = off)
+
+// ============================================================================
+// RUNTIME (acquisition and network tasks)
+// ============================================================================
+// true: sensors, mode and decisions stay in loop() (core 1); MQTT, the log
+// drain, uploads and dashboard requests run in a task on core 0, fed through
+// a lock-free queue. false: loop() runs the network step itself.
+#ifndef RUNTIME_DUAL_CORE
+#define RUNTIME_DUAL_CORE         true
+#endif
+#define RUNTIME_QUEUE_LENGTH      32      // Records between the tasks (power of two)
+#define RUNTIME_QUEUE_RESERVE     4       // Slots kept for state and alert records
+#define RUNTIME_FRAMES_IN_FLIGHT  1       // Frames the network side may hold (fb_count - 1)
+#define RUNTIME_NETWORK_CORE      0       // With the WiFi / LwIP tasks
+#define RUNTIME_NETWORK_PRIORITY  1       // Same as the Arduino loopTask
+#define RUNTIME_NETWORK_STACK     8192    // Bytes: TLS, JSON and the image transfer
+#define RUNTIME_NETWORK_IDLE_MS   1       // Sleep between network steps
+
+// ============================================================================
+// DEEP SLEEP (duty cycling between cycles)
+// ============================================================================
+// true: once a cycle's records have gone out, the device deep-sleeps until
+// the next one. Decision state, counters and the stats interval in progress
+// are kept in RTC memory (deep_sleep.h). Warm wake-ups skip the boot delay,
+// NTP and DNS, and start the camera only when a frame is needed. Dashboard
+// requests (camera/request) are only seen while awake.
+#ifndef ENABLE_DEEP_SLEEP
+#define ENABLE_DEEP_SLEEP         false
+#endif
+#define SLEEP_MIN_MS              2000    // Shorter waits stay awake (a wake-up reconnects WiFi and MQTT)
+#define BOOT_DELAY_MS             3000    // Cold boot only: time to open the serial monitor
+
+// ============================================================================
+// DUST SAMPLER (GP2Y1010 pulsed in the background)
+// ============================================================================
+// esp_timer callbacks light the IR LED, read Vo at the output peak and turn
+// the LED off; readDustLevels() only filters the last DUST_WINDOW reads. With
+// several sensors the pulses take turns, one LED lit at a time.
+#ifndef DUST_SAMPLE_HZ
+#define DUST_SAMPLE_HZ            100     // Pulses per second per sensor (datasheet cycle: 10 ms)
+#endif
+#define DUST_READ_DELAY_US        280     // LED on to ADC read (output peak)
+#define DUST_PULSE_US             320     // LED on time; later reads are dropped
+#define DUST_WINDOW               64      // Reads the filters see (0.64 s at 100 Hz)
+#define DUST_MIN_READS            8       // Right after start-up (wake-up) the first reading waits for these
+#define DUST_OUTLIER_MADS         3.0f    // Outlier: further than this many MADs (scaled to sigma) from the median
+#define DUST_OUTLIER_FLOOR        5.0f    // ug/m3, narrowest outlier band (the MAD of a steady signal is 0)
+
+// ============================================================================
+// STREAMING STATISTICS (per-channel interval aggregates)
+// ============================================================================
+// Every SystemStatus channel keeps count/mean/std/min/max/p50/p95 over the
+// report interval and an EMA across intervals, at constant cost per sample.
+#ifndef ENABLE_SENSOR_STATS
+#define ENABLE_SENSOR_STATS       true
+#endif
+#define STATS_SAMPLE_MS           2000    // Temp / humidity / dust between day cycles (DHT22: 0.5 Hz max)
+// Aggregates published every N cycles, then restarted: one report heartbeat
+// of day cycles, so they do not outnumber the telemetry sent by exception
+#define STATS_REPORT_CYCLES       (REPORT_HEARTBEAT_MS / INTERVAL_DAY)
+#define STATS_EMA_ALPHA           0.1f    // Weight of each new sample in the EMA
+
+// ============================================================================
+// VISION (PANEL SOILING SCORE)
+// ============================================================================
+
+#ifndef ENABLE_SOILING_SCORE
+#define ENABLE_SOILING_SCORE      true
+#endif
+#define SOILING_GRID_W            80      // Grayscale grid (VGA at 1/8 scale)
+#define SOILING_GRID_H            60
+#define SOILING_BLOCKS_X          8       // Blocks for brightness uniformity
+#define SOILING_BLOCKS_Y          6
+#define SOILING_SPOT_DELTA        40      // Gray levels above the 3x3 neighbourhood mean
+// Each measure is scored 0 at the first value, 1 at the second. Calibrate on
+// real frames with bench_soiling --dir.
+#define SOILING_UNIFORMITY_FLOOR  3.0f    // Std of block means (gray levels)
+#define SOILING_UNIFORMITY_FULL   12.0f
+#define SOILING_CONTRAST_CLEAN    0.18f   // Local contrast / mean brightness
+#define SOILING_CONTRAST_DIRTY    0.08f
+#define SOILING_SPOT_FLOOR        0.012f  // Fraction of spot pixels
+#define SOILING_SPOT_FULL         0.035f
+#define SOILING_WEIGHT_UNIFORMITY 0.2f
+#define SOILING_WEIGHT_HAZE       0.4f
+#define SOILING_WEIGHT_SPOTS      0.4f
+#define SOILING_INTERVAL_CYCLES   6       // Score every Nth day cycle, and whenever dust is high
+#define SOILING_CONFIRM_SCORE     25      // Dust trigger needs at least this when a score exists
+#define SOILING_CLEAN_SCORE       50      // Score that triggers cleaning on its own
+#define SOILING_UPLOAD_SCORE      45      // Upload the frame when the score crosses this
+
+// ============================================================================
+// CAMERA CAPTURE (power management, camera_capture.h)
+// ============================================================================
+// Powered only around captures: off once no frame has been out or asked for
+// in CAMERA_KEEP_WARM_MS, warmed again by the next request.
+#define CAMERA_FRAME_SIZE         FRAMESIZE_VGA   // Scoring frames (the soiling grid is VGA at 1/8)
+#define CAMERA_JPEG_QUALITY       12              // 0-63, lower is better
+#define CAMERA_UPLOAD_SIZE        FRAMESIZE_VGA   // Evidence and dashboard frames (one size: image deltas)
+#define CAMERA_UPLOAD_QUALITY     12
+#define CAMERA_XCLK_HZ            20000000
+// About what a power-up costs in camera-on time: staying on longer for a
+// request that may not come is never more than twice the best choice
+#define CAMERA_KEEP_WARM_MS       500     // Idle time before powering down (0: after each capture)
+#define CAMERA_WARMUP_FRAMES      2       // Dropped after power-up while exposure settles
+#define CAMERA_CAPTURE_TIMEOUT_MS 1500    // Whole capture, power-up included
+
+// ============================================================================
+// RULE ENGINE (cleaning decision, rules.h)
+// ============================================================================
+// The thresholds above are the default ruleset, compiled in. true: a new
+// ruleset can be sent on TOPIC_RULES (validated, then adopted at the next
+// day cycle); it is kept in RTC memory until a power cycle.
+#ifndef ENABLE_RULE_UPDATES
+#define ENABLE_RULE_UPDATES       true
+#endif
+#define RULES_MAX_CONSTS          16      // Limits of a ruleset (they size RAM and the MQTT message)
+#define RULES_MAX_OPS             64
+#define RULES_MAX_REASONS         4
+#define RULES_REASON_LEN          32      // Including the NUL
+#define RULES_MAX_SLOTS           8       // Hysteresis / hold-time state
+#define RULES_STACK               8       // Evaluation stack depth
+
+// ============================================================================
+// DELTA IMAGE UPLOAD (changed tiles against a reference keyframe)
+// ============================================================================
+
+#ifndef ENABLE_IMAGE_DELTA
+#define ENABLE_IMAGE_DELTA        true
+#endif
+#define DELTA_PARTITION_LABEL     "refframe"  // Reference keyframe, kept across reboots
+#define DELTA_TILE_PX             80          // Tile edge; a multiple of 16 keeps tiles on whole JPEG MCUs
+#define DELTA_MAX_TILES           64          // Largest tile grid (VGA is 8 x 6)
+#define DELTA_HASH_CELLS          4           // Tile hash: DELTA_HASH_CELLS^2 cell means from the 1/8 grid
+#define DELTA_CELL_LEVELS         12          // Gray levels a cell may move before its tile counts as changed
+#define DELTA_KEYFRAME_PERCENT    50          // More tiles changed than this: send a new keyframe
+#define DELTA_TILE_QUALITY        80          // JPEG quality of the re-encoded changed tiles
+#define DELTA_MAX_KEYFRAME        (160 * 1024)  // Largest keyframe JPEG (PSRAM copy and flash)
+
+// ============================================================================
+// OFFLINE STORE-AND-FORWARD
+// ============================================================================
+
+#ifndef ENABLE_OFFLINE_QUEUE
+#define ENABLE_OFFLINE_QUEUE      true
+#endif
+#define OFFLINE_PARTITION_LABEL   "offlineq"  // Data partition in partitions.csv
+#define OFFLINE_REPLAY_BUDGET_MS  50          // Max replay time per loopMQTT()
+#define OFFLINE_REPLAY_BATCH      2048        // Bytes of queued frames per replay message
+#define OFFLINE_IMAGE_CHUNK       2048        // Image bytes per flash record
+#define OFFLINE_IMAGE_MAX         (160 * 1024)  // Largest image queued (its replay buffer, PSRAM)
+
+// ============================================================================
+// CONNECTION (WiFi join, broker address, reconnects)
+// ============================================================================
+// The join, NTP and the broker lookup run in the background (net_link.h);
+// sampling starts right after setup(). true: the AP's channel and BSSID, the
+// DHCP lease and the broker's address are kept in RTC memory, so a reset or
+// a deep-sleep wake-up joins without a scan, DHCP or DNS. A power cycle
+// clears them; a cache that fails, or a lease past its renewal time, is
+// dropped for a full join.
+#ifndef ENABLE_FAST_CONNECT
+#define ENABLE_FAST_CONNECT       true
+#endif
+#define WIFI_FAST_TIMEOUT_MS      1500    // Cached AP/lease not up: full join
+#define WIFI_JOIN_TIMEOUT_MS      10000   // Scan + association + DHCP, then start over
+#define WIFI_LEASE_DEFAULT_S      3600    // Renewal time (T1) of a cached lease that did not give one
+#define MQTT_BACKOFF_MIN_MS       1000    // After a failed connect, doubled per failure (+0-25 % jitter)
+#define MQTT_BACKOFF_MAX_MS       60000
+
+// ============================================================================
+// PERFORMANCE METRICS (perf_metrics.h)
+// ============================================================================
+// Latency histograms of the loop() stages and the network side, heap/PSRAM
+// low-water marks, publish failures and connects: one JSON message on
+// TOPIC_METRICS per interval. false: the probes compile to nothing.
+#ifndef ENABLE_PERF_METRICS
+#define ENABLE_PERF_METRICS       true
+#endif
+#define PERF_REPORT_MS            60000   // Interval per report (extended while offline)
+#define PERF_REPORT_BUFFER        2048    // JSON bytes, streamed past MQTT_BUFFER_SIZE
+
 // ============================================================================
 // MQTT CONFIGURATION
 // ============================================================================
@@ -102,21 +314,99 @@
 // Base Topic Structure: argus/{device_id}/{category}/{metric}
 #define TOPIC_PREFIX "argus/"
 
+// Inbound packet buffer (acks, requests, rulesets). Outbound messages go
+// through the outbox; images and replay batches are streamed past it
+// (beginPublish/write/endPublish).
+#define MQTT_BUFFER_SIZE  512
+
+// Client (mqtt_client.h): publish() queues, the network step writes
+#define MQTT_OUTBOX_BYTES       4096    // Topics + payloads queued or awaiting PUBACK
+#define MQTT_OUTBOX_MESSAGES    32
+#define MQTT_INFLIGHT_WINDOW    8       // QoS 1 publishes sent without their PUBACK yet
+#define MQTT_FLUSH_BYTES        8192    // Outbox bytes written per loop()
+#define MQTT_KEEPALIVE_S        15
+#define MQTT_SESSION_EXPIRY_S   86400   // Broker keeps subscriptions and QoS 1 messages while away (0: clean start)
+#define MQTT_TOPIC_ALIASES      16      // Per connection, up to the broker's maximum (0: off)
+#define MQTT_TOPIC_ALIAS_LEN    64      // Longer topics always go in full
+#define MQTT_QOS_EVENTS         1       // Alerts, mode changes, acks and capture control
+#define MQTT_QOS_TELEMETRY      0       // Readings: the next cycle supersedes a lost one
+
+// Full topic resolved at compile time (string literal concatenation)
+#define MQTT_TOPIC(suffix) TOPIC_PREFIX DEVICE_ID "/" suffix
+
 // Sub-topics (suffix)
 #define TOPIC_DUST        "sensor/dust_density"
 #define TOPIC_TEMP        "sensor/temperature"
 #define TOPIC_HUM         "sensor/humidity"
 #define TOPIC_LUX         "sensor/light_level"
+#define TOPIC_SOILING     "sensor/soiling_score" // 0-100, camera-based
+#define TOPIC_EFFICIENCY  "sensor/efficiency"    // Only as aggregates (not measured yet)
+#define TOPIC_STATS       "/stats"               // Appended to a metric topic: interval aggregates (JSON)
 #define TOPIC_ALERT       "alert/clean_needed"
 #define TOPIC_MODE        "status/operation_mode"
+#define TOPIC_LOG         "status/log"
+#define TOPIC_FRAME       "sensor/frame"         // Packed binary telemetry
+#define TOPIC_REPLAY      "sensor/replay"        // Queued frames, concatenated
+#define TOPIC_BATCH       "sensor/batch"         // Compressed samples (series_codec.h)
+#define TOPIC_QUEUE       "status/offline_queue" // Catch-up summary (JSON)
+#define TOPIC_METRICS     "status/metrics"       // Stage latencies, heap, publish failures (JSON)
+#define TOPIC_RULES       "config/rules"         // Ruleset update (binary, rules.h)
+#define TOPIC_RULES_ACK   "config/rules_ack"     // Outcome of an update (JSON)
+
+// Telemetry encoding
+#define TELEMETRY_MODE_TOPICS  0    // One text message per metric (Node-RED flow)
+#define TELEMETRY_MODE_FRAME   1    // One packed frame per cycle on TOPIC_FRAME
+#define TELEMETRY_MODE_BOTH    2
+#define TELEMETRY_MODE_BATCH   3    // Samples collected and sent compressed on TOPIC_BATCH
+#ifndef TELEMETRY_MODE
+#define TELEMETRY_MODE         TELEMETRY_MODE_TOPICS
+#endif
+
+// Batch upload (TELEMETRY_MODE_BATCH): every cycle's values go into one
+// compressed payload, sent when it is full or its first sample is
+// TELEMETRY_BATCH_MS old. Values are snapped to a power-of-two step below
+// the sensor resolution first (0 = exact), so unchanged bits compress away.
+#define TELEMETRY_BATCH_MS     300000   // 5 min
+#define TELEMETRY_BATCH_BYTES  1024     // Per message (and offline record); RTC memory with deep sleep
+#define SERIES_STEP_TEMP       0.0625f  // DHT22 resolution 0.1 C
+#define SERIES_STEP_HUMIDITY   0.0625f  // 0.1 %
+#define SERIES_STEP_LUX        0.5f     // BH1750 ~0.83 lx
+#define SERIES_STEP_DUST       0.25f    // ug/m3
+#define SERIES_STEP_EFFICIENCY 0.0f
+#define SERIES_STEP_SOILING    0.25f    // Score points
+
+// Report by exception (report.h): a value goes out when it moved more than
+// its deadband since the last one sent (the larger of the absolute and the
+// relative band) or after REPORT_HEARTBEAT_MS of silence. The mode is sent
+// on a change or heartbeat, the alert on a change ("false" only after
+// REPORT_ALERT_CLEAR_CYCLES day cycles without a trigger).
+#ifndef ENABLE_REPORT_BY_EXCEPTION
+#define ENABLE_REPORT_BY_EXCEPTION true
+#endif
+#define REPORT_HEARTBEAT_MS    900000   // 15 min: longest silence of a measured value
+#define REPORT_DB_TEMP         0.5      // C (DHT22 resolution 0.1)
+#define REPORT_DB_HUMIDITY     2.0      // %
+#define REPORT_DB_LUX          200.0    // lx, or
+#define REPORT_DB_LUX_REL      0.15     // of the last value sent
+#define REPORT_DB_DUST         10.0     // ug/m3, or
+#define REPORT_DB_DUST_REL     0.10
+#define REPORT_DB_SOILING      5.0      // Score points
+#define REPORT_ALERT_CLEAR_CYCLES 3
 
 // Camera Topics
 #define TOPIC_CAM_CTRL    "camera/control"     // JSON metadata (start/end)
 #define TOPIC_CAM_DATA    "camera/image_chunk" // Binary data
-#define TOPIC_CAM_ACK     "camera/ack"         // Command from Dashboard to ESP
+#define TOPIC_CAM_ACK     "camera/ack"         // Chunk ACK/NACK from the dashboard
+#define TOPIC_CAM_REQ     "camera/request"     // "key": resend the keyframe, anything else: upload the next frame
 
 // Image Config
-#define IMG_CHUNK_SIZE    2048  // 2KB per chunk (safe for HiveMQ free tier)
+#ifndef IMG_CHUNK_SIZE
+#define IMG_CHUNK_SIZE    (64 * 1024)  // Streamed, so a VGA frame is one message; lower on lossy links
+#endif
+#define IMG_MAX_CHUNKS    128   // Largest image: IMG_MAX_CHUNKS * IMG_CHUNK_SIZE
+#define IMG_WINDOW        8     // Unacknowledged chunks in flight
+#define IMG_RETRY_MS      1000  // Resend a chunk not ACKed within this time
+#define IMG_TRANSFER_TIMEOUT_MS 10000  // Abort when no ACK progress for this long
 
 #endif
 
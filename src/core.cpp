@@ -1,69 +1,90 @@
 #include "core.h"
+#include "rules.h"
 
 // State variables (Persistent)
 unsigned long lastCleanTime = 0;
 int daysSinceLastClean = 7; // Start at 7 for testing
+float lastSoilingScore = NAN;
 
 // Mocking function for testing
 void setDaysSinceClean(int days) {
     daysSinceLastClean = days;
 }
 
-// Helper: Timestamp generator
-String getTimestamp() {
-    unsigned long now = millis();
-    unsigned long h = (now / 3600000) % 24;
-    unsigned long m = (now / 60000) % 60;
-    unsigned long s = (now / 1000) % 60;
-    char buf[16];
-    sprintf(buf, "[%02lu:%02lu:%02lu]", h, m, s);
-    return String(buf);
+CoreState coreSaveState() {
+    CoreState state;
+    state.daysSinceLastClean = daysSinceLastClean;
+    state.sinceCleanMs = millis() - lastCleanTime;
+    state.lastSoilingScore = lastSoilingScore;
+    return state;
 }
 
-void logSystem(String message) {
-    Serial.print(getTimestamp());
-    Serial.print(" ");
-    Serial.println(message);
+void coreRestoreState(const CoreState& state, uint32_t sleptMs) {
+    daysSinceLastClean = state.daysSinceLastClean;
+    lastCleanTime = millis() - (state.sinceCleanMs + sleptMs);   // Wraps like millis()
+    lastSoilingScore = state.lastSoilingScore;
 }
 
-SystemMode determineOperationMode(float lux) {
+SystemMode determineOperationMode(float lux, SystemMode current) {
+    // Hysteresis: lux hovering at dawn / dusk does not flip the mode every pass
+    if (current == MODE_DAY) return (lux < MIN_LUX_DAY_MODE - MODE_LUX_HYSTERESIS) ? MODE_NIGHT : MODE_DAY;
+    if (current == MODE_NIGHT) return (lux > MIN_LUX_DAY_MODE + MODE_LUX_HYSTERESIS) ? MODE_DAY : MODE_NIGHT;
     return (lux >= MIN_LUX_DAY_MODE) ? MODE_DAY : MODE_NIGHT;
 }
 
-bool evaluateSystemState(SystemStatus status) {
-    bool triggerCleaning = false;
-    String reason = "";
+const char* modeName(SystemMode mode) { return (mode == MODE_DAY) ? "DAY_MODE" : "NIGHT_MODE"; }
 
-    // --- RULE: Environmental ---
-    bool condDust = (status.dust > DUST_THRESHOLD);
-    bool condHum = (status.humidity < HUMIDITY_MIN_TRIGGER);
-    bool condLux = (status.lux > MIN_LUX_FOR_CLEANING);
-    bool condTime = (daysSinceLastClean >= DAYS_BETWEEN_CLEAN);
+float channelMax(const float* values, uint8_t channels) {
+    float best = NAN;
+    for (uint8_t i = 0; i < channels; i++) {
+        if (values[i] > best || isnan(best)) best = values[i];
+    }
+    return best;
+}
 
-    // Visual Debug for Simulator
-    if (condDust && condHum && condLux) {
-        if (!condTime) {
-            logSystem("⚠️ Critical conditions met, waiting for schedule (" + 
-                    String(daysSinceLastClean) + "/" + String(DAYS_BETWEEN_CLEAN) + " days)");
+bool evaluateSystemState(const SystemStatus& status, const SensorBank& bank) {
+    // Thresholds, time and camera conditions: the ruleset (rules.h), once per channel
+    RuleResult results[SENSOR_MAX_CHANNELS];
+    rulesEvaluateBank(bank, status, daysSinceLastClean, results);
+    uint8_t notes = 0;
+    int8_t trigger = -1;
+    uint8_t triggerChannel = 0;
+    for (uint8_t ch = 0; ch < bank.channels; ch++) {
+        notes |= results[ch].notes;
+        if (trigger < 0 && results[ch].trigger >= 0) {
+            trigger = results[ch].trigger;
+            triggerChannel = ch;
         }
     }
 
-    if (condDust && condHum && condLux && condTime) {
-        triggerCleaning = true;
-        reason = "Environment (Dust+Dry+Time)";
+    // Visual Debug for Simulator
+    for (int8_t r = 0; r < RULES_MAX_REASONS; r++) {
+        if (notes & (1 << r)) {
+            LOG_WARN("⚠️ %s (%d/%d days)", rulesReason(r), daysSinceLastClean, DAYS_BETWEEN_CLEAN);
+        }
     }
 
     // --- ACTION ---
-    if (triggerCleaning) {
-        logSystem("⚠️ ALERT: CLEANING TRIGGERED");
-        logSystem("   Reason: " + reason);
+    if (trigger >= 0) {
+        LOG_WARN("⚠️ ALERT: CLEANING TRIGGERED");
+        if (bank.channels > 1) LOG_WARN("   Reason: %s (string %u)", rulesReason(trigger), (unsigned)triggerChannel);
+        else LOG_WARN("   Reason: %s", rulesReason(trigger));
         
         lastCleanTime = millis();
         daysSinceLastClean = 0; 
         return true; 
     } else {
-        logSystem("Status: OK (Dust:" + String(status.dust,0) + 
-                " Days:" + String(daysSinceLastClean) + ")");
+        float dust = channelMax(bank.dust, bank.channels);
+        if (isnan(status.soiling)) LOG_INFO("Status: OK (Dust:%.0f Days:%d)", dust, daysSinceLastClean);
+        else LOG_INFO("Status: OK (Dust:%.0f Soiling:%.0f Days:%d)", dust, status.soiling, daysSinceLastClean);
         return false; 
     }
+}
+
+bool shouldUploadFrame(const SystemStatus& status, bool cleaningTriggered) {
+    if (isnan(status.soiling)) return cleaningTriggered;
+    bool crossed = status.soiling >= SOILING_UPLOAD_SCORE &&
+                   (isnan(lastSoilingScore) || lastSoilingScore < SOILING_UPLOAD_SCORE);
+    lastSoilingScore = status.soiling;
+    return crossed;
 }
\ No newline at end of file
@@ -3,28 +3,65 @@
 
 #include <Arduino.h>
 #include "config.h"
+#include "logger.h"
 
 // System Operation Modes
 enum SystemMode { MODE_BOOT, MODE_DAY, MODE_NIGHT };
 
-// Structure to hold complete system status
+// Structure to hold complete system status. With several sensors per type
+// the measured fields are channel 0's; every channel is in SensorBank.
 struct SystemStatus {
     float temp;
     float humidity;
     float lux;
     float dust;
     float efficiency;
+    float soiling;      // Camera soiling score 0-100 (NaN = not scored this cycle)
     SystemMode mode;
 };
 
-// Main logic engine: Evaluates inputs and triggers alerts if necessary
-bool evaluateSystemState(SystemStatus status);
+// Every channel of each sensor type, struct-of-arrays: a pass over one
+// quantity walks one contiguous array (rules, statistics, telemetry).
+// Channel i is panel string i; all `channels` entries are filled, a shared
+// sensor repeated. NaN = not measured this cycle.
+struct SensorBank {
+    uint8_t channels;
+    float temp[SENSOR_MAX_CHANNELS];
+    float humidity[SENSOR_MAX_CHANNELS];
+    float lux[SENSOR_MAX_CHANNELS];
+    float dust[SENSOR_MAX_CHANNELS];
+};
+
+// Largest value over the channels (NaN entries skipped; NaN if all are)
+float channelMax(const float* values, uint8_t channels);
+
+// Main logic engine: Evaluates every channel against the ruleset (rules.h)
+// and triggers alerts if necessary. Soiling, efficiency and mode come from
+// `status` and are shared by all channels.
+bool evaluateSystemState(const SystemStatus& status, const SensorBank& bank);
+
+// Whether this cycle's frame should be uploaded: when the soiling score
+// crosses SOILING_UPLOAD_SCORE, or on a cleaning trigger if nothing was scored
+bool shouldUploadFrame(const SystemStatus& status, bool cleaningTriggered);
 
-// Helper to determine Day/Night based on Lux
-SystemMode determineOperationMode(float lux);
+// Helper to determine Day/Night based on Lux. From a known mode it only
+// switches past MODE_LUX_HYSTERESIS on the other side of MIN_LUX_DAY_MODE.
+SystemMode determineOperationMode(float lux, SystemMode current = MODE_BOOT);
+
+// Mode as published on TOPIC_MODE ("DAY_MODE" / "NIGHT_MODE")
+const char* modeName(SystemMode mode);
+
+// Decision state that outlives deep sleep (deep_sleep.h). Times are ages,
+// millis() restarts at every boot.
+struct CoreState {
+    int32_t daysSinceLastClean;
+    uint32_t sinceCleanMs;
+    float lastSoilingScore;
+};
 
-// Helper to format logs
-void logSystem(String message);
+CoreState coreSaveState();
+// `sleptMs`: time between the save and this boot
+void coreRestoreState(const CoreState& state, uint32_t sleptMs);
 
 // Test helper: Force days since clean
 void setDaysSinceClean(int days);
@@ -0,0 +1,58 @@
+#include "deep_sleep.h"
+#include "checksum.h"
+#include <esp_sleep.h>
+#include <stddef.h>
+
+#define SLEEP_MAGIC    0x41524753UL    // "ARGS"
+#define SLEEP_VERSION  4
+
+struct SleepRecord {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t size;              // sizeof(SleepRecord): another layout is a cold boot
+    uint32_t wakes;
+    uint32_t sleepMs;
+    SleepState state;
+    uint32_t crc;               // Over everything above
+};
+
+RTC_DATA_ATTR static SleepRecord rtc;
+static SleepStats stats;
+
+static uint32_t recordCrc(const SleepRecord& r) {
+    return crc32((const uint8_t*)&r, offsetof(SleepRecord, crc));
+}
+
+bool sleepResume(SleepState* state, uint32_t* sleptMs) {
+    memset(&stats, 0, sizeof(stats));
+    bool timerWake = esp_sleep_get_wakeup_cause() == ESP_SLEEP_WAKEUP_TIMER;
+    bool valid = rtc.magic == SLEEP_MAGIC && rtc.version == SLEEP_VERSION && rtc.size == sizeof(rtc) &&
+                 rtc.crc == recordCrc(rtc);
+    if (!timerWake || !valid) {
+        stats.rejected = timerWake;
+        if (stats.rejected) LOG_WARN("💤 Sleep state invalid (CRC or layout): cold boot");
+        rtc.magic = 0;
+        return false;
+    }
+    rtc.magic = 0;              // Used once: a crash before the next sleep boots cold
+    stats.warm = true;
+    stats.wakes = rtc.wakes;
+    stats.sleptMs = rtc.sleepMs;
+    *state = rtc.state;
+    *sleptMs = rtc.sleepMs;
+    return true;
+}
+
+void sleepFor(const SleepState& state, uint32_t ms) {
+    rtc.magic = SLEEP_MAGIC;
+    rtc.version = SLEEP_VERSION;
+    rtc.size = sizeof(rtc);
+    rtc.wakes = stats.wakes + 1;
+    rtc.sleepMs = ms;
+    rtc.state = state;
+    rtc.crc = recordCrc(rtc);
+    esp_sleep_enable_timer_wakeup((uint64_t)ms * 1000ULL);
+    esp_deep_sleep_start();
+}
+
+SleepStats sleepStats() { return stats; }
@@ -0,0 +1,59 @@
+#ifndef DEEP_SLEEP_H
+#define DEEP_SLEEP_H
+
+#include <Arduino.h>
+#include "config.h"
+#include "core.h"
+#include "rules.h"
+#include "report.h"
+#include "sensor_stats.h"
+
+// Deep-sleep duty cycling. Between cycles the device sleeps instead of
+// spinning in loop(). What has to outlive the sleep is kept in RTC slow
+// memory (RTC_DATA_ATTR, see below) with a CRC.
+// setup() resumes from it on a timer wake-up; anything else (power-on, reset,
+// brown-out, a bad CRC or another firmware's layout) is a cold boot with the
+// defaults. Times are kept as ages plus the sleep length, as millis()
+// restarts at every boot.
+//
+// RTC_DATA_ATTR survives a deep sleep and nothing else: the bootloader skips
+// reloading it on a deep-sleep wake-up and reloads it, initialiser or not, on
+// every other boot (esp_restart(), watchdog, panic, brown-out). What has to
+// survive a reset goes in RTC_NOINIT_ATTR memory, which no boot touches. That
+// is garbage after a power-on, so it is only trusted with a magic and a CRC
+// (rules.cpp, net_link.cpp).
+
+struct SleepState {
+    // Acquisition (main.cpp)
+    uint8_t mode;               // SystemMode
+    uint32_t dayCycles;
+    uint32_t statsCycles;
+    uint32_t sinceCycleMs;      // Age of the last cycle when going to sleep
+    uint32_t wakeLeadMs;        // Boot to MQTT connected last time: the sleep ends that much early
+    // Decision (core.h)
+    CoreState core;
+    RulesState rules;
+    // What was last published (report.h)
+    ReportState report;
+    // Aggregates of the interval in progress (sensor_stats.h)
+    uint8_t stats[SENSOR_STATS_STATE_SIZE];
+};
+
+struct SleepStats {
+    bool warm;                  // This boot resumed from RTC memory
+    bool rejected;              // Timer wake-up, but the RTC record was invalid
+    uint32_t wakes;             // Warm boots since the last cold one
+    uint32_t sleptMs;           // Length of the sleep that ended (warm boots)
+};
+
+// First thing in setup(): true on a timer wake-up with a valid record,
+// copied to *state, and *sleptMs set to the sleep length
+bool sleepResume(SleepState* state, uint32_t* sleptMs);
+
+// Saves the state and deep-sleeps for `ms`. Does not return on the device;
+// on the host it returns with the sleep pending (host_sim.h).
+void sleepFor(const SleepState& state, uint32_t ms);
+
+SleepStats sleepStats();
+
+#endif
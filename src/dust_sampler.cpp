@@ -0,0 +1,248 @@
+#include "dust_sampler.h"
+#include <esp_timer.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <atomic>
+
+enum DustPhase : uint8_t { DUST_DARK, DUST_LIT, DUST_READ };
+
+static esp_timer_handle_t dustTimer = nullptr;
+static std::atomic<bool> running(false);
+
+// Sensors, set while stopped
+static uint8_t ledPins[SENSOR_MAX_CHANNELS] = {DUST_LED_PIN};
+static uint8_t voPins[SENSOR_MAX_CHANNELS] = {DUST_VO_PIN};
+static uint8_t channels = 1;
+
+// Timer callback only
+static uint8_t phase = DUST_DARK;
+static uint8_t current = 0;         // Sensor of the pulse in progress
+static int64_t pulseAt = 0;
+static uint32_t periodUs = 1000000UL / DUST_SAMPLE_HZ;
+
+// Shared with the readers, under dustMux. running and callbackBusy change
+// under it too, and the timer is only armed inside it, so a callback in
+// flight cannot re-arm behind stopDustSampler().
+static portMUX_TYPE dustMux = portMUX_INITIALIZER_UNLOCKED;
+static bool callbackBusy = false;
+static uint16_t window[SENSOR_MAX_CHANNELS][DUST_WINDOW];
+static uint32_t written[SENSOR_MAX_CHANNELS];
+static DustSamplerStats stats;
+
+// ============================================================================
+// PULSE (esp_timer callback)
+// ============================================================================
+
+// Ends the callback: arms the next step unless the sampler was stopped
+static void armAt(int64_t at) {
+    int64_t now = esp_timer_get_time();
+    portENTER_CRITICAL(&dustMux);
+    if (running.load()) esp_timer_start_once(dustTimer, at > now ? (uint64_t)(at - now) : 0);
+    callbackBusy = false;
+    portEXIT_CRITICAL(&dustMux);
+}
+
+static void recordRead(uint8_t channel, uint16_t raw, uint32_t offsetUs) {
+    portENTER_CRITICAL(&dustMux);
+    stats.pulses++;
+    if (offsetUs < DUST_PULSE_US) {
+        window[channel][written[channel]++ % DUST_WINDOW] = raw;
+        stats.samples++;
+        if (offsetUs < stats.readOffsetMinUs) stats.readOffsetMinUs = offsetUs;
+        if (offsetUs > stats.readOffsetMaxUs) stats.readOffsetMaxUs = offsetUs;
+    } else {
+        stats.late++;
+    }
+    portEXIT_CRITICAL(&dustMux);
+}
+
+static void onDustTimer(void* arg) {
+    (void)arg;
+    int64_t now = esp_timer_get_time();
+    portENTER_CRITICAL(&dustMux);
+    bool live = running.load();
+    callbackBusy = live;
+    portEXIT_CRITICAL(&dustMux);
+    if (!live) return;          // Fired as it was stopped: the LEDs are already off
+    switch (phase) {
+    case DUST_DARK:
+        digitalWrite(ledPins[current], LOW);    // IR LED on (active low)
+        pulseAt = now;
+        phase = DUST_LIT;
+        armAt(pulseAt + DUST_READ_DELAY_US);
+        break;
+    case DUST_LIT: {
+        uint16_t raw = analogRead(voPins[current]);
+        recordRead(current, raw, (uint32_t)(now - pulseAt));
+        phase = DUST_READ;
+        armAt(pulseAt + DUST_PULSE_US);
+        break;
+    }
+    default: {
+        digitalWrite(ledPins[current], HIGH);
+        phase = DUST_DARK;
+        current = (current + 1) % channels;
+        // Stay on the rate grid; pulses missed while the task was held are skipped
+        int64_t next = pulseAt + periodUs;
+        while (next <= now) next += periodUs;
+        armAt(next);
+        break;
+    }
+    }
+}
+
+bool dustSamplerSetChannels(const uint8_t* leds, const uint8_t* vos, uint8_t n) {
+    if (n == 0 || n > SENSOR_MAX_CHANNELS) return false;
+    stopDustSampler();
+    memcpy(ledPins, leds, n);
+    memcpy(voPins, vos, n);
+    channels = n;
+    for (uint8_t i = 0; i < n; i++) {
+        pinMode(ledPins[i], OUTPUT);
+        digitalWrite(ledPins[i], HIGH);
+    }
+    return true;
+}
+
+bool startDustSampler(uint16_t rateHz) {
+    // One LED lit at a time: every sensor gets rateHz pulses a second
+    if (rateHz == 0 || 1000000UL / ((uint32_t)rateHz * channels) <= DUST_PULSE_US) return false;
+    if (!dustTimer) {
+        esp_timer_create_args_t args = {};
+        args.callback = onDustTimer;
+        args.dispatch_method = ESP_TIMER_TASK;
+        args.name = "dust";
+        if (esp_timer_create(&args, &dustTimer) != ESP_OK) return false;
+    }
+    stopDustSampler();
+
+    periodUs = 1000000UL / ((uint32_t)rateHz * channels);
+    phase = DUST_DARK;
+    current = 0;
+    portENTER_CRITICAL(&dustMux);
+    memset(written, 0, sizeof(written));
+    memset(&stats, 0, sizeof(stats));
+    stats.readOffsetMinUs = UINT32_MAX;
+    running.store(true);
+    bool ok = esp_timer_start_once(dustTimer, 0) == ESP_OK;
+    if (!ok) running.store(false);
+    portEXIT_CRITICAL(&dustMux);
+    return ok;
+}
+
+void stopDustSampler() {
+    portENTER_CRITICAL(&dustMux);
+    running.store(false);
+    if (dustTimer) esp_timer_stop(dustTimer);
+    bool busy = callbackBusy;
+    portEXIT_CRITICAL(&dustMux);
+    // A callback already running on the other core finishes its step (and
+    // does not re-arm) before the pins and the pulse state are reset
+    while (busy) {
+        vTaskDelay(1);
+        portENTER_CRITICAL(&dustMux);
+        busy = callbackBusy;
+        portEXIT_CRITICAL(&dustMux);
+    }
+    for (uint8_t i = 0; i < channels; i++) {
+        pinMode(ledPins[i], OUTPUT);
+        digitalWrite(ledPins[i], HIGH);
+    }
+}
+
+DustSamplerStats dustSamplerStats() {
+    portENTER_CRITICAL(&dustMux);
+    DustSamplerStats s = stats;
+    portEXIT_CRITICAL(&dustMux);
+    if (!s.samples) s.readOffsetMinUs = 0;
+    return s;
+}
+
+// ============================================================================
+// FILTERS (reader side)
+// ============================================================================
+
+float dustDensityFromAdc(uint16_t raw) {
+    float voltage = raw * (3.3f / 4095.0f);
+    if (voltage < 0.1f) voltage = 0.1f;
+    float density = (0.17f * voltage - 0.1f) * 1000.0f * DUST_CALIB;
+    return density < 0 ? 0 : density;
+}
+
+static void sortAscending(float* v, uint16_t n) {
+    for (uint16_t i = 1; i < n; i++) {
+        float x = v[i];
+        uint16_t j = i;
+        for (; j > 0 && v[j - 1] > x; j--) v[j] = v[j - 1];
+        v[j] = x;
+    }
+}
+
+static float sortedMedian(const float* v, uint16_t n) {
+    return (n & 1) ? v[n / 2] : (v[n / 2 - 1] + v[n / 2]) * 0.5f;
+}
+
+void filterDust(float* samples, uint16_t n, DustReading* out) {
+    memset(out, 0, sizeof(*out));
+    if (n > DUST_WINDOW) n = DUST_WINDOW;
+    if (n == 0) return;
+
+    sortAscending(samples, n);
+    float sum = 0;
+    for (uint16_t i = 0; i < n; i++) sum += samples[i];
+    out->mean = sum / n;
+    out->median = sortedMedian(samples, n);
+
+    // Hampel: band of DUST_OUTLIER_MADS median absolute deviations (x1.4826 ~ sigma).
+    // The samples are sorted, so the deviations grow outwards from the
+    // median: merging both sides gives them in order without a second sort.
+    float deviation[DUST_WINDOW];
+    int right = 0;
+    while (right < n && samples[right] < out->median) right++;
+    int left = right - 1;
+    for (uint16_t i = 0; i < n; i++) {
+        float below = left >= 0 ? out->median - samples[left] : INFINITY;
+        float above = right < n ? samples[right] - out->median : INFINITY;
+        if (below <= above) {
+            deviation[i] = below;
+            left--;
+        } else {
+            deviation[i] = above;
+            right++;
+        }
+    }
+    float band = DUST_OUTLIER_MADS * 1.4826f * sortedMedian(deviation, n);
+    if (band < DUST_OUTLIER_FLOOR) band = DUST_OUTLIER_FLOOR;
+
+    float kept = 0;
+    uint16_t keptCount = 0;
+    for (uint16_t i = 0; i < n; i++) {
+        if (fabsf(samples[i] - out->median) <= band) {
+            kept += samples[i];
+            keptCount++;
+        }
+    }
+    out->filtered = keptCount ? kept / keptCount : out->median;
+    out->count = n;
+    out->rejected = n - keptCount;
+}
+
+bool readDust(DustReading* out, uint8_t channel) {
+    uint16_t raw[DUST_WINDOW];
+    uint32_t n = 0;
+    portENTER_CRITICAL(&dustMux);
+    if (channel < channels) {
+        n = written[channel] < DUST_WINDOW ? written[channel] : DUST_WINDOW;
+        memcpy(raw, window[channel], n * sizeof(raw[0]));
+    }
+    portEXIT_CRITICAL(&dustMux);
+    if (n == 0) {
+        memset(out, 0, sizeof(*out));
+        return false;
+    }
+
+    float samples[DUST_WINDOW];
+    for (uint32_t i = 0; i < n; i++) samples[i] = dustDensityFromAdc(raw[i]);
+    filterDust(samples, (uint16_t)n, out);
+    return true;
+}
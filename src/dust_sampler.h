@@ -0,0 +1,53 @@
+#ifndef DUST_SAMPLER_H
+#define DUST_SAMPLER_H
+
+#include <Arduino.h>
+#include "config.h"
+
+// Background GP2Y1010 sampler. A one-shot esp_timer is re-armed through the
+// datasheet pulse: LED on, ADC read DUST_READ_DELAY_US later, LED off at
+// DUST_PULSE_US, next pulse on the DUST_SAMPLE_HZ grid. The callbacks run in
+// the esp_timer task (top priority, core 0), not in an ISR: analogRead() takes
+// the ADC driver lock. Readers only copy the sample window and filter it.
+// With several sensors the pulses take turns (one LED lit at a time), each
+// sensor keeping its own window and rate.
+
+struct DustReading {
+    float mean;         // ug/m3, every read in the window
+    float median;
+    float filtered;     // Mean of the reads within the outlier band around the median
+    uint16_t count;     // Reads in the window
+    uint16_t rejected;  // Outliers left out of `filtered`
+};
+
+// Over all sensors
+struct DustSamplerStats {
+    uint32_t pulses;
+    uint32_t samples;           // Reads taken while the LED was lit
+    uint32_t late;              // Reads after DUST_PULSE_US, dropped
+    uint32_t readOffsetMinUs;   // LED on to ADC read, over the kept reads
+    uint32_t readOffsetMaxUs;
+};
+
+// Sensors to pulse, in turn (stops the sampler). DUST_LED_PIN/DUST_VO_PIN
+// until called.
+bool dustSamplerSetChannels(const uint8_t* ledPins, const uint8_t* voPins, uint8_t channels);
+
+// Starts (or restarts, with empty windows) pulsing each sensor at `rateHz`.
+// False if the pulses of all sensors don't fit in 1 / rateHz.
+bool startDustSampler(uint16_t rateHz = DUST_SAMPLE_HZ);
+void stopDustSampler();
+
+// Filters the current window of a sensor. False until its first read.
+bool readDust(DustReading* out, uint8_t channel = 0);
+
+// Mean, median and outlier-rejected mean of `n` densities (sorts `samples`,
+// n up to DUST_WINDOW)
+void filterDust(float* samples, uint16_t n, DustReading* out);
+
+// GP2Y1010 transfer function (12-bit read at 3.3 V full scale), DUST_CALIB applied
+float dustDensityFromAdc(uint16_t raw);
+
+DustSamplerStats dustSamplerStats();
+
+#endif
@@ -0,0 +1,360 @@
+#include "image_delta.h"
+#include "soiling.h"
+#include "checksum.h"
+#include "logger.h"
+#include "img_converters.h"
+#include <esp_partition.h>
+
+#define HASH_SIZE      (DELTA_HASH_CELLS * DELTA_HASH_CELLS)
+#define NO_SLOT        0xFF
+#define MAX_CHANGED    (DELTA_MAX_TILES * DELTA_KEYFRAME_PERCENT / 100)
+#define TILE_BYTES     ((size_t)DELTA_TILE_PX * DELTA_TILE_PX * 3)
+#define CONTAINER_MAX  (DELTA_HEADER_SIZE + 2 * DELTA_MAX_TILES + DELTA_MAX_KEYFRAME)
+
+// Persisted keyframe: [magic u32][container length u32][crc32 u32][tiles u16][0 u16]
+// tile hashes, container. Written body first, header last.
+#define REF_MAGIC      0x46455241u  // "AREF"
+#define REF_HEADER     16
+
+struct TileGrid {
+    uint16_t width;
+    uint16_t height;
+    uint8_t cols;
+    uint8_t rows;
+    uint16_t count;
+};
+
+static uint8_t grayPixels[SOILING_GRID_W * SOILING_GRID_H];
+static uint8_t frameHashes[DELTA_MAX_TILES][HASH_SIZE];
+static uint8_t keyHashes[DELTA_MAX_TILES][HASH_SIZE];    // Of the keyframe being sent
+static uint8_t refHashes[DELTA_MAX_TILES][HASH_SIZE];
+static uint8_t* reference = nullptr;    // Keyframe container (PSRAM)
+static size_t referenceLen = 0;
+static uint8_t* pending = nullptr;      // Container being sent (PSRAM)
+static uint8_t* atlas = nullptr;        // Changed tiles, BGR888 as fmt2jpg_cb takes it (PSRAM)
+static const esp_partition_t* partition = nullptr;
+
+static inline uint16_t get16(const uint8_t* p) { return (uint16_t)(p[0] | (p[1] << 8)); }
+static inline uint32_t get32(const uint8_t* p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+static inline void put16(uint8_t* p, uint16_t v) { p[0] = (uint8_t)v; p[1] = (uint8_t)(v >> 8); }
+static inline void put32(uint8_t* p, uint32_t v) { put16(p, (uint16_t)v); put16(p + 2, (uint16_t)(v >> 16)); }
+
+// Frame size from the SOF marker, without decoding
+static bool jpegSize(const uint8_t* jpeg, size_t len, uint16_t* w, uint16_t* h) {
+    if (len < 4 || jpeg[0] != 0xFF || jpeg[1] != 0xD8) return false;
+    size_t i = 2;
+    while (i + 9 < len) {
+        if (jpeg[i] != 0xFF) return false;
+        uint8_t marker = jpeg[i + 1];
+        if (marker == 0xFF) {       // Fill byte
+            i++;
+            continue;
+        }
+        if (marker >= 0xC0 && marker <= 0xCF && marker != 0xC4 && marker != 0xC8 && marker != 0xCC) {
+            *h = (uint16_t)((jpeg[i + 5] << 8) | jpeg[i + 6]);
+            *w = (uint16_t)((jpeg[i + 7] << 8) | jpeg[i + 8]);
+            return *w && *h;
+        }
+        i += 2 + ((jpeg[i + 2] << 8) | jpeg[i + 3]);
+    }
+    return false;
+}
+
+static bool tileGrid(uint16_t width, uint16_t height, TileGrid* out) {
+    out->width = width;
+    out->height = height;
+    uint16_t cols = (uint16_t)((width + DELTA_TILE_PX - 1) / DELTA_TILE_PX);
+    uint16_t rows = (uint16_t)((height + DELTA_TILE_PX - 1) / DELTA_TILE_PX);
+    out->cols = (uint8_t)cols;
+    out->rows = (uint8_t)rows;
+    out->count = (uint16_t)(cols * rows);
+    return out->count > 0 && out->count <= DELTA_MAX_TILES;
+}
+
+// Cell means per tile. Cell edges fall between grid pixels on a 1/8 grid
+// (10 grid pixels per tile on VGA); every cell gets at least one.
+static void hashTiles(const GrayGrid& gray, const TileGrid& grid) {
+    for (uint16_t t = 0; t < grid.count; t++) {
+        uint32_t tx0 = (uint32_t)(t % grid.cols) * DELTA_TILE_PX;
+        uint32_t ty0 = (uint32_t)(t / grid.cols) * DELTA_TILE_PX;
+        for (uint8_t cy = 0; cy < DELTA_HASH_CELLS; cy++) {
+            uint16_t y0 = (uint16_t)((ty0 + cy * DELTA_TILE_PX / DELTA_HASH_CELLS) / gray.scale);
+            uint16_t y1 = (uint16_t)((ty0 + (cy + 1) * DELTA_TILE_PX / DELTA_HASH_CELLS) / gray.scale);
+            if (y0 >= gray.h) y0 = gray.h - 1;
+            if (y1 > gray.h) y1 = gray.h;
+            if (y1 <= y0) y1 = y0 + 1;
+            for (uint8_t cx = 0; cx < DELTA_HASH_CELLS; cx++) {
+                uint16_t x0 = (uint16_t)((tx0 + cx * DELTA_TILE_PX / DELTA_HASH_CELLS) / gray.scale);
+                uint16_t x1 = (uint16_t)((tx0 + (cx + 1) * DELTA_TILE_PX / DELTA_HASH_CELLS) / gray.scale);
+                if (x0 >= gray.w) x0 = gray.w - 1;
+                if (x1 > gray.w) x1 = gray.w;
+                if (x1 <= x0) x1 = x0 + 1;
+                uint32_t sum = 0;
+                for (uint16_t y = y0; y < y1; y++) {
+                    const uint8_t* row = gray.pixels + (size_t)y * gray.w;
+                    for (uint16_t x = x0; x < x1; x++) sum += row[x];
+                }
+                frameHashes[t][cy * DELTA_HASH_CELLS + cx] = (uint8_t)(sum / ((uint32_t)(y1 - y0) * (x1 - x0)));
+            }
+        }
+    }
+}
+
+static bool tileChanged(uint16_t t) {
+    for (uint8_t i = 0; i < HASH_SIZE; i++) {
+        int d = (int)frameHashes[t][i] - refHashes[t][i];
+        if (d > DELTA_CELL_LEVELS || d < -DELTA_CELL_LEVELS) return true;
+    }
+    return false;
+}
+
+static void writeHeader(uint8_t* out, uint8_t kind, uint16_t keyframeId, const TileGrid& grid, uint32_t hash,
+                        uint16_t changed) {
+    memcpy(out, DELTA_MAGIC, 4);
+    out[4] = DELTA_VERSION;
+    out[5] = kind;
+    put16(out + 6, keyframeId);
+    put16(out + 8, grid.width);
+    put16(out + 10, grid.height);
+    put16(out + 12, DELTA_TILE_PX);
+    out[14] = grid.cols;
+    out[15] = grid.rows;
+    put32(out + 16, hash);
+    put16(out + 20, changed);
+    put16(out + 22, 0);
+}
+
+// --- Full-scale decode of the changed tiles into the atlas ---
+
+struct TileDecoder {
+    const uint8_t* jpeg;
+    size_t len;
+    const TileGrid* grid;
+    uint8_t slot[DELTA_MAX_TILES];  // Atlas position per tile, NO_SLOT if unchanged
+    uint16_t lastRow;               // Below this no tile changed
+    bool done;
+};
+
+static size_t readJpeg(void* arg, size_t index, uint8_t* buf, size_t len) {
+    TileDecoder* d = (TileDecoder*)arg;
+    if (index >= d->len) return 0;
+    if (len > d->len - index) len = d->len - index;
+    if (buf) memcpy(buf, d->jpeg + index, len);
+    return len;
+}
+
+static bool writeTiles(void* arg, uint16_t x, uint16_t y, uint16_t w, uint16_t h, uint8_t* data) {
+    TileDecoder* d = (TileDecoder*)arg;
+    if (!data) return true;
+    const TileGrid& g = *d->grid;
+    for (uint16_t row = 0; row < h && y + row < g.height; row++) {
+        uint16_t py = y + row;
+        const uint8_t* rgb = data + (size_t)row * w * 3;
+        const uint8_t* slots = d->slot + (py / DELTA_TILE_PX) * g.cols;
+        uint16_t px = x;
+        while (px < x + w && px < g.width) {
+            uint16_t tx = px / DELTA_TILE_PX;
+            uint16_t end = (uint16_t)((tx + 1) * DELTA_TILE_PX);
+            if (end > x + w) end = x + w;
+            if (end > g.width) end = g.width;
+            if (slots[tx] != NO_SLOT) {
+                uint8_t* dst = atlas + (((size_t)slots[tx] * DELTA_TILE_PX + py % DELTA_TILE_PX) * DELTA_TILE_PX +
+                                        px % DELTA_TILE_PX) * 3;
+                const uint8_t* src = rgb + (size_t)(px - x) * 3;
+                for (uint16_t n = end - px; n; n--, dst += 3, src += 3) {
+                    dst[0] = src[2];
+                    dst[1] = src[1];
+                    dst[2] = src[0];
+                }
+            }
+            px = end;
+        }
+    }
+    // Blocks arrive left to right, top to bottom: stop after the last
+    // changed tile row instead of decoding the rest of the frame
+    if (x + w >= g.width && y + h >= d->lastRow && d->lastRow < g.height) {
+        d->done = true;
+        return false;
+    }
+    return true;
+}
+
+struct TileSink {
+    uint8_t* out;
+    size_t cap;
+    size_t len;
+};
+
+// fmt2jpg_cb() output; taking less than offered stops the encoder
+static size_t writeTileJpeg(void* arg, size_t index, const void* data, size_t n) {
+    TileSink* sink = (TileSink*)arg;
+    if (index != sink->len || n > sink->cap - sink->len) return 0;
+    memcpy(sink->out + sink->len, data, n);
+    sink->len += n;
+    return n;
+}
+
+static bool encodeTiles(const uint8_t* jpeg, size_t len, const TileGrid& grid, const uint8_t* slot,
+                        uint16_t changed, DeltaFrame* out) {
+    TileDecoder d;
+    d.jpeg = jpeg;
+    d.len = len;
+    d.grid = &grid;
+    d.done = false;
+    d.lastRow = 0;
+    memcpy(d.slot, slot, sizeof(d.slot));
+    for (uint16_t t = 0; t < grid.count; t++) {
+        if (slot[t] != NO_SLOT) d.lastRow = (uint16_t)((t / grid.cols + 1) * DELTA_TILE_PX);
+    }
+    memset(atlas, 0, changed * TILE_BYTES);     // Edge tiles past the frame stay black
+    if (esp_jpg_decode(len, JPG_SCALE_NONE, readJpeg, writeTiles, &d) != ESP_OK && !d.done) return false;
+
+    // Encoded straight into the container after its header: no encoder
+    // output buffer. Not worth it when the tiles come out as large as the frame.
+    size_t headLen = DELTA_HEADER_SIZE + 2 * (size_t)changed;
+    TileSink sink;
+    sink.out = pending + headLen;
+    sink.cap = CONTAINER_MAX - headLen < len - 1 ? CONTAINER_MAX - headLen : len - 1;
+    sink.len = 0;
+    if (!fmt2jpg_cb(atlas, changed * TILE_BYTES, DELTA_TILE_PX, (uint16_t)(changed * DELTA_TILE_PX), PIXFORMAT_RGB888,
+                    DELTA_TILE_QUALITY, writeTileJpeg, &sink)) {
+        return false;
+    }
+    writeHeader(pending, DELTA_TILES, out->keyframeId, grid, out->contentHash, changed);
+    for (uint16_t t = 0; t < grid.count; t++) {
+        if (slot[t] != NO_SLOT) put16(pending + DELTA_HEADER_SIZE + 2 * slot[t], t);
+    }
+    out->kind = DELTA_TILES;
+    out->changed = changed;
+    out->payload = pending;
+    out->payloadLen = headLen + sink.len;
+    return true;
+}
+
+static bool encodeKeyframe(const uint8_t* jpeg, size_t len, const TileGrid& grid, DeltaFrame* out) {
+    if (len > DELTA_MAX_KEYFRAME) return false;
+    uint16_t id = (uint16_t)(out->keyframeId + 1);
+    if (id == 0) id = 1;
+    writeHeader(pending, DELTA_KEYFRAME, id, grid, out->contentHash, 0);
+    memcpy(pending + DELTA_HEADER_SIZE, jpeg, len);
+    memcpy(keyHashes, frameHashes, sizeof(keyHashes));
+    out->kind = DELTA_KEYFRAME;
+    out->keyframeId = id;
+    out->changed = grid.count;
+    out->payload = pending;
+    out->payloadLen = DELTA_HEADER_SIZE + len;
+    return true;
+}
+
+// --- Persistence ---
+
+static void saveReference(uint16_t tiles) {
+    if (!partition) return;
+    size_t hashLen = (size_t)tiles * HASH_SIZE;
+    size_t total = REF_HEADER + hashLen + referenceLen;
+    size_t erase = (total + SPI_FLASH_SEC_SIZE - 1) / SPI_FLASH_SEC_SIZE * SPI_FLASH_SEC_SIZE;
+    if (erase > partition->size) {
+        LOG_WARN("🧩 Keyframe too large to persist (%u bytes)", (unsigned)total);
+        return;
+    }
+    uint8_t head[REF_HEADER];
+    put32(head, REF_MAGIC);
+    put32(head + 4, (uint32_t)referenceLen);
+    put32(head + 8, crc32Update(crc32(&refHashes[0][0], hashLen), reference, referenceLen));
+    put16(head + 12, tiles);
+    put16(head + 14, 0);
+    bool ok = esp_partition_erase_range(partition, 0, erase) == ESP_OK &&
+              esp_partition_write(partition, REF_HEADER, &refHashes[0][0], hashLen) == ESP_OK &&
+              esp_partition_write(partition, REF_HEADER + hashLen, reference, referenceLen) == ESP_OK &&
+              esp_partition_write(partition, 0, head, sizeof(head)) == ESP_OK;
+    if (!ok) LOG_WARN("🧩 Keyframe not persisted");
+}
+
+static bool loadReference() {
+    uint8_t head[REF_HEADER];
+    if (esp_partition_read(partition, 0, head, sizeof(head)) != ESP_OK || get32(head) != REF_MAGIC) return false;
+    size_t len = get32(head + 4);
+    uint16_t tiles = get16(head + 12);
+    size_t hashLen = (size_t)tiles * HASH_SIZE;
+    if (len < DELTA_HEADER_SIZE || len > CONTAINER_MAX || tiles == 0 || tiles > DELTA_MAX_TILES) return false;
+    if (esp_partition_read(partition, REF_HEADER, &refHashes[0][0], hashLen) != ESP_OK ||
+        esp_partition_read(partition, REF_HEADER + hashLen, reference, len) != ESP_OK) {
+        return false;
+    }
+    if (crc32Update(crc32(&refHashes[0][0], hashLen), reference, len) != get32(head + 8) ||
+        memcmp(reference, DELTA_MAGIC, 4) != 0 || reference[5] != DELTA_KEYFRAME ||
+        (uint16_t)(reference[14] * reference[15]) != tiles) {
+        return false;
+    }
+    referenceLen = len;
+    return true;
+}
+
+void initImageDelta() {
+    if (!psramFound()) {
+        LOG_WARN("🧩 No PSRAM: frames go out whole");
+        return;
+    }
+    if (!reference) reference = (uint8_t*)ps_malloc(CONTAINER_MAX);
+    if (!pending) pending = (uint8_t*)ps_malloc(CONTAINER_MAX);
+    if (!atlas) atlas = (uint8_t*)ps_malloc(MAX_CHANGED * TILE_BYTES);
+    if (!reference || !pending || !atlas) {
+        LOG_ERROR("❌ Delta upload buffers failed");
+        return;
+    }
+    referenceLen = 0;
+    partition = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, DELTA_PARTITION_LABEL);
+    if (partition && loadReference()) {
+        LOG_INFO("🧩 Keyframe %u restored (%u bytes)", (unsigned)get16(reference + 6), (unsigned)referenceLen);
+    }
+}
+
+bool imageDeltaEncode(const uint8_t* jpeg, size_t len, DeltaFrame* out) {
+    memset(out, 0, sizeof(*out));
+    if (!reference || !pending || !atlas) return false;
+    TileGrid grid;
+    uint16_t width, height;
+    if (!jpegSize(jpeg, len, &width, &height) || !tileGrid(width, height, &grid)) return false;
+    GrayGrid gray;
+    if (!decodeGrayGrid(jpeg, len, grayPixels, &gray)) return false;
+    hashTiles(gray, grid);
+    out->tiles = grid.count;
+    out->contentHash = crc32(&frameHashes[0][0], (size_t)grid.count * HASH_SIZE);
+
+    bool haveReference = referenceLen && get16(reference + 8) == width && get16(reference + 10) == height &&
+                         get16(reference + 12) == DELTA_TILE_PX;
+    if (referenceLen) out->keyframeId = get16(reference + 6);
+    if (!haveReference) return encodeKeyframe(jpeg, len, grid, out);
+
+    uint8_t slot[DELTA_MAX_TILES];
+    uint16_t changed = 0;
+    for (uint16_t t = 0; t < DELTA_MAX_TILES; t++) {
+        slot[t] = t < grid.count && tileChanged(t) ? (uint8_t)changed++ : NO_SLOT;
+    }
+    if (changed == 0) {
+        out->kind = DELTA_UNCHANGED;
+        return true;
+    }
+    if (changed <= MAX_CHANGED && changed * 100 <= grid.count * DELTA_KEYFRAME_PERCENT &&
+        encodeTiles(jpeg, len, grid, slot, changed, out)) {
+        return true;
+    }
+    return encodeKeyframe(jpeg, len, grid, out);
+}
+
+void imageDeltaDelivered(const DeltaFrame& frame) {
+    if (frame.kind != DELTA_KEYFRAME || frame.payload != pending) return;
+    memcpy(refHashes, keyHashes, sizeof(refHashes));
+    uint8_t* previous = reference;
+    reference = pending;
+    pending = previous;
+    referenceLen = frame.payloadLen;
+    saveReference(frame.tiles);
+}
+
+const uint8_t* imageDeltaKeyframe(size_t* len) {
+    *len = referenceLen;
+    return referenceLen ? reference : nullptr;
+}
@@ -0,0 +1,75 @@
+#ifndef IMAGE_DELTA_H
+#define IMAGE_DELTA_H
+
+#include <Arduino.h>
+#include "config.h"
+
+// Delta upload of camera frames against a reference keyframe.
+//
+// The frame is cut into DELTA_TILE_PX tiles. Each tile has a perceptual hash:
+// DELTA_HASH_CELLS x DELTA_HASH_CELLS cell means taken from the 1/8-scale
+// grayscale decode (soiling.h), so a hash costs no full decode and ignores
+// sensor noise and JPEG re-encoding. A tile has changed when any cell moved
+// more than DELTA_CELL_LEVELS from the keyframe. Then:
+//
+//   no tile changed    only the content hash goes out (camera/control JSON)
+//   some changed       the changed tiles, decoded at full scale, stacked into
+//                      one DELTA_TILE_PX-wide atlas and re-encoded (fmt2jpg_cb)
+//   too many changed   the frame itself becomes the new keyframe
+//
+// Deltas are always against the keyframe, never the previous delta, so a lost
+// or late (offline queued) delta never corrupts the next reconstruction.
+// The keyframe is kept in PSRAM and in the DELTA_PARTITION_LABEL partition,
+// so deltas continue after a reboot; "key" on camera/request resends it.
+//
+// Containers travel as images (publishImage), little-endian:
+//   off size field
+//    0   4   magic "ADLT"
+//    4   1   version (DELTA_VERSION)
+//    5   1   kind (DELTA_KEYFRAME / DELTA_TILES)
+//    6   2   keyframe id
+//    8   2   frame width
+//   10   2   frame height
+//   12   2   tile size (pixels)
+//   14   1   tile columns
+//   15   1   tile rows
+//   16   4   content hash (CRC-32 of the tile hashes)
+//   20   2   changed tile count n (0 for a keyframe)
+//   22   2   reserved
+//   24   2n  changed tile indices, row-major, in atlas order
+//   ..       JPEG: the keyframe, or the atlas (tile size x n tiles high)
+
+#define DELTA_MAGIC       "ADLT"
+#define DELTA_VERSION     1
+#define DELTA_HEADER_SIZE 24
+
+enum DeltaKind : uint8_t {
+    DELTA_KEYFRAME = 1,
+    DELTA_TILES,
+    DELTA_UNCHANGED     // No container: the content hash is the whole message
+};
+
+struct DeltaFrame {
+    uint8_t kind;
+    uint16_t keyframeId;
+    uint32_t contentHash;
+    uint16_t tiles;
+    uint16_t changed;
+    const uint8_t* payload;     // Container (valid until the next encode)
+    size_t payloadLen;
+};
+
+// Allocates the PSRAM buffers and loads the persisted keyframe
+void initImageDelta();
+
+// False when the frame cannot go as a delta (no PSRAM, not decodable, too
+// large): send the JPEG as it is
+bool imageDeltaEncode(const uint8_t* jpeg, size_t len, DeltaFrame* out);
+
+// Call once a frame was delivered: a keyframe becomes the reference
+void imageDeltaDelivered(const DeltaFrame& frame);
+
+// Current keyframe container, nullptr if there is none yet
+const uint8_t* imageDeltaKeyframe(size_t* len);
+
+#endif
@@ -0,0 +1,111 @@
+#include "image_transfer.h"
+
+static inline void put16(uint8_t* p, uint16_t v) { p[0] = (uint8_t)v; p[1] = (uint8_t)(v >> 8); }
+static inline uint16_t get16(const uint8_t* p) { return (uint16_t)(p[0] | (p[1] << 8)); }
+
+size_t encodeImageChunkHeader(const ImageChunkHeader& h, uint8_t* out, size_t size) {
+    if (size < IMG_CHUNK_HEADER_SIZE) return 0;
+    out[0] = IMG_PROTOCOL_VERSION;
+    out[1] = h.flags;
+    put16(out + 2, h.imageId);
+    put16(out + 4, h.index);
+    put16(out + 6, h.count);
+    put16(out + 8, (uint16_t)h.crc);
+    put16(out + 10, (uint16_t)(h.crc >> 16));
+    return IMG_CHUNK_HEADER_SIZE;
+}
+
+bool decodeImageChunkHeader(const uint8_t* data, size_t len, ImageChunkHeader* out) {
+    if (len < IMG_CHUNK_HEADER_SIZE || data[0] != IMG_PROTOCOL_VERSION) return false;
+    out->flags = data[1];
+    out->imageId = get16(data + 2);
+    out->index = get16(data + 4);
+    out->count = get16(data + 6);
+    out->crc = (uint32_t)get16(data + 8) | ((uint32_t)get16(data + 10) << 16);
+    return out->index < out->count;
+}
+
+size_t encodeImageAck(uint8_t type, uint16_t imageId, const ImageAckRange* ranges, uint8_t count,
+                      uint8_t* out, size_t size) {
+    size_t len = IMG_ACK_HEADER_SIZE + 4 * (size_t)count;
+    if (size < len) return 0;
+    out[0] = type;
+    out[1] = count;
+    put16(out + 2, imageId);
+    for (uint8_t i = 0; i < count; i++) {
+        put16(out + 4 + 4 * i, ranges[i].first);
+        put16(out + 6 + 4 * i, ranges[i].last);
+    }
+    return len;
+}
+
+void imageSenderStart(ImageSender& s, uint16_t imageId, uint16_t count) {
+    s.active = true;
+    s.imageId = imageId;
+    s.count = count > IMG_MAX_CHUNKS ? IMG_MAX_CHUNKS : count;
+    s.nextNew = 0;
+    s.acked = 0;
+    s.resent = 0;
+    memset(s.state, 0, sizeof(s.state));
+}
+
+int imageSenderNext(ImageSender& s, uint32_t now) {
+    if (!s.active) return -1;
+    uint16_t inFlight = 0;
+    int nacked = -1;
+    int expired = -1;
+    for (uint16_t i = 0; i < s.nextNew; i++) {
+        uint8_t st = s.state[i];
+        if (st & IMG_STATE_ACKED) continue;
+        if (st & IMG_STATE_NACKED) {
+            if (nacked < 0) nacked = i;
+        } else if (now - s.sentAt[i] >= IMG_RETRY_MS) {
+            if (expired < 0) expired = i;
+        } else {
+            inFlight++;
+        }
+    }
+    if (inFlight >= IMG_WINDOW) return -1;
+    if (nacked >= 0) return nacked;
+    if (expired >= 0) return expired;
+    if (s.nextNew < s.count) return s.nextNew;
+    return -1;
+}
+
+void imageSenderSent(ImageSender& s, uint16_t index, uint32_t now) {
+    if (index >= s.count) return;
+    if (index == s.nextNew) {
+        s.nextNew++;
+    } else {
+        s.resent++;
+    }
+    s.state[index] = (uint8_t)((s.state[index] | IMG_STATE_SENT) & ~IMG_STATE_NACKED);
+    s.sentAt[index] = now;
+}
+
+bool imageSenderApplyAck(ImageSender& s, const uint8_t* payload, size_t len) {
+    if (!s.active || len < IMG_ACK_HEADER_SIZE) return false;
+    uint8_t type = payload[0];
+    uint8_t ranges = payload[1];
+    if (get16(payload + 2) != s.imageId) return false;
+    if ((type != IMG_ACK_RANGES && type != IMG_NACK_RANGES) || len < IMG_ACK_HEADER_SIZE + 4 * (size_t)ranges) {
+        return false;
+    }
+
+    for (uint8_t r = 0; r < ranges; r++) {
+        uint16_t first = get16(payload + 4 + 4 * r);
+        uint16_t last = get16(payload + 6 + 4 * r);
+        if (last >= s.count) last = s.count - 1;
+        for (uint32_t i = first; i <= last; i++) {
+            uint8_t& st = s.state[i];
+            if ((st & IMG_STATE_ACKED) || !(st & IMG_STATE_SENT)) continue;
+            if (type == IMG_ACK_RANGES) {
+                st = (uint8_t)((st | IMG_STATE_ACKED) & ~IMG_STATE_NACKED);
+                s.acked++;
+            } else {
+                st |= IMG_STATE_NACKED;
+            }
+        }
+    }
+    return true;
+}
@@ -0,0 +1,87 @@
+#ifndef IMAGE_TRANSFER_H
+#define IMAGE_TRANSFER_H
+
+#include <Arduino.h>
+#include "config.h"
+
+// Windowed, acknowledged image transfer.
+//
+// camera/control   {"status":"start","id":N,"size":B,"chunks":C,"chunk_size":S,"crc":X}
+//                  {"status":"end","id":N,"chunks":C,"resent":R,"ms":T}   (after every chunk is ACKed)
+//
+// camera/image_chunk (little-endian, 12-byte header + data):
+//   off size field
+//    0   1   version (IMG_PROTOCOL_VERSION)
+//    1   1   flags (IMG_CHUNK_FLAG_*)
+//    2   2   image id
+//    4   2   chunk index
+//    6   2   chunk count
+//    8   4   CRC-32 of the chunk data
+//
+// camera/ack (receiver -> device):
+//    0   1   type: 'A' = ranges received, 'N' = ranges missing (resend now)
+//    1   1   range count
+//    2   2   image id
+//    4   4n  ranges [first u16][last u16], inclusive
+//
+// The device keeps up to IMG_WINDOW unacknowledged chunks in flight, resends
+// NACKed chunks first, and resends any chunk not ACKed within IMG_RETRY_MS.
+
+#define IMG_PROTOCOL_VERSION   1
+#define IMG_CHUNK_HEADER_SIZE  12
+#define IMG_CHUNK_FLAG_RESEND  0x01
+
+#define IMG_ACK_RANGES         'A'
+#define IMG_NACK_RANGES        'N'
+#define IMG_ACK_HEADER_SIZE    4
+
+struct ImageChunkHeader {
+    uint8_t flags;
+    uint16_t imageId;
+    uint16_t index;
+    uint16_t count;
+    uint32_t crc;
+};
+
+struct ImageAckRange {
+    uint16_t first;
+    uint16_t last;
+};
+
+size_t encodeImageChunkHeader(const ImageChunkHeader& h, uint8_t* out, size_t size);
+bool decodeImageChunkHeader(const uint8_t* data, size_t len, ImageChunkHeader* out);
+
+// Returns bytes written, 0 if the buffer is too small
+size_t encodeImageAck(uint8_t type, uint16_t imageId, const ImageAckRange* ranges, uint8_t count,
+                      uint8_t* out, size_t size);
+
+// --- Sender bookkeeping (no I/O; mqtt_driver does the publishing) ---
+
+#define IMG_STATE_SENT    0x01
+#define IMG_STATE_ACKED   0x02
+#define IMG_STATE_NACKED  0x04
+
+struct ImageSender {
+    bool active;
+    uint16_t imageId;
+    uint16_t count;
+    uint16_t nextNew;       // First chunk never sent
+    uint16_t acked;
+    uint32_t resent;
+    uint8_t state[IMG_MAX_CHUNKS];
+    uint32_t sentAt[IMG_MAX_CHUNKS];
+};
+
+void imageSenderStart(ImageSender& s, uint16_t imageId, uint16_t count);
+
+// Next chunk to send at `now` (NACKed, then timed out, then new), or -1 if
+// the window is full or everything sent is waiting for an ACK
+int imageSenderNext(ImageSender& s, uint32_t now);
+void imageSenderSent(ImageSender& s, uint16_t index, uint32_t now);
+
+// Applies a camera/ack payload; false if malformed or for another image
+bool imageSenderApplyAck(ImageSender& s, const uint8_t* payload, size_t len);
+
+inline bool imageSenderDone(const ImageSender& s) { return s.active && s.acked == s.count; }
+
+#endif
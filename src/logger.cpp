@@ -0,0 +1,161 @@
+#include "logger.h"
+#include <freertos/FreeRTOS.h>
+
+// Ring buffer (head = next write, tail = next read, free-running counters)
+static LogRecord ring[LOG_RING_SIZE];
+static volatile uint32_t head = 0;
+static volatile uint32_t tail = 0;
+static uint32_t dropped = 0;
+static uint32_t droppedReported = 0;
+static portMUX_TYPE logMux = portMUX_INITIALIZER_UNLOCKED;
+
+// Line waiting for room in the Serial TX buffer
+static char line[LOG_LINE_MAX + 2];
+static size_t lineLen = 0;
+static uint8_t lineLevel = 0;
+
+static LogSink extraSink = nullptr;
+static uint8_t extraSinkLevel = LOG_LEVEL_NONE;
+
+void logSetSink(LogSink sink, uint8_t minLevel) {
+    extraSink = sink;
+    extraSinkLevel = minLevel;
+}
+
+void logPush(const LogRecord& rec) {
+    portENTER_CRITICAL(&logMux);
+    if (head - tail >= LOG_RING_SIZE) {
+        dropped++;
+    } else {
+        ring[head % LOG_RING_SIZE] = rec;
+        head = head + 1;
+    }
+    portEXIT_CRITICAL(&logMux);
+}
+
+static bool popRecord(LogRecord& out) {
+    bool ok = false;
+    portENTER_CRITICAL(&logMux);
+    if (tail != head) {
+        out = ring[tail % LOG_RING_SIZE];
+        tail = tail + 1;
+        ok = true;
+    }
+    portEXIT_CRITICAL(&logMux);
+    return ok;
+}
+
+uint32_t logPending() { return head - tail; }
+uint32_t logDropped() { return dropped; }
+
+// Formats one argument using the caller's conversion spec. Length modifiers
+// are dropped and re-derived from the recorded type.
+static int formatArg(char* out, size_t size, const char* spec, size_t specLen, uint8_t type, const LogArg& arg) {
+    char fmt[16];
+    size_t n = 0;
+    for (size_t i = 0; i < specLen && n < sizeof(fmt) - 1; i++) {
+        char c = spec[i];
+        if (c == 'l' || c == 'h' || c == 'z') continue;
+        fmt[n++] = c;
+    }
+    fmt[n] = 0;
+    char conv = spec[specLen - 1];
+    switch (type) {
+        case LOG_ARG_INT:
+            if (conv == 'f') return snprintf(out, size, "%d", (int)arg.i);
+            return snprintf(out, size, fmt, (int)arg.i);
+        case LOG_ARG_UINT:
+            if (conv == 'f') return snprintf(out, size, "%u", (unsigned)arg.u);
+            return snprintf(out, size, fmt, (unsigned)arg.u);
+        case LOG_ARG_FLOAT:
+            if (conv != 'f' && conv != 'e' && conv != 'g') return snprintf(out, size, "%g", (double)arg.f);
+            return snprintf(out, size, fmt, (double)arg.f);
+        default:
+            if (conv != 's') return snprintf(out, size, "?");
+            return snprintf(out, size, fmt, arg.s ? arg.s : "(null)");
+    }
+}
+
+size_t logFormat(const LogRecord& rec, char* out, size_t size) {
+    if (size == 0) return 0;
+    unsigned long h = (rec.timestamp / 3600000UL) % 24;
+    unsigned long m = (rec.timestamp / 60000UL) % 60;
+    unsigned long s = (rec.timestamp / 1000UL) % 60;
+    int w = snprintf(out, size, "[%02lu:%02lu:%02lu] ", h, m, s);
+    size_t o = (w < 0) ? 0 : (size_t)w;
+    uint8_t argIndex = 0;
+
+    for (const char* p = rec.fmt; *p && o < size - 1; p++) {
+        if (*p != '%') {
+            out[o++] = *p;
+            continue;
+        }
+        if (p[1] == '%') {
+            out[o++] = '%';
+            p++;
+            continue;
+        }
+        // Conversion spec: flags, width, precision, length, conversion char
+        const char* spec = p;
+        size_t specLen = 1;
+        while (spec[specLen] && !strchr("diuxXfegsc", spec[specLen])) specLen++;
+        if (!spec[specLen]) break;
+        specLen++;
+        p += specLen - 1;
+        if (argIndex >= rec.argc) continue;
+        w = formatArg(out + o, size - o, spec, specLen, rec.types[argIndex], rec.args[argIndex]);
+        argIndex++;
+        if (w > 0) o += (size_t)w;
+        if (o >= size) o = size - 1;
+    }
+    out[o] = 0;
+    return o;
+}
+
+// Writes the pending line if the UART can take it without blocking
+static bool flushLine(bool block) {
+    if (lineLen == 0) return true;
+    if (!block && Serial.availableForWrite() < (int)lineLen) return false;
+    Serial.write((const uint8_t*)line, lineLen);
+    if (extraSink && lineLevel <= extraSinkLevel) {
+        line[lineLen - 2] = 0;      // Sink gets the line without CR/LF
+        extraSink(lineLevel, line);
+    }
+    lineLen = 0;
+    return true;
+}
+
+static int drain(bool block) {
+    int written = 0;
+    for (;;) {
+        if (!flushLine(block)) break;
+        if (dropped != droppedReported) {
+            LogRecord rec;
+            rec.timestamp = millis();
+            rec.fmt = "⚠️ Logger overflow: %u records dropped";
+            rec.level = LOG_LEVEL_WARN;
+            rec.argc = 1;
+            rec.types[0] = LOG_ARG_UINT;
+            rec.args[0].u = dropped - droppedReported;
+            droppedReported = dropped;
+            lineLen = logFormat(rec, line, LOG_LINE_MAX);
+            lineLevel = rec.level;
+        } else {
+            LogRecord rec;
+            if (!popRecord(rec)) break;
+            lineLen = logFormat(rec, line, LOG_LINE_MAX);
+            lineLevel = rec.level;
+        }
+        line[lineLen++] = '\r';
+        line[lineLen++] = '\n';
+        written++;
+    }
+    return written;
+}
+
+int logDrain() { return drain(false); }
+
+void logFlush() {
+    drain(true);
+    Serial.flush();
+}
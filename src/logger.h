@@ -0,0 +1,117 @@
+#ifndef LOGGER_H
+#define LOGGER_H
+
+#include <Arduino.h>
+#include "config.h"
+
+// Deferred binary logger.
+// Call sites store the format string pointer (its id) plus raw arguments in a
+// fixed ring buffer: constant time, no heap, no Serial I/O. logDrain() formats
+// queued records later, only as fast as the UART can take them.
+//
+// Rules for call sites:
+//  - the format must be a string literal
+//  - %s arguments must point to static strings (literals, const tables)
+//  - at most LOG_MAX_ARGS arguments (int, unsigned, long, float, double, const char*)
+
+#define LOG_LEVEL_NONE  0
+#define LOG_LEVEL_ERROR 1
+#define LOG_LEVEL_WARN  2
+#define LOG_LEVEL_INFO  3
+#define LOG_LEVEL_DEBUG 4
+
+enum LogArgType : uint8_t { LOG_ARG_INT, LOG_ARG_UINT, LOG_ARG_FLOAT, LOG_ARG_STR };
+
+struct LogArg {
+    union {
+        int32_t i;
+        uint32_t u;
+        float f;
+        const char* s;
+    };
+};
+
+struct LogRecord {
+    uint32_t timestamp;     // millis() at the call site
+    const char* fmt;
+    uint8_t level;
+    uint8_t argc;
+    uint8_t types[LOG_MAX_ARGS];
+    LogArg args[LOG_MAX_ARGS];
+};
+
+// Optional second sink (e.g. MQTT) for drained lines at or above minLevel
+typedef void (*LogSink)(uint8_t level, const char* line);
+void logSetSink(LogSink sink, uint8_t minLevel);
+
+// Formats and writes queued records while the Serial TX buffer has room.
+// Returns the number of records written.
+int logDrain();
+
+// Drains everything, blocking on Serial if needed (boot, before sleep/reset)
+void logFlush();
+
+// Counters
+uint32_t logPending();
+uint32_t logDropped();
+
+// Formats one record as "[hh:mm:ss] message" (no line ending)
+size_t logFormat(const LogRecord& rec, char* out, size_t size);
+
+// --- Internal: record capture ---
+void logPush(const LogRecord& rec);
+
+inline void logPack(LogRecord& rec, int v) { rec.types[rec.argc] = LOG_ARG_INT; rec.args[rec.argc++].i = v; }
+inline void logPack(LogRecord& rec, long v) { rec.types[rec.argc] = LOG_ARG_INT; rec.args[rec.argc++].i = (int32_t)v; }
+inline void logPack(LogRecord& rec, unsigned int v) { rec.types[rec.argc] = LOG_ARG_UINT; rec.args[rec.argc++].u = v; }
+inline void logPack(LogRecord& rec, unsigned long v) { rec.types[rec.argc] = LOG_ARG_UINT; rec.args[rec.argc++].u = (uint32_t)v; }
+inline void logPack(LogRecord& rec, float v) { rec.types[rec.argc] = LOG_ARG_FLOAT; rec.args[rec.argc++].f = v; }
+inline void logPack(LogRecord& rec, double v) { rec.types[rec.argc] = LOG_ARG_FLOAT; rec.args[rec.argc++].f = (float)v; }
+inline void logPack(LogRecord& rec, const char* v) { rec.types[rec.argc] = LOG_ARG_STR; rec.args[rec.argc++].s = v; }
+
+inline void logPackAll(LogRecord& rec) { (void)rec; }
+
+template <typename T, typename... Rest>
+inline void logPackAll(LogRecord& rec, T first, Rest... rest) {
+    logPack(rec, first);
+    logPackAll(rec, rest...);
+}
+
+template <typename... Args>
+inline void logWrite(uint8_t level, const char* fmt, Args... args) {
+    static_assert(sizeof...(Args) <= LOG_MAX_ARGS, "too many log arguments");
+    LogRecord rec;
+    rec.timestamp = millis();
+    rec.fmt = fmt;
+    rec.level = level;
+    rec.argc = 0;
+    logPackAll(rec, args...);
+    logPush(rec);
+}
+
+// --- Call-site macros (levels above LOG_LEVEL compile to nothing) ---
+#if LOG_LEVEL >= LOG_LEVEL_ERROR
+#define LOG_ERROR(...) logWrite(LOG_LEVEL_ERROR, __VA_ARGS__)
+#else
+#define LOG_ERROR(...) do {} while (0)
+#endif
+
+#if LOG_LEVEL >= LOG_LEVEL_WARN
+#define LOG_WARN(...) logWrite(LOG_LEVEL_WARN, __VA_ARGS__)
+#else
+#define LOG_WARN(...) do {} while (0)
+#endif
+
+#if LOG_LEVEL >= LOG_LEVEL_INFO
+#define LOG_INFO(...) logWrite(LOG_LEVEL_INFO, __VA_ARGS__)
+#else
+#define LOG_INFO(...) do {} while (0)
+#endif
+
+#if LOG_LEVEL >= LOG_LEVEL_DEBUG
+#define LOG_DEBUG(...) logWrite(LOG_LEVEL_DEBUG, __VA_ARGS__)
+#else
+#define LOG_DEBUG(...) do {} while (0)
+#endif
+
+#endif
@@ -14,148 +14,201 @@
 */
 
 #include <Arduino.h>
-#include "esp_camera.h"
 #include "config.h"
 #include "sensor_driver.h"
 #include "core.h"
+#include "rules.h"
+#include "report.h"
 #include "mqtt_driver.h"
+#include "offline_queue.h"
+#include "soiling.h"
+#include "image_delta.h"
+#include "runtime.h"
+#include "sensor_stats.h"
+#include "deep_sleep.h"
+#include "net_link.h"
+#include "perf_metrics.h"
+#include "serial_commands.h"
+#include "camera_capture.h"
 
 // Global State
 SystemMode currentMode = MODE_BOOT;
 unsigned long lastCheckTime = 0;
+uint32_t dayCycles = 0;
+SensorBank bank;                // Every sensor of each type (SoA), channel 0 = status
+unsigned long lastStatsSampleMs = 0;
+uint32_t statsCycles = 0;
+unsigned long bootMs = 0;       // millis() after the boot delay
+uint32_t wakeLeadMs = 0;        // Deep sleep: boot to MQTT connected on the last boot
 
-// --- SERIAL COMMAND PARSER (For Simulation) ---
-void checkSerialCommands() {
-    if (Serial.available() > 0) {
-        String cmd = Serial.readStringUntil('\n');
-        cmd.trim(); 
-        
-        if (cmd.length() == 0) return;
-
-        if (cmd.startsWith("set dust ")) {
-            float val = cmd.substring(9).toFloat();
-            setSimDust(val);
-            Serial.println("CMD: Dust set to " + String(val));
-        }
-        else if (cmd.startsWith("set lux ")) {
-            float val = cmd.substring(8).toFloat();
-            setSimLux(val);
-            Serial.println("CMD: Lux set to " + String(val));
-        }
-        else if (cmd.startsWith("set hum ")) {
-            float val = cmd.substring(8).toFloat();
-            setSimHum(val);
-            Serial.println("CMD: Humidity set to " + String(val));
-        }
-        else if (cmd.startsWith("set days ")) {
-            int val = cmd.substring(9).toInt();
-            setDaysSinceClean(val);
-            Serial.println("CMD: Days since clean set to " + String(val));
-        }
-        else {
-            Serial.println("Unknown command. Use: set dust X, set lux X, set hum X, set days X");
-        }
-    }
+static camera_fb_t* captureFrame(const CaptureRequest& request) {
+    PERF_SCOPE(PERF_CAMERA);
+    return cameraCapture(request);
+}
+
+static bool scoreSoiling(const camera_fb_t* fb, SoilingScore* soil) {
+    PERF_SCOPE(PERF_SOILING);
+    return scoreSoilingJpeg(fb->buf, fb->len, soil);
+}
+
+#if ENABLE_DEEP_SLEEP
+// Ordinary RAM is lost in deep sleep: what carries over to the next cycle
+static void saveSleepState(SleepState* state) {
+    memset(state, 0, sizeof(*state));
+    state->mode = (uint8_t)currentMode;
+    state->dayCycles = dayCycles;
+    state->statsCycles = statsCycles;
+    state->sinceCycleMs = millis() - lastCheckTime;
+    state->wakeLeadMs = wakeLeadMs;
+    state->core = coreSaveState();
+    state->rules = rulesSaveState();
+    state->report = reportSaveState();
+    sensorStatsSave(state->stats);
 }
 
-void setupWiFi() {
-    Serial.print("Connecting to WiFi: ");
-    Serial.println(SECRET_SSID);
-    WiFi.begin(SECRET_SSID, SECRET_WIFI_PASSWORD);
+static void restoreSleepState(const SleepState& state, uint32_t sleptMs) {
+    currentMode = (SystemMode)state.mode;
+    dayCycles = state.dayCycles;
+    statsCycles = state.statsCycles;
+    lastCheckTime = millis() - (state.sinceCycleMs + sleptMs);     // Wraps like millis()
+    lastStatsSampleMs = lastCheckTime;
+    wakeLeadMs = state.wakeLeadMs;
+    coreRestoreState(state.core, sleptMs);
+    rulesRestoreState(state.rules, sleptMs);
+    reportRestoreState(state.report, sleptMs);
+    sensorStatsRestore(state.stats);
+}
 
-    int attempts = 0;
-    while (WiFi.status() != WL_CONNECTED && attempts < 20) {
-        delay(500);
-        Serial.print(".");
-        attempts++;
+// Once everything submitted has gone out, sleeps until the next cycle is due
+static void sleepUntilNextCycle() {
+    unsigned long interval = (currentMode == MODE_DAY) ? INTERVAL_DAY : INTERVAL_NIGHT;
+    unsigned long elapsed = millis() - lastCheckTime;
+    if (elapsed >= interval) return;
+    // Wake early by what this boot took to get online, so the next cycle
+    // finds the connection up and keeps its period
+    if (mqttConnectedAtMs()) {
+        wakeLeadMs = mqttConnectedAtMs() - bootMs;
+        if (wakeLeadMs > interval / 2) wakeLeadMs = interval / 2;
     }
-    if(WiFi.status() == WL_CONNECTED) {
-        Serial.println("\nWiFi Connected.");
-    } else {
-        Serial.println("\nWiFi Failed (Will retry later).");
+    unsigned long remaining = interval - elapsed;
+    if (wakeLeadMs < remaining) remaining -= wakeLeadMs;
+    if (remaining < SLEEP_MIN_MS) return;
+    if (!runtimeIdle()) return;
+    if (runtimeNetworkTaskRunning()) {
+        runtimeStop();
+        while (runtimeNetworkTaskRunning()) delay(1);
     }
+
+    cameraPowerDown();
+
+    // Log out first: the ages are taken at the moment of sleeping
+    uint32_t sleepMs = remaining + 1;
+    LOG_INFO("💤 Deep sleep %lu ms", (unsigned long)sleepMs);
+    logFlush();
+    SleepState state;
+    saveSleepState(&state);
+    sleepFor(state, sleepMs);
 }
+#endif
 
-// Camera Init (Kept here as it's a core system component)
-bool initCamera() {
-    camera_config_t config;
-    config.ledc_channel = LEDC_CHANNEL_0;
-    config.ledc_timer = LEDC_TIMER_0;
-    config.pin_d0 = Y2_GPIO_NUM;
-    config.pin_d1 = Y3_GPIO_NUM;
-    config.pin_d2 = Y4_GPIO_NUM;
-    config.pin_d3 = Y5_GPIO_NUM;
-    config.pin_d4 = Y6_GPIO_NUM;
-    config.pin_d5 = Y7_GPIO_NUM;
-    config.pin_d6 = Y8_GPIO_NUM;
-    config.pin_d7 = Y9_GPIO_NUM;
-    config.pin_xclk = XCLK_GPIO_NUM;
-    config.pin_pclk = PCLK_GPIO_NUM;
-    config.pin_vsync = VSYNC_GPIO_NUM;
-    config.pin_href = HREF_GPIO_NUM;
-    config.pin_sccb_sda = SIOD_GPIO_NUM; 
-    config.pin_sccb_scl = SIOC_GPIO_NUM;
-    config.pin_pwdn = PWDN_GPIO_NUM;
-    config.pin_reset = RESET_GPIO_NUM;
-    config.xclk_freq_hz = 20000000;
-    config.pixel_format = PIXFORMAT_JPEG;
-    config.frame_size = FRAMESIZE_VGA;
-    config.jpeg_quality = 12;
-    config.fb_count = 1;
-    
-    if(psramFound()) {
-        config.fb_count = 2;
-        logSystem("PSRAM Detected (Double Buffer)");
+#if ENABLE_SENSOR_STATS
+// Every STATS_REPORT_CYCLES cycles: one aggregate record per channel, then a
+// new interval
+static void reportSensorStats() {
+    if (++statsCycles < STATS_REPORT_CYCLES) return;
+    statsCycles = 0;
+    StatsSummary summary;
+    for (uint8_t ch = 0; ch < SENSOR_CHANNELS; ch++) {
+        if (sensorStatsSummary(ch, &summary)) runtimeSubmitStats(ch, summary);
     }
-
-    esp_err_t err = esp_camera_init(&config);
-    return (err == ESP_OK);
+    sensorStatsResetInterval();
+    ReportStats report = reportStats();
+    LOG_INFO("📉 Reported %u, held back %u (%u heartbeats)", (unsigned)report.sent, (unsigned)report.suppressed,
+             (unsigned)report.heartbeats);
 }
+#endif
 
 // --- MAIN SETUP ---
 void setup() {
-    delay(3000);
+    // Warm wake-up from deep sleep: state from RTC memory, no boot delay
+    bool warm = false;
+    uint32_t sleptMs = 0;
+    #if ENABLE_DEEP_SLEEP
+        SleepState saved;
+        warm = sleepResume(&saved, &sleptMs);
+    #endif
+    if (!warm) delay(BOOT_DELAY_MS);
+    bootMs = millis();
+    Serial.setTxBufferSize(LOG_SERIAL_TX_BUFFER);
+    Serial.setRxBufferSize(SERIAL_RX_BUFFER);
     Serial.begin(115200);
-    logSystem("=== ARGUS SYSTEM v1.0 STARTED ===");
+    serialCommandsBegin();
+    if (warm) {
+        LOG_INFO("💤 Wake-up %lu after %lu ms", (unsigned long)sleepStats().wakes, (unsigned long)sleptMs);
+    } else {
+        LOG_INFO("=== ARGUS SYSTEM v1.0 STARTED ===");
+    }
+    netLinkBegin(sleptMs);      // Joins in the background while the hardware starts
 
     // 1. Hardware Init
     initSensors();
-    if (initCamera()) {
-        logSystem("✅ Camera Initialized");
-    } else {
-        logSystem("❌ Camera Failed");
-    }
+    sensorBankReset(&bank);
+    rulesInit();                // Last update kept in RTC memory, else the defaults
+    #if ENABLE_SENSOR_STATS
+        statsCycles = 0;        // First aggregate interval starts at boot
+        sensorStatsResetInterval();
+    #endif
+    #if ENABLE_DEEP_SLEEP
+        if (warm) restoreSleepState(saved, sleptMs);
+    #endif
+    #if ENABLE_OFFLINE_QUEUE
+        initOfflineQueue();     // Before WiFi: capture works even if it never connects
+    #endif
+    cameraBegin(!warm);         // Probed on a cold boot, then off until a frame is needed
+    #if ENABLE_IMAGE_DELTA
+        initImageDelta();       // Keyframe from flash: deltas continue across reboots
+    #endif
+    logFlush();
 
-    setupWiFi();
-    initMQTT();
+    initMQTT(warm);
     
-    logSystem("System Ready. Waiting for cycle...");
+    LOG_INFO("System Ready. Waiting for cycle...");
+    logFlush();
+    #if RUNTIME_DUAL_CORE
+        runtimeStartNetworkTask();  // From here on only the network task drains the log
+    #endif
 }
 
 // --- MAIN LOOP ---
-void loop() {
+// Acquisition only: everything that goes out is submitted to the runtime
+// (runtime.h), published by the network task, so a slow broker or upload
+// never holds up sampling or mode detection.
+static void acquisitionPass() {
+    PERF_SCOPE(PERF_LOOP);
     unsigned long now = millis();
     
-    loopMQTT();
-    checkSerialCommands(); // Listen for 'set' commands
+    runtimeRetryPending();
+    serialCommandsPoll();  // 'set' commands and sample frames, never waits for a line
 
-    // 1. Continuous Light Monitoring (Mode Switching)
-    float currentLux = readLightLevel();
-    SystemMode newMode = determineOperationMode(currentLux);
+    // Frame asked for on the dashboard: taken here, uploaded by the network side
+    if (runtimeTakeFrameRequest()) runtimeSubmitFrame(captureFrame(CAPTURE_UPLOAD));
 
-    if (newMode != currentMode) {
-        currentMode = newMode;
-        String modeStr = (currentMode == MODE_DAY) ? "DAY_MODE" : "NIGHT_MODE";
-        logSystem("MODE CHANGE: " + modeStr);
-        publishState(modeStr);
+    // 1. Continuous Light Monitoring (Mode Switching)
+    float currentLux;
+    {
+        PERF_SCOPE(PERF_LIGHT);
+        currentLux = readLightLevels(&bank);        // Brightest sensor
     }
+    #if ENABLE_SENSOR_STATS
+        sensorStatsAddAll(CH_LUX, bank.lux, bank.channels);
+    #endif
+    SystemMode newMode = determineOperationMode(currentLux, currentMode);
 
     if (newMode != currentMode) {
         currentMode = newMode;
-        String modeStr = (currentMode == MODE_DAY) ? "☀️ DAY_MODE" : "🌙 NIGHT_MODE";
-        logSystem("MODE CHANGE: " + modeStr);
-        publishState(modeStr);
+        LOG_INFO("MODE CHANGE: %s", modeName(currentMode));
     }
+    if (reportMode(currentMode)) runtimeSubmitState(currentMode);     // Change or heartbeat
 
     // 2. Cycle Timing
     unsigned long interval = (currentMode == MODE_DAY) ? INTERVAL_DAY : INTERVAL_NIGHT;
@@ -163,46 +216,111 @@ void loop() {
     if (now - lastCheckTime > interval) {
         lastCheckTime = now;
 
-        // Build Status Object
-        SystemStatus status;
-        status.lux = currentLux;
-        status.mode = currentMode;
+        // Build Status Object (NaN = not measured this cycle): channel 0,
+        // every channel in the bank
+        SystemStatus status = {NAN, NAN, bank.lux[0], NAN, NAN, NAN, currentMode};
+        for (uint8_t i = 0; i < bank.channels; i++) {
+            bank.temp[i] = NAN;
+            bank.humidity[i] = NAN;
+            bank.dust[i] = NAN;
+        }
 
         if (currentMode == MODE_NIGHT) {
-            publishTelemetry(status);
-            logSystem("Night Monitor - Lux: " + String(status.lux));
+            runtimeSubmitTelemetry(status, bank, reportTelemetry(status, bank));
+            LOG_INFO("Night Monitor - Lux: %.2f", currentLux);
         } 
         else {
             // Day Cycle
-            status.temp = readTemperature();
-            status.humidity = readHumidity();
-            
-            // Fill dust buffer
-            for(int k=0; k<5; k++) { readDustSensorSmooth(); delay(20); }
-            status.dust = readDustSensorSmooth();
+            {
+                PERF_SCOPE(PERF_SENSORS);
+                readClimate(&bank);
+                readDustLevels(&bank);
+            }
+            status.temp = bank.temp[0];
+            status.humidity = bank.humidity[0];
+            status.dust = bank.dust[0];
+
+            // Vision: score the panel every few cycles, and whenever dust is
+            // high. The frame is kept only until the upload decision.
+            camera_fb_t * fb = nullptr;
+            bool visionDue = (dayCycles++ % SOILING_INTERVAL_CYCLES) == 0 || channelMax(bank.dust, bank.channels) > DUST_THRESHOLD;
+            if (ENABLE_SOILING_SCORE && visionDue) {
+                fb = captureFrame(CAPTURE_SCORING);
+                SoilingScore soil;
+                if (fb && scoreSoiling(fb, &soil)) {
+                    status.soiling = soil.score;
+                    LOG_INFO("👁️ Soiling %.0f (uniformity %.2f, haze %.2f, spots %.2f)", soil.score,
+                             soil.uniformity, soil.haze, soil.spots);
+                }
+            }
             
             // Log & Telemetry
-            String logMsg = "Env: " + String(status.temp, 1) + "C | " + String(status.lux, 0) + " lx";
-            logSystem(logMsg);
-            publishTelemetry(status);
+            LOG_INFO("Env: %.1fC | %.0f lx", status.temp, status.lux);
+            runtimeSubmitTelemetry(status, bank, reportTelemetry(status, bank));
 
             // 3. DECISION LOGIC (AGORA USANDO O RETORNO BOOL)
             // Não repetimos a lógica aqui. O evaluateSystemState já decidiu.
-            bool cleaningTriggered = evaluateSystemState(status);
+            bool cleaningTriggered;
+            {
+                PERF_SCOPE(PERF_DECISION);
+                cleaningTriggered = evaluateSystemState(status, bank);
+            }
 
-            // Publica o estado do alerta no MQTT
-            publishAlert(cleaningTriggered, "Auto-Logic");
+            // Publica o estado do alerta no MQTT (on a change, report.h)
+            bool alertState;
+            if (reportAlert(cleaningTriggered, &alertState)) runtimeSubmitAlert(alertState);
 
-            if (cleaningTriggered) {
-                logSystem("📸 CAPTURING EVIDENCE...");
-                camera_fb_t * fb = esp_camera_fb_get();
+            // Upload only when the score crosses the threshold (or, without
+            // a score, on a cleaning trigger as before)
+            if (shouldUploadFrame(status, cleaningTriggered)) {
+                LOG_INFO("📸 CAPTURING EVIDENCE...");
+                if (fb && !cameraSameSettings(CAPTURE_SCORING, CAPTURE_UPLOAD)) {
+                    cameraRelease(fb);
+                    fb = nullptr;
+                }
+                if (!fb) fb = captureFrame(CAPTURE_UPLOAD);
                 if (fb) {
-                    publishImage(fb->buf, fb->len);
-                    esp_camera_fb_return(fb);
+                    runtimeSubmitFrame(fb);     // The network side returns it
+                    fb = nullptr;
                 } else {
-                    logSystem("❌ Camera Capture Failed");
+                    LOG_ERROR("❌ Camera Capture Failed");
                 }
             }
+            cameraRelease(fb);
+        }
+
+        #if ENABLE_SENSOR_STATS
+            sensorStatsAddStatus(status, bank);
+            lastStatsSampleMs = now;
+            reportSensorStats();
+        #endif
+    }
+    #if ENABLE_SENSOR_STATS
+    else if (currentMode == MODE_DAY && now - lastStatsSampleMs >= STATS_SAMPLE_MS) {
+        // Between cycles: more samples for the aggregates
+        SensorBank samples;
+        sensorBankReset(&samples);
+        {
+            PERF_SCOPE(PERF_SENSORS);
+            readClimate(&samples);
+            readDustLevels(&samples);
         }
+        sensorStatsAddAll(CH_TEMP, samples.temp, samples.channels);
+        sensorStatsAddAll(CH_HUMIDITY, samples.humidity, samples.channels);
+        sensorStatsAddAll(CH_DUST, samples.dust, samples.channels);
+        lastStatsSampleMs = now;
     }
-}
\ No newline at end of file
+    #endif
+    cameraIdle();               // Off once unused for CAMERA_KEEP_WARM_MS
+}
+
+void loop() {
+    acquisitionPass();
+
+    // Single task: the network side runs here, after this pass's records
+    if (!runtimeNetworkTaskRunning()) runtimeNetworkStep();
+
+    #if ENABLE_DEEP_SLEEP
+        sleepUntilNextCycle();
+    #endif
+}
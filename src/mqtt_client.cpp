@@ -0,0 +1,657 @@
+#include "mqtt_client.h"
+
+static_assert(MQTT_OUTBOX_BYTES <= 65535, "outbox offsets are 16-bit");
+static_assert(MQTT_INFLIGHT_WINDOW <= MQTT_OUTBOX_MESSAGES, "in-flight window larger than the outbox");
+
+#define MQTT_TOPIC_MAX 128      // Longer topics are refused (getTopic() builds 128)
+
+#define PACKET_CONNECT      0x10
+#define PACKET_CONNACK      2
+#define PACKET_PUBLISH      3
+#define PACKET_PUBACK       4
+#define PACKET_SUBSCRIBE    0x82
+#define PACKET_SUBACK       9
+#define PACKET_PINGREQ      0xC0
+#define PACKET_PINGRESP     13
+#define PACKET_DISCONNECT   14
+
+#define PROP_SESSION_EXPIRY     0x11
+#define PROP_RECEIVE_MAXIMUM    0x21
+#define PROP_TOPIC_ALIAS_MAX    0x22
+#define PROP_MAXIMUM_PACKET     0x27
+#define PROP_TOPIC_ALIAS        0x23
+
+static size_t putLength(uint8_t* out, size_t length) {
+    size_t n = 0;
+    do {
+        uint8_t b = length & 0x7F;
+        length >>= 7;
+        out[n++] = length ? (b | 0x80) : b;
+    } while (length);
+    return n;
+}
+
+// Variable byte integer at p; bytes used, 0 if incomplete or malformed
+static size_t getLength(const uint8_t* p, size_t avail, size_t* length) {
+    size_t value = 0;
+    for (size_t i = 0; i < 4 && i < avail; i++) {
+        value |= (size_t)(p[i] & 0x7F) << (7 * i);
+        if (!(p[i] & 0x80)) {
+            *length = value;
+            return i + 1;
+        }
+    }
+    return 0;
+}
+
+static size_t putString(uint8_t* out, const char* s, size_t len) {
+    out[0] = (uint8_t)(len >> 8);
+    out[1] = (uint8_t)len;
+    memcpy(out + 2, s, len);
+    return 2 + len;
+}
+
+// Bytes of a property's value (MQTT 5.0, 2.2.2.2); -1 if unknown or cut off
+static int propertySize(uint8_t id, const uint8_t* p, size_t left) {
+    switch (id) {
+        case 0x01: case 0x17: case 0x19: case 0x24: case 0x25: case 0x28: case 0x29: case 0x2A:
+            return left >= 1 ? 1 : -1;
+        case 0x13: case 0x21: case 0x22: case 0x23:
+            return left >= 2 ? 2 : -1;
+        case 0x02: case 0x11: case 0x18: case 0x27:
+            return left >= 4 ? 4 : -1;
+        case 0x0B: {
+            size_t v;
+            size_t n = getLength(p, left, &v);
+            return n ? (int)n : -1;
+        }
+        case 0x03: case 0x08: case 0x09: case 0x12: case 0x15: case 0x16: case 0x1A: case 0x1C: case 0x1F: {
+            if (left < 2) return -1;
+            size_t n = 2 + ((p[0] << 8) | p[1]);
+            return n <= left ? (int)n : -1;
+        }
+        case 0x26: {
+            int key = propertySize(0x03, p, left);
+            if (key < 0) return -1;
+            int value = propertySize(0x03, p + key, left - key);
+            return value < 0 ? -1 : key + value;
+        }
+        default:
+            return -1;
+    }
+}
+
+MqttClient::MqttClient(WiFiClient& net)
+    : net(&net), callback(nullptr), buffer(nullptr), bufferSize(0), keepAliveS(MQTT_KEEPALIVE_S),
+      sessionExpiryS(MQTT_SESSION_EXPIRY_S), socketTimeoutS(15), window(MQTT_INFLIGHT_WINDOW),
+      aliasLimit(MQTT_TOPIC_ALIASES), connState(MQTT_DISCONNECTED), outFirst(0), outCount(0), outTail(0),
+      nextPacketId(1), inflightCount(0), brokerAliasMax(0), brokerReceiveMax(0), brokerMaxPacket(0), aliasCount(0), rxLen(0),
+      rxSkip(0), lastOutMs(0), lastInMs(0), connectStartMs(0), pingOutstanding(false), streaming(false), streamLeft(0),
+      clientStats() {}
+
+MqttClient& MqttClient::setCallback(MqttCallback callback) {
+    this->callback = callback;
+    return *this;
+}
+
+// A packet half read stays in the buffer: not shrunk below it
+bool MqttClient::setBufferSize(uint16_t size) {
+    if (size < 16 || size < rxLen) return false;
+    uint8_t* grown = (uint8_t*)realloc(buffer, size);
+    if (!grown) return false;
+    buffer = grown;
+    bufferSize = size;
+    return true;
+}
+
+MqttClient& MqttClient::setKeepAlive(uint16_t seconds) {
+    keepAliveS = seconds;
+    return *this;
+}
+
+MqttClient& MqttClient::setSessionExpiry(uint32_t seconds) {
+    sessionExpiryS = seconds;
+    return *this;
+}
+
+MqttClient& MqttClient::setSocketTimeout(uint16_t seconds) {
+    socketTimeoutS = seconds;
+    return *this;
+}
+
+MqttClient& MqttClient::setInflightWindow(uint8_t window) {
+    this->window = window < 1 ? 1 : window > MQTT_INFLIGHT_WINDOW ? MQTT_INFLIGHT_WINDOW : window;
+    return *this;
+}
+
+MqttClient& MqttClient::setTopicAliases(uint8_t aliases) {
+    aliasLimit = aliases > MQTT_TOPIC_ALIASES ? MQTT_TOPIC_ALIASES : aliases;
+    return *this;
+}
+
+// ============================================================================
+// CONNECTION
+// ============================================================================
+
+bool MqttClient::connect(const char* id, const char* user, const char* pass) {
+    if (!buffer || !net->connected()) {
+        connState = MQTT_CONNECT_FAILED;
+        return false;
+    }
+    connState = MQTT_DISCONNECTED;
+    rxLen = 0;
+    rxSkip = 0;
+    aliasCount = 0;
+    brokerAliasMax = 0;
+    brokerReceiveMax = 0xFFFF;
+    brokerMaxPacket = 0;
+    pingOutstanding = false;
+    streaming = false;
+
+    size_t idLen = strlen(id);
+    size_t userLen = user ? strlen(user) : 0;
+    size_t passLen = pass ? strlen(pass) : 0;
+    size_t props = sessionExpiryS ? 5 : 0;
+    size_t remaining = 10 + 1 + props + 2 + idLen + (user ? 2 + userLen : 0) + (pass ? 2 + passLen : 0);
+    if (remaining + 5 > bufferSize) {
+        connState = MQTT_CONNECT_FAILED;
+        return false;
+    }
+    uint8_t* p = buffer;
+    size_t n = 0;
+    p[n++] = PACKET_CONNECT;
+    n += putLength(p + n, remaining);
+    n += putString(p + n, "MQTT", 4);
+    p[n++] = 5;
+    // No session expiry: clean start, the broker drops what it kept
+    p[n++] = (user ? 0x80 : 0) | (pass ? 0x40 : 0) | (sessionExpiryS ? 0 : 0x02);
+    p[n++] = (uint8_t)(keepAliveS >> 8);
+    p[n++] = (uint8_t)keepAliveS;
+    p[n++] = (uint8_t)props;
+    if (sessionExpiryS) {
+        p[n++] = PROP_SESSION_EXPIRY;
+        for (int shift = 24; shift >= 0; shift -= 8) p[n++] = (uint8_t)(sessionExpiryS >> shift);
+    }
+    n += putString(p + n, id, idLen);
+    if (user) n += putString(p + n, user, userLen);
+    if (pass) n += putString(p + n, pass, passLen);
+    if (net->write(p, n) != n) {
+        net->stop();
+        connState = MQTT_CONNECT_FAILED;
+        return false;
+    }
+    lastOutMs = millis();
+    connectStartMs = lastOutMs;
+    connState = MQTT_CONNECTING;
+    return true;
+}
+
+// CONNACK (handlePacket() sets the state), or the socket timeout
+bool MqttClient::awaitConnack() {
+    while (connState == MQTT_CONNECTING && readPacket()) {
+        handlePacket(buffer, rxLen);
+        rxLen = 0;
+    }
+    if (connState == MQTT_CONNECTING) {
+        if (net->connected() && millis() - connectStartMs < socketTimeoutS * 1000UL) return false;
+        connState = MQTT_CONNECTION_TIMEOUT;
+    }
+    if (connState != MQTT_CONNECTED) {
+        net->stop();
+        return false;
+    }
+    return true;
+}
+
+void MqttClient::disconnect() {
+    if (connState == MQTT_CONNECTED && net->connected()) {
+        static const uint8_t packet[2] = {PACKET_DISCONNECT << 4, 0};
+        net->write(packet, sizeof(packet));
+    }
+    connectionLost(MQTT_DISCONNECTED);
+}
+
+void MqttClient::reset() {
+    net->stop();
+    connState = MQTT_DISCONNECTED;
+    outFirst = 0;
+    outCount = 0;
+    outTail = 0;
+    inflightCount = 0;
+    aliasCount = 0;
+    rxLen = 0;
+    rxSkip = 0;
+    streaming = false;
+    pingOutstanding = false;
+    clientStats = MqttClientStats();
+}
+
+bool MqttClient::connected() {
+    if (connState == MQTT_CONNECTED && !net->connected()) connectionLost(MQTT_CONNECTION_LOST);
+    return connState == MQTT_CONNECTED;
+}
+
+// QoS 1 publishes not acknowledged go back in the queue, in order; queued
+// QoS 0 ones are dropped
+void MqttClient::connectionLost(int reason) {
+    net->stop();
+    connState = reason;
+    aliasCount = 0;
+    rxLen = 0;
+    rxSkip = 0;
+    streaming = false;
+    pingOutstanding = false;
+    inflightCount = 0;
+    for (uint16_t i = 0; i < outCount; i++) {
+        OutboxEntry& e = entries[(outFirst + i) % MQTT_OUTBOX_MESSAGES];
+        if (e.state == ENTRY_AWAITING) {
+            e.state = ENTRY_QUEUED;
+            e.dup = true;
+        } else if (e.state == ENTRY_QUEUED && e.qos == 0) {
+            e.state = ENTRY_DONE;
+            clientStats.dropped++;
+        }
+    }
+    retire();
+}
+
+// ============================================================================
+// OUTBOX
+// ============================================================================
+
+// Contiguous room for `length` bytes after the newest entry, wrapping to
+// the start of the ring when the end is too short
+bool MqttClient::reserve(size_t length, uint16_t* offset) {
+    if (outCount == MQTT_OUTBOX_MESSAGES || length > MQTT_OUTBOX_BYTES) return false;
+    if (outCount == 0) outTail = 0;
+    uint16_t head = outCount ? entries[outFirst].offset : 0;
+    size_t used;
+    if (outCount == 0 || outTail > head) {
+        if ((size_t)(MQTT_OUTBOX_BYTES - outTail) >= length) {
+            *offset = outTail;
+        } else if (head >= length) {
+            *offset = 0;
+        } else {
+            return false;
+        }
+    } else {
+        if ((size_t)(head - outTail) < length) return false;
+        *offset = outTail;
+    }
+    outTail = (uint16_t)(*offset + length);
+    used = outTail > head ? outTail - head : MQTT_OUTBOX_BYTES - head + outTail;
+    if (used > clientStats.outboxMax) clientStats.outboxMax = (uint32_t)used;
+    return true;
+}
+
+void MqttClient::retire() {
+    while (outCount && entries[outFirst].state == ENTRY_DONE) {
+        outFirst = (outFirst + 1) % MQTT_OUTBOX_MESSAGES;
+        outCount--;
+    }
+    if (!outCount) outTail = 0;
+}
+
+bool MqttClient::publish(const char* topic, const uint8_t* payload, size_t length, uint8_t qos) {
+    size_t topicLen = strlen(topic);
+    uint16_t offset;
+    bool ok = connected() && !streaming && topicLen && topicLen <= MQTT_TOPIC_MAX && fitsBroker(topicLen, length);
+    // Outbox full: first write out what the window lets go (QoS 0 entries
+    // leave the outbox with it)
+    if (ok && !reserve(topicLen + length, &offset)) {
+        flush(MQTT_FLUSH_BYTES);
+        ok = reserve(topicLen + length, &offset);
+    }
+    if (!ok) {
+        clientStats.refused++;
+        return false;
+    }
+    OutboxEntry& e = entries[(outFirst + outCount) % MQTT_OUTBOX_MESSAGES];
+    outCount++;
+    e.offset = offset;
+    e.topicLen = (uint16_t)topicLen;
+    e.payloadLen = (uint16_t)length;
+    e.qos = qos ? 1 : 0;
+    e.state = ENTRY_QUEUED;
+    e.dup = false;
+    e.packetId = 0;
+    if (e.qos) {
+        e.packetId = nextPacketId++;
+        if (!nextPacketId) nextPacketId = 1;
+    }
+    memcpy(outbox + offset, topic, topicLen);
+    if (length) memcpy(outbox + offset + topicLen, payload, length);
+    clientStats.bytesQueued += length;
+    return true;
+}
+
+bool MqttClient::publish(const char* topic, const char* payload, uint8_t qos) {
+    return publish(topic, (const uint8_t*)payload, strlen(payload), qos);
+}
+
+// Under the broker's Maximum Packet Size, whether or not an alias replaces
+// the topic
+bool MqttClient::fitsBroker(size_t topicLen, size_t payloadLen) const {
+    return !brokerMaxPacket || 1 + 4 + 2 + topicLen + 2 + 1 + 3 + payloadLen <= brokerMaxPacket;
+}
+
+// Alias number for a topic on this connection, 0 for none; isNew: first
+// use, the PUBLISH carries the topic as well
+int MqttClient::aliasFor(const char* topic, size_t topicLen, bool* isNew) {
+    *isNew = false;
+    if (topicLen >= MQTT_TOPIC_ALIAS_LEN) return 0;
+    for (uint8_t i = 0; i < aliasCount; i++) {
+        if (strncmp(aliases[i], topic, topicLen) == 0 && aliases[i][topicLen] == '\0') return i + 1;
+    }
+    if (aliasCount >= aliasLimit || aliasCount >= brokerAliasMax) return 0;
+    memcpy(aliases[aliasCount], topic, topicLen);
+    aliases[aliasCount][topicLen] = '\0';
+    *isNew = true;
+    return ++aliasCount;
+}
+
+// Fixed header to properties; the payload follows
+size_t MqttClient::publishHeader(uint8_t* out, const char* topic, size_t topicLen, size_t payloadLen, uint8_t qos,
+                                 uint16_t packetId, bool dup) {
+    bool isNew;
+    int alias = aliasFor(topic, topicLen, &isNew);
+    bool withTopic = alias == 0 || isNew;
+    size_t props = alias ? 3 : 0;
+    size_t remaining = 2 + (withTopic ? topicLen : 0) + (qos ? 2 : 0) + 1 + props + payloadLen;
+    size_t n = 0;
+    out[n++] = (uint8_t)((PACKET_PUBLISH << 4) | (dup ? 0x08 : 0) | (qos << 1));
+    n += putLength(out + n, remaining);
+    n += putString(out + n, topic, withTopic ? topicLen : 0);
+    if (qos) {
+        out[n++] = (uint8_t)(packetId >> 8);
+        out[n++] = (uint8_t)packetId;
+    }
+    out[n++] = (uint8_t)props;
+    if (alias) {
+        out[n++] = PROP_TOPIC_ALIAS;
+        out[n++] = (uint8_t)(alias >> 8);
+        out[n++] = (uint8_t)alias;
+        if (!isNew) clientStats.aliased++;
+    }
+    return n;
+}
+
+bool MqttClient::sendPacket(const uint8_t* header, size_t headerLen, const uint8_t* body, size_t bodyLen) {
+    if (net->write(header, headerLen) != headerLen || (bodyLen && net->write(body, bodyLen) != bodyLen)) {
+        connectionLost(MQTT_CONNECTION_LOST);
+        return false;
+    }
+    lastOutMs = millis();
+    return true;
+}
+
+bool MqttClient::sendEntry(OutboxEntry& e) {
+    uint8_t header[MQTT_TOPIC_MAX + 16];
+    const char* topic = (const char*)outbox + e.offset;
+    bool resend = e.dup;
+    size_t n = publishHeader(header, topic, e.topicLen, e.payloadLen, e.qos, e.packetId, resend);
+    if (!sendPacket(header, n, outbox + e.offset + e.topicLen, e.payloadLen)) return false;
+    if (resend) clientStats.retransmits++;
+    else clientStats.published++;
+    if (e.qos == 0) {
+        e.state = ENTRY_DONE;
+    } else if (e.state == ENTRY_QUEUED) {
+        e.state = ENTRY_AWAITING;
+        inflightCount++;
+        if (inflightCount > clientStats.inflightMax) clientStats.inflightMax = inflightCount;
+    }
+    return true;
+}
+
+// In publish order: a QoS 1 publish waiting for a window slot holds back
+// everything after it
+void MqttClient::flush(size_t budget) {
+    uint8_t limit = brokerReceiveMax < window ? (uint8_t)brokerReceiveMax : window;
+    size_t written = 0;
+    for (uint16_t i = 0; i < outCount && connState == MQTT_CONNECTED && written < budget; i++) {
+        OutboxEntry& e = entries[(outFirst + i) % MQTT_OUTBOX_MESSAGES];
+        if (e.state != ENTRY_QUEUED) continue;
+        if (e.qos && inflightCount >= limit) break;
+        if (!sendEntry(e)) break;
+        written += e.topicLen + e.payloadLen;
+    }
+    retire();
+}
+
+// ============================================================================
+// STREAMED PUBLISH
+// ============================================================================
+
+bool MqttClient::beginPublish(const char* topic, size_t length) {
+    size_t topicLen = strlen(topic);
+    if (!connected() || streaming || topicLen == 0 || topicLen > MQTT_TOPIC_MAX) return false;
+    if (!fitsBroker(topicLen, length)) {
+        clientStats.refused++;
+        return false;
+    }
+    // Ordered after what is queued: refused while the window holds some back
+    flush((size_t)-1);
+    if (connState != MQTT_CONNECTED) return false;
+    for (uint16_t i = 0; i < outCount; i++) {
+        if (entries[(outFirst + i) % MQTT_OUTBOX_MESSAGES].state == ENTRY_QUEUED) {
+            clientStats.refused++;
+            return false;
+        }
+    }
+    uint8_t header[MQTT_TOPIC_MAX + 16];
+    size_t n = publishHeader(header, topic, topicLen, length, 0, 0, false);
+    if (!sendPacket(header, n, nullptr, 0)) return false;
+    clientStats.published++;
+    streaming = true;
+    streamLeft = length;
+    return true;
+}
+
+size_t MqttClient::write(const uint8_t* data, size_t length) {
+    if (!streaming) return 0;
+    if (length > streamLeft) length = streamLeft;
+    size_t sent = net->write(data, length);
+    streamLeft -= sent;
+    if (sent != length) {
+        connectionLost(MQTT_CONNECTION_LOST);
+        return sent;
+    }
+    lastOutMs = millis();
+    return sent;
+}
+
+// A message cut short leaves the stream out of step: the connection goes
+bool MqttClient::endPublish() {
+    if (!streaming) return false;
+    streaming = false;
+    if (streamLeft) {
+        connectionLost(MQTT_CONNECTION_LOST);
+        return false;
+    }
+    return connState == MQTT_CONNECTED;
+}
+
+bool MqttClient::subscribe(const char* topic, uint8_t qos) {
+    size_t topicLen = strlen(topic);
+    if (!connected() || streaming || topicLen > MQTT_TOPIC_MAX) return false;
+    uint8_t packet[MQTT_TOPIC_MAX + 16];
+    size_t n = 0;
+    packet[n++] = PACKET_SUBSCRIBE;
+    n += putLength(packet + n, 2 + 1 + 2 + topicLen + 1);
+    packet[n++] = (uint8_t)(nextPacketId >> 8);
+    packet[n++] = (uint8_t)nextPacketId;
+    if (!++nextPacketId) nextPacketId = 1;
+    packet[n++] = 0;
+    n += putString(packet + n, topic, topicLen);
+    packet[n++] = qos ? 1 : 0;
+    return sendPacket(packet, n, nullptr, 0);
+}
+
+// ============================================================================
+// INBOUND
+// ============================================================================
+
+// Reads what is available towards one packet; true once buffer holds a
+// whole one (rxLen bytes). Larger than the buffer: skipped.
+bool MqttClient::readPacket() {
+    while (net->available() > 0) {
+        if (rxSkip) {
+            uint8_t scratch[64];
+            int n = net->read(scratch, rxSkip < sizeof(scratch) ? rxSkip : sizeof(scratch));
+            if (n <= 0) return false;
+            rxSkip -= n;
+            continue;
+        }
+        size_t remaining = 0;
+        size_t lenBytes = rxLen > 1 ? getLength(buffer + 1, rxLen - 1, &remaining) : 0;
+        if (!lenBytes) {
+            // Fixed header, a byte at a time
+            if (rxLen == 5) {
+                connectionLost(MQTT_CONNECTION_LOST);   // Malformed length
+                return false;
+            }
+            int c = net->read();
+            if (c < 0) return false;
+            buffer[rxLen++] = (uint8_t)c;
+            lenBytes = rxLen > 1 ? getLength(buffer + 1, rxLen - 1, &remaining) : 0;
+            if (!lenBytes) continue;
+            if (1 + lenBytes + remaining > bufferSize) {
+                rxSkip = remaining;
+                rxLen = 0;
+                continue;
+            }
+        }
+        size_t total = 1 + lenBytes + remaining;
+        if (rxLen < total) {
+            int avail = net->available();
+            size_t want = total - rxLen;
+            if (avail > 0 && (size_t)avail < want) want = (size_t)avail;
+            int n = want ? net->read(buffer + rxLen, want) : 0;
+            if (n < 0) return false;
+            rxLen += (size_t)n;
+        }
+        if (rxLen == total) return true;
+    }
+    return false;
+}
+
+void MqttClient::handlePacket(uint8_t* packet, size_t length) {
+    size_t remaining;
+    size_t h = 1 + getLength(packet + 1, length - 1, &remaining);
+    uint8_t* body = packet + h;
+    size_t len = length - h;
+    lastInMs = millis();
+
+    switch (packet[0] >> 4) {
+        case PACKET_CONNACK: {
+            if (len < 2) break;
+            if (body[1] >= 0x80) {
+                connState = MQTT_CONNECT_REFUSED;
+                break;
+            }
+            size_t propLen = 0;
+            size_t at = 2;
+            size_t n = len > at ? getLength(body + at, len - at, &propLen) : 0;
+            at += n;
+            size_t end = at + propLen <= len ? at + propLen : len;
+            while (at < end) {
+                uint8_t id = body[at++];
+                int size = propertySize(id, body + at, end - at);
+                if (size < 0) break;
+                if (id == PROP_RECEIVE_MAXIMUM) brokerReceiveMax = (uint16_t)((body[at] << 8) | body[at + 1]);
+                if (id == PROP_TOPIC_ALIAS_MAX) brokerAliasMax = (uint16_t)((body[at] << 8) | body[at + 1]);
+                if (id == PROP_MAXIMUM_PACKET) {
+                    brokerMaxPacket = ((uint32_t)body[at] << 24) | ((uint32_t)body[at + 1] << 16) |
+                                      ((uint32_t)body[at + 2] << 8) | body[at + 3];
+                }
+                at += size;
+            }
+            // Session not present: the broker lost it; what was in flight
+            // goes out again as new messages
+            bool present = body[0] & 0x01;
+            if (present) clientStats.sessionsResumed++;
+            for (uint16_t i = 0; i < outCount && !present; i++) entries[(outFirst + i) % MQTT_OUTBOX_MESSAGES].dup = false;
+            connState = MQTT_CONNECTED;
+            break;
+        }
+        case PACKET_PUBLISH: {
+            uint8_t qos = (packet[0] >> 1) & 0x03;
+            if (len < 2) break;
+            size_t topicLen = (body[0] << 8) | body[1];
+            size_t at = 2 + topicLen;
+            uint16_t packetId = 0;
+            if (qos) {
+                if (at + 2 > len) break;
+                packetId = (uint16_t)((body[at] << 8) | body[at + 1]);
+                at += 2;
+            }
+            size_t propLen = 0;
+            size_t n = at < len ? getLength(body + at, len - at, &propLen) : 0;
+            if (!n || at + n + propLen > len) break;
+            at += n + propLen;
+            // Topic moved over its length field to end it with a NUL
+            memmove(body, body + 2, topicLen);
+            body[topicLen] = '\0';
+            if (callback) callback((char*)body, body + at, (unsigned int)(len - at));
+            if (qos) {
+                uint8_t ack[4] = {PACKET_PUBACK << 4, 2, (uint8_t)(packetId >> 8), (uint8_t)packetId};
+                sendPacket(ack, sizeof(ack), nullptr, 0);
+            }
+            break;
+        }
+        case PACKET_PUBACK: {
+            if (len < 2) break;
+            uint16_t packetId = (uint16_t)((body[0] << 8) | body[1]);
+            uint8_t reason = len >= 3 ? body[2] : 0;
+            for (uint16_t i = 0; i < outCount; i++) {
+                OutboxEntry& e = entries[(outFirst + i) % MQTT_OUTBOX_MESSAGES];
+                if (e.state != ENTRY_AWAITING || e.packetId != packetId) continue;
+                e.state = ENTRY_DONE;
+                inflightCount--;
+                clientStats.acked++;
+                if (reason >= 0x80) clientStats.rejected++;
+                break;
+            }
+            retire();
+            break;
+        }
+        case PACKET_PINGRESP:
+            pingOutstanding = false;
+            break;
+        case PACKET_DISCONNECT:
+            connectionLost(MQTT_CONNECTION_LOST);
+            break;
+        default:
+            break;      // SUBACK
+    }
+}
+
+bool MqttClient::loop() {
+    if (connState == MQTT_CONNECTING && !awaitConnack()) return false;
+    if (!connected()) return false;
+    unsigned long now = millis();
+    if (keepAliveS && (now - lastInMs >= keepAliveS * 1000UL || now - lastOutMs >= keepAliveS * 1000UL)) {
+        if (pingOutstanding) {
+            connectionLost(MQTT_CONNECTION_TIMEOUT);
+            return false;
+        }
+        static const uint8_t ping[2] = {PACKET_PINGREQ, 0};
+        if (!sendPacket(ping, sizeof(ping), nullptr, 0)) return false;
+        pingOutstanding = true;
+        lastInMs = now;         // The PINGRESP gets a keep-alive period
+    }
+
+    while (connState == MQTT_CONNECTED && readPacket()) {
+        handlePacket(buffer, rxLen);
+        rxLen = 0;
+    }
+
+    flush(MQTT_FLUSH_BYTES);
+
+    // Whatever the broker already answered
+    while (connState == MQTT_CONNECTED && readPacket()) {
+        handlePacket(buffer, rxLen);
+        rxLen = 0;
+    }
+    return connState == MQTT_CONNECTED;
+}
@@ -0,0 +1,177 @@
+#ifndef MQTT_CLIENT_H
+#define MQTT_CLIENT_H
+
+#include <Arduino.h>
+#include <WiFi.h>
+#include "config.h"
+
+// MQTT 5 client over a socket the caller opened (mqtt_driver.cpp: TLS to
+// the address net_link.h found). Replaces PubSubClient, which publishes at
+// QoS 0 only and writes every publish to the socket from the caller.
+//
+// connect() sends CONNECT and returns; loop() takes the CONNACK (or gives
+// up after the socket timeout), so nothing waits for the broker.
+//
+// publish() copies topic and payload into the outbox (MQTT_OUTBOX_BYTES)
+// and returns; loop() reads what the broker sent, then writes the outbox,
+// at most MQTT_FLUSH_BYTES per call (publish() does the same first when the
+// outbox is full). A message over the broker's Maximum Packet Size is
+// refused. QoS 1 publishes stay in the outbox
+// until their PUBACK, up to MQTT_INFLIGHT_WINDOW (or the broker's Receive
+// Maximum) in flight at a time, in order. MQTT 5 allows no resend on a live
+// connection (TCP loses nothing): a missing PUBACK waits for the reconnect.
+//
+// Session: with a session expiry the broker keeps the subscriptions and
+// the QoS 1 messages towards the device while it is away, and the client
+// keeps its unacknowledged QoS 1 publishes, resent with DUP after the
+// reconnect.
+// Queued QoS 0 publishes are dropped with the connection. The outbox is in
+// RAM: a deep sleep or reset loses it (mqtt_driver.cpp waits for idle()).
+//
+// Topic aliases: the first MQTT_TOPIC_ALIASES topics (up to the broker's
+// Topic Alias Maximum) get a number per connection; after the first PUBLISH
+// a message on one carries 2 bytes instead of the topic.
+//
+// beginPublish()/write()/endPublish() stream one QoS 0 message straight
+// from the caller's memory, past the outbox (images, replay batches); what
+// is queued before it goes out first, so beginPublish() fails while the
+// window holds queued publishes back. One task only.
+
+#define MQTT_CONNECTING             -5  // CONNECT sent, CONNACK not in yet
+#define MQTT_CONNECTION_TIMEOUT     -4
+#define MQTT_CONNECTION_LOST        -3
+#define MQTT_CONNECT_FAILED         -2
+#define MQTT_DISCONNECTED           -1
+#define MQTT_CONNECTED               0
+#define MQTT_CONNECT_REFUSED         5  // CONNACK reason code 0x80 or above
+
+typedef void (*MqttCallback)(char* topic, uint8_t* payload, unsigned int length);
+
+struct MqttClientStats {
+    uint32_t published;         // PUBLISH packets written, resends not included
+    uint32_t acked;             // QoS 1 PUBACKs
+    uint32_t rejected;          // PUBACKs with a failure reason code
+    uint32_t retransmits;       // QoS 1 sent again after a reconnect
+    uint32_t refused;           // publish() with the outbox full or no connection
+    uint32_t dropped;           // Queued QoS 0 lost with the connection
+    uint32_t inflightMax;
+    uint32_t outboxMax;         // Outbox bytes, high-water mark
+    uint32_t aliased;           // PUBLISH sent with an alias instead of the topic
+    uint32_t sessionsResumed;   // CONNACKs with the session present
+    uint64_t bytesQueued;       // Payload bytes copied into the outbox
+};
+
+class MqttClient {
+public:
+    explicit MqttClient(WiFiClient& net);
+
+    MqttClient& setCallback(MqttCallback callback);
+    // Inbound packets (ACKs, requests, rulesets); larger ones are skipped
+    bool setBufferSize(uint16_t size);
+    uint16_t getBufferSize() { return bufferSize; }
+    MqttClient& setKeepAlive(uint16_t seconds);
+    // 0: the session ends with the connection (clean start)
+    MqttClient& setSessionExpiry(uint32_t seconds);
+    MqttClient& setSocketTimeout(uint16_t seconds);
+    // At most MQTT_INFLIGHT_WINDOW
+    MqttClient& setInflightWindow(uint8_t window);
+    // At most MQTT_TOPIC_ALIASES (0: topics always in full)
+    MqttClient& setTopicAliases(uint8_t aliases);
+
+    // CONNECT on the open socket; false if it could not be sent. connected()
+    // turns true once loop() has the CONNACK.
+    bool connect(const char* id, const char* user, const char* pass);
+    // DISCONNECT, then closes the socket (the broker keeps the session)
+    void disconnect();
+    // Boot: no connection, nothing queued
+    void reset();
+    bool connected();
+    // CONNECT sent, waiting for the CONNACK (loop())
+    bool connecting() const { return connState == MQTT_CONNECTING; }
+    int state() { return connState; }
+
+    // False with no connection or no room in the outbox
+    bool publish(const char* topic, const uint8_t* payload, size_t length, uint8_t qos = 0);
+    bool publish(const char* topic, const char* payload, uint8_t qos = 0);
+
+    bool beginPublish(const char* topic, size_t length);
+    size_t write(const uint8_t* data, size_t length);
+    bool endPublish();
+
+    // Sent now; the broker confirms asynchronously (SUBACK is not checked)
+    bool subscribe(const char* topic, uint8_t qos = 0);
+
+    // Takes the CONNACK; reads, retransmits, writes the outbox. False
+    // without a connection.
+    bool loop();
+    // Nothing queued and no QoS 1 publish waiting for its PUBACK
+    bool idle() const { return outCount == 0; }
+    uint8_t inflight() const { return inflightCount; }
+    MqttClientStats stats() const { return clientStats; }
+
+private:
+    enum EntryState : uint8_t { ENTRY_QUEUED, ENTRY_AWAITING, ENTRY_DONE };
+
+    struct OutboxEntry {
+        uint16_t offset;        // Topic, then payload, in outbox[]
+        uint16_t topicLen;
+        uint16_t payloadLen;
+        uint16_t packetId;      // QoS 1
+        uint8_t qos;
+        uint8_t state;
+        bool dup;               // Sent before: resend with DUP
+    };
+
+    WiFiClient* net;
+    MqttCallback callback;
+    uint8_t* buffer;            // Inbound packet
+    uint16_t bufferSize;
+    uint16_t keepAliveS;
+    uint32_t sessionExpiryS;
+    uint16_t socketTimeoutS;
+    uint8_t window;
+    uint8_t aliasLimit;
+    int connState;
+
+    // Outbox: entries in publish order, their bytes in a ring
+    uint8_t outbox[MQTT_OUTBOX_BYTES];
+    OutboxEntry entries[MQTT_OUTBOX_MESSAGES];
+    uint16_t outFirst;
+    uint16_t outCount;
+    uint16_t outTail;           // Next free byte
+    uint16_t nextPacketId;
+    uint8_t inflightCount;
+
+    // This connection
+    uint16_t brokerAliasMax;
+    uint16_t brokerReceiveMax;
+    uint32_t brokerMaxPacket;   // 0: no limit
+    uint8_t aliasCount;
+    char aliases[MQTT_TOPIC_ALIASES][MQTT_TOPIC_ALIAS_LEN];
+    size_t rxLen;               // Bytes of the current inbound packet in buffer
+    size_t rxSkip;              // Bytes still to discard of one too large
+    unsigned long lastOutMs;
+    unsigned long lastInMs;
+    unsigned long connectStartMs;
+    bool pingOutstanding;
+    bool streaming;
+    size_t streamLeft;
+
+    MqttClientStats clientStats;
+
+    bool sendPacket(const uint8_t* header, size_t headerLen, const uint8_t* body, size_t bodyLen);
+    bool sendEntry(OutboxEntry& e);
+    size_t publishHeader(uint8_t* out, const char* topic, size_t topicLen, size_t payloadLen, uint8_t qos,
+                         uint16_t packetId, bool dup);
+    bool fitsBroker(size_t topicLen, size_t payloadLen) const;
+    int aliasFor(const char* topic, size_t topicLen, bool* isNew);
+    bool reserve(size_t length, uint16_t* offset);
+    void retire();
+    void flush(size_t budget);
+    void connectionLost(int reason);
+    bool awaitConnack();
+    bool readPacket();
+    void handlePacket(uint8_t* packet, size_t length);
+};
+
+#endif
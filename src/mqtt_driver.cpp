@@ -1,188 +1,756 @@
 #include "mqtt_driver.h"
+#include "telemetry_frame.h"
+#include "offline_queue.h"
+#include "image_transfer.h"
+#include "image_delta.h"
+#include "checksum.h"
+#include "net_link.h"
+#include "rules.h"
+#include "series_codec.h"
+#include "perf_metrics.h"
+#include <esp_sntp.h>
 #include <time.h>
 
 WiFiClientSecure espClient;
-PubSubClient client(espClient);
+MqttClient client(espClient);
 char topicBuffer[128];
+uint32_t telemetrySeq = 0;
 
+// Image transfer state, updated by callback() while sendImage() runs
+static ImageSender imageTx;
+static uint16_t nextImageId = 0;
+static volatile bool imageRequested = false;
+static volatile bool keyframeRequested = false;
+
+#if ENABLE_OFFLINE_QUEUE
+static uint8_t* replayImageBuffer = nullptr;    // A queued image put back together (PSRAM)
+#endif
+
+// Runtime topic builder, only for suffixes not known at compile time.
+// Fixed topics use MQTT_TOPIC() from config.h.
 const char* getTopic(const char* suffix) {
     snprintf(topicBuffer, sizeof(topicBuffer), "%s%s/%s", TOPIC_PREFIX, SECRET_MQTT_CLIENT_ID, suffix);
     return topicBuffer;
 }
 
+// Every publish goes through here or publishStreamed(): refusals are counted.
+// Queued in the client's outbox; loopMQTT()/flushMQTT() write it.
+static bool mqttPublish(const char* topic, const uint8_t* payload, size_t len, uint8_t qos = 0) {
+    bool ok = client.publish(topic, payload, len, qos);
+    if (!ok) PERF_COUNT(PERF_PUBLISH_FAILED);
+    return ok;
+}
+
+static bool mqttPublish(const char* topic, const char* payload, uint8_t qos = 0) {
+    return mqttPublish(topic, (const uint8_t*)payload, strlen(payload), qos);
+}
+
+#if ENABLE_RULE_UPDATES
+static_assert(RULES_BLOB_MAX + sizeof(MQTT_TOPIC(TOPIC_RULES)) + 8 <= MQTT_BUFFER_SIZE,
+              "a full ruleset does not fit the MQTT buffer");
+
+// Ruleset update: validated here, adopted by the acquisition side at its
+// next evaluation (rules.h). The outcome goes back on TOPIC_RULES_ACK.
+static void receiveRules(const uint8_t* payload, unsigned int length) {
+    uint16_t version;
+    RuleError err = rulesOffer(payload, length, &version);
+    char ack[64];
+    snprintf(ack, sizeof(ack), "{\"version\":%u,\"result\":\"%s\"}", (unsigned)version, rulesErrorName(err));
+    mqttPublish(MQTT_TOPIC(TOPIC_RULES_ACK), ack, MQTT_QOS_EVENTS);
+    if (err == RULES_OK) LOG_INFO("📜 Rules v%u received (%u bytes)", (unsigned)version, length);
+    else LOG_WARN("📜 Rules v%u rejected: %s", (unsigned)version, rulesErrorName(err));
+}
+#endif
+
 void callback(char* topic, byte* payload, unsigned int length) {
-    // Futuro: Implementar recepção de ACK aqui se necessário
-    // Por enquanto, apenas logamos
+    if (strcmp(topic, MQTT_TOPIC(TOPIC_CAM_ACK)) == 0) {
+        imageSenderApplyAck(imageTx, payload, length);
+        return;
+    }
+    if (strcmp(topic, MQTT_TOPIC(TOPIC_CAM_REQ)) == 0) {
+        if (length == 3 && memcmp(payload, "key", 3) == 0) keyframeRequested = true;
+        else imageRequested = true;
+        return;
+    }
+    #if ENABLE_RULE_UPDATES
+        if (strcmp(topic, MQTT_TOPIC(TOPIC_RULES)) == 0) {
+            receiveRules(payload, length);
+            return;
+        }
+    #endif
     Serial.print("Message arrived [");
     Serial.print(topic);
     Serial.print("] ");
-    for (int i = 0; i < length; i++) {
+    for (unsigned int i = 0; i < length; i++) {
         Serial.print((char)payload[i]);
     }
     Serial.println();
 }
 
-void syncTime() {
-    Serial.print("⏳ NTP Sync...");
-    configTime(0, 0, "pool.ntp.org", "time.nist.gov"); 
-    
-    time_t now = time(nullptr);
-    int retry = 0;
-    while (now < 100000 && retry < 20) {
-        delay(500);
-        Serial.print(".");
-        now = time(nullptr);
-        retry++;
-    }
-    
-    if (now > 100000) {
-        Serial.println(" OK!");
-    } else {
-        Serial.println(" Failed (Time is wrong, SSL might fail)");
-    }
+// Log sink: forwards drained WARN/ERROR lines to the log topic (the level
+// is already filtered by LOG_MQTT_MIN_LEVEL)
+void publishLogLine(uint8_t, const char* line) {
+    if (client.connected()) mqttPublish(MQTT_TOPIC(TOPIC_LOG), line);
 }
 
-void initMQTT() {
-    syncTime();
+// NTP runs in the background (lwIP SNTP); loopMQTT() reports when it lands.
+// TLS uses setInsecure(), so nothing waits for the clock.
+static bool timeSyncPending = false;
+static volatile unsigned long connectedAtMs = 0;
+
+// Reconnect back-off: doubles per failed connect, reset by a good one
+static uint32_t backoffMs = 0;
+static unsigned long nextAttemptMs = 0;
+static uint32_t connectFailures = 0;    // Since the last good connect
+static bool connackPending = false;     // CONNECT sent: client.loop() takes the CONNACK
+
+#if TELEMETRY_MODE == TELEMETRY_MODE_BATCH
+static void batchReset();
+static unsigned long batchStartedMs = 0;    // This boot: first sample, or the wake-up
+#endif
+
+void initMQTT(bool warmBoot) {
+    connectedAtMs = 0;
+    timeSyncPending = !warmBoot;
+    if (timeSyncPending) configTime(0, 0, "pool.ntp.org", "time.nist.gov");
+    backoffMs = 0;
+    nextAttemptMs = millis();
+    connectFailures = 0;
+    connackPending = false;
+    #if TELEMETRY_MODE == TELEMETRY_MODE_BATCH
+        if (!warmBoot) batchReset();
+        batchStartedMs = millis();
+    #endif
 
     espClient.setInsecure();
     espClient.setTimeout(15);
 
-    Serial.print("🔍 DNS check: ");
+    // A reset or deep sleep lost the outbox; the broker kept the session
+    client.reset();
+    client.setCallback(callback);
+    client.setKeepAlive(MQTT_KEEPALIVE_S);
+    client.setSessionExpiry(MQTT_SESSION_EXPIRY_S);
+    if (client.setBufferSize(MQTT_BUFFER_SIZE)) {
+        Serial.printf("📦 MQTT Buffer Size: %d bytes\n", MQTT_BUFFER_SIZE);
+    } else {
+        Serial.println("❌ Failed to set MQTT Buffer Size");
+    }
+
+    #if LOG_MQTT_MIN_LEVEL > 0
+        logSetSink(publishLogLine, LOG_MQTT_MIN_LEVEL);
+    #endif
+    #if ENABLE_OFFLINE_QUEUE
+        // Taken once, so a replay never allocates; without PSRAM images are
+        // not queued
+        if (!replayImageBuffer && psramFound()) replayImageBuffer = (uint8_t*)ps_malloc(OFFLINE_IMAGE_MAX);
+    #endif
+}
+
+static void connectFailed() {
+    PERF_COUNT(PERF_CONNECT_FAILED);
+    connectFailures++;
+    backoffMs = backoffMs ? backoffMs * 2 : MQTT_BACKOFF_MIN_MS;
+    if (backoffMs > MQTT_BACKOFF_MAX_MS) backoffMs = MQTT_BACKOFF_MAX_MS;
+    // Jitter: a fleet that lost the broker together does not retry together
+    uint32_t wait = backoffMs + (uint32_t)random(backoffMs / 4 + 1);
+    nextAttemptMs = millis() + wait;
+}
+
+static void connectError() {
+    // Static: the logger keeps the pointer until the line is drained
+    static char errBuf[100];
+    espClient.lastError(errBuf, sizeof(errBuf));
+    espClient.stop();
+    netBrokerFailed();
+    connectFailed();
+    LOG_WARN("📡 MQTT failed, rc=%d (SSL: %s), retry in %lu ms", client.state(), errBuf,
+             (unsigned long)(nextAttemptMs - millis()));
+}
+
+// One attempt when the back-off allows it, to the address net_link.h has
+// (TLS with SNI on the broker name; the MQTT client uses the open socket).
+// The CONNACK is left to client.loop(): connectDone() finishes the attempt.
+void reconnect() {
+    if (client.connected() || connackPending || (long)(millis() - nextAttemptMs) < 0) return;
+
     IPAddress ip;
-    if(WiFi.hostByName(SECRET_MQTT_SERVER, ip)) {
-        Serial.print("OK (");
-        Serial.print(ip);
-        Serial.println(")");
+    NetLookup lookup = netBrokerAddress(&ip);
+    if (lookup == NET_LOOKUP_PENDING) return;
+    if (lookup == NET_LOOKUP_FAILED) {
+        connectFailed();
+        LOG_WARN("📡 Broker address unknown, retry in %lu ms", (unsigned long)(nextAttemptMs - millis()));
+        return;
+    }
+
+    PERF_SCOPE(PERF_RECONNECT);
+    LOG_INFO("📡 Connecting to HiveMQ...");
+    if (espClient.connect(ip, SECRET_MQTT_PORT, SECRET_MQTT_SERVER, nullptr, nullptr, nullptr) &&
+        client.connect(SECRET_MQTT_CLIENT_ID, SECRET_MQTT_USER, SECRET_MQTT_PASSWORD)) {
+        connackPending = true;
     } else {
-        Serial.println("❌ DNS FAIL! Check secrets.h");
+        connectError();
     }
+}
 
-    client.setServer(SECRET_MQTT_SERVER, SECRET_MQTT_PORT);
-    client.setCallback(callback);
-    if (client.setBufferSize(MQTT_MAX_PACKET_SIZE)) {
-        Serial.printf("📦 MQTT Buffer Size: %d bytes\n", MQTT_MAX_PACKET_SIZE);
+// The CONNACK arrived, or the client gave up waiting for it
+static void connectDone() {
+    if (!connackPending || client.connecting()) return;
+    connackPending = false;
+    if (client.connected()) {
+        if (!connectedAtMs) connectedAtMs = millis();
+        PERF_COUNT(PERF_CONNECTS);
+        LOG_INFO("📡 MQTT Connected!");
+        backoffMs = 0;
+        connectFailures = 0;
+        // Chunk ACKs are resent by the window; requests and rulesets are not
+        client.subscribe(MQTT_TOPIC(TOPIC_CAM_ACK));
+        client.subscribe(MQTT_TOPIC(TOPIC_CAM_REQ), 1);
+        #if ENABLE_RULE_UPDATES
+            client.subscribe(MQTT_TOPIC(TOPIC_RULES), 1);
+        #endif
+        mqttPublish(MQTT_TOPIC(TOPIC_MODE), "BOOT_ONLINE", MQTT_QOS_EVENTS);
     } else {
-        Serial.println("❌ Failed to set MQTT Buffer Size");
+        connectError();
     }
 }
 
-void reconnect() {
-    if (!client.connected()) {
-        Serial.print("📡 Connecting to HiveMQ...");
-        if (client.connect(SECRET_MQTT_CLIENT_ID, SECRET_MQTT_USER, SECRET_MQTT_PASSWORD)) {
-            Serial.println(" Connected!");
-            client.subscribe(getTopic(TOPIC_CAM_ACK));
-            client.publish(getTopic(TOPIC_MODE), "BOOT_ONLINE");
-        } else {
-            Serial.print(" failed, rc=");
-            Serial.print(client.state());
-            char errBuf[100];
-            espClient.lastError(errBuf, 100);
-            Serial.printf(" (SSL: %s)\n", errBuf);
-            Serial.println(" try again in next loop");
+static bool sendImage(const uint8_t* imageBuffer, size_t length);
+
+// One QoS 0 message written straight from the caller's memory, past the
+// outbox, so payloads may exceed it
+static bool publishStreamed(const char* topic, const uint8_t* head, size_t headLen,
+                            const uint8_t* data, size_t len) {
+    bool ok = client.beginPublish(topic, headLen + len);
+    if (ok) {
+        ok = !headLen || client.write(head, headLen) == headLen;
+        ok = ok && (!len || client.write(data, len) == len);
+        ok = client.endPublish() && ok;
+    }
+    if (!ok) PERF_COUNT(PERF_PUBLISH_FAILED);
+    return ok;
+}
+
+#if ENABLE_OFFLINE_QUEUE
+static uint8_t replayRecord[OFFLINE_IMAGE_CHUNK + 4];
+static uint8_t replayBatch[OFFLINE_REPLAY_BATCH];
+static uint16_t offlineImageId = 0;
+
+static inline uint16_t get16(const uint8_t* p) { return (uint16_t)(p[0] | (p[1] << 8)); }
+static inline uint32_t get32(const uint8_t* p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+static inline void put16(uint8_t* p, uint16_t v) { p[0] = (uint8_t)v; p[1] = (uint8_t)(v >> 8); }
+static inline void put32(uint8_t* p, uint32_t v) { put16(p, (uint16_t)v); put16(p + 2, (uint16_t)(v >> 16)); }
+
+// Stores an image as a head record plus OFFLINE_IMAGE_CHUNK data records
+static bool queueImage(const uint8_t* imageBuffer, size_t length) {
+    if (!replayImageBuffer || length > OFFLINE_IMAGE_MAX) {
+        LOG_WARN("💾 Image not queued offline (%u bytes, replay room %u)", (unsigned)length,
+                 (unsigned)(replayImageBuffer ? OFFLINE_IMAGE_MAX : 0));
+        return false;
+    }
+    uint16_t id = offlineImageId++;
+    uint16_t chunks = (uint16_t)((length + OFFLINE_IMAGE_CHUNK - 1) / OFFLINE_IMAGE_CHUNK);
+    uint8_t head[8];
+    put16(head, id);
+    put16(head + 2, chunks);
+    put32(head + 4, (uint32_t)length);
+    if (!offlineQueuePush(OFFLINE_IMAGE_HEAD, head, sizeof(head))) return false;
+    for (uint16_t i = 0; i < chunks; i++) {
+        size_t offset = (size_t)i * OFFLINE_IMAGE_CHUNK;
+        size_t n = length - offset;
+        if (n > OFFLINE_IMAGE_CHUNK) n = OFFLINE_IMAGE_CHUNK;
+        put16(replayRecord, id);
+        put16(replayRecord + 2, i);
+        memcpy(replayRecord + 4, imageBuffer + offset, n);
+        if (!offlineQueuePush(OFFLINE_IMAGE_DATA, replayRecord, n + 4)) return false;
+    }
+    LOG_INFO("💾 Image queued offline (%u bytes)", (unsigned)length);
+    return true;
+}
+
+// Reassembles a queued image in PSRAM and sends it. Returns false if the
+// connection dropped and it must be retried; an incomplete image (chunks
+// overwritten) or one the dashboard never ACKs is discarded.
+static bool replayImage(OfflineCursor* cursor) {
+    uint16_t id = get16(replayRecord);
+    uint16_t chunks = get16(replayRecord + 2);
+    uint32_t length = get32(replayRecord + 4);
+    OfflineCursor done = *cursor;
+
+    uint8_t* image = replayImageBuffer;
+    bool complete = image && length <= OFFLINE_IMAGE_MAX;
+    for (uint16_t i = 0; i < chunks && complete; i++) {
+        OfflineRecord rec;
+        OfflineCursor next = done;
+        complete = offlineQueueRead(&next, &rec, replayRecord, sizeof(replayRecord)) &&
+                   rec.kind == OFFLINE_IMAGE_DATA && get16(replayRecord) == id && get16(replayRecord + 2) == i;
+        if (!complete) break;
+        size_t offset = (size_t)i * OFFLINE_IMAGE_CHUNK;
+        size_t n = rec.len - 4;
+        if (offset + n > length) n = length - offset;
+        memcpy(image + offset, replayRecord + 4, n);
+        done = next;
+    }
+
+    bool ok = true;
+    if (complete) {
+        ok = sendImage(image, length) || client.connected();
+    } else {
+        LOG_WARN("💾 Queued image %u incomplete, discarded", (unsigned)id);
+    }
+    if (ok) *cursor = done;
+    return ok;
+}
+
+// Drains the offline queue oldest-first within OFFLINE_REPLAY_BUDGET_MS.
+// Consecutive telemetry frames go out concatenated on TOPIC_REPLAY.
+static void replayOfflineQueue() {
+    if (offlineQueueEmpty()) return;
+    unsigned long start = millis();
+
+    while (!offlineQueueEmpty() && client.connected() && millis() - start < OFFLINE_REPLAY_BUDGET_MS) {
+        OfflineCursor cursor;
+        OfflineRecord rec;
+        offlineQueueBegin(&cursor);
+        if (!offlineQueueRead(&cursor, &rec, replayRecord, sizeof(replayRecord))) break;
+
+        bool ok = true;
+        switch (rec.kind) {
+            case OFFLINE_TELEMETRY: {
+                size_t used = 0;
+                OfflineCursor batchEnd = cursor;
+                do {
+                    memcpy(replayBatch + used, replayRecord, rec.len);
+                    used += rec.len;
+                    batchEnd = cursor;
+                } while (used + TELEMETRY_FRAME_SIZE <= sizeof(replayBatch) &&
+                         offlineQueueRead(&cursor, &rec, replayRecord, sizeof(replayRecord)) &&
+                         rec.kind == OFFLINE_TELEMETRY && rec.len <= sizeof(replayBatch) - used);
+                cursor = batchEnd;
+                ok = publishStreamed(MQTT_TOPIC(TOPIC_REPLAY), nullptr, 0, replayBatch, used);
+                break;
+            }
+            case OFFLINE_ALERT:
+                ok = mqttPublish(MQTT_TOPIC(TOPIC_ALERT), replayRecord[0] ? "true" : "false", MQTT_QOS_EVENTS);
+                break;
+            case OFFLINE_STATE:
+                ok = mqttPublish(MQTT_TOPIC(TOPIC_MODE), replayRecord, rec.len, MQTT_QOS_EVENTS);
+                break;
+            case OFFLINE_BATCH:
+                ok = publishStreamed(MQTT_TOPIC(TOPIC_BATCH), nullptr, 0, replayRecord, rec.len);
+                break;
+            case OFFLINE_IMAGE_HEAD:
+                ok = replayImage(&cursor);
+                break;
+            default:
+                break;      // Orphan image data: skip
         }
+        if (!ok) break;
+        offlineQueueConsume(cursor);
+    }
+
+    if (offlineQueueEmpty()) {
+        OfflineQueueStats st = offlineQueueStats();
+        char json[160];
+        snprintf(json, sizeof(json),
+                 "{\"replayed\":%u,\"ms\":%u,\"rate\":%.1f,\"dropped\":%u,\"corrupt\":%u}",
+                 (unsigned)st.lastReplayCount, (unsigned)st.lastReplayMs, st.lastReplayRate,
+                 (unsigned)st.dropped, (unsigned)st.corrupt);
+        mqttPublish(MQTT_TOPIC(TOPIC_QUEUE), json);
+        LOG_INFO("💾 Offline queue replayed: %u records in %u ms", (unsigned)st.lastReplayCount,
+                 (unsigned)st.lastReplayMs);
+    }
+}
+#endif
+
+// Epoch seconds once NTP has synced; uptime seconds before (returns true)
+static bool telemetryClock(uint32_t* timestamp) {
+    time_t now = time(nullptr);
+    if (now > 1600000000) {
+        *timestamp = (uint32_t)now;
+        return false;
+    }
+    *timestamp = millis() / 1000;
+    return true;
+}
+
+#if TELEMETRY_MODE == TELEMETRY_MODE_BATCH
+static_assert(6 + 4 * (SENSOR_MAX_CHANNELS - 1) <= SERIES_MAX_COLUMNS, "too many channels for a batch");
+#if ENABLE_OFFLINE_QUEUE
+static_assert(TELEMETRY_BATCH_BYTES <= sizeof(replayRecord), "a queued batch does not fit the replay buffer");
+#endif
+
+// The batch being filled. In RTC memory, so a deep sleep keeps it; a cold
+// boot drops it (initMQTT()).
+struct TelemetryBatch {
+    SeriesEncoder enc;
+    uint32_t seq;
+    uint32_t start;             // Timestamp of the first sample
+    uint8_t flags;
+    uint8_t data[TELEMETRY_BATCH_BYTES];
+};
+
+RTC_DATA_ATTR static TelemetryBatch batch;
+
+static void batchReset() { memset(&batch, 0, sizeof(batch)); }
+
+// The SystemStatus floats, then channels 1.. of each SensorBank array (the
+// version 3 frame order), snapped to their SERIES_STEP_*
+static uint8_t batchColumns(const SystemStatus& status, const SensorBank& bank, float* out) {
+    static const float steps[] = {SERIES_STEP_TEMP, SERIES_STEP_HUMIDITY, SERIES_STEP_LUX,
+                                  SERIES_STEP_DUST, SERIES_STEP_EFFICIENCY, SERIES_STEP_SOILING};
+    const float fields[] = {status.temp, status.humidity, status.lux, status.dust, status.efficiency, status.soiling};
+    uint8_t n = 0;
+    for (uint8_t i = 0; i < 6; i++) out[n++] = seriesQuantize(fields[i], steps[i]);
+    const float* arrays[] = {bank.temp, bank.humidity, bank.lux, bank.dust};
+    for (uint8_t a = 0; a < 4; a++) {
+        for (uint8_t i = 1; i < bank.channels; i++) out[n++] = seriesQuantize(arrays[a][i], steps[a]);
+    }
+    return n;
+}
+
+// Sends the batch, or queues it offline
+static void flushBatch() {
+    size_t len = seriesFinish(&batch.enc);
+    if (!len) return;
+    bool sent = client.connected() && publishStreamed(MQTT_TOPIC(TOPIC_BATCH), nullptr, 0, batch.data, len);
+    #if ENABLE_OFFLINE_QUEUE
+        if (!sent) sent = offlineQueuePush(OFFLINE_BATCH, batch.data, len);
+    #endif
+    if (!sent) LOG_WARN("📦 Batch of %u samples lost", (unsigned)batch.enc.count);
+    batch.enc.count = 0;
+}
+
+static void batchAppend(const SystemStatus& status, const SensorBank& bank) {
+    float values[SERIES_MAX_COLUMNS];
+    uint8_t columns = batchColumns(status, bank, values);
+    uint32_t timestamp;
+    uint8_t flags = telemetryClock(&timestamp) ? SERIES_FLAG_UPTIME : 0;
+    // Same clock and layout, and room left: else a new batch
+    if (batch.enc.count && batch.enc.columns == columns && batch.flags == flags &&
+        seriesAppend(&batch.enc, timestamp, (uint8_t)status.mode, values)) {
+        return;
     }
+    flushBatch();
+    seriesBegin(&batch.enc, batch.data, sizeof(batch.data), columns, flags, batch.seq++);
+    batch.start = timestamp;
+    batch.flags = flags;
+    batchStartedMs = millis();
+    seriesAppend(&batch.enc, timestamp, (uint8_t)status.mode, values);
 }
 
+// Aged by millis() within a boot, and by the samples' clock across deep
+// sleeps (once synced, the RTC keeps it); a clock change ends the batch
+static void flushBatchIfDue() {
+    if (!batch.enc.count) return;
+    uint32_t now;
+    uint8_t flags = telemetryClock(&now) ? SERIES_FLAG_UPTIME : 0;
+    bool due = millis() - batchStartedMs >= TELEMETRY_BATCH_MS || flags != batch.flags || now < batch.start ||
+               (uint64_t)(now - batch.start) * 1000 >= TELEMETRY_BATCH_MS;
+    if (due) flushBatch();
+}
+#endif
+
+#if ENABLE_PERF_METRICS
+// Skipped while offline: the interval runs on until the next connection
+static void publishMetricsIfDue() {
+    static PerfReport report;
+    static char json[PERF_REPORT_BUFFER];
+    if (!perfReportDue(&report)) return;
+    size_t len = perfReportJson(report, json, sizeof(json));
+    if (len) publishStreamed(MQTT_TOPIC(TOPIC_METRICS), nullptr, 0, (const uint8_t*)json, len);
+    else LOG_WARN("📈 Metrics report over %u bytes", (unsigned)sizeof(json));
+}
+#endif
+
 void loopMQTT() {
-    if (WiFi.status() == WL_CONNECTED) {
-        if (!client.connected()) {
-            reconnect();
-        }
-        client.loop();
+    PERF_SCOPE(PERF_MQTT);
+    if (!netLinkUp()) return;
+    if (timeSyncPending && sntp_get_sync_status() == SNTP_SYNC_STATUS_COMPLETED) {
+        timeSyncPending = false;
+        LOG_INFO("⏰ NTP synced");
+    }
+    if (!client.connected()) {
+        reconnect();
     }
+    client.loop();
+    connectDone();
+    #if TELEMETRY_MODE == TELEMETRY_MODE_BATCH
+        flushBatchIfDue();
+    #endif
+    #if ENABLE_OFFLINE_QUEUE
+        if (client.connected()) replayOfflineQueue();
+    #endif
+    #if ENABLE_PERF_METRICS
+        if (client.connected()) publishMetricsIfDue();
+    #endif
 }
 
-bool publishTelemetry(SystemStatus status) {
-    if (!client.connected()) return false;
+void flushMQTT() {
+    if (netLinkUp()) client.loop();
+}
 
-    client.publish(getTopic(TOPIC_TEMP), String(status.temp, 1).c_str());
-    client.publish(getTopic(TOPIC_HUM), String(status.humidity, 1).c_str());
-    client.publish(getTopic(TOPIC_LUX), String(status.lux, 0).c_str());
-    client.publish(getTopic(TOPIC_DUST), String(status.dust, 0).c_str());
-    
+unsigned long mqttConnectedAtMs() { return connectedAtMs; }
+
+bool mqttIdle() {
+    // Still coming up on this boot: what was submitted waits for it
+    if (!client.connected()) {
+        bool linkUp = WiFi.status() == WL_CONNECTED;
+        return connectFailures > 0 || (!linkUp && !netLinkJoining());
+    }
+    #if ENABLE_OFFLINE_QUEUE
+        return client.idle() && offlineQueueEmpty();
+    #else
+        return client.idle();
+    #endif
+}
+
+#if TELEMETRY_MODE == TELEMETRY_MODE_TOPICS || TELEMETRY_MODE == TELEMETRY_MODE_BOTH
+// One text value per metric topic; NaN means not measured this cycle
+static bool publishMetric(const char* topic, float value, int decimals) {
+    if (isnan(value)) return true;
+    char payload[16];
+    snprintf(payload, sizeof(payload), "%.*f", decimals, value);
+    return mqttPublish(topic, payload, MQTT_QOS_TELEMETRY);
+}
+
+// The due channels of a SensorBank array: 0 on `topic`, i on "<topic>/<i>"
+static bool publishChannels(const char* topic, const float* values, uint8_t channels, uint16_t due, int decimals) {
+    bool ok = true;
+    char channelTopic[96];
+    if (due & 1) ok &= publishMetric(topic, values[0], decimals);
+    for (uint8_t i = 1; i < channels; i++) {
+        if (!((due >> i) & 1)) continue;
+        snprintf(channelTopic, sizeof(channelTopic), "%s/%u", topic, (unsigned)i);
+        ok &= publishMetric(channelTopic, values[i], decimals);
+    }
+    return ok;
+}
+#endif
+
+#if TELEMETRY_MODE == TELEMETRY_MODE_BATCH
+// Every cycle goes into the batch: an unchanged value costs a bit there,
+// so `due` is not applied
+bool publishTelemetry(const SystemStatus& status, const SensorBank& bank, const ReportMask& due) {
+    (void)due;
+    batchAppend(status, bank);
+    flushBatchIfDue();
     return true;
 }
+#else
+static size_t buildFrame(const SystemStatus& status, const SensorBank& bank, uint8_t* payload, size_t size) {
+    TelemetryFrame frame;
+    frame.flags = 0;
+    frame.seq = telemetrySeq++;
+    frame.status = status;
+    frame.bank = bank;
+    if (telemetryClock(&frame.timestamp)) frame.flags |= TELEMETRY_FLAG_UPTIME;
+    return encodeTelemetryFrame(frame, payload, size);
+}
 
-bool publishState(String mode) {
-    if (!client.connected()) return false;
-    return client.publish(getTopic(TOPIC_MODE), mode.c_str());
+// Offline: the frame goes to flash whatever TELEMETRY_MODE is
+bool publishTelemetry(const SystemStatus& status, const SensorBank& bank, const ReportMask& due) {
+    if (reportMaskEmpty(due)) return true;      // Nothing changed enough
+    if (!client.connected()) {
+        #if ENABLE_OFFLINE_QUEUE
+            uint8_t payload[TELEMETRY_FRAME_MAX_SIZE];
+            size_t len = buildFrame(status, bank, payload, sizeof(payload));
+            offlineQueuePush(OFFLINE_TELEMETRY, payload, len);
+        #endif
+        return false;
+    }
+    bool ok = true;
+
+    #if TELEMETRY_MODE != TELEMETRY_MODE_FRAME
+        // Channel 0 is the status
+        ok &= publishChannels(MQTT_TOPIC(TOPIC_TEMP), bank.temp, bank.channels, due.channels[REPORT_TEMP], 1);
+        ok &= publishChannels(MQTT_TOPIC(TOPIC_HUM), bank.humidity, bank.channels, due.channels[REPORT_HUMIDITY], 1);
+        ok &= publishChannels(MQTT_TOPIC(TOPIC_LUX), bank.lux, bank.channels, due.channels[REPORT_LUX], 0);
+        ok &= publishChannels(MQTT_TOPIC(TOPIC_DUST), bank.dust, bank.channels, due.channels[REPORT_DUST], 0);
+        if (due.channels[REPORT_SOILING]) ok &= publishMetric(MQTT_TOPIC(TOPIC_SOILING), status.soiling, 0);
+    #endif
+
+    #if TELEMETRY_MODE != TELEMETRY_MODE_TOPICS
+        uint8_t payload[TELEMETRY_FRAME_MAX_SIZE];
+        size_t len = buildFrame(status, bank, payload, sizeof(payload));
+        ok &= mqttPublish(MQTT_TOPIC(TOPIC_FRAME), payload, len, MQTT_QOS_TELEMETRY);
+    #endif
+
+    return ok;
+}
+#endif
+
+bool publishState(const char* mode) {
+    if (!client.connected()) {
+        #if ENABLE_OFFLINE_QUEUE
+            offlineQueuePush(OFFLINE_STATE, (const uint8_t*)mode, strlen(mode));
+        #endif
+        return false;
+    }
+    return mqttPublish(MQTT_TOPIC(TOPIC_MODE), mode, MQTT_QOS_EVENTS);
+}
+
+// Offline only raised alerts are kept; "false" is the steady state
+bool publishAlert(bool cleanNeeded) {
+    if (!client.connected()) {
+        #if ENABLE_OFFLINE_QUEUE
+            if (cleanNeeded) {
+                uint8_t payload[5] = {1};
+                put32(payload + 1, (uint32_t)time(nullptr));
+                offlineQueuePush(OFFLINE_ALERT, payload, sizeof(payload));
+            }
+        #endif
+        return false;
+    }
+    return mqttPublish(MQTT_TOPIC(TOPIC_ALERT), cleanNeeded ? "true" : "false", MQTT_QOS_EVENTS);
 }
 
-bool publishAlert(bool cleanNeeded, String reason) {
+bool publishStats(const char* topic, const StatsSummary& stats, uint8_t decimals) {
     if (!client.connected()) return false;
-    client.publish(getTopic(TOPIC_ALERT), cleanNeeded ? "true" : "false");
-    return true;
+    int d = decimals;
+    char json[224];
+    snprintf(json, sizeof(json),
+             "{\"n\":%u,\"mean\":%.*f,\"std\":%.*f,\"min\":%.*f,\"max\":%.*f,\"p50\":%.*f,\"p95\":%.*f,\"ema\":%.*f}",
+             (unsigned)stats.count, d, stats.mean, d + 1, stats.std, d, stats.min, d, stats.max, d, stats.p50, d,
+             stats.p95, d, stats.ema);
+    return mqttPublish(topic, json);
+}
+
+bool takeImageRequest() {
+    bool requested = imageRequested;
+    imageRequested = false;
+    return requested;
+}
+
+bool takeKeyframeRequest() {
+    bool requested = keyframeRequested;
+    keyframeRequested = false;
+    return requested;
+}
+
+bool publishFrame(const uint8_t* jpeg, size_t length) {
+    #if ENABLE_IMAGE_DELTA
+        DeltaFrame frame;
+        if (imageDeltaEncode(jpeg, length, &frame)) {
+            if (frame.kind == DELTA_UNCHANGED) {
+                // Stale "nothing changed" is not worth queueing offline
+                if (!client.connected()) return false;
+                char json[160];
+                snprintf(json, sizeof(json),
+                         "{\"status\":\"unchanged\",\"key\":%u,\"hash\":%lu,\"tiles\":%u,\"device\":\"%s\"}",
+                         (unsigned)frame.keyframeId, (unsigned long)frame.contentHash, (unsigned)frame.tiles,
+                         SECRET_MQTT_CLIENT_ID);
+                LOG_INFO("🧩 Frame unchanged since keyframe %u", (unsigned)frame.keyframeId);
+                return mqttPublish(MQTT_TOPIC(TOPIC_CAM_CTRL), json, MQTT_QOS_EVENTS);
+            }
+            if (frame.kind == DELTA_TILES) {
+                LOG_INFO("🧩 %u/%u tiles changed since keyframe %u (%u bytes)", (unsigned)frame.changed,
+                         (unsigned)frame.tiles, (unsigned)frame.keyframeId, (unsigned)frame.payloadLen);
+            } else {
+                LOG_INFO("🧩 Keyframe %u (%u bytes)", (unsigned)frame.keyframeId, (unsigned)frame.payloadLen);
+            }
+            bool ok = publishImage(frame.payload, frame.payloadLen);
+            if (ok) imageDeltaDelivered(frame);
+            return ok;
+        }
+    #endif
+    return publishImage(jpeg, length);
+}
+
+bool publishKeyframe() {
+    size_t length = 0;
+    const uint8_t* keyframe = imageDeltaKeyframe(&length);
+    return keyframe && publishImage(keyframe, length);
 }
 
 bool publishImage(const uint8_t* imageBuffer, size_t length) {
-    if (!client.connected()) return false;
+    if (!client.connected()) {
+        #if ENABLE_OFFLINE_QUEUE
+            queueImage(imageBuffer, length);
+        #endif
+        return false;
+    }
+    return sendImage(imageBuffer, length);
+}
 
-    Serial.printf("📸 Starting Image Upload (%u bytes)...\n", length);
-    Serial.printf("   Chunk Size: %d bytes\n", IMG_CHUNK_SIZE);
-    Serial.printf("   MQTT Buffer Size: %d bytes\n", client.getBufferSize());
-
-    // 1. Send START Metadata (JSON)
-    StaticJsonDocument<200> doc;
-    doc["status"] = "start";
-    doc["size"] = length;
-    doc["device"] = SECRET_MQTT_CLIENT_ID;
-    char jsonBuffer[200];
-    serializeJson(doc, jsonBuffer);
-    if (client.publish(getTopic(TOPIC_CAM_CTRL), jsonBuffer)) {
-        Serial.println("   ✅ Header START sent.");
-    } else {
-        Serial.println("   ❌ Header START fail.");
+// Windowed transfer (see image_transfer.h): blocks until every chunk is
+// ACKed, the connection drops or ACK progress stalls
+static bool sendImage(const uint8_t* imageBuffer, size_t length) {
+    uint32_t count = (length + IMG_CHUNK_SIZE - 1) / IMG_CHUNK_SIZE;
+    if (count == 0 || count > IMG_MAX_CHUNKS) {
+        LOG_ERROR("❌ Image too large (%u bytes)", (unsigned)length);
         return false;
     }
-    client.publish(getTopic(TOPIC_CAM_CTRL), jsonBuffer);
+    uint16_t id = nextImageId++;
+    unsigned long start = millis();
+
+    char json[200];
+    snprintf(json, sizeof(json),
+             "{\"status\":\"start\",\"id\":%u,\"size\":%u,\"chunks\":%u,\"chunk_size\":%d,\"crc\":%lu,"
+             "\"device\":\"%s\"}",
+             (unsigned)id, (unsigned)length, (unsigned)count, IMG_CHUNK_SIZE,
+             (unsigned long)crc32(imageBuffer, length), SECRET_MQTT_CLIENT_ID);
+    if (!mqttPublish(MQTT_TOPIC(TOPIC_CAM_CTRL), json, MQTT_QOS_EVENTS)) {
+        LOG_ERROR("❌ Image %u: START failed", (unsigned)id);
+        return false;
+    }
+    LOG_INFO("📸 Image %u: %u bytes in %u chunks", (unsigned)id, (unsigned)length, (unsigned)count);
+
+    imageSenderStart(imageTx, id, (uint16_t)count);
+    uint16_t lastAcked = 0;
+    unsigned long lastProgress = millis();
+    bool ok = true;
 
-    // 2. Stream Binary Chunks
-    size_t offset = 0;
-    size_t chunkIndex = 0;
-    int errorCount = 0;
+    while (!imageSenderDone(imageTx)) {
+        client.loop();      // ACKs arrive through callback()
+        if (!client.connected()) {
+            ok = false;
+            break;
+        }
+        if (imageTx.acked != lastAcked) {
+            lastAcked = imageTx.acked;
+            lastProgress = millis();
+        } else if (millis() - lastProgress > IMG_TRANSFER_TIMEOUT_MS) {
+            ok = false;
+            break;
+        }
 
-    Serial.print(" Sending [");
-    
-    while (offset < length) {
+        int index = imageSenderNext(imageTx, millis());
+        if (index < 0) {
+            delay(1);       // Window full: wait for ACKs
+            continue;
+        }
+        size_t offset = (size_t)index * IMG_CHUNK_SIZE;
         size_t chunkSize = length - offset;
         if (chunkSize > IMG_CHUNK_SIZE) chunkSize = IMG_CHUNK_SIZE;
 
-        bool sent = client.publish(getTopic(TOPIC_CAM_DATA), &imageBuffer[offset], chunkSize);
-        if (sent) {
-            Serial.print("#"); // # Success
+        ImageChunkHeader h;
+        h.flags = (index < imageTx.nextNew) ? IMG_CHUNK_FLAG_RESEND : 0;
+        h.imageId = id;
+        h.index = (uint16_t)index;
+        h.count = (uint16_t)count;
+        h.crc = crc32(imageBuffer + offset, chunkSize);
+        uint8_t header[IMG_CHUNK_HEADER_SIZE];
+        encodeImageChunkHeader(h, header, sizeof(header));
+        // Chunk data goes to the socket straight from the frame buffer
+        if (publishStreamed(MQTT_TOPIC(TOPIC_CAM_DATA), header, sizeof(header), imageBuffer + offset, chunkSize)) {
+            imageSenderSent(imageTx, (uint16_t)index, millis());
         } else {
-            Serial.print("X"); // X Fail
-            errorCount++;
+            delay(1);       // Outbox still draining queued messages
         }
-        offset += chunkSize;
-        chunkIndex++;
-        
-        delay(20); 
-        client.loop(); 
     }
-    Serial.println("]");
+    imageTx.active = false;
 
-    if (errorCount > 0) {
-        Serial.printf("   ⚠️ ATENTTION: %d failure chunks!\n", errorCount);
-    } else {
-        Serial.printf("   ✅ All %d chunks sended.\n", chunkIndex );
-    }
-
-    // 3. Send END Metadata
-    doc.clear();
-    doc["status"] = "end";
-    doc["chunks"] = chunkIndex;
-    
-    serializeJson(doc, jsonBuffer);
-    client.publish(getTopic(TOPIC_CAM_CTRL), jsonBuffer);
-    if (client.publish(getTopic(TOPIC_CAM_CTRL), jsonBuffer)) {
-        Serial.println("   ✅ Header END sent.");
-    } else {
-        Serial.println("   ❌ Feader END Fail.");
+    unsigned long elapsed = millis() - start;
+    if (!ok) {
+        LOG_WARN("⚠️ Image %u failed: %u/%u chunks ACKed", (unsigned)id, (unsigned)imageTx.acked, (unsigned)count);
+        return false;
     }
 
-    Serial.println("📸 Image Upload Complete.");
-    return (errorCount == 0);
-}
\ No newline at end of file
+    snprintf(json, sizeof(json), "{\"status\":\"end\",\"id\":%u,\"chunks\":%u,\"resent\":%u,\"ms\":%lu}",
+             (unsigned)id, (unsigned)count, (unsigned)imageTx.resent, elapsed);
+    mqttPublish(MQTT_TOPIC(TOPIC_CAM_CTRL), json, MQTT_QOS_EVENTS);
+    LOG_INFO("📸 Image %u delivered in %lu ms (%u resent)", (unsigned)id, elapsed, (unsigned)imageTx.resent);
+    return true;
+}
@@ -3,23 +3,61 @@
 
 #include <WiFi.h>
 #include <WiFiClientSecure.h>
-#include <PubSubClient.h>
-#include <ArduinoJson.h>
 #include "config.h"
+#include "mqtt_client.h"
 #include "core.h" // Para acessar a struct SystemStatus
+#include "report.h"
+#include "stream_stats.h"
 
-void initMQTT();
+// Nothing here blocks: the WiFi join (net_link.h), NTP and the broker lookup
+// run in the background, and loopMQTT() connects once they are done.
+// warmBoot: woken from deep sleep, the RTC kept the time (no NTP sync)
+void initMQTT(bool warmBoot = false);
+// Connects with exponential back-off (MQTT_BACKOFF_MIN_MS..MAX_MS), not on
+// every call
 void loopMQTT();
-bool publishTelemetry(SystemStatus status);
-bool publishState(String mode);
-bool publishAlert(bool cleanNeeded, String reason);
+// Writes what publishes queued since (end of the network step), reads acks
+void flushMQTT();
+// Nothing waiting for the broker: the offline backlog is replayed and the
+// outbox written and acknowledged, or there is no connection to replay it
+// on (it stays in flash). False while the
+// first connection of this boot is still coming up.
+bool mqttIdle();
+// millis() of this boot's first broker connection, 0 until then
+unsigned long mqttConnectedAtMs();
+// Channel 0 on the metric topics, channel i of a multi-sensor bank on
+// "<metric topic>/<i>"; the frame carries every channel. Only the values in
+// `due` (report.h) go out, the frame (or offline record) if any is due.
+// TELEMETRY_MODE_BATCH: every cycle goes into the compressed batch instead.
+bool publishTelemetry(const SystemStatus& status, const SensorBank& bank, const ReportMask& due);
+bool publishState(const char* mode);
+// False if it did not reach the outbox (offline, a raised alert is queued)
+bool publishAlert(bool cleanNeeded);
+// Interval aggregates of one channel as JSON (not queued offline: the
+// replayed frames carry the samples)
+bool publishStats(const char* topic, const StatsSummary& stats, uint8_t decimals);
 
 /**
- * 1. Envia Metadata (Start, Size)
- * 2. Fatia o buffer da câmera em chunks
- * 3. Envia chunks binários
- * 4. Envia Metadata (End)
+ * 1. Envia Metadata (Start: id, size, chunks, CRC)
+ * 2. Envia chunks com cabeçalho (id, índice, CRC) em janela de IMG_WINDOW
+ * 3. Reenvia só os chunks com NACK ou sem ACK (camera/ack)
+ * 4. Envia Metadata (End) quando todos tiverem ACK
+ * Offline: a imagem vai para a fila em flash.
  */
 bool publishImage(const uint8_t* imageBuffer, size_t length);
 
+/**
+ * Frame da câmera pelo codificador delta (image_delta.h): só o hash quando
+ * nada mudou desde o keyframe, senão os tiles alterados ou um novo keyframe.
+ * Sem PSRAM ou com frame inválido, envia o JPEG inteiro (publishImage).
+ */
+bool publishFrame(const uint8_t* jpeg, size_t length);
+
+// Resends the current keyframe (dashboard lost it); false if there is none
+bool publishKeyframe();
+
+// True once per message received on TOPIC_CAM_REQ ("key" is a keyframe request)
+bool takeImageRequest();
+bool takeKeyframeRequest();
+
 #endif
\ No newline at end of file
@@ -0,0 +1,293 @@
+#include "net_link.h"
+#include "checksum.h"
+#include "logger.h"
+#include <esp_netif.h>
+#include <lwip/dhcp.h>
+#include <lwip/dns.h>
+#include <stddef.h>
+
+#define NET_CACHE_MAGIC   0x4E45544CUL   // "NETL"
+#define NET_CACHE_AP      0x01           // Channel, BSSID and lease
+#define NET_CACHE_BROKER  0x02
+#define NET_LEASE_MAX_S   604800UL       // Longer T1s are cut here: ages stay well inside millis()
+#define NET_LEASE_AGE_MS  1000           // Lease age written to the cache this often while up
+
+struct NetCache {
+    uint32_t magic;
+    uint32_t key;               // CRC of SSID and broker name: other secrets, no cache
+    uint8_t flags;
+    uint8_t channel;
+    uint8_t bssid[6];
+    uint32_t ip;
+    uint32_t gateway;
+    uint32_t subnet;
+    uint32_t dns;
+    uint32_t leaseS;            // Renewal time (T1) of the lease
+    uint32_t leaseAgeMs;        // Age of the lease when last written
+    uint32_t broker;
+    uint32_t crc;               // Over everything above
+};
+
+enum JoinPhase : uint8_t { JOIN_FAST, JOIN_FULL, JOIN_UP };
+
+// Kept across resets too (RTC_NOINIT_ATTR, see deep_sleep.h)
+RTC_NOINIT_ATTR static NetCache rtc;
+static NetLinkStats stats;
+static JoinPhase phase = JOIN_FULL;
+static unsigned long joinStartMs = 0;
+
+// Cached lease in use on this boot: the age is sleep-corrected at boot and
+// kept current in the cache while the link is up. A reset adds its own
+// downtime, not counted but short beside T1.
+static bool leaseCached = false;
+static bool leaseStatic = false;    // Joined with it (static IP): no DHCP client renews it
+static unsigned long leaseAtMs = 0;
+static unsigned long leaseSavedMs = 0;
+
+// Broker lookup, answered on the lwIP thread
+static volatile bool lookupPending = false;
+static volatile bool lookupDone = false;
+static volatile uint32_t lookupResult = 0;
+static unsigned long lookupStartMs = 0;
+static uint32_t brokerIp = 0;
+static bool refreshed = false;      // Looked up once on this boot
+
+static uint32_t cacheKey() {
+    uint32_t crc = crc32Update(0, (const uint8_t*)SECRET_SSID, strlen(SECRET_SSID));
+    return crc32Update(crc, (const uint8_t*)SECRET_MQTT_SERVER, strlen(SECRET_MQTT_SERVER));
+}
+
+static uint32_t cacheCrc() {
+    return crc32((const uint8_t*)&rtc, offsetof(NetCache, crc));
+}
+
+static bool cacheHas(uint8_t flag) {
+    #if ENABLE_FAST_CONNECT
+        return rtc.magic == NET_CACHE_MAGIC && rtc.key == cacheKey() && rtc.crc == cacheCrc() &&
+               (rtc.flags & flag);
+    #else
+        (void)flag;
+        return false;
+    #endif
+}
+
+static void cacheSave() {
+    #if ENABLE_FAST_CONNECT
+        rtc.magic = NET_CACHE_MAGIC;
+        rtc.key = cacheKey();
+        rtc.crc = cacheCrc();
+    #endif
+}
+
+// Record to update in place: entries that are still valid are kept
+static void cacheOpen() {
+    if (!cacheHas(NET_CACHE_AP | NET_CACHE_BROKER)) memset(&rtc, 0, sizeof(rtc));
+}
+
+static void cacheDrop(uint8_t flag) {
+    cacheOpen();
+    rtc.flags &= ~flag;
+    cacheSave();
+    if (flag & NET_CACHE_AP) leaseCached = false;
+}
+
+// T1 of the lease the DHCP client holds, WIFI_LEASE_DEFAULT_S if it gave none
+static uint32_t leaseRenewS() {
+    struct netif* nif = (struct netif*)esp_netif_get_netif_impl(esp_netif_get_handle_from_ifkey("WIFI_STA_DEF"));
+    struct dhcp* dhcp = nif ? netif_dhcp_data(nif) : nullptr;
+    uint32_t t1 = dhcp && dhcp->offered_t1_renew ? dhcp->offered_t1_renew : WIFI_LEASE_DEFAULT_S;
+    return t1 < NET_LEASE_MAX_S ? t1 : NET_LEASE_MAX_S;
+}
+
+static bool leaseDue(uint64_t ageMs) { return ageMs >= (uint64_t)rtc.leaseS * 1000; }
+
+static void beginFull() {
+    WiFi.config(IPAddress(), IPAddress(), IPAddress());    // DHCP
+    WiFi.begin(SECRET_SSID, SECRET_WIFI_PASSWORD);
+    phase = JOIN_FULL;
+    joinStartMs = millis();
+    leaseStatic = false;
+}
+
+// Link up: keeps the cached lease's age current. Past T1 a lease the DHCP
+// client holds has been renewed; one joined with as a static IP is not, and
+// is given up for a DHCP join.
+static bool leaseCheck(unsigned long now) {
+    if (!leaseCached || now - leaseSavedMs < NET_LEASE_AGE_MS) return true;
+    leaseSavedMs = now;
+    if (leaseDue(now - leaseAtMs)) {
+        if (leaseStatic) {
+            LOG_WARN("📶 Cached lease due for renewal: DHCP join");
+            stats.leaseExpired++;
+            cacheDrop(NET_CACHE_AP);
+            WiFi.disconnect();
+            beginFull();
+            return false;
+        }
+        leaseAtMs = now;
+    }
+    cacheOpen();
+    rtc.leaseAgeMs = now - leaseAtMs;
+    cacheSave();
+    return true;
+}
+
+void netLinkBegin(uint32_t sleptMs) {
+    memset(&stats, 0, sizeof(stats));
+    lookupPending = false;
+    lookupDone = false;
+    refreshed = false;
+    leaseCached = false;
+    brokerIp = cacheHas(NET_CACHE_BROKER) ? rtc.broker : 0;
+    stats.cachedBroker = brokerIp != 0;
+
+    WiFi.persistent(false);     // No flash write per join
+    WiFi.mode(WIFI_STA);
+    if (cacheHas(NET_CACHE_AP) && leaseDue((uint64_t)rtc.leaseAgeMs + sleptMs)) {
+        LOG_INFO("📶 Cached lease due for renewal: DHCP");
+        stats.leaseExpired++;
+        cacheDrop(NET_CACHE_AP);
+    }
+    if (cacheHas(NET_CACHE_AP)) {
+        LOG_INFO("📶 WiFi: %s (cached, channel %u)", SECRET_SSID, (unsigned)rtc.channel);
+        WiFi.config(IPAddress(rtc.ip), IPAddress(rtc.gateway), IPAddress(rtc.subnet), IPAddress(rtc.dns));
+        WiFi.begin(SECRET_SSID, SECRET_WIFI_PASSWORD, rtc.channel, rtc.bssid);
+        phase = JOIN_FAST;
+        joinStartMs = millis();
+        leaseCached = true;
+        leaseStatic = true;
+        leaseAtMs = joinStartMs - (rtc.leaseAgeMs + sleptMs);     // Wraps like millis()
+        leaseSavedMs = joinStartMs;
+    } else {
+        LOG_INFO("📶 WiFi: %s", SECRET_SSID);
+        beginFull();
+    }
+}
+
+bool netLinkUp() {
+    unsigned long now = millis();
+    if (WiFi.status() == WL_CONNECTED) {
+        if (phase != JOIN_UP) {
+            stats.joinMs = now - joinStartMs;
+            stats.joins++;
+            if (phase == JOIN_FAST) stats.fastJoins++;
+            LOG_INFO("📶 WiFi up in %lu ms (%s)", (unsigned long)stats.joinMs,
+                     phase == JOIN_FAST ? "cached" : "scan + DHCP");
+            if (phase == JOIN_FULL && !leaseStatic) {
+                cacheOpen();
+                rtc.flags |= NET_CACHE_AP;
+                rtc.channel = (uint8_t)WiFi.channel();
+                memcpy(rtc.bssid, WiFi.BSSID(), sizeof(rtc.bssid));
+                rtc.ip = WiFi.localIP();
+                rtc.gateway = WiFi.gatewayIP();
+                rtc.subnet = WiFi.subnetMask();
+                rtc.dns = WiFi.dnsIP();
+                rtc.leaseS = leaseRenewS();
+                rtc.leaseAgeMs = 0;
+                cacheSave();
+                leaseCached = true;
+                leaseAtMs = now;
+                leaseSavedMs = now;
+            }
+            phase = JOIN_UP;
+        }
+        return leaseCheck(now);
+    }
+
+    if (phase == JOIN_UP) {
+        // Lost: the driver reconnects by itself; time that as a new join
+        LOG_WARN("📶 WiFi lost");
+        phase = JOIN_FULL;
+        joinStartMs = now;
+    } else if (phase == JOIN_FAST && now - joinStartMs > WIFI_FAST_TIMEOUT_MS) {
+        LOG_WARN("📶 Cached AP/lease not up in %u ms: full join", (unsigned)WIFI_FAST_TIMEOUT_MS);
+        stats.fastFailed++;
+        cacheDrop(NET_CACHE_AP);
+        WiFi.disconnect();
+        beginFull();
+    } else if (phase == JOIN_FULL && now - joinStartMs > WIFI_JOIN_TIMEOUT_MS) {
+        LOG_WARN("📶 WiFi join timed out: retrying");
+        stats.joinTimeouts++;
+        WiFi.disconnect();
+        beginFull();
+    }
+    return false;
+}
+
+bool netLinkJoining() {
+    return phase != JOIN_UP && stats.joinTimeouts == 0;
+}
+
+static void lookupFound(const char* name, const ip_addr_t* ipaddr, void* arg) {
+    (void)name;
+    (void)arg;
+    lookupResult = ipaddr ? ip4_addr_get_u32(ip_2_ip4(ipaddr)) : 0;
+    lookupDone = true;
+}
+
+static void startLookup() {
+    ip_addr_t addr;
+    lookupStartMs = millis();
+    lookupDone = false;
+    lookupPending = true;
+    err_t err = dns_gethostbyname(SECRET_MQTT_SERVER, &addr, lookupFound, nullptr);
+    if (err == ERR_OK) {
+        lookupFound(SECRET_MQTT_SERVER, &addr, nullptr);
+    } else if (err != ERR_INPROGRESS) {
+        lookupFound(SECRET_MQTT_SERVER, nullptr, nullptr);
+    }
+}
+
+// Takes a finished lookup; the result replaces the cached address
+static void finishLookup() {
+    if (!lookupPending || !lookupDone) return;
+    lookupPending = false;
+    stats.dnsMs = millis() - lookupStartMs;
+    if (!lookupResult) {
+        LOG_WARN("🔍 DNS lookup of %s failed", SECRET_MQTT_SERVER);
+        return;
+    }
+    if (lookupResult != brokerIp) {
+        brokerIp = lookupResult;
+        cacheOpen();
+        rtc.flags |= NET_CACHE_BROKER;
+        rtc.broker = brokerIp;
+        cacheSave();
+        IPAddress ip(brokerIp);
+        LOG_INFO("🔍 Broker at %u.%u.%u.%u", ip[0], ip[1], ip[2], ip[3]);
+    }
+}
+
+NetLookup netBrokerAddress(IPAddress* ip) {
+    finishLookup();
+    // Cached: connect now, and check it in the background once per boot
+    if (brokerIp) {
+        if (!refreshed && !lookupPending) {
+            refreshed = true;
+            startLookup();
+        }
+        *ip = IPAddress(brokerIp);
+        return NET_LOOKUP_DONE;
+    }
+    if (lookupPending) return NET_LOOKUP_PENDING;
+    if (refreshed) {
+        refreshed = false;      // Failed: a new lookup on the next call
+        return NET_LOOKUP_FAILED;
+    }
+    refreshed = true;
+    startLookup();
+    finishLookup();             // Answered from the lwIP cache
+    if (brokerIp) {
+        *ip = IPAddress(brokerIp);
+        return NET_LOOKUP_DONE;
+    }
+    return lookupPending ? NET_LOOKUP_PENDING : NET_LOOKUP_FAILED;
+}
+
+void netBrokerFailed() {
+    brokerIp = 0;
+    refreshed = false;
+    cacheDrop(NET_CACHE_BROKER);
+}
+
+NetLinkStats netLinkStats() { return stats; }
@@ -0,0 +1,53 @@
+#ifndef NET_LINK_H
+#define NET_LINK_H
+
+#include <WiFi.h>
+#include "config.h"
+
+// WiFi join and broker address, for the network side (mqtt_driver.cpp).
+// Nothing here blocks: the WiFi driver joins in the background and lwIP
+// resolves the broker name asynchronously; callers poll.
+//
+// ENABLE_FAST_CONNECT: what a join learns (the AP's channel and BSSID, the
+// DHCP lease, the broker's address) is kept in RTC memory with a CRC, keyed
+// to SECRET_SSID and SECRET_MQTT_SERVER. The next boot, after a reset or a
+// deep sleep, joins on one channel with a static IP and connects without
+// DNS. A cached AP or lease that is not up within WIFI_FAST_TIMEOUT_MS is
+// dropped for a full scan + DHCP join, and so is a lease past its renewal
+// time (T1, counted across sleeps); a cached broker address that fails a
+// connect is looked up again.
+
+enum NetLookup : uint8_t {
+    NET_LOOKUP_PENDING,         // Lookup in progress (or the link is down)
+    NET_LOOKUP_DONE,
+    NET_LOOKUP_FAILED           // The next call starts a new one
+};
+
+struct NetLinkStats {
+    uint32_t joinMs;            // WiFi.begin() to connected, last join
+    uint32_t dnsMs;             // Last broker lookup (0: none finished)
+    uint32_t joins;
+    uint32_t fastJoins;         // With the cached AP and lease
+    uint32_t fastFailed;        // Cache dropped for a full join
+    uint32_t joinTimeouts;      // Full joins started over
+    uint32_t leaseExpired;      // Cached lease past T1: DHCP join
+    bool cachedBroker;          // The broker address came from the cache this boot
+};
+
+// Starts the join; setup(), as early as possible. `sleptMs`: length of the
+// deep sleep this boot woke from, 0 otherwise (ages the cached lease).
+void netLinkBegin(uint32_t sleptMs);
+// Polled by loopMQTT(): true while joined with an IP. Falls back from the
+// cache, restarts a join that timed out, and caches what a join learnt.
+bool netLinkUp();
+// First join of this boot still in progress (none timed out yet)
+bool netLinkJoining();
+
+// The broker's address, cached or resolved
+NetLookup netBrokerAddress(IPAddress* ip);
+// A connect to that address failed: resolve again before the next one
+void netBrokerFailed();
+
+NetLinkStats netLinkStats();
+
+#endif
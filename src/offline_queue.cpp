@@ -0,0 +1,313 @@
+#include "offline_queue.h"
+#include "checksum.h"
+#include "logger.h"
+#include <esp_partition.h>
+
+#define SECTOR_SIZE      4096
+#define SECTOR_MAGIC     0x31535141UL   // "AQS1"
+#define SECTOR_HDR_SIZE  8
+#define RECORD_HDR_SIZE  12
+
+// Record state byte, each step clears bits
+#define REC_BLANK        0xFF
+#define REC_VALID        0x7F
+#define REC_CONSUMED     0x3F
+
+struct RecordHeader {
+    uint8_t state;
+    uint8_t kind;
+    uint16_t len;
+    uint32_t seq;
+    uint32_t crc;
+};
+
+static const esp_partition_t* partition = nullptr;
+static uint16_t sectorCount = 0;
+
+static uint16_t readSector = 0;     // Oldest sector that may hold pending records
+static uint16_t readOffset = SECTOR_HDR_SIZE;
+static uint16_t writeSector = 0;
+static uint16_t writeOffset = SECTOR_HDR_SIZE;
+static uint32_t sectorSeq = 0;      // Sequence of the write sector
+static uint32_t recordSeq = 0;      // Next record sequence
+
+static OfflineQueueStats stats;
+static unsigned long replayStartMs = 0;
+static uint32_t replayCount = 0;
+
+static inline uint16_t align4(uint32_t n) { return (uint16_t)((n + 3) & ~3UL); }
+static inline uint16_t nextSector(uint16_t s) { return (uint16_t)((s + 1) % sectorCount); }
+static inline size_t sectorAddr(uint16_t s) { return (size_t)s * SECTOR_SIZE; }
+
+static bool readHeader(uint16_t s, uint16_t off, RecordHeader* h) {
+    uint8_t raw[RECORD_HDR_SIZE];
+    if (esp_partition_read(partition, sectorAddr(s) + off, raw, sizeof(raw)) != ESP_OK) return false;
+    h->state = raw[0];
+    h->kind = raw[1];
+    h->len = (uint16_t)(raw[2] | (raw[3] << 8));
+    h->seq = (uint32_t)raw[4] | ((uint32_t)raw[5] << 8) | ((uint32_t)raw[6] << 16) | ((uint32_t)raw[7] << 24);
+    h->crc = (uint32_t)raw[8] | ((uint32_t)raw[9] << 8) | ((uint32_t)raw[10] << 16) | ((uint32_t)raw[11] << 24);
+    return true;
+}
+
+static bool isBlank(const RecordHeader& h) {
+    return h.state == REC_BLANK && h.kind == 0xFF && h.len == 0xFFFF && h.seq == 0xFFFFFFFFUL &&
+           h.crc == 0xFFFFFFFFUL;
+}
+
+// A header that can be walked past (the length is trustworthy)
+static bool isWalkable(const RecordHeader& h, uint16_t off) {
+    return (h.state == REC_VALID || h.state == REC_CONSUMED) &&
+           off + align4(RECORD_HDR_SIZE + h.len) <= SECTOR_SIZE;
+}
+
+static uint32_t recordCrc(const RecordHeader& h, const uint8_t* payload) {
+    uint8_t meta[7] = {h.kind, (uint8_t)h.len, (uint8_t)(h.len >> 8), (uint8_t)h.seq, (uint8_t)(h.seq >> 8),
+                       (uint8_t)(h.seq >> 16), (uint8_t)(h.seq >> 24)};
+    return crc32Update(crc32(meta, sizeof(meta)), payload, h.len);
+}
+
+static bool readSectorSeq(uint16_t s, uint32_t* seq) {
+    uint32_t hdr[2];
+    if (esp_partition_read(partition, sectorAddr(s), hdr, sizeof(hdr)) != ESP_OK) return false;
+    if (hdr[0] != SECTOR_MAGIC) return false;
+    *seq = hdr[1];
+    return true;
+}
+
+// Walks the records of one sector. Returns the offset where appending can
+// continue (SECTOR_SIZE if the sector is closed by a torn record).
+static uint16_t scanSector(uint16_t s, uint32_t* pending, uint32_t* pendingBytes) {
+    uint16_t off = SECTOR_HDR_SIZE;
+    while (off + RECORD_HDR_SIZE <= SECTOR_SIZE) {
+        RecordHeader h;
+        if (!readHeader(s, off, &h) || isBlank(h)) return off;
+        if (!isWalkable(h, off)) {
+            stats.corrupt++;
+            return SECTOR_SIZE;
+        }
+        uint16_t size = align4(RECORD_HDR_SIZE + h.len);
+        if (h.state == REC_VALID) {
+            if (pending) (*pending)++;
+            if (pendingBytes) *pendingBytes += size;
+        }
+        if (h.seq + 1 > recordSeq) recordSeq = h.seq + 1;
+        off += size;
+    }
+    return off;
+}
+
+static bool openSector(uint16_t s) {
+    uint32_t first = 0;
+    esp_partition_read(partition, sectorAddr(s), &first, sizeof(first));
+    if (first != 0xFFFFFFFFUL) {
+        if (esp_partition_erase_range(partition, sectorAddr(s), SECTOR_SIZE) != ESP_OK) return false;
+    }
+    uint32_t hdr[2] = {SECTOR_MAGIC, sectorSeq + 1};
+    if (esp_partition_write(partition, sectorAddr(s), hdr, sizeof(hdr)) != ESP_OK) return false;
+    sectorSeq++;
+    writeSector = s;
+    writeOffset = SECTOR_HDR_SIZE;
+    return true;
+}
+
+// Moves the write head to the next sector, dropping the oldest one if the
+// ring is full
+static bool advanceWriteSector() {
+    uint16_t next = nextSector(writeSector);
+    if (next == readSector) {
+        uint32_t lost = 0;
+        uint32_t lostBytes = 0;
+        scanSector(next, &lost, &lostBytes);
+        stats.dropped += lost;
+        stats.depth -= lost;
+        stats.depthBytes -= lostBytes;
+        readSector = nextSector(next);
+        readOffset = SECTOR_HDR_SIZE;
+        if (lost) LOG_WARN("💾 Offline queue full, dropped %u oldest records", lost);
+    }
+    return openSector(next);
+}
+
+bool initOfflineQueue() {
+    partition = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, OFFLINE_PARTITION_LABEL);
+    if (!partition) {
+        LOG_ERROR("❌ Offline queue: partition '%s' not found", OFFLINE_PARTITION_LABEL);
+        return false;
+    }
+    sectorCount = (uint16_t)(partition->size / SECTOR_SIZE);
+    if (sectorCount < 2) {
+        partition = nullptr;
+        return false;
+    }
+
+    uint32_t captured = stats.captured;
+    uint32_t replayed = stats.replayed;
+    memset(&stats, 0, sizeof(stats));
+    stats.captured = captured;
+    stats.replayed = replayed;
+    stats.capacityBytes = (uint32_t)(sectorCount - 1) * (SECTOR_SIZE - SECTOR_HDR_SIZE);
+    recordSeq = 0;
+    replayCount = 0;
+
+    // Oldest and newest formatted sectors
+    bool found = false;
+    uint32_t minSeq = 0;
+    uint32_t maxSeq = 0;
+    for (uint16_t s = 0; s < sectorCount; s++) {
+        uint32_t seq;
+        if (!readSectorSeq(s, &seq)) continue;
+        if (!found || seq < minSeq) { minSeq = seq; readSector = s; }
+        if (!found || seq > maxSeq) { maxSeq = seq; writeSector = s; }
+        found = true;
+    }
+
+    if (!found) {
+        sectorSeq = 0;
+        readSector = 0;
+        readOffset = SECTOR_HDR_SIZE;
+        bool ok = openSector(0);
+        LOG_INFO("💾 Offline queue formatted (%u KB)", (unsigned)(stats.capacityBytes / 1024));
+        return ok;
+    }
+
+    sectorSeq = maxSeq;
+    readOffset = SECTOR_HDR_SIZE;
+    for (uint16_t s = readSector;; s = nextSector(s)) {
+        uint32_t seq;
+        if (readSectorSeq(s, &seq)) {
+            uint16_t end = scanSector(s, &stats.depth, &stats.depthBytes);
+            if (s == writeSector) writeOffset = end;
+        }
+        if (s == writeSector) break;
+    }
+
+    LOG_INFO("💾 Offline queue: %u records pending (%u/%u KB)", stats.depth,
+             (unsigned)(stats.depthBytes / 1024), (unsigned)(stats.capacityBytes / 1024));
+    return true;
+}
+
+size_t offlineQueueMaxPayload() { return SECTOR_SIZE - SECTOR_HDR_SIZE - RECORD_HDR_SIZE; }
+
+bool offlineQueuePush(uint8_t kind, const uint8_t* data, size_t len) {
+    if (!partition || len > offlineQueueMaxPayload()) return false;
+    uint16_t size = align4(RECORD_HDR_SIZE + len);
+    if (writeOffset + size > SECTOR_SIZE) {
+        if (!advanceWriteSector()) return false;
+    }
+
+    RecordHeader h;
+    h.state = REC_BLANK;
+    h.kind = kind;
+    h.len = (uint16_t)len;
+    h.seq = recordSeq;
+    h.crc = recordCrc(h, data);
+    uint8_t raw[RECORD_HDR_SIZE] = {
+        REC_BLANK, h.kind, (uint8_t)h.len, (uint8_t)(h.len >> 8),
+        (uint8_t)h.seq, (uint8_t)(h.seq >> 8), (uint8_t)(h.seq >> 16), (uint8_t)(h.seq >> 24),
+        (uint8_t)h.crc, (uint8_t)(h.crc >> 8), (uint8_t)(h.crc >> 16), (uint8_t)(h.crc >> 24)
+    };
+
+    // Body first, then commit the state byte
+    size_t addr = sectorAddr(writeSector) + writeOffset;
+    uint8_t committed = REC_VALID;
+    bool ok = esp_partition_write(partition, addr + 1, raw + 1, RECORD_HDR_SIZE - 1) == ESP_OK &&
+              (len == 0 || esp_partition_write(partition, addr + RECORD_HDR_SIZE, data, len) == ESP_OK) &&
+              esp_partition_write(partition, addr, &committed, 1) == ESP_OK;
+    if (!ok) {
+        writeOffset = SECTOR_SIZE;      // Never append after a failed write
+        return false;
+    }
+
+    writeOffset += size;
+    recordSeq++;
+    stats.depth++;
+    stats.depthBytes += size;
+    stats.captured++;
+    return true;
+}
+
+bool offlineQueueEmpty() { return stats.depth == 0; }
+
+void offlineQueueBegin(OfflineCursor* cursor) {
+    cursor->sector = readSector;
+    cursor->offset = readOffset;
+}
+
+bool offlineQueueRead(OfflineCursor* cursor, OfflineRecord* rec, uint8_t* buf, size_t size) {
+    if (!partition || stats.depth == 0) return false;
+    for (;;) {
+        bool atWriteSector = cursor->sector == writeSector;
+        if (atWriteSector && cursor->offset >= writeOffset) return false;
+
+        RecordHeader h;
+        bool more = cursor->offset + RECORD_HDR_SIZE <= SECTOR_SIZE &&
+                    readHeader(cursor->sector, cursor->offset, &h) && isWalkable(h, cursor->offset);
+        if (!more) {
+            if (atWriteSector) return false;
+            cursor->sector = nextSector(cursor->sector);
+            cursor->offset = SECTOR_HDR_SIZE;
+            continue;
+        }
+
+        uint16_t off = cursor->offset;
+        cursor->offset += align4(RECORD_HDR_SIZE + h.len);
+        if (h.state != REC_VALID) continue;
+        if (h.len > size) {
+            stats.corrupt++;
+            continue;
+        }
+        esp_partition_read(partition, sectorAddr(cursor->sector) + off + RECORD_HDR_SIZE, buf, h.len);
+        if (recordCrc(h, buf) != h.crc) {
+            stats.corrupt++;
+            continue;
+        }
+        rec->kind = h.kind;
+        rec->len = h.len;
+        rec->seq = h.seq;
+        return true;
+    }
+}
+
+// Marks valid records in [from, to) of one sector consumed
+static void consumeRange(uint16_t s, uint16_t from, uint16_t to) {
+    uint8_t consumed = REC_CONSUMED;
+    uint16_t off = from;
+    while (off < to && off + RECORD_HDR_SIZE <= SECTOR_SIZE) {
+        RecordHeader h;
+        if (!readHeader(s, off, &h) || !isWalkable(h, off)) break;
+        uint16_t size = align4(RECORD_HDR_SIZE + h.len);
+        if (h.state == REC_VALID) {
+            esp_partition_write(partition, sectorAddr(s) + off, &consumed, 1);
+            if (stats.depth) stats.depth--;
+            stats.depthBytes = (stats.depthBytes > size) ? stats.depthBytes - size : 0;
+            stats.replayed++;
+            replayCount++;
+        }
+        off += size;
+    }
+}
+
+void offlineQueueConsume(const OfflineCursor& upTo) {
+    if (!partition) return;
+    if (replayCount == 0) replayStartMs = millis();
+
+    while (readSector != upTo.sector) {
+        // Fully consumed sectors are erased when the write head reaches them,
+        // keeping the 45 ms erase out of the replay budget
+        consumeRange(readSector, readOffset, SECTOR_SIZE);
+        readSector = nextSector(readSector);
+        readOffset = SECTOR_HDR_SIZE;
+    }
+    consumeRange(readSector, readOffset, upTo.offset);
+    readOffset = upTo.offset;
+
+    if (stats.depth == 0 && replayCount > 0) {
+        stats.lastReplayCount = replayCount;
+        stats.lastReplayMs = millis() - replayStartMs;
+        stats.lastReplayRate = replayCount * 1000.0f / (stats.lastReplayMs ? stats.lastReplayMs : 1);
+        replayCount = 0;
+    }
+}
+
+OfflineQueueStats offlineQueueStats() { return stats; }
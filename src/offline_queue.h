@@ -0,0 +1,72 @@
+#ifndef OFFLINE_QUEUE_H
+#define OFFLINE_QUEUE_H
+
+#include <Arduino.h>
+#include "config.h"
+
+// Store-and-forward queue for messages produced while the broker is
+// unreachable. Log-structured ring over the OFFLINE_PARTITION_LABEL flash
+// partition, safe against power loss at any point:
+//
+//   sector (4 KB):  [magic u32][sector seq u32] record record ... (0xFF tail)
+//   record:         [state u8][kind u8][len u16][seq u32][crc32 u32] payload, 4-byte aligned
+//
+// Records are appended with state 0xFF and committed by programming the
+// state byte (NOR flash can only clear bits), so a torn write is never seen
+// as valid. Replayed records are marked consumed in place; sectors are only
+// erased when the write head wraps around to them. When the ring is full the
+// oldest sector is reused and its pending records count as dropped.
+
+enum OfflineRecordKind : uint8_t {
+    OFFLINE_TELEMETRY = 1,  // Packed TelemetryFrame
+    OFFLINE_ALERT,          // [clean needed u8][timestamp u32]
+    OFFLINE_STATE,          // Mode string (no terminator)
+    OFFLINE_IMAGE_HEAD,     // [image id u16][chunk count u16][length u32]
+    OFFLINE_IMAGE_DATA,     // [image id u16][chunk index u16] data
+    OFFLINE_BATCH           // Compressed samples (series_codec.h)
+};
+
+struct OfflineRecord {
+    uint8_t kind;
+    uint16_t len;
+    uint32_t seq;
+};
+
+// Position in the queue for reading ahead of the consumed point
+struct OfflineCursor {
+    uint16_t sector;
+    uint16_t offset;
+};
+
+struct OfflineQueueStats {
+    uint32_t depth;             // Records waiting for replay
+    uint32_t depthBytes;        // Flash used by those records
+    uint32_t capacityBytes;
+    uint32_t captured;          // Since boot
+    uint32_t replayed;          // Since boot
+    uint32_t dropped;           // Overwritten before replay (queue full)
+    uint32_t corrupt;           // Torn or bad-CRC records skipped
+    uint32_t lastReplayCount;   // Last completed catch-up
+    uint32_t lastReplayMs;
+    float lastReplayRate;       // Records/s over the last catch-up
+};
+
+// Mounts the partition and rebuilds the queue state from flash. Safe to call
+// again (e.g. after a simulated reboot).
+bool initOfflineQueue();
+
+// Appends one record. False if not mounted, too large or the write failed.
+bool offlineQueuePush(uint8_t kind, const uint8_t* data, size_t len);
+size_t offlineQueueMaxPayload();
+
+bool offlineQueueEmpty();
+
+// Reading: start at the oldest pending record, read forward, then consume
+// everything before the cursor once it has been delivered.
+void offlineQueueBegin(OfflineCursor* cursor);
+bool offlineQueueRead(OfflineCursor* cursor, OfflineRecord* rec, uint8_t* buf, size_t size);
+void offlineQueueConsume(const OfflineCursor& upTo);
+
+OfflineQueueStats offlineQueueStats();
+
+#endif
@@ -0,0 +1,160 @@
+#include "perf_metrics.h"
+
+#if ENABLE_PERF_METRICS
+#include <atomic>
+#include <stdarg.h>
+#include <string.h>
+
+// Cumulative since perfReset(); the reader diffs against its last report.
+// Single writer per stage: plain relaxed load + store, no read-modify-write.
+struct PerfHistogram {
+    std::atomic<uint32_t> buckets[PERF_BUCKETS];
+    std::atomic<uint32_t> sumUs;        // Wraps; an interval's difference does not
+    std::atomic<uint32_t> maxUs;        // Since the last report (the reader zeroes it)
+};
+
+static PerfHistogram histograms[PERF_STAGES];
+static std::atomic<uint32_t> counters[PERF_COUNTERS];
+
+// Reader side (network task)
+static uint32_t lastBuckets[PERF_STAGES][PERF_BUCKETS];
+static uint32_t lastSumUs[PERF_STAGES];
+static uint32_t lastCounters[PERF_COUNTERS];
+static unsigned long intervalStartMs = 0;
+static bool started = false;
+
+static const char* const STAGE_NAMES[PERF_STAGES] = {
+    "loop", "light", "sensors", "decision", "camera", "soiling", "camera_on", "telemetry", "image", "mqtt", "reconnect"
+};
+
+static inline uint8_t bucketOf(uint32_t us) {
+    uint8_t b = us ? (uint8_t)(32 - __builtin_clz(us)) : 0;
+    return b < PERF_BUCKETS ? b : PERF_BUCKETS - 1;
+}
+
+void perfRecord(PerfStage stage, uint32_t us) {
+    PerfHistogram& h = histograms[stage];
+    std::atomic<uint32_t>& bucket = h.buckets[bucketOf(us)];
+    bucket.store(bucket.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    h.sumUs.store(h.sumUs.load(std::memory_order_relaxed) + us, std::memory_order_relaxed);
+    if (us > h.maxUs.load(std::memory_order_relaxed)) h.maxUs.store(us, std::memory_order_relaxed);
+}
+
+void perfCount(PerfCounter counter) { counters[counter].fetch_add(1, std::memory_order_relaxed); }
+
+const char* perfStageName(PerfStage stage) { return stage < PERF_STAGES ? STAGE_NAMES[stage] : "?"; }
+
+void perfReset() {
+    for (uint8_t s = 0; s < PERF_STAGES; s++) {
+        for (uint8_t b = 0; b < PERF_BUCKETS; b++) histograms[s].buckets[b].store(0);
+        histograms[s].sumUs.store(0);
+        histograms[s].maxUs.store(0);
+    }
+    for (uint8_t c = 0; c < PERF_COUNTERS; c++) counters[c].store(0);
+    memset(lastBuckets, 0, sizeof(lastBuckets));
+    memset(lastSumUs, 0, sizeof(lastSumUs));
+    memset(lastCounters, 0, sizeof(lastCounters));
+    intervalStartMs = millis();
+    started = true;
+}
+
+// Upper bound of the bucket holding the p-th percentile, at most the max
+static uint32_t bucketPercentile(const uint32_t* buckets, uint32_t count, uint32_t percent, uint32_t maxUs) {
+    uint32_t rank = (uint32_t)(((uint64_t)count * percent + 99) / 100);
+    uint32_t seen = 0;
+    for (uint8_t b = 0; b < PERF_BUCKETS; b++) {
+        seen += buckets[b];
+        if (seen >= rank) {
+            uint32_t upper = b == PERF_BUCKETS - 1 ? maxUs : (1u << b);
+            return upper < maxUs ? upper : maxUs;
+        }
+    }
+    return maxUs;
+}
+
+bool perfReportDue(PerfReport* report) {
+    if (!started) perfReset();
+    unsigned long now = millis();
+    if (now - intervalStartMs < PERF_REPORT_MS) return false;
+    report->intervalMs = (uint32_t)(now - intervalStartMs);
+    intervalStartMs = now;
+
+    for (uint8_t s = 0; s < PERF_STAGES; s++) {
+        PerfHistogram& h = histograms[s];
+        PerfStageSummary& out = report->stage[s];
+        // Max first: a sample landing in between is counted now or next time,
+        // its max at worst in the next interval
+        out.maxUs = h.maxUs.exchange(0, std::memory_order_relaxed);
+        out.count = 0;
+        for (uint8_t b = 0; b < PERF_BUCKETS; b++) {
+            uint32_t total = h.buckets[b].load(std::memory_order_relaxed);
+            out.buckets[b] = total - lastBuckets[s][b];
+            lastBuckets[s][b] = total;
+            out.count += out.buckets[b];
+        }
+        uint32_t sum = h.sumUs.load(std::memory_order_relaxed);
+        out.avgUs = out.count ? (sum - lastSumUs[s]) / out.count : 0;
+        lastSumUs[s] = sum;
+        out.p50Us = out.count ? bucketPercentile(out.buckets, out.count, 50, out.maxUs) : 0;
+        out.p95Us = out.count ? bucketPercentile(out.buckets, out.count, 95, out.maxUs) : 0;
+    }
+    for (uint8_t c = 0; c < PERF_COUNTERS; c++) {
+        uint32_t total = counters[c].load(std::memory_order_relaxed);
+        report->counters[c] = total - lastCounters[c];
+        lastCounters[c] = total;
+    }
+    report->heapFree = ESP.getFreeHeap();
+    report->heapMin = ESP.getMinFreeHeap();
+    report->psramFree = psramFound() ? ESP.getFreePsram() : 0;
+    report->psramMin = psramFound() ? ESP.getMinFreePsram() : 0;
+    return true;
+}
+
+// Appends to out[*len]; false once it no longer fits
+static bool append(char* out, size_t size, size_t* len, const char* fmt, ...) __attribute__((format(printf, 4, 5)));
+static bool append(char* out, size_t size, size_t* len, const char* fmt, ...) {
+    if (*len >= size) return false;
+    va_list args;
+    va_start(args, fmt);
+    int n = vsnprintf(out + *len, size - *len, fmt, args);
+    va_end(args);
+    if (n < 0 || (size_t)n >= size - *len) {
+        *len = size;
+        return false;
+    }
+    *len += n;
+    return true;
+}
+
+// {"ms":..,"heap":[free,min],"psram":[free,min],"pub_fail":..,"conn":..,"conn_fail":..,
+//  "st":{"<stage>":[n,avg,p50,p95,max,first bucket,counts...],...}}
+// Stages without samples are left out; the counts run from the first to the
+// last non-empty bucket.
+size_t perfReportJson(const PerfReport& report, char* out, size_t size) {
+    size_t len = 0;
+    bool ok = append(out, size, &len,
+                     "{\"ms\":%lu,\"heap\":[%lu,%lu],\"psram\":[%lu,%lu],\"pub_fail\":%lu,\"conn\":%lu,"
+                     "\"conn_fail\":%lu,\"st\":{",
+                     (unsigned long)report.intervalMs, (unsigned long)report.heapFree, (unsigned long)report.heapMin,
+                     (unsigned long)report.psramFree, (unsigned long)report.psramMin,
+                     (unsigned long)report.counters[PERF_PUBLISH_FAILED], (unsigned long)report.counters[PERF_CONNECTS],
+                     (unsigned long)report.counters[PERF_CONNECT_FAILED]);
+    bool first = true;
+    for (uint8_t s = 0; ok && s < PERF_STAGES; s++) {
+        const PerfStageSummary& st = report.stage[s];
+        if (!st.count) continue;
+        uint8_t lo = 0, hi = PERF_BUCKETS - 1;
+        while (!st.buckets[lo]) lo++;
+        while (!st.buckets[hi]) hi--;
+        ok = append(out, size, &len, "%s\"%s\":[%lu,%lu,%lu,%lu,%lu,%u", first ? "" : ",", STAGE_NAMES[s],
+                    (unsigned long)st.count, (unsigned long)st.avgUs, (unsigned long)st.p50Us,
+                    (unsigned long)st.p95Us, (unsigned long)st.maxUs, (unsigned)lo);
+        for (uint8_t b = lo; ok && b <= hi; b++) ok = append(out, size, &len, ",%lu", (unsigned long)st.buckets[b]);
+        ok = ok && append(out, size, &len, "]");
+        first = false;
+    }
+    ok = ok && append(out, size, &len, "}}");
+    return ok ? len : 0;
+}
+
+#endif
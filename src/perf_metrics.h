@@ -0,0 +1,101 @@
+#ifndef PERF_METRICS_H
+#define PERF_METRICS_H
+
+#include <Arduino.h>
+#include "config.h"
+
+// Always-on timing of the loop() stages and the network side. A probe is two
+// micros() reads and a few stores into a log2 histogram: no lock, no
+// allocation. Each stage is timed by one task only (acquisition or network),
+// so its counts have a single writer; the network side reads them when it
+// publishes (TOPIC_METRICS, every PERF_REPORT_MS).
+//
+// ENABLE_PERF_METRICS false: PERF_SCOPE / PERF_COUNT expand to nothing and
+// the rest is not built.
+
+enum PerfStage : uint8_t {
+    // Acquisition side
+    PERF_LOOP,                  // One loop() pass (without the single-task network step)
+    PERF_LIGHT,                 // readLightLevels()
+    PERF_SENSORS,               // readClimate() + readDustLevels()
+    PERF_DECISION,              // evaluateSystemState()
+    PERF_CAMERA,                // cameraCapture(), power-up included
+    PERF_SOILING,               // scoreSoilingJpeg()
+    PERF_CAMERA_ON,             // Camera powered, per power-up (camera_capture.h)
+    // Network side
+    PERF_TELEMETRY,             // publishTelemetry()
+    PERF_IMAGE,                 // publishFrame() / publishKeyframe(), the whole upload
+    PERF_MQTT,                  // loopMQTT(), reconnects and replay included
+    PERF_RECONNECT,             // One broker connect attempt
+    PERF_STAGES
+};
+
+enum PerfCounter : uint8_t {
+    PERF_PUBLISH_FAILED,        // A publish the client refused
+    PERF_CONNECTS,
+    PERF_CONNECT_FAILED,
+    PERF_COUNTERS
+};
+
+// Bucket 0: < 1 us, bucket b: [2^(b-1), 2^b) us, the last one open-ended
+#define PERF_BUCKETS 24
+
+#if ENABLE_PERF_METRICS
+
+void perfRecord(PerfStage stage, uint32_t micros);
+void perfCount(PerfCounter counter);
+
+class PerfScope {
+public:
+    explicit PerfScope(PerfStage stage) : stage(stage), start(micros()) {}
+    ~PerfScope() { perfRecord(stage, micros() - start); }
+
+private:
+    PerfStage stage;
+    uint32_t start;
+};
+
+#define PERF_CONCAT2(a, b) a##b
+#define PERF_CONCAT(a, b) PERF_CONCAT2(a, b)
+// Times the rest of the enclosing block
+#define PERF_SCOPE(stage) PerfScope PERF_CONCAT(perfScope, __LINE__)(stage)
+#define PERF_COUNT(counter) perfCount(counter)
+
+// One stage over the interval since the last report
+struct PerfStageSummary {
+    uint32_t count;
+    uint32_t avgUs;
+    uint32_t p50Us;             // Upper bound of the bucket holding it
+    uint32_t p95Us;
+    uint32_t maxUs;
+    uint32_t buckets[PERF_BUCKETS];
+};
+
+struct PerfReport {
+    uint32_t intervalMs;
+    PerfStageSummary stage[PERF_STAGES];
+    uint32_t counters[PERF_COUNTERS];
+    uint32_t heapFree;
+    uint32_t heapMin;           // Low-water marks since boot
+    uint32_t psramFree;
+    uint32_t psramMin;
+};
+
+// Network side. True every PERF_REPORT_MS: `report` holds the interval that
+// just ended and a new one starts.
+bool perfReportDue(PerfReport* report);
+// The report as compact JSON (see README); returns the length, 0 if it does
+// not fit
+size_t perfReportJson(const PerfReport& report, char* out, size_t size);
+const char* perfStageName(PerfStage stage);
+// Everything to zero, the interval starts now
+void perfReset();
+
+#else
+
+#define PERF_SCOPE(stage) do {} while (0)
+#define PERF_COUNT(counter) do {} while (0)
+
+#endif
+
+#endif
@@ -0,0 +1,181 @@
+#include "report.h"
+
+static ReportConfig config = reportConfigDefault();
+
+// Last sent, per metric and channel
+static uint16_t primed[REPORT_METRICS];
+static float last[REPORT_METRICS][SENSOR_MAX_CHANNELS];
+static unsigned long sentAtMs[REPORT_METRICS][SENSOR_MAX_CHANNELS];
+static int8_t alertSent = -1;
+static uint8_t alertQuiet = 0;
+static unsigned long alertAtMs = 0;
+static int8_t modeSent = -1;
+static unsigned long modeAtMs = 0;
+
+static ReportStats stats;
+
+const ReportConfig& reportConfigDefault() {
+    static const ReportConfig def = {
+        ENABLE_REPORT_BY_EXCEPTION,
+        {
+            {REPORT_DB_TEMP, 0},
+            {REPORT_DB_HUMIDITY, 0},
+            {REPORT_DB_LUX, REPORT_DB_LUX_REL},
+            {REPORT_DB_DUST, REPORT_DB_DUST_REL},
+            {REPORT_DB_SOILING, 0},
+        },
+        REPORT_HEARTBEAT_MS,
+        REPORT_ALERT_CLEAR_CYCLES,
+    };
+    return def;
+}
+
+void reportConfigure(const ReportConfig& newConfig) {
+    config = newConfig;
+    memset(primed, 0, sizeof(primed));
+    alertSent = -1;
+    alertQuiet = 0;
+    modeSent = -1;
+}
+
+// Due: unsent, past the deadband or silent too long
+static bool valueDue(uint8_t metric, uint8_t channel, float value, unsigned long now, bool* heartbeat) {
+    if (!config.enabled || !((primed[metric] >> channel) & 1)) return true;
+    float sent = last[metric][channel];
+    const Deadband& band = config.deadband[metric];
+    float limit = band.rel * fabsf(sent);
+    if (limit < band.abs) limit = band.abs;
+    if (fabsf(value - sent) > limit) return true;
+    *heartbeat = now - sentAtMs[metric][channel] >= config.heartbeatMs;
+    return *heartbeat;
+}
+
+static void markSent(uint8_t metric, uint8_t channel, float value, unsigned long now) {
+    primed[metric] |= 1 << channel;
+    last[metric][channel] = value;
+    sentAtMs[metric][channel] = now;
+}
+
+ReportMask reportTelemetry(const SystemStatus& status, const SensorBank& bank) {
+    ReportMask mask;
+    memset(&mask, 0, sizeof(mask));
+    unsigned long now = millis();
+    const float* values[REPORT_METRICS] = {bank.temp, bank.humidity, bank.lux, bank.dust, &status.soiling};
+    uint8_t n = bank.channels < SENSOR_MAX_CHANNELS ? bank.channels : SENSOR_MAX_CHANNELS;
+    uint32_t due = 0, held = 0, heartbeats = 0;
+
+    for (uint8_t m = 0; m < REPORT_METRICS; m++) {
+        uint8_t channels = m == REPORT_SOILING ? 1 : n;
+        for (uint8_t ch = 0; ch < channels; ch++) {
+            float v = values[m][ch];
+            if (isnan(v)) continue;
+            bool heartbeat = false;
+            if (valueDue(m, ch, v, now, &heartbeat)) {
+                mask.channels[m] |= 1 << ch;
+                due++;
+                heartbeats += heartbeat;
+            } else {
+                held++;
+            }
+        }
+    }
+
+    #if TELEMETRY_MODE == TELEMETRY_MODE_FRAME
+        // The frame carries every value: all of them are sent, or none
+        if (due) {
+            for (uint8_t m = 0; m < REPORT_METRICS; m++) {
+                uint8_t channels = m == REPORT_SOILING ? 1 : n;
+                for (uint8_t ch = 0; ch < channels; ch++) {
+                    if (!isnan(values[m][ch])) mask.channels[m] |= 1 << ch;
+                }
+            }
+            stats.sent++;
+            stats.heartbeats += heartbeats == due;
+        } else if (held) {
+            stats.suppressed++;
+        }
+    #else
+        stats.sent += due;
+        stats.suppressed += held;
+        stats.heartbeats += heartbeats;
+    #endif
+
+    for (uint8_t m = 0; m < REPORT_METRICS; m++) {
+        for (uint8_t ch = 0; ch < n; ch++) {
+            if (reportMaskHas(mask, m, ch)) markSent(m, ch, values[m][ch], now);
+        }
+    }
+    return mask;
+}
+
+bool reportAlert(bool cleanNeeded, bool* value) {
+    unsigned long now = millis();
+    if (cleanNeeded) alertQuiet = 0;
+    else if (alertQuiet < 255) alertQuiet++;
+
+    bool state = cleanNeeded;
+    bool publish = true;
+    if (config.enabled) {
+        // A raised alert stays raised until it has been quiet for a while
+        if (!cleanNeeded && alertSent == 1 && alertQuiet < config.alertClearCycles) state = true;
+        publish = alertSent != (int8_t)state || now - alertAtMs >= config.heartbeatMs;
+        if (publish && alertSent == (int8_t)state) stats.heartbeats++;
+    }
+    if (!publish) {
+        stats.suppressed++;
+        return false;
+    }
+    stats.sent++;
+    alertSent = state;
+    alertAtMs = now;
+    *value = state;
+    return true;
+}
+
+bool reportMode(SystemMode mode) {
+    unsigned long now = millis();
+    bool changed = modeSent != (int8_t)mode;
+    bool heartbeat = config.enabled && !changed && now - modeAtMs >= config.heartbeatMs;
+    if (!changed && !heartbeat) return false;       // Not counted: it was never sent every pass
+    stats.sent++;
+    stats.heartbeats += heartbeat;
+    modeSent = (int8_t)mode;
+    modeAtMs = now;
+    return true;
+}
+
+ReportStats reportStats() { return stats; }
+
+void reportResetStats() { memset(&stats, 0, sizeof(stats)); }
+
+ReportState reportSaveState() {
+    ReportState state;
+    memset(&state, 0, sizeof(state));
+    unsigned long now = millis();
+    memcpy(state.primed, primed, sizeof(primed));
+    memcpy(state.last, last, sizeof(last));
+    for (uint8_t m = 0; m < REPORT_METRICS; m++) {
+        for (uint8_t ch = 0; ch < SENSOR_MAX_CHANNELS; ch++) state.ageMs[m][ch] = now - sentAtMs[m][ch];
+    }
+    state.alert = alertSent;
+    state.alertQuiet = alertQuiet;
+    state.alertAgeMs = now - alertAtMs;
+    state.mode = modeSent;
+    state.modeAgeMs = now - modeAtMs;
+    return state;
+}
+
+void reportRestoreState(const ReportState& state, uint32_t sleptMs) {
+    unsigned long now = millis();
+    memcpy(primed, state.primed, sizeof(primed));
+    memcpy(last, state.last, sizeof(last));
+    // Wraps like millis()
+    for (uint8_t m = 0; m < REPORT_METRICS; m++) {
+        for (uint8_t ch = 0; ch < SENSOR_MAX_CHANNELS; ch++) sentAtMs[m][ch] = now - (state.ageMs[m][ch] + sleptMs);
+    }
+    alertSent = state.alert;
+    alertQuiet = state.alertQuiet;
+    alertAtMs = now - (state.alertAgeMs + sleptMs);
+    modeSent = state.mode;
+    modeAtMs = now - (state.modeAgeMs + sleptMs);
+}
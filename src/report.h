@@ -0,0 +1,94 @@
+#ifndef REPORT_H
+#define REPORT_H
+
+#include <Arduino.h>
+#include "config.h"
+#include "core.h"
+
+// Report by exception. Acquisition asks here, once per cycle, which values
+// are worth publishing; the network side publishes only those. A value that
+// is not measured (NaN) is neither sent nor counted, and does not trigger a
+// heartbeat. Deadbands compare with the last value sent, so a slow drift is
+// reported once it adds up.
+
+enum ReportMetric : uint8_t {
+    REPORT_TEMP,
+    REPORT_HUMIDITY,
+    REPORT_LUX,
+    REPORT_DUST,
+    REPORT_SOILING,             // Channel 0 only (one camera)
+    REPORT_METRICS
+};
+
+// A change counts past max(abs, rel * |last sent|)
+struct Deadband {
+    float abs;
+    float rel;
+};
+
+struct ReportConfig {
+    bool enabled;               // false: every value of every cycle, the mode on a change only
+    Deadband deadband[REPORT_METRICS];
+    uint32_t heartbeatMs;
+    uint8_t alertClearCycles;
+};
+
+// Channel bits per metric: this cycle's values to publish
+struct ReportMask {
+    uint16_t channels[REPORT_METRICS];
+};
+
+static_assert(SENSOR_MAX_CHANNELS <= 16, "ReportMask has 16 channel bits");
+
+inline bool reportMaskHas(const ReportMask& mask, uint8_t metric, uint8_t channel) {
+    return (mask.channels[metric] >> channel) & 1;
+}
+
+inline bool reportMaskEmpty(const ReportMask& mask) {
+    for (uint8_t m = 0; m < REPORT_METRICS; m++) {
+        if (mask.channels[m]) return false;
+    }
+    return true;
+}
+
+inline void reportMaskMerge(ReportMask* mask, const ReportMask& other) {
+    for (uint8_t m = 0; m < REPORT_METRICS; m++) mask->channels[m] |= other.channels[m];
+}
+
+// Messages sent vs held back. In TELEMETRY_MODE_FRAME a telemetry message is
+// a frame (sent when any value is due), otherwise one value.
+struct ReportStats {
+    uint32_t sent;
+    uint32_t suppressed;
+    uint32_t heartbeats;        // Sent only because of the silence limit
+};
+
+// config.h values (ENABLE_REPORT_BY_EXCEPTION, REPORT_*)
+const ReportConfig& reportConfigDefault();
+// Takes effect at once, forgetting what was sent (the next values all go out)
+void reportConfigure(const ReportConfig& config);
+
+ReportMask reportTelemetry(const SystemStatus& status, const SensorBank& bank);
+// True if the state should be published (as *value)
+bool reportAlert(bool cleanNeeded, bool* value);
+bool reportMode(SystemMode mode);
+
+ReportStats reportStats();
+void reportResetStats();
+
+// What was last sent, across deep sleep (times as ages)
+struct ReportState {
+    uint16_t primed[REPORT_METRICS];    // Channel bits with a value sent
+    float last[REPORT_METRICS][SENSOR_MAX_CHANNELS];
+    uint32_t ageMs[REPORT_METRICS][SENSOR_MAX_CHANNELS];
+    int8_t alert;                       // Last sent: -1 none, 0 / 1
+    uint8_t alertQuiet;                 // Day cycles without a trigger since
+    int8_t mode;                        // Last sent SystemMode, -1 none
+    uint32_t alertAgeMs;
+    uint32_t modeAgeMs;
+};
+
+ReportState reportSaveState();
+void reportRestoreState(const ReportState& state, uint32_t sleptMs);
+
+#endif
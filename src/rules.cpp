@@ -0,0 +1,409 @@
+#include "rules.h"
+#include "checksum.h"
+#include "logger.h"
+#include <atomic>
+
+#define RULES_MAGIC       0x454C5552UL   // "RULE"
+#define RULES_HEADER_SIZE 12
+#define RULES_RTC_MAGIC   0x52554C53UL   // "RULS"
+
+static_assert(RULES_MAX_SLOTS <= 8, "slot bits are kept in a uint8_t");
+static_assert(RULES_MAX_REASONS <= 8, "note bits are kept in a uint8_t");
+static_assert(RULES_MAX_OPS <= 255 && RULES_MAX_CONSTS <= 255, "counts are sent as one byte");
+
+// --- Default ruleset: the fixed logic this engine replaced ---
+enum { K_DUST, K_HUMIDITY, K_LUX, K_DAYS, K_CONFIRM, K_CLEAN, K_COUNT };
+enum { R_WAITING, R_ENVIRONMENT, R_VISION, R_COUNT };
+
+static constexpr RuleOp fieldOp(RuleField f) { return RuleOp(OP_FIELD, f); }
+static constexpr RuleOp constOp(uint8_t k) { return RuleOp(OP_CONST, k); }
+static constexpr RuleOp op(RuleOpcode code, uint8_t a = 0) { return RuleOp(code, a); }
+
+static constexpr RuleSet DEFAULT_RULES = {
+    0, K_COUNT, 52, R_COUNT,
+    {DUST_THRESHOLD, HUMIDITY_MIN_TRIGGER, MIN_LUX_FOR_CLEANING, DAYS_BETWEEN_CLEAN, SOILING_CONFIRM_SCORE,
+     SOILING_CLEAN_SCORE},
+    {
+        // Dusty, dry and bright, but not due yet: log only
+        fieldOp(RULE_DUST), constOp(K_DUST), op(OP_GT),
+        fieldOp(RULE_HUMIDITY), constOp(K_HUMIDITY), op(OP_LT), op(OP_AND),
+        fieldOp(RULE_LUX), constOp(K_LUX), op(OP_GT), op(OP_AND),
+        fieldOp(RULE_DAYS_SINCE_CLEAN), constOp(K_DAYS), op(OP_GE), op(OP_NOT), op(OP_AND),
+        op(OP_NOTE, R_WAITING),
+        // Dusty, dry, bright and due; the camera, if it scored, agrees
+        fieldOp(RULE_DUST), constOp(K_DUST), op(OP_GT),
+        fieldOp(RULE_HUMIDITY), constOp(K_HUMIDITY), op(OP_LT), op(OP_AND),
+        fieldOp(RULE_LUX), constOp(K_LUX), op(OP_GT), op(OP_AND),
+        fieldOp(RULE_DAYS_SINCE_CLEAN), constOp(K_DAYS), op(OP_GE), op(OP_AND),
+        fieldOp(RULE_SOILING), op(OP_ISNAN),
+        fieldOp(RULE_SOILING), constOp(K_CONFIRM), op(OP_GE), op(OP_OR), op(OP_AND),
+        op(OP_TRIGGER, R_ENVIRONMENT),
+        // The camera alone: soiled (NaN, not scored, compares false), bright and due
+        fieldOp(RULE_SOILING), constOp(K_CLEAN), op(OP_GE),
+        fieldOp(RULE_LUX), constOp(K_LUX), op(OP_GT), op(OP_AND),
+        fieldOp(RULE_DAYS_SINCE_CLEAN), constOp(K_DAYS), op(OP_GE), op(OP_AND),
+        op(OP_TRIGGER, R_VISION),
+    },
+    {"Critical conditions, not due", "Environment (Dust+Dry+Time)", "Vision (Soiling score)"},
+};
+
+static_assert(DEFAULT_RULES.ops[DEFAULT_RULES.nOps - 1].op != 0 && DEFAULT_RULES.ops[DEFAULT_RULES.nOps].op == 0,
+              "nOps of the default ruleset does not match its program");
+static_assert(ruleProgramOk(DEFAULT_RULES.ops, DEFAULT_RULES.nOps, DEFAULT_RULES.nConsts, DEFAULT_RULES.nReasons),
+              "default ruleset is not a valid program");
+
+// --- Active ruleset (acquisition side) ---
+// Updates go to the bank not in use, so the reason texts of the previous
+// ruleset stay valid while the logger still holds them
+static RuleSet banks[2];
+static uint8_t nextBank = 0;
+static const RuleSet* active = &DEFAULT_RULES;
+static std::atomic<uint32_t> activeId(0);
+
+// Slot state, per channel
+static uint8_t latched[SENSOR_MAX_CHANNELS];
+static uint8_t held[SENSOR_MAX_CHANNELS];
+static unsigned long heldSinceMs[RULES_MAX_SLOTS][SENSOR_MAX_CHANNELS];
+
+// Last adopted update, reloaded after a reset or a deep sleep. RTC memory
+// that no boot reloads (see deep_sleep.h): garbage after a power-on, so it is
+// only trusted with the magic and the CRC of len and blob.
+struct RulesRecord {
+    uint32_t magic;
+    uint32_t crc;
+    uint16_t len;
+    uint8_t blob[RULES_BLOB_MAX];
+};
+
+RTC_NOINIT_ATTR static RulesRecord rtc;
+
+// Mailbox: written by rulesOffer() while `pending` is false, read by the
+// acquisition side while it is true
+static std::atomic<bool> pending(false);
+static RuleSet incoming;
+static uint8_t incomingBlob[RULES_BLOB_MAX];
+static uint16_t incomingLen = 0;
+static uint32_t incomingId = 0;
+
+static void putU16(uint8_t* p, uint16_t v) {
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+}
+
+static void putU32(uint8_t* p, uint32_t v) {
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+    p[2] = (uint8_t)(v >> 16);
+    p[3] = (uint8_t)(v >> 24);
+}
+
+static uint16_t getU16(const uint8_t* p) { return (uint16_t)(p[0] | (p[1] << 8)); }
+
+static uint32_t getU32(const uint8_t* p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+// Identifies a ruleset: its CRC, 0 if the blob does not carry a valid one
+static uint32_t blobId(const uint8_t* blob, size_t len) {
+    if (len < 4) return 0;
+    uint32_t crc = crc32(blob, len - 4);
+    return crc == getU32(blob + len - 4) ? crc : 0;
+}
+
+static uint32_t recordCrc(const RulesRecord& r) {
+    return crc32Update(crc32((const uint8_t*)&r.len, sizeof(r.len)), r.blob, r.len);
+}
+
+static void resetSlots() {
+    memset(latched, 0, sizeof(latched));
+    memset(held, 0, sizeof(held));
+    memset(heldSinceMs, 0, sizeof(heldSinceMs));
+}
+
+static uint32_t defaultId() {
+    uint8_t blob[RULES_BLOB_MAX];
+    size_t len = rulesEncode(DEFAULT_RULES, blob, sizeof(blob));
+    return blobId(blob, len);
+}
+
+void rulesInit() {
+    pending.store(false);
+    resetSlots();
+    active = &DEFAULT_RULES;
+    activeId.store(defaultId());
+    nextBank = 0;
+    if (rtc.magic != RULES_RTC_MAGIC) return;
+    if (rtc.len <= sizeof(rtc.blob) && rtc.crc == recordCrc(rtc) && rulesDecode(rtc.blob, rtc.len, &banks[0]) == RULES_OK) {
+        active = &banks[0];
+        activeId.store(blobId(rtc.blob, rtc.len));
+        nextBank = 1;
+        LOG_INFO("📜 Rules v%u from RTC memory (%u ops)", (unsigned)active->version, (unsigned)active->nOps);
+    } else {
+        rtc.magic = 0;
+        LOG_WARN("📜 Stored rules invalid: defaults");
+    }
+}
+
+static void adoptPending() {
+    if (!pending.load(std::memory_order_acquire)) return;
+    RuleSet& bank = banks[nextBank];
+    bank = incoming;
+    nextBank ^= 1;
+    active = &bank;
+    activeId.store(incomingId);
+    resetSlots();
+    #if ENABLE_RULE_UPDATES
+        memcpy(rtc.blob, incomingBlob, incomingLen);
+        rtc.len = incomingLen;
+        rtc.crc = recordCrc(rtc);
+        rtc.magic = RULES_RTC_MAGIC;
+    #endif
+    pending.store(false, std::memory_order_release);
+    LOG_INFO("📜 Rules v%u adopted (%u ops)", (unsigned)bank.version, (unsigned)bank.nOps);
+}
+
+// Each instruction runs over all channels before the next one (a stack
+// entry is one value per channel). Programs are validated before they
+// become active (static_assert for the default, rulesDecode() for updates),
+// so nothing is checked here.
+void rulesEvaluateBank(const SensorBank& bank, const SystemStatus& shared, int32_t daysSinceClean,
+                       RuleResult* out) {
+    adoptPending();
+    const RuleSet& rules = *active;
+    uint8_t n = bank.channels < SENSOR_MAX_CHANNELS ? bank.channels : SENSOR_MAX_CHANNELS;
+    for (uint8_t c = 0; c < n; c++) {
+        out[c].trigger = -1;
+        out[c].notes = 0;
+    }
+    // Per-channel fields point into the bank, the others are one value for all
+    const float* lanes[RULE_FIELD_COUNT] = {bank.temp, bank.humidity, bank.lux, bank.dust};
+    float common[RULE_FIELD_COUNT];
+    common[RULE_EFFICIENCY] = shared.efficiency;
+    common[RULE_SOILING] = shared.soiling;
+    common[RULE_DAYS_SINCE_CLEAN] = (float)daysSinceClean;
+    common[RULE_MODE] = (float)shared.mode;
+
+    float stack[RULES_STACK][SENSOR_MAX_CHANNELS];
+    int sp = 0;
+    // x: second from the top, y: top; the result replaces x
+    #define RULE_BINARY(expr)                                   \
+        sp--;                                                   \
+        for (uint8_t c = 0; c < n; c++) {                       \
+            float x = stack[sp - 1][c], y = stack[sp][c];       \
+            stack[sp - 1][c] = (expr);                          \
+        }                                                       \
+        break
+    for (uint8_t i = 0; i < rules.nOps; i++) {
+        const RuleOp& o = rules.ops[i];
+        float* top = stack[sp > 0 ? sp - 1 : 0];
+        switch (o.op) {
+            case OP_FIELD:
+                if (lanes[o.a]) memcpy(stack[sp], lanes[o.a], n * sizeof(float));
+                else for (uint8_t c = 0; c < n; c++) stack[sp][c] = common[o.a];
+                sp++;
+                break;
+            case OP_CONST:
+                for (uint8_t c = 0; c < n; c++) stack[sp][c] = rules.consts[o.a];
+                sp++;
+                break;
+            case OP_GT:    RULE_BINARY(x > y);
+            case OP_GE:    RULE_BINARY(x >= y);
+            case OP_LT:    RULE_BINARY(x < y);
+            case OP_LE:    RULE_BINARY(x <= y);
+            case OP_AND:   RULE_BINARY(x != 0 && y != 0);
+            case OP_OR:    RULE_BINARY(x != 0 || y != 0);
+            case OP_ISNAN:
+                for (uint8_t c = 0; c < n; c++) top[c] = isnan(top[c]);
+                break;
+            case OP_NOT:
+                for (uint8_t c = 0; c < n; c++) top[c] = top[c] == 0;
+                break;
+            case OP_HYST: {
+                sp -= 2;
+                uint8_t bit = 1 << o.a;
+                float* x = stack[sp - 1];
+                for (uint8_t c = 0; c < n; c++) {
+                    if (x[c] > stack[sp][c]) latched[c] |= bit;
+                    else if (x[c] < stack[sp + 1][c]) latched[c] &= ~bit;
+                    x[c] = (latched[c] & bit) != 0;
+                }
+                break;
+            }
+            case OP_HELD: {
+                uint8_t bit = 1 << o.a;
+                unsigned long now = millis();
+                unsigned long holdMs = (unsigned long)o.b * 1000UL;
+                for (uint8_t c = 0; c < n; c++) {
+                    if (top[c] != 0) {
+                        if (!(held[c] & bit)) {
+                            held[c] |= bit;
+                            heldSinceMs[o.a][c] = now;
+                        }
+                        top[c] = now - heldSinceMs[o.a][c] >= holdMs;
+                    } else {
+                        held[c] &= ~bit;
+                    }
+                }
+                break;
+            }
+            case OP_NOTE:
+                sp--;
+                for (uint8_t c = 0; c < n; c++) {
+                    if (top[c] != 0) out[c].notes |= 1 << o.a;
+                }
+                break;
+            case OP_TRIGGER:
+                sp--;
+                for (uint8_t c = 0; c < n; c++) {
+                    if (top[c] != 0 && out[c].trigger < 0) out[c].trigger = (int8_t)o.a;
+                }
+                break;
+        }
+    }
+    #undef RULE_BINARY
+}
+
+RuleResult rulesEvaluate(const SystemStatus& status, int32_t daysSinceClean) {
+    SensorBank bank;
+    bank.channels = 1;
+    bank.temp[0] = status.temp;
+    bank.humidity[0] = status.humidity;
+    bank.lux[0] = status.lux;
+    bank.dust[0] = status.dust;
+    RuleResult result;
+    rulesEvaluateBank(bank, status, daysSinceClean, &result);
+    return result;
+}
+
+const char* rulesReason(int8_t index) {
+    return index >= 0 && index < active->nReasons ? active->reasons[index] : "";
+}
+
+uint16_t rulesVersion() { return active->version; }
+
+const RuleSet& rulesDefault() { return DEFAULT_RULES; }
+
+bool rulesIsDefault() { return active == &DEFAULT_RULES; }
+
+RulesState rulesSaveState() {
+    RulesState state;
+    memset(&state, 0, sizeof(state));
+    state.id = activeId.load();
+    memcpy(state.latched, latched, sizeof(latched));
+    memcpy(state.held, held, sizeof(held));
+    unsigned long now = millis();
+    for (int i = 0; i < RULES_MAX_SLOTS; i++) {
+        for (int c = 0; c < SENSOR_MAX_CHANNELS; c++) {
+            if (held[c] & (1 << i)) state.heldAgeMs[i][c] = now - heldSinceMs[i][c];
+        }
+    }
+    return state;
+}
+
+void rulesRestoreState(const RulesState& state, uint32_t sleptMs) {
+    resetSlots();
+    if (state.id != activeId.load()) return;   // Another ruleset since the save
+    memcpy(latched, state.latched, sizeof(latched));
+    memcpy(held, state.held, sizeof(held));
+    unsigned long now = millis();
+    for (int i = 0; i < RULES_MAX_SLOTS; i++) {
+        for (int c = 0; c < SENSOR_MAX_CHANNELS; c++) {
+            // Wraps like millis()
+            if (held[c] & (1 << i)) heldSinceMs[i][c] = now - (state.heldAgeMs[i][c] + sleptMs);
+        }
+    }
+}
+
+RuleError rulesOffer(const uint8_t* blob, size_t len, uint16_t* version) {
+    *version = len >= 6 ? getU16(blob + 4) : 0;
+    uint32_t id = blobId(blob, len);
+    if (id && id == activeId.load()) return RULES_OK;
+    if (pending.load(std::memory_order_acquire)) return id == incomingId ? RULES_OK : RULES_BUSY;
+    RuleError err = rulesDecode(blob, len, &incoming);
+    if (err != RULES_OK) return err;
+    memcpy(incomingBlob, blob, len);
+    incomingLen = (uint16_t)len;
+    incomingId = id;
+    pending.store(true, std::memory_order_release);
+    return RULES_OK;
+}
+
+const char* rulesErrorName(RuleError err) {
+    switch (err) {
+        case RULES_OK:          return "ok";
+        case RULES_BAD_SIZE:    return "bad_size";
+        case RULES_BAD_CRC:     return "bad_crc";
+        case RULES_BAD_HEADER:  return "bad_header";
+        case RULES_BAD_PROGRAM: return "bad_program";
+        case RULES_BAD_REASON:  return "bad_reason";
+        case RULES_BUSY:        return "busy";
+    }
+    return "unknown";
+}
+
+size_t rulesEncode(const RuleSet& rules, uint8_t* out, size_t size) {
+    size_t len = RULES_HEADER_SIZE + 4 * rules.nConsts + 4 * rules.nOps + 4;
+    for (uint8_t r = 0; r < rules.nReasons; r++) len += strnlen(rules.reasons[r], RULES_REASON_LEN - 1) + 1;
+    if (len > size) return 0;
+
+    putU32(out, RULES_MAGIC);
+    putU16(out + 4, rules.version);
+    out[6] = rules.nConsts;
+    out[7] = rules.nOps;
+    out[8] = rules.nReasons;
+    out[9] = out[10] = out[11] = 0;
+    uint8_t* p = out + RULES_HEADER_SIZE;
+    for (uint8_t k = 0; k < rules.nConsts; k++, p += 4) {
+        uint32_t bits;
+        memcpy(&bits, &rules.consts[k], sizeof(bits));
+        putU32(p, bits);
+    }
+    for (uint8_t i = 0; i < rules.nOps; i++, p += 4) {
+        p[0] = rules.ops[i].op;
+        p[1] = rules.ops[i].a;
+        putU16(p + 2, rules.ops[i].b);
+    }
+    for (uint8_t r = 0; r < rules.nReasons; r++) {
+        size_t n = strnlen(rules.reasons[r], RULES_REASON_LEN - 1);
+        memcpy(p, rules.reasons[r], n);
+        p[n] = 0;
+        p += n + 1;
+    }
+    putU32(p, crc32(out, p - out));
+    return len;
+}
+
+RuleError rulesDecode(const uint8_t* blob, size_t len, RuleSet* rules) {
+    if (len < RULES_HEADER_SIZE + 4 || len > RULES_BLOB_MAX) return RULES_BAD_SIZE;
+    if (getU32(blob + len - 4) != crc32(blob, len - 4)) return RULES_BAD_CRC;
+    uint8_t nConsts = blob[6], nOps = blob[7], nReasons = blob[8];
+    if (getU32(blob) != RULES_MAGIC || nConsts > RULES_MAX_CONSTS || nOps == 0 || nOps > RULES_MAX_OPS ||
+        nReasons > RULES_MAX_REASONS) {
+        return RULES_BAD_HEADER;
+    }
+    const uint8_t* p = blob + RULES_HEADER_SIZE;
+    const uint8_t* end = blob + len - 4;
+    if ((size_t)(end - p) < 4u * nConsts + 4u * nOps) return RULES_BAD_SIZE;
+
+    *rules = RuleSet();
+    rules->version = getU16(blob + 4);
+    rules->nConsts = nConsts;
+    rules->nOps = nOps;
+    rules->nReasons = nReasons;
+    for (uint8_t k = 0; k < nConsts; k++, p += 4) {
+        uint32_t bits = getU32(p);
+        memcpy(&rules->consts[k], &bits, sizeof(bits));
+    }
+    for (uint8_t i = 0; i < nOps; i++, p += 4) rules->ops[i] = RuleOp(p[0], p[1], getU16(p + 2));
+    for (uint8_t r = 0; r < nReasons; r++) {
+        size_t room = end - p;
+        size_t n = strnlen((const char*)p, room < RULES_REASON_LEN ? room : RULES_REASON_LEN);
+        if (n == room) return RULES_BAD_SIZE;
+        if (n == RULES_REASON_LEN) return RULES_BAD_REASON;
+        memcpy(rules->reasons[r], p, n + 1);
+        p += n + 1;
+    }
+    if (p != end) return RULES_BAD_SIZE;
+    if (!ruleProgramOk(rules->ops, nOps, nConsts, nReasons)) return RULES_BAD_PROGRAM;
+    return RULES_OK;
+}
@@ -0,0 +1,163 @@
+#ifndef RULES_H
+#define RULES_H
+
+#include <Arduino.h>
+#include "config.h"
+#include "core.h"
+
+// Cleaning-decision rules as a small stack program, evaluated against each
+// day cycle's readings, every channel (panel string) at once. No jumps and at
+// most RULES_MAX_OPS instructions, so an evaluation is bounded; no heap
+// anywhere.
+//
+// A rule pushes values (status fields, constants), combines them and ends in
+// TRIGGER (raise the alert with a reason; the first one wins, later rules
+// still run so their time/hysteresis state stays current) or NOTE (log the
+// reason only). HYST and HELD keep state per slot and channel between evaluations.
+//
+// The default ruleset is the fixed logic from config.h, checked at compile
+// time. A new one arrives as a blob on TOPIC_RULES, is decoded and validated
+// on the network side, and is adopted by the next evaluation.
+
+enum RuleField : uint8_t {
+    RULE_TEMP,                  // Per channel (SensorBank)
+    RULE_HUMIDITY,
+    RULE_LUX,
+    RULE_DUST,
+    RULE_EFFICIENCY,            // Shared by all channels
+    RULE_SOILING,
+    RULE_DAYS_SINCE_CLEAN,
+    RULE_MODE,                  // SystemMode as a number
+    RULE_FIELD_COUNT
+};
+
+// Stack effect in brackets (popped -> pushed). Booleans are 0 / 1; NaN
+// compares false, as in C.
+enum RuleOpcode : uint8_t {
+    OP_FIELD = 1,   // a = RuleField              [ -> x]
+    OP_CONST,       // a = constant index         [ -> k]
+    OP_GT,          //                            [x y -> x > y]
+    OP_GE,
+    OP_LT,
+    OP_LE,
+    OP_ISNAN,       //                            [x -> isnan(x)]
+    OP_AND,         //                            [p q -> p && q]
+    OP_OR,
+    OP_NOT,         //                            [p -> !p]
+    OP_HYST,        // a = slot: on above `on`, off below `off`, else as before
+                    //                            [x on off -> latched]
+    OP_HELD,        // a = slot, b = seconds: p true for at least b s
+                    //                            [p -> held]
+    OP_NOTE,        // a = reason: logged when p  [p -> ]
+    OP_TRIGGER,     // a = reason: the decision   [p -> ]
+    OP_COUNT
+};
+
+struct RuleOp {
+    uint8_t op;
+    uint8_t a;
+    uint16_t b;
+
+    constexpr RuleOp() : op(0), a(0), b(0) {}
+    constexpr RuleOp(uint8_t op, uint8_t a = 0, uint16_t b = 0) : op(op), a(a), b(b) {}
+};
+
+struct RuleSet {
+    uint16_t version;           // Chosen by the sender, echoed in the ACK
+    uint8_t nConsts;
+    uint8_t nOps;
+    uint8_t nReasons;
+    float consts[RULES_MAX_CONSTS];
+    RuleOp ops[RULES_MAX_OPS];
+    char reasons[RULES_MAX_REASONS][RULES_REASON_LEN];
+};
+
+enum RuleError : uint8_t {
+    RULES_OK,
+    RULES_BAD_SIZE,             // Truncated, or longer than its header says
+    RULES_BAD_CRC,
+    RULES_BAD_HEADER,           // Magic or counts beyond the limits
+    RULES_BAD_PROGRAM,          // Unknown op, index out of range, stack depth
+    RULES_BAD_REASON,           // Not terminated within RULES_REASON_LEN
+    RULES_BUSY                  // The previous update is not adopted yet
+};
+
+struct RuleResult {
+    int8_t trigger;             // Reason of the first TRIGGER taken, -1 if none
+    uint8_t notes;              // Bit per reason of the NOTEs taken
+};
+
+// --- Compile-time checks (also used on received rulesets) ---
+constexpr int rulePops(uint8_t op) {
+    return op == OP_FIELD || op == OP_CONST ? 0
+         : op == OP_ISNAN || op == OP_NOT || op == OP_HELD || op == OP_NOTE || op == OP_TRIGGER ? 1
+         : op == OP_HYST ? 3
+         : op >= OP_GT && op < OP_COUNT ? 2
+         : -1;
+}
+
+constexpr int rulePushes(uint8_t op) { return op == OP_NOTE || op == OP_TRIGGER ? 0 : 1; }
+
+constexpr bool ruleArgOk(const RuleOp& op, uint8_t nConsts, uint8_t nReasons) {
+    return op.op == OP_FIELD ? op.a < RULE_FIELD_COUNT
+         : op.op == OP_CONST ? op.a < nConsts
+         : op.op == OP_HYST || op.op == OP_HELD ? op.a < RULES_MAX_SLOTS
+         : op.op == OP_NOTE || op.op == OP_TRIGGER ? op.a < nReasons
+         : true;
+}
+
+// Every op known with valid arguments, the stack within RULES_STACK and
+// empty at the end
+constexpr bool ruleProgramOk(const RuleOp* ops, int n, uint8_t nConsts, uint8_t nReasons, int i = 0,
+                             int depth = 0) {
+    return i == n ? depth == 0
+         : rulePops(ops[i].op) < 0 || depth < rulePops(ops[i].op) || !ruleArgOk(ops[i], nConsts, nReasons) ? false
+         : depth - rulePops(ops[i].op) + rulePushes(ops[i].op) > RULES_STACK ? false
+         : ruleProgramOk(ops, n, nConsts, nReasons, i + 1, depth - rulePops(ops[i].op) + rulePushes(ops[i].op));
+}
+
+// --- Acquisition side ---
+// Ruleset kept in RTC memory (last accepted update) or the default
+void rulesInit();
+// Adopts a pending update first. One result per channel in `out`;
+// efficiency, soiling and mode come from `shared`.
+void rulesEvaluateBank(const SensorBank& bank, const SystemStatus& shared, int32_t daysSinceClean,
+                       RuleResult* out);
+// One channel: the status' own values (channel 0's slots)
+RuleResult rulesEvaluate(const SystemStatus& status, int32_t daysSinceClean);
+// Reason text of the active ruleset (stable until the update after next)
+const char* rulesReason(int8_t index);
+uint16_t rulesVersion();
+const RuleSet& rulesDefault();
+// Active RuleSet is the default (no update adopted since power-on)
+bool rulesIsDefault();
+
+// Slot state across deep sleep (times as ages)
+struct RulesState {
+    uint32_t id;                // CRC of the ruleset: slots only apply to the same one
+    uint8_t latched[SENSOR_MAX_CHANNELS];   // HYST bit per slot
+    uint8_t held[SENSOR_MAX_CHANNELS];      // HELD running bit per slot
+    uint32_t heldAgeMs[RULES_MAX_SLOTS][SENSOR_MAX_CHANNELS];
+};
+
+RulesState rulesSaveState();
+void rulesRestoreState(const RulesState& state, uint32_t sleptMs);
+
+// --- Network side ---
+// Validates a received blob and hands it to the acquisition side. The same
+// blob as the active one (a retained message after a reconnect) is accepted
+// without a swap, so the slot state is kept. *version: from the header, 0
+// if unreadable.
+RuleError rulesOffer(const uint8_t* blob, size_t len, uint16_t* version);
+const char* rulesErrorName(RuleError err);
+
+// --- Wire format (little-endian) ---
+// "RULE", version u16, nConsts u8, nOps u8, nReasons u8, 3 reserved bytes,
+// consts (f32 each), ops (op u8, a u8, b u16 each), reasons (NUL-terminated),
+// CRC-32 of everything before it
+#define RULES_BLOB_MAX (12 + 4 * RULES_MAX_CONSTS + 4 * RULES_MAX_OPS + RULES_MAX_REASONS * RULES_REASON_LEN + 4)
+
+size_t rulesEncode(const RuleSet& rules, uint8_t* out, size_t size);
+RuleError rulesDecode(const uint8_t* blob, size_t len, RuleSet* rules);
+
+#endif
@@ -0,0 +1,269 @@
+#include "runtime.h"
+#include "spsc_queue.h"
+#include "mqtt_driver.h"
+#include "sensor_stats.h"
+#include "logger.h"
+#include "perf_metrics.h"
+#include "camera_capture.h"
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <atomic>
+
+static SpscQueue<RuntimeRecord, RUNTIME_QUEUE_LENGTH> queue;
+
+// Acquisition side only
+static RuntimeRecord pending[RUNTIME_ALERT];    // Latest-wins slot per kind (not frames or stats)
+static bool pendingSet[RUNTIME_ALERT];
+static uint32_t nextSeq = 0;
+static uint32_t lastSampleMs = 0;
+static bool sampled = false;
+
+// Network side only
+static uint64_t latencySumUs = 0;
+static uint32_t handledSeq = 0;         // Sequence number after the last record handled
+
+// Written by the network side after each step: handledSeq if the broker had
+// nothing waiting then, else NOT_IDLE
+static const uint32_t NOT_IDLE = 0xFFFFFFFFUL;
+static std::atomic<uint32_t> idleAtSeq(NOT_IDLE);
+
+// Counters, each written by one side
+static std::atomic<uint32_t> framesInFlight(0);
+static std::atomic<uint32_t> statQueued(0);
+static std::atomic<uint32_t> statCoalesced(0);
+static std::atomic<uint32_t> statFramesDropped(0);
+static std::atomic<uint32_t> statStatsDropped(0);
+static std::atomic<uint32_t> statMaxDepth(0);
+static std::atomic<uint32_t> statSampleJitter(0);
+static std::atomic<uint32_t> statProcessed(0);
+static std::atomic<uint32_t> statLatencyMax(0);
+static std::atomic<uint32_t> statLatencyAvg(0);
+
+// Dashboard frame request: set by the network side, taken by the acquisition
+// side, which owns the camera
+static std::atomic<bool> frameRequested(false);
+
+static std::atomic<bool> taskRunning(false);
+static std::atomic<bool> stopRequested(false);
+
+// ============================================================================
+// ACQUISITION SIDE
+// ============================================================================
+
+static RuntimeRecord makeRecord(uint8_t kind) {
+    RuntimeRecord rec;
+    memset(&rec, 0, sizeof(rec));
+    rec.kind = kind;
+    rec.submittedAt = micros();
+    return rec;
+}
+
+static bool enqueue(RuntimeRecord& rec) {
+    uint32_t freeSlots = queue.freeSlots();
+    bool reserved = rec.kind == RUNTIME_STATE || rec.kind == RUNTIME_ALERT;
+    if (freeSlots == 0 || (!reserved && freeSlots <= RUNTIME_QUEUE_RESERVE)) return false;
+    rec.seq = nextSeq++;
+    queue.push(rec);
+    statQueued.fetch_add(1, std::memory_order_relaxed);
+    uint32_t depth = queue.size();
+    if (depth > statMaxDepth.load(std::memory_order_relaxed)) statMaxDepth.store(depth, std::memory_order_relaxed);
+    return true;
+}
+
+void runtimeRetryPending() {
+    for (int k = 0; k < RUNTIME_ALERT; k++) {
+        if (pendingSet[k] && enqueue(pending[k])) pendingSet[k] = false;
+    }
+}
+
+bool runtimeTakeFrameRequest() { return frameRequested.exchange(false); }
+
+// Older records of the same kind go first, so per-kind order is kept
+static void submit(RuntimeRecord& rec) {
+    runtimeRetryPending();
+    int k = rec.kind - 1;
+    if (!pendingSet[k] && enqueue(rec)) return;
+    if (pendingSet[k]) {
+        statCoalesced.fetch_add(1, std::memory_order_relaxed);
+        // report.cpp counts the replaced values as sent: the newer record sends them
+        if (rec.kind == RUNTIME_TELEMETRY) reportMaskMerge(&rec.due, pending[k].due);
+    }
+    pending[k] = rec;
+    pendingSet[k] = true;
+}
+
+bool runtimeIdle() {
+    for (int k = 0; k < RUNTIME_ALERT; k++) {
+        if (pendingSet[k]) return false;
+    }
+    if (frameRequested.load()) return false;
+    return idleAtSeq.load() == nextSeq;
+}
+
+void runtimeSubmitTelemetry(const SystemStatus& status, const SensorBank& bank, const ReportMask& due) {
+    uint32_t now = millis();
+    if (sampled) {
+        uint32_t interval = (status.mode == MODE_DAY) ? INTERVAL_DAY : INTERVAL_NIGHT;
+        uint32_t gap = now - lastSampleMs;
+        uint32_t late = gap > interval ? gap - interval : 0;
+        if (late > statSampleJitter.load(std::memory_order_relaxed)) statSampleJitter.store(late);
+    }
+    lastSampleMs = now;
+    sampled = true;
+
+    RuntimeRecord rec = makeRecord(RUNTIME_TELEMETRY);
+    rec.status = status;
+    rec.bank = bank;
+    rec.due = due;
+    submit(rec);
+}
+
+void runtimeSubmitState(SystemMode mode) {
+    RuntimeRecord rec = makeRecord(RUNTIME_STATE);
+    rec.mode = mode;
+    submit(rec);
+}
+
+void runtimeSubmitAlert(bool cleanNeeded) {
+    RuntimeRecord rec = makeRecord(RUNTIME_ALERT);
+    rec.cleanNeeded = cleanNeeded;
+    submit(rec);
+}
+
+void runtimeSubmitStats(uint8_t channel, const StatsSummary& stats) {
+    runtimeRetryPending();
+    RuntimeRecord rec = makeRecord(RUNTIME_STATS);
+    rec.channel = channel;
+    rec.stats = stats;
+    if (!enqueue(rec)) statStatsDropped.fetch_add(1, std::memory_order_relaxed);
+}
+
+void runtimeSubmitFrame(camera_fb_t* fb) {
+    if (!fb) return;
+    runtimeRetryPending();
+    RuntimeRecord rec = makeRecord(RUNTIME_FRAME);
+    rec.fb = fb;
+    // Counted before the push: the network side may return it right away
+    if (framesInFlight.fetch_add(1) < RUNTIME_FRAMES_IN_FLIGHT && enqueue(rec)) return;
+    framesInFlight.fetch_sub(1);
+    cameraRelease(fb);
+    statFramesDropped.fetch_add(1, std::memory_order_relaxed);
+    LOG_WARN("📸 Frame dropped: upload still in progress");
+}
+
+// ============================================================================
+// NETWORK SIDE
+// ============================================================================
+
+static void handleRecord(const RuntimeRecord& rec) {
+    switch (rec.kind) {
+        case RUNTIME_TELEMETRY: {
+            PERF_SCOPE(PERF_TELEMETRY);
+            publishTelemetry(rec.status, rec.bank, rec.due);
+            break;
+        }
+        case RUNTIME_STATE:
+            publishState(modeName(rec.mode));
+            break;
+        case RUNTIME_ALERT:
+            publishAlert(rec.cleanNeeded);
+            break;
+        case RUNTIME_FRAME: {
+            PERF_SCOPE(PERF_IMAGE);
+            publishFrame(rec.fb->buf, rec.fb->len);
+            cameraRelease(rec.fb);
+            framesInFlight.fetch_sub(1);
+            break;
+        }
+        case RUNTIME_STATS:
+            publishStats(sensorStatsTopic(rec.channel), rec.stats, sensorStatsDecimals(rec.channel));
+            break;
+    }
+    handledSeq = rec.seq + 1;
+    uint32_t latency = micros() - rec.submittedAt;
+    uint32_t processed = statProcessed.fetch_add(1, std::memory_order_relaxed) + 1;
+    latencySumUs += latency;
+    statLatencyAvg.store((uint32_t)(latencySumUs / processed), std::memory_order_relaxed);
+    if (latency > statLatencyMax.load(std::memory_order_relaxed)) statLatencyMax.store(latency, std::memory_order_relaxed);
+}
+
+void runtimeNetworkStep() {
+    logDrain();            // Write out queued log records (never blocks)
+    loopMQTT();
+
+    // Frame or keyframe requested from the dashboard (TOPIC_CAM_REQ). With
+    // no keyframe yet the next frame becomes one: captured by the
+    // acquisition side and queued back as a RUNTIME_FRAME.
+    bool keyframeRequested = takeKeyframeRequest();
+    bool imageRequested = takeImageRequest();
+    if (imageRequested || keyframeRequested) {
+        PERF_SCOPE(PERF_IMAGE);
+        if (imageRequested || !publishKeyframe()) frameRequested.store(true);
+    }
+
+    // Back to loopMQTT() (ACKs, requests) after each upload
+    RuntimeRecord rec;
+    while (queue.pop(&rec)) {
+        handleRecord(rec);
+        if (rec.kind == RUNTIME_FRAME) break;
+    }
+    flushMQTT();           // What the records queued goes out now
+    idleAtSeq.store(mqttIdle() ? handledSeq : NOT_IDLE);
+}
+
+static void networkTask(void* arg) {
+    (void)arg;
+    while (!stopRequested.load()) {
+        runtimeNetworkStep();
+        vTaskDelay(pdMS_TO_TICKS(RUNTIME_NETWORK_IDLE_MS));
+    }
+    taskRunning.store(false);
+    vTaskDelete(NULL);
+}
+
+bool runtimeStartNetworkTask() {
+    if (taskRunning.load()) return true;
+    stopRequested.store(false);
+    taskRunning.store(true);
+    if (xTaskCreatePinnedToCore(networkTask, "network", RUNTIME_NETWORK_STACK, nullptr, RUNTIME_NETWORK_PRIORITY,
+                                nullptr, RUNTIME_NETWORK_CORE) != pdPASS) {
+        taskRunning.store(false);
+        LOG_ERROR("❌ Network task failed: running single-task");
+        return false;
+    }
+    LOG_INFO("🧵 Network task on core %d", RUNTIME_NETWORK_CORE);
+    return true;
+}
+
+bool runtimeNetworkTaskRunning() { return taskRunning.load(); }
+
+void runtimeStop() { stopRequested.store(true); }
+
+RuntimeStats runtimeStats() {
+    RuntimeStats s;
+    s.queued = statQueued.load();
+    s.processed = statProcessed.load();
+    s.coalesced = statCoalesced.load();
+    s.framesDropped = statFramesDropped.load();
+    s.statsDropped = statStatsDropped.load();
+    s.maxDepth = statMaxDepth.load();
+    s.latencyMaxUs = statLatencyMax.load();
+    s.latencyAvgUs = statLatencyAvg.load();
+    s.sampleJitterMaxMs = statSampleJitter.load();
+    return s;
+}
+
+// With both sides idle (before the task starts or after it stopped)
+void runtimeResetStats() {
+    statQueued.store(0);
+    statProcessed.store(0);
+    statCoalesced.store(0);
+    statFramesDropped.store(0);
+    statStatsDropped.store(0);
+    statMaxDepth.store(0);
+    statLatencyMax.store(0);
+    statLatencyAvg.store(0);
+    statSampleJitter.store(0);
+    latencySumUs = 0;
+    sampled = false;
+}
@@ -0,0 +1,92 @@
+#ifndef RUNTIME_H
+#define RUNTIME_H
+
+#include <Arduino.h>
+#include "esp_camera.h"
+#include "config.h"
+#include "core.h"
+#include "report.h"
+#include "stream_stats.h"
+
+// Two-task runtime. The acquisition side (loop(), core 1) reads the sensors,
+// follows the mode and makes the decisions; the network side (a task on
+// RUNTIME_NETWORK_CORE, or loop() itself without RUNTIME_DUAL_CORE) owns MQTT,
+// the log drain, uploads and dashboard requests. Results cross over as
+// fixed-size records through one SPSC queue (spsc_queue.h).
+//
+// Back-pressure: the acquisition side never waits for the network.
+//  - telemetry and frames only take a slot while more than
+//    RUNTIME_QUEUE_RESERVE are free; state and alert records may use the reserve
+//  - a record that does not fit waits in a latest-wins slot of its kind and is
+//    retried on the next submit; a newer one replaces it (coalesced), taking
+//    over the telemetry values the older one was due to publish
+//  - a frame that does not fit, or beyond RUNTIME_FRAMES_IN_FLIGHT, goes back
+//    to the camera at once (dropped), keeping a buffer free for scoring
+//  - interval aggregates (one record per channel) are dropped if they do not fit
+
+enum RuntimeRecordKind : uint8_t {
+    RUNTIME_TELEMETRY = 1,
+    RUNTIME_STATE,
+    RUNTIME_ALERT,
+    RUNTIME_FRAME,
+    RUNTIME_STATS
+};
+
+struct RuntimeRecord {
+    uint8_t kind;
+    bool cleanNeeded;           // Alert
+    uint8_t channel;            // Stats (SensorChannel)
+    SystemMode mode;            // State
+    uint32_t seq;
+    uint32_t submittedAt;       // micros() at submit, for the queue latency
+    camera_fb_t* fb;            // Frame, returned by the network side
+    union {
+        SystemStatus status;    // Telemetry
+        StatsSummary stats;     // Stats
+    };
+    SensorBank bank;            // Telemetry, every channel
+    ReportMask due;             // Telemetry values to publish (report.h)
+};
+
+struct RuntimeStats {
+    uint32_t queued;
+    uint32_t processed;
+    uint32_t coalesced;         // Replaced in a latest-wins slot before it was queued
+    uint32_t framesDropped;
+    uint32_t statsDropped;      // Aggregates that found the queue full
+    uint32_t maxDepth;
+    uint32_t latencyMaxUs;      // Submit to handled by the network side
+    uint32_t latencyAvgUs;
+    uint32_t sampleJitterMaxMs; // Telemetry submits later than the mode's interval
+};
+
+// --- Acquisition side ---
+void runtimeSubmitTelemetry(const SystemStatus& status, const SensorBank& bank, const ReportMask& due);
+void runtimeSubmitState(SystemMode mode);
+void runtimeSubmitAlert(bool cleanNeeded);
+void runtimeSubmitStats(uint8_t channel, const StatsSummary& stats);
+// Takes the frame: uploaded and returned by the network side, or returned here
+void runtimeSubmitFrame(camera_fb_t* fb);
+// Queues what waits in the latest-wins slots, if there is room now
+void runtimeRetryPending();
+// A frame asked for on the dashboard since the last call (capture it and
+// runtimeSubmitFrame() it)
+bool runtimeTakeFrameRequest();
+// Everything submitted has been handled by the network side and the broker
+// has nothing waiting (mqttIdle()); before a deep sleep
+bool runtimeIdle();
+
+// --- Network side ---
+// Log drain, MQTT, dashboard requests, then the queued records
+void runtimeNetworkStep();
+
+// Starts the network task; false if it could not be created (run inline)
+bool runtimeStartNetworkTask();
+bool runtimeNetworkTaskRunning();
+// Asks the network task to return after its current step
+void runtimeStop();
+
+RuntimeStats runtimeStats();
+void runtimeResetStats();
+
+#endif
@@ -1,12 +1,28 @@
 #include "sensor_driver.h"
+#include "dust_sampler.h"
+#include <new>
 
-// Private global objects
-DHT dht(DHT_PIN, DHT_TYPE);
-BH1750 lightMeter(BH1750_ADDR);
+static const uint8_t defaultDhtPins[] = DHT_PINS;
+static const uint8_t defaultLuxAddrs[] = BH1750_ADDRS;
+static const uint8_t defaultDustLedPins[] = DUST_LED_PINS;
+static const uint8_t defaultDustVoPins[] = DUST_VO_PINS;
 
-// Buffer for moving average
-float dustReadings[DUST_SAMPLES];
-int dustIndex = 0;
+static_assert(sizeof(defaultDhtPins) <= SENSOR_MAX_CHANNELS && sizeof(defaultLuxAddrs) <= SENSOR_MAX_CHANNELS &&
+                  sizeof(defaultDustLedPins) <= SENSOR_MAX_CHANNELS,
+              "More sensors than SENSOR_MAX_CHANNELS");
+static_assert(sizeof(defaultDustLedPins) == sizeof(defaultDustVoPins), "DUST_LED_PINS and DUST_VO_PINS differ");
+
+static SensorLayout layout;
+
+#if !ENABLE_SIMULATOR
+// Private sensor objects: the DHT driver has no default constructor, so
+// they are built in place by initSensors()
+alignas(DHT) static uint8_t dhtStorage[SENSOR_MAX_CHANNELS][sizeof(DHT)];
+static BH1750 lightMeters[SENSOR_MAX_CHANNELS];
+static uint8_t dhtBuilt = 0;
+
+static DHT& dht(uint8_t i) { return *reinterpret_cast<DHT*>(dhtStorage[i]); }
+#endif
 
 // --- SIMULATION VARIABLES ---
 float simTemp = 25.0;
@@ -20,81 +36,132 @@ void setSimHum(float v) { simHum = v; }
 void setSimLux(float v) { simLux = v; }
 void setSimDust(float v) { simDust = v; }
 
-void initSensors() {
+const SensorLayout& sensorLayoutDefault() {
+    static SensorLayout def;
+    static bool built = false;
+    if (!built) {
+        memset(&def, 0, sizeof(def));
+        def.dht = sizeof(defaultDhtPins);
+        def.lux = sizeof(defaultLuxAddrs);
+        def.dust = sizeof(defaultDustLedPins);
+        memcpy(def.dhtPins, defaultDhtPins, def.dht);
+        memcpy(def.luxAddrs, defaultLuxAddrs, def.lux);
+        memcpy(def.dustLedPins, defaultDustLedPins, def.dust);
+        memcpy(def.dustVoPins, defaultDustVoPins, def.dust);
+        built = true;
+    }
+    return def;
+}
+
+static uint8_t clampCount(uint8_t n) {
+    if (n == 0) return 1;
+    return n > SENSOR_MAX_CHANNELS ? SENSOR_MAX_CHANNELS : n;
+}
+
+void initSensors(const SensorLayout& newLayout) {
+    layout = newLayout;
+    layout.dht = clampCount(layout.dht);
+    layout.lux = clampCount(layout.lux);
+    layout.dust = clampCount(layout.dust);
+
     #if !ENABLE_SIMULATOR
-        dht.begin();
+        for (uint8_t i = 0; i < layout.dht; i++) {
+            if (i < dhtBuilt) dht(i).~DHT();
+            new (dhtStorage[i]) DHT(layout.dhtPins[i], DHT_TYPE);
+            dht(i).begin();
+        }
+        if (layout.dht > dhtBuilt) dhtBuilt = layout.dht;
         
         Wire.setTimeOut(1000);
         Wire.begin(I2C_SDA_PIN, I2C_SCL_PIN);
         
-        if (lightMeter.begin(BH1750::CONTINUOUS_HIGH_RES_MODE)) {
-            Serial.println("✅ Sensors: BH1750 OK");
+        uint8_t luxOk = 0;
+        for (uint8_t i = 0; i < layout.lux; i++) {
+            lightMeters[i] = BH1750(layout.luxAddrs[i]);
+            if (lightMeters[i].begin(BH1750::CONTINUOUS_HIGH_RES_MODE)) luxOk++;
+        }
+        if (luxOk == layout.lux) {
+            Serial.printf("✅ Sensors: BH1750 OK (%u)\n", (unsigned)luxOk);
         } else {
-            Serial.println("❌ Sensors: BH1750 Failed");
+            Serial.printf("❌ Sensors: BH1750 Failed (%u of %u)\n", (unsigned)(layout.lux - luxOk), (unsigned)layout.lux);
         }
 
-        pinMode(DUST_LED_PIN, OUTPUT);
-        digitalWrite(DUST_LED_PIN, HIGH);
         analogReadResolution(12);
 
-        // Init dust buffer
-        for(int i=0; i<DUST_SAMPLES; i++) dustReadings[i] = 0;
+        // Dust is pulsed in the background from here on
+        if (!dustSamplerSetChannels(layout.dustLedPins, layout.dustVoPins, layout.dust) || !startDustSampler()) {
+            Serial.println("❌ Sensors: Dust sampler failed");
+        }
     #else
         Serial.println("⚠️ SIMULATION MODE ENABLED: Hardware ignored");
         Serial.println("   Use Serial Commands: set dust X, set lux X, etc.");
     #endif
 }
 
-float readTemperature() {
-    #if ENABLE_SIMULATOR
-        return simTemp;
-    #else
-        return dht.readTemperature();
-    #endif
+uint8_t sensorChannels() {
+    uint8_t n = layout.dht > layout.lux ? layout.dht : layout.lux;
+    n = n > layout.dust ? n : layout.dust;
+    return n ? n : 1;
 }
 
-float readHumidity() {
-    #if ENABLE_SIMULATOR
-        return simHum;
-    #else
-        return dht.readHumidity();
-    #endif
+void sensorBankReset(SensorBank* bank) {
+    bank->channels = sensorChannels();
+    for (uint8_t i = 0; i < SENSOR_MAX_CHANNELS; i++) {
+        bank->temp[i] = NAN;
+        bank->humidity[i] = NAN;
+        bank->lux[i] = NAN;
+        bank->dust[i] = NAN;
+    }
 }
 
-float readLightLevel() {
-    #if ENABLE_SIMULATOR
-        return simLux;
-    #else
-        float lux = lightMeter.readLightLevel();
-        return (lux < 0) ? 0 : lux;
-    #endif
+// Channels past the last sensor of a type share it
+static void repeatLast(float* values, uint8_t sensors, uint8_t channels) {
+    for (uint8_t i = sensors; i < channels; i++) values[i] = values[sensors - 1];
 }
 
-float readDustSensorSmooth() {
-    #if ENABLE_SIMULATOR
-        return simDust;
-    #else
-        // 1. Raw Read
-        digitalWrite(DUST_LED_PIN, LOW); 
-        delayMicroseconds(280);          
-        int adc = analogRead(DUST_VO_PIN); 
-        delayMicroseconds(40);
-        digitalWrite(DUST_LED_PIN, HIGH); 
-        delayMicroseconds(9680);
-        
-        float voltage = adc * (3.3 / 4095.0);
-        if (voltage < 0.1) voltage = 0.1;
-        
-        float rawDensity = (0.17 * voltage - 0.1) * 1000 * DUST_CALIB;
-        if (rawDensity < 0) rawDensity = 0;
+float readLightLevels(SensorBank* bank) {
+    uint8_t n = layout.lux < bank->channels ? layout.lux : bank->channels;
+    for (uint8_t i = 0; i < n; i++) {
+        #if ENABLE_SIMULATOR
+            bank->lux[i] = simLux;
+        #else
+            float lux = lightMeters[i].readLightLevel();
+            bank->lux[i] = (lux < 0) ? 0 : lux;
+        #endif
+    }
+    repeatLast(bank->lux, n, bank->channels);
+    return channelMax(bank->lux, bank->channels);
+}
 
-        // 2. Moving Average Logic
-        dustReadings[dustIndex] = rawDensity;
-        dustIndex = (dustIndex + 1) % DUST_SAMPLES;
+void readClimate(SensorBank* bank) {
+    uint8_t n = layout.dht < bank->channels ? layout.dht : bank->channels;
+    for (uint8_t i = 0; i < n; i++) {
+        #if ENABLE_SIMULATOR
+            bank->temp[i] = simTemp;
+            bank->humidity[i] = simHum;
+        #else
+            bank->temp[i] = dht(i).readTemperature();
+            bank->humidity[i] = dht(i).readHumidity();
+        #endif
+    }
+    repeatLast(bank->temp, n, bank->channels);
+    repeatLast(bank->humidity, n, bank->channels);
+}
 
-        float sum = 0;
-        for (int i = 0; i < DUST_SAMPLES; i++) sum += dustReadings[i];
-        
-        return sum / DUST_SAMPLES;
+void readDustLevels(SensorBank* bank) {
+    uint8_t n = layout.dust < bank->channels ? layout.dust : bank->channels;
+    #if ENABLE_SIMULATOR
+        for (uint8_t i = 0; i < n; i++) bank->dust[i] = simDust;
+    #else
+        // Windows still filling (just started): a few pulse periods at most
+        unsigned long start = millis();
+        unsigned long waitMs = (DUST_MIN_READS + 2) * 1000UL / DUST_SAMPLE_HZ;
+        uint32_t needed = (uint32_t)DUST_MIN_READS * layout.dust;
+        while (dustSamplerStats().samples < needed && millis() - start < waitMs) delay(1);
+        for (uint8_t i = 0; i < n; i++) {
+            DustReading dust;
+            bank->dust[i] = readDust(&dust, i) ? dust.filtered : NAN;
+        }
     #endif
-}
\ No newline at end of file
+    repeatLast(bank->dust, n, bank->channels);
+}
@@ -6,26 +6,44 @@
 #include <BH1750.h>
 #include <Wire.h>
 #include "config.h"
+#include "core.h"
+
+// Sensors of each type, channel order (config.h: DHT_PINS, BH1750_ADDRS,
+// DUST_LED_PINS / DUST_VO_PINS)
+struct SensorLayout {
+    uint8_t dht;
+    uint8_t lux;
+    uint8_t dust;
+    uint8_t dhtPins[SENSOR_MAX_CHANNELS];
+    uint8_t luxAddrs[SENSOR_MAX_CHANNELS];
+    uint8_t dustLedPins[SENSOR_MAX_CHANNELS];
+    uint8_t dustVoPins[SENSOR_MAX_CHANNELS];
+};
+
+const SensorLayout& sensorLayoutDefault();
 
 // Initializes all sensors (DHT, I2C, Light, Dust Pins)
-void initSensors();
+void initSensors(const SensorLayout& layout = sensorLayoutDefault());
 
-// Wrapper to read temperature safely (returns NaN on error)
-float readTemperature();
+// Channels of a SensorBank: the largest sensor count of any type
+uint8_t sensorChannels();
 
-// Wrapper to read humidity safely
-float readHumidity();
+// Sets the channel count, every value NaN
+void sensorBankReset(SensorBank* bank);
 
-// Wrapper to read light intensity
-float readLightLevel();
+// Each reader fills its arrays for every channel (NaN on error). Returns
+// the brightest channel, which decides the mode.
+float readLightLevels(SensorBank* bank);
+void readClimate(SensorBank* bank);
+// Outlier-rejected mean of the background dust sampler (dust_sampler.h),
+// per sensor. Does not block once the sampler has DUST_MIN_READS reads per
+// sensor (it waits for them right after start-up, e.g. a wake-up).
+void readDustLevels(SensorBank* bank);
 
-// Complex function: Handles LED switching, timing, ADC reading, and smoothing
-float readDustSensorSmooth();
-
-// Simulation Setters (Used by Serial Command parser)
+// Simulation Setters (Used by Serial Command parser), every channel
 void setSimTemp(float v);
 void setSimHum(float v);
 void setSimLux(float v);
 void setSimDust(float v);
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,57 @@
+#include "sensor_stats.h"
+
+static ChannelStats channels[SENSOR_CHANNELS] = {
+    ChannelStats(STATS_EMA_ALPHA), ChannelStats(STATS_EMA_ALPHA), ChannelStats(STATS_EMA_ALPHA),
+    ChannelStats(STATS_EMA_ALPHA), ChannelStats(STATS_EMA_ALPHA), ChannelStats(STATS_EMA_ALPHA)};
+
+struct ChannelInfo {
+    const char* topic;
+    uint8_t decimals;
+};
+
+// Same resolution as the per-metric telemetry
+static const ChannelInfo info[SENSOR_CHANNELS] = {
+    {MQTT_TOPIC(TOPIC_TEMP TOPIC_STATS), 1},
+    {MQTT_TOPIC(TOPIC_HUM TOPIC_STATS), 1},
+    {MQTT_TOPIC(TOPIC_LUX TOPIC_STATS), 0},
+    {MQTT_TOPIC(TOPIC_DUST TOPIC_STATS), 0},
+    {MQTT_TOPIC(TOPIC_EFFICIENCY TOPIC_STATS), 1},
+    {MQTT_TOPIC(TOPIC_SOILING TOPIC_STATS), 0},
+};
+
+void sensorStatsAdd(uint8_t channel, float value) {
+    if (channel < SENSOR_CHANNELS) channels[channel].add(value);
+}
+
+void sensorStatsAddAll(uint8_t channel, const float* values, uint8_t n) {
+    if (channel >= SENSOR_CHANNELS) return;
+    ChannelStats& stats = channels[channel];
+    for (uint8_t i = 0; i < n; i++) stats.add(values[i]);
+}
+
+void sensorStatsAddStatus(const SystemStatus& status, const SensorBank& bank) {
+    sensorStatsAddAll(CH_TEMP, bank.temp, bank.channels);
+    sensorStatsAddAll(CH_HUMIDITY, bank.humidity, bank.channels);
+    sensorStatsAddAll(CH_DUST, bank.dust, bank.channels);
+    channels[CH_EFFICIENCY].add(status.efficiency);
+    channels[CH_SOILING].add(status.soiling);
+}
+
+bool sensorStatsSummary(uint8_t channel, StatsSummary* out) {
+    if (channel >= SENSOR_CHANNELS || channels[channel].count() == 0) return false;
+    channels[channel].summary(out);
+    return true;
+}
+
+void sensorStatsResetInterval() {
+    for (int i = 0; i < SENSOR_CHANNELS; i++) channels[i].reset();
+}
+
+// ChannelStats is plain data (floats and counters)
+void sensorStatsSave(uint8_t* out) { memcpy(out, (const void*)channels, SENSOR_STATS_STATE_SIZE); }
+
+void sensorStatsRestore(const uint8_t* in) { memcpy((void*)channels, in, SENSOR_STATS_STATE_SIZE); }
+
+const char* sensorStatsTopic(uint8_t channel) { return channel < SENSOR_CHANNELS ? info[channel].topic : ""; }
+
+uint8_t sensorStatsDecimals(uint8_t channel) { return channel < SENSOR_CHANNELS ? info[channel].decimals : 1; }
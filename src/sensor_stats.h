@@ -0,0 +1,45 @@
+#ifndef SENSOR_STATS_H
+#define SENSOR_STATS_H
+
+#include <Arduino.h>
+#include "config.h"
+#include "core.h"
+#include "stream_stats.h"
+
+// Interval aggregates of every SystemStatus channel (stream_stats.h). loop()
+// feeds lux on every pass, temperature / humidity / dust every
+// STATS_SAMPLE_MS during the day and the rest of the status at each cycle.
+// Every STATS_REPORT_CYCLES cycles the summaries are published on
+// "<metric topic>/stats" and the interval restarts.
+
+enum SensorChannel : uint8_t {
+    CH_TEMP,
+    CH_HUMIDITY,
+    CH_LUX,
+    CH_DUST,
+    CH_EFFICIENCY,
+    CH_SOILING,
+    SENSOR_CHANNELS
+};
+
+void sensorStatsAdd(uint8_t channel, float value);
+// One value per sensor (SensorBank array): with several sensors the
+// interval covers all of them
+void sensorStatsAddAll(uint8_t channel, const float* values, uint8_t n);
+// Every measured field except lux (fed on every pass); temperature,
+// humidity and dust from every sensor in `bank`
+void sensorStatsAddStatus(const SystemStatus& status, const SensorBank& bank);
+// False if the channel has no sample this interval
+bool sensorStatsSummary(uint8_t channel, StatsSummary* out);
+void sensorStatsResetInterval();
+
+// Interval in progress as raw bytes, for RTC memory across deep sleep
+#define SENSOR_STATS_STATE_SIZE (SENSOR_CHANNELS * sizeof(ChannelStats))
+void sensorStatsSave(uint8_t* out);
+void sensorStatsRestore(const uint8_t* in);
+
+// Full MQTT topic of the channel's aggregates, and decimals to publish
+const char* sensorStatsTopic(uint8_t channel);
+uint8_t sensorStatsDecimals(uint8_t channel);
+
+#endif
@@ -0,0 +1,184 @@
+#include "serial_commands.h"
+#include "checksum.h"
+#include "core.h"
+#include "logger.h"
+#include "sensor_driver.h"
+#include <stdlib.h>
+#include <string.h>
+
+// --- Command table ---
+// A command is its name, then one number. New ones are a row here.
+struct SerialCommand {
+    const char* name;
+    const char* label;          // For the reply (static: the logger keeps the pointer)
+    void (*apply)(float value);
+    bool integer;
+};
+
+static void setDays(float value) { setDaysSinceClean((int)value); }
+
+static const SerialCommand COMMANDS[] = {
+    {"set dust", "Dust", setSimDust, false},
+    {"set lux", "Lux", setSimLux, false},
+    {"set hum", "Humidity", setSimHum, false},
+    {"set temp", "Temperature", setSimTemp, false},
+    {"set days", "Days since clean", setDays, true},
+};
+
+enum ParseState : uint8_t { PARSE_LINE, PARSE_DISCARD, PARSE_FRAME };
+
+static ParseState state = PARSE_LINE;
+static char line[SERIAL_CMD_LINE_MAX + 1];
+static uint8_t lineLen = 0;
+static uint8_t frame[3 + SERIAL_FRAME_MAX_PAYLOAD + 4];
+static uint8_t frameLen = 0;
+static SerialCommandStats stats = {};
+
+static void unknownCommand() {
+    stats.unknown++;
+    LOG_WARN("Unknown command. Use: set dust X, set lux X, set hum X, set temp X, set days X, stats");
+}
+
+static void runLine() {
+    line[lineLen] = 0;
+    char* cmd = line;
+    while (*cmd == ' ' || *cmd == '\t') cmd++;
+    char* end = line + lineLen;
+    while (end > cmd && (end[-1] == ' ' || end[-1] == '\t')) *--end = 0;
+    if (!*cmd) return;
+
+    if (strcmp(cmd, "stats") == 0) {
+        stats.lines++;
+        LOG_INFO("CMD: %u lines, %u unknown, %u too long", (unsigned)stats.lines, (unsigned)stats.unknown,
+                 (unsigned)stats.overflows);
+        LOG_INFO("CMD: %u frames, %u bad", (unsigned)stats.frames, (unsigned)stats.badFrames);
+        return;
+    }
+    for (size_t i = 0; i < sizeof(COMMANDS) / sizeof(COMMANDS[0]); i++) {
+        const SerialCommand& c = COMMANDS[i];
+        size_t n = strlen(c.name);
+        if (strncmp(cmd, c.name, n) != 0 || cmd[n] != ' ') continue;
+        char* parsed;
+        float value = strtof(cmd + n + 1, &parsed);
+        if (parsed == cmd + n + 1 || *parsed) break;        // No number, or something after it
+        c.apply(value);
+        stats.lines++;
+        if (c.integer) LOG_INFO("CMD: %s set to %d", c.label, (int)value);
+        else LOG_INFO("CMD: %s set to %.1f", c.label, value);
+        return;
+    }
+    unknownCommand();
+}
+
+static float readFloat(const uint8_t* p) {
+    uint32_t bits = (uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24;
+    float value;
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+static void runFrame() {
+    uint8_t type = frame[1];
+    uint8_t len = frame[2];
+    const uint8_t* payload = frame + 3;
+    const uint8_t* c = payload + len;
+    uint32_t crc = (uint32_t)c[0] | (uint32_t)c[1] << 8 | (uint32_t)c[2] << 16 | (uint32_t)c[3] << 24;
+    if (crc != crc32(frame + 1, 2 + len)) {
+        stats.badFrames++;
+        return;
+    }
+    if (type == SERIAL_FRAME_SAMPLE && len == 16) {
+        float v[4];
+        for (uint8_t i = 0; i < 4; i++) v[i] = readFloat(payload + 4 * i);
+        if (!isnan(v[0])) setSimTemp(v[0]);
+        if (!isnan(v[1])) setSimHum(v[1]);
+        if (!isnan(v[2])) setSimLux(v[2]);
+        if (!isnan(v[3])) setSimDust(v[3]);
+    } else if (type == SERIAL_FRAME_DAYS && len == 4) {
+        setDaysSinceClean((int32_t)((uint32_t)payload[0] | (uint32_t)payload[1] << 8 | (uint32_t)payload[2] << 16 |
+                                    (uint32_t)payload[3] << 24));
+    } else {
+        stats.badFrames++;
+        return;
+    }
+    stats.frames++;
+}
+
+static void parseByte(uint8_t b) {
+    switch (state) {
+        case PARSE_LINE:
+            if (b == SERIAL_FRAME_SYNC && lineLen == 0) {
+                frame[0] = b;
+                frameLen = 1;
+                state = PARSE_FRAME;
+            } else if (b == '\n') {
+                runLine();
+                lineLen = 0;
+            } else if (b == '\r') {
+                // CRLF terminals
+            } else if (lineLen < SERIAL_CMD_LINE_MAX) {
+                line[lineLen++] = (char)b;
+            } else {
+                stats.overflows++;
+                state = PARSE_DISCARD;
+            }
+            break;
+        case PARSE_DISCARD:
+            if (b == '\n') {
+                LOG_WARN("CMD: line over %d characters dropped", SERIAL_CMD_LINE_MAX);
+                lineLen = 0;
+                state = PARSE_LINE;
+            }
+            break;
+        case PARSE_FRAME:
+            frame[frameLen++] = b;
+            if (frameLen == 3 && frame[2] > SERIAL_FRAME_MAX_PAYLOAD) {
+                stats.badFrames++;
+                state = PARSE_LINE;
+            } else if (frameLen > 3 && frameLen == SERIAL_FRAME_OVERHEAD + frame[2]) {
+                runFrame();
+                state = PARSE_LINE;
+            }
+            break;
+    }
+}
+
+void serialCommandsBegin() {
+    state = PARSE_LINE;
+    lineLen = 0;
+    frameLen = 0;
+    stats = SerialCommandStats();
+}
+
+void serialCommandsFeed(const uint8_t* data, size_t len) {
+    for (size_t i = 0; i < len; i++) parseByte(data[i]);
+}
+
+size_t serialCommandsPoll() {
+    uint8_t buf[64];
+    size_t taken = 0;
+    while (taken < SERIAL_CMD_POLL_BYTES) {
+        int ready = Serial.available();
+        if (ready <= 0) break;
+        size_t n = (size_t)ready < sizeof(buf) ? (size_t)ready : sizeof(buf);
+        if (n > SERIAL_CMD_POLL_BYTES - taken) n = SERIAL_CMD_POLL_BYTES - taken;
+        n = Serial.readBytes(buf, n);       // Already buffered: returns at once
+        if (n == 0) break;
+        serialCommandsFeed(buf, n);
+        taken += n;
+    }
+    return taken;
+}
+
+const SerialCommandStats& serialCommandStats() { return stats; }
+
+size_t serialFrameEncode(uint8_t type, const uint8_t* payload, uint8_t len, uint8_t* out) {
+    if (len > SERIAL_FRAME_MAX_PAYLOAD) return 0;
+    out[0] = SERIAL_FRAME_SYNC;
+    out[1] = type;
+    out[2] = len;
+    memcpy(out + 3, payload, len);
+    uint32_t crc = crc32(out + 1, 2 + len);
+    for (uint8_t i = 0; i < 4; i++) out[3 + len + i] = (uint8_t)(crc >> (8 * i));
+    return SERIAL_FRAME_OVERHEAD + len;
+}
@@ -0,0 +1,60 @@
+#ifndef SERIAL_COMMANDS_H
+#define SERIAL_COMMANDS_H
+
+#include <Arduino.h>
+#include "config.h"
+
+// Serial command channel for the simulator hooks (setSim*, setDaysSinceClean).
+// serialCommandsPoll() takes whatever bytes the UART already holds (at most
+// SERIAL_CMD_POLL_BYTES), never waits for the rest of a line, and keeps no
+// String: a partial line or frame stays in a fixed buffer until the next pass.
+//
+// Text: one command per line ('\n', '\r' ignored), looked up in a table:
+//
+//   set dust X | set lux X | set hum X | set temp X | set days N | stats
+//
+// Binary, for hardware-in-the-loop rigs pushing sample vectors: a frame
+// starts with SERIAL_FRAME_SYNC where a line would start (never a text byte)
+//
+//   off size field
+//    0   1   SERIAL_FRAME_SYNC
+//    1   1   type (SERIAL_FRAME_*)
+//    2   1   payload length (n)
+//    3   n   payload
+//  3+n   4   CRC-32 of bytes 1..2+n, little-endian
+//
+//   SERIAL_FRAME_SAMPLE  temp, humidity, lux, dust: float32 LE each, NaN =
+//                        leave as is. Applied silently (counted), so
+//                        thousands per second do not flood the log.
+//   SERIAL_FRAME_DAYS    days since clean, int32 LE
+//
+// A frame with a bad CRC, type or length is dropped and counted; the parser
+// goes back to looking for a line or a sync byte.
+
+#define SERIAL_FRAME_SYNC    0xA5
+#define SERIAL_FRAME_SAMPLE  0x01
+#define SERIAL_FRAME_DAYS    0x02
+#define SERIAL_FRAME_MAX_PAYLOAD 16
+#define SERIAL_FRAME_OVERHEAD 7          // Sync, type, length, CRC
+
+struct SerialCommandStats {
+    uint32_t lines;             // Text commands run
+    uint32_t unknown;           // Lines not in the table or with a bad value
+    uint32_t overflows;         // Lines over SERIAL_CMD_LINE_MAX, dropped
+    uint32_t frames;            // Binary frames applied
+    uint32_t badFrames;
+};
+
+// At boot: no partial line or frame, counters to zero
+void serialCommandsBegin();
+// From loop(): handles the bytes that have arrived. Returns how many it took.
+size_t serialCommandsPoll();
+// Feeds bytes from elsewhere (tests, another transport)
+void serialCommandsFeed(const uint8_t* data, size_t len);
+const SerialCommandStats& serialCommandStats();
+
+// Builds a binary frame into out (SERIAL_FRAME_OVERHEAD + len bytes), for
+// host tools and tests. Returns its size, 0 if the payload is too long.
+size_t serialFrameEncode(uint8_t type, const uint8_t* payload, uint8_t len, uint8_t* out);
+
+#endif
@@ -0,0 +1,245 @@
+#include "series_codec.h"
+#include <string.h>
+
+static const uint32_t QUIET_NAN = 0x7FC00000;
+
+static void putU16(uint8_t* p, uint16_t v) {
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+}
+
+static void putU32(uint8_t* p, uint32_t v) {
+    putU16(p, (uint16_t)v);
+    putU16(p + 2, (uint16_t)(v >> 16));
+}
+
+static uint16_t getU16(const uint8_t* p) { return (uint16_t)(p[0] | (p[1] << 8)); }
+
+static uint32_t getU32(const uint8_t* p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static uint32_t floatBits(float v) {
+    if (v != v) return QUIET_NAN;
+    uint32_t bits;
+    memcpy(&bits, &v, sizeof(bits));
+    return bits;
+}
+
+static int leadingZeros(uint32_t x) { return x ? __builtin_clz(x) : 32; }
+static int trailingZeros(uint32_t x) { return x ? __builtin_ctz(x) : 32; }
+
+// ============================================================================
+// ENCODER
+// ============================================================================
+
+// n <= 32 bits of `value`, most significant first; the buffer is zeroed
+static void writeBits(SeriesEncoder* enc, uint32_t value, int n) {
+    uint8_t* p = enc->out + SERIES_HEADER_SIZE;
+    while (n > 0) {
+        size_t byte = enc->bits >> 3;
+        int free = 8 - (int)(enc->bits & 7);
+        int take = n < free ? n : free;
+        uint32_t chunk = (value >> (n - take)) & ((1u << take) - 1);
+        p[byte] |= (uint8_t)(chunk << (free - take));
+        enc->bits += take;
+        n -= take;
+    }
+}
+
+static void writeTimestamp(SeriesEncoder* enc, int32_t dod) {
+    if (dod == 0) {
+        writeBits(enc, 0, 1);
+    } else if (dod >= -63 && dod <= 64) {
+        writeBits(enc, 0x2, 2);
+        writeBits(enc, (uint32_t)(dod + 63), 7);
+    } else if (dod >= -255 && dod <= 256) {
+        writeBits(enc, 0x6, 3);
+        writeBits(enc, (uint32_t)(dod + 255), 9);
+    } else if (dod >= -2047 && dod <= 2048) {
+        writeBits(enc, 0xE, 4);
+        writeBits(enc, (uint32_t)(dod + 2047), 12);
+    } else {
+        writeBits(enc, 0xF, 4);
+        writeBits(enc, (uint32_t)dod, 32);
+    }
+}
+
+static void writeValue(SeriesEncoder* enc, SeriesColumn* c, uint32_t bits) {
+    uint32_t x = bits ^ c->bits;
+    c->bits = bits;
+    if (!x) {
+        writeBits(enc, 0, 1);
+        return;
+    }
+    int lead = leadingZeros(x);
+    int trail = trailingZeros(x);
+    if (lead > 31) lead = 31;
+    if (c->width && lead >= c->lead && 32 - c->lead - c->width <= trail) {
+        // Fits the previous window
+        writeBits(enc, 0x2, 2);
+        writeBits(enc, x >> (32 - c->lead - c->width), c->width);
+        return;
+    }
+    int width = 32 - lead - trail;
+    writeBits(enc, 0x3, 2);
+    writeBits(enc, (uint32_t)lead, 5);
+    writeBits(enc, (uint32_t)(width - 1), 5);
+    writeBits(enc, x >> trail, width);
+    c->lead = (uint8_t)lead;
+    c->width = (uint8_t)width;
+}
+
+bool seriesBegin(SeriesEncoder* enc, uint8_t* out, size_t size, uint8_t columns, uint8_t flags, uint32_t seq) {
+    if (size < SERIES_HEADER_SIZE || columns > SERIES_MAX_COLUMNS) return false;
+    memset(enc, 0, sizeof(*enc));
+    enc->out = out;
+    enc->size = size;
+    enc->columns = columns;
+    memset(out, 0, size);
+    out[0] = SERIES_VERSION;
+    out[1] = flags;
+    out[2] = columns;
+    putU32(out + 4, seq);
+    return true;
+}
+
+bool seriesAppend(SeriesEncoder* enc, uint32_t timestamp, uint8_t mode, const float* values) {
+    // Worst case: 36 timestamp bits, 4 mode bits, 44 bits per column
+    size_t worst = 40 + 44 * (size_t)enc->columns;
+    if (SERIES_HEADER_SIZE * 8 + enc->bits + worst > enc->size * 8) return false;
+
+    if (enc->count == 0) {
+        putU32(enc->out + 8, timestamp);
+        enc->out[3] = mode;
+        for (uint8_t i = 0; i < enc->columns; i++) {
+            enc->col[i].bits = floatBits(values[i]);
+            writeBits(enc, enc->col[i].bits, 32);
+        }
+    } else {
+        if (timestamp < enc->timestamp || timestamp - enc->timestamp > 0x7FFFFFFF) return false;
+        int32_t delta = (int32_t)(timestamp - enc->timestamp);
+        writeTimestamp(enc, delta - enc->delta);
+        enc->delta = delta;
+        if (mode == enc->mode) {
+            writeBits(enc, 0, 1);
+        } else {
+            writeBits(enc, 1, 1);
+            writeBits(enc, mode & 0x7, 3);
+        }
+        for (uint8_t i = 0; i < enc->columns; i++) writeValue(enc, &enc->col[i], floatBits(values[i]));
+    }
+    enc->timestamp = timestamp;
+    enc->mode = mode;
+    enc->count++;
+    return true;
+}
+
+size_t seriesFinish(SeriesEncoder* enc) {
+    if (!enc->count) return 0;
+    putU16(enc->out + 12, enc->count);
+    return SERIES_HEADER_SIZE + (enc->bits + 7) / 8;
+}
+
+// ============================================================================
+// DECODER
+// ============================================================================
+
+static bool readBits(SeriesDecoder* dec, int n, uint32_t* value) {
+    size_t avail = (dec->len - SERIES_HEADER_SIZE) * 8;
+    if (dec->bit + n > avail) return false;
+    const uint8_t* p = dec->data + SERIES_HEADER_SIZE;
+    uint32_t v = 0;
+    while (n > 0) {
+        size_t byte = dec->bit >> 3;
+        int left = 8 - (int)(dec->bit & 7);
+        int take = n < left ? n : left;
+        v = (v << take) | ((p[byte] >> (left - take)) & ((1u << take) - 1));
+        dec->bit += take;
+        n -= take;
+    }
+    *value = v;
+    return true;
+}
+
+static bool readTimestamp(SeriesDecoder* dec, int32_t* dod) {
+    uint32_t bit, v;
+    int prefix = 0;
+    while (prefix < 4) {
+        if (!readBits(dec, 1, &bit)) return false;
+        if (!bit) break;
+        prefix++;
+    }
+    switch (prefix) {
+        case 0: *dod = 0; return true;
+        case 1: if (!readBits(dec, 7, &v)) return false; *dod = (int32_t)v - 63; return true;
+        case 2: if (!readBits(dec, 9, &v)) return false; *dod = (int32_t)v - 255; return true;
+        case 3: if (!readBits(dec, 12, &v)) return false; *dod = (int32_t)v - 2047; return true;
+        default: if (!readBits(dec, 32, &v)) return false; *dod = (int32_t)v; return true;
+    }
+}
+
+static bool readValue(SeriesDecoder* dec, SeriesColumn* c) {
+    uint32_t bit, x;
+    if (!readBits(dec, 1, &bit)) return false;
+    if (!bit) return true;
+    if (!readBits(dec, 1, &bit)) return false;
+    if (bit) {
+        uint32_t lead, width;
+        if (!readBits(dec, 5, &lead) || !readBits(dec, 5, &width)) return false;
+        width++;
+        if (lead + width > 32) return false;
+        c->lead = (uint8_t)lead;
+        c->width = (uint8_t)width;
+    } else if (!c->width) {
+        return false;           // No window yet
+    }
+    if (!readBits(dec, c->width, &x)) return false;
+    c->bits ^= x << (32 - c->lead - c->width);
+    return true;
+}
+
+bool seriesDecodeBegin(SeriesDecoder* dec, const uint8_t* data, size_t len) {
+    if (len < SERIES_HEADER_SIZE || data[0] != SERIES_VERSION || data[2] > SERIES_MAX_COLUMNS) return false;
+    memset(dec, 0, sizeof(*dec));
+    dec->header.version = data[0];
+    dec->header.flags = data[1];
+    dec->header.columns = data[2];
+    dec->header.seq = getU32(data + 4);
+    dec->header.start = getU32(data + 8);
+    dec->header.count = getU16(data + 12);
+    dec->data = data;
+    dec->len = len;
+    dec->mode = data[3];
+    dec->timestamp = dec->header.start;
+    return true;
+}
+
+bool seriesDecodeNext(SeriesDecoder* dec, uint32_t* timestamp, uint8_t* mode, float* values) {
+    if (dec->index >= dec->header.count) return false;
+    uint8_t columns = dec->header.columns;
+    if (dec->index == 0) {
+        for (uint8_t i = 0; i < columns; i++) {
+            if (!readBits(dec, 32, &dec->col[i].bits)) return false;
+        }
+    } else {
+        int32_t dod;
+        uint32_t changed, m;
+        if (!readTimestamp(dec, &dod)) return false;
+        dec->delta += dod;
+        dec->timestamp += (uint32_t)dec->delta;
+        if (!readBits(dec, 1, &changed)) return false;
+        if (changed) {
+            if (!readBits(dec, 3, &m)) return false;
+            dec->mode = (uint8_t)m;
+        }
+        for (uint8_t i = 0; i < columns; i++) {
+            if (!readValue(dec, &dec->col[i])) return false;
+        }
+    }
+    for (uint8_t i = 0; i < columns; i++) memcpy(&values[i], &dec->col[i].bits, sizeof(float));
+    *timestamp = dec->timestamp;
+    *mode = dec->mode;
+    dec->index++;
+    return true;
+}
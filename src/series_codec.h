@@ -0,0 +1,105 @@
+#ifndef SERIES_CODEC_H
+#define SERIES_CODEC_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Compressed batch of samples (Gorilla-style): one timestamp, one mode and a
+// fixed set of float columns per sample. No Arduino dependency, so the
+// decoder builds as is on the server side.
+//
+// Header, little-endian, SERIES_HEADER_SIZE bytes:
+//
+//   off size field
+//    0   1   version (SERIES_VERSION)
+//    1   1   flags (SERIES_FLAG_*)
+//    2   1   columns per sample
+//    3   1   mode of the first sample
+//    4   4   batch sequence number
+//    8   4   timestamp of the first sample (epoch seconds, or uptime)
+//   12   2   sample count
+//   14   2   reserved (0)
+//
+// Then one bit stream, most significant bit first, sample after sample:
+//
+//   timestamp   (from the second sample) delta-of-delta d, the first delta
+//               taken against 0:
+//                 '0' d = 0, '10' + 7 bits, '110' + 9 bits, '1110' + 12 bits
+//                 (d + 63 / 255 / 2047), '1111' + 32 bits (d as int32)
+//   mode        (from the second sample) '0' unchanged, '1' + 3 bits
+//   each column first sample: the 32 float bits. Then x = bits XOR previous:
+//                 '0' x = 0
+//                 '10' + the meaningful bits of x in the previous window
+//                 '11' + 5 bits leading zeros + 5 bits (length - 1) + length bits
+//
+// NaN is stored as the quiet NaN 0x7FC00000 whatever its payload.
+
+#define SERIES_VERSION       1
+#define SERIES_HEADER_SIZE   16
+#define SERIES_MAX_COLUMNS   72
+#define SERIES_FLAG_UPTIME   0x01   // Timestamps are uptime seconds (clock not synced)
+
+struct SeriesColumn {
+    uint32_t bits;              // Previous value
+    uint8_t lead;               // Window of the last XOR written with one
+    uint8_t width;              // 0 = none yet
+};
+
+// Writer state. Plain data: it can live in RTC memory with its buffer.
+struct SeriesEncoder {
+    uint8_t* out;
+    size_t size;
+    size_t bits;                // Written after the header
+    uint16_t count;
+    uint8_t columns;
+    uint8_t mode;
+    uint32_t timestamp;
+    int32_t delta;
+    SeriesColumn col[SERIES_MAX_COLUMNS];
+};
+
+// Starts an empty batch in `out` (at least SERIES_HEADER_SIZE bytes)
+bool seriesBegin(SeriesEncoder* enc, uint8_t* out, size_t size, uint8_t columns, uint8_t flags, uint32_t seq);
+// False, with nothing written, if the sample might not fit or its timestamp
+// is before the previous one: finish this batch and start another
+bool seriesAppend(SeriesEncoder* enc, uint32_t timestamp, uint8_t mode, const float* values);
+// Completes the header; returns the payload length (0 for an empty batch)
+size_t seriesFinish(SeriesEncoder* enc);
+
+// Snaps a value to a multiple of `step` (0 = unchanged). With a power-of-two
+// step the low mantissa bits are zero, which keeps the XORs short.
+inline float seriesQuantize(float value, float step) {
+    if (step <= 0 || value != value) return value;
+    float q = (float)(int32_t)(value / step + (value < 0 ? -0.5f : 0.5f));
+    return q * step;
+}
+
+// --- Decoder ---
+struct SeriesHeader {
+    uint8_t version;
+    uint8_t flags;
+    uint8_t columns;
+    uint32_t seq;
+    uint32_t start;
+    uint16_t count;
+};
+
+struct SeriesDecoder {
+    SeriesHeader header;
+    const uint8_t* data;
+    size_t len;
+    size_t bit;                 // Read position after the header
+    uint16_t index;
+    uint8_t mode;
+    uint32_t timestamp;
+    int32_t delta;
+    SeriesColumn col[SERIES_MAX_COLUMNS];
+};
+
+// False on a short buffer, an unknown version or too many columns
+bool seriesDecodeBegin(SeriesDecoder* dec, const uint8_t* data, size_t len);
+// Next sample into `values` (header.columns floats); false after the last
+// one or on a truncated stream
+bool seriesDecodeNext(SeriesDecoder* dec, uint32_t* timestamp, uint8_t* mode, float* values);
+
+#endif
@@ -0,0 +1,160 @@
+#include "soiling.h"
+#include "esp_jpg_decode.h"
+
+// Kernels are branch-free loops over uint8 rows with uint16/uint32
+// accumulators and fixed strides: the host compiler vectorizes them, and on
+// the S3 the whole 4.8 KB grid is a few hundred microseconds of integer work.
+
+static uint8_t grayGrid[SOILING_GRID_W * SOILING_GRID_H];
+
+struct GrayDecoder {
+    uint8_t* pixels;
+    const uint8_t* jpeg;
+    size_t len;
+    uint16_t outW;      // Decoder output size
+    uint16_t outH;
+    uint8_t step;       // Output pixels per grid pixel (decimation)
+    uint16_t w;         // Grid size
+    uint16_t h;
+};
+
+static size_t readJpeg(void* arg, size_t index, uint8_t* buf, size_t len) {
+    GrayDecoder* d = (GrayDecoder*)arg;
+    if (index >= d->len) return 0;
+    if (len > d->len - index) len = d->len - index;
+    if (buf) memcpy(buf, d->jpeg + index, len);
+    return len;
+}
+
+// RGB888 blocks -> luma (BT.601, 8-bit fixed point), decimated to the grid
+static bool writeGray(void* arg, uint16_t x, uint16_t y, uint16_t w, uint16_t h, uint8_t* data) {
+    GrayDecoder* d = (GrayDecoder*)arg;
+    if (!data) {
+        if (x == 0 && y == 0) {
+            d->outW = w;
+            d->outH = h;
+            d->step = 1;
+            while (w / d->step > SOILING_GRID_W || h / d->step > SOILING_GRID_H) d->step++;
+            d->w = w / d->step;
+            d->h = h / d->step;
+        }
+        return true;
+    }
+    for (uint16_t row = 0; row < h; row++) {
+        uint16_t gy = (uint16_t)((y + row) / d->step);
+        if ((y + row) % d->step || gy >= d->h) continue;
+        const uint8_t* rgb = data + (size_t)row * w * 3;
+        uint8_t* out = d->pixels + (size_t)gy * d->w;
+        for (uint16_t col = 0; col < w; col++) {
+            uint16_t gx = (uint16_t)((x + col) / d->step);
+            if ((x + col) % d->step || gx >= d->w) continue;
+            const uint8_t* p = rgb + col * 3;
+            out[gx] = (uint8_t)((77 * p[0] + 150 * p[1] + 29 * p[2]) >> 8);
+        }
+    }
+    return true;
+}
+
+bool decodeGrayGrid(const uint8_t* jpeg, size_t len, uint8_t* pixels, GrayGrid* out) {
+    memset(out, 0, sizeof(*out));
+    if (!jpeg || len < 4) return false;
+    GrayDecoder d;
+    memset(&d, 0, sizeof(d));
+    d.pixels = pixels;
+    d.jpeg = jpeg;
+    d.len = len;
+    if (esp_jpg_decode(len, JPG_SCALE_8X, readJpeg, writeGray, &d) != ESP_OK || d.w < 8 || d.h < 8) {
+        return false;
+    }
+    out->pixels = pixels;
+    out->w = d.w;
+    out->h = d.h;
+    out->scale = (uint16_t)(8 * d.step);
+    return true;
+}
+
+bool scoreSoilingJpeg(const uint8_t* jpeg, size_t len, SoilingScore* out) {
+    memset(out, 0, sizeof(*out));
+    GrayGrid grid;
+    if (!decodeGrayGrid(jpeg, len, grayGrid, &grid)) return false;
+    scoreSoilingGray(grid.pixels, grid.w, grid.h, out);
+    return out->valid;
+}
+
+// 0 at `from`, 1 at `to` (either direction), clamped
+static inline float ramp(float v, float from, float to) {
+    float t = (v - from) / (to - from);
+    return t < 0 ? 0 : (t > 1 ? 1 : t);
+}
+
+void scoreSoilingGray(const uint8_t* gray, uint16_t w, uint16_t h, SoilingScore* out) {
+    memset(out, 0, sizeof(*out));
+    if (w < 8 || h < 8 || w > SOILING_GRID_W || h > SOILING_GRID_H) return;
+    const uint16_t bw = w / SOILING_BLOCKS_X;
+    const uint16_t bh = h / SOILING_BLOCKS_Y;
+    if (!bw || !bh) return;
+
+    // --- Block means: column sums per block row, then per block ---
+    uint32_t blockSum[SOILING_BLOCKS_X * SOILING_BLOCKS_Y];
+    uint16_t colSum[SOILING_GRID_W];
+    for (uint16_t by = 0; by < SOILING_BLOCKS_Y; by++) {
+        memset(colSum, 0, sizeof(colSum));
+        for (uint16_t y = by * bh; y < (by + 1) * bh; y++) {
+            const uint8_t* row = gray + (size_t)y * w;
+            for (uint16_t x = 0; x < w; x++) colSum[x] += row[x];
+        }
+        for (uint16_t bx = 0; bx < SOILING_BLOCKS_X; bx++) {
+            uint32_t sum = 0;
+            for (uint16_t x = bx * bw; x < (bx + 1) * bw; x++) sum += colSum[x];
+            blockSum[by * SOILING_BLOCKS_X + bx] = sum;
+        }
+    }
+    const uint32_t blockPixels = (uint32_t)bw * bh;
+    float mean = 0;
+    for (int i = 0; i < SOILING_BLOCKS_X * SOILING_BLOCKS_Y; i++) {
+        mean += (float)blockSum[i] / blockPixels;
+    }
+    mean /= SOILING_BLOCKS_X * SOILING_BLOCKS_Y;
+    float var = 0;
+    for (int i = 0; i < SOILING_BLOCKS_X * SOILING_BLOCKS_Y; i++) {
+        float dv = (float)blockSum[i] / blockPixels - mean;
+        var += dv * dv;
+    }
+    var /= SOILING_BLOCKS_X * SOILING_BLOCKS_Y;
+    if (mean < 1) mean = 1;
+
+    // --- Local contrast (|9p - 3x3 sum|) and spots (9p - 3x3 sum > 9 delta):
+    // a 1-3 pixel blob stands out from its neighbourhood on every side, a
+    // cell gap line only across it, so lines stay below the spot delta
+    // Three rolling rows of horizontal 3-sums
+    uint16_t hsum[3][SOILING_GRID_W];
+    uint32_t deviation = 0;
+    uint32_t spotCount = 0;
+    const int spotLimit = 9 * SOILING_SPOT_DELTA;
+    for (uint16_t y = 0; y < h; y++) {
+        const uint8_t* row = gray + (size_t)y * w;
+        uint16_t* hs = hsum[y % 3];
+        hs[0] = hs[w - 1] = 0;
+        for (uint16_t x = 1; x + 1 < w; x++) hs[x] = (uint16_t)(row[x - 1] + row[x] + row[x + 1]);
+        if (y < 2) continue;
+
+        const uint16_t* a = hsum[(y - 2) % 3];
+        const uint16_t* b = hsum[(y - 1) % 3];
+        const uint16_t* c = hs;
+        const uint8_t* mid = gray + (size_t)(y - 1) * w;
+        for (uint16_t x = 1; x + 1 < w; x++) {
+            int d = 9 * mid[x] - (a[x] + b[x] + c[x]);
+            deviation += (uint32_t)(d < 0 ? -d : d);
+            spotCount += d > spotLimit;
+        }
+    }
+    float localContrast = (float)deviation / (9.0f * (w - 2) * (h - 2)) / mean;
+    float spotFraction = (float)spotCount / ((float)(w - 2) * (h - 2));
+
+    out->uniformity = ramp(sqrtf(var), SOILING_UNIFORMITY_FLOOR, SOILING_UNIFORMITY_FULL);
+    out->haze = ramp(localContrast, SOILING_CONTRAST_CLEAN, SOILING_CONTRAST_DIRTY);
+    out->spots = ramp(spotFraction, SOILING_SPOT_FLOOR, SOILING_SPOT_FULL);
+    out->score = 100.0f * (SOILING_WEIGHT_UNIFORMITY * out->uniformity + SOILING_WEIGHT_HAZE * out->haze +
+                           SOILING_WEIGHT_SPOTS * out->spots);
+    out->valid = true;
+}
@@ -0,0 +1,46 @@
+#ifndef SOILING_H
+#define SOILING_H
+
+#include <Arduino.h>
+#include "config.h"
+
+// Panel soiling score from a camera JPEG. The frame is decoded at 1/8 scale
+// (DC coefficients only, so VGA costs about as much as entropy decoding) into a
+// SOILING_GRID_W x SOILING_GRID_H grayscale grid, then three measures are taken:
+//
+//   uniformity  spread of block brightness means (dust lies in patches)
+//   haze        mean deviation from the 3x3 neighbourhood over brightness,
+//               from SOILING_CONTRAST_CLEAN down to _DIRTY (film)
+//   spots       pixels more than SOILING_SPOT_DELTA above their 3x3
+//               neighbourhood mean (droppings, debris)
+//
+// Each is mapped to 0..1 and weighted into a 0..100 score.
+
+struct SoilingScore {
+    bool valid;         // False if the frame could not be decoded
+    float uniformity;
+    float haze;
+    float spots;
+    float score;
+};
+
+// 1/8-scale grayscale decode shared with the delta encoder (image_delta.h)
+struct GrayGrid {
+    const uint8_t* pixels;  // w * h, row-major, in the caller's buffer
+    uint16_t w;
+    uint16_t h;
+    uint16_t scale;         // Image pixels per grid pixel
+};
+
+// Decodes a frame into `pixels` (SOILING_GRID_W * SOILING_GRID_H bytes, no
+// heap). Each caller owns its buffer: scoring runs on the acquisition task,
+// delta encoding on the network task.
+bool decodeGrayGrid(const uint8_t* jpeg, size_t len, uint8_t* pixels, GrayGrid* out);
+
+// Decodes and scores one frame
+bool scoreSoilingJpeg(const uint8_t* jpeg, size_t len, SoilingScore* out);
+
+// Scores an already decoded grayscale grid (w, h up to the grid size)
+void scoreSoilingGray(const uint8_t* gray, uint16_t w, uint16_t h, SoilingScore* out);
+
+#endif
@@ -0,0 +1,61 @@
+#ifndef SPSC_QUEUE_H
+#define SPSC_QUEUE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <atomic>
+
+// Lock-free single-producer / single-consumer ring of fixed-size records.
+// One task pushes, one other task pops; neither blocks, locks or allocates.
+//
+// head and tail are free-running counters, each written by one side only:
+// the producer's release store of tail publishes the slot it just filled,
+// the consumer's release store of head hands the slot back. They live on
+// separate cache lines so the two cores do not bounce one line between them
+// on every operation.
+
+#define SPSC_CACHE_LINE 64
+
+template <typename T, uint32_t N>
+class SpscQueue {
+    static_assert(N >= 2 && (N & (N - 1)) == 0, "SpscQueue length must be a power of two");
+
+public:
+    SpscQueue() : tail(0), head(0) {}
+
+    // Producer side. False when full.
+    bool push(const T& item) {
+        uint32_t t = tail.load(std::memory_order_relaxed);
+        if (t - head.load(std::memory_order_acquire) == N) return false;
+        slots[t & (N - 1)] = item;
+        tail.store(t + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Consumer side. False when empty.
+    bool pop(T* item) {
+        uint32_t h = head.load(std::memory_order_relaxed);
+        if (tail.load(std::memory_order_acquire) == h) return false;
+        *item = slots[h & (N - 1)];
+        head.store(h + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Exact from either side for its own end: the producer may see fewer
+    // free slots than there are, the consumer fewer records, never more
+    uint32_t size() const {
+        uint32_t h = head.load(std::memory_order_acquire);
+        uint32_t n = tail.load(std::memory_order_acquire) - h;
+        return n > N ? N : n;
+    }
+
+    uint32_t freeSlots() const { return N - size(); }
+    static uint32_t capacity() { return N; }
+
+private:
+    alignas(SPSC_CACHE_LINE) std::atomic<uint32_t> tail;    // Written by the producer
+    alignas(SPSC_CACHE_LINE) std::atomic<uint32_t> head;    // Written by the consumer
+    alignas(SPSC_CACHE_LINE) T slots[N];
+};
+
+#endif
@@ -0,0 +1,137 @@
+#include "stream_stats.h"
+
+// ============================================================================
+// RUNNING MOMENTS (Welford: no catastrophic cancellation in float)
+// ============================================================================
+
+void RunningStats::reset() {
+    n = 0;
+    origin = 0;
+    m = 0;
+    m2 = 0;
+    lo = 0;
+    hi = 0;
+}
+
+void RunningStats::add(float x) {
+    if (isnan(x)) return;
+    if (n == 0) {
+        origin = x;
+        lo = x;
+        hi = x;
+    }
+    if (x < lo) lo = x;
+    if (x > hi) hi = x;
+    n++;
+    x -= origin;
+    float delta = x - m;
+    m += delta / n;
+    m2 += delta * (x - m);
+}
+
+float RunningStats::stddev() const { return sqrtf(variance()); }
+
+void Ema::add(float x) {
+    if (isnan(x)) return;
+    v = primed ? v + alpha * (x - v) : x;
+    primed = true;
+}
+
+// ============================================================================
+// P-SQUARE QUANTILE
+// ============================================================================
+
+void P2Quantile::add(float x) {
+    if (isnan(x)) return;
+    if (n == 0) origin = x;
+    x -= origin;
+    if (n < 5) {
+        // Insertion-sorted until the markers can be placed
+        int i = (int)n++;
+        for (; i > 0 && q[i - 1] > x; i--) q[i] = q[i - 1];
+        q[i] = x;
+        if (n == 5) {
+            for (int k = 0; k < 5; k++) pos[k] = k + 1;
+            want[0] = 1;
+            want[1] = 1 + 2 * p;
+            want[2] = 1 + 4 * p;
+            want[3] = 3 + 2 * p;
+            want[4] = 5;
+        }
+        return;
+    }
+
+    // Cell of x; the extreme markers follow the min and max
+    int k;
+    if (x < q[0]) {
+        q[0] = x;
+        k = 0;
+    } else if (x >= q[4]) {
+        q[4] = x;
+        k = 3;
+    } else {
+        k = 0;
+        while (k < 3 && x >= q[k + 1]) k++;
+    }
+    for (int i = k + 1; i < 5; i++) pos[i]++;
+    const float step[5] = {0, p / 2, p, (1 + p) / 2, 1};
+    for (int i = 0; i < 5; i++) want[i] += step[i];
+    n++;
+
+    // Move the middle markers towards their desired positions
+    for (int i = 1; i <= 3; i++) {
+        float d = want[i] - pos[i];
+        if ((d >= 1 && pos[i + 1] - pos[i] > 1) || (d <= -1 && pos[i - 1] - pos[i] < -1)) {
+            int s = d > 0 ? 1 : -1;
+            float below = (float)(pos[i] - pos[i - 1]);
+            float above = (float)(pos[i + 1] - pos[i]);
+            float parabolic = q[i] + (float)s / (pos[i + 1] - pos[i - 1]) *
+                              ((below + s) * (q[i + 1] - q[i]) / above + (above - s) * (q[i] - q[i - 1]) / below);
+            if (q[i - 1] < parabolic && parabolic < q[i + 1]) {
+                q[i] = parabolic;
+            } else {
+                q[i] += s * (q[i + s] - q[i]) / (pos[i + s] - pos[i]);
+            }
+            pos[i] += s;
+        }
+    }
+}
+
+float P2Quantile::value() const {
+    if (n == 0) return NAN;
+    if (n >= 5) return origin + q[2];
+    // Few samples: exact, interpolated between the sorted values
+    float at = p * (n - 1);
+    int i = (int)at;
+    if (i + 1 >= (int)n) return origin + q[n - 1];
+    return origin + q[i] + (at - i) * (q[i + 1] - q[i]);
+}
+
+// ============================================================================
+// CHANNEL
+// ============================================================================
+
+void ChannelStats::add(float x) {
+    if (isnan(x)) return;
+    moments.add(x);
+    median.add(x);
+    high.add(x);
+    smooth.add(x);
+}
+
+void ChannelStats::reset() {
+    moments.reset();
+    median.reset();
+    high.reset();
+}
+
+void ChannelStats::summary(StatsSummary* out) const {
+    out->count = moments.count();
+    out->mean = moments.mean();
+    out->std = moments.stddev();
+    out->min = moments.minimum();
+    out->max = moments.maximum();
+    out->p50 = median.value();
+    out->p95 = high.value();
+    out->ema = smooth.value();
+}
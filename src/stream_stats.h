@@ -0,0 +1,93 @@
+#ifndef STREAM_STATS_H
+#define STREAM_STATS_H
+
+#include <Arduino.h>
+
+// Incremental statistics: constant cost per sample and constant memory,
+// whatever the number of samples in the window. NaN samples are ignored.
+//
+//   RunningStats  count, mean, variance (Welford), min, max
+//   Ema           exponential moving average
+//   P2Quantile    streaming quantile estimate (Jain & Chlamtac P-square,
+//                 five markers; exact until the fifth sample)
+//   ChannelStats  all of the above for one channel: p50 and p95 over an
+//                 interval that is restarted by reset(), EMA across intervals
+
+class RunningStats {
+public:
+    RunningStats() { reset(); }
+    void reset();
+    void add(float x);
+    uint32_t count() const { return n; }
+    float mean() const { return n ? origin + m : NAN; }
+    float variance() const { return n > 1 ? m2 / (n - 1) : 0; }    // Sample variance
+    float stddev() const;
+    float minimum() const { return n ? lo : NAN; }
+    float maximum() const { return n ? hi : NAN; }
+
+private:
+    uint32_t n;
+    float origin;   // First sample: moments are kept around it for float precision
+    float m;
+    float m2;
+    float lo;
+    float hi;
+};
+
+class Ema {
+public:
+    explicit Ema(float alpha = 0.1f) : alpha(alpha), v(0), primed(false) {}
+    void reset() { primed = false; }
+    void add(float x);
+    float value() const { return primed ? v : NAN; }
+
+private:
+    float alpha;
+    float v;
+    bool primed;
+};
+
+class P2Quantile {
+public:
+    explicit P2Quantile(float p = 0.5f) : p(p) { reset(); }
+    void reset() { n = 0; }
+    void add(float x);
+    float value() const;
+
+private:
+    float p;
+    uint32_t n;
+    float origin;   // First sample; heights are kept relative to it
+    float q[5];     // Marker heights
+    int32_t pos[5]; // Actual marker positions (1-based)
+    float want[5];  // Desired positions
+};
+
+struct StatsSummary {
+    uint32_t count;
+    float mean;
+    float std;
+    float min;
+    float max;
+    float p50;
+    float p95;
+    float ema;      // Runs across intervals
+};
+
+class ChannelStats {
+public:
+    explicit ChannelStats(float emaAlpha = 0.1f) : median(0.5f), high(0.95f), smooth(emaAlpha) {}
+    void add(float x);
+    // Interval restart; the EMA carries on
+    void reset();
+    uint32_t count() const { return moments.count(); }
+    void summary(StatsSummary* out) const;
+
+private:
+    RunningStats moments;
+    P2Quantile median;
+    P2Quantile high;
+    Ema smooth;
+};
+
+#endif
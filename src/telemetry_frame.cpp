@@ -0,0 +1,98 @@
+#include "telemetry_frame.h"
+
+static void putU16(uint8_t* p, uint16_t v) {
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+}
+
+static void putU32(uint8_t* p, uint32_t v) {
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+    p[2] = (uint8_t)(v >> 16);
+    p[3] = (uint8_t)(v >> 24);
+}
+
+static void putF32(uint8_t* p, float v) {
+    uint32_t bits;
+    memcpy(&bits, &v, sizeof(bits));
+    putU32(p, bits);
+}
+
+static uint16_t getU16(const uint8_t* p) { return (uint16_t)(p[0] | (p[1] << 8)); }
+
+static uint32_t getU32(const uint8_t* p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static float getF32(const uint8_t* p) {
+    uint32_t bits = getU32(p);
+    float v;
+    memcpy(&v, &bits, sizeof(v));
+    return v;
+}
+
+size_t encodeTelemetryFrame(const TelemetryFrame& frame, uint8_t* out, size_t size) {
+    uint8_t n = frame.bank.channels < SENSOR_MAX_CHANNELS ? frame.bank.channels : SENSOR_MAX_CHANNELS;
+    size_t total = TELEMETRY_FRAME_SIZE_CHANNELS(n);
+    if (size < total) return 0;
+    out[0] = n > 1 ? TELEMETRY_FRAME_VERSION_CHANNELS : TELEMETRY_FRAME_VERSION;
+    out[1] = (uint8_t)frame.status.mode;
+    putU16(out + 2, frame.flags);
+    putU32(out + 4, frame.seq);
+    putU32(out + 8, frame.timestamp);
+    putF32(out + 12, frame.status.temp);
+    putF32(out + 16, frame.status.humidity);
+    putF32(out + 20, frame.status.lux);
+    putF32(out + 24, frame.status.dust);
+    putF32(out + 28, frame.status.efficiency);
+    putF32(out + 32, frame.status.soiling);
+    if (n <= 1) return TELEMETRY_FRAME_SIZE;
+
+    // One array per quantity, as in SensorBank
+    out[36] = n;
+    uint8_t* p = out + 37;
+    const float* arrays[] = {frame.bank.temp, frame.bank.humidity, frame.bank.lux, frame.bank.dust};
+    for (const float* values : arrays) {
+        for (uint8_t i = 1; i < n; i++, p += 4) putF32(p, values[i]);
+    }
+    return total;
+}
+
+bool decodeTelemetryFrame(const uint8_t* data, size_t len, TelemetryFrame* out, size_t* used) {
+    if (len < 1) return false;
+    uint8_t version = data[0];
+    if (version < 1 || version > TELEMETRY_FRAME_VERSION_CHANNELS) return false;
+    size_t size = version == 1 ? TELEMETRY_FRAME_V1_SIZE : TELEMETRY_FRAME_SIZE;
+    uint8_t n = 1;
+    if (version == TELEMETRY_FRAME_VERSION_CHANNELS) {
+        if (len <= TELEMETRY_FRAME_SIZE) return false;
+        n = data[36];
+        if (n < 2 || n > SENSOR_MAX_CHANNELS) return false;
+        size = TELEMETRY_FRAME_SIZE_CHANNELS(n);
+    }
+    if (len < size) return false;
+    out->status.mode = (SystemMode)data[1];
+    out->flags = getU16(data + 2);
+    out->seq = getU32(data + 4);
+    out->timestamp = getU32(data + 8);
+    out->status.temp = getF32(data + 12);
+    out->status.humidity = getF32(data + 16);
+    out->status.lux = getF32(data + 20);
+    out->status.dust = getF32(data + 24);
+    out->status.efficiency = getF32(data + 28);
+    out->status.soiling = size > TELEMETRY_FRAME_V1_SIZE ? getF32(data + 32) : NAN;
+
+    SensorBank& bank = out->bank;
+    bank.channels = n;
+    bank.temp[0] = out->status.temp;
+    bank.humidity[0] = out->status.humidity;
+    bank.lux[0] = out->status.lux;
+    bank.dust[0] = out->status.dust;
+    const uint8_t* p = data + 37;
+    float* arrays[] = {bank.temp, bank.humidity, bank.lux, bank.dust};
+    for (float* values : arrays) {
+        for (uint8_t i = 1; i < n; i++, p += 4) values[i] = getF32(p);
+    }
+    if (used) *used = size;
+    return true;
+}
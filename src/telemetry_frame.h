@@ -0,0 +1,58 @@
+#ifndef TELEMETRY_FRAME_H
+#define TELEMETRY_FRAME_H
+
+#include <Arduino.h>
+#include "core.h"
+
+// Packed telemetry frame: one MQTT message per cycle with every SystemStatus
+// field. Little-endian, fixed 36 bytes:
+//
+//   off size field
+//    0   1   version (TELEMETRY_FRAME_VERSION)
+//    1   1   mode (SystemMode)
+//    2   2   flags (TELEMETRY_FLAG_*)
+//    4   4   sequence number
+//    8   4   timestamp (epoch seconds, or uptime seconds if TELEMETRY_FLAG_UPTIME)
+//   12   4   temp        float32 (NaN = not measured)
+//   16   4   humidity    float32
+//   20   4   lux         float32
+//   24   4   dust        float32
+//   28   4   efficiency  float32
+//   32   4   soiling     float32 (version 2)
+//
+// With several sensors per type (SensorBank.channels > 1) the frame is
+// version 3: the fields above are channel 0's, then
+//
+//   36   1   channels (n)
+//   37       temp[1..n-1], humidity[1..n-1], lux[1..n-1], dust[1..n-1]  float32
+//
+// One channel still encodes as version 2, byte for byte.
+
+#define TELEMETRY_FRAME_VERSION 2
+#define TELEMETRY_FRAME_VERSION_CHANNELS 3
+#define TELEMETRY_FRAME_SIZE    36
+#define TELEMETRY_FRAME_V1_SIZE 32     // Still decoded (frames queued by older firmware)
+#define TELEMETRY_FRAME_SIZE_CHANNELS(n) ((n) > 1 ? TELEMETRY_FRAME_SIZE + 1 + 16 * ((n) - 1) : TELEMETRY_FRAME_SIZE)
+#define TELEMETRY_FRAME_MAX_SIZE TELEMETRY_FRAME_SIZE_CHANNELS(SENSOR_MAX_CHANNELS)
+
+#define TELEMETRY_FLAG_UPTIME   0x0001  // Clock not synced, timestamp is uptime
+#define TELEMETRY_FLAG_ALERT    0x0002  // Cleaning alert raised this cycle
+
+struct TelemetryFrame {
+    uint16_t flags;
+    uint32_t seq;
+    uint32_t timestamp;
+    SystemStatus status;
+    SensorBank bank;            // Channels 1.. (and the count); channel 0 is `status`
+};
+
+// Returns bytes written (TELEMETRY_FRAME_SIZE_CHANNELS(bank.channels)) or 0
+// if the buffer is too small
+size_t encodeTelemetryFrame(const TelemetryFrame& frame, uint8_t* out, size_t size);
+
+// Server-side helper; false on short buffer or unknown version. Returns the
+// frame size in *used if given (version 1 frames have no soiling: NaN).
+// The bank gets every channel, channel 0 from the status fields.
+bool decodeTelemetryFrame(const uint8_t* data, size_t len, TelemetryFrame* out, size_t* used = nullptr);
+
+#endif